@@ -0,0 +1,112 @@
+#pragma once
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "rlop/common/timer.h"
+#include "rlop/common/typedef.h"
+
+namespace benchmarks {
+    using rlop::Int;
+
+    // Runs the workloads of the benchmarks and writes one tab-separated line of throughput per workload, so that the
+    // lines of two releases can be joined on the name and compared. A workload is a function of a number of
+    // iterations, which runs them and returns the number of items processed, such as MCTS iterations or sampled
+    // transitions. Its number of iterations is calibrated by warm-up runs so that a repetition lasts `min_seconds`, and
+    // the lines report the median, the minimum and the maximum throughput over the repetitions, of which the
+    // median is the one to track.
+    //
+    // The workloads use fixed seeds and fixed inputs, so that they process the same items from a run to the next.
+    class Runner {
+    public:
+        using Workload = std::function<Int(Int)>;
+
+        // Parameters:
+        //   out: The stream of the lines.
+        //   filter: Runs only the workloads whose name contains it, all if empty.
+        //   min_seconds: The minimum duration of a repetition.
+        //   num_repetitions: The number of repetitions of each workload.
+        Runner(std::ostream& out, std::string filter = "", double min_seconds = 0.5, Int num_repetitions = 5) :
+            out_(out),
+            filter_(std::move(filter)),
+            min_seconds_(min_seconds),
+            num_repetitions_(std::max<Int>(num_repetitions, 1))
+        {}
+
+        // Parses the arguments [filter] [min_seconds] [num_repetitions] of the command line of a benchmark.
+        static Runner FromArgs(int argc, char *argv[], std::ostream& out = std::cout) {
+            std::string filter = argc > 1 && std::string(argv[1]) != "all" ? argv[1] : "";
+            double min_seconds = argc > 2 ? std::stod(argv[2]) : 0.5;
+            Int num_repetitions = argc > 3 ? std::stoll(argv[3]) : 5;
+            return Runner(out, filter, min_seconds, num_repetitions);
+        }
+
+        void WriteHeader() {
+            out_ << "benchmark\tunit\titerations\trepetitions\titems\tmedian_seconds\tmedian_items_per_second"
+                    "\tmin_items_per_second\tmax_items_per_second" << std::endl;
+        }
+
+        bool Enabled(const std::string& name) const {
+            return filter_.empty() || name.find(filter_) != std::string::npos;
+        }
+
+        // Runs a workload, after warm-up runs which calibrate the number of iterations.
+        void Run(const std::string& name, const std::string& unit, const Workload& workload) {
+            if (!Enabled(name))
+                return;
+            Int num_iters = Calibrate(workload);
+            std::vector<double> seconds;
+            std::vector<double> throughputs;
+            Int num_items = 0;
+            for (Int i=0; i<num_repetitions_; ++i) {
+                auto [duration, items] = Time(workload, num_iters);
+                seconds.push_back(duration);
+                throughputs.push_back(items / std::max(duration, 1e-9));
+                num_items = items;
+            }
+            out_ << name << '\t' << unit << '\t' << num_iters << '\t' << num_repetitions_ << '\t' << num_items
+                 << '\t' << Median(seconds) << '\t' << Median(throughputs)
+                 << '\t' << *std::min_element(throughputs.begin(), throughputs.end())
+                 << '\t' << *std::max_element(throughputs.begin(), throughputs.end()) << std::endl;
+        }
+
+        // Notes a workload which cannot run here, as a comment line which the parsers of the lines skip.
+        void Skip(const std::string& name, const std::string& reason) {
+            if (Enabled(name))
+                out_ << "# " << name << " skipped: " << reason << std::endl;
+        }
+
+    protected:
+        // Grows the number of iterations, at most tenfold a run, until a run lasts `min_seconds`.
+        Int Calibrate(const Workload& workload) const {
+            Int num_iters = 1;
+            while (true) {
+                double duration = Time(workload, num_iters).first;
+                if (duration >= min_seconds_)
+                    return num_iters;
+                double scale = duration > 0 ? std::min(1.2 * min_seconds_ / duration, 10.0) : 10.0;
+                num_iters = std::max(num_iters + 1, static_cast<Int>(num_iters * scale));
+            }
+        }
+
+        static std::pair<double, Int> Time(const Workload& workload, Int num_iters) {
+            rlop::Timer<std::chrono::nanoseconds> timer;
+            timer.Start();
+            Int items = workload(num_iters);
+            timer.Stop();
+            return { timer.duration() * 1e-9, items };
+        }
+
+        static double Median(std::vector<double> values) {
+            std::sort(values.begin(), values.end());
+            Int n = values.size();
+            return n % 2 == 1 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+        }
+
+        std::ostream& out_;
+        std::string filter_;
+        double min_seconds_;
+        Int num_repetitions_;
+    };
+}
\ No newline at end of file
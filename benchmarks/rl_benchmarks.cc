@@ -0,0 +1,180 @@
+#include "benchmark.h"
+#include "examples/lunar_lander/ppo_policy.h"
+#include "examples/snake/mcts.h"
+#include "rlop/rl/buffers.h"
+#include "rlop/rl/gym_envs.h"
+
+// The benchmarks of the reinforcement learning, which need libtorch, and of the searches on snake, whose engine needs
+// SFML. The buffers are on the host.
+//
+// Usage: rlop_rl_benchmarks [filter] [min_seconds] [num_repetitions]
+//   filter: Runs only the benchmarks whose name contains it, all of them if empty or "all".
+//   min_seconds: The minimum duration of a repetition. Default is 0.5.
+//   num_repetitions: The number of repetitions of each benchmark. Default is 5.
+namespace benchmarks {
+    constexpr Int kNumEnvs = 16;
+    constexpr Int kObservationSize = 64;
+    constexpr Int kNumActions = 4;
+
+    // MCTS iterations per second of the snake agent, from the same initial state with new trees.
+    void SnakeMCTS(Runner* runner) {
+        constexpr Int kNumSearchIters = 2000;
+        snake::Problem problem;
+        problem.Reset(uint64_t(0));
+        snake::MCTS mcts;
+        runner->Run("mcts/snake", "iterations", [&](Int num_iters) {
+            Int num_items = 0;
+            for (Int i=0; i<num_iters; ++i) {
+                mcts.NewSearch(problem.engine(), kNumSearchIters, false);
+                num_items += mcts.num_iters();
+            }
+            return num_items;
+        });
+    }
+
+    // Sampled transitions per second of a full replay buffer, in batches of 256.
+    void ReplayBufferSample(Runner* runner) {
+        if (!runner->Enabled("replay_buffer/sample"))
+            return;
+        constexpr Int kCapacity = 100000;
+        constexpr Int kBatchSize = 256;
+        rlop::ReplayBuffer buffer(kCapacity, kNumEnvs, { kObservationSize }, {}, torch::kFloat32, torch::kInt64);
+        buffer.Reset();
+        torch::Tensor observations = torch::randn({ kNumEnvs, kObservationSize });
+        torch::Tensor actions = torch::randint(0, kNumActions, { kNumEnvs }, torch::kInt64);
+        torch::Tensor rewards = torch::randn({ kNumEnvs });
+        torch::Tensor dones = torch::zeros({ kNumEnvs });
+        for (Int i=0; i<kCapacity / kNumEnvs; ++i) {
+            buffer.Add(observations, actions, observations, rewards, dones);
+        }
+        runner->Run("replay_buffer/sample", "transitions", [&](Int num_iters) {
+            for (Int i=0; i<num_iters; ++i) {
+                buffer.Sample(kBatchSize);
+            }
+            return num_iters * kBatchSize;
+        });
+    }
+
+    // Fills a rollout buffer of `num_steps` steps with random rollouts.
+    void FillRollouts(rlop::RolloutBuffer* buffer, Int num_steps) {
+        torch::Tensor observations = torch::randn({ kNumEnvs, kObservationSize });
+        torch::Tensor actions = torch::randint(0, kNumActions, { kNumEnvs }, torch::kInt64);
+        for (Int i=0; i<num_steps; ++i) {
+            torch::Tensor episode_starts = (torch::rand({ kNumEnvs }) < 0.01).to(torch::kFloat32);
+            buffer->Add(observations, actions, torch::randn({ kNumEnvs }), torch::randn({ kNumEnvs }), torch::randn({ kNumEnvs }), episode_starts);
+        }
+    }
+
+    // Rollouts per second of the epochs of a rollout buffer, in batches of 64, staged or gathered.
+    void RolloutBufferGet(Runner* runner, bool staged) {
+        std::string name = staged ? "rollout_buffer/get_staged" : "rollout_buffer/get_gathered";
+        if (!runner->Enabled(name))
+            return;
+        constexpr Int kNumSteps = 1024;
+        constexpr Int kBatchSize = 64;
+        rlop::RolloutBuffer buffer(kNumSteps, kNumEnvs, { kObservationSize }, {}, torch::kFloat32, torch::kInt64);
+        buffer.set_staged(staged);
+        buffer.Reset();
+        FillRollouts(&buffer, kNumSteps);
+        buffer.UpdateGAE(torch::zeros({ kNumEnvs }), torch::zeros({ kNumEnvs }), 0.99, 0.95);
+        constexpr Int kNumRollouts = kNumSteps * kNumEnvs;
+        runner->Run(name, "rollouts", [&](Int num_iters) {
+            for (Int i=0; i<num_iters; ++i) {
+                for (Int j=0; j<kNumRollouts; j+=kBatchSize) {
+                    buffer.Get(kBatchSize);
+                }
+            }
+            return num_iters * kNumRollouts;
+        });
+    }
+
+    // Steps per second of the generalized advantage estimation of a full rollout buffer.
+    void UpdateGAE(Runner* runner) {
+        if (!runner->Enabled("rollout_buffer/update_gae"))
+            return;
+        constexpr Int kNumSteps = 1024;
+        rlop::RolloutBuffer buffer(kNumSteps, kNumEnvs, { kObservationSize }, {}, torch::kFloat32, torch::kInt64);
+        buffer.Reset();
+        FillRollouts(&buffer, kNumSteps);
+        torch::Tensor last_values = torch::randn({ kNumEnvs });
+        torch::Tensor dones = torch::zeros({ kNumEnvs });
+        runner->Run("rollout_buffer/update_gae", "steps", [&](Int num_iters) {
+            for (Int i=0; i<num_iters; ++i) {
+                buffer.UpdateGAE(last_values, dones, 0.99, 0.95);
+            }
+            return num_iters * kNumSteps * kNumEnvs;
+        });
+    }
+
+    // Predicted observations per second of the PPO policy of lunar lander on the CPU, in batches of the actors of
+    // `kNumEnvs` environments, float32 or its int8 copy.
+    void PolicyPredict(Runner* runner, bool quantized) {
+        std::string name = quantized ? "policy/predict_int8" : "policy/predict_float32";
+        if (!runner->Enabled(name))
+            return;
+        constexpr Int kLunarLanderObservationSize = 8;
+        auto policy = std::make_shared<lunar_lander::PPOPolicy>(kLunarLanderObservationSize, kNumActions);
+        policy->Reset();
+        std::shared_ptr<rlop::PPOPolicy> predicting_policy = policy;
+        if (quantized) {
+            predicting_policy = rlop::MakeQuantizedPolicy(*policy, [&]() {
+                return std::make_shared<lunar_lander::PPOPolicy>(kLunarLanderObservationSize, kNumActions, true);
+            });
+        }
+        torch::Tensor observations = torch::randn({ kNumEnvs, kLunarLanderObservationSize });
+        runner->Run(name, "observations", [&](Int num_iters) {
+            for (Int i=0; i<num_iters; ++i) {
+                predicting_policy->Predict(observations, true);
+            }
+            return num_iters * kNumEnvs;
+        });
+    }
+
+    // Environment steps per second of a synchronous vector of CartPole environments of Gymnasium, with the
+    // conversions of the actions and of the results that the algorithms make at each step.
+    void GymVectorEnvStep(Runner* runner) {
+        if (!runner->Enabled("gym_vector_env/step"))
+            return;
+        constexpr Int kNumGymEnvs = 8;
+        rlop::GymVectorEnv env;
+        try {
+            env = rlop::GymVectorEnv("CartPole-v1", kNumGymEnvs, "sync");
+        }
+        catch (const std::exception& e) {
+            runner->Skip("gym_vector_env/step", e.what());
+            return;
+        }
+        env.Seed(0);
+        env.Reset();
+        torch::Tensor actions = torch::randint(0, 2, { kNumGymEnvs }, torch::kInt64);
+        runner->Run("gym_vector_env/step", "env_steps", [&](Int num_iters) {
+            for (Int i=0; i<num_iters; ++i) {
+                auto [observations, rewards, terminations, truncations, infos] = env.Step(rlop::pybind11_utils::TensorToArray(actions));
+                rlop::pybind11_utils::ArrayToTensor(py::cast<py::array>(observations));
+                rlop::pybind11_utils::ArrayToTensor(rewards);
+            }
+            return num_iters * kNumGymEnvs;
+        });
+        env.Close();
+    }
+}
+
+int main(int argc, char *argv[]) {
+    using namespace benchmarks;
+
+    py::scoped_interpreter guard{};
+    rlop::torch_utils::SetRandomSeed(0);
+    torch::set_num_threads(1);
+
+    Runner runner = Runner::FromArgs(argc, argv);
+    runner.WriteHeader();
+    SnakeMCTS(&runner);
+    ReplayBufferSample(&runner);
+    RolloutBufferGet(&runner, true);
+    RolloutBufferGet(&runner, false);
+    UpdateGAE(&runner);
+    PolicyPredict(&runner, false);
+    PolicyPredict(&runner, true);
+    GymVectorEnvStep(&runner);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,119 @@
+#include "benchmark.h"
+#include "examples/connect4/mcts.h"
+#include "examples/connect4/alpha_beta_search.h"
+#include "problems/vrp/insertion_solver.h"
+#include "rlop/common/random.h"
+
+// The benchmarks of the searches, which do not need libtorch.
+//
+// Usage: rlop_benchmarks [filter] [min_seconds] [num_repetitions]
+//   filter: Runs only the benchmarks whose name contains it, all of them if empty or "all".
+//   min_seconds: The minimum duration of a repetition. Default is 0.5.
+//   num_repetitions: The number of repetitions of each benchmark. Default is 5.
+namespace benchmarks {
+    // Positions of connect four of the middle game, taken from examples/connect4/positions.txt.
+    const std::vector<std::string> kConnect4Positions = {
+        "..........OX.....XO.X...OX.O...XO.X...OX.O",
+        "..........OX.....XO.....OX.....XO.....OX..",
+        "..........O......X......OX.....XO.....OX.."
+    };
+
+    // MCTS iterations per second of the root-parallel connect four agent, from the same positions with new trees.
+    void Connect4MCTS(Runner* runner) {
+        connect4::MCTS mcts;
+        connect4::Board board;
+        runner->Run("mcts/connect4", "iterations", [&](Int num_iters) {
+            Int num_items = 0;
+            for (Int i=0; i<num_iters; ++i) {
+                for (const auto& position : kConnect4Positions) {
+                    board.Reset(position);
+                    mcts.Reset();
+                    mcts.NewSearch(board, 2000, false);
+                    for (Int n : mcts.num_iters()) {
+                        num_items += n;
+                    }
+                }
+            }
+            return num_items;
+        });
+    }
+
+    // The depth of the alpha-beta searches, which keeps a search from the positions within a second.
+    constexpr Int kAlphaBetaDepth = 16;
+
+    // Searched nodes per second of the single-threaded alpha-beta search, to a fixed depth from the same positions,
+    // each from a cleared transposition table. num_nodes() counts the nodes of the last search only.
+    void AlphaBeta(Runner* runner) {
+        connect4::Board board;
+        auto search = std::make_unique<connect4::AlphaBetaSearch>();
+        runner->Run("alpha_beta/connect4", "nodes", [&](Int num_iters) {
+            Int num_items = 0;
+            for (Int i=0; i<num_iters; ++i) {
+                for (const auto& position : kConnect4Positions) {
+                    board.Reset(position);
+                    search->NewSearch(board, kAlphaBetaDepth);
+                    num_items += search->num_nodes();
+                }
+            }
+            return num_items;
+        });
+    }
+
+    // Neighbour evaluations per second of the operators of a VRP: the routes of a random Euclidean instance are built
+    // by insertion, and each iteration evaluates the deltas of all their neighbours, bypassing the cache of the
+    // deltas of the operator space.
+    void VRPNeighbors(Runner* runner) {
+        using namespace vrp;
+        if (!runner->Enabled("vrp/neighbors"))
+            return;
+        const Int num_nodes = 200;
+        const Int num_routes = 10;
+        rlop::Random rand(0);
+        // The targets, followed by the depot shared by the sentinels of the routes.
+        std::vector<std::array<double, 2>> points(num_nodes + 1);
+        for (auto& point : points) {
+            point = { rand.Uniform(0.0, 1000.0), rand.Uniform(0.0, 1000.0) };
+        }
+        std::function<Int(Int, Int)> get_cost = [&points, num_nodes](Int from, Int to) {
+            const auto& a = points[std::min(from, num_nodes)];
+            const auto& b = points[std::min(to, num_nodes)];
+            return static_cast<Int>(std::hypot(a[0] - b[0], a[1] - b[1]) + 0.5);
+        };
+        Routes routes(num_routes, num_nodes);
+        routes.Reset();
+        ArcCostManager cost_manager(routes, get_cost);
+        OperatorSpace space(routes);
+        BasicProblem<ArcCostManager> problem(&routes, &space, &cost_manager);
+        cost_manager.Reset();
+        space.Reset();
+        InsertionSolver(&problem).Solve();
+        space.GenerateNeighbors();
+
+        runner->Run("vrp/neighbors", "evaluations", [&](Int num_iters) {
+            Int num_items = 0;
+            Int checksum = 0;
+            for (Int i=0; i<num_iters; ++i) {
+                Int num_neighbors = space.NumNeighbors();
+                for (Int j=0; j<num_neighbors; ++j) {
+                    checksum += problem.EvaluateDelta(*space.GetNeighbor(j));
+                }
+                num_items += num_neighbors;
+            }
+            // Keeps the evaluations from being optimized away.
+            if (checksum == rlop::kIntNull)
+                std::cerr << checksum << std::endl;
+            return num_items;
+        });
+    }
+}
+
+int main(int argc, char *argv[]) {
+    using namespace benchmarks;
+
+    Runner runner = Runner::FromArgs(argc, argv);
+    runner.WriteHeader();
+    Connect4MCTS(&runner);
+    AlphaBeta(&runner);
+    VRPNeighbors(&runner);
+    return 0;
+}
\ No newline at end of file
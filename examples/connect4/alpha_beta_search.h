@@ -2,32 +2,51 @@
 #include "problems/connect4/problem.h"
 #include "rlop/minmax/alpha_beta_search_trans.h"
 #include "rlop/minmax/transpositions.h"
+#include "rlop/minmax/lazy_smp.h"
 
 namespace connect4 {
     class AlphaBetaSearch : public rlop::AlphaBetaSearchTrans<Board::bitboard> {
     public:
-        static constexpr Int kTransSize = 8306069;
+        using Item = rlop::BucketTransposition<Board::bitboard>::Item;
+
+        static constexpr Int kTransBytes = Int(128) << 20;
         static constexpr Int kSymmetryThres = 10;
         static constexpr double kWinScore = 1;
-
-        AlphaBetaSearch() : rlop::AlphaBetaSearchTrans<Board::bitboard>(kWinScore), transposition_(kTransSize) {}
+        static constexpr double kThreatScore = 100;
+
+        AlphaBetaSearch() : 
+            rlop::AlphaBetaSearchTrans<Board::bitboard>(kWinScore), 
+            transposition_(std::make_shared<rlop::BucketTransposition<Board::bitboard>>(kTransBytes)) 
+        {
+            // The scores are -1, 0 and 1, so the null windows of principal variation search can be one point wide.
+            set_score_resolution(1);
+            set_pvs(true);
+        }
 
         void Reset() override {
             problem_.Reset();
-            transposition_.Reset();
+            transposition_->Reset();
             ResetPriorScores();
+            ClearMoveHistory();
         }
 
         void Reset(const Board& board) {
             problem_.Reset(board);
-            transposition_.Reset();
+            transposition_->Reset();
             ResetPriorScores();
+            ClearMoveHistory();
         } 
 
         void Reset(Board&& board) {
             problem_.Reset(std::move(board));
-            transposition_.Reset();
+            transposition_->Reset();
             ResetPriorScores();
+            ClearMoveHistory();
+        }
+
+        // Copies the board and shares the transposition table, for the helper threads of Lazy SMP.
+        std::unique_ptr<rlop::AlphaBetaSearch> Clone() const override {
+            return std::make_unique<AlphaBetaSearch>(*this);
         }
 
         void ResetPriorScores() {
@@ -41,17 +60,23 @@ namespace connect4 {
             };
         }
 
+        // Scores a finished game, or a game the player to move wins at the next move.
         double Evaluate() override {
             if (problem_.board().Win())
                 return -1;
+            if (problem_.board().CanWinNext())
+                return 1;
             return 0;
         }
 
+        // The game is decided as soon as the player to move can win immediately, which saves searching the last ply.
         bool IsTerminal() override {
             if (problem_.board().IsFull())
                 return true;
             else if (problem_.board().Win()) 
                 return true;
+            else if (problem_.board().CanWinNext())
+                return true;
 
             return false;
         }
@@ -73,23 +98,30 @@ namespace connect4 {
             return prior_scores_[problem_.board().heights()[move]][move];
         }
 
-        std::vector<Int> GenerateMoves() override {
-            std::vector<Int> moves;
-            moves.reserve(problem_.NumMoves());
+        // Indexes the history table by the square a move drops its disc on. The history is off by default, since the
+        // threat scores of GenerateMoves() order the moves better.
+        Int HistoryIndex(Int move) override {
+            return problem_.board().heights()[move] * Board::kWidth_ + move;
+        }
+
+        // Generates the moves which do not let the opponent win at the next move, scored by the threats they create
+        // and then by their prior scores. A winning move is returned alone, and no move is returned when the game is
+        // lost at the next move anyway.
+        void GenerateMoves(rlop::MoveList& moves) override {
+            const Board& board = problem_.board();
+            Board::bitboard winning = board.WinningMoves();
+            Board::bitboard candidates = winning ? winning : board.NonLosingMoves();
             for (Int i=0; i<problem_.NumMoves(); ++i) {
                 Int move = problem_.GetMove(i);
-                if (problem_.Step(move)) {
-                    if (problem_.board().Win()) {
-                        problem_.Undo(move);
-                        moves = { move };
-                        break;
-                    }
-                    problem_.Undo(move);
-                    moves.push_back(move);
+                Board::bitboard cell = candidates & Board::ColumnMask(move);
+                if (cell == 0)
+                    continue;
+                if (winning) {
+                    moves.Add(move);
+                    return;
                 }
+                moves.Add(move, kThreatScore * board.MoveScore(cell) + GetPriorScore(move));
             }
-            std::sort(moves.begin(), moves.end(), [this](Int mv1, Int mv2){ return this->GetPriorScore(mv1) > this->GetPriorScore(mv2);});
-            return moves;
         }
 
         bool MakeMove(Int move) override {
@@ -100,22 +132,48 @@ namespace connect4 {
             problem_.Undo(move);
         }
 
-        std::optional<std::pair<double, ValueType>> Transpose(const Board::bitboard& key, Int depth) override {
-            const auto& item = transposition_.Get(key);
-            if (item.lock == key && item.depth >= depth) 
-                return std::pair<double, ValueType>{ item.value, item.type };
-            return std::nullopt;
+        // Looks a position up in the transposition table, and in the book on a miss, whose items are copied to the
+        // table so that the book is read once per position and search.
+        std::optional<TableEntry> Transpose(const Board::bitboard& key, Int depth) override {
+            auto item = transposition_->Get(key);
+            if ((item.lock != key || item.type == ValueType::kNone) && book_ != nullptr && problem_.board().num_moves() <= book_->max_ply()) {
+                item = book_->Get(key);
+                if (item.type != ValueType::kNone)
+                    transposition_->Save(key, item);
+            }
+            if (item.lock != key || item.type == ValueType::kNone)
+                return std::nullopt;
+            if (item.depth >= depth) 
+                return TableEntry{ item.value, item.type, item.move };
+            return TableEntry{ item.value, ValueType::kNone, item.move };
         }
 
-        void UpdateTable(const Board::bitboard& key, Int depth, double value, ValueType type) override {
-            const auto& item = transposition_.Get(key);
-            if (item.type == ValueType::kNone || depth > item.depth)
-                transposition_.Save(key, { key, depth, value, type });
+        void UpdateTable(const Board::bitboard& key, Int depth, double value, ValueType type, Int move) override {
+            transposition_->Save(key, { key, depth, value, type, move });
         }
 
-        auto NewSearch(const Board& board, Int depth = kIntFull) {
+        // Searches the best move from a board. With a time limit or several threads, the search deepens iteratively
+        // until the deadline and returns the best move of the deepest completed iteration.
+        //
+        // Parameters:
+        //   board: The board to search from.
+        //   depth: The maximum depth of the search.
+        //   max_duration: The maximum duration of the search in milliseconds.
+        auto NewSearch(const Board& board, Int depth = kIntFull, Int max_duration = kIntFull) {
             Reset(board);
-            auto [mv, value] = Search(depth);
+            StartSearch();
+            if (board.CanWinNext()) {
+                last_value_ = kWinScore;
+                for (Int i=0; i<problem_.NumMoves(); ++i) {
+                    Int mv = problem_.GetMove(i);
+                    if (board.WinningMoves() & Board::ColumnMask(mv))
+                        return mv;
+                }
+            }
+            Int max_depth = std::min<Int>(depth, Board::kSize_ - board.num_moves());
+            auto [mv, value] = num_threads_ > 1 ? rlop::LazySMP(num_threads_).Search(*this, max_depth, max_duration) :
+                (max_duration == kIntFull ? SearchDepth(max_depth) : IterativeDeepening(max_depth, max_duration));
+            last_value_ = value;
             if (mv == kIntNull) {
                 for (Int i=0; i<problem_.NumMoves(); ++i) {
                     Int mv = problem_.GetMove(i);
@@ -126,9 +184,66 @@ namespace connect4 {
             return mv;
         }
 
+        // Returns the value of the best move found by the last NewSearch(), from the point of view of the player to move:
+        // 1 for a win, -1 for a loss and 0 for a draw or when the search did not see the end of the game.
+        double last_value() const {
+            return last_value_;
+        }
+
+        // Sets a book of positions solved by earlier searches, which the searches look up when the table misses, or
+        // nullptr for none. The book is shared with the helper threads of Lazy SMP.
+        void set_book(const std::shared_ptr<rlop::TranspositionBook<Board::bitboard>>& book) {
+            book_ = book;
+        }
+
+        const std::shared_ptr<rlop::TranspositionBook<Board::bitboard>>& book() const {
+            return book_;
+        }
+
+        // Writes the items of the transposition table of the last search whose positions have at most
+        // `max_num_moves` moves, merged with those of the book, to a book at `path`, which becomes the book of the
+        // searches. Called after each search, it builds an opening book of the positions solved.
+        void SaveBook(const std::string& path, Int max_num_moves = Board::kSize_) {
+            std::vector<Item> items;
+            if (book_ != nullptr)
+                items = book_->Items();
+            transposition_->ForEach([&](const Item& item) {
+                if (item.type != ValueType::kNone && NumMoves(item.lock) <= max_num_moves)
+                    items.push_back(item);
+            });
+            Int max_ply = 0;
+            for (const auto& item : items) {
+                max_ply = std::max(max_ply, NumMoves(item.lock));
+            }
+            rlop::TranspositionBook<Board::bitboard>::Write(path, std::move(items), max_ply);
+            book_ = std::make_shared<rlop::TranspositionBook<Board::bitboard>>(path);
+        }
+
+        // Returns the number of moves of a position from its code: a column holds its discs of the player to move
+        // under a bit at its height.
+        static Int NumMoves(Board::bitboard code) {
+            Int num_moves = 0;
+            for (Int col=0; col<Board::kWidth_; ++col) {
+                Board::bitboard column = (code >> (Board::kH1_ * col)) & Board::kCol1_;
+                while (column > 1) {
+                    column >>= 1;
+                    ++num_moves;
+                }
+            }
+            return num_moves;
+        }
+
+        // Sets the number of threads of the Lazy SMP search.
+        void set_num_threads(Int num_threads) {
+            num_threads_ = std::max<Int>(num_threads, 1);
+        }
+
     protected:
         Problem problem_;
-        rlop::CircularTransposition<Board::bitboard> transposition_;
+        std::shared_ptr<rlop::BucketTransposition<Board::bitboard>> transposition_;
+        std::shared_ptr<rlop::TranspositionBook<Board::bitboard>> book_ = nullptr;
+        Int num_threads_ = 1;
+        double last_value_ = 0;
         std::vector<std::vector<Int>> prior_scores_;
     };
 }
\ No newline at end of file
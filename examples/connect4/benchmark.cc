@@ -0,0 +1,70 @@
+#include "mcts.h"
+#include "alpha_beta_search.h"
+#include "rlop/common/timer.h"
+
+// Runs the alpha-beta solver and the MCTS agent over a set of positions and prints one CSV row per position and
+// solver, so that runs before and after a change can be compared.
+//
+// Usage: connect4_benchmark [positions] [max_positions] [max_duration] [mcts_iters] [threads]
+//   positions: The file of positions, one per line. Default is positions.txt.
+//   max_positions: The number of positions to run from the top of the file. Default is 5.
+//   max_duration: The time limit of the alpha-beta search per position in milliseconds, 0 for none. Default is 0.
+//   mcts_iters: The number of MCTS iterations per child of the root. Default is 6000.
+//   threads: The number of threads of the alpha-beta search. Default is 1.
+//
+// For alpha-beta, nodes are the searched nodes. For MCTS, they are the iterations and the hit rate is left empty.
+int main(int argc, char *argv[]) {
+    using namespace connect4;
+
+    std::string path = argc > 1 ? argv[1] : "positions.txt";
+    Int max_positions = argc > 2 ? std::stoi(argv[2]) : 5;
+    Int max_duration = argc > 3 && std::stoi(argv[3]) > 0 ? std::stoi(argv[3]) : kIntFull;
+    Int mcts_iters = argc > 4 ? std::stoi(argv[4]) : 6000;
+    Int num_threads = argc > 5 ? std::stoi(argv[5]) : 1;
+
+    std::ifstream input(path);
+    if (!input)
+        throw std::runtime_error("Cannot open the positions file " + path + ".");
+    std::vector<std::string> positions;
+    std::string position;
+    while (positions.size() < max_positions && getline(input, position)) {
+        if (!position.empty())
+            positions.push_back(position);
+    }
+
+    std::cout << "solver,position,moves,best_move,value,depth,time_ms,nodes,nodes_per_s,tt_hit_rate" << std::endl;
+    rlop::Timer timer;
+    Board board;
+    auto ab = std::make_unique<AlphaBetaSearch>();
+    ab->set_num_threads(num_threads);
+    ab->set_statistics_enabled(true);
+    for (Int i=0; i<positions.size(); ++i) {
+        board.Reset(positions[i]);
+        ab->ClearStatistics();
+        timer.Restart();
+        Int move = ab->NewSearch(board, kIntFull, max_duration);
+        timer.Stop();
+        const auto& statistics = ab->statistics();
+        Int depth = max_duration == kIntFull && num_threads == 1 ? Board::kSize_ - board.num_moves() : ab->completed_depth();
+        std::cout << "alpha_beta," << i << "," << board.num_moves() << "," << move << "," << ab->last_value() << ","
+                  << depth << "," << timer.duration() << "," << statistics.num_nodes << ","
+                  << statistics.num_nodes * 1e3 / std::max<Int>(timer.duration(), 1) << "," << statistics.HitRate() << std::endl;
+    }
+    ab.reset();
+
+    MCTS mcts;
+    mcts.set_statistics_enabled(true);
+    for (Int i=0; i<positions.size(); ++i) {
+        board.Reset(positions[i]);
+        mcts.Reset();
+        mcts.ClearStatistics();
+        timer.Restart();
+        Int move = mcts.NewSearch(board, mcts_iters, false);
+        timer.Stop();
+        auto statistics = mcts.TotalStatistics();
+        std::cout << "mcts," << i << "," << board.num_moves() << "," << move << ",,"
+                  << statistics.max_depth << "," << timer.duration() << "," << statistics.num_iters << ","
+                  << statistics.num_iters * 1e3 / std::max<Int>(timer.duration(), 1) << "," << std::endl;
+    }
+    return 0;
+}
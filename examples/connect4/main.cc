@@ -12,6 +12,13 @@ int main(int argc, char *argv[]) {
    
     if (argc <= 1 || std::string(argv[1]) == "alpha_beta") {
         AlphaBetaSearch solver;
+        if (argc > 3)
+            solver.set_num_threads(std::stoi(argv[3]));
+        // The book of the solved positions, which the solves look up and extend.
+        std::string book_path = argc > 4 ? argv[4] : "";
+        Int book_max_moves = argc > 5 ? std::stoi(argv[5]) : 20;
+        if (!book_path.empty() && std::filesystem::exists(book_path))
+            solver.set_book(std::make_shared<rlop::TranspositionBook<Board::bitboard>>(book_path));
         std::ifstream input(argv[2]);
         std::string position;
         while(getline(input, position)) {                                            
@@ -24,6 +31,8 @@ int main(int argc, char *argv[]) {
             timer.Stop();
             board.Print();
             std::cout << "Solved in duration: " << timer.duration() << std::endl;
+            if (!book_path.empty())
+                solver.SaveBook(book_path, book_max_moves);
         }
     }
     else if (std::string(argv[1]) == "mcts") {
@@ -5,11 +5,20 @@
 namespace connect4 {
     class MCTS : public rlop::RootParallelMCTS {
     public:
-        MCTS(double coef = std::sqrt(2)) : problem_(Board::kWidth_), rlop::RootParallelMCTS(Board::kWidth_, coef) {}
+        MCTS(double coef = std::sqrt(2)) : problem_(Board::kWidth_), rlop::RootParallelMCTS(Board::kWidth_, coef), illegal_(Board::kWidth_, false), playout_rewards_(Board::kWidth_) {
+            set_solver(true);
+        }
+
+        void PlaceEnv(Int env_i) override {
+            rlop::RootParallelMCTS::PlaceEnv(env_i);
+            std::vector<Int> stack;
+            stack.reserve(std::max<size_t>(stacks_[env_i].capacity(), 64));
+            stacks_[env_i].swap(stack);
+        }
 
         void Reset() override {
             rlop::RootParallelMCTS::Reset();
-            stacks_ = std::vector<std::vector<Int>>(problem_.num_problems());
+            stacks_.resize(problem_.num_problems());
             for (Int i=0; i<problem_.num_problems(); ++i) {
                 paths_[i].reserve(64);
                 stacks_[i].reserve(64);
@@ -25,6 +34,8 @@ namespace connect4 {
         }
 
         void RevertState(Int env_i) override {
+            illegal_[env_i] = false;
+            playout_rewards_[env_i] = std::nullopt;
             while (!stacks_[env_i].empty()) {
                 problem_.Undo(env_i, stacks_[env_i].back());
                 stacks_[env_i].pop_back();
@@ -33,15 +44,31 @@ namespace connect4 {
 
         bool Step(Int env_i, Int child_i) override {
             Int move = problem_.GetMove(child_i);
-            if (!problem_.Step(env_i, move))
+            if (!problem_.Step(env_i, move)) {
+                illegal_[env_i] = true;
                 return false;
+            }
             stacks_[env_i].push_back(move);
             if (problem_.boards()[env_i].IsOver())
                 return false;
             return true;
         }
 
+        // Plays the random continuations of the leaf as a batch of playouts on the bitboards, in place of stepping one
+        // game a move at a time through the problem, and keeps their mean reward for BackPropagate().
+        bool Simulate(Int env_i) override {
+            const Board& board = problem_.boards()[env_i];
+            // The rewards are for the player of the move at the root, as in Reward().
+            int player = (board.num_moves() - 1 - (Int)stacks_[env_i].size()) % 2;
+            int64_t num_plies = 0;
+            playout_rewards_[env_i] = board.RandomPlayouts(num_playouts_, player, rands_[env_i].get(), &num_plies);
+            rollout_lengths_[env_i] += num_plies / num_playouts_;
+            return false;
+        }
+
         double Reward(Int env_i) override {
+            if (playout_rewards_[env_i])
+                return *playout_rewards_[env_i];
             if (problem_.boards()[env_i].Win()) {
                 if (stacks_[env_i].size() % 2 == 0)
                     return 1;
@@ -59,6 +86,16 @@ namespace connect4 {
             }
         }
 
+        std::optional<double> TerminalValue(Int env_i) override {
+            if (illegal_[env_i])
+                return std::numeric_limits<double>::lowest();
+            if (problem_.boards()[env_i].Win())
+                return 1;
+            if (problem_.boards()[env_i].IsFull())
+                return 0;
+            return std::nullopt;
+        }
+
         void UpdateNode(Int env_i, double reward) const override {
             if (paths_[env_i].size() % 2 == 1)
                rlop::RootParallelMCTS::UpdateNode(env_i, reward);
@@ -66,46 +103,89 @@ namespace connect4 {
                rlop::RootParallelMCTS::UpdateNode(env_i, -reward);
         }
         
-        Int NewSearch(const Board& board, Int max_num_iters = 6000) {
+        // Reuses the trees of the previous search if `board` follows the previous root board by one move of each
+        // player. The tree of environment `j` is then the grandchild (o, j) of the tree of the move played.
+        //
+        // Parameters:
+        //   board: The board of the next search.
+        //
+        // Returns:
+        //   bool: Returns true if the trees were reused.
+        bool ReuseTrees(const Board& board) {
+            if (!last_board_ || board.num_moves() != last_board_->num_moves() + 2)
+                return false;
+            for (Int m=0; m<problem_.NumMoves(); ++m) {
+                for (Int o=0; o<problem_.NumMoves(); ++o) {
+                    Board next = *last_board_;
+                    if (!next.MakeMove(problem_.GetMove(m)) || next.IsOver() || !next.MakeMove(problem_.GetMove(o)))
+                        continue;
+                    if (next.players() != board.players())
+                        continue;
+                    const Node* root = paths_[m].front();
+                    const Node* node = o < root->children.size() ? root->children[o] : nullptr;
+                    for (Int j=0; j<problem_.NumMoves(); ++j) {
+                        if (j == m)
+                            continue;
+                        CopyTree(j, (node != nullptr && j < node->children.size()) ? node->children[j] : nullptr);
+                    }
+                    if (AdvanceRoot(m, o))
+                        AdvanceRoot(m, m);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Sets the number of random playouts averaged at each simulation.
+        void set_num_playouts(Int num_playouts) {
+            num_playouts_ = std::max<Int>(num_playouts, 1);
+        }
+
+        Int num_playouts() const {
+            return num_playouts_;
+        }
+
+        Int NewSearch(const Board& board, Int max_num_iters = 6000, bool reuse_trees = true) {
             if (board.IsOver())
                 return kIntNull;
-            Reset();
-            Int best_i = kIntNull;
-            double score = std::numeric_limits<double>::lowest();
-            #pragma omp parallel for
-            for (Int i=0; i < problem_.NumMoves(); ++i) {
+            if (!reuse_trees || !ReuseTrees(board))
+                Reset();
+            last_board_ = board;
+            Int num_moves = problem_.NumMoves();
+            scores_.assign(num_moves, std::numeric_limits<double>::lowest());
+            ForEachEnv([&](Int i) {
                 problem_.Reset(i, board);
-                if(problem_.Step(i, problem_.GetMove(i))) {
-                    if (problem_.boards()[i].Win()) {
-                        #pragma omp critical
-                        {
-                            best_i = i;
-                            score = std::numeric_limits<double>::max();
-                        }
-                    }
-                    else if (problem_.boards()[i].IsFull()) {
-                        #pragma omp critical
-                        if (0 > score) {
-                            best_i = i;
-                            score = 0;
-                        } 
-                    }
+                stacks_[i].clear();
+                if (problem_.Step(i, problem_.GetMove(i))) {
+                    if (problem_.boards()[i].Win())
+                        scores_[i] = std::numeric_limits<double>::max();
+                    else if (problem_.boards()[i].IsFull())
+                        scores_[i] = 0;
                     else {
                         Search(i, max_num_iters);
-                        #pragma omp critical
-                        if (paths_[i].front()->mean_reward > score) {
-                            best_i = i;
-                            score = paths_[i].front()->mean_reward;
-                        } 
+                        const Node* root = paths_[i].front();
+                        scores_[i] = root->proven ? root->proven_value : root->mean_reward;
                     }
-                    
                 }
-            } 
-            return best_i; 
+            });
+            Int best_i = kIntNull;
+            double score = std::numeric_limits<double>::lowest();
+            for (Int i=0; i<num_moves; ++i) {
+                if (scores_[i] > score) {
+                    best_i = i;
+                    score = scores_[i];
+                }
+            }
+            return best_i;
         }
 
     protected:
         VectorProblem problem_;
         std::vector<std::vector<Int>> stacks_;
+        std::vector<double> scores_;
+        std::optional<Board> last_board_;
+        std::vector<uint8_t> illegal_;
+        Int num_playouts_ = 4;
+        std::vector<std::optional<double>> playout_rewards_; // The mean reward of the playouts of the iteration.
     };
 }
\ No newline at end of file
@@ -0,0 +1,53 @@
+#include "self_play.h"
+#include "rlop/common/timer.h"
+
+// Trains a policy-value network of connect four by self-play.
+//
+// Usage: connect4_self_play [num_gradient_steps] [num_actors]
+int main(int argc, char *argv[]) {
+    using namespace connect4;
+
+    Int num_gradient_steps = argc > 1 ? std::stoll(argv[1]) : 100000;
+    Int num_actors = argc > 2 ? std::stoll(argv[2]) : 32;
+    torch::Device device = torch::cuda::is_available() ? torch::kCUDA : torch::kCPU;
+
+    rlop::SelfPlay self_play(
+        std::make_shared<PolicyValueNet>(),
+        std::make_shared<PolicyValueNet>(),
+        []() { return std::make_unique<SelfPlayGame>(); },
+        num_actors, // num_actors
+        200, // num_simulations
+        8, // search_batch_size
+        200000, // replay_capacity
+        10000, // learning_starts
+        256, // batch_size
+        1e-3, // lr
+        100, // sync_interval
+        10, // num_sampled_moves
+        1.0, // dirichlet_alpha
+        0.25, // noise_fraction
+        512, // max_inference_batch_size
+        500, // max_inference_latency_us
+        device // device
+    );
+    self_play.Reset();
+
+    rlop::Timer timer;
+    timer.Start();
+    Int log_interval = 1000;
+    for (Int i=0; i<num_gradient_steps; i+=log_interval) {
+        self_play.Learn(std::min(log_interval, num_gradient_steps - i));
+        auto [policy_loss, value_loss] = self_play.losses();
+        const rlop::InferenceBatcher* batcher = self_play.batcher();
+        std::cout << "gradient_steps: " << self_play.num_gradient_steps()
+            << " games: " << self_play.num_games()
+            << " positions: " << self_play.num_positions()
+            << " policy_loss: " << policy_loss
+            << " value_loss: " << value_loss
+            << " mean_inference_batch: " << batcher->num_requests() / std::max<double>(batcher->num_batches(), 1)
+            << std::endl;
+    }
+    timer.Stop();
+    std::cout << "duration: " << timer.duration() << std::endl;
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,119 @@
+#pragma once
+#include "problems/connect4/board.h"
+#include "rlop/rl/self_play.h"
+
+namespace connect4 {
+    using rlop::Int;
+
+    // Connect four as a game of rlop::SelfPlay, whose actions are the columns.
+    class SelfPlayGame : public rlop::SelfPlayGame {
+    public:
+        SelfPlayGame() {
+            board_.Reset();
+        }
+
+        void Reset() override {
+            board_.Reset();
+        }
+
+        std::unique_ptr<rlop::SelfPlayGame> Clone() const override {
+            return std::make_unique<SelfPlayGame>(*this);
+        }
+
+        void CopyFrom(const rlop::SelfPlayGame& other) override {
+            board_ = static_cast<const SelfPlayGame&>(other).board_;
+        }
+
+        Int NumActions() const override {
+            return Board::kWidth_;
+        }
+
+        bool IsLegal(Int action) const override {
+            return !board_.IsOver() && board_.IsPlayable(action);
+        }
+
+        bool Step(Int action) override {
+            board_.MakeMove(action);
+            return !board_.IsOver();
+        }
+
+        bool IsOver() const override {
+            return board_.IsOver();
+        }
+
+        double Result() const override {
+            return board_.Win() ? 1 : 0;
+        }
+
+        // Returns the discs of the player to move and those of the opponent as two planes of the board.
+        torch::Tensor Observe() const override {
+            torch::Tensor observation = torch::zeros({ 2, Board::kHeight_, Board::kWidth_ }, torch::kFloat32);
+            float* data = observation.data_ptr<float>();
+            const auto& players = board_.players();
+            for (Int plane=0; plane<2; ++plane) {
+                Board::bitboard discs = players[(board_.num_moves() + plane) % 2];
+                for (Int col=0; col<Board::kWidth_; ++col) {
+                    for (Int row=0; row<Board::kHeight_; ++row) {
+                        if (discs & (static_cast<Board::bitboard>(1) << (row + Board::kH1_ * col)))
+                            data[(plane * Board::kHeight_ + row) * Board::kWidth_ + col] = 1;
+                    }
+                }
+            }
+            return observation;
+        }
+
+        const Board& board() const {
+            return board_;
+        }
+
+    protected:
+        Board board_;
+    };
+
+    // A convolutional policy-value network of the planes of SelfPlayGame.
+    class PolicyValueNet : public rlop::PolicyValueNet {
+    public:
+        PolicyValueNet(Int num_channels = 64) :
+            feature_extractor_(
+                torch::nn::Conv2d(torch::nn::Conv2dOptions(2, num_channels, 3).padding({1, 1})),
+                torch::nn::ReLU(),
+                torch::nn::Conv2d(torch::nn::Conv2dOptions(num_channels, num_channels, 3).padding({1, 1})),
+                torch::nn::ReLU(),
+                torch::nn::Conv2d(torch::nn::Conv2dOptions(num_channels, num_channels, 3).padding({1, 1})),
+                torch::nn::ReLU(),
+                torch::nn::Flatten()
+            ),
+            policy_net_(num_channels * Board::kSize_, Board::kWidth_),
+            value_mlp_(num_channels * Board::kSize_, 64),
+            value_net_(64, 1)
+        {
+            register_module("feature_extractor", feature_extractor_);
+            register_module("policy_net", policy_net_);
+            register_module("value_mlp", value_mlp_);
+            register_module("value_net", value_net_);
+        }
+
+        void Reset() override {
+            feature_extractor_->apply([](torch::nn::Module& module){ rlop::RLPolicy::InitWeights(&module, std::sqrt(2.0)); });
+            policy_net_->apply([](torch::nn::Module& module){ rlop::RLPolicy::InitWeights(&module, 0.01); });
+            value_mlp_->apply([](torch::nn::Module& module){ rlop::RLPolicy::InitWeights(&module, std::sqrt(2.0)); });
+            value_net_->apply([](torch::nn::Module& module){ rlop::RLPolicy::InitWeights(&module, 1.0); });
+        }
+
+        void SetTrainingMode(bool mode) override {
+            train(mode);
+        }
+
+        std::array<torch::Tensor, 2> PredictPolicyValues(const torch::Tensor& observations) override {
+            torch::Tensor features = feature_extractor_->forward(observations);
+            torch::Tensor values = torch::tanh(value_net_->forward(torch::relu(value_mlp_->forward(features)))).view({ -1 });
+            return { policy_net_->forward(features), values };
+        }
+
+    protected:
+        torch::nn::Sequential feature_extractor_;
+        torch::nn::Linear policy_net_;
+        torch::nn::Linear value_mlp_;
+        torch::nn::Linear value_net_;
+    };
+}
\ No newline at end of file
@@ -77,5 +77,38 @@ int main(int argc, char *argv[]) {
         auto [mean_reward, std_reward] = evaluator.Evaluate(&solver, 1000);
         std::cout << mean_reward << " " << std_reward << " " << timer.duration() << std::endl;
     }
+    else if (std::string(argv[1]) == "ppo_seeds") {
+        // Trains the PPO of several seeds in one process, each on its own group of environments.
+        Int num_seeds = argc > 2 ? std::stoll(argv[2]) : 8;
+        Int num_envs_per_seed = 4;
+        std::cout << "PPO training of " << num_seeds << " seeds..." << std::endl;
+        PPO solver(
+            num_seeds * num_envs_per_seed, // num_envs
+            false, // render
+            1024, // num_steps
+            64 * num_seeds, // batch_size
+            4, // num_epochs
+            3e-4, // lr
+            0.99, // gamma
+            0.2, // clip_range
+            0, // clip_range_vf
+            false, // normalize_advantage
+            0.01, // ent_coef
+            0.1, // vf_coef
+            0.98, // gae_lambda
+            0.5, // max_grad_norm
+            0, // target_kl
+            path + "_ppo_seeds", // output_path
+            torch::kCUDA // device
+        );
+        solver.set_num_seeds(num_seeds);
+        solver.Reset();
+        timer.Start();
+        // The time steps count those of all the seeds.
+        solver.Learn(num_time_steps * num_seeds, 1);
+        timer.Stop();
+        solver.Save("data/continuous_lunar_lander/rlop_ppo_seeds.pth");
+        std::cout << timer.duration() << std::endl;
+    }
     return 0;
 }
\ No newline at end of file
@@ -61,6 +61,8 @@ namespace continuous_lunar_lander {
         }
 
         std::shared_ptr<rlop::PPOPolicy> MakePolicy() const override {
+            if (num_seeds_ > 1)
+                return std::make_shared<EnsemblePPOPolicy>(num_seeds_, rollout_buffer_->observation_sizes()[0], rollout_buffer_->action_sizes()[0]);
             return std::make_shared<PPOPolicy>(rollout_buffer_->observation_sizes()[0], rollout_buffer_->action_sizes()[0]);
         }
 
@@ -70,26 +72,21 @@ namespace continuous_lunar_lander {
 
         torch::Tensor ResetEnv() override {
             auto [observations, info] = env_.Reset();
-            return rlop::pybind11_utils::ArrayToTensor(py::cast<py::array>(observations));
+            return rlop::pybind11_utils::ArrayToTensorView(py::cast<py::array>(observations));
         }
 
         std::array<torch::Tensor, 5> Step(const torch::Tensor& actions) override {
-            auto [observation_py, rewards_array, termination_array, truncation_array, infos] = env_.Step(rlop::pybind11_utils::TensorToArray(actions)); 
-            torch::Tensor observations = rlop::pybind11_utils::ArrayToTensor(py::cast<py::array>(observation_py));
-            torch::Tensor rewards = rlop::pybind11_utils::ArrayToTensor(rewards_array);
-            torch::Tensor terminations = rlop::pybind11_utils::ArrayToTensor(termination_array);
-            torch::Tensor truncations = rlop::pybind11_utils::ArrayToTensor(truncation_array);
+            auto [observation_py, rewards_array, termination_array, truncation_array, infos] = env_.Step(rlop::pybind11_utils::TensorToArrayView(actions)); 
+            // The arrays returned by the step are fresh, so the tensors view them instead of copying them.
+            torch::Tensor observations = rlop::pybind11_utils::ArrayToTensorView(py::cast<py::array>(observation_py));
+            torch::Tensor rewards = rlop::pybind11_utils::ArrayToTensorView(rewards_array);
+            torch::Tensor terminations = rlop::pybind11_utils::ArrayToTensorView(termination_array);
+            torch::Tensor truncations = rlop::pybind11_utils::ArrayToTensorView(truncation_array);
             torch::Tensor final_observations = torch::zeros_like(observations);
             if (infos.contains("final_observation")) {
-                int i=0;
-                auto observation_array = infos["final_observation"];
-                for (const auto& obs : observation_array) {
-                    if (!obs.is_none()) 
-                        final_observations[i].copy_(rlop::pybind11_utils::ArrayToTensor(py::cast<py::array>(obs)));
-                    else if (terminations[i].item<bool>() || truncations[i].item<bool>())
-                        throw;
-                    ++i;
-                }
+                torch::Tensor copied = rlop::pybind11_utils::CopyArraysToTensor(infos["final_observation"], final_observations);
+                if (torch::logical_or(terminations, truncations).logical_and(copied.logical_not()).any().item<bool>())
+                    throw std::runtime_error("PPO: an episode ended without a final observation.");
             }
             return { 
                 observations, 
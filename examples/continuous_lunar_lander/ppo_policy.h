@@ -1,6 +1,7 @@
 #pragma once
 #include "rlop/rl/ppo/policy.h"
 #include "rlop/rl/distributions.h"
+#include "rlop/rl/ensemble.h"
 
 namespace continuous_lunar_lander {
     using rlop::Int;
@@ -48,7 +49,7 @@ namespace continuous_lunar_lander {
 
         torch::Tensor PredictActions(const torch::Tensor& observations, bool deterministic = false) override {
             torch::Tensor mean = PredictDist(observations);
-            rlop::DiagGaussian dist(mean, log_std_.exp());
+            rlop::DiagGaussian dist(mean, log_std_.exp(), log_std_);
             if (deterministic) 
                 return dist.Mode();
             else {
@@ -63,18 +64,16 @@ namespace continuous_lunar_lander {
 
         std::tuple<torch::Tensor, torch::Tensor, std::optional<torch::Tensor>> EvaluateActions(const torch::Tensor& observations, const torch::Tensor& actions) override {
             torch::Tensor mean = PredictDist(observations);
-            rlop::DiagGaussian dist(mean, log_std_.exp());
-            torch::Tensor log_prob = dist.LogProb(actions);
-            torch::Tensor entropy = dist.Entropy();
+            rlop::DiagGaussian dist(mean, log_std_.exp(), log_std_);
+            auto [ log_prob, entropy ] = dist.LogProbAndEntropy(actions);
             torch::Tensor values = PredictValues(observations);
             return { values, log_prob, { entropy } };
         }
 
         std::array<torch::Tensor, 3> Forward(const torch::Tensor& observations) override {
             torch::Tensor mean = PredictDist(observations);
-            rlop::DiagGaussian dist(mean, log_std_.exp());
-            torch::Tensor actions = dist.Sample();
-            torch::Tensor log_prob = dist.LogProb(actions);
+            rlop::DiagGaussian dist(mean, log_std_.exp(), log_std_);
+            auto [ actions, log_prob ] = dist.SampleAndLogProb();
             torch::Tensor values = PredictValues(observations);
             return { actions, values, log_prob };
         }
@@ -85,4 +84,61 @@ namespace continuous_lunar_lander {
         torch::nn::Linear action_net_, value_net_;
         torch::Tensor log_std_;
     };
+
+    // The policies of `num_seeds` seeds trained together, as stacked members of the same networks as PPOPolicy. The
+    // observations are those of the environments of the seeds, one seed after the other.
+    class EnsemblePPOPolicy : public rlop::PPOPolicy {
+    public:
+        EnsemblePPOPolicy(Int num_seeds, Int observation_size, Int action_dim) :
+            num_seeds_(num_seeds),
+            action_mlp_(std::make_shared<rlop::EnsembleMLP>(num_seeds, std::vector<Int>{ observation_size, 64, 64, action_dim })),
+            value_mlp_(std::make_shared<rlop::EnsembleMLP>(num_seeds, std::vector<Int>{ observation_size, 64, 64, 1 })),
+            log_std_(torch::zeros({ num_seeds, 1, action_dim }, torch::requires_grad(true)))
+        {
+            register_module("action_mlp", action_mlp_);
+            register_module("value_mlp", value_mlp_);
+            register_parameter("log_std", log_std_);
+        }
+
+        torch::Tensor PredictActions(const torch::Tensor& observations, bool deterministic = false) override {
+            auto [ mean, log_std ] = PredictDist(observations);
+            rlop::DiagGaussian dist(mean, log_std.exp(), log_std);
+            if (deterministic)
+                return dist.Mode();
+            return dist.Sample();
+        }
+
+        torch::Tensor PredictValues(const torch::Tensor& observations) override {
+            return value_mlp_->forward(observations).flatten();
+        }
+
+        std::tuple<torch::Tensor, torch::Tensor, std::optional<torch::Tensor>> EvaluateActions(const torch::Tensor& observations, const torch::Tensor& actions) override {
+            auto [ mean, log_std ] = PredictDist(observations);
+            rlop::DiagGaussian dist(mean, log_std.exp(), log_std);
+            auto [ log_prob, entropy ] = dist.LogProbAndEntropy(actions);
+            torch::Tensor values = PredictValues(observations);
+            return { values, log_prob, { entropy } };
+        }
+
+        std::array<torch::Tensor, 3> Forward(const torch::Tensor& observations) override {
+            auto [ mean, log_std ] = PredictDist(observations);
+            rlop::DiagGaussian dist(mean, log_std.exp(), log_std);
+            auto [ actions, log_prob ] = dist.SampleAndLogProb();
+            torch::Tensor values = PredictValues(observations);
+            return { actions, values, log_prob };
+        }
+
+    private:
+        // Returns the means of the actions and the log standard deviations of their seeds, expanded over the rows.
+        std::array<torch::Tensor, 2> PredictDist(const torch::Tensor& observations) {
+            torch::Tensor mean = action_mlp_->forward(observations);
+            torch::Tensor log_std = log_std_.expand({ num_seeds_, mean.size(0) / num_seeds_, mean.size(1) }).reshape({ -1, mean.size(1) });
+            return { mean, log_std };
+        }
+
+        Int num_seeds_;
+        std::shared_ptr<rlop::EnsembleMLP> action_mlp_;
+        std::shared_ptr<rlop::EnsembleMLP> value_mlp_;
+        torch::Tensor log_std_;
+    };
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 #include "rlop/rl/sac/policy.h"
 #include "rlop/rl/distributions.h"
+#include "rlop/rl/quantization.h"
 
 namespace continuous_lunar_lander {
     using rlop::Int;
@@ -38,48 +39,52 @@ namespace continuous_lunar_lander {
 
     class SACPolicy : public rlop::SACPolicy {
     public:
-        SACPolicy(Int observation_dim, Int action_dim, Int num_critics) :
+        // With `quantized`, the linear layers of the actor are QuantizedLinear, for the int8 copies of
+        // MakeQuantizedPolicy(). The critics stay float32.
+        SACPolicy(Int observation_dim, Int action_dim, Int num_critics, bool ensemble_critic = true, bool quantized = false) :
             observation_dim_(observation_dim),
             action_dim_(action_dim),
             num_critics_(num_critics),
+            ensemble_critic_(ensemble_critic),
             latent_pi_(
-                torch::nn::Linear(observation_dim, 256),
+                rlop::MakeLinear(observation_dim, 256, quantized),
                 torch::nn::ReLU(),
-                torch::nn::Linear(256, 256),
+                rlop::MakeLinear(256, 256, quantized),
                 torch::nn::ReLU()
             ),
-            mu_(torch::nn::Linear(256, action_dim)),
-            log_std_(torch::nn::Linear(256, action_dim))
+            mu_(rlop::MakeLinear(256, action_dim, quantized)),
+            log_std_(rlop::MakeLinear(256, action_dim, quantized))
         {
             register_module("latent_pi", latent_pi_);
-            register_module("mu", mu_);
-            register_module("log_std", log_std_);
+            register_module("mu", mu_.ptr());
+            register_module("log_std", log_std_.ptr());
         }
 
         std::shared_ptr<rlop::ContinuousQNet> MakeCritic() const override {
+            // The ensemble evaluates the critics in one forward, instead of one per critic.
+            if (ensemble_critic_)
+                return std::make_shared<rlop::EnsembleQNet>(num_critics_, observation_dim_ + action_dim_, std::vector<Int>{ kWidth, kWidth });
             return std::make_shared<SACCritic>(num_critics_, observation_dim_, action_dim_);
         }
 
         std::array<torch::Tensor, 2> PredictDist(const torch::Tensor& observations) {
             torch::Tensor y = latent_pi_->forward(observations);
-            torch::Tensor mean = mu_->forward(y);
-            torch::Tensor log_std = log_std_->forward(y);
+            torch::Tensor mean = mu_.forward(y);
+            torch::Tensor log_std = log_std_.forward(y);
             log_std = torch::clamp(log_std, kLogStdMin, kLogStdMax);
             return { mean, log_std };
         }
 
         std::array<torch::Tensor, 2> PredictLogProb(const torch::Tensor& observations) override {
             auto [ mean, log_std ] = PredictDist(observations);
-            rlop::SquashedDiagGaussian dist(mean, log_std.exp());
-            torch::Tensor gaussian_actions = dist.rlop::DiagGaussian::Sample();
-            torch::Tensor actions = torch::tanh(gaussian_actions);
-            torch::Tensor log_prob = dist.LogProb(actions, gaussian_actions);
+            rlop::SquashedDiagGaussian dist(mean, log_std.exp(), 1e-6, log_std);
+            auto [ actions, log_prob ] = dist.SampleAndLogProb();
             return { actions, log_prob };
         }
 
         torch::Tensor PredictActions(const torch::Tensor& observations, bool deterministic = false) override {
             auto [ mean, log_std ] = PredictDist(observations);
-            rlop::SquashedDiagGaussian dist(mean, log_std.exp());
+            rlop::SquashedDiagGaussian dist(mean, log_std.exp(), 1e-6, log_std);
             if (deterministic)
                 return dist.Mode();
             return dist.Sample();
@@ -87,10 +92,11 @@ namespace continuous_lunar_lander {
         
     private:
         torch::nn::Sequential latent_pi_;
-        torch::nn::Linear mu_{nullptr};
-        torch::nn::Linear log_std_{nullptr};
+        torch::nn::AnyModule mu_;
+        torch::nn::AnyModule log_std_;
         Int observation_dim_;
         Int action_dim_;
         Int num_critics_;
+        bool ensemble_critic_;
     };
 }
\ No newline at end of file
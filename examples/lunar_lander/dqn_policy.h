@@ -1,5 +1,6 @@
 #pragma once
 #include "rlop/rl/dqn/policy.h"
+#include "rlop/rl/quantization.h"
 
 namespace lunar_lander {
     using rlop::Int;
@@ -8,13 +9,13 @@ namespace lunar_lander {
 
     class QNet : public rlop::QNet {
     public:
-        QNet(Int observation_dim, Int num_actions) :
+        QNet(Int observation_dim, Int num_actions, bool quantized = false) :
             mlp_(
-                torch::nn::Linear(observation_dim, 64),
+                rlop::MakeLinear(observation_dim, 64, quantized),
                 torch::nn::ReLU(),
-                torch::nn::Linear(64, 64),
+                rlop::MakeLinear(64, 64, quantized),
                 torch::nn::ReLU(),
-                torch::nn::Linear(64, num_actions)
+                rlop::MakeLinear(64, num_actions, quantized)
             )
         {
             register_module("mlp", mlp_);
@@ -30,17 +31,20 @@ namespace lunar_lander {
 
     class DQNPolicy : public rlop::DQNPolicy {
     public:
-        DQNPolicy(Int observation_dim, Int num_actions) :
+        // With `quantized`, the linear layers are QuantizedLinear, for the int8 copies of MakeQuantizedPolicy().
+        DQNPolicy(Int observation_dim, Int num_actions, bool quantized = false) :
             observation_dim_(observation_dim),
-            num_actions_(num_actions)
+            num_actions_(num_actions),
+            quantized_(quantized)
         {}
 
         std::shared_ptr<rlop::QNet> MakeQNet() const override {
-            return std::make_shared<QNet>(observation_dim_, num_actions_);
+            return std::make_shared<QNet>(observation_dim_, num_actions_, quantized_);
         }
 
     private:
         Int observation_dim_;
         Int num_actions_;
+        bool quantized_;
     };
 }
\ No newline at end of file
@@ -23,7 +23,8 @@ namespace lunar_lander {
             double max_grad_norm,
             double target_kl,
             std::string output_path,
-            torch::Device device
+            torch::Device device,
+            Int num_env_groups = 1
         ) :
             rlop::PPO(
                 batch_size,
@@ -46,50 +47,95 @@ namespace lunar_lander {
             py::dict kwargs;
             if (render)
                 kwargs["render_mode"]  = "human";
-            env_ = rlop::GymVectorEnv("LunarLander-v2", num_envs, "async", kwargs);
+            // With several groups, the environments are split into groups of their own subprocesses, so that the
+            // policy runs on the observations of a group while the others step. A single group steps them all at once.
+            num_env_groups = std::clamp(num_env_groups, Int(1), num_envs);
+            for (Int group=0; group<num_env_groups; ++group) {
+                Int group_num_envs = num_envs * (group + 1) / num_env_groups - num_envs * group / num_env_groups;
+                env_groups_.emplace_back("LunarLander-v2", group_num_envs, "async", kwargs);
+            }
         }
 
         std::shared_ptr<rlop::RolloutBuffer> MakeRolloutBuffer() const override {
             return std::make_shared<rlop::RolloutBuffer>(
                 num_steps_, 
-                env_.num_envs(),
-                rlop::pybind11_utils::ArrayShapeToTensorSizes(env_.observation_shape()),
-                rlop::pybind11_utils::ArrayShapeToTensorSizes(env_.action_shape()),
-                rlop::pybind11_utils::ArrayDtypeToTensorDtype(env_.observation_dtype()),
-                rlop::pybind11_utils::ArrayDtypeToTensorDtype(env_.action_dtype())
+                NumEnvs(),
+                rlop::pybind11_utils::ArrayShapeToTensorSizes(env().observation_shape()),
+                rlop::pybind11_utils::ArrayShapeToTensorSizes(env().action_shape()),
+                rlop::pybind11_utils::ArrayDtypeToTensorDtype(env().observation_dtype()),
+                rlop::pybind11_utils::ArrayDtypeToTensorDtype(env().action_dtype())
             );
         }
 
         std::shared_ptr<rlop::PPOPolicy> MakePolicy() const override {
-            return std::make_shared<PPOPolicy>(rollout_buffer_->observation_sizes()[0], py::cast<Int>(env_.single_action_space().attr("n")));
+            return std::make_shared<PPOPolicy>(rollout_buffer_->observation_sizes()[0], py::cast<Int>(env().single_action_space().attr("n")));
         }
 
         Int NumEnvs() const override {
-            return env_.num_envs();
+            Int num_envs = 0;
+            for (const auto& env : env_groups_) {
+                num_envs += env.num_envs();
+            }
+            return num_envs;
+        }
+
+        Int NumEnvGroups() const override {
+            return env_groups_.size();
+        }
+
+        // Collects the rollouts without the GIL, which the calls into Python take back, so that other threads run
+        // Python while the policy runs.
+        void CollectRollouts() override {
+            py::gil_scoped_release release;
+            rlop::PPO::CollectRollouts();
         }
 
         torch::Tensor ResetEnv() override {
-            auto [observations, info] = env_.Reset();
-            return rlop::pybind11_utils::ArrayToTensor(py::cast<py::array>(observations));
+            py::gil_scoped_acquire gil;
+            std::vector<torch::Tensor> observations;
+            for (auto& env : env_groups_) {
+                auto [group_observations, info] = env.Reset();
+                observations.push_back(rlop::pybind11_utils::ArrayToTensorView(py::cast<py::array>(group_observations)));
+            }
+            return observations.size() == 1 ? observations[0] : torch::cat(observations);
         }
 
         std::array<torch::Tensor, 5> Step(const torch::Tensor& actions) override {
-            auto [observation_py, rewards_array, termination_array, truncation_array, infos] = env_.Step(rlop::pybind11_utils::TensorToArray(actions)); 
-            torch::Tensor observations = rlop::pybind11_utils::ArrayToTensor(py::cast<py::array>(observation_py));
-            torch::Tensor rewards = rlop::pybind11_utils::ArrayToTensor(rewards_array);
-            torch::Tensor terminations = rlop::pybind11_utils::ArrayToTensor(termination_array);
-            torch::Tensor truncations = rlop::pybind11_utils::ArrayToTensor(truncation_array);
+            for (Int group=0; group<NumEnvGroups(); ++group) {
+                StepAsync(group, actions.slice(0, GroupBegin(group), GroupBegin(group + 1)));
+            }
+            std::array<std::vector<torch::Tensor>, 5> group_results;
+            for (Int group=0; group<NumEnvGroups(); ++group) {
+                auto results = StepWait(group);
+                for (Int i=0; i<5; ++i) {
+                    group_results[i].push_back(results[i]);
+                }
+            }
+            std::array<torch::Tensor, 5> results;
+            for (Int i=0; i<5; ++i) {
+                results[i] = group_results[i].size() == 1 ? group_results[i][0] : torch::cat(group_results[i]);
+            }
+            return results;
+        }
+
+        void StepAsync(Int group, const torch::Tensor& actions) override {
+            py::gil_scoped_acquire gil;
+            env_groups_[group].StepAsync(rlop::pybind11_utils::TensorToArray(actions));
+        }
+
+        std::array<torch::Tensor, 5> StepWait(Int group) override {
+            py::gil_scoped_acquire gil;
+            auto [observation_py, rewards_array, termination_array, truncation_array, infos] = env_groups_[group].StepWait(); 
+            // The arrays returned by the step are fresh, so the tensors view them instead of copying them.
+            torch::Tensor observations = rlop::pybind11_utils::ArrayToTensorView(py::cast<py::array>(observation_py));
+            torch::Tensor rewards = rlop::pybind11_utils::ArrayToTensorView(rewards_array);
+            torch::Tensor terminations = rlop::pybind11_utils::ArrayToTensorView(termination_array);
+            torch::Tensor truncations = rlop::pybind11_utils::ArrayToTensorView(truncation_array);
             torch::Tensor final_observations = torch::zeros_like(observations);
             if (infos.contains("final_observation")) {
-                int i=0;
-                auto observation_array = infos["final_observation"];
-                for (const auto& obs : observation_array) {
-                    if (!obs.is_none()) 
-                        final_observations[i].copy_(rlop::pybind11_utils::ArrayToTensor(py::cast<py::array>(obs)));
-                    else if (terminations[i].item<bool>() || truncations[i].item<bool>())
-                        throw;
-                    ++i;
-                }
+                torch::Tensor copied = rlop::pybind11_utils::CopyArraysToTensor(infos["final_observation"], final_observations);
+                if (torch::logical_or(terminations, truncations).logical_and(copied.logical_not()).any().item<bool>())
+                    throw std::runtime_error("PPO: an episode ended without a final observation.");
             }
             return { 
                 observations, 
@@ -100,12 +146,17 @@ namespace lunar_lander {
             };
         }
 
-        const rlop::GymVectorEnv& env() const {
-            return env_;
+        const rlop::GymVectorEnv& env(Int group = 0) const {
+            return env_groups_[group];
         }
 
     protected:
-        rlop::GymVectorEnv env_;
+        // Returns the index of the first environment of a group.
+        Int GroupBegin(Int group) const {
+            return NumEnvs() * group / NumEnvGroups();
+        }
+
+        std::vector<rlop::GymVectorEnv> env_groups_;
         Int num_steps_;
     };
 }
\ No newline at end of file
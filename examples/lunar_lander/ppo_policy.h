@@ -1,6 +1,7 @@
 #pragma once
 #include "rlop/rl/ppo/policy.h"
 #include "rlop/rl/distributions.h"
+#include "rlop/rl/quantization.h"
 
 namespace lunar_lander {
     using rlop::Int;
@@ -9,39 +10,40 @@ namespace lunar_lander {
 
     class PPOPolicy : public rlop::PPOPolicy {
     public:
-        PPOPolicy(Int observation_dim, Int num_actions) :
+        // With `quantized`, the linear layers are QuantizedLinear, for the int8 copies of MakeQuantizedPolicy().
+        PPOPolicy(Int observation_dim, Int num_actions, bool quantized = false) :
             action_mlp_(
-                torch::nn::Linear(observation_dim, 64),
+                rlop::MakeLinear(observation_dim, 64, quantized),
                 torch::nn::Tanh(),
-                torch::nn::Linear(64, 64),
+                rlop::MakeLinear(64, 64, quantized),
                 torch::nn::Tanh()
             ),
             value_mlp_(
-                torch::nn::Linear(observation_dim, 64),
+                rlop::MakeLinear(observation_dim, 64, quantized),
                 torch::nn::Tanh(),
-                torch::nn::Linear(64, 64),
+                rlop::MakeLinear(64, 64, quantized),
                 torch::nn::Tanh()
             ),
-            action_net_(torch::nn::Linear(64, num_actions)),
-            value_net_(torch::nn::Linear(64, 1))
+            action_net_(rlop::MakeLinear(64, num_actions, quantized)),
+            value_net_(rlop::MakeLinear(64, 1, quantized))
         {
             register_module("action_mlp", action_mlp_);
             register_module("value_mlp", value_mlp_);
-            register_module("action_net", action_net_);
-            register_module("value_net", value_net_);
+            register_module("action_net", action_net_.ptr());
+            register_module("value_net", value_net_.ptr());
         }
 
         void Reset() override {
             rlop::PPOPolicy::Reset();
             action_mlp_->apply([](torch::nn::Module& module){ rlop::PPOPolicy::InitWeights(&module, std::sqrt(2.0)); });
             value_mlp_->apply([](torch::nn::Module& module){ rlop::PPOPolicy::InitWeights(&module, std::sqrt(2.0)); });
-            action_net_->apply([](torch::nn::Module& module){ rlop::PPOPolicy::InitWeights(&module, 0.01); });
-            value_net_->apply([](torch::nn::Module& module){ rlop::PPOPolicy::InitWeights(&module, 1.0); });
+            action_net_.ptr()->apply([](torch::nn::Module& module){ rlop::PPOPolicy::InitWeights(&module, 0.01); });
+            value_net_.ptr()->apply([](torch::nn::Module& module){ rlop::PPOPolicy::InitWeights(&module, 1.0); });
         }
 
         torch::Tensor PredictActionLogits(const torch::Tensor& observations) {
             torch::Tensor latent_pi = action_mlp_->forward(observations);
-            return action_net_->forward(latent_pi);
+            return action_net_.forward(latent_pi);
         }
 
         torch::Tensor PredictActions(const torch::Tensor& observations, bool deterministic = false) override {
@@ -55,30 +57,28 @@ namespace lunar_lander {
 
         torch::Tensor PredictValues(const torch::Tensor& observations) override {
             torch::Tensor latent_pi = value_mlp_->forward(observations);
-            return value_net_->forward(latent_pi).flatten();
+            return value_net_.forward(latent_pi).flatten();
         }
 
         std::tuple<torch::Tensor, torch::Tensor, std::optional<torch::Tensor>> EvaluateActions(const torch::Tensor& observations, const torch::Tensor& actions) override {
             torch::Tensor logits = PredictActionLogits(observations);
             torch::Tensor values = PredictValues(observations);
             rlop::Categorical dist(logits);
-            torch::Tensor log_prob = dist.LogProb(actions);
-            torch::Tensor entropy = dist.Entropy();
+            auto [ log_prob, entropy ] = dist.LogProbAndEntropy(actions);
             return { values, log_prob, { entropy } };
         }
 
         std::array<torch::Tensor, 3> Forward(const torch::Tensor& observations) override {
             torch::Tensor logits = PredictActionLogits(observations);
             rlop::Categorical dist(logits);
-            torch::Tensor actions = dist.Sample();
+            auto [ actions, log_prob ] = dist.SampleAndLogProb();
             torch::Tensor values = PredictValues(observations);
-            torch::Tensor log_prob = dist.LogProb(actions);
             return { actions, values, log_prob };
         }
 
     private:
         torch::nn::Sequential action_mlp_;
         torch::nn::Sequential value_mlp_;
-        torch::nn::Linear action_net_, value_net_;
+        torch::nn::AnyModule action_net_, value_net_;
     };
 }
\ No newline at end of file
@@ -0,0 +1,381 @@
+#pragma once
+#include "problems/multi_armed_bandit/batched_problem.h"
+#include "rlop/common/base_algorithm.h"
+
+namespace multi_armed_bandit {
+    // The batched counterpart of BaseSolver, which solves the instances of a BatchedProblem together. The Q-values
+    // and the visit counts are stored as the means of BatchedProblem, at arm * num_instances() + instance, and each
+    // selection is a few loops over the arms of loops over the instances. The recorded total rewards and numbers of
+    // optimal pulls of each step are the sums over the instances.
+    class BatchedSolver : public rlop::BaseAlgorithm {
+    public:
+        BatchedSolver(const std::string& name, Int num_instances, Int num_arms, double alpha = 0) :
+            name_(name),
+            problem_(num_instances, num_arms),
+            alpha_(alpha)
+        {}
+
+        virtual ~BatchedSolver() = default;
+
+        // Pure virtual function to select the arm of each instance.
+        //
+        // Parameters:
+        //   actions: The arm selected in each instance, of size num_instances().
+        virtual void Select(std::vector<Int>& actions) = 0;
+
+        virtual void Reset() override {
+            problem_.Reset();
+            Int size = problem_.num_arms() * problem_.num_instances();
+            q_values_.assign(size, 0);
+            num_visits_.assign(size, 0);
+            actions_.assign(problem_.num_instances(), 0);
+        }
+
+        // Resets the solver and the problem with seeds derived from one seed, so that the runs are reproducible.
+        virtual void Reset(uint64_t seed) {
+            rand_.Seed(seed);
+            problem_.Seed(seed + 1);
+            Reset();
+        }
+
+        virtual void Solve(Int max_num_steps) {
+            num_steps_ = 0;
+            max_num_steps_ = max_num_steps;
+            total_rewards_ = std::vector<double>(max_num_steps, 0);
+            num_opts_ = std::vector<Int>(max_num_steps, 0);
+            while (Proceed()) {
+                Step();
+                Update();
+            }
+        }
+
+        virtual bool Proceed() {
+            return num_steps_ < max_num_steps_;
+        }
+
+        virtual void Update() {
+            ++num_steps_;
+        }
+
+        virtual void Step() {
+            Select(actions_);
+            problem_.Step(actions_, rewards_);
+            UpdateQValues();
+            const auto& total_rewards = problem_.total_rewards();
+            const auto& best_arms = problem_.best_arms();
+            double total_reward = 0;
+            Int num_opts = 0;
+            for (Int b=0; b<num_instances(); ++b) {
+                total_reward += total_rewards[b];
+                num_opts += actions_[b] == best_arms[b];
+            }
+            total_rewards_[num_steps_] = total_reward;
+            num_opts_[num_steps_] = num_opts;
+        }
+
+        // Updates the Q-values of the pulled arms as BaseSolver::UpdateQValue() does.
+        virtual void UpdateQValues() {
+            Int num_instances = problem_.num_instances();
+            #pragma omp simd
+            for (Int b=0; b<num_instances; ++b) {
+                Int i = actions_[b] * num_instances + b;
+                ++num_visits_[i];
+                double step_size = alpha_ > 0 ? alpha_ : 1.0 / (num_visits_[i] + 1);
+                q_values_[i] += (rewards_[b] - q_values_[i]) * step_size;
+            }
+        }
+
+        const std::string& name() const {
+            return name_;
+        }
+
+        Int num_instances() const {
+            return problem_.num_instances();
+        }
+
+        Int num_steps() const {
+            return num_steps_;
+        }
+
+        const std::vector<double>& total_rewards() const {
+            return total_rewards_;
+        }
+
+        const std::vector<Int>& num_opts() const {
+            return num_opts_;
+        }
+
+        const std::vector<double>& q_values() const {
+            return q_values_;
+        }
+
+    protected:
+        // Selects the arm of the highest score of each instance, the first one on ties.
+        void SelectBest(const std::vector<double>& scores, std::vector<Int>& actions) {
+            Int num_instances = problem_.num_instances();
+            best_scores_.assign(num_instances, std::numeric_limits<double>::lowest());
+            std::fill(actions.begin(), actions.end(), 0);
+            for (Int a=0; a<problem_.num_arms(); ++a) {
+                const double* arm_scores = &scores[a * num_instances];
+                #pragma omp simd
+                for (Int b=0; b<num_instances; ++b) {
+                    Int better = arm_scores[b] > best_scores_[b];
+                    best_scores_[b] = std::max(best_scores_[b], arm_scores[b]);
+                    actions[b] += better * (a - actions[b]);
+                }
+            }
+        }
+
+        // Samples the arm of each instance with probabilities proportional to the weights, as the number of arms
+        // whose cumulative weight is below a uniform draw scaled by the total weight.
+        void SelectDiscrete(const std::vector<double>& weights, std::vector<Int>& actions) {
+            Int num_instances = problem_.num_instances();
+            Int num_arms = problem_.num_arms();
+            targets_.assign(num_instances, 0);
+            for (Int a=0; a<num_arms; ++a) {
+                const double* arm_weights = &weights[a * num_instances];
+                #pragma omp simd
+                for (Int b=0; b<num_instances; ++b)
+                    targets_[b] += arm_weights[b];
+            }
+            uniforms_.resize(num_instances);
+            rand_.FillUniform(uniforms_.begin(), uniforms_.end());
+            #pragma omp simd
+            for (Int b=0; b<num_instances; ++b)
+                targets_[b] *= uniforms_[b];
+            cumulative_weights_.assign(num_instances, 0);
+            std::fill(actions.begin(), actions.end(), 0);
+            for (Int a=0; a<num_arms-1; ++a) {
+                const double* arm_weights = &weights[a * num_instances];
+                #pragma omp simd
+                for (Int b=0; b<num_instances; ++b) {
+                    cumulative_weights_[b] += arm_weights[b];
+                    actions[b] += cumulative_weights_[b] <= targets_[b];
+                }
+            }
+        }
+
+        // Replaces the selected arm of each instance by a uniformly random one with probability epsilon. A uniform
+        // draw below epsilon, divided by epsilon, is again uniform and draws the random arm.
+        void Explore(double epsilon, std::vector<Int>& actions) {
+            Int num_instances = problem_.num_instances();
+            Int num_arms = problem_.num_arms();
+            uniforms_.resize(num_instances);
+            rand_.FillUniform(uniforms_.begin(), uniforms_.end());
+            #pragma omp simd
+            for (Int b=0; b<num_instances; ++b) {
+                Int random_arm = std::min<Int>(uniforms_[b] / epsilon * num_arms, num_arms - 1);
+                actions[b] += (uniforms_[b] < epsilon) * (random_arm - actions[b]);
+            }
+        }
+
+        std::string name_;
+        BatchedProblem problem_;
+        Int num_steps_ = 0;
+        Int max_num_steps_ = 0;
+        double alpha_;
+        std::vector<double> q_values_;
+        std::vector<Int> num_visits_;
+        std::vector<Int> actions_;
+        std::vector<double> rewards_;
+        std::vector<double> total_rewards_;
+        std::vector<Int> num_opts_;
+        std::vector<double> best_scores_;
+        std::vector<double> targets_;
+        std::vector<double> cumulative_weights_;
+        std::vector<double> uniforms_;
+        rlop::Random rand_;
+    };
+
+    class BatchedEpsilonGreedySolver : public BatchedSolver {
+    public:
+        BatchedEpsilonGreedySolver(const std::string& name, Int num_instances, Int num_arms, double epsilon = 0.1, double alpha = 0) :
+            BatchedSolver(name, num_instances, num_arms, alpha),
+            epsilon_(epsilon)
+        {}
+
+        virtual ~BatchedEpsilonGreedySolver() = default;
+
+        virtual void Select(std::vector<Int>& actions) override {
+            SelectBest(q_values_, actions);
+            Explore(epsilon_, actions);
+        }
+
+    protected:
+        double epsilon_;
+    };
+
+    class BatchedSoftmaxSolver : public BatchedSolver {
+    public:
+        BatchedSoftmaxSolver(const std::string& name, Int num_instances, Int num_arms, double temp = 1.0, double alpha = 0) :
+            BatchedSolver(name, num_instances, num_arms, alpha),
+            temp_(temp)
+        {}
+
+        virtual ~BatchedSoftmaxSolver() = default;
+
+        using BatchedSolver::Reset;
+
+        virtual void Reset() override {
+            BatchedSolver::Reset();
+            weights_.assign(q_values_.size(), 1);
+            shifts_.assign(problem_.num_instances(), 0);
+            shift_arms_.assign(problem_.num_instances(), 0);
+        }
+
+        // Samples from the softmax of the Q-values of each instance, whose weights are kept by UpdateQValues().
+        virtual void Select(std::vector<Int>& actions) override {
+            SelectDiscrete(weights_, actions);
+        }
+
+        // Updates the weight exp((q - shift) / temp) of each pulled arm. The shift of an instance is the maximum
+        // Q-value at its last rebase, which only has to keep the exponents of the instance bounded above and that of
+        // the arm of the shift bounded below, so that the weights neither overflow nor all underflow. The instance
+        // is rebased when an exponent leaves these bounds, and otherwise one exponential is computed per instance.
+        virtual void UpdateQValues() override {
+            BatchedSolver::UpdateQValues();
+            Int num_instances = problem_.num_instances();
+            for (Int b=0; b<num_instances; ++b) {
+                Int i = actions_[b] * num_instances + b;
+                double exponent = (q_values_[i] - shifts_[b]) / temp_;
+                if (exponent > kMaxExponent || (actions_[b] == shift_arms_[b] && exponent < -kMaxExponent))
+                    Rebase(b);
+                else
+                    weights_[i] = std::exp(exponent);
+            }
+        }
+
+    protected:
+        static constexpr double kMaxExponent = 300;
+
+        // Shifts the exponents of an instance by its maximum Q-value and recomputes its weights.
+        void Rebase(Int instance) {
+            Int num_instances = problem_.num_instances();
+            Int num_arms = problem_.num_arms();
+            for (Int a=0; a<num_arms; ++a) {
+                if (a == 0 || q_values_[a * num_instances + instance] > shifts_[instance]) {
+                    shifts_[instance] = q_values_[a * num_instances + instance];
+                    shift_arms_[instance] = a;
+                }
+            }
+            for (Int a=0; a<num_arms; ++a) {
+                Int i = a * num_instances + instance;
+                weights_[i] = std::exp((q_values_[i] - shifts_[instance]) / temp_);
+            }
+        }
+
+        double temp_;
+        std::vector<double> weights_;
+        std::vector<double> shifts_;
+        std::vector<Int> shift_arms_;
+    };
+
+    class BatchedUCB1Solver : public BatchedSolver {
+    public:
+        BatchedUCB1Solver(const std::string& name, Int num_instances, Int num_arms, double c = std::sqrt(2), double alpha = 0) :
+            BatchedSolver(name, num_instances, num_arms, alpha),
+            c_(c)
+        {}
+
+        virtual ~BatchedUCB1Solver() = default;
+
+        using BatchedSolver::Reset;
+
+        virtual void Reset() override {
+            BatchedSolver::Reset();
+            inv_sqrt_visits_.assign(q_values_.size(), 0);
+        }
+
+        // Selects the arm of the highest rlop::UCB1() score of each instance. The exploration bonus is the product
+        // of a factor of the step and of the inverse square root of the visits, kept for each arm, so that scoring
+        // the arms is a multiply-add.
+        virtual void Select(std::vector<Int>& actions) override {
+            scores_.resize(q_values_.size());
+            double factor = c_ * std::sqrt(std::log(num_steps_));
+            #pragma omp simd
+            // An unvisited arm has a Q-value and an inverse square root of 0, and scores the maximum.
+            for (Int i=0; i<scores_.size(); ++i) {
+                double unvisited = inv_sqrt_visits_[i] == 0;
+                scores_[i] = q_values_[i] + factor * inv_sqrt_visits_[i] + unvisited * std::numeric_limits<double>::max();
+            }
+            SelectBest(scores_, actions);
+        }
+
+        virtual void UpdateQValues() override {
+            BatchedSolver::UpdateQValues();
+            Int num_instances = problem_.num_instances();
+            #pragma omp simd
+            for (Int b=0; b<num_instances; ++b) {
+                Int i = actions_[b] * num_instances + b;
+                inv_sqrt_visits_[i] = 1.0 / std::sqrt(num_visits_[i]);
+            }
+        }
+
+    protected:
+        double c_;
+        std::vector<double> scores_;
+        std::vector<double> inv_sqrt_visits_; // The inverse square root of the visits of each arm, 0 if unvisited.
+    };
+
+    class BatchedPersuitSolver : public BatchedSolver {
+    public:
+        BatchedPersuitSolver(const std::string& name, Int num_instances, Int num_arms, double beta = 0.01, double alpha = 0) :
+            BatchedSolver(name, num_instances, num_arms, alpha),
+            beta_(beta)
+        {}
+
+        virtual ~BatchedPersuitSolver() = default;
+
+        using BatchedSolver::Reset;
+
+        virtual void Reset() override {
+            BatchedSolver::Reset();
+            prefs_.assign(q_values_.size(), 1.0 / problem_.num_arms());
+            greedy_actions_.assign(problem_.num_instances(), 0);
+        }
+
+        virtual void Select(std::vector<Int>& actions) override {
+            SelectDiscrete(prefs_, actions);
+        }
+
+        // Moves the preferences of each instance towards its greedy arm, as PersuitSolver::UpdatePrefs() does.
+        virtual void UpdatePrefs() {
+            Int num_instances = problem_.num_instances();
+            SelectBest(q_values_, greedy_actions_);
+            for (Int a=0; a<problem_.num_arms(); ++a) {
+                double* prefs = &prefs_[a * num_instances];
+                #pragma omp simd
+                for (Int b=0; b<num_instances; ++b)
+                    prefs[b] += beta_ * ((greedy_actions_[b] == a) - prefs[b]);
+            }
+        }
+
+        virtual void Update() override {
+            UpdatePrefs();
+            ++num_steps_;
+        }
+
+    protected:
+        double beta_;
+        std::vector<double> prefs_;
+        std::vector<Int> greedy_actions_;
+    };
+
+    class BatchedPursuitEpsilonGreedySolver : public BatchedPersuitSolver {
+    public:
+        BatchedPursuitEpsilonGreedySolver(const std::string& name, Int num_instances, Int num_arms, double epsilon = 0.1, double beta = 0.01, double alpha = 0) :
+            BatchedPersuitSolver(name, num_instances, num_arms, beta, alpha),
+            epsilon_(epsilon)
+        {}
+
+        virtual ~BatchedPursuitEpsilonGreedySolver() = default;
+
+        virtual void Select(std::vector<Int>& actions) override {
+            SelectBest(prefs_, actions);
+            Explore(epsilon_, actions);
+        }
+
+    protected:
+        double epsilon_;
+    };
+}
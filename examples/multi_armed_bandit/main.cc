@@ -1,13 +1,17 @@
 #include "solvers.h"
+#include "batched_solvers.h"
 #include "rlop/common/timer.h"
 
-int main() {
+// Usage: multi_armed_bandit [num_arms] [num_experiments] [max_num_steps]
+//   The defaults are 10 arms, 2000 experiments and 1000 steps. The batched solvers keep num_arms * num_experiments
+//   values per array, so large action sets call for fewer experiments.
+int main(int argc, char *argv[]) {
     using namespace multi_armed_bandit;
 
     rlop::Timer timer;
-    Int num_experiments = 2000;
-    Int num_arms = 10;
-    Int max_num_steps = 1000;
+    Int num_arms = argc > 1 ? std::stoll(argv[1]) : 10;
+    Int num_experiments = argc > 2 ? std::stoll(argv[2]) : 2000;
+    Int max_num_steps = argc > 3 ? std::stoll(argv[3]) : 1000;
     
     std::vector<BaseSolver*> solvers;
     solvers.push_back(new EpsilonGreedySolver("epsilon_greedy", num_arms));
@@ -33,6 +37,22 @@ int main() {
         std::cout << solvers[i]->name() + ": " << timer.duration() << "ms" << std::endl;
     }
 
+    std::vector<BatchedSolver*> batched_solvers;
+    batched_solvers.push_back(new BatchedEpsilonGreedySolver("epsilon_greedy", num_experiments, num_arms));
+    batched_solvers.push_back(new BatchedSoftmaxSolver("softmax", num_experiments, num_arms));
+    batched_solvers.push_back(new BatchedUCB1Solver("ucb1", num_experiments, num_arms));
+    batched_solvers.push_back(new BatchedPersuitSolver("persuit", num_experiments, num_arms));
+    batched_solvers.push_back(new BatchedPursuitEpsilonGreedySolver("persuit_epsilon_greedy", num_experiments, num_arms));
+
+    for (Int i=0; i<batched_solvers.size(); ++i) {
+        timer.Restart();
+        batched_solvers[i]->Reset();
+        batched_solvers[i]->Solve(max_num_steps);
+        timer.Stop();
+        std::cout << batched_solvers[i]->name() + " (batched): " << timer.duration() << "ms, optimal rate at the last step: "
+                  << batched_solvers[i]->num_opts().back() / (double)num_experiments << std::endl;
+    }
+
     std::ofstream out("reward_results.txt");
     out << "num_steps";
     for (Int i=0; i<solvers.size(); ++i) {
@@ -64,6 +84,9 @@ int main() {
     for (auto ptr : solvers) {
         delete ptr;
     }
+    for (auto ptr : batched_solvers) {
+        delete ptr;
+    }
 
     return 0;
 }
\ No newline at end of file
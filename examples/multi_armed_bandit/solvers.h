@@ -2,6 +2,8 @@
 #include "problems/multi_armed_bandit/problem.h"
 #include "rlop/common/base_algorithm.h"
 #include "rlop/common/selectors.h"
+#include "rlop/common/sum_tree.h"
+#include "rlop/common/max_tree.h"
  
 namespace multi_armed_bandit {
     class BaseSolver : public rlop::BaseAlgorithm {
@@ -20,6 +22,7 @@ namespace multi_armed_bandit {
             problem_.Reset();
             q_values_ = std::vector<double>(problem_.num_arms(), 0);
             num_visits_ = std::vector<Int>(problem_.num_arms(), 0);
+            best_q_values_.Reset(problem_.num_arms(), 0);
         }
 
         virtual void Solve(Int max_num_steps) {
@@ -47,6 +50,7 @@ namespace multi_armed_bandit {
                 q_values_[i] += (reward - q_values_[i]) * alpha_;
             else
                 q_values_[i] += (reward - q_values_[i]) / (num_visits_[i] + 1);    
+            best_q_values_.Set(i, q_values_[i]);
         }
 
         virtual bool Step() {
@@ -85,6 +89,7 @@ namespace multi_armed_bandit {
         double alpha_;
         std::vector<double> q_values_;
         std::vector<Int> num_visits_;
+        rlop::MaxTree<double> best_q_values_; // The greedy arm in O(log n) per update of a Q-value.
         std::vector<double> total_rewards_;
         std::vector<Int> num_opts_;
         rlop::Random rand_;
@@ -100,8 +105,10 @@ namespace multi_armed_bandit {
         virtual ~EpsilonGreedySolver() = default;
 
         virtual std::optional<Int> Select() override {
+            if (problem_.NumActions() == 0)
+                return std::nullopt;
             if (rand_.Uniform(0.0, 1.0) >= epsilon_)
-                return rlop::SelectBest(q_values_.begin(), q_values_.end());
+                return { best_q_values_.best() };
             else
                 return { rand_.Uniform(Int(0), problem_.NumActions() - 1) };
         }    
@@ -119,16 +126,49 @@ namespace multi_armed_bandit {
 
         virtual ~SoftmaxSolver() = default;
 
+        virtual void Reset() override {
+            BaseSolver::Reset();
+            weights_.Reset(problem_.num_arms(), 1);
+            shift_ = 0;
+            shift_arm_ = 0;
+        }
+
+        // Samples from the softmax of the Q-values, whose weights exp((q - shift) / temp) are kept in a sum tree by
+        // UpdateQValue(), so that a draw costs O(log n).
         virtual std::optional<Int> Select() override {
-            auto probs = rlop::Softmax(q_values_.begin(), q_values_.end(), temp_);
-            if (probs.empty())
+            if (weights_.size() == 0)
                 return std::nullopt;
-            Int i = rand_.Discrete<Int>(probs.begin(), probs.end());
-            return { i };
-        }    
+            return { weights_.Find(rand_.Uniform(0.0, weights_.total())) };
+        }
+
+        // Updates the weight of the arm. The shift is the Q-value of an arm at the last rebase, and the weights are
+        // rebased on the highest Q-value when an exponent would overflow or that of the arm of the shift would
+        // underflow, so that the weights stay finite and not all zero.
+        virtual void UpdateQValue(Int i, double reward) override {
+            BaseSolver::UpdateQValue(i, reward);
+            double exponent = (q_values_[i] - shift_) / temp_;
+            if (exponent > kMaxExponent || (i == shift_arm_ && exponent < -kMaxExponent))
+                Rebase();
+            else
+                weights_.Set(i, std::exp(exponent));
+        }
 
     protected:
+        void Rebase() {
+            shift_arm_ = best_q_values_.best();
+            shift_ = q_values_[shift_arm_];
+            std::vector<double> weights(q_values_.size());
+            for (Int i=0; i<weights.size(); ++i)
+                weights[i] = std::exp((q_values_[i] - shift_) / temp_);
+            weights_.Assign(weights.begin(), weights.end());
+        }
+
+        static constexpr double kMaxExponent = 300;
+
         double temp_;
+        rlop::SumTree<double> weights_;
+        double shift_ = 0;
+        Int shift_arm_ = 0;
     };
 
     class UCB1Solver : public BaseSolver {
@@ -140,16 +180,65 @@ namespace multi_armed_bandit {
 
         virtual ~UCB1Solver() = default;
 
+        virtual void Reset() override {
+            BaseSolver::Reset();
+            horizon_ = 2;
+            bounds_.Reset(problem_.num_arms(), std::numeric_limits<double>::max());
+        }
+
+        // Selects the arm of the highest rlop::UCB1() score. The scores grow with the number of steps, so the tree
+        // keeps the scores at a horizon a little past the current step, which bound them from above until the
+        // number of steps passes the horizon. The arms are taken by decreasing bounds and scored until the best
+        // score is no lower than the next bound, which usually takes a few arms. The bounds are refreshed in O(n)
+        // when the horizon is passed, which happens once every growth of the steps by 1 / kHorizonDivisor.
         virtual std::optional<Int> Select() override {
-            std::vector<double> scores(problem_.NumActions());
-            for (Int i=0; i<scores.size(); ++i) {
-                scores[i] = rlop::UCB1(q_values_[i], num_visits_[i], num_steps_, c_);
+            if (bounds_.size() == 0)
+                return std::nullopt;
+            if (num_steps_ > horizon_) {
+                horizon_ = num_steps_ + num_steps_ / kHorizonDivisor + 1;
+                scored_bounds_.resize(bounds_.size());
+                for (Int i=0; i<bounds_.size(); ++i)
+                    scored_bounds_[i] = GetBound(i);
+                bounds_.Assign(scored_bounds_.begin(), scored_bounds_.end());
+                scored_bounds_.clear();
             }
-            return rlop::SelectBest(scores.begin(), scores.end());
-        }    
+            Int best = kIntNull;
+            double best_score = std::numeric_limits<double>::lowest();
+            scored_.clear();
+            while (scored_.size() < bounds_.size() && (best == kIntNull || bounds_.max() > best_score)) {
+                Int i = bounds_.best();
+                double score = rlop::UCB1(q_values_[i], num_visits_[i], num_steps_, c_);
+                if (score > best_score || (score == best_score && i < best)) {
+                    best = i;
+                    best_score = score;
+                }
+                scored_.push_back(i);
+                scored_bounds_.push_back(bounds_.Get(i));
+                bounds_.Set(i, std::numeric_limits<double>::lowest());
+            }
+            for (Int j=0; j<scored_.size(); ++j)
+                bounds_.Set(scored_[j], scored_bounds_[j]);
+            scored_bounds_.clear();
+            return { best };
+        }
+
+        virtual void UpdateQValue(Int i, double reward) override {
+            BaseSolver::UpdateQValue(i, reward);
+            bounds_.Set(i, GetBound(i));
+        }
 
     protected:
+        double GetBound(Int i) const {
+            return rlop::UCB1(q_values_[i], num_visits_[i], horizon_, c_);
+        }
+
+        static constexpr Int kHorizonDivisor = 16;
+
         double c_;
+        Int horizon_ = 2;
+        rlop::MaxTree<double> bounds_;
+        std::vector<Int> scored_;
+        std::vector<double> scored_bounds_;
     };
 
     class PersuitSolver : public BaseSolver {
@@ -161,23 +250,36 @@ namespace multi_armed_bandit {
 
         virtual void Reset() override {
             BaseSolver::Reset();    
-            prefs_ = std::vector<double>(problem_.num_arms(), 1.0 / problem_.num_arms());
+            prefs_.Reset(problem_.num_arms(), 1.0 / problem_.num_arms());
+            best_prefs_.Reset(problem_.num_arms(), 1.0 / problem_.num_arms());
+            pref_scale_ = 1;
         }
 
         virtual std::optional<Int> Select() override {
-            Int i = rand_.Discrete<Int>(prefs_.begin(), prefs_.end());
-            return { i };
+            if (prefs_.size() == 0)
+                return std::nullopt;
+            return { prefs_.Find(rand_.Uniform(0.0, prefs_.total())) };
         }
 
+        // Moves the preferences towards the greedy arm. The preferences are kept as weights times a common scale,
+        // so that shrinking all of them is a product by the scale and only the weight of the greedy arm is updated,
+        // in O(log n). The weights are rescaled before the scale underflows.
         virtual void UpdatePrefs() {
-            auto max_q = std::max_element(q_values_.begin(), q_values_.end());
-            Int best_i = std::distance(q_values_.begin(), max_q);
-            for (Int i=0; i<prefs_.size(); ++i) {
-                if (i == best_i)
-                    prefs_[i] += beta_ * (1 - prefs_[i]);
-                else 
-                    prefs_[i] += beta_ * (0 - prefs_[i]);
+            if (prefs_.size() == 0)
+                return;
+            Int best_i = best_q_values_.best();
+            pref_scale_ *= 1 - beta_;
+            if (pref_scale_ < kMinPrefScale) {
+                std::vector<double> prefs(prefs_.weights());
+                for (auto& pref : prefs)
+                    pref *= pref_scale_;
+                prefs_.Assign(prefs.begin(), prefs.end());
+                best_prefs_.Assign(prefs.begin(), prefs.end());
+                pref_scale_ = 1;
             }
+            double pref = prefs_.Get(best_i) + beta_ / pref_scale_;
+            prefs_.Set(best_i, pref);
+            best_prefs_.Set(best_i, pref);
         }
 
         virtual void Update() override {
@@ -185,9 +287,18 @@ namespace multi_armed_bandit {
             ++num_steps_;
         }
 
+        // Returns the preference of an arm.
+        double GetPref(Int i) const {
+            return prefs_.Get(i) * pref_scale_;
+        }
+
     protected:
+        static constexpr double kMinPrefScale = 1e-200;
+
         double beta_;
-        std::vector<double> prefs_;
+        rlop::SumTree<double> prefs_; // The weights of the preferences in a sum tree for the draws.
+        rlop::MaxTree<double> best_prefs_; // The same weights in a max tree for the arm of the highest preference.
+        double pref_scale_ = 1;
     };
 
     class PursuitEpsilonGreedySolver : public PersuitSolver {
@@ -198,8 +309,10 @@ namespace multi_armed_bandit {
         {}
 
         virtual std::optional<Int> Select() override {
+            if (problem_.NumActions() == 0)
+                return std::nullopt;
             if (rand_.Uniform(0.0, 1.0) >= epsilon_)
-                return rlop::SelectBest(prefs_.begin(), prefs_.end());
+                return { best_prefs_.best() };
             else
                 return { rand_.Uniform(Int(0), problem_.NumActions()-1) };
         }    
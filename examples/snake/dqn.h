@@ -41,6 +41,7 @@ namespace snake {
                 device
             ),
             problem_(num_envs, render),
+            vector_env_(problem_.MakeEnvs(), problem_.observation_sizes()),
             replay_buffer_capacity_(replay_buffer_capacity),
             score_stack_(problem_.max_num_steps())
         {
@@ -59,6 +60,7 @@ namespace snake {
             rlop::DQN::RegisterLogItems();
             log_items_["score"] = torch::Tensor();
             score_stack_.Reset();
+            score_ = torch::Tensor();
         }
 
         std::shared_ptr<rlop::ReplayBuffer> MakeReplayBuffer() const override {
@@ -68,7 +70,10 @@ namespace snake {
                     problem_.observation_sizes(),
                     problem_.action_sizes(),
                     torch::kFloat32,
-                    torch::kInt64 
+                    torch::kInt64,
+                    torch::kCPU,
+                    true, // The grids are the bulk of the buffer, so the next observations are not stored,
+                    problem_.MakeObservationCodec() // and the others are packed.
                 );
         }
 
@@ -85,66 +90,45 @@ namespace snake {
         }
 
         torch::Tensor ResetEnv() override {
-            std::vector<torch::Tensor> observation_list(problem_.num_problems());
-            #pragma omp parallel for
-            for (Int i=0; i<problem_.num_problems(); ++i) {
-                problem_.Reset(i);
-                observation_list[i] = problem_.GetObservation(i);
-            }
+            torch::Tensor observations = vector_env_.Reset();
             problem_.Render();
-            return torch::stack(observation_list);
+            return observations;
         }
 
+        // Runs on the actor thread in the asynchronous mode, so the score is handed to OnCollectRolloutStep(), on the
+        // training thread, instead of being written to the log items read by Monitor().
         std::array<torch::Tensor, 5> Step(const torch::Tensor& actions) override {
-            std::vector<torch::Tensor> observation_list(problem_.num_problems());
-            std::vector<torch::Tensor> reward_list(problem_.num_problems());
-            std::vector<torch::Tensor> termination_list(problem_.num_problems());
-            std::vector<torch::Tensor> score_list(problem_.num_problems());
-            std::vector<torch::Tensor> terminal_obseravtion_list(problem_.num_problems());
-            #pragma omp parallel for
+            auto results = vector_env_.Step(actions);
+            torch::Tensor scores = torch::empty({ problem_.num_problems() }, torch::kFloat32);
+            float* score_data = scores.data_ptr<float>();
             for (Int i=0; i<problem_.num_problems(); ++i) {
-                Int num_foods = problem_.engines()[i].snakes()[0].num_foods;
-                if (!problem_.Step(i, { problem_.GetAction(actions[i].item<Int>()) })) {
-                    double reward;
-                    if (problem_.engines()[i].snakes()[0].alive)
-                        reward = problem_.engines()[i].snakes()[0].num_foods - num_foods + problem_.engines()[i].min_num_foods() + 0.001 * problem_.engines()[i].num_steps();
-                    else
-                        reward = 0;
-                    reward_list[i] = torch::tensor(reward, torch::kFloat32);
-                    termination_list[i] = torch::tensor(1, torch::kFloat32);
-                    terminal_obseravtion_list[i] = problem_.GetObservation(i);
-                    problem_.Reset(i);
-                }
-                else {
-                    double reward = problem_.engines()[i].snakes()[0].num_foods - num_foods + 0.001;
-                    reward_list[i] = torch::tensor(reward, torch::kFloat32);
-                    termination_list[i] = torch::tensor(0, torch::kFloat32);
-                    terminal_obseravtion_list[i] = torch::zeros_like(problem_.GetObservation(i));
-                }
-                observation_list[i] = problem_.GetObservation(i);
-                score_list[i] = torch::tensor(problem_.engines()[i].snakes()[0].num_foods, torch::kFloat32);
+                score_data[i] = problem_.engines()[i].snakes()[0].num_foods;
+            }
+            score_stack_.Push(scores);
+            if (score_stack_.full()) {
+                torch::Tensor score = torch::stack(score_stack_.vec()).mean();
+                std::lock_guard<std::mutex> lock(score_mutex_);
+                score_ = score;
             }
-            torch::Tensor next_observations = torch::stack(observation_list);
-            torch::Tensor rewards = torch::stack(reward_list);
-            torch::Tensor terminations = torch::stack(termination_list);
-            torch::Tensor truncations = torch::zeros_like(terminations);
-            torch::Tensor terminal_observations = torch::stack(terminal_obseravtion_list);
-            score_stack_.Push(torch::stack(score_list));
-            if (score_stack_.full())
-                log_items_["score"] = torch::stack(score_stack_.vec()).mean();
             problem_.Render();
-            return { next_observations, rewards, terminations, truncations, terminal_observations };
+            return results;
         }
 
         void OnCollectRolloutStep() override {
             rlop::DQN::OnCollectRolloutStep();
             eps_ = linear_fn_(time_steps_ / (double)max_time_steps_); 
+            std::lock_guard<std::mutex> lock(score_mutex_);
+            if (score_.defined())
+                log_items_["score"] = score_;
         }
 
     protected:
         VectorProblem problem_;
+        rlop::VectorEnv vector_env_;
         Int replay_buffer_capacity_;
         rlop::CircularStack<torch::Tensor> score_stack_;
+        std::mutex score_mutex_;
+        torch::Tensor score_; // The last score of the actor, logged by the training thread.
         std::function<double(double)> linear_fn_;
     };
 }
\ No newline at end of file
@@ -66,6 +66,17 @@ int main(int argc, char *argv[]) {
             path + "_ppo", // output_path
             torch::kCUDA // device
         );
+        // The snapshots of the policy are evaluated on environments of their own while the training continues. The
+        // evaluation only needs the policy, so its rollout buffer holds a single step.
+        auto eval_solver = std::make_shared<PPO>(
+            num_cpu, false, 1, 1, 1, 1e-4, 0.99, 0.2, 0, true, 0.01, 0.1, 0.95, 10, 0.1, "", torch::kCUDA
+        );
+        eval_solver->Reset();
+        solver.add_callback(std::make_shared<rlop::BackgroundEvaluator>(
+            eval_solver, 
+            100, // num_eval_episodes
+            1e5 // eval_interval
+        ));
         solver.Reset();
         timer.Start();
         solver.Learn(num_time_steps, 1);
@@ -2,6 +2,7 @@
 #pragma once
 #include "problems/snake/problem.h"
 #include "rlop/mcts/mcts.h"
+#include "rlop/rl/ppo/policy.h"
 
 namespace snake {
     class MCTS : public rlop::MCTS {
@@ -25,8 +26,7 @@ namespace snake {
         }
 
         void RevertState() override {
-            engine_bk_.set_seed(rand_.Uniform(uint64_t(0), uint64_t(100)));
-            problem_.Reset(engine_bk_);
+            problem_.Rewind(rand_.Uniform(uint64_t(0), uint64_t(100)));
             depth_ = 0;
         }
 
@@ -39,24 +39,68 @@ namespace snake {
         }
 
         double Reward() override {
-            if (problem_.engine().snakes()[0].alive)
-                return (problem_.engine().snakes()[0].num_foods + problem_.engine().min_num_foods()) / (double)problem_.grid_size() + 0.002 * depth_ / (double)max_depth_;
-            else 
-                return problem_.engine().snakes()[0].num_foods / (double)problem_.grid_size() + 0.001 * depth_ / (double)max_depth_;
+            return Score(problem_.engine(), depth_);
+        }
+
+        // Copies the engine of the leaf, without its undo log, for the leaf-parallel mode.
+        void CloneLeaf(Int num_rollouts) override {
+            leaf_engines_.resize(std::max<Int>(leaf_engines_.size(), num_rollouts));
+            for (Int i=0; i<num_rollouts; ++i) {
+                leaf_engines_[i] = problem_.engine();
+                leaf_engines_[i].Unmark();
+            }
+        }
+
+        // Plays random directions on a copy of the leaf as Step() does on the problem.
+        double LeafRollout(Int rollout_i, rlop::Random* rand) override {
+            Engine& engine = leaf_engines_[rollout_i];
+            engine.set_seed(rand->Uniform(uint64_t(0), std::numeric_limits<uint64_t>::max()));
+            Int depth = depth_;
+            for (Int i=0; i<rollout_depth_; ++i) {
+                engine.SetDir(0, problem_.GetAction(rand->Uniform(Int(0), problem_.NumActions() - 1)));
+                engine.Update();
+                if (engine.IsEnd() || depth >= max_depth_)
+                    break;
+                ++depth;
+            }
+            return Score(engine, depth);
         }
 
+        // Scores a leaf by the value a PPO policy predicts from its observation, the future foods, added to the foods
+        // eaten, in the units of Reward(). Without a policy, the cut rollouts are scored by Reward().
+        std::optional<double> EvaluateLeaf() override {
+            if (value_policy_ == nullptr || !problem_.engine().snakes()[0].alive)
+                return std::nullopt;
+            torch::NoGradGuard no_grad;
+            double value = value_policy_->PredictValues(problem_.GetObservation().unsqueeze(0).to(device_)).item<double>();
+            return (problem_.engine().snakes()[0].num_foods + value) / (double)problem_.grid_size();
+        }
+
+        // Sets the PPO policy scoring the leaves, whose inputs are moved to `device`, typically along with
+        // set_rollout_depth() and set_leaf_value_weight().
+        void set_value_policy(std::shared_ptr<rlop::PPOPolicy> value_policy, torch::Device device = torch::kCPU) {
+            value_policy_ = std::move(value_policy);
+            device_ = device;
+        }
+
+        // Searches the best direction from a state. With `reuse_tree`, `engine` must be the state reached by playing 
+        // the direction returned by the previous call, whose subtree then seeds the new search.
         template<typename TEngine>
-        Int NewSearch(TEngine&& engine, Int max_num_iters) {
+        Int NewSearch(TEngine&& engine, Int max_num_iters, bool reuse_tree = false) {
             if (!engine.snakes()[0].alive)
                 return kIntNull;
-            Reset();
-            engine_bk_ = std::forward<TEngine>(engine);
+            if (!reuse_tree || last_i_ == kIntNull || !AdvanceRoot(last_i_))
+                Reset();
+            // The searches rewind the problem to the state instead of copying it at each iteration.
+            problem_.Reset(std::forward<TEngine>(engine));
+            problem_.Mark();
             Search(max_num_iters);
+            problem_.Rewind();
             Int best_i = kIntNull;
             double best_score = std::numeric_limits<double>::lowest();
             for (Int i=0; i < path_.front()->children.size(); ++i) {
                 Int dir = problem_.GetAction(i);
-                if(engine.Lookahead(0, dir)) {
+                if(problem_.engine().Lookahead(0, dir)) {
                     double score = path_.front()->children[i]->num_visits;
                     if (score > best_score) {
                         best_score = score;
@@ -64,24 +108,38 @@ namespace snake {
                     } 
                 }
             } 
+            last_i_ = best_i;
             return best_i;
         }
 
         void Evaluate(Int num_time_steps, bool render, Int max_num_iters = 30000) {
             Problem problem(render);
             problem.Reset();
+            bool reuse_tree = false;
             for (Int i=0; i< num_time_steps; ++i) {
-                Int dir = NewSearch(problem.engine(), max_num_iters);
-                if (!problem.Step({ dir == kIntNull? 0 : dir }))
+                Int dir = NewSearch(problem.engine(), max_num_iters, reuse_tree);
+                reuse_tree = problem.Step({ dir == kIntNull? 0 : dir });
+                if (!reuse_tree)
                     problem.Reset();
                 problem.Render();
             }
         }
 
     private:
+        // Returns the reward of an engine reached at a depth of the search.
+        double Score(const Engine& engine, Int depth) const {
+            if (engine.snakes()[0].alive)
+                return (engine.snakes()[0].num_foods + engine.min_num_foods()) / (double)engine.grid_size() + 0.002 * depth / (double)max_depth_;
+            else 
+                return engine.snakes()[0].num_foods / (double)engine.grid_size() + 0.001 * depth / (double)max_depth_;
+        }
+
         Problem problem_;
         Int max_depth_;
-        Engine engine_bk_; 
         Int depth_;
+        Int last_i_ = kIntNull;
+        std::shared_ptr<rlop::PPOPolicy> value_policy_ = nullptr;
+        torch::Device device_ = torch::kCPU;
+        std::vector<Engine> leaf_engines_;
     };
 }
\ No newline at end of file
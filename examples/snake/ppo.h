@@ -43,6 +43,7 @@ namespace snake {
                 device
             ),
             problem_(num_envs, render),
+            vector_env_(problem_.MakeEnvs(), problem_.observation_sizes()),
             num_steps_(num_steps),
             score_stack_(problem_.max_num_steps())
         {}
@@ -67,7 +68,9 @@ namespace snake {
                     problem_.observation_sizes(),
                     problem_.action_sizes(),
                     torch::kFloat32,
-                    torch::kInt64
+                    torch::kInt64,
+                    torch::kCPU,
+                    problem_.MakeObservationCodec()
                 );
         }
 
@@ -80,59 +83,28 @@ namespace snake {
         }
 
         torch::Tensor ResetEnv() override {
-            std::vector<torch::Tensor> observation_list(problem_.num_problems());
-            #pragma omp parallel for
-            for (Int env_i=0; env_i<problem_.num_problems(); ++env_i) {
-                problem_.Reset(env_i);
-                observation_list[env_i] = problem_.GetObservation(env_i);
-            }
+            torch::Tensor observations = vector_env_.Reset();
             problem_.Render();
-            return torch::stack(observation_list);
+            return observations;
         }
 
         std::array<torch::Tensor, 5> Step(const torch::Tensor& action) override {
-            std::vector<torch::Tensor> observation_list(problem_.num_problems());
-            std::vector<torch::Tensor> reward_list(problem_.num_problems());
-            std::vector<torch::Tensor> terminated_list(problem_.num_problems());
-            std::vector<torch::Tensor> score_list(problem_.num_problems());
-            std::vector<torch::Tensor> terminal_obseravtion_list(problem_.num_problems());
-            #pragma omp parallel for
+            auto results = vector_env_.Step(action);
+            torch::Tensor scores = torch::empty({ problem_.num_problems() }, torch::kFloat32);
+            float* score_data = scores.data_ptr<float>();
             for (Int i=0; i<problem_.num_problems(); ++i) {
-                Int num_foods = problem_.engines()[i].snakes()[0].num_foods;
-                if (!problem_.Step(i, { problem_.GetAction(action[i].item<Int>()) })) {
-                    double reward;
-                    if (problem_.engines()[i].snakes()[0].alive)
-                        reward = problem_.engines()[i].snakes()[0].num_foods - num_foods + problem_.engines()[i].min_num_foods() + 0.001 * problem_.engines()[i].num_steps();
-                    else
-                        reward = 0;
-                    reward_list[i] = torch::tensor(reward, torch::kFloat32);
-                    terminated_list[i] = torch::tensor(1, torch::kFloat32);
-                    terminal_obseravtion_list[i] = problem_.GetObservation(i);
-                    problem_.Reset(i);
-                }
-                else {
-                    double reward = problem_.engines()[i].snakes()[0].num_foods - num_foods + 0.001;
-                    reward_list[i] = torch::tensor(reward, torch::kFloat32);
-                    terminated_list[i] = torch::tensor(0, torch::kFloat32);
-                    terminal_obseravtion_list[i] = torch::zeros_like(problem_.GetObservation(i));
-                }
-                observation_list[i] = problem_.GetObservation(i);
-                score_list[i] = torch::tensor(problem_.engines()[i].snakes()[0].num_foods, torch::kFloat32);
+                score_data[i] = problem_.engines()[i].snakes()[0].num_foods;
             }
-            torch::Tensor next_observation = torch::stack(observation_list);
-            torch::Tensor reward = torch::stack(reward_list);
-            torch::Tensor terminated = torch::stack(terminated_list);
-            torch::Tensor truncated = torch::zeros_like(terminated);
-            torch::Tensor terminal_observation = torch::stack(terminal_obseravtion_list);
-            score_stack_.Push(torch::stack(score_list));
+            score_stack_.Push(scores);
             if (score_stack_.full())
                 log_items_["score"] = torch::stack(score_stack_.vec()).mean();
             problem_.Render();
-            return { next_observation, reward, terminated, truncated, terminal_observation };
+            return results;
         }
 
     protected:
         VectorProblem problem_;
+        rlop::VectorEnv vector_env_;
         Int num_steps_;
         rlop::CircularStack<torch::Tensor> score_stack_;
     };
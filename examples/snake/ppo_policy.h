@@ -67,8 +67,7 @@ namespace snake {
             torch::Tensor logits = PredictActionLogitsFromFeatures(features);
             torch::Tensor values = PredictValuesFromFeatures(features);
             rlop::Categorical dist(logits);
-            torch::Tensor log_prob = dist.LogProb(actions);
-            torch::Tensor entropy = dist.Entropy();
+            auto [ log_prob, entropy ] = dist.LogProbAndEntropy(actions);
             return { values, log_prob, { entropy } };
         }
 
@@ -76,9 +75,8 @@ namespace snake {
             torch::Tensor features = feature_extractor_->forward(observations);
             torch::Tensor logits = PredictActionLogitsFromFeatures(features);
             rlop::Categorical dist(logits);
-            torch::Tensor actions = dist.Sample();
+            auto [ actions, log_prob ] = dist.SampleAndLogProb();
             torch::Tensor values = PredictValuesFromFeatures(features);
-            torch::Tensor log_prob = dist.LogProb(actions);
             return { actions, values, log_prob };
         }
 
@@ -0,0 +1,210 @@
+#pragma once
+#include "problems/vrp/regret_insertion_solver.h"
+#include "rlop/local_search/alns.h"
+#include "rlop/local_search/solution_journal.h"
+
+namespace vrp {
+    // Destroys the routes by random, worst or related removal of nodes and repairs them by regret-k insertion. The
+    // nodes removed and inserted in an iteration are logged, so that a rejected solution is restored by undoing them,
+    // and those of an accepted one are recorded in the journal of the best routes.
+    class ALNS : public rlop::ALNS<Int> {
+    public:
+        enum DestroyOperator {
+            kRandomRemoval = 0,
+            kWorstRemoval,
+            kRelatedRemoval,
+            kNumDestroyOperators
+        };
+
+        // Parameters:
+        //   get_cost: The cost of the arc between two nodes.
+        //   initial_temp: The starting temperature of the acceptance criterion.
+        //   cooling_rate: The rate at which the temperature decreases in each iteration.
+        //   min_removal_rate: The smallest fraction of the nodes removed by a destroy operator.
+        //   max_removal_rate: The largest fraction of the nodes removed by a destroy operator.
+        ALNS(
+            const std::function<Int(Int, Int)>& get_cost,
+            double initial_temp = 10,
+            double cooling_rate = 0.001,
+            double min_removal_rate = 0.1,
+            double max_removal_rate = 0.3
+        ) :
+            rlop::ALNS<Int>(initial_temp, cooling_rate),
+            get_cost_(get_cost),
+            cost_manager_(routes_, get_cost),
+            problem_(&routes_, nullptr, &cost_manager_),
+            repair_(&problem_),
+            min_removal_rate_(min_removal_rate),
+            max_removal_rate_(max_removal_rate)
+        {}
+
+        ~ALNS() = default;
+
+        void Reset(const Routes& routes) {
+            rlop::ALNS<Int>::Reset();
+            routes_ = routes;
+            cost_manager_.Reset();
+            journal_.Reset(routes_);
+            removed_.clear();
+        }
+
+        Int NumDestroyOperators() const override {
+            return kNumDestroyOperators;
+        }
+
+        // The repair operators are regret-1, regret-2 and regret-3 insertions.
+        Int NumRepairOperators() const override {
+            return kNumRepairOperators;
+        }
+
+        Int EvaluateSolution() override {
+            if (routes_.num_visited_nodes() < routes_.num_nodes())
+                return std::numeric_limits<Int>::max();
+            return problem_.GetTotalCost();
+        }
+
+        void Destroy(Int destroy_i) override {
+            removed_.clear();
+            Int num_visited = routes_.num_visited_nodes();
+            Int min_removed = std::max<Int>(min_removal_rate_ * num_visited, 1);
+            Int max_removed = std::max<Int>(max_removal_rate_ * num_visited, min_removed);
+            Int num_removed = std::min(rand_.Uniform(min_removed, max_removed), num_visited);
+            if (num_removed == 0)
+                return;
+            switch (destroy_i) {
+                case kRandomRemoval:
+                    RandomRemoval(num_removed);
+                    break;
+                case kWorstRemoval:
+                    WorstRemoval(num_removed);
+                    break;
+                case kRelatedRemoval:
+                    RelatedRemoval(num_removed);
+                    break;
+            }
+        }
+
+        void Repair(Int repair_i) override {
+            repair_.set_k(repair_i + 1);
+            repair_.Solve();
+        }
+
+        void KeepSolution() override {
+            for (const auto& insertion : removed_)
+                journal_.Record({ insertion, true });
+            for (const auto& insertion : repair_.insertions())
+                journal_.Record({ insertion, false });
+            removed_.clear();
+        }
+
+        void RestoreSolution() override {
+            const auto& inserted = repair_.insertions();
+            for (auto it = inserted.rbegin(); it != inserted.rend(); ++it)
+                problem_.Undo(*it);
+            for (auto it = removed_.rbegin(); it != removed_.rend(); ++it)
+                problem_.Step(*it);
+            removed_.clear();
+        }
+
+        void RecordSolution() override {
+            journal_.Commit(routes_);
+        }
+
+        const Routes& best_routes() const {
+            return journal_.best();
+        }
+
+    protected:
+        // A node removed or inserted by an accepted iteration, as its insertion and whether it is undone.
+        struct Change {
+            Insertion insertion;
+            bool removed;
+        };
+
+        // The routes of the journal, on which the changes are replayed.
+        class JournaledRoutes : public Routes {
+        public:
+            JournaledRoutes() = default;
+
+            JournaledRoutes(const Routes& routes) : Routes(routes) {}
+
+            bool Step(const Change& change) {
+                if (!change.removed)
+                    return Routes::Step(change.insertion);
+                Undo(change.insertion);
+                return true;
+            }
+        };
+
+
+        static constexpr Int kNumRepairOperators = 3;
+        static constexpr double kWorstRemovalRandomness = 3; // Larger values remove the worst nodes more strictly.
+
+        // Removes a node, logged as the insertion which restores it.
+        void Remove(Int node) {
+            Insertion insertion(node, routes_.GetNext(node));
+            problem_.Undo(insertion);
+            removed_.push_back(insertion);
+        }
+
+        std::vector<Int> GetVisitedNodes() const {
+            std::vector<Int> nodes;
+            for (Int i=0; i<routes_.num_nodes(); ++i) {
+                if (routes_.IsVisited(i))
+                    nodes.push_back(i);
+            }
+            return nodes;
+        }
+
+        void RandomRemoval(Int num_removed) {
+            auto nodes = GetVisitedNodes();
+            rand_.PartialShuffle(nodes.begin(), nodes.end(), num_removed);
+            for (Int i=0; i<num_removed; ++i)
+                Remove(nodes[i]);
+        }
+
+        // Removes the nodes whose arcs cost the most compared to the arc bypassing them, one at a time, drawing the
+        // rank of the removed node with a bias towards the worst.
+        void WorstRemoval(Int num_removed) {
+            auto nodes = GetVisitedNodes();
+            std::vector<std::pair<Int, Int>> savings;
+            for (Int i=0; i<num_removed; ++i) {
+                savings.clear();
+                for (Int node : nodes) {
+                    Int last = routes_.GetLast(node);
+                    Int next = routes_.GetNext(node);
+                    savings.emplace_back(get_cost_(last, node) + get_cost_(node, next) - get_cost_(last, next), node);
+                }
+                std::sort(savings.begin(), savings.end(), std::greater<>());
+                Int rank = std::pow(rand_.Uniform(0.0, 1.0), kWorstRemovalRandomness) * savings.size();
+                Int node = savings[std::min<Int>(rank, savings.size() - 1)].second;
+                Remove(node);
+                nodes.erase(std::find(nodes.begin(), nodes.end(), node));
+            }
+        }
+
+        // Removes a random node and the nodes closest to it.
+        void RelatedRemoval(Int num_removed) {
+            auto nodes = GetVisitedNodes();
+            Int seed = nodes[rand_.Uniform(Int(0), (Int)nodes.size() - 1)];
+            auto relatedness = [&](Int node) {
+                return node == seed ? std::numeric_limits<Int>::lowest() : get_cost_(seed, node) + get_cost_(node, seed);
+            };
+            std::nth_element(nodes.begin(), nodes.begin() + num_removed - 1, nodes.end(), [&](Int a, Int b) {
+                return relatedness(a) < relatedness(b);
+            });
+            for (Int i=0; i<num_removed; ++i)
+                Remove(nodes[i]);
+        }
+
+        std::function<Int(Int, Int)> get_cost_;
+        Routes routes_;
+        rlop::SolutionJournal<JournaledRoutes, Change> journal_; // The best routes, as the nodes removed and inserted since.
+        ArcCostManager cost_manager_;
+        BasicProblem<ArcCostManager> problem_;
+        RegretInsertionSolver repair_;
+        double min_removal_rate_;
+        double max_removal_rate_;
+        std::vector<Insertion> removed_; // The insertions restoring the nodes removed in the current iteration.
+    };
+}
@@ -0,0 +1,168 @@
+#include "problems/vrp/instance.h"
+#include "problems/vrp/insertion_solver.h"
+#include "local_search.h"
+#include "tabu_search.h"
+#include "simulate_annealing.h"
+#include "rlop/common/timer.h"
+
+namespace vrp {
+    // Records when a search first finds a capacity-feasible solution whose cost is at most a target.
+    template<typename TSearch>
+    class Benchmarked : public TSearch {
+    public:
+        using TSearch::TSearch;
+
+        void Start(Int target_cost) {
+            target_cost_ = target_cost;
+            time_to_target_ = kIntNull;
+            start_ = std::chrono::steady_clock::now();
+            if (target_cost_ != kIntNull && this->EvaluateSolution() <= target_cost_ && this->capacity_manager_.total_cost() == 0)
+                time_to_target_ = 0;
+        }
+
+        void Improved() override {
+            TSearch::Improved();
+            if (time_to_target_ == kIntNull && target_cost_ != kIntNull && this->best_cost_ <= target_cost_ &&
+                this->capacity_manager_.total_cost() == 0) {
+                auto duration = std::chrono::steady_clock::now() - start_;
+                time_to_target_ = std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
+            }
+        }
+
+        // The milliseconds from Start() to the target, or kIntNull if it has not been reached.
+        Int time_to_target() const {
+            return time_to_target_;
+        }
+
+    protected:
+        Int target_cost_ = kIntNull;
+        Int time_to_target_ = kIntNull;
+        std::chrono::steady_clock::time_point start_;
+    };
+}
+
+// Runs insertion, local search, tabu search and simulated annealing on an instance in the CVRPLIB or TSPLIB format
+// and prints one CSV row per solver, so that runs before and after a change can be compared. The searches start
+// from the insertion solution and the random ones use fixed seeds.
+//
+// Usage: vrp_benchmark instance [max_iters] [target_gap] [penalty] [best_known] [num_vehicles] [seed]
+//   instance: The instance file. A CVRPLIB solution file with the same name and the extension .sol, if any, gives
+//             the best known cost.
+//   max_iters: The number of iterations of each search. Default is 1000.
+//   target_gap: The gap to the best known cost in percent under which the target is reached. Default is 5.
+//   penalty: The cost of each unit of load beyond the capacity. Default is 1000.
+//   best_known: The best known cost, 0 to take it from the instance or the solution file. Default is 0.
+//   num_vehicles: The number of vehicles, 0 to take it from the instance or the demands. Default is 0.
+//   seed: The seed of simulated annealing. Default is 0.
+//
+// The moves are the inserted nodes for insertion and the iterations for the searches. The cost includes the
+// penalized excess loads, the distance and the overload do not, and the gap is that of the distance.
+int main(int argc, char *argv[]) {
+    using namespace vrp;
+
+    if (argc < 2) {
+        std::cerr << "Usage: vrp_benchmark instance [max_iters] [target_gap] [penalty] [best_known] [num_vehicles] [seed]" << std::endl;
+        return 1;
+    }
+    std::string path = argv[1];
+    Int max_iters = argc > 2 ? std::stoll(argv[2]) : 1000;
+    double target_gap = argc > 3 ? std::stod(argv[3]) : 5;
+    Int penalty = argc > 4 ? std::stoll(argv[4]) : 1000;
+    Int best_known = argc > 5 && std::stoll(argv[5]) > 0 ? std::stoll(argv[5]) : kIntNull;
+    Int num_vehicles = argc > 6 && std::stoll(argv[6]) > 0 ? std::stoll(argv[6]) : kIntNull;
+    uint64_t seed = argc > 7 ? std::stoull(argv[7]) : 0;
+
+    rlop::Timer timer;
+    timer.Restart();
+    Instance instance(path);
+    timer.Stop();
+    Int read_time = timer.duration();
+
+    if (best_known == kIntNull) {
+        auto solution_path = std::filesystem::path(path).replace_extension(".sol");
+        if (std::filesystem::exists(solution_path))
+            best_known = Instance::ReadSolutionCost(solution_path.string());
+    }
+    if (best_known == kIntNull)
+        best_known = instance.best_known_cost();
+    bool capacitated = instance.capacity() != kIntNull;
+    std::vector<Int> demands = instance.GetDemands();
+    if (num_vehicles == kIntNull)
+        num_vehicles = instance.num_vehicles();
+    if (num_vehicles == kIntNull) {
+        Int total_demand = std::accumulate(demands.begin(), demands.end(), Int(0));
+        num_vehicles = capacitated && instance.capacity() > 0 ? std::max<Int>((total_demand + instance.capacity() - 1) / instance.capacity(), 1) : 1;
+    }
+    std::vector<Int> capacities(num_vehicles, capacitated ? instance.capacity() : 0);
+    if (!capacitated)
+        std::fill(demands.begin(), demands.end(), 0);
+    Int target_cost = best_known == kIntNull ? kIntNull : static_cast<Int>(best_known * (1 + target_gap / 100));
+
+    std::function<Int(Int, Int)> get_cost = [&instance](Int from, Int to) {
+        return instance.GetCost(from, to);
+    };
+    Routes routes(num_vehicles, instance.num_targets());
+    routes.Reset();
+    BasicArcCostManager<Instance> arc_manager(routes, instance);
+    CapacityCostManager capacity_manager(routes, demands, capacities, penalty);
+    OperatorSpace space(routes);
+    BasicProblem<BasicArcCostManager<Instance>, CapacityCostManager> problem(&routes, &space, &arc_manager, &capacity_manager);
+    arc_manager.Reset();
+    capacity_manager.Reset();
+    space.Reset();
+
+    std::cout << "# " << instance.name() << ": " << instance.num_targets() << " targets, " << num_vehicles
+              << " vehicles, read in " << read_time << "ms" << std::endl;
+    std::cout << "solver,moves,time_ms,moves_per_s,cost,distance,overload,best_known,gap_percent,time_to_target_ms" << std::endl;
+    auto report = [&](const std::string& solver, Int moves, Int time, Int cost, const Routes& solution, Int time_to_target) {
+        BasicArcCostManager<Instance> distance(solution, instance);
+        distance.Reset();
+        CapacityCostManager overload(solution, demands, capacities);
+        overload.Reset();
+        std::cout << solver << "," << moves << "," << time << "," << moves * 1e3 / std::max<Int>(time, 1) << ","
+                  << cost << "," << distance.total_cost() << "," << overload.total_cost() << ",";
+        if (best_known != kIntNull)
+            std::cout << best_known << "," << (distance.total_cost() - best_known) * 100.0 / best_known;
+        else
+            std::cout << ",";
+        std::cout << ",";
+        if (time_to_target != kIntNull)
+            std::cout << time_to_target;
+        std::cout << std::endl;
+    };
+
+    InsertionSolver insertion(&problem);
+    timer.Restart();
+    insertion.Solve();
+    timer.Stop();
+    Int insertion_time_to_target = kIntNull;
+    if (target_cost != kIntNull && arc_manager.total_cost() <= target_cost && capacity_manager.total_cost() == 0)
+        insertion_time_to_target = timer.duration();
+    report("insertion", routes.num_visited_nodes(), timer.duration(), problem.GetTotalCost(), routes, insertion_time_to_target);
+
+    auto run = [&](const std::string& solver, auto& search) {
+        search.set_capacities(demands, capacities, penalty);
+        search.Reset(routes);
+        search.Start(target_cost);
+        timer.Restart();
+        search.Search(max_iters);
+        timer.Stop();
+        report(solver, search.num_iters(), timer.duration(), search.best_cost(), search.best_routes(), search.time_to_target());
+    };
+
+    Benchmarked<LocalSearch> local_search(get_cost);
+    run("local_search", local_search);
+
+    Benchmarked<TabuSearch> tabu_search(get_cost);
+    run("tabu_search", tabu_search);
+
+    Benchmarked<SimulatedAnnealing> simulated_annealing(get_cost);
+    simulated_annealing.SetSeed(seed);
+    run("simulated_annealing", simulated_annealing);
+
+#if defined(RLOP_PROFILE)
+    rlop::Profiler::Get().Report(std::cerr);
+    rlop::Profiler::Get().WriteChromeTrace("vrp_benchmark_trace.json");
+#endif
+    return 0;
+}
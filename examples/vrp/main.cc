@@ -2,6 +2,8 @@
 #include "local_search.h"
 #include "tabu_search.h"
 #include "simulate_annealing.h"
+#include "alns.h"
+#include "rlop/local_search/parallel_search.h"
 #include "rlop/common/timer.h"
 
 int main() {
@@ -13,22 +15,22 @@ int main() {
     Int num_vehicles = 5;
     Int num_tasks = 30;
 
-    std::vector<std::vector<Int>> matrix(num_tasks + num_vehicles, std::vector<Int>(num_tasks + num_vehicles, 0));
+    DistanceMatrix matrix(num_tasks + num_vehicles);
     for (Int i=0; i<matrix.size(); ++i) {
-        for (Int j=0; j<matrix[i].size(); ++j) {
+        for (Int j=0; j<matrix.size(); ++j) {
             if (i==j)
                 continue;
-            matrix[i][j] = rand.Uniform(1, 100); 
+            matrix.Set(i, j, rand.Uniform(1, 100)); 
         }
     }
 
     auto get_cost = [&matrix](Int i, Int j){ 
-        return matrix[i][j]; 
+        return matrix(i, j); 
     };
 
     Routes routes(num_vehicles, num_tasks);
     routes.Reset();
-    ArcCostManager manager(routes, get_cost);
+    BasicArcCostManager<DistanceMatrix> manager(routes, matrix);
     manager.Reset();
     OperatorSpace space(routes);
     space.Reset();
@@ -79,6 +81,42 @@ int main() {
     std::cout << "total cost: " << simulated_annealing.best_cost() << std::endl;
     std::cout << "computing time: " << timer.duration() << "ms" << std::endl;    
     std::cout << std::endl;
+
+    // Parallel tempering: a ladder of constant temperatures, the coldest first.
+    std::vector<std::unique_ptr<SimulatedAnnealing>> replicas;
+    for (double temp : { 1.0, 3.0, 10.0, 30.0 }) {
+        replicas.push_back(std::make_unique<SimulatedAnnealing>(get_cost, temp, 0.0, 0.0));
+        replicas.back()->Reset(routes);
+    }
+    rlop::ParallelSearch<SimulatedAnnealing, Routes> replica_exchange(
+        std::move(replicas),
+        [](const SimulatedAnnealing& replica) { return replica.best_routes(); },
+        [](const SimulatedAnnealing& replica) { return replica.routes(); },
+        [](SimulatedAnnealing& replica, const Routes& routes) { replica.Reset(routes); },
+        rlop::ParallelSearch<SimulatedAnnealing, Routes>::Mode::kReplicaExchange
+    );
+    replica_exchange.set_num_threads(4);
+    replica_exchange.Reset();
+    timer.Restart();
+    replica_exchange.Search(50, 200);
+    timer.Stop();
+    std::cout << "replica exchange: " << std::endl;
+    replica_exchange.best_solution()->Print();
+    std::cout << "total cost: " << replica_exchange.best_cost() << std::endl;
+    std::cout << "exchanges: " << replica_exchange.num_exchanges() << std::endl;
+    std::cout << "computing time: " << timer.duration() << "ms" << std::endl;    
+    std::cout << std::endl;
+
+    ALNS alns(get_cost);
+    alns.Reset(routes);
+    timer.Restart();
+    alns.Search(2000);
+    timer.Stop();
+    std::cout << "alns: " << std::endl;
+    alns.best_routes().Print();
+    std::cout << "total cost: " << alns.best_cost() << std::endl;
+    std::cout << "computing time: " << timer.duration() << "ms" << std::endl;    
+    std::cout << std::endl;
     
     return 0;
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
+#include "problems/vrp/capacity_cost_manager.h"
 #include "problems/vrp/problem.h"
+#include "rlop/local_search/solution_journal.h"
 #include "rlop/local_search/simulated_annealing.h"
  
 namespace vrp {
@@ -14,14 +16,18 @@ namespace vrp {
             rlop::SimulatedAnnealing<Int, Int>(initial_temp, final_temp, cooling_rate), 
             operator_space_(routes_), 
             cost_manager_(routes_, get_cost),
-            problem_(&routes_, &operator_space_, { &cost_manager_ })
-        {}
+            problem_(&routes_, &operator_space_, &cost_manager_, &capacity_manager_)
+        {
+            operator_space_.set_incremental(true);
+        }
 
         void Reset() override {
             rlop::SimulatedAnnealing<Int, Int>::Reset();
             routes_.Reset();
             operator_space_.Reset();
             cost_manager_.Reset();
+            ResetCapacityManager();
+            journal_.Reset(routes_);
         }
 
         void Reset(const Routes& routes) {
@@ -29,6 +35,8 @@ namespace vrp {
             routes_ = routes;
             operator_space_.Reset();
             cost_manager_.Reset();
+            ResetCapacityManager();
+            journal_.Reset(routes_);
         }
 
         void Reset(Routes&& routes) {
@@ -36,6 +44,8 @@ namespace vrp {
             routes_ = std::move(routes);
             operator_space_.Reset();
             cost_manager_.Reset();
+            ResetCapacityManager();
+            journal_.Reset(routes_);
         }
 
         std::optional<Int> SelectRandom() override {
@@ -63,9 +73,15 @@ namespace vrp {
             return problem_.GetTotalCost();
         }
 
+        // The proposals of the batched mode are evaluated by several threads, which only read the cached deltas, as
+        // the writes of SetDelta() would race.
         Int EvaluateNeighbor(const Int& op_i) override {
-            auto op = problem_.operator_space()->GetNeighbor(op_i);
-            return problem_.EvaluateDelta(*op) + problem_.GetTotalCost();
+            if (num_proposals_ == 0 || num_threads_ <= 1)
+                return problem_.EvaluateNeighbor(op_i) + problem_.GetTotalCost();
+            auto delta = problem_.operator_space()->GetDelta(op_i);
+            if (delta)
+                return *delta + problem_.GetTotalCost();
+            return problem_.EvaluateDelta(*problem_.operator_space()->GetNeighbor(op_i)) + problem_.GetTotalCost();
         }
 
         std::optional<Int> Select() override {
@@ -77,22 +93,55 @@ namespace vrp {
             auto op = problem_.operator_space()->GetNeighbor(op_i);
             if (!problem_.Step(*op))
                 return false;
+            journal_.Record(*op);
             return true;
         }
 
         void RecordSolution() override {
-            best_routes_ = routes_;
+            journal_.Commit(routes_);
+        }
+
+        // Sets the demands of the nodes and the capacities of the routes, whose excess loads are penalized by the
+        // cost of each unit. They apply from the next Reset(). Without them, the routes are not capacitated.
+        void set_capacities(std::vector<Int> demands, std::vector<Int> capacities, Int penalty = 1) {
+            demands_ = std::move(demands);
+            capacities_ = std::move(capacities);
+            capacity_penalty_ = penalty;
+        }
+
+        // Restricts the neighbors of each iteration to the moves of the nodes around the previous steps, with the
+        // don't-look bits of the operator space.
+        void set_dont_look_bits(bool dont_look_bits) {
+            operator_space_.set_dont_look_bits(dont_look_bits);
+        }
+
+        const Routes& routes() const {
+            return routes_;
         }
 
         const Routes& best_routes() const {
-            return best_routes_;
+            return journal_.best();
         }
 
     protected:
+        void ResetCapacityManager() {
+            capacity_manager_ = CapacityCostManager(
+                routes_,
+                demands_.empty() ? std::vector<Int>(routes_.num_nodes(), 0) : demands_,
+                capacities_.empty() ? std::vector<Int>(routes_.num_routes(), 0) : capacities_,
+                capacity_penalty_
+            );
+            capacity_manager_.Reset();
+        }
+
         Routes routes_;
-        Routes best_routes_;
+        rlop::SolutionJournal<Routes, Operator> journal_; // The best routes, as the operators applied since.
         ArcCostManager cost_manager_;
+        CapacityCostManager capacity_manager_;
+        std::vector<Int> demands_; // The demands of the nodes, none if empty.
+        std::vector<Int> capacities_; // The capacities of the routes, none if empty.
+        Int capacity_penalty_ = 1;
         OperatorSpace operator_space_;
-        Problem problem_;
+        BasicProblem<ArcCostManager, CapacityCostManager> problem_;
     };
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
+#include "problems/vrp/capacity_cost_manager.h"
 #include "problems/vrp/problem.h"
+#include "rlop/local_search/solution_journal.h"
 #include "rlop/local_search/tabu_search.h"
  
 namespace vrp {
@@ -13,9 +15,11 @@ namespace vrp {
             rlop::TabuSearch<Int>(max_num_unimproved_iters),
             operator_space_(routes_),
             cost_manager_(routes_, get_cost),
-            problem_(&routes_, &operator_space_, { &cost_manager_ }), 
+            problem_(&routes_, &operator_space_, &cost_manager_, &capacity_manager_), 
             tenure_(tenure)
-        {}
+        {
+            operator_space_.set_incremental(true);
+        }
 
         ~TabuSearch() = default;
 
@@ -25,6 +29,8 @@ namespace vrp {
             routes_.Reset();
             operator_space_.Reset();
             cost_manager_.Reset();
+            ResetCapacityManager();
+            journal_.Reset(routes_);
         }
 
         void Reset(const Routes& routes) {
@@ -33,6 +39,8 @@ namespace vrp {
             routes_ = routes;
             operator_space_.Reset();
             cost_manager_.Reset();
+            ResetCapacityManager();
+            journal_.Reset(routes_);
         }
 
         void Reset(Routes&& routes) {
@@ -41,6 +49,8 @@ namespace vrp {
             routes_ = std::move(routes);
             operator_space_.Reset();
             cost_manager_.Reset();
+            ResetCapacityManager();
+            journal_.Reset(routes_);
         }
 
         Int EvaluateSolution() override {
@@ -57,8 +67,7 @@ namespace vrp {
         }
 
         Int EvaluateNeighbor(Int neighbor_i) override {
-            const Operator* op = problem_.operator_space()->GetNeighbor(neighbor_i);
-            return problem_.EvaluateDelta(*op) + problem_.GetTotalCost();;
+            return problem_.EvaluateNeighbor(neighbor_i) + problem_.GetTotalCost();
         }
 
         std::optional<Int> Select() override {
@@ -70,12 +79,13 @@ namespace vrp {
             const Operator* op = problem_.operator_space()->GetNeighbor(neighbor_i);
             if (!problem_.Step(*op))
                 return false;
+            journal_.Record(*op);
             tabu_table_.Tabu(problem_.EncodeOperator(*op), tenure_);
             return true;
         }
 
         void RecordSolution() override {
-            best_routes_ = *(problem_.routes());
+            journal_.Commit(routes_);
         }
 
         void Update() override {
@@ -87,8 +97,22 @@ namespace vrp {
             return tenure_;
         }
 
+        // Sets the demands of the nodes and the capacities of the routes, whose excess loads are penalized by the
+        // cost of each unit. They apply from the next Reset(). Without them, the routes are not capacitated.
+        void set_capacities(std::vector<Int> demands, std::vector<Int> capacities, Int penalty = 1) {
+            demands_ = std::move(demands);
+            capacities_ = std::move(capacities);
+            capacity_penalty_ = penalty;
+        }
+
+        // Restricts the neighbors of each iteration to the moves of the nodes around the previous steps, with the
+        // don't-look bits of the operator space.
+        void set_dont_look_bits(bool dont_look_bits) {
+            operator_space_.set_dont_look_bits(dont_look_bits);
+        }
+
         const Routes& best_routes() const {
-            return best_routes_;
+            return journal_.best();
         }
 
         void set_tenure(Int num) {
@@ -96,12 +120,26 @@ namespace vrp {
         }
 
     protected:
+        void ResetCapacityManager() {
+            capacity_manager_ = CapacityCostManager(
+                routes_,
+                demands_.empty() ? std::vector<Int>(routes_.num_nodes(), 0) : demands_,
+                capacities_.empty() ? std::vector<Int>(routes_.num_routes(), 0) : capacities_,
+                capacity_penalty_
+            );
+            capacity_manager_.Reset();
+        }
+
         Int tenure_;
         Routes routes_;
-        Routes best_routes_;
+        rlop::SolutionJournal<Routes, Operator> journal_; // The best routes, as the operators applied since.
         ArcCostManager cost_manager_;
+        CapacityCostManager capacity_manager_;
+        std::vector<Int> demands_; // The demands of the nodes, none if empty.
+        std::vector<Int> capacities_; // The capacities of the routes, none if empty.
+        Int capacity_penalty_ = 1;
         OperatorSpace operator_space_;
-        Problem problem_;
-        rlop::HashTabuTable<Int> tabu_table_;
+        BasicProblem<ArcCostManager, CapacityCostManager> problem_;
+        rlop::ExpiryHashTabuTable<Int> tabu_table_;
     };
 }
\ No newline at end of file
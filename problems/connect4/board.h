@@ -13,6 +13,7 @@ namespace connect4 {
         static constexpr int kH2_ = kHeight_ + 2;
         static constexpr int kCol1_ = (((bitboard)1<<kH1_)-(bitboard)1);
         static constexpr bitboard kBottom = 0b0000001000000100000010000001000000100000010000001;
+        static constexpr bitboard kBoardMask = kBottom * ((static_cast<bitboard>(1) << kHeight_) - 1);
 
         /*
         .  .  .  .  .  .  .
@@ -89,15 +90,7 @@ namespace connect4 {
         }
 
         virtual bool Win() const {
-            int current = 1 - num_moves_ % 2;
-            bitboard h = players_[current] & (players_[current] >> kH1_);
-            bitboard v = players_[current] & (players_[current] >> 1);
-            bitboard d1 = players_[current] & (players_[current] >> kHeight_) ;
-            bitboard d2 = players_[current] & (players_[current] >> kH2_);
-            return (h & (h >> (2 * kH1_))) ||
-                (v  & (v >> 2)) ||
-                (d1 & (d1 >> (2 * kHeight_))) || 
-                (d2 & (d2 >> (2 * kH2_)));
+            return HasFour(players_[1 - num_moves_ % 2]);
         }
 
         virtual bitboard PositionEncode() const {
@@ -117,6 +110,142 @@ namespace connect4 {
             players_[num_moves_ % 2] ^= static_cast<bitboard>(1) << (--heights_[col] + kH1_ * col);
         }
 
+        // Returns the discs of both players.
+        bitboard Mask() const {
+            return players_[0] | players_[1];
+        }
+
+        // Returns the cells a disc can be dropped on, one per playable column.
+        bitboard PossibleMask() const {
+            return (Mask() + kBottom) & kBoardMask;
+        }
+
+        // Returns the empty cells which would complete a line of four for the player to move.
+        bitboard WinningSpots() const {
+            return WinningSpots(players_[num_moves_ % 2], Mask());
+        }
+
+        // Returns the empty cells which would complete a line of four for the opponent of the player to move.
+        bitboard OpponentWinningSpots() const {
+            return WinningSpots(players_[1 - num_moves_ % 2], Mask());
+        }
+
+        // Returns the cells the player to move can drop a disc on to win immediately.
+        bitboard WinningMoves() const {
+            return WinningSpots() & PossibleMask();
+        }
+
+        bool CanWinNext() const {
+            return WinningMoves() != 0;
+        }
+
+        // Returns the cells the player to move can drop a disc on without letting the opponent win at the next move,
+        // assuming the player to move cannot win immediately. If the opponent threatens to win on a playable cell, it
+        // is the only candidate. If the opponent threatens on two playable cells, or every move lets the opponent
+        // drop a disc on a winning spot, no cell is returned and the game is lost.
+        bitboard NonLosingMoves() const {
+            bitboard possible = PossibleMask();
+            bitboard opponent_spots = OpponentWinningSpots();
+            bitboard forced = possible & opponent_spots;
+            if (forced) {
+                if (forced & (forced - 1))
+                    return 0;
+                possible = forced;
+            }
+            return possible & ~(opponent_spots >> 1);
+        }
+
+        // Scores a move by the number of winning spots the player to move would have after playing it.
+        //
+        // Parameters:
+        //   move: The cell the disc is dropped on, one of PossibleMask().
+        //
+        // Returns:
+        //   int: The number of threats created by the move.
+        int MoveScore(bitboard move) const {
+            return PopCount(WinningSpots(players_[num_moves_ % 2] | move, Mask()));
+        }
+
+        // Plays `num_playouts` games from the board to their end by uniformly random moves, each move a few bit
+        // operations on copies of the bitboards, with no virtual call nor full check of the board, and returns the mean
+        // outcome for `player`: 1 for a win, -1 for a loss and 0 for a draw. A board already over scores its outcome.
+        //
+        // Parameters:
+        //   num_playouts: The number of games played.
+        //   player: The player scored, 0 for the first one to move.
+        //   rand: The random generator, with a method Uniform(min, max) drawing in [min, max].
+        //   num_plies: If given, the moves played by all the games are added to it.
+        template <typename TRandom>
+        double RandomPlayouts(int num_playouts, int player, TRandom* rand, int64_t* num_plies = nullptr) const {
+            if (Win())
+                return (1 - num_moves_ % 2) == player ? 1 : -1;
+            int total = 0;
+            for (int i=0; i<num_playouts; ++i) {
+                std::array<bitboard, 2> position = players_;
+                bitboard mask = Mask();
+                int moves = num_moves_;
+                while (moves < kSize_) {
+                    bitboard possible = (mask + kBottom) & kBoardMask;
+                    for (int k = rand->Uniform(0, PopCount(possible) - 1); k > 0; --k) {
+                        possible &= possible - 1;
+                    }
+                    bitboard move = possible & (~possible + 1);
+                    int current = moves & 1;
+                    position[current] |= move;
+                    mask |= move;
+                    ++moves;
+                    if (HasFour(position[current])) {
+                        total += current == player ? 1 : -1;
+                        break;
+                    }
+                }
+                if (num_plies != nullptr)
+                    *num_plies += moves - num_moves_;
+            }
+            return num_playouts > 0 ? total / (double)num_playouts : 0.0;
+        }
+
+        // Returns whether the discs of a player hold a line of four.
+        static bool HasFour(bitboard position) {
+            bitboard h = position & (position >> kH1_);
+            bitboard v = position & (position >> 1);
+            bitboard d1 = position & (position >> kHeight_);
+            bitboard d2 = position & (position >> kH2_);
+            return (h & (h >> (2 * kH1_))) ||
+                (v  & (v >> 2)) ||
+                (d1 & (d1 >> (2 * kHeight_))) || 
+                (d2 & (d2 >> (2 * kH2_)));
+        }
+
+        // Returns the cells of a column.
+        static constexpr bitboard ColumnMask(int col) {
+            return static_cast<bitboard>(kCol1_ >> 1) << (kH1_ * col);
+        }
+
+        // Returns the empty cells which would complete a line of four for the player owning `position`.
+        //
+        // Parameters:
+        //   position: The discs of the player.
+        //   mask: The discs of both players.
+        static bitboard WinningSpots(bitboard position, bitboard mask) {
+            // Vertical lines.
+            bitboard r = (position << 1) & (position << 2) & (position << 3);
+            // Horizontal and diagonal lines, each as the shift of one cell along the line.
+            for (int shift : { kH1_, kHeight_, kH2_ }) {
+                bitboard p = (position << shift) & (position << 2 * shift);
+                r |= p & (position << 3 * shift);
+                r |= p & (position >> shift);
+                p = (position >> shift) & (position >> 2 * shift);
+                r |= p & (position << shift);
+                r |= p & (position >> 3 * shift);
+            }
+            return r & (kBoardMask ^ mask);
+        }
+
+        static int PopCount(bitboard m) {
+            return std::bitset<64>(m).count();
+        }
+
         int num_moves() const {
             return num_moves_;
         }
@@ -0,0 +1,91 @@
+#pragma once
+#include "problem.h"
+
+namespace multi_armed_bandit {
+    // A batch of independent bandits with the reward distributions of Problem, stored as structures of arrays. The
+    // values of an arm for all the instances are contiguous, at arm * num_instances() + instance, so that the
+    // instances are stepped together by loops over them, which the compiler vectorizes.
+    class BatchedProblem {
+    public:
+        BatchedProblem(Int num_instances, Int num_arms) : num_instances_(num_instances), num_arms_(num_arms) {}
+
+        virtual ~BatchedProblem() = default;
+
+        // Draws the means of the arms of each instance from the standard normal distribution.
+        virtual void Reset() {
+            means_.resize(num_arms_ * num_instances_);
+            rand_.FillNormal(means_.begin(), means_.end());
+            best_arms_.assign(num_instances_, 0);
+            best_means_.assign(num_instances_, std::numeric_limits<double>::lowest());
+            for (Int a=0; a<num_arms_; ++a) {
+                const double* means = &means_[a * num_instances_];
+                #pragma omp simd
+                for (Int b=0; b<num_instances_; ++b) {
+                    Int better = means[b] > best_means_[b];
+                    best_means_[b] = std::max(best_means_[b], means[b]);
+                    best_arms_[b] += better * (a - best_arms_[b]);
+                }
+            }
+            total_rewards_.assign(num_instances_, 0);
+            noises_.resize(num_instances_);
+        }
+
+        virtual void Reset(uint64_t seed) {
+            Seed(seed);
+            Reset();
+        }
+
+        void Seed(uint64_t seed) {
+            rand_.Seed(seed);
+        }
+
+        // Pulls one arm of each instance.
+        //
+        // Parameters:
+        //   actions: The arm pulled in each instance.
+        //   rewards: The reward of each instance, resized to num_instances().
+        virtual void Step(const std::vector<Int>& actions, std::vector<double>& rewards) {
+            rewards.resize(num_instances_);
+            rand_.FillNormal(noises_.begin(), noises_.end());
+            #pragma omp simd
+            for (Int b=0; b<num_instances_; ++b) {
+                rewards[b] = means_[actions[b] * num_instances_ + b] + noises_[b];
+                total_rewards_[b] += rewards[b];
+            }
+        }
+
+        double GetMean(Int instance, Int arm) const {
+            return means_[arm * num_instances_ + instance];
+        }
+
+        Int num_instances() const {
+            return num_instances_;
+        }
+
+        Int num_arms() const {
+            return num_arms_;
+        }
+
+        const std::vector<double>& means() const {
+            return means_;
+        }
+
+        const std::vector<Int>& best_arms() const {
+            return best_arms_;
+        }
+
+        const std::vector<double>& total_rewards() const {
+            return total_rewards_;
+        }
+
+    protected:
+        Int num_instances_;
+        Int num_arms_;
+        std::vector<double> means_;
+        std::vector<Int> best_arms_;
+        std::vector<double> best_means_;
+        std::vector<double> total_rewards_;
+        std::vector<double> noises_;
+        rlop::Random rand_;
+    };
+}
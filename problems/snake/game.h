@@ -1,6 +1,7 @@
 #include <SFML/Graphics.hpp>
 #include <SFML/Window.hpp>
 #include <ctime>
+#include "rlop/common/circular_deque.h"
 #include "rlop/common/utils.h"
 #include "rlop/common/random.h"
 
@@ -22,9 +23,12 @@ namespace snake {
         };
 
         struct Snake {
-            Snake(Int x, Int y, Int dir) : body({{x, y}}), dir(dir) {}
+            // The body holds up to `capacity` tiles, the head first.
+            Snake(Int x, Int y, Int dir, Int capacity) : body(capacity), dir(dir) {
+                body.PushBack({x, y});
+            }
 
-            std::vector<std::pair<Int, Int>> body;
+            rlop::CircularDeque<std::pair<Int, Int>> body;
             Int dir = kIntNull;
             Int len = 1;
             Int num_foods = 0;
@@ -35,16 +39,20 @@ namespace snake {
             num_snakes_(num_snakes),
             num_alives_(num_snakes),
             grid_(grid_height_, std::vector<Tile>(grid_width_))
-        {}
+        {
+            ResetFreeTiles();
+        }
 
         virtual ~Engine() = default;
 
         virtual void Reset() {
+            Unmark();
             num_steps_ = 0;
             num_alives_ = num_snakes_;
             grid_ = std::vector<std::vector<Tile>>(grid_height_, std::vector<Tile>(grid_width_));
             foods_.clear();
             SetSnakes();
+            ResetFreeTiles();
             SetFoods();
         }
 
@@ -57,26 +65,21 @@ namespace snake {
                 Int y = tiles[i] / grid_width_;
                 Int x = tiles[i] % grid_width_;
                 Int dir = rand_.Uniform(0, 3);
-                snakes_.emplace_back(x, y, dir);
+                // The head moves before the tail, so that a body spans one more tile than the grid at most.
+                snakes_.emplace_back(x, y, dir, grid_size_ + 1);
                 ++grid_[y][x].num_snakes;
             }
         }
 
+        // Places foods on free tiles drawn uniformly from the set of free tiles, in O(1) per food.
         virtual void SetFoods() {
-            if (foods_.size() >= min_num_foods_)
-                return;
-            std::vector<std::pair<Int, Int>> pos;
-            for (Int x = 0; x < grid_width_; ++x) {
-                for (Int y=0; y < grid_height_; ++y) {
-                    if (!grid_[y][x].has_food && grid_[y][x].num_snakes == 0) 
-                        pos.push_back({x, y});
-                }
-            }
-            Int num_foods = min_num_foods_ - foods_.size();
-            rand_.PartialShuffle(pos.begin(), pos.end(), num_foods);
-            for (Int i=0; i<num_foods; ++i) {
-                grid_[pos[i].second][pos[i].first].has_food = true;
-                foods_.push_back(pos[i]);
+            while (foods_.size() < min_num_foods_ && !free_tiles_.empty()) {
+                Int tile_i = free_tiles_[rand_.Uniform(Int(0), (Int)free_tiles_.size() - 1)];
+                std::pair<Int, Int> pos = { tile_i % grid_width_, tile_i / grid_width_ };
+                MutableTile(pos).has_food = true;
+                UpdateFreeTile(pos);
+                foods_.push_back(pos);
+                Log(kFoodPush, foods_.size() - 1, pos);
             }
         }
 
@@ -113,14 +116,14 @@ namespace snake {
         virtual bool Lookahead(Int snake_i, Int dir) const {
             if (dir  == GetReverseDir(snakes_[snake_i].dir))
                 return false;
-            auto head = GetNextPos(snakes_[snake_i].body.front(), dir);
+            auto head = GetNextPos(snakes_[snake_i].body.Front(), dir);
             if (CheckCollision(head))
                 return false;
             return true;
         }
 
         virtual const std::pair<Int, Int>& GetHead(Int snake_i) const {
-            return snakes_[snake_i].body.front();
+            return snakes_[snake_i].body.Front();
         }
 
         virtual Int GetMinFoodDistance(const std::pair<Int, Int>& head) const {
@@ -154,21 +157,23 @@ namespace snake {
             for (Int i=0; i<snakes_.size(); ++i) {
                 if (!snakes_[i].alive)
                     continue;
-                auto head = GetNextPos(snakes_[i].body.front(), snakes_[i].dir);
+                auto head = GetNextPos(snakes_[i].body.Front(), snakes_[i].dir);
                 if (OutOfBoundary(head)) {
                     snakes_[i].alive = false;
                     to_remove[i] = true;
                     --num_alives_;
                 }
                 else {
-                    snakes_[i].body.insert(snakes_[i].body.begin(), head);
-                    ++grid_[head.second][head.first].num_snakes;
+                    snakes_[i].body.PushFront(head);
+                    Log(kBodyPushFront, i, head);
+                    ++MutableTile(head).num_snakes;
+                    UpdateFreeTile(head);
                 }
             }
             for (Int i=0; i<snakes_.size(); ++i) {
                 if (!snakes_[i].alive)
                     continue;
-                auto head = snakes_[i].body.front();
+                auto head = snakes_[i].body.Front();
                 if (grid_[head.second][head.first].num_snakes > 1) {
                     snakes_[i].alive = false;
                     to_remove[i] = true;
@@ -189,28 +194,29 @@ namespace snake {
                         --num_alives_;
                     }
                     else {
-                        --grid_[snakes_[i].body.back().second][snakes_[i].body.back().first].num_snakes;
-                        snakes_[i].body.pop_back();
+                        PopTail(i);
                         --snakes_[i].len;
                     }
                 }
             }
             for (Int i=0; i<snakes_.size(); ++i) {
                 if (!snakes_[i].alive && to_remove[i]) {
-                    for (auto& p : snakes_[i].body) {
-                        --grid_[p.second][p.first].num_snakes;
+                    for (Int body_i=0; body_i<snakes_[i].body.Size(); ++body_i) {
+                        --MutableTile(snakes_[i].body[body_i]).num_snakes;
+                        UpdateFreeTile(snakes_[i].body[body_i]);
                     }
                 }
-                else if (snakes_[i].len < snakes_[i].body.size()) {
-                    --grid_[snakes_[i].body.back().second][snakes_[i].body.back().first].num_snakes;
-                    snakes_[i].body.pop_back();
+                else if (snakes_[i].len < snakes_[i].body.Size()) {
+                    PopTail(i);
                 }
                 else {
-                    std::pair<Int, Int> head = snakes_[i].body.front();
+                    std::pair<Int, Int> head = snakes_[i].body.Front();
                     for (Int i=0; i<foods_.size(); ++i) {
                         if (foods_[i].first == head.first && foods_[i].second == head.second) {
+                            Log(kFoodErase, i, foods_[i]);
                             foods_.erase(foods_.begin() + i);
-                            grid_[head.second][head.first].has_food = false;
+                            MutableTile(head).has_food = false;
+                            UpdateFreeTile(head);
                             break;
                         }
                     }
@@ -240,6 +246,81 @@ namespace snake {
             snakes_[i].dir = dir;
         }
 
+        // Marks the current state as the one restored by Rewind(), and from then on logs the changes of Update() to
+        // undo them, so that a search replaying moves from a state restores it at a cost proportional to the moves
+        // played, in place of copying the engine, whose grid is of the size of the board.
+        void Mark() {
+            marked_ = true;
+            log_.clear();
+            mark_.num_alives = num_alives_;
+            mark_.num_steps = num_steps_;
+            mark_.rand = rand_;
+            mark_.snakes.resize(snakes_.size());
+            for (Int i=0; i<snakes_.size(); ++i) {
+                mark_.snakes[i] = { snakes_[i].dir, snakes_[i].len, snakes_[i].num_foods, snakes_[i].alive };
+            }
+        }
+
+        // Restores the state of the last call to Mark(), which stays marked.
+        void Rewind() {
+            if (!marked_)
+                throw std::runtime_error("Engine: rewinds without a mark.");
+            for (auto it = log_.rbegin(); it != log_.rend(); ++it) {
+                switch (it->kind) {
+                case kTile:
+                    grid_[it->pos.second][it->pos.first] = it->tile;
+                    break;
+                case kFreeTileAppend:
+                    free_tile_indices_[free_tiles_.back()] = kIntNull;
+                    free_tiles_.pop_back();
+                    break;
+                case kFreeTileRemove:
+                    // Moves back the last tile, which took the place of the removed one, unless it was the one.
+                    if (it->index < free_tiles_.size()) {
+                        free_tiles_.push_back(free_tiles_[it->index]);
+                        free_tile_indices_[free_tiles_.back()] = free_tiles_.size() - 1;
+                        free_tiles_[it->index] = it->tile_i;
+                    }
+                    else
+                        free_tiles_.push_back(it->tile_i);
+                    free_tile_indices_[it->tile_i] = it->index;
+                    break;
+                case kBodyPushFront:
+                    snakes_[it->index].body.PopFront();
+                    break;
+                case kBodyPopBack:
+                    snakes_[it->index].body.PushBack(it->pos);
+                    break;
+                case kFoodErase:
+                    foods_.insert(foods_.begin() + it->index, it->pos);
+                    break;
+                case kFoodPush:
+                    foods_.pop_back();
+                    break;
+                }
+            }
+            log_.clear();
+            num_alives_ = mark_.num_alives;
+            num_steps_ = mark_.num_steps;
+            rand_ = mark_.rand;
+            for (Int i=0; i<snakes_.size(); ++i) {
+                snakes_[i].dir = mark_.snakes[i].dir;
+                snakes_[i].len = mark_.snakes[i].len;
+                snakes_[i].num_foods = mark_.snakes[i].num_foods;
+                snakes_[i].alive = mark_.snakes[i].alive;
+            }
+        }
+
+        // Stops logging the changes.
+        void Unmark() {
+            marked_ = false;
+            log_.clear();
+        }
+
+        bool marked() const {
+            return marked_;
+        }
+
         virtual bool IsStart() const {
             return num_steps_ == 0;
         }
@@ -301,6 +382,88 @@ namespace snake {
         }
 
     private:
+        // The kinds of the changes undone by Rewind().
+        enum ChangeKind { kTile, kBodyPushFront, kBodyPopBack, kFoodErase, kFoodPush, kFreeTileAppend, kFreeTileRemove };
+
+        // A change of the state, with the value it overwrote.
+        struct Change {
+            ChangeKind kind;
+            Int index; // The snake or the food changed, or the position of the free tile removed.
+            std::pair<Int, Int> pos;
+            Tile tile;
+            Int tile_i = kIntNull; // The free tile removed.
+        };
+
+        // The scalars of a snake at the mark, its body being restored from the log.
+        struct SnakeMark {
+            Int dir;
+            Int len;
+            Int num_foods;
+            bool alive;
+        };
+
+        struct MarkState {
+            Int num_alives = 0;
+            Int num_steps = 0;
+            rlop::Random rand;
+            std::vector<SnakeMark> snakes;
+        };
+
+        void Log(ChangeKind kind, Int index, const std::pair<Int, Int>& pos) {
+            if (marked_)
+                log_.push_back({ kind, index, pos, Tile() });
+        }
+
+        // Returns a tile to change, logging its value.
+        Tile& MutableTile(const std::pair<Int, Int>& pos) {
+            Tile& tile = grid_[pos.second][pos.first];
+            if (marked_)
+                log_.push_back({ kTile, 0, pos, tile });
+            return tile;
+        }
+
+        void PopTail(Int snake_i) {
+            auto tail = snakes_[snake_i].body.Back();
+            --MutableTile(tail).num_snakes;
+            UpdateFreeTile(tail);
+            snakes_[snake_i].body.PopBack();
+            Log(kBodyPopBack, snake_i, tail);
+        }
+
+        // Rebuilds the set of the free tiles, without snake nor food.
+        void ResetFreeTiles() {
+            free_tiles_.clear();
+            free_tile_indices_.assign(grid_size_, kIntNull);
+            for (Int y=0; y<grid_height_; ++y) {
+                for (Int x=0; x<grid_width_; ++x) {
+                    UpdateFreeTile({x, y});
+                }
+            }
+        }
+
+        // Adds a tile to the free tiles or removes it from them after a change, in O(1). The changes are logged, so
+        // that Rewind() restores the order of the free tiles, and the foods drawn from them after it.
+        void UpdateFreeTile(const std::pair<Int, Int>& pos) {
+            Int tile_i = pos.second * grid_width_ + pos.first;
+            const Tile& tile = grid_[pos.second][pos.first];
+            bool free = tile.num_snakes == 0 && !tile.has_food;
+            Int& index = free_tile_indices_[tile_i];
+            if (free && index == kIntNull) {
+                index = free_tiles_.size();
+                free_tiles_.push_back(tile_i);
+                if (marked_)
+                    log_.push_back({ kFreeTileAppend, index, pos, Tile() });
+            }
+            else if (!free && index != kIntNull) {
+                if (marked_)
+                    log_.push_back({ kFreeTileRemove, index, pos, Tile(), tile_i });
+                free_tiles_[index] = free_tiles_.back();
+                free_tile_indices_[free_tiles_.back()] = index;
+                free_tiles_.pop_back();
+                index = kIntNull;
+            }
+        }
+
         Int grid_width_ = 11;
         Int grid_height_ = 7;
         Int grid_size_ = grid_width_ * grid_height_;
@@ -313,7 +476,12 @@ namespace snake {
         std::vector<std::vector<Tile>> grid_;
         std::vector<Snake> snakes_;
         std::vector<std::pair<Int, Int>> foods_;
+        std::vector<Int> free_tiles_; // The tiles without snake nor food, as indices y * grid_width + x.
+        std::vector<Int> free_tile_indices_; // The position of each tile in free_tiles_, or kIntNull.
         rlop::Random rand_;
+        bool marked_ = false;
+        std::vector<Change> log_; // The changes since the mark, in order.
+        MarkState mark_;
     };
 
     class Graphics {
@@ -414,7 +582,7 @@ namespace snake {
                         for (Int snake_i=0; snake_i<engines_[engine_i]->snakes().size(); ++snake_i) {
                             if (!engines_[engine_i]->snakes()[snake_i].alive)
                                 continue;
-                            auto& body = engines_[engine_i]->snakes()[snake_i].body.front();
+                            auto& body = engines_[engine_i]->snakes()[snake_i].body.Front();
                             if (snake_i == 0) 
                                 snake_head_.setFillColor(sf::Color::Green); 
                             else if (snake_i == 1)
@@ -425,7 +593,7 @@ namespace snake {
                                 snake_head_.setFillColor(sf::Color::Cyan);  
                             snake_head_.setPosition(sub_x + gap_ + body.first * tile_size_, sub_y + gap_ + body.second * tile_size_);
                             window_.draw(snake_head_);
-                            for (Int body_i=1; body_i<engines_[engine_i]->snakes()[snake_i].body.size(); ++body_i) {
+                            for (Int body_i=1; body_i<engines_[engine_i]->snakes()[snake_i].body.Size(); ++body_i) {
                                 auto& body = engines_[engine_i]->snakes()[snake_i].body[body_i];
                                 if (snake_i == 0) 
                                     snake_rect_.setFillColor(sf::Color(0, std::max(255 - 2*body_i, Int(30)), 0, std::max(255 - 2*body_i, Int(30)))); 
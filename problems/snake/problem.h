@@ -1,8 +1,45 @@
 #pragma once
 #include "game.h"
 #include "rlop/common/torch_utils.h"
+#include "rlop/rl/observation_codecs.h"
+#include "rlop/rl/vector_env.h"
 
 namespace snake {
+    // Writes the observation of an engine into the contiguous planes of `data`, which are zero: the foods, and the
+    // head, the old head, the body and the tail of each snake. The offsets of the cells set are appended to `cells`
+    // if given.
+    inline void WriteObservation(const Engine& engine, float* data, std::vector<Int>* cells = nullptr) {
+        Int size = engine.grid_size();
+        Int width = engine.grid_width();
+        auto set = [&](Int cell, float value) {
+            data[cell] = value;
+            if (cells != nullptr)
+                cells->push_back(cell);
+        };
+        for (const auto& pos : engine.foods()) {
+            set(pos.second*width+pos.first, 1.0);
+        }
+        Int planes = size;
+        for (const auto& snake : engine.snakes()) {
+            Int head = planes;
+            Int old_head = planes + size;
+            Int body = planes + 2 * size;
+            Int tail = planes + 3 * size;
+            if (snake.alive) {
+                set(head + snake.body.Front().second*width+snake.body.Front().first, 1.0);
+                set(tail + snake.body.Back().second*width+snake.body.Back().first, 1.0);
+                Int rev_dir = engine.GetReverseDir(snake.dir);
+                auto pos = engine.GetNextPos(snake.body.Front(), rev_dir);
+                if (!engine.OutOfBoundary(pos) && engine.num_steps() != 0)
+                    set(old_head + pos.second*width+pos.first, 1.0);
+                for (Int i=0; i<snake.body.Size(); ++i) {
+                    set(body + snake.body[i].second*width+snake.body[i].first, 1.0 - 1.0 / (size + 1) * i);
+                }
+            }
+            planes += 4 * size;
+        }
+    }
+
     class Problem {
     public:
         Problem(bool render = false) {
@@ -32,36 +69,25 @@ namespace snake {
             engine_ = engine;
         }
 
+        // Marks the current state to rewind to, as Engine::Mark().
+        virtual void Mark() {
+            engine_.Mark();
+        }
+
+        // Restores the marked state, as Engine::Rewind().
+        virtual void Rewind() {
+            engine_.Rewind();
+        }
+
+        virtual void Rewind(uint64_t seed) {
+            Rewind();
+            engine_.set_seed(seed);
+        }
+
         virtual torch::Tensor GetObservation() const {
-            std::vector<float> food(grid_size(), 0); 
-            for (const auto& pos : engine_.foods()) {
-                food[pos.second*grid_width()+pos.first] = 1.0;
-            }
-            std::vector<torch::Tensor> channels;
-            channels.reserve(5);
-            channels.push_back(torch::tensor(food).view({-1, grid_width()}));
-            for (const auto& snake : engine_.snakes()) {
-                std::vector<float> head(grid_size(), 0);
-                std::vector<float> body(grid_size(), 0);
-                std::vector<float> tail(grid_size(), 0);
-                std::vector<float> old_head(grid_size(), 0);
-                if (snake.alive) {
-                    head[snake.body.front().second*grid_width()+snake.body.front().first] = 1.0;
-                    tail[snake.body.back().second*grid_width()+snake.body.back().first] = 1.0;
-                    Int rev_dir = engine_.GetReverseDir(snake.dir);
-                    auto pos = engine_.GetNextPos(snake.body.front(), rev_dir);
-                    if (!engine_.OutOfBoundary(pos) && engine_.num_steps() != 0)
-                        old_head[pos.second*grid_width()+pos.first] = 1.0; 
-                    for (Int i=0; i<snake.body.size(); ++i) {
-                        body[snake.body[i].second*grid_width()+snake.body[i].first] = 1.0 - 1.0 / (grid_size() + 1) * i;
-                    }
-                }
-                channels.push_back(torch::tensor(head).view({-1, grid_width()}));
-                channels.push_back(torch::tensor(old_head).view({-1, grid_width()}));
-                channels.push_back(torch::tensor(body).view({-1, grid_width()}));
-                channels.push_back(torch::tensor(tail).view({-1, grid_width()}));
-            }
-            return torch::stack(channels);
+            torch::Tensor observation = torch::zeros({ 1 + 4 * (Int)engine_.snakes().size(), grid_height(), grid_width() }, torch::kFloat32);
+            WriteObservation(engine_, observation.data_ptr<float>());
+            return observation;
         }
 
         virtual Int NumActions() const {
@@ -125,7 +151,7 @@ namespace snake {
 
     class VectorProblem {
     public:
-        VectorProblem(Int num_envs, bool render = false) : engines_(num_envs) {
+        VectorProblem(Int num_envs, bool render = false) : engines_(num_envs), observation_caches_(num_envs) {
             if (render) {
                 std::vector<const Engine*> engine_ptrs;
                 engine_ptrs.reserve(num_envs);
@@ -157,35 +183,56 @@ namespace snake {
         }
 
         virtual torch::Tensor GetObservation(Int env_i) const {
-            std::vector<float> food(grid_size(), 0); 
-            for (const auto& pos : engines_[env_i].foods()) {
-                food[pos.second*grid_width()+pos.first] = 1.0;
-            }
-            std::vector<torch::Tensor> channels;
-            channels.reserve(5);
-            channels.push_back(torch::tensor(food).view({-1, grid_width()}));
-            for (const auto& snake : engines_[env_i].snakes()) {
-                std::vector<float> head(grid_size(), 0);
-                std::vector<float> body(grid_size(), 0);
-                std::vector<float> tail(grid_size(), 0);
-                std::vector<float> old_head(grid_size(), 0);
-                if (snake.alive) {
-                    head[snake.body.front().second*grid_width()+snake.body.front().first] = 1.0;
-                    tail[snake.body.back().second*grid_width()+snake.body.back().first] = 1.0;
-                    Int rev_dir = engines_[env_i].GetReverseDir(snake.dir);
-                    auto pos = engines_[env_i].GetNextPos(snake.body.front(), rev_dir);
-                    if (!engines_[env_i].OutOfBoundary(pos) && engines_[env_i].num_steps() != 0)
-                        old_head[pos.second*grid_width()+pos.first] = 1.0; 
-                    for (Int i=0; i<snake.body.size(); ++i) {
-                        body[snake.body[i].second*grid_width()+snake.body[i].first] = 1.0 - 1.0 / (grid_size() + 1) * i;
-                    }
+            torch::Tensor observation = torch::empty({ 1 + 4 * (Int)engines_[env_i].snakes().size(), grid_height(), grid_width() }, torch::kFloat32);
+            WriteObservation(env_i, observation.data_ptr<float>());
+            return observation;
+        }
+
+        // Writes the observation of a problem into the contiguous planes of `data`: the foods, and the head, the old
+        // head, the body and the tail of each snake.
+        void WriteObservation(Int env_i, float* data) const {
+            std::fill(data, data + ObservationSize(env_i), 0.0f);
+            snake::WriteObservation(engines_[env_i], data);
+        }
+
+        // Writes the observation of a problem into `data` as WriteObservation(), but only updates the cells that
+        // changed since the last write of the problem to the same address: the cells set then are cleared, and those
+        // of the current state set, in place of clearing all the planes. The memory must not be written by others
+        // between the writes, except to zero. The last addresses of each problem are remembered, so that the sets of
+        // buffers cycled by rlop::VectorEnv are all updated incrementally. Each problem may be written from a
+        // different thread.
+        void UpdateObservation(Int env_i, float* data) {
+            auto& caches = observation_caches_[env_i];
+            auto it = std::find_if(caches.begin(), caches.end(), [&](const ObservationCache& cache) { return cache.data == data; });
+            if (it != caches.end()) {
+                for (Int cell : it->cells) {
+                    data[cell] = 0.0f;
                 }
-                channels.push_back(torch::tensor(head).view({-1, grid_width()}));
-                channels.push_back(torch::tensor(old_head).view({-1, grid_width()}));
-                channels.push_back(torch::tensor(body).view({-1, grid_width()}));
-                channels.push_back(torch::tensor(tail).view({-1, grid_width()}));
             }
-            return torch::stack(channels);
+            else {
+                // A new address takes the place of the oldest one.
+                if (caches.size() < kNumObservationCaches)
+                    caches.emplace_back();
+                else
+                    std::rotate(caches.begin(), caches.begin() + 1, caches.end());
+                it = caches.end() - 1;
+                it->data = data;
+                std::fill(data, data + ObservationSize(env_i), 0.0f);
+            }
+            it->cells.clear();
+            snake::WriteObservation(engines_[env_i], data, &it->cells);
+        }
+
+        // Updates the observations of all the problems, in parallel, in a contiguous float tensor of shape
+        // {num_problems, C, H, W} on the CPU allocated once by the caller, as UpdateObservation().
+        void UpdateObservations(const torch::Tensor& observations) {
+            if (!observations.is_contiguous() || observations.scalar_type() != torch::kFloat32 || !observations.device().is_cpu() || observations.size(0) != num_problems())
+                throw std::runtime_error("VectorProblem: observations must be a contiguous float tensor on the CPU of a row per problem.");
+            float* data = observations.data_ptr<float>();
+            Int stride = observations.stride(0);
+            rlop::ThreadPool::Global().ParallelFor(0, num_problems(), [&](Int env_i) {
+                UpdateObservation(env_i, data + env_i * stride);
+            });
         }
 
         virtual Int NumActions() const {
@@ -238,6 +285,15 @@ namespace snake {
             return {};
         }
 
+        // Returns a codec storing the observations in the buffers in 1.5 bytes per cell instead of 20: the food, head,
+        // old head and tail planes are binary and bit-packed, and the body plane, whose values are multiples of
+        // 1 / (grid_size + 1), is quantized, exactly up to 254 cells.
+        std::shared_ptr<rlop::ObservationCodec> MakeObservationCodec() const {
+            auto binary = std::make_shared<rlop::BitPackedCodec>();
+            auto body = std::make_shared<rlop::QuantizedCodec>(1.0 / std::min<Int>(grid_size() + 1, 255));
+            return std::make_shared<rlop::ChannelSplitCodec>(std::vector<Int>{ 3, 1, 1 }, std::vector<std::shared_ptr<rlop::ObservationCodec>>{ binary, body, binary });
+        }
+
         Int max_num_steps() const {
             return engines_[0].max_num_steps();
         }
@@ -246,8 +302,68 @@ namespace snake {
             return engines_;
         }
 
+        // Returns the problems as environments of rlop::VectorEnv, which refer to this vector problem.
+        std::vector<std::shared_ptr<rlop::Env>> MakeEnvs();
+
     protected:
+        // Returns the number of floats of the observation of a problem.
+        Int ObservationSize(Int env_i) const {
+            return (1 + 4 * (Int)engines_[env_i].snakes().size()) * grid_size();
+        }
+
+        // The cells set by the last write of the observation of a problem to an address.
+        struct ObservationCache {
+            const float* data = nullptr;
+            std::vector<Int> cells;
+        };
+
+        static constexpr Int kNumObservationCaches = 4;
+
         std::vector<Engine> engines_;
         std::unique_ptr<Graphics> graphics_ = nullptr;
+        std::vector<std::vector<ObservationCache>> observation_caches_; // The caches of each problem, the oldest first.
     };
+
+    // A problem of a VectorProblem as an environment of rlop::VectorEnv, which rewards the foods eaten and 0.001 per
+    // step, and, for a snake alive at the end of an episode, the minimum number of foods and 0.001 per step of the
+    // episode. The episodes end by termination.
+    class ProblemEnv : public rlop::Env {
+    public:
+        ProblemEnv(VectorProblem* problem, Int env_i) : problem_(problem), env_i_(env_i) {}
+
+        virtual void Reset() override {
+            problem_->Reset(env_i_);
+        }
+
+        virtual rlop::EnvStep Step(const torch::Tensor& action) override {
+            const Engine& engine = problem_->engines()[env_i_];
+            Int num_foods = engine.snakes()[0].num_foods;
+            rlop::EnvStep step;
+            if (!problem_->Step(env_i_, { problem_->GetAction(action.item<Int>()) })) {
+                if (engine.snakes()[0].alive)
+                    step.reward = engine.snakes()[0].num_foods - num_foods + engine.min_num_foods() + 0.001 * engine.num_steps();
+                step.terminated = true;
+            }
+            else
+                step.reward = engine.snakes()[0].num_foods - num_foods + 0.001;
+            return step;
+        }
+
+        virtual void Observe(const torch::Tensor& observation) const override {
+            problem_->UpdateObservation(env_i_, observation.data_ptr<float>());
+        }
+
+    protected:
+        VectorProblem* problem_;
+        Int env_i_;
+    };
+
+    inline std::vector<std::shared_ptr<rlop::Env>> VectorProblem::MakeEnvs() {
+        std::vector<std::shared_ptr<rlop::Env>> envs;
+        envs.reserve(num_problems());
+        for (Int i=0; i<num_problems(); ++i) {
+            envs.push_back(std::make_shared<ProblemEnv>(this, i));
+        }
+        return envs;
+    }
 }
\ No newline at end of file
@@ -0,0 +1,136 @@
+#pragma once
+#include "cost_manager.h"
+
+namespace vrp {
+    // Penalizes the load of each route beyond the capacity of its vehicle, so that a capacitated problem is solved by
+    // minimizing the arc costs plus the penalized excess loads. The load of each route is kept, which evaluates the
+    // operators between two routes in O(1), while the operators within a route never change the loads.
+    class CapacityCostManager : public CostManager {
+    public:
+        CapacityCostManager() = default;
+
+        // Parameters:
+        //   routes: The routes whose loads are managed.
+        //   demands: The demand of each node, sentinels excluded.
+        //   capacities: The capacity of the vehicle of each route.
+        //   penalty: The cost of each unit of load beyond the capacity.
+        CapacityCostManager(const Routes& routes, std::vector<Int> demands, std::vector<Int> capacities, Int penalty = 1) :
+            routes_(&routes),
+            demands_(std::move(demands)),
+            capacities_(std::move(capacities)),
+            penalty_(penalty)
+        {}
+
+        virtual ~CapacityCostManager() = default;
+
+        virtual void Reset() override {
+            if (demands_.size() != routes_->num_nodes() || capacities_.size() != routes_->num_routes())
+                throw std::runtime_error("CapacityCostManager: the demands or capacities do not match the routes.");
+            route_loads_.assign(routes_->num_routes(), 0);
+            total_cost_ = 0;
+            for (Int ri=0; ri<routes_->num_routes(); ++ri) {
+                route_loads_[ri] = ComputeLoad(ri);
+                total_cost_ += GetExcessCost(ri, route_loads_[ri]);
+            }
+        }
+
+        virtual void Reset(const Routes& routes) {
+            routes_ = &routes;
+            Reset();
+        }
+
+        virtual Int EvaluateDelta(const Operator& op) const override {
+            Int from_node = op.from_node();
+            Int to_node = op.to_node();
+            switch (op.GetType()) {
+                case Operator::Type::kInsertion: {
+                    if (!routes_->IsInsertable(from_node, to_node))
+                        return std::numeric_limits<Int>::max();
+                    return GetLoadDelta(routes_->GetRoute(to_node), demands_[from_node]);
+                }
+                case Operator::Type::kSwap: {
+                    if (!routes_->IsSwappable(from_node, to_node))
+                        return std::numeric_limits<Int>::max();
+                    Int from_route = routes_->GetRoute(from_node);
+                    Int to_route = routes_->GetRoute(to_node);
+                    if (from_route == to_route)
+                        return 0;
+                    Int exchanged = demands_[to_node] - demands_[from_node];
+                    return GetLoadDelta(from_route, exchanged) + GetLoadDelta(to_route, -exchanged);
+                }
+                case Operator::Type::kMoving: {
+                    if (!routes_->IsMovable(from_node, to_node))
+                        return std::numeric_limits<Int>::max();
+                    Int moved = routes_->GetLast(from_node);
+                    Int from_route = routes_->GetRoute(moved);
+                    Int to_route = routes_->GetRoute(to_node);
+                    if (from_route == to_route)
+                        return 0;
+                    return GetLoadDelta(from_route, -demands_[moved]) + GetLoadDelta(to_route, demands_[moved]);
+                }
+                case Operator::Type::kTwoOpt: {
+                    if (!routes_->IsTwoOptable(from_node, to_node))
+                        return std::numeric_limits<Int>::max();
+                    return 0;
+                }
+            }
+            return 0;
+        }
+
+        // The loads are updated by Synchronize(), once the routes are modified.
+        virtual void Step(const Operator& op) override {}
+
+        // Recomputes the loads of the routes of the operator. These are the only routes an operator modifies, in both
+        // directions.
+        virtual void Synchronize(const Operator& op) override {
+            Int from_route = routes_->GetRoute(op.from_node());
+            Int to_route = routes_->GetRoute(op.to_node());
+            if (from_route != kIntNull)
+                UpdateLoad(from_route);
+            if (to_route != kIntNull && to_route != from_route)
+                UpdateLoad(to_route);
+        }
+
+        Int ComputeLoad(Int route) const {
+            Int load = 0;
+            for (Int ni=routes_->GetStart(route); ni!=routes_->GetSentinel(route); ni=routes_->GetNext(ni))
+                load += demands_[ni];
+            return load;
+        }
+
+        Int GetExcessCost(Int route, Int load) const {
+            return penalty_ * std::max<Int>(load - capacities_[route], 0);
+        }
+
+        Int route_load(Int route) const {
+            return route_loads_[route];
+        }
+
+        Int penalty() const {
+            return penalty_;
+        }
+
+        // Sets the cost of each unit of excess load, and recomputes the total cost with it.
+        void set_penalty(Int penalty) {
+            penalty_ = penalty;
+            Reset();
+        }
+
+    protected:
+        Int GetLoadDelta(Int route, Int load_delta) const {
+            return GetExcessCost(route, route_loads_[route] + load_delta) - GetExcessCost(route, route_loads_[route]);
+        }
+
+        void UpdateLoad(Int route) {
+            total_cost_ -= GetExcessCost(route, route_loads_[route]);
+            route_loads_[route] = ComputeLoad(route);
+            total_cost_ += GetExcessCost(route, route_loads_[route]);
+        }
+
+        const Routes* routes_ = nullptr;
+        std::vector<Int> demands_;
+        std::vector<Int> capacities_;
+        Int penalty_ = 1;
+        std::vector<Int> route_loads_;
+    };
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include "routes.h"
+#include "distance_matrix.h"
 
 namespace vrp {
     class CostManager {
@@ -16,6 +17,10 @@ namespace vrp {
 
         virtual void Undo(const Operator& op) {}
 
+        // Called once the routes are modified by a step or an undo of the operator, after Step() and Undo(), to
+        // update the state derived from the routes.
+        virtual void Synchronize(const Operator& op) {}
+
         Int total_cost() const {
             return total_cost_;
         }
@@ -24,16 +29,29 @@ namespace vrp {
         Int total_cost_ = 0; 
     };
 
-    class ArcCostManager : public CostManager {
+    // Manages the total cost of the arcs of the routes. The cumulative costs of the arcs from the sentinel to each node
+    // are kept in both directions, so that the cost of a reversed segment, and thus the delta of a 2-opt, are computed
+    // in O(1) with asymmetric costs.
+    //
+    // Template Parameters:
+    //   TArcCost: The callable type returning the cost of the arc between two nodes. A concrete type such as
+    //             DistanceMatrix or EuclideanCost lets the compiler inline the lookups of the evaluation loops, while
+    //             ArcCostManager type-erases it with std::function.
+    template<typename TArcCost>
+    class BasicArcCostManager : public CostManager {
     public:
-        ArcCostManager() = default;
+        BasicArcCostManager() = default;
         
-        ArcCostManager(const Routes& routes, const std::function<Int(Int, Int)>& get_cost) : routes_(&routes), get_cost_(get_cost) {}
+        BasicArcCostManager(const Routes& routes, const TArcCost& get_cost) : routes_(&routes), get_cost_(get_cost) {}
         
-        virtual ~ArcCostManager() = default;
+        virtual ~BasicArcCostManager() = default;
 
         virtual void Reset() override {
             total_cost_ = ComputeTotalCost(*routes_, get_cost_);    
+            forward_costs_.assign(routes_->num_nodes() + routes_->num_routes(), 0);
+            backward_costs_.assign(routes_->num_nodes() + routes_->num_routes(), 0);
+            for (Int ri=0; ri<routes_->num_routes(); ++ri)
+                UpdateCumulativeCosts(ri);
         }
         
         virtual void Reset(const Routes& routes) {
@@ -41,7 +59,7 @@ namespace vrp {
             Reset();
         }
 
-        static Int ComputeTotalCost(const Routes& routes, const std::function<Int(Int, Int)>& get_cost) {
+        static Int ComputeTotalCost(const Routes& routes, const TArcCost& get_cost) {
             Int total_cost = 0;    
             for (Int ri=0; ri<routes.num_routes(); ++ri) {
                 total_cost += get_cost(routes.GetSentinel(ri), routes.GetStart(ri));
@@ -52,15 +70,19 @@ namespace vrp {
             return total_cost;
         }
 
+        // Dispatches an operator to the overload of its type. The typed operators are built on the stack, since they
+        // are plain values.
         virtual Int EvaluateDelta(const Operator& op) const { 
-            if (op.GetType() == Operator::Type::kInsertion)
-                return EvaluateDelta(static_cast<const Insertion&>(op));        
-            else if (op.GetType() == Operator::Type::kSwap)
-                return EvaluateDelta(static_cast<const Swapping&>(op));
-            else if (op.GetType() == Operator::Type::kMoving)
-                return EvaluateDelta(static_cast<const Moving&>(op));    
-            else if (op.GetType() == Operator::Type::kTwoOpt)
-                return EvaluateDelta(static_cast<const TwoOpting&>(op));
+            switch (op.GetType()) {
+                case Operator::Type::kInsertion:
+                    return EvaluateDelta(Insertion(op.from_node(), op.to_node()));
+                case Operator::Type::kSwap:
+                    return EvaluateDelta(Swapping(op.from_node(), op.to_node()));
+                case Operator::Type::kMoving:
+                    return EvaluateDelta(Moving(op.from_node(), op.to_node()));
+                case Operator::Type::kTwoOpt:
+                    return EvaluateDelta(TwoOpting(op.from_node(), op.to_node()));
+            }
             return 0;
         }
 
@@ -116,37 +138,57 @@ namespace vrp {
             Int from_last = routes_->GetLast(two_opt.from_node());
             Int to_next = routes_->GetNext(two_opt.to_node());
             Int cost = 0;
-            for (Int node=two_opt.from_node(); node!=to_next; node=routes_->GetNext(node)) {
-                cost -= get_cost_(routes_->GetLast(node), node);
-                if (node != to_next)
-                    cost += get_cost_(routes_->GetNext(node), node); 
-            }
-            cost -= get_cost_(two_opt.to_node(), to_next); 
-            cost += get_cost_(two_opt.from_node(), to_next); 
-            cost += get_cost_(from_last, two_opt.to_node()); 
+            cost += get_cost_(from_last, two_opt.to_node());
+            cost += get_cost_(two_opt.from_node(), to_next);
+            cost -= get_cost_(from_last, two_opt.from_node());
+            cost -= get_cost_(two_opt.to_node(), to_next);
+            cost += SegmentCost(two_opt.from_node(), two_opt.to_node(), true);
+            cost -= SegmentCost(two_opt.from_node(), two_opt.to_node(), false);
             return cost;
         }
 
         virtual void Step(const Operator& op) override {
-            if (op.GetType() == Operator::Type::kInsertion)
-                Step(static_cast<const Insertion&>(op));
-            else if (op.GetType() == Operator::Type::kSwap)
-                Step(static_cast<const Swapping&>(op));
-            else if (op.GetType() == Operator::Type::kMoving)
-                Step(static_cast<const Moving&>(op));
-            else if (op.GetType() == Operator::Type::kTwoOpt)
-                Step(static_cast<const TwoOpting&>(op));
-        }
-
-        virtual void Undo(const Operator& op) {
-            if (op.GetType() == Operator::Type::kInsertion)
-                Undo(static_cast<const Insertion&>(op));    
-            else if (op.GetType() == Operator::Type::kSwap)
-                Undo(static_cast<const Swapping&>(op));    
-            else if (op.GetType() == Operator::Type::kMoving)
-                Undo(static_cast<const Moving&>(op));    
-            else if (op.GetType() == Operator::Type::kTwoOpt)
-                Undo(static_cast<const TwoOpting&>(op));    
+            switch (op.GetType()) {
+                case Operator::Type::kInsertion:
+                    Step(Insertion(op.from_node(), op.to_node()));
+                    break;
+                case Operator::Type::kSwap:
+                    Step(Swapping(op.from_node(), op.to_node()));
+                    break;
+                case Operator::Type::kMoving:
+                    Step(Moving(op.from_node(), op.to_node()));
+                    break;
+                case Operator::Type::kTwoOpt:
+                    Step(TwoOpting(op.from_node(), op.to_node()));
+                    break;
+            }
+        }
+
+        virtual void Undo(const Operator& op) override {
+            switch (op.GetType()) {
+                case Operator::Type::kInsertion:
+                    Undo(Insertion(op.from_node(), op.to_node()));
+                    break;
+                case Operator::Type::kSwap:
+                    Undo(Swapping(op.from_node(), op.to_node()));
+                    break;
+                case Operator::Type::kMoving:
+                    Undo(Moving(op.from_node(), op.to_node()));
+                    break;
+                case Operator::Type::kTwoOpt:
+                    Undo(TwoOpting(op.from_node(), op.to_node()));
+                    break;
+            }
+        }
+
+        // Updates the cumulative costs of the routes of the operator.
+        virtual void Synchronize(const Operator& op) override {
+            Int from_route = routes_->GetRoute(op.from_node());
+            Int to_route = routes_->GetRoute(op.to_node());
+            if (from_route != kIntNull)
+                UpdateCumulativeCosts(from_route);
+            if (to_route != kIntNull && to_route != from_route)
+                UpdateCumulativeCosts(to_route);
         }
 
         virtual void Step(const Insertion& insert) {
@@ -218,38 +260,57 @@ namespace vrp {
             total_cost_ += get_cost_(last2, move.to_node());
         }
 
+        // The routes are reversed already, while the cumulative costs are those before the step.
         virtual void Step(const TwoOpting& two_opt) {
-            Int from_next = routes_->GetNext(two_opt.from_node());
-            Int to_last = routes_->GetLast(two_opt.to_node());
-            for (Int node=two_opt.to_node(); node!=from_next; node=routes_->GetNext(node)) {
-                total_cost_ += get_cost_(routes_->GetLast(node), node);
-                if (node != two_opt.from_node())
-                    total_cost_ -= get_cost_(routes_->GetNext(node), node); 
-            }
-            total_cost_ += get_cost_(two_opt.from_node(), from_next); 
-            total_cost_ -= get_cost_(to_last, two_opt.from_node()); 
-            total_cost_ -= get_cost_(two_opt.to_node(), from_next); 
+            Int from_last = routes_->GetLast(two_opt.to_node());
+            Int to_next = routes_->GetNext(two_opt.from_node());
+            total_cost_ += get_cost_(from_last, two_opt.to_node());
+            total_cost_ += get_cost_(two_opt.from_node(), to_next);
+            total_cost_ -= get_cost_(from_last, two_opt.from_node());
+            total_cost_ -= get_cost_(two_opt.to_node(), to_next);
+            total_cost_ += SegmentCost(two_opt.from_node(), two_opt.to_node(), true);
+            total_cost_ -= SegmentCost(two_opt.from_node(), two_opt.to_node(), false);
         }
 
+        // The routes and the cumulative costs are those after the step, in which to_node is before from_node.
         virtual void Undo(const TwoOpting& two_opt) {
-            Int from_next = routes_->GetNext(two_opt.from_node());
-            Int to_last = routes_->GetLast(two_opt.to_node());
-            for (Int node=two_opt.to_node(); node!=from_next; node=routes_->GetNext(node)) {
-                total_cost_ -= get_cost_(routes_->GetLast(node), node);
-                if (node != two_opt.from_node())
-                    total_cost_ += get_cost_(routes_->GetNext(node), node); 
-            }
-            total_cost_ -= get_cost_(two_opt.from_node(), from_next); 
-            total_cost_ += get_cost_(to_last, two_opt.from_node()); 
-            total_cost_ += get_cost_(two_opt.to_node(), from_next); 
+            Int from_last = routes_->GetLast(two_opt.to_node());
+            Int to_next = routes_->GetNext(two_opt.from_node());
+            total_cost_ -= get_cost_(from_last, two_opt.to_node());
+            total_cost_ -= get_cost_(two_opt.from_node(), to_next);
+            total_cost_ += get_cost_(from_last, two_opt.from_node());
+            total_cost_ += get_cost_(two_opt.to_node(), to_next);
+            total_cost_ -= SegmentCost(two_opt.to_node(), two_opt.from_node(), false);
+            total_cost_ += SegmentCost(two_opt.to_node(), two_opt.from_node(), true);
         }
 
-        const std::function<Int(Int, Int)>& get_cost() const {
+        const TArcCost& get_cost() const {
             return get_cost_;
         }
 
     protected:
+        // Returns the cost of the arcs from first to last, two nodes of the same route with first not after last, or
+        // the cost of these arcs reversed.
+        Int SegmentCost(Int first, Int last, bool reversed) const {
+            const auto& costs = reversed ? backward_costs_ : forward_costs_;
+            return costs[last] - costs[first];
+        }
+
+        // Recomputes the cumulative costs of a route from its sentinel, in both directions.
+        void UpdateCumulativeCosts(Int route) {
+            Int sentinel = routes_->GetSentinel(route);
+            for (Int ni=routes_->GetStart(route); ni!=sentinel; ni=routes_->GetNext(ni)) {
+                Int last = routes_->GetLast(ni);
+                forward_costs_[ni] = forward_costs_[last] + get_cost_(last, ni);
+                backward_costs_[ni] = backward_costs_[last] + get_cost_(ni, last);
+            }
+        }
+
         const Routes* routes_ = nullptr;
-        std::function<Int(Int, Int)> get_cost_;
+        TArcCost get_cost_;
+        std::vector<Int> forward_costs_; // The cost of the arcs from the sentinel to each node.
+        std::vector<Int> backward_costs_; // The cost of the same arcs reversed.
     };
+
+    using ArcCostManager = BasicArcCostManager<std::function<Int(Int, Int)>>;
 }
\ No newline at end of file
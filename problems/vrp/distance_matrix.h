@@ -0,0 +1,124 @@
+#pragma once
+#include "operators.h"
+
+namespace vrp {
+    // A square matrix of arc costs stored row-major in one contiguous block. Each row starts on a cache line, so that
+    // scanning the costs from a node touches as few lines as possible. It is a callable cost, to be used as the cost
+    // type of BasicArcCostManager, whose lookups are then inlined.
+    class DistanceMatrix {
+    public:
+        DistanceMatrix() = default;
+
+        // Constructs a matrix of zero costs.
+        //
+        // Parameters:
+        //   size: The number of nodes, including the sentinels of the routes.
+        DistanceMatrix(Int size) : size_(size), stride_((size + kLineSize - 1) / kLineSize * kLineSize), lines_(size * stride_ / kLineSize) {}
+
+        // Constructs a matrix from the costs of a function.
+        //
+        // Parameters:
+        //   size: The number of nodes, including the sentinels of the routes.
+        //   get_cost: The cost of the arc between two nodes.
+        template<typename TArcCost>
+        DistanceMatrix(Int size, const TArcCost& get_cost) : DistanceMatrix(size) {
+            for (Int i=0; i<size_; ++i) {
+                for (Int j=0; j<size_; ++j)
+                    Set(i, j, get_cost(i, j));
+            }
+        }
+
+        // Constructs a matrix from nested rows.
+        DistanceMatrix(const std::vector<std::vector<Int>>& rows) : DistanceMatrix(rows.size()) {
+            for (Int i=0; i<size_; ++i) {
+                for (Int j=0; j<size_; ++j)
+                    Set(i, j, rows[i][j]);
+            }
+        }
+
+        Int operator()(Int from_node, Int to_node) const {
+            return data()[from_node * stride_ + to_node];
+        }
+
+        void Set(Int from_node, Int to_node, Int cost) {
+            data()[from_node * stride_ + to_node] = cost;
+        }
+
+        Int size() const {
+            return size_;
+        }
+
+    protected:
+        static constexpr Int kLineSize = 64 / sizeof(Int);
+
+        struct alignas(64) Line {
+            Int values[kLineSize];
+        };
+
+        Int* data() {
+            return reinterpret_cast<Int*>(lines_.data());
+        }
+
+        const Int* data() const {
+            return reinterpret_cast<const Int*>(lines_.data());
+        }
+
+        Int size_ = 0;
+        Int stride_ = 0; // The number of costs per row, rounded up to whole cache lines.
+        std::vector<Line> lines_;
+    };
+
+    // Euclidean arc costs between points, rounded to the nearest integer. The costs are computed on each lookup, which
+    // needs no memory beyond the coordinates, unless Cache() has stored them in a DistanceMatrix.
+    class EuclideanCost {
+    public:
+        EuclideanCost() = default;
+
+        // Constructs the costs between points.
+        //
+        // Parameters:
+        //   xs: The x coordinates of the nodes, including the sentinels of the routes.
+        //   ys: The y coordinates of the nodes.
+        //   scale: The factor applied to the distances before rounding, to keep decimals in integer costs.
+        EuclideanCost(std::vector<double> xs, std::vector<double> ys, double scale = 1) : xs_(std::move(xs)), ys_(std::move(ys)), scale_(scale) {
+            if (xs_.size() != ys_.size())
+                throw std::runtime_error("EuclideanCost: the coordinates have different sizes.");
+        }
+
+        Int operator()(Int from_node, Int to_node) const {
+            if (cached_)
+                return matrix_(from_node, to_node);
+            return Compute(from_node, to_node);
+        }
+
+        Int Compute(Int from_node, Int to_node) const {
+            return std::llround(scale_ * std::hypot(xs_[from_node] - xs_[to_node], ys_[from_node] - ys_[to_node]));
+        }
+
+        // Computes all costs once into a matrix, trading O(n^2) memory for lookups without square roots.
+        void Cache() {
+            matrix_ = DistanceMatrix(size(), [this](Int i, Int j) { return Compute(i, j); });
+            cached_ = true;
+        }
+
+        void ClearCache() {
+            matrix_ = DistanceMatrix();
+            cached_ = false;
+        }
+
+        bool cached() const {
+            return cached_;
+        }
+
+        Int size() const {
+            return xs_.size();
+        }
+
+    protected:
+        std::vector<double> xs_;
+        std::vector<double> ys_;
+        double scale_ = 1;
+        bool cached_ = false;
+        DistanceMatrix matrix_;
+    };
+}
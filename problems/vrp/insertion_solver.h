@@ -2,6 +2,7 @@
 #include "problem.h"
 #include "rlop/common/selectors.h"
 #include "rlop/common/base_algorithm.h"
+#include "rlop/common/thread_pool.h"
  
 namespace vrp {
     class InsertionSolver : public rlop::BaseAlgorithm {
@@ -17,15 +18,28 @@ namespace vrp {
             return problem_->EvaluateDelta(*op);
         }
 
+        // Selects the cheapest insertion. With several threads, the insertions are scanned in contiguous blocks on the
+        // shared pool and reduced in order, so the selection is the same as the one of the serial scan.
         virtual std::optional<Int> Select() {
             problem_->operator_space()->GenerateInsertions();
+            Int num_insertions = problem_->operator_space()->NumInsertions();
+            block_bests_.assign(num_threads_, kIntNull);
+            block_best_scores_.assign(num_threads_, std::numeric_limits<double>::max());
+            rlop::ParallelForBlocks(0, num_insertions, num_threads_, [&](Int block, Int begin, Int end) {
+                for (Int i=begin; i<end; ++i) {
+                    double score = Evaluate(i);
+                    if (score < block_best_scores_[block]) {
+                        block_bests_[block] = i;
+                        block_best_scores_[block] = score;
+                    }
+                }
+            });
             Int best = kIntNull;
             double best_score = std::numeric_limits<double>::max();
-            for (Int i=0; i<problem_->operator_space()->NumInsertions(); ++i) {
-                double score = Evaluate(i);
-                if (score < best_score) {
-                    best = i;
-                    best_score = score;
+            for (Int block=0; block<block_bests_.size(); ++block) {
+                if (block_best_scores_[block] < best_score) {
+                    best = block_bests_[block];
+                    best_score = block_best_scores_[block];
                 }
             }
             if (best == kIntNull)
@@ -44,7 +58,19 @@ namespace vrp {
             }
         }
 
+        Int num_threads() const {
+            return num_threads_;
+        }
+
+        // Sets the number of threads evaluating the insertions in Select().
+        void set_num_threads(Int num_threads) {
+            num_threads_ = std::max<Int>(num_threads, 1);
+        }
+
     protected:
         Problem* problem_ = nullptr;
+        Int num_threads_ = 1;
+        std::vector<Int> block_bests_;
+        std::vector<double> block_best_scores_;
     };
 }
\ No newline at end of file
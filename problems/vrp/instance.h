@@ -0,0 +1,391 @@
+#pragma once
+#include "distance_matrix.h"
+#include "rlop/common/mapped_file.h"
+
+namespace vrp {
+    // An instance in the TSPLIB format, which CVRPLIB also uses: the nodes with their coordinates or an explicit
+    // matrix of edge weights, and for capacitated instances the demands, the capacity of the vehicles and the depot.
+    // The file is memory-mapped and read in one pass, and the costs of coordinate-based instances are computed from
+    // the coordinates when requested rather than stored, so that the memory grows linearly with the number of nodes.
+    //
+    // The instance is seen by the routes as num_targets() targets, the nodes other than the depot in the order of the
+    // file, followed by the sentinels of the routes, which are all the depot. A TSP instance without a depot uses its
+    // first node as the depot.
+    class Instance {
+    public:
+        enum class EdgeWeightType {
+            kEuc2D = 0,
+            kCeil2D,
+            kMan2D,
+            kMax2D,
+            kAtt,
+            kGeo,
+            kExplicit
+        };
+
+        Instance() = default;
+
+        // Parameters:
+        //   path: The path of the instance file.
+        Instance(const std::string& path) {
+            Read(path);
+        }
+
+        virtual ~Instance() = default;
+
+        // Reads an instance file, replacing the current instance.
+        virtual void Read(const std::string& path) {
+            *this = Instance();
+            rlop::MappedFile file(path);
+            // Clears the view of the input on every exit, before the file is unmapped, even if the parsing throws.
+            struct InputGuard {
+                std::string_view& input;
+                ~InputGuard() {
+                    input = {};
+                }
+            } input_guard{ input_ };
+            input_ = file.view();
+            pos_ = 0;
+            std::string edge_weight_format = "FULL_MATRIX";
+            std::string edge_weight_type = "EUC_2D";
+            std::vector<Int> depots;
+            bool has_coordinates = false;
+            while (pos_ < input_.size()) {
+                auto line = Trim(ReadLine());
+                if (line.empty())
+                    continue;
+                auto colon = line.find(':');
+                auto key = Trim(line.substr(0, colon));
+                auto value = colon == std::string_view::npos ? std::string_view() : Trim(line.substr(colon + 1));
+                if (key == "EOF")
+                    break;
+                else if (key == "NAME")
+                    name_ = value;
+                else if (key == "TYPE")
+                    type_ = value;
+                else if (key == "COMMENT")
+                    ReadComment(value);
+                else if (key == "DIMENSION")
+                    dimension_ = ParseInt(value);
+                else if (key == "CAPACITY")
+                    capacity_ = ParseInt(value);
+                else if (key == "VEHICLES")
+                    num_vehicles_ = ParseInt(value);
+                else if (key == "EDGE_WEIGHT_TYPE")
+                    edge_weight_type = value;
+                else if (key == "EDGE_WEIGHT_FORMAT")
+                    edge_weight_format = value;
+                else if (key == "NODE_COORD_SECTION") {
+                    CheckDimension();
+                    xs_.assign(dimension_, 0);
+                    ys_.assign(dimension_, 0);
+                    for (Int i=0; i<dimension_; ++i) {
+                        Int node = ParseNode(ReadToken());
+                        xs_[node] = ParseDouble(ReadToken());
+                        ys_[node] = ParseDouble(ReadToken());
+                    }
+                    has_coordinates = true;
+                }
+                else if (key == "DEMAND_SECTION") {
+                    CheckDimension();
+                    demands_.assign(dimension_, 0);
+                    for (Int i=0; i<dimension_; ++i) {
+                        Int node = ParseNode(ReadToken());
+                        demands_[node] = ParseInt(ReadToken());
+                    }
+                }
+                else if (key == "DEPOT_SECTION") {
+                    for (auto token = ReadToken(); !token.empty() && token != "-1"; token = ReadToken())
+                        depots.push_back(ParseNode(token));
+                }
+                else if (key == "EDGE_WEIGHT_SECTION") {
+                    CheckDimension();
+                    ReadEdgeWeights(edge_weight_format);
+                }
+                else if (key == "DISPLAY_DATA_SECTION") {
+                    CheckDimension();
+                    for (Int i=0; i<3*dimension_; ++i)
+                        ReadToken();
+                }
+            }
+
+            CheckDimension();
+            if (depots.size() > 1)
+                throw std::runtime_error("Instance: instances with several depots are not supported.");
+            depot_ = depots.empty() ? 0 : depots.front();
+            edge_weight_type_ = ParseEdgeWeightType(edge_weight_type);
+            if (edge_weight_type_ == EdgeWeightType::kExplicit) {
+                if (weights_.size() != dimension_)
+                    throw std::runtime_error("Instance: the edge weights are missing.");
+            }
+            else if (!has_coordinates)
+                throw std::runtime_error("Instance: the node coordinates are missing.");
+            if (edge_weight_type_ == EdgeWeightType::kGeo) {
+                for (Int i=0; i<dimension_; ++i) {
+                    xs_[i] = ToGeoRadians(xs_[i]);
+                    ys_[i] = ToGeoRadians(ys_[i]);
+                }
+            }
+            if (demands_.empty())
+                demands_.assign(dimension_, 0);
+            for (Int i=0; i<dimension_; ++i) {
+                if (i != depot_)
+                    targets_.push_back(i);
+            }
+        }
+
+        // Reads the cost of a solution file in the CVRPLIB format, given by its "Cost" line.
+        //
+        // Returns:
+        //   Int: The cost of the solution, or kIntNull if the file has none.
+        static Int ReadSolutionCost(const std::string& path) {
+            rlop::MappedFile file(path);
+            auto input = file.view();
+            auto pos = input.find("Cost");
+            if (pos == std::string_view::npos)
+                return kIntNull;
+            return FindInt(input.substr(pos + 4));
+        }
+
+        // Returns the cost of the arc between two nodes of the routes, the targets followed by the sentinels.
+        Int operator()(Int from, Int to) const {
+            return GetCost(from, to);
+        }
+
+        // Returns the cost of the arc between two nodes of the routes, the targets followed by the sentinels.
+        Int GetCost(Int from, Int to) const {
+            return GetDistance(GetNode(from), GetNode(to));
+        }
+
+        // Returns the distance between two nodes of the instance, computed by the rounding of its edge weight type.
+        Int GetDistance(Int i, Int j) const {
+            if (i == j)
+                return 0;
+            switch (edge_weight_type_) {
+                case EdgeWeightType::kEuc2D:
+                    return std::hypot(xs_[i] - xs_[j], ys_[i] - ys_[j]) + 0.5;
+                case EdgeWeightType::kCeil2D:
+                    return std::ceil(std::hypot(xs_[i] - xs_[j], ys_[i] - ys_[j]));
+                case EdgeWeightType::kMan2D:
+                    return std::abs(xs_[i] - xs_[j]) + std::abs(ys_[i] - ys_[j]) + 0.5;
+                case EdgeWeightType::kMax2D:
+                    return std::max<Int>(std::abs(xs_[i] - xs_[j]) + 0.5, std::abs(ys_[i] - ys_[j]) + 0.5);
+                case EdgeWeightType::kAtt: {
+                    double dx = xs_[i] - xs_[j];
+                    double dy = ys_[i] - ys_[j];
+                    double r = std::sqrt((dx * dx + dy * dy) / 10.0);
+                    Int t = r + 0.5;
+                    return t < r ? t + 1 : t;
+                }
+                case EdgeWeightType::kGeo: {
+                    double q1 = std::cos(ys_[i] - ys_[j]);
+                    double q2 = std::cos(xs_[i] - xs_[j]);
+                    double q3 = std::cos(xs_[i] + xs_[j]);
+                    return static_cast<Int>(kEarthRadius * std::acos(0.5 * ((1.0 + q1) * q2 - (1.0 - q1) * q3)) + 1.0);
+                }
+                case EdgeWeightType::kExplicit:
+                    return weights_(i, j);
+            }
+            return 0;
+        }
+
+        // Returns the node of the instance of a node of the routes.
+        Int GetNode(Int node) const {
+            return node < num_targets() ? targets_[node] : depot_;
+        }
+
+        // Returns the demands of the targets, in the order of the routes.
+        std::vector<Int> GetDemands() const {
+            std::vector<Int> demands(num_targets());
+            for (Int i=0; i<num_targets(); ++i)
+                demands[i] = demands_[targets_[i]];
+            return demands;
+        }
+
+        const std::string& name() const {
+            return name_;
+        }
+
+        const std::string& type() const {
+            return type_;
+        }
+
+        Int dimension() const {
+            return dimension_;
+        }
+
+        Int num_targets() const {
+            return targets_.size();
+        }
+
+        Int depot() const {
+            return depot_;
+        }
+
+        // The capacity of the vehicles, or kIntNull if the instance is not capacitated.
+        Int capacity() const {
+            return capacity_;
+        }
+
+        // The number of vehicles, given by the VEHICLES key, the comment or a "-k" suffix of the name, or kIntNull.
+        Int num_vehicles() const {
+            if (num_vehicles_ != kIntNull)
+                return num_vehicles_;
+            auto pos = name_.rfind("-k");
+            if (pos != std::string::npos)
+                return FindInt(std::string_view(name_).substr(pos + 2));
+            return kIntNull;
+        }
+
+        // The cost of the best known or optimal solution given by the comment, or kIntNull.
+        Int best_known_cost() const {
+            return best_known_cost_;
+        }
+
+        EdgeWeightType edge_weight_type() const {
+            return edge_weight_type_;
+        }
+
+        const std::vector<Int>& demands() const {
+            return demands_;
+        }
+
+    protected:
+        static constexpr double kEarthRadius = 6378.388;
+        static constexpr double kGeoPi = 3.141592;
+
+        std::string_view ReadLine() {
+            auto end = input_.find('\n', pos_);
+            if (end == std::string_view::npos)
+                end = input_.size();
+            auto line = input_.substr(pos_, end - pos_);
+            pos_ = end + 1;
+            return line;
+        }
+
+        // Returns the next token separated by white space, or an empty token at the end of the input.
+        std::string_view ReadToken() {
+            while (pos_ < input_.size() && std::isspace(static_cast<unsigned char>(input_[pos_])))
+                ++pos_;
+            size_t begin = pos_;
+            while (pos_ < input_.size() && !std::isspace(static_cast<unsigned char>(input_[pos_])))
+                ++pos_;
+            return input_.substr(begin, pos_ - begin);
+        }
+
+        // Reads the edge weights of an explicit instance, a column format being the transpose of a row format.
+        void ReadEdgeWeights(const std::string& format) {
+            weights_ = DistanceMatrix(dimension_);
+            bool full = format == "FULL_MATRIX";
+            bool upper = format == "UPPER_ROW" || format == "UPPER_DIAG_ROW" || format == "LOWER_COL" || format == "LOWER_DIAG_COL";
+            bool lower = format == "LOWER_ROW" || format == "LOWER_DIAG_ROW" || format == "UPPER_COL" || format == "UPPER_DIAG_COL";
+            bool diagonal = format.find("DIAG") != std::string::npos;
+            if (!full && !upper && !lower)
+                throw std::runtime_error("Instance: the edge weight format " + format + " is not supported.");
+            for (Int i=0; i<dimension_; ++i) {
+                Int begin = full || lower ? 0 : (diagonal ? i : i + 1);
+                Int end = full || upper ? dimension_ : (diagonal ? i + 1 : i);
+                for (Int j=begin; j<end; ++j) {
+                    Int weight = ParseInt(ReadToken());
+                    weights_.Set(i, j, weight);
+                    if (!full)
+                        weights_.Set(j, i, weight);
+                }
+            }
+        }
+
+        // Reads the number of trucks and the optimal or best known value of the comments of CVRPLIB.
+        void ReadComment(std::string_view comment) {
+            auto trucks = comment.find("trucks:");
+            if (trucks != std::string_view::npos && num_vehicles_ == kIntNull)
+                num_vehicles_ = FindInt(comment.substr(trucks + 7));
+            auto value = comment.find("value:");
+            if (value != std::string_view::npos)
+                best_known_cost_ = FindInt(comment.substr(value + 6));
+        }
+
+        void CheckDimension() const {
+            if (dimension_ <= 0)
+                throw std::runtime_error("Instance: the dimension is missing.");
+        }
+
+        Int ParseNode(std::string_view token) const {
+            Int node = ParseInt(token) - 1;
+            if (node < 0 || node >= dimension_)
+                throw std::runtime_error("Instance: node " + std::string(token) + " is out of range.");
+            return node;
+        }
+
+        static EdgeWeightType ParseEdgeWeightType(const std::string& type) {
+            if (type == "EUC_2D")
+                return EdgeWeightType::kEuc2D;
+            if (type == "CEIL_2D")
+                return EdgeWeightType::kCeil2D;
+            if (type == "MAN_2D")
+                return EdgeWeightType::kMan2D;
+            if (type == "MAX_2D")
+                return EdgeWeightType::kMax2D;
+            if (type == "ATT")
+                return EdgeWeightType::kAtt;
+            if (type == "GEO")
+                return EdgeWeightType::kGeo;
+            if (type == "EXPLICIT")
+                return EdgeWeightType::kExplicit;
+            throw std::runtime_error("Instance: the edge weight type " + type + " is not supported.");
+        }
+
+        // Converts a TSPLIB geographical coordinate, in degrees and minutes as DDD.MM, to radians.
+        static double ToGeoRadians(double coordinate) {
+            Int degrees = coordinate;
+            double minutes = coordinate - degrees;
+            return kGeoPi * (degrees + 5.0 * minutes / 3.0) / 180.0;
+        }
+
+        static std::string_view Trim(std::string_view text) {
+            while (!text.empty() && std::isspace(static_cast<unsigned char>(text.front())))
+                text.remove_prefix(1);
+            while (!text.empty() && std::isspace(static_cast<unsigned char>(text.back())))
+                text.remove_suffix(1);
+            return text;
+        }
+
+        static double ParseDouble(std::string_view token) {
+            std::string text(token);
+            char* end = nullptr;
+            double value = std::strtod(text.c_str(), &end);
+            if (text.empty() || *end != '\0')
+                throw std::runtime_error("Instance: cannot parse the number " + text + ".");
+            return value;
+        }
+
+        static Int ParseInt(std::string_view token) {
+            double value = ParseDouble(token);
+            return std::llround(value);
+        }
+
+        // Returns the first integer of a text, or kIntNull if it has none.
+        static Int FindInt(std::string_view text) {
+            auto begin = text.find_first_of("-0123456789");
+            if (begin == std::string_view::npos)
+                return kIntNull;
+            auto end = text.find_first_not_of("-0123456789", begin + 1);
+            return ParseInt(text.substr(begin, end == std::string_view::npos ? end : end - begin));
+        }
+
+        std::string name_;
+        std::string type_;
+        Int dimension_ = 0;
+        Int capacity_ = kIntNull;
+        Int num_vehicles_ = kIntNull;
+        Int best_known_cost_ = kIntNull;
+        Int depot_ = 0;
+        EdgeWeightType edge_weight_type_ = EdgeWeightType::kEuc2D;
+        std::vector<double> xs_; // The coordinates of the nodes, in radians for GEO.
+        std::vector<double> ys_;
+        std::vector<Int> demands_; // The demand of each node of the instance.
+        std::vector<Int> targets_; // The nodes of the instance of the targets of the routes.
+        DistanceMatrix weights_; // The edge weights of an explicit instance.
+        std::string_view input_; // The input being read.
+        size_t pos_ = 0;
+    };
+}
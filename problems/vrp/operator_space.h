@@ -3,17 +3,28 @@
 #include "operators.h"
 
 namespace vrp {
+    // Generates the insertions and the neighborhood operators of a solution. The swap, move and 2-opt operators are
+    // kept by ordered pair of routes. In incremental mode, GenerateNeighbors() only regenerates the pairs involving a
+    // route modified since the previous call, and the deltas cached for the other pairs stay valid. Routes are marked
+    // as modified by Invalidate(), which Problem calls on each step and undo. Cached deltas assume that the delta of an
+    // operator only depends on the routes of its nodes. With candidate lists, the neighborhood is granular: operators
+    // are only generated between a node and its nearest nodes.
+    //
+    // With don't-look bits, the operators are kept by node instead, the node whose moves they are, and
+    // GenerateNeighbors() only offers the operators of the active nodes, which it regenerates: the nodes within two
+    // positions of the nodes of the operators applied or undone since the previous call, and the nodes offered by the
+    // previous call with an improving cached delta. The other nodes are not looked at until a step comes near them,
+    // so an iteration costs the size of the change instead of the size of the instance, which granular candidate
+    // lists make small. Without a step since the previous call,
+    // the same operators are offered again, such as to a simulated annealing rejecting a move. The first call after a
+    // reset activates all the nodes.
     class OperatorSpace {
     public:
         OperatorSpace() = default;
 
         OperatorSpace(const Routes& routes) : routes_(&routes) {}
 
-        virtual ~OperatorSpace() {
-            for (auto ptr : operators_) {
-                delete ptr;
-            }
-        }
+        virtual ~OperatorSpace() = default;
 
         virtual void Reset() {
             ClearOperators();
@@ -26,16 +37,19 @@ namespace vrp {
         }
 
         virtual void ClearOperators() {
-            for (auto ptr : operators_) {
-                delete ptr;
-            }
+            route_pair_operators_.clear();
+            route_pair_deltas_.clear();
+            modified_routes_.clear();
+            node_operators_.clear();
+            node_deltas_.clear();
+            active_nodes_.clear();
+            active_queue_.clear();
+            offered_nodes_.clear();
             operators_.clear();
+            deltas_.clear();
         }
 
         virtual void ClearInsertions() {
-            for (auto ptr : insertions_) {
-                delete ptr;
-            }
             insertions_.clear();
         }
 
@@ -44,7 +58,7 @@ namespace vrp {
         }
 
         virtual const Insertion* GetInsertion(Int i) const {
-            return insertions_[i];
+            return &insertions_[i];
         }
 
         virtual Int NumNeighbors() const {
@@ -52,7 +66,36 @@ namespace vrp {
         }
 
         virtual const Operator* GetNeighbor(Int i) const {
-            return operators_[i];
+            return &operators_[i];
+        }
+
+        // Returns the delta cached for a neighbor by SetDelta(), or std::nullopt if it has not been evaluated since its
+        // routes were last modified.
+        std::optional<Int> GetDelta(Int i) const {
+            if (*deltas_[i] == kIntNull)
+                return std::nullopt;
+            return { *deltas_[i] };
+        }
+
+        void SetDelta(Int i, Int delta) {
+            *deltas_[i] = delta;
+        }
+
+        // Marks the routes of the nodes of an operator as modified, and with don't-look bits, activates the nodes
+        // around them. The node of an insertion may not be routed yet, in which case only the route it is inserted
+        // into is marked. It is called once the operator is applied or undone.
+        virtual void Invalidate(const Operator& op) {
+            InvalidateRoute(routes_->GetRoute(op.from_node()));
+            InvalidateRoute(routes_->GetRoute(op.to_node()));
+            if (dont_look_bits_) {
+                ActivateAround(op.from_node());
+                ActivateAround(op.to_node());
+            }
+        }
+
+        void InvalidateRoute(Int route) {
+            if (route >= 0 && route < modified_routes_.size())
+                modified_routes_[route] = true;
         }
 
         virtual void GenerateInsertions() {
@@ -71,42 +114,224 @@ namespace vrp {
                 return;
             Int i = unvisited[rand_.Uniform(Int(0), (Int)unvisited.size()-1)];
             for (Int j : visited)
-                insertions_.push_back(new Insertion(i, j));
+                insertions_.emplace_back(i, j);
             for (Int j=0; j<routes_->num_routes(); ++j)
-                insertions_.push_back(new Insertion(i, routes_->GetSentinel(j)));
+                insertions_.emplace_back(i, routes_->GetSentinel(j));
         }
         
+        // Generates the swap, move and 2-opt operators of all started routes. Without the incremental mode, or after
+        // a reset, every route pair is regenerated. The operators are regenerated in place, so that no allocation
+        // happens once the storage has grown to the size of the neighborhood.
         virtual void GenerateNeighbors() {
-            ClearOperators();
-            for (Int ri=0; ri<routes_->num_routes(); ++ri) {
-                if (!routes_->IsStarted(ri))
+            if (dont_look_bits_) {
+                GenerateActiveNeighbors();
+                return;
+            }
+            Int num_routes = routes_->num_routes();
+            if (route_pair_operators_.size() != num_routes * num_routes) {
+                ClearOperators();
+                route_pair_operators_.resize(num_routes * num_routes);
+                route_pair_deltas_.resize(num_routes * num_routes);
+                modified_routes_.assign(num_routes, true);
+            }
+            else if (!incremental_)
+                std::fill(modified_routes_.begin(), modified_routes_.end(), true);
+            for (Int ri=0; ri<num_routes; ++ri) {
+                for (Int rj=0; rj<num_routes; ++rj) {
+                    if (!modified_routes_[ri] && !modified_routes_[rj])
+                        continue;
+                    auto& operators = route_pair_operators_[ri * num_routes + rj];
+                    operators.clear();
+                    GenerateNeighbors(ri, rj, operators);
+                    route_pair_deltas_[ri * num_routes + rj].assign(operators.size(), kIntNull);
+                }
+            }
+            std::fill(modified_routes_.begin(), modified_routes_.end(), false);
+            operators_.clear();
+            deltas_.clear();
+            for (Int p=0; p<route_pair_operators_.size(); ++p) {
+                for (Int k=0; k<route_pair_operators_[p].size(); ++k) {
+                    operators_.push_back(route_pair_operators_[p][k]);
+                    deltas_.push_back(&route_pair_deltas_[p][k]);
+                }
+            }
+        }
+
+        // Generates the operators moving nodes from route ri to route rj, swapping their nodes and, within a route,
+        // reversing a segment.
+        //
+        // Parameters:
+        //   ri: The route of the first node.
+        //   rj: The route of the second node.
+        //   operators: The operators to append to.
+        virtual void GenerateNeighbors(Int ri, Int rj, std::vector<Operator>& operators) const {
+            if (!routes_->IsStarted(ri))
+                return;
+            if (!candidates_.empty()) {
+                GenerateGranularNeighbors(ri, rj, operators);
+                return;
+            }
+            for (Int ni=routes_->GetStart(ri); ni!=routes_->GetSentinel(ri); ni=routes_->GetNext(ni))
+                GenerateSwaps(ni, rj, operators);
+            for (Int ni=routes_->GetStart(ri); ni!=routes_->GetSentinel(ri); ni=routes_->GetNext(ni))
+                GenerateMoves(ni, rj, operators);
+        }
+
+        // Generates the operators of a node of the full neighborhood with the nodes of route rj: the swaps with them
+        // and, within the route of the node, the swaps and 2-opts with the nodes after it.
+        void GenerateSwaps(Int ni, Int rj, std::vector<Operator>& operators) const {
+            if (routes_->GetRoute(ni) == rj) {
+                for (Int nj=routes_->GetNext(ni); nj!=routes_->GetSentinel(rj); nj=routes_->GetNext(nj)) {
+                    if (nj != routes_->GetNext(ni))
+                        operators.push_back(Swapping(ni, nj));
+                    operators.push_back(TwoOpting(ni, nj));
+                }
+            }
+            else {
+                for (Int nj=routes_->GetStart(rj); nj!=routes_->GetSentinel(rj); nj=routes_->GetNext(nj)) {
+                    operators.push_back(Swapping(ni, nj));
+                }
+            }
+        }
+
+        // Generates the moves of the node before a node of the full neighborhood to before the nodes of route rj.
+        void GenerateMoves(Int ni, Int rj, std::vector<Operator>& operators) const {
+            if (routes_->GetLast(ni) == routes_->GetSentinel(routes_->GetRoute(ni)))
+                return;
+            for (Int nj=routes_->GetStart(rj); nj!=routes_->GetSentinel(rj); nj=routes_->GetNext(nj)) {
+                if (ni == nj || nj == routes_->GetLast(ni))
                     continue;
-                for (Int rj=0; rj<routes_->num_routes(); ++rj) {
-                    if (ri == rj) {
-                        for (Int ni=routes_->GetStart(ri); ni!=routes_->GetSentinel(ri); ni=routes_->GetNext(ni)) {
-                            for (Int nj=routes_->GetNext(ni); nj!=routes_->GetSentinel(rj); nj=routes_->GetNext(nj)) {
-                                if (nj != routes_->GetNext(ni))
-                                    operators_.push_back(new Swapping(ni, nj));
-                                operators_.push_back(new TwoOpting(ni, nj));
-                            }
-                        }
-                    }
-                    else {
-                        for (Int ni=routes_->GetStart(ri); ni!=routes_->GetSentinel(ri); ni=routes_->GetNext(ni)) {
-                            for (Int nj=routes_->GetStart(rj); nj!=routes_->GetSentinel(rj); nj=routes_->GetNext(nj)) {
-                                operators_.push_back(new Swapping(ni, nj));
-                            }
-                        }
-                    }
-                    for (Int ni=routes_->GetStart(ri); ni!=routes_->GetSentinel(ri); ni=routes_->GetNext(ni)) {
-                        for (Int nj=routes_->GetStart(rj); nj!=routes_->GetSentinel(rj); nj=routes_->GetNext(nj)) {
-                            if (ni == nj || nj == routes_->GetLast(ni) || routes_->GetLast(ni) == routes_->GetSentinel(ri))
-                                continue;
-                            operators_.push_back(new Moving(ni, nj));
-                        }
-                    }
+                operators.push_back(Moving(ni, nj));
+            }
+        }
+
+        // Generates the operators of route ri and route rj which create an arc between a node and one of its
+        // candidates: swaps and 2-opts between a node of ri and a candidate in rj, and moves of a node of ri next to,
+        // before or after, a candidate in rj. A swap or 2-opt within a route is generated once for a pair of nodes
+        // which are candidates of each other.
+        //
+        // Parameters:
+        //   ri: The route of the first node.
+        //   rj: The route of the second node.
+        //   operators: The operators to append to.
+        virtual void GenerateGranularNeighbors(Int ri, Int rj, std::vector<Operator>& operators) const {
+            for (Int ni=routes_->GetStart(ri); ni!=routes_->GetSentinel(ri); ni=routes_->GetNext(ni))
+                GenerateGranularMoves(ni, rj, operators);
+        }
+
+        // Generates the operators of the granular neighborhood of a node with the candidates in route rj.
+        void GenerateGranularMoves(Int ni, Int rj, std::vector<Operator>& operators) const {
+            Int ri = routes_->GetRoute(ni);
+            for (Int nj : candidates_[ni]) {
+                if (routes_->GetRoute(nj) != rj)
+                    continue;
+                if (ri != rj)
+                    operators.push_back(Swapping(ni, nj));
+                else if (routes_->IsBefore(ni, nj) || !IsCandidate(nj, ni)) {
+                    Int first = routes_->IsBefore(ni, nj) ? ni : nj;
+                    Int second = first == ni ? nj : ni;
+                    if (second != routes_->GetNext(first))
+                        operators.push_back(Swapping(first, second));
+                    operators.push_back(TwoOpting(first, second));
                 }
             }
+            Int moved = routes_->GetLast(ni);
+            if (moved == routes_->GetSentinel(ri))
+                return;
+            for (Int candidate : candidates_[moved]) {
+                if (routes_->GetRoute(candidate) != rj)
+                    continue;
+                Int next = routes_->GetNext(candidate);
+                for (Int nj : { candidate, next }) {
+                    if (nj == routes_->GetSentinel(rj) || nj == ni || nj == moved || (nj == next && IsCandidate(moved, next)))
+                        continue;
+                    operators.push_back(Moving(ni, nj));
+                }
+            }
+        }
+
+        // Generates the operators of a routed node with the nodes of all the routes.
+        virtual void GenerateNodeNeighbors(Int ni, std::vector<Operator>& operators) const {
+            for (Int rj=0; rj<routes_->num_routes(); ++rj) {
+                if (!candidates_.empty())
+                    GenerateGranularMoves(ni, rj, operators);
+                else
+                    GenerateSwaps(ni, rj, operators);
+            }
+            if (!candidates_.empty())
+                return;
+            for (Int rj=0; rj<routes_->num_routes(); ++rj)
+                GenerateMoves(ni, rj, operators);
+        }
+
+        // Builds the candidate lists of a granular neighborhood: the k nearest visitable nodes of each node.
+        //
+        // Parameters:
+        //   k: The number of candidates of each node.
+        //   get_cost: The cost of the arc between two nodes.
+        void SetCandidates(Int k, const std::function<Int(Int, Int)>& get_cost) {
+            Int num_nodes = routes_->num_nodes();
+            k = std::min(k, num_nodes - 1);
+            std::vector<std::vector<Int>> candidates(num_nodes);
+            std::vector<Int> others;
+            for (Int i=0; i<num_nodes; ++i) {
+                others.clear();
+                for (Int j=0; j<num_nodes; ++j) {
+                    if (j != i)
+                        others.push_back(j);
+                }
+                auto closer = [&](Int a, Int b) {
+                    Int cost_a = get_cost(i, a);
+                    Int cost_b = get_cost(i, b);
+                    return cost_a < cost_b || (cost_a == cost_b && a < b);
+                };
+                std::nth_element(others.begin(), others.begin() + k, others.end(), closer);
+                std::sort(others.begin(), others.begin() + k, closer);
+                candidates[i].assign(others.begin(), others.begin() + k);
+            }
+            SetCandidates(std::move(candidates));
+        }
+
+        // Sets the candidate lists of a granular neighborhood, one list of nodes per node. Empty lists restore the
+        // full neighborhood.
+        void SetCandidates(std::vector<std::vector<Int>> candidates) {
+            candidates_ = std::move(candidates);
+            ClearOperators();
+        }
+
+        const std::vector<std::vector<Int>>& candidates() const {
+            return candidates_;
+        }
+
+        bool IsCandidate(Int node, Int candidate) const {
+            const auto& list = candidates_[node];
+            return std::find(list.begin(), list.end(), candidate) != list.end();
+        }
+
+        bool incremental() const {
+            return incremental_;
+        }
+
+        bool dont_look_bits() const {
+            return dont_look_bits_;
+        }
+
+        // Enables the don't-look bits, with which GenerateNeighbors() only offers the operators of the nodes around
+        // the operators applied or undone since its previous call.
+        void set_dont_look_bits(bool dont_look_bits) {
+            dont_look_bits_ = dont_look_bits;
+            ClearOperators();
+        }
+
+        // Returns the number of nodes whose operators the next GenerateNeighbors() regenerates with don't-look bits.
+        Int NumActiveNodes() const {
+            return node_operators_.empty() ? routes_->num_visited_nodes() : active_queue_.size();
+        }
+
+        // Enables regenerating only the operators of the routes modified since the previous GenerateNeighbors().
+        void set_incremental(bool incremental) {
+            incremental_ = incremental;
+            ClearOperators();
         }
 
         void Seed(uint64_t seed) {
@@ -114,9 +339,88 @@ namespace vrp {
         }
 
     protected: 
+        // Activates the nodes within two positions of a node in its route, which cover the nodes whose arcs an
+        // operator of the node changed.
+        void ActivateAround(Int node) {
+            if (node < 0 || node >= routes_->num_nodes() || !routes_->IsVisited(node))
+                return;
+            Int last = node;
+            Int next = node;
+            ActivateNode(node);
+            for (Int i=0; i<2; ++i) {
+                last = routes_->GetLast(last);
+                next = routes_->GetNext(next);
+                ActivateNode(last);
+                ActivateNode(next);
+            }
+        }
+
+        // Activates a node, or nothing for a sentinel.
+        void ActivateNode(Int node) {
+            if (node < 0 || node >= static_cast<Int>(active_nodes_.size()) || active_nodes_[node])
+                return;
+            active_nodes_[node] = true;
+            active_queue_.push_back(node);
+        }
+
+        // Regenerates the operators of the active nodes, and offers them, with all the nodes active after a reset.
+        // Offering a node sets its don't-look bit, unless one of its operators turns out to improve.
+        void GenerateActiveNeighbors() {
+            Int num_nodes = routes_->num_nodes();
+            if (node_operators_.size() != num_nodes) {
+                ClearOperators();
+                node_operators_.resize(num_nodes);
+                node_deltas_.resize(num_nodes);
+                active_nodes_.assign(num_nodes, false);
+                for (Int i=0; i<num_nodes; ++i)
+                    ActivateNode(i);
+            }
+            else if (active_queue_.empty())
+                return;
+            // The nodes offered with an improving operator keep their bits cleared.
+            for (Int node : offered_nodes_) {
+                for (Int delta : node_deltas_[node]) {
+                    if (delta != kIntNull && delta < 0) {
+                        ActivateNode(node);
+                        break;
+                    }
+                }
+            }
+            operators_.clear();
+            deltas_.clear();
+            for (Int node : active_queue_) {
+                active_nodes_[node] = false;
+                auto& operators = node_operators_[node];
+                operators.clear();
+                if (routes_->IsVisited(node))
+                    GenerateNodeNeighbors(node, operators);
+                node_deltas_[node].assign(operators.size(), kIntNull);
+            }
+            for (Int node : active_queue_) {
+                for (Int k=0; k<node_operators_[node].size(); ++k) {
+                    operators_.push_back(node_operators_[node][k]);
+                    deltas_.push_back(&node_deltas_[node][k]);
+                }
+            }
+            offered_nodes_.swap(active_queue_);
+            active_queue_.clear();
+        }
+
         const Routes* routes_ = nullptr;
-        std::vector<Operator*> operators_;
-        std::vector<Insertion*> insertions_;
+        bool incremental_ = false;
+        bool dont_look_bits_ = false;
+        std::vector<std::vector<Operator>> node_operators_; // The operators of each node, with don't-look bits.
+        std::vector<std::vector<Int>> node_deltas_; // The cached deltas of these operators.
+        std::vector<bool> active_nodes_; // The don't-look bits, cleared for the active nodes.
+        std::vector<Int> active_queue_; // The active nodes, in the order of their activation.
+        std::vector<Int> offered_nodes_; // The nodes whose operators are offered.
+        std::vector<std::vector<Operator>> route_pair_operators_; // The operators of each ordered pair of routes.
+        std::vector<std::vector<Int>> route_pair_deltas_; // The cached deltas of these operators, kIntNull if unknown.
+        std::vector<bool> modified_routes_;
+        std::vector<std::vector<Int>> candidates_; // The candidates of each node, empty for the full neighborhood.
+        std::vector<Operator> operators_;
+        std::vector<Int*> deltas_;
+        std::vector<Insertion> insertions_;
         rlop::Random rand_;               
     };
 }
\ No newline at end of file
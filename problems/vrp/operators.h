@@ -6,6 +6,9 @@ namespace vrp {
     using rlop::kIntNull;
     using rlop::kIntFull;
 
+    // An operator is a plain value made of its type and two nodes, so that operators can be stored contiguously and
+    // regenerated without allocation. Consumers switch on GetType(). The derived classes only name the constructors
+    // and the nodes of each type, and add no data, so they can be stored as Operator.
     class Operator {
     public:
         enum class Type {
@@ -15,34 +18,14 @@ namespace vrp {
             kTwoOpt,
         };
 
-        virtual Type GetType() const = 0;
-    };
-
-    class Insertion : public Operator {
-    public:
-        Insertion(Int node, Int to_node) : node_(node), to_node_(to_node) {}
-
-        Int node() const {
-            return node_;
-        }
+        Operator() = default;
 
-        Int to_node() const {
-            return to_node_;
-        }
+        Operator(Type type, Int from_node, Int to_node) : type_(type), from_node_(from_node), to_node_(to_node) {}
 
-        virtual Type GetType() const override {
-            return Type::kInsertion;
+        Type GetType() const {
+            return type_;
         }
 
-    private:
-        Int node_ = kIntNull;
-        Int to_node_ = kIntNull;
-    };
-
-    class Swapping : public Operator {
-    public:
-        Swapping(Int from_node, Int to_node) : from_node_(from_node), to_node_(to_node) {}
-
         Int from_node() const {
             return from_node_;
         }
@@ -51,54 +34,33 @@ namespace vrp {
             return to_node_;
         }
 
-        virtual Type GetType() const override {
-            return Type::kSwap;
-        }
-
-    private:
+    protected:
+        Type type_ = Type::kInsertion;
         Int from_node_ = kIntNull;
         Int to_node_ = kIntNull;
     };
 
-    class Moving : public Operator {
+    class Insertion : public Operator {
     public:
-        Moving(Int from_node, Int to_node) : from_node_(from_node), to_node_(to_node) {}
+        Insertion(Int node, Int to_node) : Operator(Type::kInsertion, node, to_node) {}
 
-        Int from_node() const {
+        Int node() const {
             return from_node_;
         }
+    };
 
-        Int to_node() const {
-            return to_node_;
-        }
-
-        virtual Type GetType() const override {
-            return Type::kMoving;
-        }
+    class Swapping : public Operator {
+    public:
+        Swapping(Int from_node, Int to_node) : Operator(Type::kSwap, from_node, to_node) {}
+    };
 
-    private:
-        Int from_node_ = kIntNull;
-        Int to_node_ = kIntNull;
+    class Moving : public Operator {
+    public:
+        Moving(Int from_node, Int to_node) : Operator(Type::kMoving, from_node, to_node) {}
     };
 
     class TwoOpting : public Operator {
     public:
-        TwoOpting(Int from_node, Int to_node) : from_node_(from_node), to_node_(to_node) {}
-
-        Int from_node() const {
-            return from_node_;
-        }
-
-        Int to_node() const {
-            return to_node_;
-        }
-
-        virtual Type GetType() const override {
-            return Type::kTwoOpt;
-        }
-
-    private:
-        Int from_node_ = kIntNull;
-        Int to_node_ = kIntNull; 
+        TwoOpting(Int from_node, Int to_node) : Operator(Type::kTwoOpt, from_node, to_node) {}
     };
-}
\ No newline at end of file
+}
@@ -15,19 +15,44 @@ namespace vrp {
 
         virtual void Reset() {}
 
+        // Sums the deltas of the cost managers. An operator which one of them evaluates as infeasible, with
+        // std::numeric_limits<Int>::max(), is infeasible.
         virtual Int EvaluateDelta(const Operator& op) const { 
             Int delta = 0;
             for (auto manager : cost_managers_) {
-                delta += manager->EvaluateDelta(op);
+                Int manager_delta = manager->EvaluateDelta(op);
+                if (manager_delta == std::numeric_limits<Int>::max())
+                    return manager_delta;
+                delta += manager_delta;
             }
             return delta;
         }
 
+        // Evaluates the delta of a neighbor of the operator space, reusing the delta cached by the operator space
+        // while the routes of the neighbor are not modified.
+        //
+        // Parameters:
+        //   neighbor_i: The index of the neighbor in the operator space.
+        //
+        // Returns:
+        //   Int: The change of the total cost if the neighbor is applied.
+        virtual Int EvaluateNeighbor(Int neighbor_i) const {
+            auto delta = operator_space_->GetDelta(neighbor_i);
+            if (delta)
+                return *delta;
+            Int value = EvaluateDelta(*operator_space_->GetNeighbor(neighbor_i));
+            operator_space_->SetDelta(neighbor_i, value);
+            return value;
+        }
+
         virtual bool Step(const Operator& op) {
             if (!routes_->Step(op))
                 return false;
+            if (operator_space_ != nullptr)
+                operator_space_->Invalidate(op);
             for (auto manager : cost_managers_) {
                 manager->Step(op);
+                manager->Synchronize(op);
             }
             return true;
         }
@@ -37,28 +62,15 @@ namespace vrp {
                 manager->Undo(op);
             }
             routes_->Undo(op);    
+            if (operator_space_ != nullptr)
+                operator_space_->Invalidate(op);
+            for (auto manager : cost_managers_) {
+                manager->Synchronize(op);
+            }
         }
 
         virtual Int EncodeOperator(const Operator& op) const {
-            if (op.GetType() == Operator::Type::kInsertion) {
-                auto insert = static_cast<const Insertion&>(op);
-                return insert.node() ^ insert.to_node() ^ 0;            
-            }
-            else if (op.GetType() == Operator::Type::kSwap) {
-                auto swap = static_cast<const Swapping&>(op);
-                return swap.from_node() ^ swap.to_node() ^ 1;
-                
-            }
-            else if (op.GetType() == Operator::Type::kMoving) {
-                auto move = static_cast<const Moving&>(op);
-                return move.from_node() ^ move.to_node() ^ 2;    
-
-            }
-            else if (op.GetType() == Operator::Type::kTwoOpt) {
-                auto two_opt = static_cast<const TwoOpting&>(op);
-                return two_opt.from_node() ^ two_opt.to_node() ^ 3;
-            }    
-            return Int(0);
+            return op.from_node() ^ op.to_node() ^ static_cast<Int>(op.GetType());
         }
 
         virtual Int GetTotalCost() const {
@@ -86,4 +98,72 @@ namespace vrp {
         OperatorSpace* operator_space_ = nullptr;
         std::vector<CostManager*> cost_managers_;
     };
-}
\ No newline at end of file
+
+    // A problem whose cost managers have types known at compile time. The delta of an operator is the sum of the deltas
+    // of the managers for its type, called without virtual dispatch, so that the evaluation of a neighbor is one
+    // function in which the managers are inlined. The managers are called as TManagers, and not through the overrides
+    // of derived classes. Steps, undos and the total cost go through the managers as in Problem.
+    //
+    // Template Parameters:
+    //   TManagers: The types of the cost managers, derived from CostManager.
+    template<typename... TManagers>
+    class BasicProblem : public Problem {
+    public:
+        BasicProblem(Routes* routes, OperatorSpace* operator_space, TManagers*... managers) :
+            Problem(routes, operator_space, { managers... }),
+            managers_(managers...)
+        {}
+
+        virtual ~BasicProblem() = default;
+
+        virtual Int EvaluateDelta(const Operator& op) const override {
+            switch (op.GetType()) {
+                case Operator::Type::kInsertion:
+                    return EvaluateDelta(Insertion(op.from_node(), op.to_node()));
+                case Operator::Type::kSwap:
+                    return EvaluateDelta(Swapping(op.from_node(), op.to_node()));
+                case Operator::Type::kMoving:
+                    return EvaluateDelta(Moving(op.from_node(), op.to_node()));
+                case Operator::Type::kTwoOpt:
+                    return EvaluateDelta(TwoOpting(op.from_node(), op.to_node()));
+            }
+            return 0;
+        }
+
+        // Sums the deltas of the managers for a typed operator, std::numeric_limits<Int>::max() if any of them is.
+        template<typename TOperator>
+        Int EvaluateDelta(const TOperator& op) const {
+            Int delta = 0;
+            bool feasible = std::apply([&](const auto*... managers) {
+                return (AddDelta(*managers, op, delta) && ...);
+            }, managers_);
+            return feasible ? delta : std::numeric_limits<Int>::max();
+        }
+
+        // Evaluates a neighbor as Problem does, without the virtual call of EvaluateDelta().
+        virtual Int EvaluateNeighbor(Int neighbor_i) const override {
+            auto delta = operator_space_->GetDelta(neighbor_i);
+            if (delta)
+                return *delta;
+            Int value = BasicProblem::EvaluateDelta(*operator_space_->GetNeighbor(neighbor_i));
+            operator_space_->SetDelta(neighbor_i, value);
+            return value;
+        }
+
+        const std::tuple<TManagers*...>& managers() const {
+            return managers_;
+        }
+
+    protected:
+        template<typename TManager, typename TOperator>
+        static bool AddDelta(const TManager& manager, const TOperator& op, Int& delta) {
+            Int manager_delta = manager.TManager::EvaluateDelta(op);
+            if (manager_delta == std::numeric_limits<Int>::max())
+                return false;
+            delta += manager_delta;
+            return true;
+        }
+
+        std::tuple<TManagers*...> managers_;
+    };
+}
@@ -0,0 +1,163 @@
+#pragma once
+#include "insertion_solver.h"
+
+namespace vrp {
+    // Inserts the unvisited nodes by regret-k insertion: the next node inserted is the one maximizing the sum of the
+    // differences between the cost of its best insertion and the costs of its best insertions into the k - 1 next best
+    // routes, at its cheapest position. Regret-1 is the greedy cheapest insertion. The cheapest insertion of each node
+    // into each route is cached, and after an insertion only the costs of the modified route are evaluated again. The
+    // nodes are kept in a priority queue by regret, whose outdated entries are skipped by version.
+    //
+    // As with the deltas cached by OperatorSpace, the cost of inserting a node into a route is assumed to only depend
+    // on that route.
+    class RegretInsertionSolver : public InsertionSolver {
+    public:
+        // Parameters:
+        //   problem: The problem whose unvisited nodes are inserted.
+        //   k: The number of routes compared by the regret, at least 1.
+        RegretInsertionSolver(Problem* problem, Int k = 2) : InsertionSolver(problem), k_(std::max<Int>(k, 1)) {}
+
+        ~RegretInsertionSolver() = default;
+
+        // Inserts the unvisited nodes until none is left or none can be inserted. With several threads, the costs of
+        // the insertions are evaluated for several nodes at once.
+        virtual void Solve() override {
+            const Routes& routes = *problem_->routes();
+            Int num_routes = routes.num_routes();
+            insertions_.clear();
+            nodes_.clear();
+            for (Int i=0; i<routes.num_nodes(); ++i) {
+                if (!routes.IsVisited(i))
+                    nodes_.push_back(i);
+            }
+            if (nodes_.empty())
+                return;
+            best_insertions_.resize(routes.num_nodes() * num_routes);
+            versions_.assign(routes.num_nodes(), 0);
+            queue_ = Queue();
+            UpdateInsertions(kIntNull);
+            while (!queue_.empty()) {
+                Entry entry = queue_.top();
+                queue_.pop();
+                if (entry.version != versions_[entry.node] || routes.IsVisited(entry.node))
+                    continue;
+                Int route = GetBestRoute(entry.node);
+                const auto& best = best_insertions_[entry.node * num_routes + route];
+                if (best.delta == std::numeric_limits<Int>::max())
+                    continue;
+                Insertion insertion(entry.node, best.to_node);
+                if (!problem_->Step(insertion))
+                    continue;
+                insertions_.push_back(insertion);
+                nodes_.erase(std::find(nodes_.begin(), nodes_.end(), entry.node));
+                UpdateInsertions(route);
+            }
+        }
+
+        // Returns the insertions applied by the last Solve(), in order.
+        const std::vector<Insertion>& insertions() const {
+            return insertions_;
+        }
+
+        Int k() const {
+            return k_;
+        }
+
+        void set_k(Int k) {
+            k_ = std::max<Int>(k, 1);
+        }
+
+    protected:
+        // The cheapest insertion of a node into a route.
+        struct BestInsertion {
+            Int delta = std::numeric_limits<Int>::max();
+            Int to_node = kIntNull;
+        };
+
+        struct Entry {
+            double regret;
+            Int delta;
+            Int node;
+            Int version;
+
+            // Orders the queue by the largest regret, then the cheapest insertion and the lowest node.
+            bool operator<(const Entry& other) const {
+                if (regret != other.regret)
+                    return regret < other.regret;
+                if (delta != other.delta)
+                    return delta > other.delta;
+                return node > other.node;
+            }
+        };
+
+        using Queue = std::priority_queue<Entry>;
+
+        // Evaluates the cheapest insertions of the remaining nodes into a route, or into all routes for kIntNull, and
+        // queues the nodes with their new regrets.
+        void UpdateInsertions(Int route) {
+            const Routes& routes = *problem_->routes();
+            Int num_routes = routes.num_routes();
+            Int num_nodes = nodes_.size();
+            rlop::ParallelFor(0, num_nodes, [&](Int i) {
+                Int node = nodes_[i];
+                if (route != kIntNull)
+                    best_insertions_[node * num_routes + route] = EvaluateBestInsertion(node, route);
+                else {
+                    for (Int ri=0; ri<num_routes; ++ri)
+                        best_insertions_[node * num_routes + ri] = EvaluateBestInsertion(node, ri);
+                }
+            }, 1, num_threads_);
+            for (Int node : nodes_) {
+                Int best_route = GetBestRoute(node);
+                queue_.push({ GetRegret(node), best_insertions_[node * num_routes + best_route].delta, node, ++versions_[node] });
+            }
+        }
+
+        BestInsertion EvaluateBestInsertion(Int node, Int route) const {
+            const Routes& routes = *problem_->routes();
+            BestInsertion best;
+            for (Int to_node=routes.GetStart(route); ; to_node=routes.GetNext(to_node)) {
+                Int delta = problem_->EvaluateDelta(Insertion(node, to_node));
+                if (delta < best.delta)
+                    best = { delta, to_node };
+                if (to_node == routes.GetSentinel(route))
+                    break;
+            }
+            return best;
+        }
+
+        Int GetBestRoute(Int node) const {
+            Int num_routes = problem_->routes()->num_routes();
+            auto begin = best_insertions_.begin() + node * num_routes;
+            return std::min_element(begin, begin + num_routes, [](const BestInsertion& a, const BestInsertion& b) {
+                return a.delta < b.delta;
+            }) - begin;
+        }
+
+        // Returns the sum of the differences between the k - 1 next cheapest insertions of a node and its cheapest
+        // one. An infeasible insertion counts as a large cost, which favors the nodes with few feasible routes.
+        double GetRegret(Int node) {
+            Int num_routes = problem_->routes()->num_routes();
+            Int k = std::min(k_, num_routes);
+            deltas_.resize(num_routes);
+            for (Int ri=0; ri<num_routes; ++ri) {
+                Int delta = best_insertions_[node * num_routes + ri].delta;
+                deltas_[ri] = delta == std::numeric_limits<Int>::max() ? kInfeasibleCost : delta;
+            }
+            std::partial_sort(deltas_.begin(), deltas_.begin() + k, deltas_.end());
+            double regret = 0;
+            for (Int j=1; j<k; ++j)
+                regret += deltas_[j] - deltas_[0];
+            return regret;
+        }
+
+        static constexpr double kInfeasibleCost = 1e15;
+        Int k_;
+        std::vector<Int> nodes_; // The nodes left to insert.
+        std::vector<BestInsertion> best_insertions_; // The cheapest insertion of each node into each route.
+        std::vector<Int> versions_; // The version of the last queued entry of each node.
+        std::vector<double> deltas_;
+        std::vector<Insertion> insertions_;
+        Queue queue_;
+    };
+}
@@ -2,6 +2,8 @@
 #include "operators.h"
 
 namespace vrp {
+    // Routes as doubly linked lists of nodes closed by one sentinel per route. The position of each node in its route
+    // is kept up to date by the modifications, which answers order queries in O(1).
     class Routes {
     public:
         Routes() = default;
@@ -15,10 +17,12 @@ namespace vrp {
             node_to_route_ = std::vector<Int>(num_routes_ + num_nodes_, kIntNull);
             lasts_ = std::vector<Int>(num_routes_ + num_nodes_, kIntNull);
             nexts_ = std::vector<Int>(num_routes_ + num_nodes_, kIntNull);
+            positions_ = std::vector<Int>(num_routes_ + num_nodes_, kIntNull);
             for (Int i=0; i<num_routes_; ++i) {
                 lasts_[GetSentinel(i)] = GetSentinel(i);
                 nexts_[GetSentinel(i)] = GetSentinel(i);
                 node_to_route_[GetSentinel(i)] = i; 
+                positions_[GetSentinel(i)] = 0;
             }
         }
 
@@ -37,57 +41,47 @@ namespace vrp {
         }
 
         virtual bool Step(const Operator& op) {
-            if (op.GetType() == Operator::Type::kInsertion) {
-                auto insert = static_cast<const Insertion&>(op);
-                if (!Insert(insert.node(), insert.to_node()))
-                    return false;
-            }
-            else if (op.GetType() == Operator::Type::kSwap) {
-                auto swap = static_cast<const Swapping&>(op);
-                if (!Swap(swap.from_node(), swap.to_node()))
-                    return false;
-            }
-            else if (op.GetType() == Operator::Type::kMoving) {
-                auto move = static_cast<const Moving&>(op);
-                if (!Move(move.from_node(), move.to_node()))
-                    return false;
-            }
-            else if (op.GetType() == Operator::Type::kTwoOpt) {
-                auto opt = static_cast<const TwoOpting&>(op);
-                if (!TwoOpt(opt.from_node(), opt.to_node()))
-                    return false;
+            switch (op.GetType()) {
+                case Operator::Type::kInsertion:
+                    return Insert(op.from_node(), op.to_node());
+                case Operator::Type::kSwap:
+                    return Swap(op.from_node(), op.to_node());
+                case Operator::Type::kMoving:
+                    return Move(op.from_node(), op.to_node());
+                case Operator::Type::kTwoOpt:
+                    return TwoOpt(op.from_node(), op.to_node());
             }
             return true;
         }
 
         virtual void Undo(const Operator& op) {
-            if (op.GetType() == Operator::Type::kInsertion) {
-                auto insert = static_cast<const Insertion&>(op);
-                Erase(insert.node());
-            }
-            else if (op.GetType() == Operator::Type::kSwap) {
-                auto swap = static_cast<const Swapping&>(op);
-                Swap(swap.from_node(), swap.to_node());
-            }
-            else if (op.GetType() == Operator::Type::kMoving) {
-                auto move = static_cast<const Moving&>(op);
-                Move(move.to_node(), move.from_node());
-            }
-            else if (op.GetType() == Operator::Type::kTwoOpt) {
-                auto two_opt = static_cast<const TwoOpting&>(op);
-                TwoOpt(two_opt.to_node(), two_opt.from_node()); 
+            switch (op.GetType()) {
+                case Operator::Type::kInsertion:
+                    Erase(op.from_node());
+                    break;
+                case Operator::Type::kSwap:
+                    Swap(op.from_node(), op.to_node());
+                    break;
+                case Operator::Type::kMoving:
+                    Move(op.to_node(), op.from_node());
+                    break;
+                case Operator::Type::kTwoOpt:
+                    TwoOpt(op.to_node(), op.from_node());
+                    break;
             }
         }
 
         bool Erase(Int node) {
             if (!IsErasable(node)) 
                 return false;
-            Int route = GetRoute(node);
-            nexts_[GetLast(node)] = GetNext(node);
-            lasts_[GetNext(node)] = GetLast(node);
+            Int next = GetNext(node);
+            nexts_[GetLast(node)] = next;
+            lasts_[next] = GetLast(node);
             lasts_[node] = kIntNull;
             nexts_[node] = kIntNull;
             node_to_route_[node] = kIntNull;
+            positions_[node] = kIntNull;
+            UpdatePositions(next, GetSentinel(GetRoute(next)));
             --num_visited_nodes_;
             return true;
         }
@@ -101,6 +95,7 @@ namespace vrp {
                 nexts_[GetLast(to_node)] = node;
             lasts_[to_node] = node;
             node_to_route_[node] = GetRoute(to_node);
+            UpdatePositions(node, GetSentinel(GetRoute(node)));
             ++num_visited_nodes_;
             return true;
         }
@@ -115,6 +110,7 @@ namespace vrp {
             std::swap(nexts_[from_node], nexts_[to_node]);
             std::swap(lasts_[from_node], lasts_[to_node]);
             std::swap(node_to_route_[from_node], node_to_route_[to_node]);
+            std::swap(positions_[from_node], positions_[to_node]);
             return true;
         }
 
@@ -129,6 +125,9 @@ namespace vrp {
             nexts_[moved] = to_node;
             lasts_[to_node] = moved;
             node_to_route_[moved] = node_to_route_[to_node];
+            // Within one route, the update starting first also covers the other one.
+            UpdatePositions(moved, GetSentinel(GetRoute(moved)));
+            UpdatePositions(from_node, GetSentinel(GetRoute(from_node)));
             return true;
         }
 
@@ -144,6 +143,7 @@ namespace vrp {
             lasts_[to_next] = from_node;
             nexts_[from_node] = to_next;
             lasts_[to_node] = from_last;
+            UpdatePositions(to_node, to_next);
             return true;
         }
 
@@ -167,8 +167,10 @@ namespace vrp {
             return IsVisited(from_node) && IsVisited(to_node) && GetLast(from_node) != to_node && GetLast(from_node) < num_nodes();
         }
 
+        // A 2-opt reverses the segment from from_node to to_node, which requires from_node not to be after to_node.
         virtual bool IsTwoOptable(Int from_node, Int to_node) const {
-            return IsVisited(from_node) && IsVisited(to_node) && GetRoute(from_node) == GetRoute(to_node);
+            return IsVisited(from_node) && IsVisited(to_node) && GetRoute(from_node) == GetRoute(to_node) && 
+                   GetPosition(from_node) <= GetPosition(to_node);
         }
 
         virtual bool IsStarted(Int route) const {
@@ -199,6 +201,17 @@ namespace vrp {
             return node_to_route_[node]; 
         }
 
+        // Returns the position of a node in its route, from 1 for the start. The sentinel is at 0, and an unvisited
+        // node at kIntNull.
+        virtual Int GetPosition(Int node) const {
+            return positions_[node];
+        }
+
+        // Returns whether node1 comes before node2, both being visited by the same route.
+        bool IsBefore(Int node1, Int node2) const {
+            return GetPosition(node1) < GetPosition(node2);
+        }
+
         Int num_routes() const { 
             return num_routes_; 
         };
@@ -212,11 +225,18 @@ namespace vrp {
         }
 
     protected:
+        // Renumbers the nodes from a node up to an end node excluded, following the position of the node before.
+        void UpdatePositions(Int node, Int end) {
+            for (; node!=end; node=nexts_[node])
+                positions_[node] = positions_[lasts_[node]] + 1;
+        }
+
         Int num_routes_ = 0;
         Int num_nodes_ = 0;
         Int num_visited_nodes_ = 0;
         std::vector<Int> node_to_route_;
         std::vector<Int> lasts_;
         std::vector<Int> nexts_;
+        std::vector<Int> positions_;
     };
 }
@@ -0,0 +1,279 @@
+#pragma once
+#include "cost_manager.h"
+
+namespace vrp {
+    // Penalizes the time warp of the routes, the time by which a vehicle would have to travel back in time to meet the
+    // latest start of its visits, so that time windows are soft constraints of the search. The timing of a sequence of
+    // visits is summarized by a segment, and the segment of two sequences visited one after the other follows from
+    // theirs in O(1) (Vidal et al., A hybrid genetic algorithm with adaptive diversity management for a large class of
+    // vehicle routing problems with time-windows, 2013).
+    //
+    // The segments from the start of the route to each node and from each node to the end of the route are kept, which
+    // evaluates insertions and the operators between two routes in O(1). Swaps and moves within a route also
+    // concatenate the nodes between both positions, and 2-opts the reversed segment, since the segment of a sequence
+    // cannot be recovered from a prefix and a suffix.
+    //
+    // Template Parameters:
+    //   TTravelTime: The callable type returning the travel time between two nodes, as TArcCost of
+    //                BasicArcCostManager.
+    template<typename TTravelTime>
+    class BasicTimeWindowCostManager : public CostManager {
+    public:
+        // The timing of a sequence of visits.
+        struct Segment {
+            Int duration = 0; // The travel, service and waiting time from the start of the first visit.
+            Int time_warp = 0;
+            Int earliest = 0; // The earliest start of the first visit which leads to the least duration.
+            Int latest = 0; // The latest start of the first visit without more time warp.
+
+            // Returns the segment of this sequence followed by another one.
+            //
+            // Parameters:
+            //   next: The segment visited after this one.
+            //   travel_time: The travel time from the last node of this segment to the first node of the next one.
+            Segment Concatenate(const Segment& next, Int travel_time) const {
+                Int delta = duration - time_warp + travel_time;
+                Int wait = std::max<Int>(next.earliest - delta - latest, 0);
+                Int warp = std::max<Int>(earliest + delta - next.latest, 0);
+                return { duration + next.duration + travel_time + wait, time_warp + next.time_warp + warp,
+                         std::max(next.earliest - delta, earliest) - wait, std::min(next.latest - delta, latest) + warp };
+            }
+        };
+
+        BasicTimeWindowCostManager() = default;
+
+        // Parameters:
+        //   routes: The routes whose time windows are managed.
+        //   get_travel_time: The travel time between two nodes.
+        //   earliests: The start of the time window of each node, sentinels included as the depots of the routes.
+        //   latests: The end of the time window of each node, sentinels included.
+        //   service_times: The service time of each node, sentinels included.
+        //   penalty: The cost of each unit of time warp.
+        BasicTimeWindowCostManager(
+            const Routes& routes,
+            const TTravelTime& get_travel_time,
+            std::vector<Int> earliests,
+            std::vector<Int> latests,
+            std::vector<Int> service_times,
+            Int penalty = 1
+        ) :
+            routes_(&routes),
+            get_travel_time_(get_travel_time),
+            earliests_(std::move(earliests)),
+            latests_(std::move(latests)),
+            service_times_(std::move(service_times)),
+            penalty_(penalty)
+        {}
+
+        virtual ~BasicTimeWindowCostManager() = default;
+
+        virtual void Reset() override {
+            Int size = routes_->num_nodes() + routes_->num_routes();
+            if (earliests_.size() != size || latests_.size() != size || service_times_.size() != size)
+                throw std::runtime_error("TimeWindowCostManager: the time windows do not match the routes.");
+            forwards_.assign(size, Segment());
+            backwards_.assign(size, Segment());
+            route_time_warps_.assign(routes_->num_routes(), 0);
+            total_cost_ = 0;
+            for (Int ri=0; ri<routes_->num_routes(); ++ri)
+                UpdateSegments(ri);
+        }
+
+        virtual void Reset(const Routes& routes) {
+            routes_ = &routes;
+            Reset();
+        }
+
+        virtual Int EvaluateDelta(const Operator& op) const override {
+            switch (op.GetType()) {
+                case Operator::Type::kInsertion:
+                    return EvaluateDelta(Insertion(op.from_node(), op.to_node()));
+                case Operator::Type::kSwap:
+                    return EvaluateDelta(Swapping(op.from_node(), op.to_node()));
+                case Operator::Type::kMoving:
+                    return EvaluateDelta(Moving(op.from_node(), op.to_node()));
+                case Operator::Type::kTwoOpt:
+                    return EvaluateDelta(TwoOpting(op.from_node(), op.to_node()));
+            }
+            return 0;
+        }
+
+        virtual Int EvaluateDelta(const Insertion& insert) const {
+            if (!routes_->IsInsertable(insert.node(), insert.to_node()))
+                return std::numeric_limits<Int>::max();
+            Int last = routes_->GetLast(insert.to_node());
+            Segment route = Join(Join(forwards_[last], last, insert.node(), GetSegment(insert.node())), insert.node(),
+                                 insert.to_node(), backwards_[insert.to_node()]);
+            return GetCost(route) - GetRouteCost(routes_->GetRoute(insert.to_node()));
+        }
+
+        virtual Int EvaluateDelta(const Swapping& swap) const {
+            if (!routes_->IsSwappable(swap.from_node(), swap.to_node()))
+                return std::numeric_limits<Int>::max();
+            Int from_route = routes_->GetRoute(swap.from_node());
+            Int to_route = routes_->GetRoute(swap.to_node());
+            if (from_route != to_route) {
+                Segment from = Replace(swap.from_node(), swap.to_node());
+                Segment to = Replace(swap.to_node(), swap.from_node());
+                return GetCost(from) + GetCost(to) - GetRouteCost(from_route) - GetRouteCost(to_route);
+            }
+            Int first = routes_->IsBefore(swap.from_node(), swap.to_node()) ? swap.from_node() : swap.to_node();
+            Int second = first == swap.from_node() ? swap.to_node() : swap.from_node();
+            Int first_last = routes_->GetLast(first);
+            Int first_next = routes_->GetNext(first);
+            Int second_last = routes_->GetLast(second);
+            Int second_next = routes_->GetNext(second);
+            Segment route = Join(forwards_[first_last], first_last, second, GetSegment(second));
+            route = Join(route, second, first_next, GetSubsequence(first_next, second_last));
+            route = Join(route, second_last, first, GetSegment(first));
+            route = Join(route, first, second_next, backwards_[second_next]);
+            return GetCost(route) - GetRouteCost(from_route);
+        }
+
+        virtual Int EvaluateDelta(const Moving& move) const {
+            if (!routes_->IsMovable(move.from_node(), move.to_node()))
+                return std::numeric_limits<Int>::max();
+            if (move.from_node() == move.to_node())
+                return 0;
+            Int node = routes_->GetLast(move.from_node());
+            Int node_last = routes_->GetLast(node);
+            Int to_last = routes_->GetLast(move.to_node());
+            Int from_route = routes_->GetRoute(node);
+            Int to_route = routes_->GetRoute(move.to_node());
+            if (from_route != to_route) {
+                Segment from = Join(forwards_[node_last], node_last, move.from_node(), backwards_[move.from_node()]);
+                Segment to = Join(Join(forwards_[to_last], to_last, node, GetSegment(node)), node, move.to_node(),
+                                  backwards_[move.to_node()]);
+                return GetCost(from) + GetCost(to) - GetRouteCost(from_route) - GetRouteCost(to_route);
+            }
+            Segment route;
+            if (move.to_node() == routes_->GetSentinel(to_route) || routes_->IsBefore(node, move.to_node())) {
+                route = Join(forwards_[node_last], node_last, move.from_node(), GetSubsequence(move.from_node(), to_last));
+                route = Join(route, to_last, node, GetSegment(node));
+                route = Join(route, node, move.to_node(), backwards_[move.to_node()]);
+            }
+            else {
+                route = Join(forwards_[to_last], to_last, node, GetSegment(node));
+                route = Join(route, node, move.to_node(), GetSubsequence(move.to_node(), node_last));
+                route = Join(route, node_last, move.from_node(), backwards_[move.from_node()]);
+            }
+            return GetCost(route) - GetRouteCost(from_route);
+        }
+
+        virtual Int EvaluateDelta(const TwoOpting& two_opt) const {
+            if (!routes_->IsTwoOptable(two_opt.from_node(), two_opt.to_node()))
+                return std::numeric_limits<Int>::max();
+            Int from_last = routes_->GetLast(two_opt.from_node());
+            Int to_next = routes_->GetNext(two_opt.to_node());
+            Segment route = Join(forwards_[from_last], from_last, two_opt.to_node(),
+                                 GetReversedSubsequence(two_opt.from_node(), two_opt.to_node()));
+            route = Join(route, two_opt.from_node(), to_next, backwards_[to_next]);
+            return GetCost(route) - GetRouteCost(routes_->GetRoute(two_opt.from_node()));
+        }
+
+        // The segments are updated by Synchronize(), once the routes are modified.
+        virtual void Step(const Operator& op) override {}
+
+        // Recomputes the segments of the routes of the operator. These are the only routes an operator modifies, in
+        // both directions.
+        virtual void Synchronize(const Operator& op) override {
+            Int from_route = routes_->GetRoute(op.from_node());
+            Int to_route = routes_->GetRoute(op.to_node());
+            if (from_route != kIntNull)
+                UpdateSegments(from_route);
+            if (to_route != kIntNull && to_route != from_route)
+                UpdateSegments(to_route);
+        }
+
+        // Returns the segment of a single visit.
+        Segment GetSegment(Int node) const {
+            return { service_times_[node], 0, earliests_[node], latests_[node] };
+        }
+
+        // Returns the segment of the visits from first to last, two nodes of the same route with first not after last.
+        Segment GetSubsequence(Int first, Int last) const {
+            Segment segment = GetSegment(first);
+            for (Int ni=first; ni!=last; ni=routes_->GetNext(ni))
+                segment = Join(segment, ni, routes_->GetNext(ni), GetSegment(routes_->GetNext(ni)));
+            return segment;
+        }
+
+        // Returns the segment of the visits from last back to first.
+        Segment GetReversedSubsequence(Int first, Int last) const {
+            Segment segment = GetSegment(last);
+            for (Int ni=last; ni!=first; ni=routes_->GetLast(ni))
+                segment = Join(segment, ni, routes_->GetLast(ni), GetSegment(routes_->GetLast(ni)));
+            return segment;
+        }
+
+        Int route_time_warp(Int route) const {
+            return route_time_warps_[route];
+        }
+
+        Int penalty() const {
+            return penalty_;
+        }
+
+        // Sets the cost of each unit of time warp, and recomputes the total cost with it.
+        void set_penalty(Int penalty) {
+            penalty_ = penalty;
+            Reset();
+        }
+
+        const TTravelTime& get_travel_time() const {
+            return get_travel_time_;
+        }
+
+    protected:
+        Segment Join(const Segment& segment, Int last, Int first, const Segment& next) const {
+            return segment.Concatenate(next, get_travel_time_(last, first));
+        }
+
+        // Returns the segment of the route of a node in which the node is replaced by another one.
+        Segment Replace(Int node, Int by) const {
+            Int last = routes_->GetLast(node);
+            Int next = routes_->GetNext(node);
+            return Join(Join(forwards_[last], last, by, GetSegment(by)), by, next, backwards_[next]);
+        }
+
+        Int GetCost(const Segment& route) const {
+            return penalty_ * route.time_warp;
+        }
+
+        Int GetRouteCost(Int route) const {
+            return penalty_ * route_time_warps_[route];
+        }
+
+        // Recomputes the segments from the sentinel of a route to its nodes and back. The sentinel starts the forward
+        // segments and ends the backward ones.
+        void UpdateSegments(Int route) {
+            Int sentinel = routes_->GetSentinel(route);
+            forwards_[sentinel] = GetSegment(sentinel);
+            backwards_[sentinel] = GetSegment(sentinel);
+            for (Int ni=routes_->GetStart(route); ni!=sentinel; ni=routes_->GetNext(ni)) {
+                Int last = routes_->GetLast(ni);
+                forwards_[ni] = Join(forwards_[last], last, ni, GetSegment(ni));
+            }
+            for (Int ni=routes_->GetCurrent(route); ni!=sentinel; ni=routes_->GetLast(ni)) {
+                Int next = routes_->GetNext(ni);
+                backwards_[ni] = Join(GetSegment(ni), ni, next, backwards_[next]);
+            }
+            Int current = routes_->GetCurrent(route);
+            total_cost_ -= GetRouteCost(route);
+            route_time_warps_[route] = Join(forwards_[current], current, sentinel, backwards_[sentinel]).time_warp;
+            total_cost_ += GetRouteCost(route);
+        }
+
+        const Routes* routes_ = nullptr;
+        TTravelTime get_travel_time_;
+        std::vector<Int> earliests_;
+        std::vector<Int> latests_;
+        std::vector<Int> service_times_;
+        Int penalty_ = 1;
+        std::vector<Segment> forwards_; // The segment from the sentinel to each node.
+        std::vector<Segment> backwards_; // The segment from each node to the sentinel.
+        std::vector<Int> route_time_warps_;
+    };
+
+    using TimeWindowCostManager = BasicTimeWindowCostManager<std::function<Int(Int, Int)>>;
+}
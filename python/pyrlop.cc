@@ -0,0 +1,213 @@
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <pybind11/stl.h>
+#include "examples/connect4/alpha_beta_search.h"
+#include "examples/connect4/mcts.h"
+#include "examples/vrp/local_search.h"
+#include "examples/vrp/simulate_annealing.h"
+#include "examples/vrp/tabu_search.h"
+#include "problems/vrp/insertion_solver.h"
+
+// The Python module pyrlop, which exposes the searches on their C++ domains: the MCTS and the alpha-beta search of
+// connect four, and the local searches of the VRP. The searches release the GIL, so that other Python threads run
+// meanwhile, and the cost matrices of the VRP are read in place from the numpy arrays.
+namespace py = pybind11;
+
+namespace pyrlop {
+    using rlop::Int;
+
+    // Returns the board of a position of connect four, a string of the 42 cells from the top row to the bottom one,
+    // 'X' and 'O' for the discs and any other character for an empty cell.
+    inline connect4::Board MakeBoard(const std::string& position) {
+        if (position.size() != connect4::Board::kSize_)
+            throw std::runtime_error("pyrlop: a position of connect four has " + std::to_string(connect4::Board::kSize_) + " cells, not " + std::to_string(position.size()) + ".");
+        connect4::Board board;
+        board.Reset(position);
+        return board;
+    }
+
+    // A VRP solved by a local search of examples/vrp, such as vrp::TabuSearch. The cost matrix is a C-contiguous
+    // int64 numpy array of the costs between the nodes, the targets followed by the depots of the vehicles, which is
+    // kept alive and read in place, and must not be modified during a search.
+    template <typename TSearch>
+    class VRPSolver {
+    public:
+        using CostMatrix = py::array_t<Int, py::array::c_style>;
+
+        template <typename... Args>
+        VRPSolver(const py::array& costs, Int num_vehicles, Args... args) :
+            costs_(CheckCosts(costs, num_vehicles)),
+            num_vehicles_(num_vehicles),
+            num_nodes_(costs_.shape(0) - num_vehicles),
+            search_(MakeGetCost(), args...)
+        {}
+
+        // Sets the demands of the targets and the capacities of the vehicles, whose excess loads are penalized by the
+        // cost of each unit.
+        void SetCapacities(std::vector<Int> demands, std::vector<Int> capacities, Int penalty) {
+            if (demands.size() != num_nodes_ || capacities.size() != num_vehicles_)
+                throw std::runtime_error("pyrlop: requires one demand per target and one capacity per vehicle.");
+            search_.set_capacities(std::move(demands), std::move(capacities), penalty);
+        }
+
+        // Searches from the routes given, one list of targets per vehicle, or from the routes of the cheapest
+        // insertions if none, and returns the best routes and their cost.
+        std::pair<std::vector<std::vector<Int>>, Int> Solve(Int max_num_iters, const std::optional<std::vector<std::vector<Int>>>& initial_routes) {
+            vrp::Routes routes = initial_routes ? MakeRoutes(*initial_routes) : InsertRoutes();
+            py::gil_scoped_release release;
+            search_.Reset(routes);
+            search_.Search(max_num_iters);
+            return { ToLists(search_.best_routes()), search_.best_cost() };
+        }
+
+        TSearch& search() {
+            return search_;
+        }
+
+        Int num_nodes() const {
+            return num_nodes_;
+        }
+
+        Int num_vehicles() const {
+            return num_vehicles_;
+        }
+
+    protected:
+        static CostMatrix CheckCosts(const py::array& costs, Int num_vehicles) {
+            // The cast of an array of another type or layout would copy it.
+            if (!py::isinstance<CostMatrix>(costs))
+                throw std::runtime_error("pyrlop: the cost matrix must be a C-contiguous numpy array of int64.");
+            CostMatrix matrix = py::reinterpret_borrow<CostMatrix>(costs);
+            if (matrix.ndim() != 2 || matrix.shape(0) != matrix.shape(1))
+                throw std::runtime_error("pyrlop: the cost matrix must be square.");
+            if (num_vehicles <= 0 || matrix.shape(0) <= num_vehicles)
+                throw std::runtime_error("pyrlop: the cost matrix must have the targets followed by the depots of the vehicles.");
+            return matrix;
+        }
+
+        // Returns the cost function over the matrix, in which the sentinel of each route is the depot of its vehicle.
+        std::function<Int(Int, Int)> MakeGetCost() const {
+            const Int* data = costs_.data();
+            Int size = costs_.shape(0);
+            return [data, size](Int from, Int to) {
+                return data[from * size + to];
+            };
+        }
+
+        vrp::Routes MakeRoutes(const std::vector<std::vector<Int>>& lists) const {
+            if (lists.size() != num_vehicles_)
+                throw std::runtime_error("pyrlop: requires one route per vehicle.");
+            vrp::Routes routes(num_vehicles_, num_nodes_);
+            routes.Reset();
+            for (Int r=0; r<num_vehicles_; ++r) {
+                for (Int node : lists[r]) {
+                    if (node < 0 || node >= num_nodes_ || !routes.Step(vrp::Insertion(node, routes.GetSentinel(r))))
+                        throw std::runtime_error("pyrlop: the route " + std::to_string(r) + " visits an unknown or visited target " + std::to_string(node) + ".");
+                }
+            }
+            return routes;
+        }
+
+        vrp::Routes InsertRoutes() const {
+            py::gil_scoped_release release;
+            vrp::Routes routes(num_vehicles_, num_nodes_);
+            routes.Reset();
+            vrp::ArcCostManager cost_manager(routes, MakeGetCost());
+            vrp::OperatorSpace space(routes);
+            vrp::BasicProblem<vrp::ArcCostManager> problem(&routes, &space, &cost_manager);
+            cost_manager.Reset();
+            space.Reset();
+            vrp::InsertionSolver(&problem).Solve();
+            return routes;
+        }
+
+        static std::vector<std::vector<Int>> ToLists(const vrp::Routes& routes) {
+            std::vector<std::vector<Int>> lists(routes.num_routes());
+            for (Int r=0; r<routes.num_routes(); ++r) {
+                for (Int node=routes.GetStart(r); node!=routes.GetSentinel(r); node=routes.GetNext(node)) {
+                    lists[r].push_back(node);
+                }
+            }
+            return lists;
+        }
+
+        CostMatrix costs_;
+        Int num_vehicles_;
+        Int num_nodes_;
+        TSearch search_;
+    };
+
+    // Binds the functions shared by the VRP solvers to a class whose constructor is bound by the caller.
+    template <typename TSolver>
+    void BindVRPSolver(py::class_<TSolver>& cls) {
+        cls.def("set_capacities", &TSolver::SetCapacities, py::arg("demands"), py::arg("capacities"), py::arg("penalty") = 1)
+            .def("set_dont_look_bits", [](TSolver& solver, bool dont_look_bits) { solver.search().set_dont_look_bits(dont_look_bits); }, py::arg("dont_look_bits"))
+            .def("solve", &TSolver::Solve, py::arg("max_num_iters") = 10000, py::arg("initial_routes") = std::nullopt,
+                "Searches from the routes given, or from the cheapest insertions, and returns the best routes and their cost.")
+            .def_property_readonly("num_nodes", &TSolver::num_nodes)
+            .def_property_readonly("num_vehicles", &TSolver::num_vehicles);
+    }
+}
+
+PYBIND11_MODULE(pyrlop, m) {
+    using namespace pyrlop;
+
+    m.doc() = "The searches of RLOP on their C++ domains.";
+
+    py::module_ connect4_module = m.def_submodule("connect4", "The searches of connect four.");
+
+    py::class_<connect4::MCTS>(connect4_module, "MCTS", "The root-parallel MCTS of connect four, one tree per move.")
+        .def(py::init([](double coef, Int num_playouts) {
+            auto mcts = std::make_unique<connect4::MCTS>(coef);
+            mcts->set_num_playouts(num_playouts);
+            mcts->Reset();
+            return mcts;
+        }), py::arg("coef") = std::sqrt(2), py::arg("num_playouts") = 4)
+        .def("reset", &connect4::MCTS::Reset, py::call_guard<py::gil_scoped_release>())
+        .def("search", [](connect4::MCTS& mcts, const std::string& position, Int max_num_iters, bool reuse_trees) {
+            connect4::Board board = MakeBoard(position);
+            py::gil_scoped_release release;
+            Int move = mcts.NewSearch(board, max_num_iters, reuse_trees);
+            return move == rlop::kIntNull ? std::nullopt : std::optional<Int>(move);
+        }, py::arg("position"), py::arg("max_num_iters") = 6000, py::arg("reuse_trees") = true,
+            "Returns the column of the best move of a position, or None if the game is over.");
+
+    py::class_<connect4::AlphaBetaSearch>(connect4_module, "AlphaBetaSearch", "The alpha-beta search of connect four with a transposition table.")
+        .def(py::init([](Int num_threads) {
+            auto search = std::make_unique<connect4::AlphaBetaSearch>();
+            search->set_num_threads(num_threads);
+            search->Reset();
+            return search;
+        }), py::arg("num_threads") = 1)
+        .def("reset", [](connect4::AlphaBetaSearch& search) { search.Reset(); }, py::call_guard<py::gil_scoped_release>())
+        .def("search", [](connect4::AlphaBetaSearch& search, const std::string& position, Int depth, Int max_duration) {
+            connect4::Board board = MakeBoard(position);
+            py::gil_scoped_release release;
+            Int move = search.NewSearch(board, depth, max_duration);
+            return std::make_pair(move, search.last_value());
+        }, py::arg("position"), py::arg("depth") = rlop::kIntFull, py::arg("max_duration") = rlop::kIntFull,
+            "Returns the column of the best move of a position and its value, 1 for a win, -1 for a loss and 0 otherwise, with a maximum duration in milliseconds.")
+        .def("load_book", [](connect4::AlphaBetaSearch& search, const std::string& path) {
+            search.set_book(std::make_shared<rlop::TranspositionBook<connect4::Board::bitboard>>(path));
+        }, py::arg("path"))
+        .def("save_book", &connect4::AlphaBetaSearch::SaveBook, py::arg("path"), py::arg("max_num_moves") = connect4::Board::kSize_,
+            py::call_guard<py::gil_scoped_release>())
+        .def_property_readonly("num_nodes", &connect4::AlphaBetaSearch::num_nodes);
+
+    py::module_ vrp_module = m.def_submodule("vrp", "The local searches of the vehicle routing problem.");
+
+    using LocalSearch = VRPSolver<vrp::LocalSearch>;
+    py::class_<LocalSearch> local_search(vrp_module, "LocalSearch", "The best-improvement local search of the VRP.");
+    local_search.def(py::init<const py::array&, Int, Int>(), py::arg("costs"), py::arg("num_vehicles"), py::arg("max_num_unimproved_iters") = 50);
+    BindVRPSolver(local_search);
+
+    using TabuSearch = VRPSolver<vrp::TabuSearch>;
+    py::class_<TabuSearch> tabu_search(vrp_module, "TabuSearch", "The tabu search of the VRP.");
+    tabu_search.def(py::init<const py::array&, Int, Int, Int>(), py::arg("costs"), py::arg("num_vehicles"), py::arg("max_num_unimproved_iters") = 50, py::arg("tenure") = 10);
+    BindVRPSolver(tabu_search);
+
+    using SimulatedAnnealing = VRPSolver<vrp::SimulatedAnnealing>;
+    py::class_<SimulatedAnnealing> simulated_annealing(vrp_module, "SimulatedAnnealing", "The simulated annealing of the VRP.");
+    simulated_annealing.def(py::init<const py::array&, Int, double, double, double>(), py::arg("costs"), py::arg("num_vehicles"), py::arg("initial_temp") = 100.0, py::arg("final_temp") = 0.01, py::arg("cooling_rate") = 0.03);
+    BindVRPSolver(simulated_annealing);
+}
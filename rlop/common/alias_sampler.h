@@ -0,0 +1,129 @@
+#pragma once
+#include "typedef.h"
+
+namespace rlop {
+    // Draws indices in proportion to non-negative weights in O(1) per draw after an O(n) setup, by the alias method
+    // of Walker as built by Vose. Each index owns a cell of equal probability, which yields either the index itself or
+    // its alias, so that a draw is a uniform cell and a comparison. This suits many draws from the same weights, such
+    // as a rollout policy or a prior, where Random::Discrete() pays O(n) per draw. Weights changed by Set() are
+    // applied by a single rebuild at the next draw, so that a batch of changes costs one O(n) rebuild; weights that
+    // change at every draw are better kept in a SumTree.
+    class AliasSampler {
+    public:
+        AliasSampler() = default;
+
+        template<typename TIterator>
+        AliasSampler(const TIterator& begin, const TIterator& end) {
+            Reset(begin, end);
+        }
+
+        virtual ~AliasSampler() = default;
+
+        // Sets all the weights and builds the table. The buffers are reused, so that resetting weights of the same
+        // size does not allocate.
+        template<typename TIterator>
+        void Reset(const TIterator& begin, const TIterator& end) {
+            weights_.assign(begin, end);
+            Rebuild();
+        }
+
+        // Changes the weight of an index. The table is rebuilt at the next draw.
+        void Set(Int i, double weight) {
+            weights_[i] = weight;
+            dirty_ = true;
+        }
+
+        // Builds the table from the weights in O(n). The draws are uniform if the weights sum to zero.
+        void Rebuild() {
+            Int size = weights_.size();
+            probs_.resize(size);
+            aliases_.resize(size);
+            small_.clear();
+            large_.clear();
+            total_ = 0;
+            for (double weight : weights_)
+                total_ += std::max(weight, 0.0);
+            for (Int i=0; i<size; ++i) {
+                probs_[i] = total_ > 0 ? std::max(weights_[i], 0.0) * size / total_ : 1;
+                aliases_[i] = i;
+                if (probs_[i] < 1)
+                    small_.push_back(i);
+                else
+                    large_.push_back(i);
+            }
+            while (!small_.empty() && !large_.empty()) {
+                Int small = small_.back();
+                small_.pop_back();
+                Int large = large_.back();
+                aliases_[small] = large;
+                probs_[large] = (probs_[large] + probs_[small]) - 1;
+                if (probs_[large] < 1) {
+                    large_.pop_back();
+                    small_.push_back(large);
+                }
+            }
+            // What is left is due to rounding and keeps its own cell.
+            for (Int i : small_)
+                probs_[i] = 1;
+            for (Int i : large_)
+                probs_[i] = 1;
+            dirty_ = false;
+        }
+
+        // Draws an index with one uniform draw.
+        //
+        // Template Parameters:
+        //   TRandom: The type of the random number generator, such as Random.
+        //
+        // Returns:
+        //   Int: The index drawn, or kIntNull if there are no weights.
+        template<typename TRandom>
+        Int Sample(TRandom& rand) {
+            if (dirty_)
+                Rebuild();
+            Int size = probs_.size();
+            if (size == 0)
+                return kIntNull;
+            double u = rand.Uniform(0.0, static_cast<double>(size));
+            Int i = std::min(static_cast<Int>(u), size - 1);
+            Int alias = aliases_[i];
+            // A blend rather than a branch, which would mispredict on the cells shared with an alias.
+            return alias + (u - i < probs_[i]) * (i - alias);
+        }
+
+        // Fills a range with independent draws.
+        //
+        // Template Parameters:
+        //   TRandom: The type of the random number generator, such as Random.
+        //   TIterator: Iterator type pointing to a collection of integral values.
+        template<typename TRandom, typename TIterator>
+        void Sample(TRandom& rand, const TIterator& begin, const TIterator& end) {
+            if (dirty_)
+                Rebuild();
+            for (auto it=begin; it!=end; ++it)
+                *it = Sample(rand);
+        }
+
+        Int size() const {
+            return weights_.size();
+        }
+
+        const std::vector<double>& weights() const {
+            return weights_;
+        }
+
+        // The sum of the positive weights at the last rebuild.
+        double total() const {
+            return total_;
+        }
+
+    protected:
+        std::vector<double> weights_;
+        std::vector<double> probs_;
+        std::vector<Int> aliases_;
+        std::vector<Int> small_;
+        std::vector<Int> large_;
+        double total_ = 0;
+        bool dirty_ = false;
+    };
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include "utils.h"
+
+namespace rlop {
+    // A double-ended queue in a ring of fixed capacity, whose pushes and pops at both ends are O(1) and never
+    // allocate, which suits sequences bounded in size and changed at both ends, such as the body of a snake. Unlike
+    // CircularStack, a push on a full deque throws instead of overwriting. The elements are indexed from the front.
+    template <typename T>
+    class CircularDeque {
+    public:
+        CircularDeque(size_t capacity = 1) : vec_(std::max(capacity, size_t(1))) {}
+
+        void Reset() {
+            head_ = 0;
+            size_ = 0;
+        }
+
+        bool Empty() const {
+            return size_ == 0;
+        }
+
+        size_t Capacity() const {
+            return vec_.size();
+        }
+
+        size_t Size() const {
+            return size_;
+        }
+
+        void PushFront(const T& element) {
+            if (size_ == vec_.size())
+                throw std::runtime_error("CircularDeque: push on full deque.");
+            head_ = (head_ == 0? vec_.size() : head_) - 1;
+            vec_[head_] = element;
+            ++size_;
+        }
+
+        void PushBack(const T& element) {
+            if (size_ == vec_.size())
+                throw std::runtime_error("CircularDeque: push on full deque.");
+            vec_[Index(size_)] = element;
+            ++size_;
+        }
+
+        void PopFront() {
+            if (Empty())
+                throw std::runtime_error("CircularDeque: pop on empty deque.");
+            head_ = (head_ + 1) % vec_.size();
+            --size_;
+        }
+
+        void PopBack() {
+            if (Empty())
+                throw std::runtime_error("CircularDeque: pop on empty deque.");
+            --size_;
+        }
+
+        T& Front() {
+            if (Empty())
+                throw std::runtime_error("CircularDeque: get elements on empty deque.");
+            return vec_[head_];
+        }
+
+        const T& Front() const {
+            if (Empty())
+                throw std::runtime_error("CircularDeque: get elements on empty deque.");
+            return vec_[head_];
+        }
+
+        T& Back() {
+            if (Empty())
+                throw std::runtime_error("CircularDeque: get elements on empty deque.");
+            return vec_[Index(size_ - 1)];
+        }
+
+        const T& Back() const {
+            if (Empty())
+                throw std::runtime_error("CircularDeque: get elements on empty deque.");
+            return vec_[Index(size_ - 1)];
+        }
+
+        T& operator[](size_t i) {
+            return vec_[Index(i)];
+        }
+
+        const T& operator[](size_t i) const {
+            return vec_[Index(i)];
+        }
+
+    private:
+        size_t Index(size_t i) const {
+            i += head_;
+            return i < vec_.size()? i : i - vec_.size();
+        }
+
+        std::vector<T> vec_;
+        size_t head_ = 0;
+        size_t size_ = 0;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,308 @@
+#pragma once
+#include <atomic>
+#include "typedef.h"
+
+namespace rlop {
+    // A lock-free circular queue of fixed capacity between one producer thread and one consumer thread, such as an
+    // environment worker feeding a learner. Unlike CircularStack, a full queue rejects new elements instead of
+    // overwriting the oldest ones, since the producer cannot overwrite what the consumer may be reading. The
+    // positions of the producer and the consumer are kept on their own cache lines, each with a cached copy of the
+    // other position, so that the threads only read each other's line when the queue looks full or empty. The batch
+    // functions move several elements with a single publication.
+    //
+    // Template Parameters:
+    //   T: The type of the elements, which must be default constructible and movable.
+    template <typename T>
+    class SPSCCircularQueue {
+    public:
+        // Constructs a queue holding at least `capacity` elements, rounded up to a power of two.
+        SPSCCircularQueue(size_t capacity = 1) {
+            size_t size = 1;
+            while (size < capacity)
+                size *= 2;
+            vec_.resize(size);
+            mask_ = size - 1;
+        }
+
+        DISALLOW_COPY_AND_ASSIGN(SPSCCircularQueue);
+
+        // Empties the queue. Neither thread may use the queue meanwhile.
+        void Reset() {
+            head_.store(0, std::memory_order_relaxed);
+            tail_.store(0, std::memory_order_relaxed);
+            cached_head_ = 0;
+            cached_tail_ = 0;
+        }
+
+        // Appends an element. Called by the producer only.
+        //
+        // Returns:
+        //   bool: Returns false if the queue is full, leaving the element untouched.
+        template<typename U>
+        bool TryPush(U&& element) {
+            size_t tail = tail_.load(std::memory_order_relaxed);
+            if (tail - cached_head_ == vec_.size()) {
+                cached_head_ = head_.load(std::memory_order_acquire);
+                if (tail - cached_head_ == vec_.size())
+                    return false;
+            }
+            vec_[tail & mask_] = std::forward<U>(element);
+            tail_.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Moves the longest prefix of a range that fits into the queue. Called by the producer only.
+        //
+        // Returns:
+        //   size_t: The number of elements pushed.
+        template<typename TIterator>
+        size_t TryPushBatch(TIterator begin, const TIterator& end) {
+            size_t tail = tail_.load(std::memory_order_relaxed);
+            size_t size = std::distance(begin, end);
+            if (vec_.size() - (tail - cached_head_) < size)
+                cached_head_ = head_.load(std::memory_order_acquire);
+            size = std::min(size, vec_.size() - (tail - cached_head_));
+            for (size_t i=0; i<size; ++i, ++begin)
+                vec_[(tail + i) & mask_] = std::move(*begin);
+            if (size > 0)
+                tail_.store(tail + size, std::memory_order_release);
+            return size;
+        }
+
+        // Removes the oldest element. Called by the consumer only.
+        //
+        // Returns:
+        //   bool: Returns false if the queue is empty.
+        bool TryPop(T& element) {
+            size_t head = head_.load(std::memory_order_relaxed);
+            if (head == cached_tail_) {
+                cached_tail_ = tail_.load(std::memory_order_acquire);
+                if (head == cached_tail_)
+                    return false;
+            }
+            element = std::move(vec_[head & mask_]);
+            head_.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Removes up to `max_size` of the oldest elements into an output iterator. Called by the consumer only.
+        //
+        // Returns:
+        //   size_t: The number of elements popped.
+        template<typename TIterator>
+        size_t TryPopBatch(TIterator out, size_t max_size) {
+            size_t head = head_.load(std::memory_order_relaxed);
+            if (cached_tail_ - head < max_size)
+                cached_tail_ = tail_.load(std::memory_order_acquire);
+            size_t size = std::min(max_size, cached_tail_ - head);
+            for (size_t i=0; i<size; ++i, ++out)
+                *out = std::move(vec_[(head + i) & mask_]);
+            if (size > 0)
+                head_.store(head + size, std::memory_order_release);
+            return size;
+        }
+
+        // Whether the queue is empty, which is exact for the consumer and may be outdated for other threads.
+        bool Empty() const {
+            return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+        }
+
+        size_t Capacity() const {
+            return vec_.size();
+        }
+
+        // The number of elements, which may be outdated by the time it returns if the queue is in use.
+        size_t Size() const {
+            size_t head = head_.load(std::memory_order_acquire);
+            return tail_.load(std::memory_order_acquire) - head;
+        }
+
+    protected:
+        std::vector<T> vec_;
+        size_t mask_ = 0;
+        alignas(kCacheLineSize) std::atomic<size_t> tail_{0}; // Written by the producer.
+        size_t cached_head_ = 0;
+        alignas(kCacheLineSize) std::atomic<size_t> head_{0}; // Written by the consumer.
+        size_t cached_tail_ = 0;
+    };
+
+    // A lock-free circular queue of fixed capacity shared by any number of producer and consumer threads, such as
+    // search threads feeding an inference batcher, after the bounded queue of Vyukov. Every cell carries a sequence
+    // number telling whether it awaits a producer or a consumer of a given round, so that a thread claims a cell with
+    // a single compare and swap on the shared position and then fills or empties it without further contention. The
+    // batch functions claim a run of ready cells with one compare and swap. As with SPSCCircularQueue, a full queue
+    // rejects new elements.
+    //
+    // Template Parameters:
+    //   T: The type of the elements, which must be default constructible and movable.
+    template <typename T>
+    class MPMCCircularQueue {
+    public:
+        // Constructs a queue holding at least `capacity` elements, rounded up to a power of two.
+        MPMCCircularQueue(size_t capacity = 1) {
+            size_t size = 2;
+            while (size < capacity)
+                size *= 2;
+            cells_ = std::vector<Cell>(size);
+            mask_ = size - 1;
+            Reset();
+        }
+
+        DISALLOW_COPY_AND_ASSIGN(MPMCCircularQueue);
+
+        // Empties the queue. No thread may use the queue meanwhile.
+        void Reset() {
+            for (size_t i=0; i<cells_.size(); ++i)
+                cells_[i].sequence.store(i, std::memory_order_relaxed);
+            head_.store(0, std::memory_order_relaxed);
+            tail_.store(0, std::memory_order_relaxed);
+        }
+
+        // Appends an element.
+        //
+        // Returns:
+        //   bool: Returns false if the queue is full, leaving the element untouched.
+        template<typename U>
+        bool TryPush(U&& element) {
+            size_t tail = tail_.load(std::memory_order_relaxed);
+            Cell* cell;
+            while (true) {
+                cell = &cells_[tail & mask_];
+                size_t sequence = cell->sequence.load(std::memory_order_acquire);
+                auto diff = static_cast<std::ptrdiff_t>(sequence - tail);
+                if (diff == 0) {
+                    if (tail_.compare_exchange_weak(tail, tail + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (diff < 0)
+                    return false;
+                else
+                    tail = tail_.load(std::memory_order_relaxed);
+            }
+            cell->element = std::forward<U>(element);
+            cell->sequence.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Moves the longest prefix of a range for which consecutive free cells can be claimed together.
+        //
+        // Returns:
+        //   size_t: The number of elements pushed, 0 only if the queue is full.
+        template<typename TIterator>
+        size_t TryPushBatch(TIterator begin, const TIterator& end) {
+            size_t max_size = std::distance(begin, end);
+            if (max_size == 0)
+                return 0;
+            size_t tail = tail_.load(std::memory_order_relaxed);
+            size_t size;
+            while (true) {
+                size = CountReady(tail, 0, max_size);
+                if (size > 0) {
+                    if (tail_.compare_exchange_weak(tail, tail + size, std::memory_order_relaxed))
+                        break;
+                }
+                else if (static_cast<std::ptrdiff_t>(cells_[tail & mask_].sequence.load(std::memory_order_acquire) - tail) < 0)
+                    return 0;
+                else
+                    tail = tail_.load(std::memory_order_relaxed);
+            }
+            for (size_t i=0; i<size; ++i, ++begin) {
+                Cell& cell = cells_[(tail + i) & mask_];
+                cell.element = std::move(*begin);
+                cell.sequence.store(tail + i + 1, std::memory_order_release);
+            }
+            return size;
+        }
+
+        // Removes the oldest element.
+        //
+        // Returns:
+        //   bool: Returns false if the queue is empty.
+        bool TryPop(T& element) {
+            size_t head = head_.load(std::memory_order_relaxed);
+            Cell* cell;
+            while (true) {
+                cell = &cells_[head & mask_];
+                size_t sequence = cell->sequence.load(std::memory_order_acquire);
+                auto diff = static_cast<std::ptrdiff_t>(sequence - (head + 1));
+                if (diff == 0) {
+                    if (head_.compare_exchange_weak(head, head + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (diff < 0)
+                    return false;
+                else
+                    head = head_.load(std::memory_order_relaxed);
+            }
+            element = std::move(cell->element);
+            cell->sequence.store(head + mask_ + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Removes up to `max_size` of the oldest elements into an output iterator, as many as are ready in a row.
+        //
+        // Returns:
+        //   size_t: The number of elements popped, 0 only if the queue is empty.
+        template<typename TIterator>
+        size_t TryPopBatch(TIterator out, size_t max_size) {
+            if (max_size == 0)
+                return 0;
+            size_t head = head_.load(std::memory_order_relaxed);
+            size_t size;
+            while (true) {
+                size = CountReady(head, 1, max_size);
+                if (size > 0) {
+                    if (head_.compare_exchange_weak(head, head + size, std::memory_order_relaxed))
+                        break;
+                }
+                else if (static_cast<std::ptrdiff_t>(cells_[head & mask_].sequence.load(std::memory_order_acquire) - (head + 1)) < 0)
+                    return 0;
+                else
+                    head = head_.load(std::memory_order_relaxed);
+            }
+            for (size_t i=0; i<size; ++i, ++out) {
+                Cell& cell = cells_[(head + i) & mask_];
+                *out = std::move(cell.element);
+                cell.sequence.store(head + i + mask_ + 1, std::memory_order_release);
+            }
+            return size;
+        }
+
+        // Whether the queue is empty, which may be outdated by the time it returns if the queue is in use.
+        bool Empty() const {
+            return Size() == 0;
+        }
+
+        size_t Capacity() const {
+            return cells_.size();
+        }
+
+        // The number of elements claimed by producers and not yet by consumers, which may be outdated by the time it
+        // returns if the queue is in use.
+        size_t Size() const {
+            size_t head = head_.load(std::memory_order_acquire);
+            size_t tail = tail_.load(std::memory_order_acquire);
+            return tail > head ? tail - head : 0;
+        }
+
+    protected:
+        struct Cell {
+            std::atomic<size_t> sequence{0};
+            T element;
+        };
+
+        // Counts the cells from a position ready for a producer (offset 0) or a consumer (offset 1), up to a maximum.
+        size_t CountReady(size_t position, size_t offset, size_t max_size) const {
+            size_t size = 0;
+            while (size < max_size && size < cells_.size() &&
+                cells_[(position + size) & mask_].sequence.load(std::memory_order_acquire) == position + size + offset)
+                ++size;
+            return size;
+        }
+
+        std::vector<Cell> cells_;
+        size_t mask_ = 0;
+        alignas(kCacheLineSize) std::atomic<size_t> tail_{0}; // The next position of the producers.
+        alignas(kCacheLineSize) std::atomic<size_t> head_{0}; // The next position of the consumers.
+    };
+}
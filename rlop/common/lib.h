@@ -3,8 +3,12 @@
 #include <numeric>
 #include <math.h>
 #include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <string>
+#include <sstream>
+#include <memory>
+#include <functional>
 #include <fstream>
 #include <filesystem>
 #include <vector>
@@ -13,6 +17,7 @@
 #include <stack>
 #include <array>
 #include <queue> 
+#include <deque>
 #include <tuple>
 #include <unordered_map>
 #include <unordered_set>
@@ -0,0 +1,373 @@
+#pragma once
+#include "typedef.h"
+#include <string_view>
+
+#if defined(__GNUC__) && !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace rlop {
+    // A read-only view of the contents of a file. The file is memory-mapped where mmap is available, so that large
+    // files are paged in as they are read rather than copied, and read into a buffer otherwise.
+    class MappedFile {
+    public:
+        MappedFile() = default;
+
+        // Parameters:
+        //   path: The path of the file.
+        MappedFile(const std::string& path) {
+            Open(path);
+        }
+
+        MappedFile(MappedFile&& other) noexcept {
+            *this = std::move(other);
+        }
+
+        MappedFile& operator=(MappedFile&& other) noexcept {
+            if (this != &other) {
+                Close();
+                std::swap(data_, other.data_);
+                std::swap(size_, other.size_);
+                std::swap(mapped_, other.mapped_);
+                buffer_ = std::move(other.buffer_);
+            }
+            return *this;
+        }
+
+        DISALLOW_COPY_AND_ASSIGN(MappedFile);
+
+        virtual ~MappedFile() {
+            Close();
+        }
+
+        void Open(const std::string& path) {
+            Close();
+#if defined(__GNUC__) && !defined(_WIN32)
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                throw std::runtime_error("MappedFile: cannot open " + path + ".");
+            struct stat st;
+            if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+                void* data = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (data != MAP_FAILED) {
+                    ::madvise(data, st.st_size, MADV_SEQUENTIAL);
+                    data_ = static_cast<const char*>(data);
+                    size_ = st.st_size;
+                    mapped_ = true;
+                }
+            }
+            ::close(fd);
+            if (mapped_)
+                return;
+#endif
+            std::ifstream input(path, std::ios::binary);
+            if (!input)
+                throw std::runtime_error("MappedFile: cannot open " + path + ".");
+            buffer_.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+            data_ = buffer_.data();
+            size_ = buffer_.size();
+        }
+
+        void Close() {
+#if defined(__GNUC__) && !defined(_WIN32)
+            if (mapped_)
+                ::munmap(const_cast<char*>(data_), size_);
+#endif
+            data_ = nullptr;
+            size_ = 0;
+            mapped_ = false;
+            buffer_.clear();
+        }
+
+        std::string_view view() const {
+            return { data_, size_ };
+        }
+
+        const char* data() const {
+            return data_;
+        }
+
+        size_t size() const {
+            return size_;
+        }
+
+        bool mapped() const {
+            return mapped_;
+        }
+
+    protected:
+        const char* data_ = nullptr;
+        size_t size_ = 0;
+        bool mapped_ = false;
+        std::string buffer_;
+    };
+
+    // A read-write view of a file of a fixed size. The file is memory-mapped shared where mmap is available, so that
+    // the writes go to the page cache and reach the file when the kernel writes the dirty pages back or on Flush(),
+    // and the file can exceed the memory, as only the touched pages are resident. Otherwise, the file is read into a
+    // buffer which Flush() writes back.
+    class WritableMappedFile {
+    public:
+        WritableMappedFile() = default;
+
+        // Parameters:
+        //   path: The path of the file, which is created if it does not exist.
+        //   size: The size of the file in bytes, which it is extended to if it is smaller, without writing the new
+        //         bytes, which read as zeros.
+        WritableMappedFile(const std::string& path, size_t size) {
+            Open(path, size);
+        }
+
+        WritableMappedFile(WritableMappedFile&& other) noexcept {
+            *this = std::move(other);
+        }
+
+        WritableMappedFile& operator=(WritableMappedFile&& other) noexcept {
+            if (this != &other) {
+                Close();
+                std::swap(path_, other.path_);
+                std::swap(data_, other.data_);
+                std::swap(size_, other.size_);
+                std::swap(mapped_, other.mapped_);
+                buffer_ = std::move(other.buffer_);
+            }
+            return *this;
+        }
+
+        DISALLOW_COPY_AND_ASSIGN(WritableMappedFile);
+
+        virtual ~WritableMappedFile() {
+            Close();
+        }
+
+        void Open(const std::string& path, size_t size) {
+            Close();
+            path_ = path;
+#if defined(__GNUC__) && !defined(_WIN32)
+            int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+            if (fd < 0)
+                throw std::runtime_error("WritableMappedFile: cannot open " + path + ".");
+            struct stat st;
+            if (::fstat(fd, &st) != 0 || ((size_t)st.st_size < size && ::ftruncate(fd, size) != 0)) {
+                ::close(fd);
+                throw std::runtime_error("WritableMappedFile: cannot resize " + path + ".");
+            }
+            if (size > 0) {
+                void* data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                if (data != MAP_FAILED) {
+                    data_ = static_cast<char*>(data);
+                    size_ = size;
+                    mapped_ = true;
+                }
+            }
+            ::close(fd);
+            if (mapped_ || size == 0)
+                return;
+#endif
+            buffer_.assign(size, 0);
+            {
+                std::ifstream input(path, std::ios::binary);
+                if (input)
+                    input.read(buffer_.data(), size);
+            }
+            data_ = buffer_.data();
+            size_ = size;
+            if (!std::filesystem::exists(path) || std::filesystem::file_size(path) < size)
+                Flush();
+        }
+
+        // Writes the dirty pages of a range of bytes to the file and waits for them.
+        void Flush(size_t offset, size_t size) {
+            if (data_ == nullptr || offset >= size_)
+                return;
+            size = std::min(size, size_ - offset);
+#if defined(__GNUC__) && !defined(_WIN32)
+            if (mapped_) {
+                // msync() takes a range starting on a page.
+                size_t page_size = ::sysconf(_SC_PAGESIZE);
+                size_t begin = offset / page_size * page_size;
+                if (::msync(data_ + begin, offset + size - begin, MS_SYNC) != 0)
+                    throw std::runtime_error("WritableMappedFile: cannot flush " + path_ + ".");
+                return;
+            }
+#endif
+            std::fstream output(path_, std::ios::binary | std::ios::in | std::ios::out);
+            if (!output)
+                output.open(path_, std::ios::binary | std::ios::out);
+            output.seekp(offset);
+            output.write(data_ + offset, size);
+            if (!output)
+                throw std::runtime_error("WritableMappedFile: cannot flush " + path_ + ".");
+        }
+
+        void Flush() {
+            Flush(0, size_);
+        }
+
+        // Tells the kernel that the pages are read in no particular order, such as by sampling, so that it does not
+        // read ahead.
+        void AdviseRandom() {
+#if defined(__GNUC__) && !defined(_WIN32)
+            if (mapped_)
+                ::madvise(data_, size_, MADV_RANDOM);
+#endif
+        }
+
+        // Unmaps the file without flushing it, which the kernel still writes the dirty pages of back.
+        void Close() {
+#if defined(__GNUC__) && !defined(_WIN32)
+            if (mapped_)
+                ::munmap(data_, size_);
+#endif
+            data_ = nullptr;
+            size_ = 0;
+            mapped_ = false;
+            buffer_.clear();
+        }
+
+        const std::string& path() const {
+            return path_;
+        }
+
+        char* data() {
+            return data_;
+        }
+
+        const char* data() const {
+            return data_;
+        }
+
+        size_t size() const {
+            return size_;
+        }
+
+        bool mapped() const {
+            return mapped_;
+        }
+
+    protected:
+        std::string path_;
+        char* data_ = nullptr;
+        size_t size_ = 0;
+        bool mapped_ = false;
+        std::vector<char> buffer_;
+    };
+
+    // A segment of POSIX shared memory of a fixed size, named so that other processes map the same memory, such as
+    // the actors and the learner of a training. The creator makes the segment, which reads as zeros, and removes its
+    // name when it is destroyed or on Unlink(), after which the processes attached to it keep their mapping until they
+    // close it. A name starts with a slash, such as "/rlop_replay".
+    class SharedMemory {
+    public:
+        SharedMemory() = default;
+
+        // Parameters:
+        //   name: The name of the segment.
+        //   size: The size of the segment in bytes.
+        //   create: Whether to create the segment, replacing a segment of the same name, or to attach to an existing
+        //           one, which must be at least as large.
+        SharedMemory(const std::string& name, size_t size, bool create) {
+            Open(name, size, create);
+        }
+
+        SharedMemory(SharedMemory&& other) noexcept {
+            *this = std::move(other);
+        }
+
+        SharedMemory& operator=(SharedMemory&& other) noexcept {
+            if (this != &other) {
+                Close();
+                std::swap(name_, other.name_);
+                std::swap(data_, other.data_);
+                std::swap(size_, other.size_);
+                std::swap(owner_, other.owner_);
+            }
+            return *this;
+        }
+
+        DISALLOW_COPY_AND_ASSIGN(SharedMemory);
+
+        virtual ~SharedMemory() {
+            Close();
+            if (owner_)
+                Unlink();
+        }
+
+        void Open(const std::string& name, size_t size, bool create) {
+            Close();
+            if (owner_)
+                Unlink();
+            name_ = name;
+#if defined(__GNUC__) && !defined(_WIN32)
+            if (create)
+                ::shm_unlink(name.c_str());
+            int fd = ::shm_open(name.c_str(), create ? (O_RDWR | O_CREAT | O_EXCL) : O_RDWR, 0600);
+            if (fd < 0)
+                throw std::runtime_error("SharedMemory: cannot open " + name + ".");
+            struct stat st;
+            bool sized = create ? ::ftruncate(fd, size) == 0 : (::fstat(fd, &st) == 0 && (size_t)st.st_size >= size);
+            void* data = sized ? ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+            ::close(fd);
+            if (data == MAP_FAILED) {
+                if (create)
+                    ::shm_unlink(name.c_str());
+                throw std::runtime_error("SharedMemory: cannot map " + std::to_string(size) + " bytes of " + name + ".");
+            }
+            data_ = static_cast<char*>(data);
+            size_ = size;
+            owner_ = create;
+#else
+            throw std::runtime_error("SharedMemory: POSIX shared memory is not available on this platform.");
+#endif
+        }
+
+        // Unmaps the segment, which keeps its name.
+        void Close() {
+#if defined(__GNUC__) && !defined(_WIN32)
+            if (data_ != nullptr)
+                ::munmap(data_, size_);
+#endif
+            data_ = nullptr;
+            size_ = 0;
+        }
+
+        // Removes the name of the segment, so that no other process can attach to it.
+        void Unlink() {
+#if defined(__GNUC__) && !defined(_WIN32)
+            if (!name_.empty())
+                ::shm_unlink(name_.c_str());
+#endif
+            owner_ = false;
+        }
+
+        const std::string& name() const {
+            return name_;
+        }
+
+        char* data() {
+            return data_;
+        }
+
+        const char* data() const {
+            return data_;
+        }
+
+        size_t size() const {
+            return size_;
+        }
+
+        // Returns whether the segment was created by this object, which removes its name when destroyed.
+        bool owner() const {
+            return owner_;
+        }
+
+    protected:
+        std::string name_;
+        char* data_ = nullptr;
+        size_t size_ = 0;
+        bool owner_ = false;
+    };
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include "typedef.h"
+
+namespace rlop {
+    // A tournament tree over values, which keeps the index of the highest value under updates of single values in
+    // O(log n), instead of the O(n) of a scan such as SelectBest() on every query. Ties go to the lowest index, as
+    // in SelectBest().
+    //
+    // Template Parameters:
+    //   T: The arithmetic type of the values.
+    template<typename T = double>
+    class MaxTree {
+    public:
+        MaxTree(Int size = 0, T value = 0) {
+            Reset(size, value);
+        }
+
+        virtual ~MaxTree() = default;
+
+        void Reset(Int size, T value = 0) {
+            size_ = size;
+            capacity_ = 1;
+            while (capacity_ < size_)
+                capacity_ *= 2;
+            values_.assign(capacity_, std::numeric_limits<T>::lowest());
+            std::fill(values_.begin(), values_.begin() + size_, value);
+            Rebuild();
+        }
+
+        template<typename TIterator>
+        void Assign(const TIterator& begin, const TIterator& end) {
+            Reset(std::distance(begin, end));
+            std::copy(begin, end, values_.begin());
+            Rebuild();
+        }
+
+        void Set(Int i, T value) {
+            values_[i] = value;
+            for (Int node=(i + capacity_) / 2; node>0; node/=2)
+                tree_[node] = Winner(tree_[2 * node], tree_[2 * node + 1]);
+        }
+
+        T Get(Int i) const {
+            return values_[i];
+        }
+
+        // Returns the index of the highest value, or kIntNull if the tree is empty.
+        Int best() const {
+            return size_ > 0 ? tree_[1] : kIntNull;
+        }
+
+        // Returns the highest value, or the lowest value of T if the tree is empty.
+        T max() const {
+            return size_ > 0 ? values_[tree_[1]] : std::numeric_limits<T>::lowest();
+        }
+
+        Int size() const {
+            return size_;
+        }
+
+        const std::vector<T>& values() const {
+            return values_;
+        }
+
+    protected:
+        void Rebuild() {
+            tree_.resize(2 * capacity_);
+            for (Int i=0; i<capacity_; ++i)
+                tree_[capacity_ + i] = i;
+            for (Int node=capacity_-1; node>0; --node)
+                tree_[node] = Winner(tree_[2 * node], tree_[2 * node + 1]);
+        }
+
+        Int Winner(Int left, Int right) const {
+            return values_[left] >= values_[right] ? left : right;
+        }
+
+        Int size_ = 0;
+        Int capacity_ = 1;
+        std::vector<T> values_;
+        std::vector<Int> tree_;
+    };
+}
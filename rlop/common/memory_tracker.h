@@ -0,0 +1,190 @@
+#pragma once
+#include <atomic>
+#include <iomanip>
+#include <mutex>
+#include "typedef.h"
+
+namespace rlop {
+    // Accounts the memory of the components of a process by tag, such as the trees of the searches, the
+    // transposition tables or the replay buffers, so that the owner of the memory is known where the process-wide
+    // GetProcessMemoryUsage() of platform.h only gives the total. The components report their sizes through a
+    // MemoryUsage member when they grow or shrink, so the counters cost one atomic addition per change, and a budget
+    // set on a tag makes the components of that tag apply their shrink policy, such as pruning a tree, instead of
+    // growing.
+    //
+    // The sizes are those of the large buffers of the components, not of every allocation.
+    class MemoryTracker {
+    public:
+        // The counters of a tag. Accounts are never removed, so references to them stay valid.
+        struct Account {
+            std::string tag;
+            std::atomic<int64_t> num_bytes{0};
+            std::atomic<int64_t> peak_num_bytes{0};
+            std::atomic<int64_t> budget{kIntFull};
+
+            void Add(int64_t delta) {
+                int64_t num = num_bytes.fetch_add(delta, std::memory_order_relaxed) + delta;
+                int64_t peak = peak_num_bytes.load(std::memory_order_relaxed);
+                while (num > peak && !peak_num_bytes.compare_exchange_weak(peak, num, std::memory_order_relaxed)) {}
+            }
+
+            // Returns the bytes left under the budget, which is negative once it is exceeded.
+            int64_t Available() const {
+                int64_t limit = budget.load(std::memory_order_relaxed);
+                return limit == kIntFull ? kIntFull : limit - num_bytes.load(std::memory_order_relaxed);
+            }
+        };
+
+        DISALLOW_COPY_AND_ASSIGN(MemoryTracker);
+
+        static MemoryTracker& Get() {
+            static MemoryTracker tracker;
+            return tracker;
+        }
+
+        // Returns the account of a tag, creating it on the first call.
+        Account& GetAccount(const std::string& tag) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto& account : accounts_) {
+                if (account->tag == tag)
+                    return *account;
+            }
+            accounts_.push_back(std::make_unique<Account>());
+            accounts_.back()->tag = tag;
+            return *accounts_.back();
+        }
+
+        // Sets the number of bytes the components of a tag should not exceed, kIntFull for no limit. Components check
+        // the budget when they would grow, so it applies to the following allocations.
+        void SetBudget(const std::string& tag, int64_t budget) {
+            GetAccount(tag).budget.store(budget, std::memory_order_relaxed);
+        }
+
+        int64_t GetBudget(const std::string& tag) {
+            return GetAccount(tag).budget.load(std::memory_order_relaxed);
+        }
+
+        int64_t GetNumBytes(const std::string& tag) {
+            return GetAccount(tag).num_bytes.load(std::memory_order_relaxed);
+        }
+
+        int64_t GetPeakNumBytes(const std::string& tag) {
+            return GetAccount(tag).peak_num_bytes.load(std::memory_order_relaxed);
+        }
+
+        // Returns the bytes accounted over all tags.
+        int64_t TotalNumBytes() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            int64_t total = 0;
+            for (const auto& account : accounts_)
+                total += account->num_bytes.load(std::memory_order_relaxed);
+            return total;
+        }
+
+        // Prints the current and peak sizes and the budget of each tag in MiB.
+        void Report(std::ostream& out = std::cout) const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            out << std::left << std::setw(24) << "tag" << std::right << std::setw(14) << "MiB" << std::setw(14)
+                << "peak_MiB" << std::setw(14) << "budget_MiB" << std::endl;
+            for (const auto& account : accounts_) {
+                int64_t budget = account->budget.load(std::memory_order_relaxed);
+                out << std::left << std::setw(24) << account->tag << std::right << std::fixed << std::setprecision(2)
+                    << std::setw(14) << account->num_bytes.load(std::memory_order_relaxed) / kMiB << std::setw(14)
+                    << account->peak_num_bytes.load(std::memory_order_relaxed) / kMiB << std::setw(14);
+                if (budget == kIntFull)
+                    out << "-";
+                else
+                    out << budget / kMiB;
+                out << std::endl;
+            }
+        }
+
+    protected:
+        static constexpr double kMiB = 1024.0 * 1024.0;
+
+        MemoryTracker() = default;
+
+        mutable std::mutex mutex_;
+        std::vector<std::unique_ptr<Account>> accounts_;
+    };
+
+    // The share of a component in the account of a tag. The component sets its current size with Set(), and the
+    // share is removed from the account when the component is destroyed. A copy accounts for the same size again,
+    // as copying a component copies its buffers.
+    class MemoryUsage {
+    public:
+        explicit MemoryUsage(const std::string& tag) : account_(&MemoryTracker::Get().GetAccount(tag)) {}
+
+        MemoryUsage(const MemoryUsage& other) : account_(other.account_) {
+            Set(other.num_bytes_);
+        }
+
+        MemoryUsage(MemoryUsage&& other) : account_(other.account_), num_bytes_(other.num_bytes_) {
+            other.num_bytes_ = 0;
+        }
+
+        MemoryUsage& operator=(const MemoryUsage& other) {
+            if (this != &other) {
+                Set(0);
+                account_ = other.account_;
+                Set(other.num_bytes_);
+            }
+            return *this;
+        }
+
+        MemoryUsage& operator=(MemoryUsage&& other) {
+            if (this != &other) {
+                Set(0);
+                account_ = other.account_;
+                num_bytes_ = other.num_bytes_;
+                other.num_bytes_ = 0;
+            }
+            return *this;
+        }
+
+        ~MemoryUsage() {
+            Set(0);
+        }
+
+        // Sets the current size of the component.
+        void Set(int64_t num_bytes) {
+            if (num_bytes != num_bytes_) {
+                account_->Add(num_bytes - num_bytes_);
+                num_bytes_ = num_bytes;
+            }
+        }
+
+        // Whether growing by a number of bytes would exceed the budget of the tag.
+        bool OverBudget(int64_t num_extra_bytes = 0) const {
+            return account_->Available() < num_extra_bytes;
+        }
+
+        // Returns the bytes left under the budget of the tag, kIntFull without a budget.
+        int64_t Available() const {
+            return account_->Available();
+        }
+
+        // Returns the largest number of items of a size up to `num_items` which fit under the budget of the tag, next
+        // to the current share of the component, and at least `min_num_items`. Fixed-size components size themselves
+        // with it.
+        size_t Fit(size_t num_items, size_t item_size, size_t min_num_items = 1) const {
+            int64_t available = Available();
+            if (available == kIntFull)
+                return std::max(num_items, min_num_items);
+            int64_t num_fitting = std::max<int64_t>(available + num_bytes_, 0) / std::max<size_t>(item_size, 1);
+            return std::max(std::min<size_t>(num_items, num_fitting), min_num_items);
+        }
+
+        int64_t num_bytes() const {
+            return num_bytes_;
+        }
+
+        const std::string& tag() const {
+            return account_->tag;
+        }
+
+    protected:
+        MemoryTracker::Account* account_;
+        int64_t num_bytes_ = 0;
+    };
+}
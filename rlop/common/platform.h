@@ -42,11 +42,12 @@ namespace rlop {
       std::ifstream file_stream(path);
       if (!file_stream)
          return 0;
-      unsigned size = 0;
-      file_stream >> size;
+      // The fields are the total and the resident sizes in pages.
+      int64_t size = 0, resident = 0;
+      file_stream >> size >> resident;
       if (!file_stream) 
          return 0;
-      return static_cast<int64_t>(size) * 1024;
+      return resident * sysconf(_SC_PAGESIZE);
    }
 
    inline int64_t GetAvailableMemorySize() {
@@ -90,7 +91,7 @@ namespace rlop {
       return memory;
    }
    
-   inline int64_t GetAvailableMemoryBytes() {
+   inline int64_t GetAvailableMemorySize() {
       MEMORYSTATUSEX memInfo;
       memInfo.dwLength = sizeof(MEMORYSTATUSEX);
       GlobalMemoryStatusEx(&memInfo);
@@ -98,5 +99,9 @@ namespace rlop {
       return available_bytes;
    }
 
+   inline int64_t GetAvailableMemoryBytes() {
+      return GetAvailableMemorySize();
+   }
+
 #endif
 }
\ No newline at end of file
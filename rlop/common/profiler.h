@@ -0,0 +1,311 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <mutex>
+#include "typedef.h"
+
+// Scoped profiling zones, which compile to nothing unless RLOP_PROFILE is defined, e.g. by configuring CMake with
+// -DRLOP_PROFILE=ON. A zone times the rest of the enclosing scope:
+//
+//   RLOP_PROFILE_SCOPE("MCTS::Search");
+//
+// The name must be a string literal or otherwise outlive the profiler, since only its pointer is recorded.
+#if defined(RLOP_PROFILE)
+#define RLOP_PROFILE_CONCAT_(a, b) a##b
+#define RLOP_PROFILE_CONCAT(a, b) RLOP_PROFILE_CONCAT_(a, b)
+#define RLOP_PROFILE_SCOPE(name) ::rlop::ProfileZone RLOP_PROFILE_CONCAT(rlop_profile_zone_, __LINE__)(name)
+#else
+#define RLOP_PROFILE_SCOPE(name) ((void)0)
+#endif
+
+namespace rlop {
+    // Collects the zones of all threads. Each thread records into its own buffer, which is registered once under a
+    // lock and then written without synchronization, so that zones on different threads, such as the environments
+    // of a parallel MCTS, do not contend. A buffer keeps both a call tree of the zones, aggregating their calls and
+    // times by their path from the outermost zone, and the list of the zones as events for a trace, up to a maximum
+    // number per thread.
+    //
+    // The reports read the buffers without synchronization too, so they should be written once the profiled threads
+    // are done, as should Reset() be called.
+    class Profiler {
+    public:
+        // A zone of a trace, with times in nanoseconds from the creation of the profiler.
+        struct Event {
+            const char* name;
+            int64_t start;
+            int64_t duration;
+        };
+
+        // A node of a call tree. The root, at index 0, stands for the thread and has no name.
+        struct Node {
+            const char* name = nullptr;
+            std::vector<Int> children;
+            Int num_calls = 0;
+            int64_t total_time = 0;
+        };
+
+        class ThreadBuffer {
+        public:
+            ThreadBuffer(Int thread_i) : thread_i_(thread_i) {
+                Reset();
+            }
+
+            void Reset() {
+                nodes_.assign(1, Node());
+                stack_.assign(1, 0);
+                starts_.clear();
+                events_.clear();
+                num_dropped_events_ = 0;
+            }
+
+            void Enter(const char* name, int64_t now) {
+                Int parent = stack_.back();
+                Int node = kIntNull;
+                for (Int child : nodes_[parent].children) {
+                    if (nodes_[child].name == name || std::strcmp(nodes_[child].name, name) == 0) {
+                        node = child;
+                        break;
+                    }
+                }
+                if (node == kIntNull) {
+                    node = nodes_.size();
+                    nodes_.emplace_back();
+                    nodes_.back().name = name;
+                    nodes_[parent].children.push_back(node);
+                }
+                stack_.push_back(node);
+                starts_.push_back(now);
+            }
+
+            void Exit(int64_t now, Int max_num_events) {
+                Node& node = nodes_[stack_.back()];
+                int64_t start = starts_.back();
+                stack_.pop_back();
+                starts_.pop_back();
+                ++node.num_calls;
+                node.total_time += now - start;
+                if (static_cast<Int>(events_.size()) < max_num_events)
+                    events_.push_back({ node.name, start, now - start });
+                else
+                    ++num_dropped_events_;
+            }
+
+            Int thread_i() const {
+                return thread_i_;
+            }
+
+            const std::vector<Node>& nodes() const {
+                return nodes_;
+            }
+
+            const std::vector<Event>& events() const {
+                return events_;
+            }
+
+            Int num_dropped_events() const {
+                return num_dropped_events_;
+            }
+
+        protected:
+            Int thread_i_;
+            std::vector<Node> nodes_;
+            std::vector<Int> stack_;
+            std::vector<int64_t> starts_;
+            std::vector<Event> events_;
+            Int num_dropped_events_ = 0;
+        };
+
+        DISALLOW_COPY_AND_ASSIGN(Profiler);
+
+        static Profiler& Get() {
+            static Profiler profiler;
+            return profiler;
+        }
+
+        // Returns the buffer of the calling thread, registering it on the first call of the thread.
+        ThreadBuffer& GetThreadBuffer() {
+            thread_local ThreadBuffer* buffer = nullptr;
+            if (buffer == nullptr) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                buffers_.push_back(std::make_unique<ThreadBuffer>(buffers_.size()));
+                buffer = buffers_.back().get();
+            }
+            return *buffer;
+        }
+
+        // Returns the nanoseconds since the creation of the profiler.
+        int64_t Now() const {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch_).count();
+        }
+
+        // Clears the records of all the threads, keeping their buffers registered.
+        void Reset() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto& buffer : buffers_)
+                buffer->Reset();
+        }
+
+        // Merges the call trees of all the threads by the paths of their zones.
+        std::vector<Node> GetCallTree() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::vector<Node> tree(1);
+            for (const auto& buffer : buffers_)
+                MergeNode(buffer->nodes(), 0, tree, 0);
+            return tree;
+        }
+
+        // Prints the merged call tree, one zone per line, indented by depth, with the number of calls, the total
+        // time, the time outside the child zones and the share of the total time of the parent zone.
+        void Report(std::ostream& out = std::cout) const {
+            auto tree = GetCallTree();
+            out << std::left << std::setw(48) << "zone" << std::right << std::setw(12) << "calls" << std::setw(14)
+                << "total_ms" << std::setw(14) << "self_ms" << std::setw(10) << "parent%" << std::endl;
+            for (Int child : tree[0].children)
+                ReportNode(out, tree, child, 0, 0);
+        }
+
+        // Writes the zones of all the threads as complete events of the Chrome trace format, which chrome://tracing
+        // and the Perfetto UI open.
+        //
+        // Parameters:
+        //   path: The path of the JSON file.
+        void WriteChromeTrace(const std::string& path) const {
+            std::ofstream out(path);
+            if (!out)
+                throw std::runtime_error("Profiler: cannot open " + path + ".");
+            WriteChromeTrace(out);
+        }
+
+        void WriteChromeTrace(std::ostream& out) const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+            bool first = true;
+            for (const auto& buffer : buffers_) {
+                out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << buffer->thread_i()
+                    << ",\"args\":{\"name\":\"thread " << buffer->thread_i() << "\"}}";
+                first = false;
+                for (const Event& event : buffer->events()) {
+                    out << ",\n{\"name\":\"";
+                    WriteEscaped(out, event.name);
+                    out << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer->thread_i() << ",\"ts\":" << event.start / 1000
+                        << "." << std::setw(3) << std::setfill('0') << event.start % 1000 << ",\"dur\":" << event.duration / 1000
+                        << "." << std::setw(3) << event.duration % 1000 << std::setfill(' ') << "}";
+                }
+            }
+            out << "\n]}" << std::endl;
+        }
+
+        // The number of zones not recorded as events because a buffer was full. The call trees count them all.
+        Int num_dropped_events() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            Int num_dropped_events = 0;
+            for (const auto& buffer : buffers_)
+                num_dropped_events += buffer->num_dropped_events();
+            return num_dropped_events;
+        }
+
+        bool enabled() const {
+            return enabled_.load(std::memory_order_relaxed);
+        }
+
+        // Turns the recording of new zones on or off at run time. Zones are recorded by default.
+        void set_enabled(bool enabled) {
+            enabled_.store(enabled, std::memory_order_relaxed);
+        }
+
+        Int max_num_events() const {
+            return max_num_events_;
+        }
+
+        // Sets the maximum number of events of each thread, which bounds the memory of long runs.
+        void set_max_num_events(Int max_num_events) {
+            max_num_events_ = max_num_events;
+        }
+
+    protected:
+        Profiler() : epoch_(std::chrono::steady_clock::now()) {}
+
+        static void MergeNode(const std::vector<Node>& nodes, Int node_i, std::vector<Node>& tree, Int tree_i) {
+            tree[tree_i].num_calls += nodes[node_i].num_calls;
+            tree[tree_i].total_time += nodes[node_i].total_time;
+            for (Int child : nodes[node_i].children) {
+                Int match = kIntNull;
+                for (Int tree_child : tree[tree_i].children) {
+                    if (std::strcmp(tree[tree_child].name, nodes[child].name) == 0) {
+                        match = tree_child;
+                        break;
+                    }
+                }
+                if (match == kIntNull) {
+                    match = tree.size();
+                    tree.emplace_back();
+                    tree.back().name = nodes[child].name;
+                    tree[tree_i].children.push_back(match);
+                }
+                MergeNode(nodes, child, tree, match);
+            }
+        }
+
+        static void ReportNode(std::ostream& out, const std::vector<Node>& tree, Int node_i, Int depth, int64_t parent_time) {
+            const Node& node = tree[node_i];
+            int64_t self_time = node.total_time;
+            for (Int child : node.children)
+                self_time -= tree[child].total_time;
+            out << std::left << std::setw(48) << std::string(2 * depth, ' ') + node.name << std::right << std::setw(12)
+                << node.num_calls << std::fixed << std::setprecision(3) << std::setw(14) << node.total_time / 1e6
+                << std::setw(14) << self_time / 1e6 << std::setprecision(1) << std::setw(10);
+            if (parent_time > 0)
+                out << 100.0 * node.total_time / parent_time;
+            else
+                out << "";
+            out << std::endl;
+            for (Int child : node.children)
+                ReportNode(out, tree, child, depth + 1, node.total_time);
+        }
+
+        static void WriteEscaped(std::ostream& out, const char* text) {
+            for (const char* c=text; *c; ++c) {
+                if (*c == '"' || *c == '\\')
+                    out << '\\' << *c;
+                else if (static_cast<unsigned char>(*c) < 0x20)
+                    out << ' ';
+                else
+                    out << *c;
+            }
+        }
+
+        std::chrono::steady_clock::time_point epoch_;
+        std::atomic<bool> enabled_ = true;
+        Int max_num_events_ = 1 << 20;
+        mutable std::mutex mutex_;
+        std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+    };
+
+    // Records a zone from its construction to its destruction into the buffer of the calling thread, unless the
+    // profiler is disabled at its construction. Use it through RLOP_PROFILE_SCOPE, which removes it when RLOP_PROFILE
+    // is not defined.
+    class ProfileZone {
+    public:
+        explicit ProfileZone(const char* name) {
+            Profiler& profiler = Profiler::Get();
+            if (!profiler.enabled())
+                return;
+            buffer_ = &profiler.GetThreadBuffer();
+            buffer_->Enter(name, profiler.Now());
+        }
+
+        DISALLOW_COPY_AND_ASSIGN(ProfileZone);
+
+        ~ProfileZone() {
+            if (buffer_ != nullptr) {
+                Profiler& profiler = Profiler::Get();
+                buffer_->Exit(profiler.Now(), profiler.max_num_events());
+            }
+        }
+
+    protected:
+        Profiler::ThreadBuffer* buffer_ = nullptr;
+    };
+}
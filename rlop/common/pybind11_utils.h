@@ -93,7 +93,8 @@ namespace rlop::pybind11_utils {
         }
     }
 
-    // Converts a numpy array to a libtorch tensor, preserving the data type and shape.
+    // Converts a numpy array to a libtorch tensor, preserving the data type and shape. The tensor owns a copy of
+    // the data.
     //
     // Parameters:
     //   array: A py::array object representing the numpy array to be converted.
@@ -111,7 +112,35 @@ namespace rlop::pybind11_utils {
         return torch::from_blob(info.ptr, shape, stride, options).clone();
     }
 
+    // Converts a numpy array to a libtorch tensor sharing its data, without a copy, which keeps the array alive
+    // until the tensor is freed. Writing to either writes to both. The array is copied only if its strides are
+    // negative, such as of a reversed array, or not multiples of its item size, which a tensor cannot view.
+    //
+    // Parameters:
+    //   array: A py::array object representing the numpy array to be converted.
+    //
+    // Returns:
+    //   torch::Tensor: A libtorch tensor on the CPU viewing the data of the numpy array.
+    inline torch::Tensor ArrayToTensorView(const py::array& array) {
+        py::buffer_info info = array.request();
+        std::vector<int64_t> shape(info.shape.begin(), info.shape.end());
+        std::vector<int64_t> stride(info.strides.begin(), info.strides.end());
+        for (auto& s : stride) {
+            if (s < 0 || s % info.itemsize != 0)
+                return ArrayToTensor(py::array::ensure(array, py::array::c_style | py::array::forcecast));
+            s /= info.itemsize;
+        }
+        torch::TensorOptions options = torch::TensorOptions().dtype(ArrayDtypeToTensorDtype(array.dtype()));
+        // The reference to the array is released with the GIL, since the tensor may be freed by any thread.
+        auto* owner = new py::object(array);
+        return torch::from_blob(info.ptr, shape, stride, [owner](void*) {
+            py::gil_scoped_acquire gil;
+            delete owner;
+        }, options);
+    }
+
     // Converts a libtorch tensor to a numpy array, ensuring memory continuity and correct data type representation.
+    // The array owns a copy of the data.
     //
     // Parameters:
     //   tensor: A torch::Tensor object to be converted to a numpy array.
@@ -119,7 +148,8 @@ namespace rlop::pybind11_utils {
     // Returns:
     //   py::array: A numpy array with the same data, data type, and shape as the PyTorch tensor.
     inline py::array TensorToArray(const torch::Tensor& tensor) {
-        torch::Tensor tmp = tensor.clone().contiguous().cpu();
+        // The array copies the data, from which a contiguous tensor on the CPU is made only if needed.
+        torch::Tensor tmp = tensor.cpu().contiguous();
         pybind11::dtype dtype = TensorDtypeToArrayDtype(tmp.scalar_type());
         std::vector<ssize_t> shape = tmp.sizes().vec();
         std::vector<ssize_t> strides = tmp.strides().vec();
@@ -128,4 +158,58 @@ namespace rlop::pybind11_utils {
         }
         return pybind11::array(dtype, shape, strides, tmp.data_ptr());
     }
+
+    // Converts a libtorch tensor to a numpy array sharing its data, without a copy, which keeps the tensor alive
+    // until the array is freed. A tensor off the CPU, or with negative strides, is copied to a contiguous tensor on
+    // the CPU first.
+    //
+    // Parameters:
+    //   tensor: A torch::Tensor object to be converted to a numpy array.
+    //
+    // Returns:
+    //   py::array: A numpy array viewing the data of the tensor.
+    inline py::array TensorToArrayView(const torch::Tensor& tensor) {
+        torch::Tensor tmp = tensor.cpu();
+        for (Int stride : tmp.strides()) {
+            if (stride < 0) {
+                tmp = tmp.contiguous();
+                break;
+            }
+        }
+        pybind11::dtype dtype = TensorDtypeToArrayDtype(tmp.scalar_type());
+        std::vector<ssize_t> shape = tmp.sizes().vec();
+        std::vector<ssize_t> strides = tmp.strides().vec();
+        for (auto& stride : strides) {
+            stride *= tmp.element_size();
+        }
+        void* data = tmp.data_ptr();
+        py::capsule owner(new torch::Tensor(std::move(tmp)), [](void* tensor) {
+            delete static_cast<torch::Tensor*>(tensor);
+        });
+        return pybind11::array(dtype, shape, strides, data, owner);
+    }
+
+    // Copies the arrays of a sequence into the rows of a tensor, skipping the elements which are None, such as the
+    // final observations in the infos of a vector environment of Gymnasium, in one pass without allocating a
+    // tensor per array. The rows of the None elements are left as they are.
+    //
+    // Parameters:
+    //   arrays: A sequence of numpy arrays or None, with at most as many elements as the rows of the tensor.
+    //   tensor: The tensor to copy the arrays into.
+    //
+    // Returns:
+    //   torch::Tensor: A boolean tensor of whether each row was copied.
+    inline torch::Tensor CopyArraysToTensor(const py::handle& arrays, const torch::Tensor& tensor) {
+        torch::Tensor copied = torch::zeros({ tensor.size(0) }, torch::kBool);
+        bool* copied_data = copied.data_ptr<bool>();
+        Int i = 0;
+        for (const auto& array : arrays) {
+            if (!array.is_none()) {
+                tensor[i].copy_(ArrayToTensorView(py::cast<py::array>(array)));
+                copied_data[i] = true;
+            }
+            ++i;
+        }
+        return copied;
+    }
 }
\ No newline at end of file
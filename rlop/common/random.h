@@ -2,53 +2,254 @@
 #include <random>
 #include "typedef.h"
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 namespace rlop {
-    // A utility class for generating random numbers. It wraps around the standard <random>
-    // library functionalities to provide easy-to-use methods for generating numbers from
-    // various distributions (uniform, normal, poisson, etc.) and for shuffling collections.
-    class Random {
+    // The xoshiro256++ generator of Blackman and Vigna, which is several times faster than std::mt19937_64 and has
+    // a 256-bit state. It meets the requirements of a uniform random bit generator, so it works with the standard
+    // distributions and algorithms. Jump() advances the state by 2^128 draws, so that streams jumped from one seed
+    // do not overlap and can be handed to different threads.
+    class Xoshiro256PlusPlus {
+    public:
+        using result_type = uint64_t;
+
+        Xoshiro256PlusPlus(uint64_t seed = kDefaultSeed) {
+            SeedState(seed);
+        }
+
+        // Seeds the state with the SplitMix64 sequence of a seed, which spreads close seeds to distant states.
+        void seed(uint64_t seed = kDefaultSeed) {
+            SeedState(seed);
+        }
+
+        result_type operator()() {
+            uint64_t result = Rotl(s_[0] + s_[3], 23) + s_[0];
+            uint64_t t = s_[1] << 17;
+            s_[2] ^= s_[0];
+            s_[3] ^= s_[1];
+            s_[1] ^= s_[2];
+            s_[0] ^= s_[3];
+            s_[2] ^= t;
+            s_[3] = Rotl(s_[3], 45);
+            return result;
+        }
+
+        void discard(uint64_t n) {
+            for (uint64_t i=0; i<n; ++i)
+                (*this)();
+        }
+
+        // Advances the state by 2^128 draws.
+        void Jump() {
+            static constexpr uint64_t kJump[] = { 0x180ec6d33cfd0aba, 0xd5a61266f0c9392c, 0xa9582618e03fc9aa, 0x39abdc4529b1661c };
+            Jump(kJump);
+        }
+
+        // Advances the state by 2^192 draws, which gives 2^64 starting points of streams that can each be jumped
+        // 2^64 times.
+        void LongJump() {
+            static constexpr uint64_t kLongJump[] = { 0x76e15d3efefdcbbf, 0xc5004e441c522fb3, 0x77710069854ee241, 0x39109bb02acbe635 };
+            Jump(kLongJump);
+        }
+
+        static constexpr result_type min() {
+            return 0;
+        }
+
+        static constexpr result_type max() {
+            return std::numeric_limits<result_type>::max();
+        }
+
+        bool operator==(const Xoshiro256PlusPlus& other) const {
+            return std::equal(std::begin(s_), std::end(s_), std::begin(other.s_));
+        }
+
+        bool operator!=(const Xoshiro256PlusPlus& other) const {
+            return !(*this == other);
+        }
+
+    protected:
+        static constexpr uint64_t kDefaultSeed = 5489;
+
+        static uint64_t Rotl(uint64_t x, int k) {
+            return (x << k) | (x >> (64 - k));
+        }
+
+        void SeedState(uint64_t seed) {
+            for (auto& s : s_) {
+                uint64_t z = (seed += 0x9e3779b97f4a7c15);
+                z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+                z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+                s = z ^ (z >> 31);
+            }
+        }
+
+        void Jump(const uint64_t (&jump)[4]) {
+            uint64_t s[4] = { 0, 0, 0, 0 };
+            for (uint64_t word : jump) {
+                for (int b=0; b<64; ++b) {
+                    if (word & (uint64_t(1) << b)) {
+                        for (int i=0; i<4; ++i)
+                            s[i] ^= s_[i];
+                    }
+                    (*this)();
+                }
+            }
+            std::copy(std::begin(s), std::end(s), std::begin(s_));
+        }
+
+        uint64_t s_[4];
+    };
+
+    // A utility class for generating random numbers from various distributions (uniform, normal, poisson, etc.)
+    // and for shuffling collections. The distributions keep no state outside the instance, so that instances used
+    // by different threads, such as parallel replicas of a search or the environments of a parallel MCTS, do not
+    // share anything. Threads should each use their own instance, seeded differently or jumped from one seed with
+    // Jump().
+    //
+    // Template Parameters:
+    //   TGenerator: The uniform random bit generator producing 64-bit values.
+    template<typename TGenerator>
+    class BasicRandom {
     public:
-        Random() : gen_() {}
+        static_assert(std::is_same_v<typename TGenerator::result_type, uint64_t> && TGenerator::min() == 0 &&
+            TGenerator::max() == std::numeric_limits<uint64_t>::max(), "BasicRandom: requires a 64-bit generator.");
 
-        Random(uint64_t seed) : gen_(seed) {}
+        BasicRandom() : gen_() {}
+
+        BasicRandom(uint64_t seed) : gen_(seed) {}
 
         void Seed(uint64_t seed) {
             gen_.seed(seed);
+            has_spare_normal_ = false;
+        }
+
+        // Advances the generator to the next of its non-overlapping streams, which requires a generator with
+        // Jump(), such as Xoshiro256PlusPlus.
+        //
+        // Parameters:
+        //   n: The number of streams to skip.
+        void Jump(Int n = 1) {
+            for (Int i=0; i<n; ++i)
+                gen_.Jump();
+            has_spare_normal_ = false;
         }
-        
+
+        // Returns a uniform draw in [min_value, max_value] for integral types, by the multiply-and-shift method of
+        // Lemire, which rejects rarely and needs no division in most draws, and in [min_value, max_value) for
+        // floating-point types.
         template <typename T>
         T Uniform(T min_value, T max_value) {
             static_assert(std::is_arithmetic_v<T>, "Random: uniform requires an arithmetic type.");
             if constexpr (std::is_integral_v<T>) {
-                static std::uniform_int_distribution<T> dist;
-                return dist(gen_, typename std::uniform_int_distribution<T>::param_type(min_value, max_value));
+                uint64_t range = static_cast<uint64_t>(max_value) - static_cast<uint64_t>(min_value) + 1;
+                if (range == 0)
+                    return static_cast<T>(gen_());
+                uint64_t high;
+                uint64_t low = MulWide(gen_(), range, high);
+                if (low < range) {
+                    uint64_t threshold = (0 - range) % range;
+                    while (low < threshold)
+                        low = MulWide(gen_(), range, high);
+                }
+                return static_cast<T>(static_cast<uint64_t>(min_value) + high);
             } else {
-                static std::uniform_real_distribution<T> dist;
-                return dist(gen_, typename std::uniform_real_distribution<T>::param_type(min_value, max_value));
+                return min_value + static_cast<T>(Uniform01()) * (max_value - min_value);
             }
         }
 
+        // Returns a normal draw by the polar method of Marsaglia, which makes the draws in pairs and keeps the second
+        // one for the next call.
         template <typename T>
         T Normal(T mean, T std) {
-            static_assert(std::is_arithmetic_v<T>, "Random: normal requires an arithmetic type.");
-            static std::normal_distribution<T> dist;
-            return dist(gen_, typename std::normal_distribution<T>::param_type(mean, std));
+            static_assert(std::is_floating_point_v<T>, "Random: normal requires a floating-point type.");
+            double z;
+            if (has_spare_normal_) {
+                z = spare_normal_;
+                has_spare_normal_ = false;
+            } else {
+                double u, v;
+                z = StandardNormalPair(u, v);
+                spare_normal_ = v;
+                has_spare_normal_ = true;
+            }
+            return mean + std * static_cast<T>(z);
         }
 
         template <typename T>
-        T Poisson(T mean) const {
-            static_assert(std::is_arithmetic_v<T>, "Random: poisson requires an arithmetic type.");
-            static std::poisson_distribution<T> dist;
-            return dist(gen_, typename std::poisson_distribution<T>::param_type(mean));
+        T Poisson(double mean) {
+            static_assert(std::is_integral_v<T>, "Random: poisson requires an integral type.");
+            std::poisson_distribution<T> dist(mean);
+            return dist(gen_);
         }
 
+        // Returns an index drawn in proportion to non-negative weights, by a scan of the weights, which allocates
+        // nothing, unlike building a std::discrete_distribution. The draw is uniform if the weights sum to zero. For
+        // many draws from the same weights, an AliasSampler draws in O(1).
+        //
+        // Template Parameters:
+        //   T: The integral type of the index.
+        //   TIterator: Iterator type pointing to the collection of weights.
         template <typename T, typename TIterator>
         T Discrete(const TIterator& begin, const TIterator& end) {
             static_assert(std::is_integral_v<T>, "Random: discrete requires an integral type");
-            static_assert(std::is_same_v<TIterator, typename std::vector<typename TIterator::value_type>::iterator> || 
-                std::is_same_v<TIterator, typename std::vector<typename TIterator::value_type>::const_iterator>, "Random: discrete requires a vector iterator type.");
-            static std::discrete_distribution<T> dist;
-            return dist(gen_, typename std::discrete_distribution<T>::param_type(begin, end));
+            Int size = std::distance(begin, end);
+            if (size <= 0)
+                return 0;
+            double total = 0;
+            for (auto it=begin; it!=end; ++it)
+                total += *it;
+            if (!(total > 0))
+                return static_cast<T>(Uniform(Int(0), size - 1));
+            double target = Uniform01() * total;
+            Int last = 0;
+            Int i = 0;
+            for (auto it=begin; it!=end; ++it, ++i) {
+                if (*it > 0) {
+                    target -= *it;
+                    if (target < 0)
+                        return static_cast<T>(i);
+                    last = i;
+                }
+            }
+            return static_cast<T>(last);
+        }
+
+        // Fills a range with uniform draws in [0, 1), made from the 53 high bits of the generator, which is cheaper
+        // than as many calls of Uniform(0.0, 1.0).
+        //
+        // Template Parameters:
+        //   TIterator: Iterator type pointing to a collection of floating-point values.
+        template<typename TIterator>
+        void FillUniform(const TIterator& begin, const TIterator& end) {
+            for (auto it=begin; it!=end; ++it)
+                *it = (gen_() >> 11) * 0x1.0p-53;
+        }
+
+        // Fills a range with uniform draws in [min_value, max_value], as Uniform() does.
+        template<typename TIterator, typename T>
+        void FillUniform(const TIterator& begin, const TIterator& end, T min_value, T max_value) {
+            for (auto it=begin; it!=end; ++it)
+                *it = Uniform(min_value, max_value);
+        }
+
+        // Fills a range with normal draws, by the polar method of Marsaglia with both draws of each pair used.
+        //
+        // Template Parameters:
+        //   TIterator: Iterator type pointing to a collection of floating-point values.
+        template<typename TIterator>
+        void FillNormal(const TIterator& begin, const TIterator& end, double mean = 0, double std = 1) {
+            for (auto it=begin; it!=end; ) {
+                double u, v;
+                StandardNormalPair(u, v);
+                *it = mean + std * u;
+                if (++it == end)
+                    break;
+                *it = mean + std * v;
+                ++it;
+            }
         }
 
         // Partially shuffles a collection up to 'n' elements.
@@ -69,14 +270,59 @@ namespace rlop {
                 std::iter_swap(begin + i, begin + selected);
             }
         }
-        
+
         template<typename TIterator>
         void Shuffle(const TIterator& begin, const TIterator& end) {
             static_assert(std::is_same_v<TIterator, typename std::vector<typename TIterator::value_type>::iterator>, "Random: shuffle requires a vector iterator type.");
-            std::shuffle(begin, end, gen_);   
+            Int size = static_cast<Int>(std::distance(begin, end));
+            PartialShuffle(begin, end, size - 1);
+        }
+
+        TGenerator& generator() {
+            return gen_;
         }
 
     protected:
-        std::mt19937_64 gen_;
+        double Uniform01() {
+            return (gen_() >> 11) * 0x1.0p-53;
+        }
+
+        // Returns the high and low words of the 128-bit product of two 64-bit values.
+        static uint64_t MulWide(uint64_t x, uint64_t y, uint64_t& high) {
+#if defined(__SIZEOF_INT128__)
+            __uint128_t product = static_cast<__uint128_t>(x) * y;
+            high = static_cast<uint64_t>(product >> 64);
+            return static_cast<uint64_t>(product);
+#elif defined(_MSC_VER) && defined(_M_X64)
+            return _umul128(x, y, &high);
+#else
+            uint64_t x_low = x & 0xffffffff, x_high = x >> 32, y_low = y & 0xffffffff, y_high = y >> 32;
+            uint64_t low_low = x_low * y_low, high_low = x_high * y_low, low_high = x_low * y_high;
+            uint64_t middle = (low_low >> 32) + (high_low & 0xffffffff) + low_high;
+            high = x_high * y_high + (high_low >> 32) + (middle >> 32);
+            return (middle << 32) | (low_low & 0xffffffff);
+#endif
+        }
+
+        // Draws a pair of independent standard normal values and returns the first.
+        double StandardNormalPair(double& u, double& v) {
+            double s;
+            do {
+                u = 2.0 * Uniform01() - 1.0;
+                v = 2.0 * Uniform01() - 1.0;
+                s = u * u + v * v;
+            } while (s >= 1.0 || s == 0.0);
+            double factor = std::sqrt(-2.0 * std::log(s) / s);
+            u *= factor;
+            v *= factor;
+            return u;
+        }
+
+        TGenerator gen_;
+        bool has_spare_normal_ = false;
+        double spare_normal_ = 0;
     };
-}
\ No newline at end of file
+
+    using Random = BasicRandom<Xoshiro256PlusPlus>;
+    using MTRandom = BasicRandom<std::mt19937_64>;
+}
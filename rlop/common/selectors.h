@@ -1,9 +1,212 @@
 #pragma once
+#include <cstring>
 #include "random.h"
 #include "utils.h"
 
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 namespace rlop {
-    // Selects the index of the highest scoring element from a range of scores.
+    // The vector kernels of the selectors for contiguous arrays of float and double scores, on the widest of AVX-512
+    // and AVX2 the compiler targets, e.g. with -march=native or the RLOP_NATIVE_ARCH option of CMake. Each kernel
+    // has a scalar fallback, which the selectors take for other iterators and types and when neither instruction set
+    // is enabled, so the results do not depend on the target. The kernels load the scores unaligned and finish the
+    // ranges with scalar loops.
+    //
+    // A lane holding a NaN never wins, as in the scalar comparisons, since the maximum instructions return their
+    // second operand, the running maximum, when the first one is a NaN.
+    template<typename T>
+    struct SimdSelectOps {
+        static constexpr bool kEnabled = false;
+    };
+
+    inline uint32_t CountTrailingZeros(uint32_t bits) {
+#if defined(_MSC_VER)
+        unsigned long i;
+        _BitScanForward(&i, bits);
+        return i;
+#else
+        return __builtin_ctz(bits);
+#endif
+    }
+
+#if defined(__AVX512F__)
+    template<>
+    struct SimdSelectOps<float> {
+        using Vec = __m512;
+        static constexpr bool kEnabled = true;
+        static constexpr Int kWidth = 16;
+
+        static Vec Load(const float* p) { return _mm512_loadu_ps(p); }
+        static Vec Set1(float x) { return _mm512_set1_ps(x); }
+        static Vec Max(Vec a, Vec b) { return _mm512_max_ps(a, b); }
+        static float ReduceMax(Vec a) { return _mm512_reduce_max_ps(a); }
+        static uint32_t Equal(Vec a, Vec b) { return _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ); }
+        static uint32_t Greater(Vec a, Vec b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+        static uint32_t MaskBits(const bool* mask) {
+            return _mm512_test_epi32_mask(_mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(mask))),
+                _mm512_set1_epi32(0xff));
+        }
+        static Vec Select(uint32_t bits, Vec a, Vec b) { return _mm512_mask_blend_ps(static_cast<__mmask16>(bits), b, a); }
+    };
+
+    template<>
+    struct SimdSelectOps<double> {
+        using Vec = __m512d;
+        static constexpr bool kEnabled = true;
+        static constexpr Int kWidth = 8;
+
+        static Vec Load(const double* p) { return _mm512_loadu_pd(p); }
+        static Vec Set1(double x) { return _mm512_set1_pd(x); }
+        static Vec Max(Vec a, Vec b) { return _mm512_max_pd(a, b); }
+        static double ReduceMax(Vec a) { return _mm512_reduce_max_pd(a); }
+        static uint32_t Equal(Vec a, Vec b) { return _mm512_cmp_pd_mask(a, b, _CMP_EQ_OQ); }
+        static uint32_t Greater(Vec a, Vec b) { return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ); }
+        static uint32_t MaskBits(const bool* mask) {
+            return _mm512_test_epi64_mask(_mm512_cvtepu8_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(mask))),
+                _mm512_set1_epi64(0xff));
+        }
+        static Vec Select(uint32_t bits, Vec a, Vec b) { return _mm512_mask_blend_pd(static_cast<__mmask8>(bits), b, a); }
+    };
+#elif defined(__AVX2__)
+    template<>
+    struct SimdSelectOps<float> {
+        using Vec = __m256;
+        static constexpr bool kEnabled = true;
+        static constexpr Int kWidth = 8;
+
+        static Vec Load(const float* p) { return _mm256_loadu_ps(p); }
+        static Vec Set1(float x) { return _mm256_set1_ps(x); }
+        static Vec Max(Vec a, Vec b) { return _mm256_max_ps(a, b); }
+        static float ReduceMax(Vec a) {
+            __m128 m = _mm_max_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+            m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+            m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+            return _mm_cvtss_f32(m);
+        }
+        static uint32_t Equal(Vec a, Vec b) { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_EQ_OQ)); }
+        static uint32_t Greater(Vec a, Vec b) { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GT_OQ)); }
+        static uint32_t MaskBits(const bool* mask) {
+            __m256i m = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(mask)));
+            return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(m, _mm256_setzero_si256())));
+        }
+        static Vec Select(uint32_t bits, Vec a, Vec b) {
+            const __m256i lanes = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+            __m256i m = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(bits), lanes), lanes);
+            return _mm256_blendv_ps(b, a, _mm256_castsi256_ps(m));
+        }
+    };
+
+    template<>
+    struct SimdSelectOps<double> {
+        using Vec = __m256d;
+        static constexpr bool kEnabled = true;
+        static constexpr Int kWidth = 4;
+
+        static Vec Load(const double* p) { return _mm256_loadu_pd(p); }
+        static Vec Set1(double x) { return _mm256_set1_pd(x); }
+        static Vec Max(Vec a, Vec b) { return _mm256_max_pd(a, b); }
+        static double ReduceMax(Vec a) {
+            __m128d m = _mm_max_pd(_mm256_castpd256_pd128(a), _mm256_extractf128_pd(a, 1));
+            m = _mm_max_sd(m, _mm_unpackhi_pd(m, m));
+            return _mm_cvtsd_f64(m);
+        }
+        static uint32_t Equal(Vec a, Vec b) { return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_EQ_OQ)); }
+        static uint32_t Greater(Vec a, Vec b) { return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_GT_OQ)); }
+        static uint32_t MaskBits(const bool* mask) {
+            int32_t word;
+            std::memcpy(&word, mask, sizeof(word));
+            __m256i m = _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(word));
+            return _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(m, _mm256_setzero_si256())));
+        }
+        static Vec Select(uint32_t bits, Vec a, Vec b) {
+            const __m256i lanes = _mm256_setr_epi64x(1, 2, 4, 8);
+            __m256i m = _mm256_cmpeq_epi64(_mm256_and_si256(_mm256_set1_epi64x(bits), lanes), lanes);
+            return _mm256_blendv_pd(b, a, _mm256_castsi256_pd(m));
+        }
+    };
+#endif
+
+    // Whether the selectors run the vector kernels on a range of iterators, which must point to a contiguous array
+    // of a type with kernels: a pointer or an iterator of a std::vector.
+    template<typename TIterator>
+    constexpr bool IsSimdSelectable() {
+        using T = typename std::iterator_traits<TIterator>::value_type;
+        return SimdSelectOps<T>::kEnabled && (std::is_pointer_v<TIterator> ||
+            std::is_same_v<TIterator, typename std::vector<T>::iterator> ||
+            std::is_same_v<TIterator, typename std::vector<T>::const_iterator>);
+    }
+
+    // Returns the first index of the highest score above std::numeric_limits<T>::lowest(), with (masked) the legal
+    // scores only, or kIntNull if there is none. The maximum is found first, keeping several vectors in flight, and
+    // then its first index. Ranges shorter than kMinSimdSelectSize are scanned once by a scalar loop, which is
+    // faster than the two passes there.
+    constexpr Int kMinSimdSelectSize = 32;
+
+    template<typename T, bool masked>
+    Int SimdSelectBest(const T* scores, const bool* mask, Int size) {
+        using Ops = SimdSelectOps<T>;
+        using Vec = typename Ops::Vec;
+        constexpr T kLowest = std::numeric_limits<T>::lowest();
+        constexpr Int kWidth = Ops::kWidth;
+        if (size < kMinSimdSelectSize) {
+            Int best = kIntNull;
+            T best_score = kLowest;
+            for (Int i=0; i<size; ++i) {
+                if ((!masked || mask[i]) && scores[i] > best_score) {
+                    best = i;
+                    best_score = scores[i];
+                }
+            }
+            return best;
+        }
+        const Vec lowest = Ops::Set1(kLowest);
+        Vec max0 = lowest, max1 = lowest;
+        Int i = 0;
+        for (; i+2*kWidth<=size; i+=2*kWidth) {
+            Vec a = Ops::Load(scores + i), b = Ops::Load(scores + i + kWidth);
+            if constexpr (masked) {
+                a = Ops::Select(Ops::MaskBits(mask + i), a, lowest);
+                b = Ops::Select(Ops::MaskBits(mask + i + kWidth), b, lowest);
+            }
+            max0 = Ops::Max(a, max0);
+            max1 = Ops::Max(b, max1);
+        }
+        for (; i+kWidth<=size; i+=kWidth) {
+            Vec a = Ops::Load(scores + i);
+            if constexpr (masked)
+                a = Ops::Select(Ops::MaskBits(mask + i), a, lowest);
+            max0 = Ops::Max(a, max0);
+        }
+        T best_score = Ops::ReduceMax(Ops::Max(max0, max1));
+        for (; i<size; ++i) {
+            if ((!masked || mask[i]) && scores[i] > best_score)
+                best_score = scores[i];
+        }
+        if (!(best_score > kLowest))
+            return kIntNull;
+        const Vec best = Ops::Set1(best_score);
+        for (i=0; i+kWidth<=size; i+=kWidth) {
+            uint32_t bits = Ops::Equal(Ops::Load(scores + i), best);
+            if constexpr (masked)
+                bits &= Ops::MaskBits(mask + i);
+            if (bits != 0)
+                return i + CountTrailingZeros(bits);
+        }
+        for (; i<size; ++i) {
+            if ((!masked || mask[i]) && scores[i] == best_score)
+                return i;
+        }
+        return kIntNull;
+    }
+
+    // Selects the index of the highest scoring element from a range of scores. Contiguous float and double scores
+    // are scanned with the vector kernels.
     //
     // Template Parameters:
     //   TIterator: Iterator type that points to the collection of scores.
@@ -19,12 +222,17 @@ namespace rlop {
     std::optional<Int> SelectBest(const TIterator& begin, const TIterator& end) {
         using TScore = typename std::iterator_traits<TIterator>::value_type;
         Int best = kIntNull;
-        TScore best_score = std::numeric_limits<TScore>::lowest();
-        for (auto it=begin; it!=end; ++it) {
-            TScore score = *it;
-            if (score > best_score) {
-                best = it - begin;
-                best_score = score;
+        if constexpr (IsSimdSelectable<TIterator>()) {
+            if (begin != end)
+                best = SimdSelectBest<TScore, false>(&*begin, nullptr, end - begin);
+        } else {
+            TScore best_score = std::numeric_limits<TScore>::lowest();
+            for (auto it=begin; it!=end; ++it) {
+                TScore score = *it;
+                if (score > best_score) {
+                    best = it - begin;
+                    best_score = score;
+                }
             }
         }
         if (best == kIntNull)
@@ -32,6 +240,125 @@ namespace rlop {
         return { best };
     }
 
+    // Selects the index of the highest scoring element among the legal ones of a range of scores, such as the
+    // scores of the actions of a state under its action mask. Contiguous float and double scores with a bool array
+    // of legality are scanned with the vector kernels.
+    //
+    // Template Parameters:
+    //   TIterator: Iterator type that points to the collection of scores.
+    //   TMaskIterator: Iterator type that points to the collection of boolean masks.
+    //
+    // Parameters:
+    //   begin: Iterator to the beginning of the score collection.
+    //   end: Iterator to the end of the score collection.
+    //   mask_begin: Iterator to the beginning of the masks of the scores, true for the legal ones.
+    //
+    // Returns:
+    //   std::optional<Int>: The index of the legal element with the highest score. Returns std::nullopt if no legal
+    //                       element has a valid score.
+    template<typename TIterator, typename TMaskIterator>
+    std::optional<Int> SelectBest(const TIterator& begin, const TIterator& end, const TMaskIterator& mask_begin) {
+        using TScore = typename std::iterator_traits<TIterator>::value_type;
+        using TMask = typename std::iterator_traits<TMaskIterator>::value_type;
+        static_assert(std::is_same_v<bool, TMask>, "SelectBest: requires a bool mask type.");
+        Int best = kIntNull;
+        if constexpr (IsSimdSelectable<TIterator>() && std::is_pointer_v<TMaskIterator>) {
+            if (begin != end)
+                best = SimdSelectBest<TScore, true>(&*begin, mask_begin, end - begin);
+        } else {
+            TScore best_score = std::numeric_limits<TScore>::lowest();
+            auto mask_it = mask_begin;
+            for (auto it=begin; it!=end; ++it, ++mask_it) {
+                TScore score = *it;
+                if (*mask_it && score > best_score) {
+                    best = it - begin;
+                    best_score = score;
+                }
+            }
+        }
+        if (best == kIntNull)
+            return std::nullopt;
+        return { best };
+    }
+
+    // Selects the indices of the `k` highest scoring elements of a range of scores, by decreasing score and, on
+    // ties, by increasing index, ignoring the scores not above std::numeric_limits<T>::lowest(). The current top
+    // elements are kept in a heap of indices rooted at the worst of them, so that a scan costs O(n log k) at worst,
+    // and an element only enters the heap if it beats the root, which the vector kernels test for a whole vector of
+    // contiguous float and double scores at once.
+    //
+    // Template Parameters:
+    //   TIterator: Iterator type that points to the collection of scores.
+    //
+    // Parameters:
+    //   begin: Iterator to the beginning of the score collection.
+    //   end: Iterator to the end of the score collection.
+    //   k: The number of indices to select.
+    //   indices: The output of the selected indices, fewer than `k` if there are fewer valid scores.
+    template<typename TIterator>
+    void SelectTopK(const TIterator& begin, const TIterator& end, Int k, std::vector<Int>& indices) {
+        using TScore = typename std::iterator_traits<TIterator>::value_type;
+        indices.clear();
+        if (k <= 0)
+            return;
+        indices.reserve(k);
+        auto better = [&begin](Int a, Int b) {
+            TScore score_a = begin[a], score_b = begin[b];
+            return score_a > score_b || (score_a == score_b && a < b);
+        };
+        TScore threshold = std::numeric_limits<TScore>::lowest();
+        // Elements come by increasing index, so one tying the root loses to it.
+        auto push = [&](Int i) {
+            if (!(begin[i] > threshold))
+                return;
+            if (static_cast<Int>(indices.size()) < k) {
+                indices.push_back(i);
+                std::push_heap(indices.begin(), indices.end(), better);
+            } else {
+                std::pop_heap(indices.begin(), indices.end(), better);
+                indices.back() = i;
+                std::push_heap(indices.begin(), indices.end(), better);
+            }
+            if (static_cast<Int>(indices.size()) == k)
+                threshold = begin[indices.front()];
+        };
+        Int size = end - begin;
+        Int i = 0;
+        if constexpr (IsSimdSelectable<TIterator>()) {
+            using Ops = SimdSelectOps<TScore>;
+            const TScore* scores = size > 0 ? &*begin : nullptr;
+            for (; i+Ops::kWidth<=size; i+=Ops::kWidth) {
+                uint32_t bits = Ops::Greater(Ops::Load(scores + i), Ops::Set1(threshold));
+                while (bits != 0) {
+                    push(i + CountTrailingZeros(bits));
+                    bits &= bits - 1;
+                }
+            }
+        }
+        for (; i<size; ++i)
+            push(i);
+        std::sort_heap(indices.begin(), indices.end(), better);
+    }
+
+    // Returns the first index in [begin, end) of a true element of a bool array, or kIntNull. The vector kernels
+    // compare 32 elements at a time.
+    inline Int FindTrue(const bool* mask, Int begin, Int end) {
+        Int i = begin;
+#if defined(__AVX2__)
+        for (; i+32<=end; i+=32) {
+            __m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mask + i));
+            uint32_t bits = ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(m, _mm256_setzero_si256())));
+            if (bits != 0)
+                return i + CountTrailingZeros(bits);
+        }
+#endif
+        for (; i<end; ++i) {
+            if (mask[i])
+                return i;
+        }
+        return kIntNull;
+    }
+
     // Selects the next true element in a boolean mask collection in a round-robin fashion.
     //
     // Template Parameters:
@@ -51,6 +378,14 @@ namespace rlop {
         static_assert(std::is_same_v<bool, TMask>, "SelectRoundRobin: requires a bool mask type.");
         if (current >= end - begin)
             return std::nullopt;
+        if constexpr (std::is_pointer_v<TIterator>) {
+            Int i = FindTrue(begin, current + 1, end - begin);
+            if (i == kIntNull)
+                i = FindTrue(begin, 0, current + 1);
+            if (i == kIntNull)
+                return std::nullopt;
+            return { i };
+        }
         auto current_it = begin + current;
         auto it = current_it;
         while (true) {
@@ -81,15 +416,15 @@ namespace rlop {
     template<typename TIterator>
     std::optional<Int> SelectUniform(const TIterator& begin, const TIterator& end, Random* rand) {
         using TMask = typename std::iterator_traits<TIterator>::value_type;
-        static_assert(std::is_same_v<bool, TMask>, "SelectRoundRobin: requires a bool mask type.");
-        std::vector<TIterator> indices;
-        indices.reserve(end - begin);
-        for (auto it=begin; it != end; ++it) {
-            if (*it)
-                indices.push_back(it);
-        }
-        if (indices.empty())
+        static_assert(std::is_same_v<bool, TMask>, "SelectUniform: requires a bool mask type.");
+        size_t num_true = std::count(begin, end, true);
+        if (num_true == 0)
             return std::nullopt;
-        return { indices[rand->Uniform(size_t(0), indices.size() - 1)] - begin };
+        size_t selected = rand->Uniform(size_t(0), num_true - 1);
+        for (auto it=begin; it!=end; ++it) {
+            if (*it && selected-- == 0)
+                return { it - begin };
+        }
+        return std::nullopt;
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include "typedef.h"
+
+namespace rlop {
+    // A Fenwick tree over non-negative weights, which updates a weight and samples an index in proportion to the
+    // weights in O(log n), instead of the O(n) of building a distribution from all the weights on every draw.
+    // Since the sums of the tree accumulate the rounding errors of the updates, it is rebuilt from the weights
+    // once every n updates, which keeps the errors bounded at an amortized constant cost.
+    //
+    // Template Parameters:
+    //   T: The arithmetic type of the weights.
+    template<typename T = double>
+    class SumTree {
+    public:
+        SumTree(Int size = 0, T value = 0) {
+            Reset(size, value);
+        }
+
+        virtual ~SumTree() = default;
+
+        void Reset(Int size, T value = 0) {
+            weights_.assign(size, value);
+            Rebuild();
+        }
+
+        template<typename TIterator>
+        void Assign(const TIterator& begin, const TIterator& end) {
+            weights_.assign(begin, end);
+            Rebuild();
+        }
+
+        // Recomputes the sums from the weights in O(n).
+        void Rebuild() {
+            Int size = weights_.size();
+            tree_.assign(size + 1, 0);
+            for (Int i=1; i<=size; ++i) {
+                tree_[i] += weights_[i - 1];
+                Int parent = i + (i & -i);
+                if (parent <= size)
+                    tree_[parent] += tree_[i];
+            }
+            top_ = 1;
+            while (top_ * 2 <= size)
+                top_ *= 2;
+            num_updates_ = 0;
+        }
+
+        void Set(Int i, T value) {
+            T delta = value - weights_[i];
+            weights_[i] = value;
+            if (++num_updates_ >= static_cast<Int>(weights_.size())) {
+                Rebuild();
+                return;
+            }
+            for (Int j=i+1; j<tree_.size(); j+=(j & -j))
+                tree_[j] += delta;
+        }
+
+        void Add(Int i, T delta) {
+            Set(i, weights_[i] + delta);
+        }
+
+        T Get(Int i) const {
+            return weights_[i];
+        }
+
+        // Returns the sum of the weights of the indices before i.
+        T PrefixSum(Int i) const {
+            T sum = 0;
+            for (; i>0; i-=(i & -i))
+                sum += tree_[i];
+            return sum;
+        }
+
+        // Returns the index whose interval of the cumulative weights contains the target, that is, the first index i
+        // such that PrefixSum(i + 1) > target. Drawing the target uniformly from [0, total()) samples the indices in
+        // proportion to their weights. A target not below total() gives the last index.
+        Int Find(T target) const {
+            Int size = weights_.size();
+            Int pos = 0;
+            for (Int step=top_; step>0; step/=2) {
+                if (pos + step <= size && tree_[pos + step] <= target) {
+                    pos += step;
+                    target -= tree_[pos];
+                }
+            }
+            return std::min(pos, size - 1);
+        }
+
+        T total() const {
+            return PrefixSum(weights_.size());
+        }
+
+        Int size() const {
+            return weights_.size();
+        }
+
+        const std::vector<T>& weights() const {
+            return weights_;
+        }
+
+    protected:
+        std::vector<T> weights_;
+        std::vector<T> tree_;
+        Int top_ = 1;
+        Int num_updates_ = 0;
+    };
+}
@@ -0,0 +1,458 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include "typedef.h"
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace rlop {
+    // A work-stealing pool of threads shared by the parallel parts of the library, so that the total number of
+    // threads of a process is set in one place. A pool of n threads has n - 1 workers, and the thread waiting for a
+    // parallel loop or a task group runs tasks too, so that it makes the n-th thread instead of idling. Each worker
+    // owns a deque: it runs its own tasks last in, first out, and steals the oldest tasks of the others when it has
+    // none. A task submitted by a worker goes to its own deque, and a task from another thread goes to the worker of
+    // its affinity hint, or to the workers in turn. Since waiting threads run tasks, parallel loops may nest.
+    //
+    // Idle workers spin shortly before sleeping, so that the short loops of consecutive iterations of a search do not
+    // pay the wake-up of a thread each time.
+    //
+    // Work whose memory should stay near one core, such as the tree of an environment of a root parallel search,
+    // can be bound to a worker with SubmitTo() or ParallelForPinned(): bound tasks are never stolen, so that with
+    // pinned workers the memory a task first touches is allocated on the NUMA node of its core and stays there.
+    class ThreadPool {
+    public:
+        using Task = std::function<void()>;
+
+        // Parameters:
+        //   num_threads: The number of threads, including the waiting thread. Default is DefaultNumThreads().
+        //   pin_threads: Whether to pin worker i to the core i + 1, where the platform allows it, leaving the core 0 to
+        //                the main thread. Default is DefaultPinThreads().
+        explicit ThreadPool(Int num_threads = DefaultNumThreads(), bool pin_threads = DefaultPinThreads()) : pin_threads_(pin_threads) {
+            Start(num_threads);
+        }
+
+        DISALLOW_COPY_AND_ASSIGN(ThreadPool);
+
+        virtual ~ThreadPool() {
+            Stop();
+        }
+
+        // Returns the value of the environment variable RLOP_NUM_THREADS if set, or the number of hardware threads.
+        static Int DefaultNumThreads() {
+            const char* value = std::getenv("RLOP_NUM_THREADS");
+            if (value != nullptr && std::atoi(value) > 0)
+                return std::atoi(value);
+            return std::max<Int>(std::thread::hardware_concurrency(), 1);
+        }
+
+        // Returns whether the environment variable RLOP_PIN_THREADS is set to a nonzero value.
+        static bool DefaultPinThreads() {
+            const char* value = std::getenv("RLOP_PIN_THREADS");
+            return value != nullptr && std::atoi(value) != 0;
+        }
+
+        // Returns the pool shared by the library.
+        static ThreadPool& Global() {
+            static ThreadPool pool;
+            return pool;
+        }
+
+        // Sets the number of threads of the shared pool, which must be idle.
+        static void SetGlobalNumThreads(Int num_threads) {
+            Global().Resize(num_threads);
+        }
+
+        // Replaces the workers by a new set. The pool must be idle.
+        void Resize(Int num_threads) {
+            if (std::max<Int>(num_threads, 1) == num_threads_)
+                return;
+            Stop();
+            Start(num_threads);
+        }
+
+        // Pins or unpins the workers by replacing them. The pool must be idle.
+        void set_pin_threads(bool pin_threads) {
+            if (pin_threads == pin_threads_)
+                return;
+            pin_threads_ = pin_threads;
+            Int num_threads = num_threads_;
+            Stop();
+            Start(num_threads);
+        }
+
+        // Queues a task, or runs it at once if the pool has no workers.
+        //
+        // Parameters:
+        //   task: The task.
+        //   affinity: The index of the preferred worker, kIntNull for none. Tasks submitted by a worker stay on it
+        //             without a hint.
+        void Submit(Task task, Int affinity = kIntNull) {
+            Int num_workers = workers_.size();
+            if (num_workers == 0) {
+                task();
+                return;
+            }
+            Int target;
+            if (affinity != kIntNull)
+                target = affinity % num_workers;
+            else if (current_pool_ == this)
+                target = current_worker_;
+            else
+                target = next_worker_.fetch_add(1, std::memory_order_relaxed) % num_workers;
+            {
+                std::lock_guard<std::mutex> lock(workers_[target]->mutex);
+                workers_[target]->tasks.push_back(std::move(task));
+            }
+            num_pending_.fetch_add(1);
+            if (num_sleeping_.load() > 0) {
+                { std::lock_guard<std::mutex> lock(sleep_mutex_); }
+                sleep_cv_.notify_one();
+            }
+        }
+
+        // Queues a task which only a given worker runs, or runs it at once if the pool has no workers.
+        //
+        // Parameters:
+        //   worker: The index of the worker, taken modulo the number of workers.
+        //   task: The task.
+        void SubmitTo(Int worker, Task task) {
+            Int num_workers = workers_.size();
+            if (num_workers == 0) {
+                task();
+                return;
+            }
+            Worker& target = *workers_[worker % num_workers];
+            {
+                std::lock_guard<std::mutex> lock(target.mutex);
+                target.bound_tasks.push_back(std::move(task));
+            }
+            target.num_bound.fetch_add(1);
+            { std::lock_guard<std::mutex> lock(sleep_mutex_); }
+            sleep_cv_.notify_all();
+        }
+
+        // Runs one queued task on the calling thread, taken from its own deque if it is a worker of the pool and
+        // stolen from the others otherwise.
+        //
+        // Returns:
+        //   bool: Returns false if no task was found.
+        bool RunPendingTask() {
+            Int self = current_pool_ == this ? current_worker_ : kIntNull;
+            Task task;
+            if (!PopTask(self, task))
+                return false;
+            task();
+            return true;
+        }
+
+        // Calls func(i) for each i in [begin, end) on up to max_threads threads of the pool, the calling thread
+        // included, which take chunks of grain indices in turn, so that uneven iterations balance.
+        //
+        // Parameters:
+        //   begin: The first index.
+        //   end: The index past the last one.
+        //   func: The function of an index, which must be safe to call concurrently for different indices.
+        //   grain: The number of consecutive indices of a chunk.
+        //   max_threads: The maximum number of threads of the loop.
+        template<typename TFunc>
+        void ParallelFor(Int begin, Int end, TFunc&& func, Int grain = 1, Int max_threads = kIntFull) {
+            Int size = end - begin;
+            if (size <= 0)
+                return;
+            grain = std::max<Int>(grain, 1);
+            Int num_chunks = (size + grain - 1) / grain;
+            Int num_threads = std::min({ num_threads_, max_threads, num_chunks });
+            if (num_threads <= 1) {
+                for (Int i=begin; i<end; ++i)
+                    func(i);
+                return;
+            }
+            std::atomic<Int> next_chunk(0);
+            auto run = [&]() {
+                Int chunk;
+                while ((chunk = next_chunk.fetch_add(1, std::memory_order_relaxed)) < num_chunks) {
+                    Int chunk_end = std::min(begin + (chunk + 1) * grain, end);
+                    for (Int i=begin+chunk*grain; i<chunk_end; ++i)
+                        func(i);
+                }
+            };
+            Group group(*this);
+            for (Int t=1; t<num_threads; ++t)
+                group.Run(run);
+            run();
+            group.Wait();
+        }
+
+        // Calls func(i) for each i in [begin, end) with every index on a fixed thread: the index i runs on the worker
+        // i % num_threads() if that is a worker, and on the calling thread otherwise. Successive loops over the same
+        // indices thus run each index on the same thread, which keeps their state in the cache and, with pinned
+        // workers, on the NUMA node of the thread that first touched it. Unlike ParallelFor(), the loop does not
+        // balance uneven indices.
+        template<typename TFunc>
+        void ParallelForPinned(Int begin, Int end, TFunc&& func) {
+            Int num_workers = workers_.size();
+            if (end - begin <= 1 || num_workers == 0) {
+                for (Int i=begin; i<end; ++i)
+                    func(i);
+                return;
+            }
+            Group group(*this);
+            for (Int slot=0; slot<num_workers && begin+slot<end; ++slot) {
+                group.RunOn(slot, [&, slot]() {
+                    for (Int i=begin+slot; i<end; i+=num_threads_)
+                        func(i);
+                });
+            }
+            for (Int i=begin+num_workers; i<end; i+=num_threads_)
+                func(i);
+            group.Wait();
+        }
+
+        // Returns the slot of an index in ParallelForPinned(): the index of the worker running it, or kIntNull for
+        // the calling thread.
+        Int PinnedWorker(Int i) const {
+            Int slot = i % num_threads_;
+            return slot < static_cast<Int>(workers_.size()) ? slot : kIntNull;
+        }
+
+        // Splits [begin, end) into up to max_blocks contiguous blocks of nearly equal sizes and calls
+        // func(block, block_begin, block_end) for each block in parallel. Reducing the results of the blocks in block
+        // order gives the result of the serial loop, whatever the number of threads.
+        template<typename TFunc>
+        void ParallelForBlocks(Int begin, Int end, Int max_blocks, TFunc&& func) {
+            Int size = end - begin;
+            if (size <= 0)
+                return;
+            Int num_blocks = std::max<Int>(std::min(max_blocks, size), 1);
+            ParallelFor(0, num_blocks, [&](Int block) {
+                func(block, begin + size * block / num_blocks, begin + size * (block + 1) / num_blocks);
+            }, 1, num_blocks);
+        }
+
+        Int num_threads() const {
+            return num_threads_;
+        }
+
+        Int num_workers() const {
+            return workers_.size();
+        }
+
+        bool pin_threads() const {
+            return pin_threads_;
+        }
+
+        // Returns the index of the worker of the pool running the calling thread, or kIntNull for another thread.
+        Int current_worker() const {
+            return current_pool_ == this ? current_worker_ : kIntNull;
+        }
+
+        // A set of tasks that can be waited for together. The waiting thread runs queued tasks, of the group or not,
+        // until the tasks of the group are done, and the first exception thrown by a task is rethrown by Wait().
+        class Group {
+        public:
+            explicit Group(ThreadPool& pool = ThreadPool::Global()) : pool_(pool) {}
+
+            DISALLOW_COPY_AND_ASSIGN(Group);
+
+            virtual ~Group() {
+                try {
+                    Wait();
+                } catch (...) {}
+            }
+
+            template<typename TFunc>
+            void Run(TFunc&& func, Int affinity = kIntNull) {
+                num_running_.fetch_add(1, std::memory_order_relaxed);
+                pool_.Submit(Wrap(std::forward<TFunc>(func)), affinity);
+            }
+
+            // Runs a task on a given worker only. See ThreadPool::SubmitTo().
+            template<typename TFunc>
+            void RunOn(Int worker, TFunc&& func) {
+                num_running_.fetch_add(1, std::memory_order_relaxed);
+                pool_.SubmitTo(worker, Wrap(std::forward<TFunc>(func)));
+            }
+
+            void Wait() {
+                while (num_running_.load(std::memory_order_acquire) > 0) {
+                    if (!pool_.RunPendingTask())
+                        std::this_thread::yield();
+                }
+                std::exception_ptr exception;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    std::swap(exception, exception_);
+                }
+                if (exception)
+                    std::rethrow_exception(exception);
+            }
+
+        protected:
+            template<typename TFunc>
+            Task Wrap(TFunc&& func) {
+                return [this, func = std::forward<TFunc>(func)]() mutable {
+                    try {
+                        func();
+                    } catch (...) {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        if (!exception_)
+                            exception_ = std::current_exception();
+                    }
+                    num_running_.fetch_sub(1, std::memory_order_release);
+                };
+            }
+
+            ThreadPool& pool_;
+            std::atomic<Int> num_running_{0};
+            std::mutex mutex_;
+            std::exception_ptr exception_;
+        };
+
+    protected:
+        struct Worker {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+            std::deque<Task> bound_tasks; // Run by this worker only.
+            std::atomic<Int> num_bound{0};
+            std::thread thread;
+        };
+
+        static constexpr Int kNumSpins = 4096;
+
+        void Start(Int num_threads) {
+            num_threads_ = std::max<Int>(num_threads, 1);
+            stop_ = false;
+            workers_.clear();
+            for (Int i=0; i+1<num_threads_; ++i)
+                workers_.push_back(std::make_unique<Worker>());
+            for (Int i=0; i<workers_.size(); ++i)
+                workers_[i]->thread = std::thread([this, i]() { RunWorker(i); });
+        }
+
+        void Stop() {
+            {
+                std::lock_guard<std::mutex> lock(sleep_mutex_);
+                stop_ = true;
+            }
+            sleep_cv_.notify_all();
+            for (auto& worker : workers_) {
+                if (worker->thread.joinable())
+                    worker->thread.join();
+            }
+            workers_.clear();
+            num_threads_ = 1;
+        }
+
+        bool PopTask(Int self, Task& task) {
+            Int num_workers = workers_.size();
+            if (self != kIntNull && workers_[self]->num_bound.load(std::memory_order_relaxed) > 0) {
+                std::lock_guard<std::mutex> lock(workers_[self]->mutex);
+                if (!workers_[self]->bound_tasks.empty()) {
+                    task = std::move(workers_[self]->bound_tasks.front());
+                    workers_[self]->bound_tasks.pop_front();
+                    workers_[self]->num_bound.fetch_sub(1);
+                    return true;
+                }
+            }
+            if (num_pending_.load(std::memory_order_relaxed) <= 0)
+                return false;
+            if (self != kIntNull) {
+                std::lock_guard<std::mutex> lock(workers_[self]->mutex);
+                if (!workers_[self]->tasks.empty()) {
+                    task = std::move(workers_[self]->tasks.back());
+                    workers_[self]->tasks.pop_back();
+                    num_pending_.fetch_sub(1);
+                    return true;
+                }
+            }
+            Int start = self == kIntNull ? 0 : self + 1;
+            for (Int k=0; k<num_workers; ++k) {
+                Int victim = (start + k) % num_workers;
+                if (victim == self)
+                    continue;
+                std::lock_guard<std::mutex> lock(workers_[victim]->mutex);
+                if (!workers_[victim]->tasks.empty()) {
+                    task = std::move(workers_[victim]->tasks.front());
+                    workers_[victim]->tasks.pop_front();
+                    num_pending_.fetch_sub(1);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void RunWorker(Int i) {
+            current_pool_ = this;
+            current_worker_ = i;
+            Worker& worker = *workers_[i];
+            if (pin_threads_)
+                Pin(i + 1);
+            Task task;
+            while (true) {
+                if (PopTask(i, task)) {
+                    task();
+                    task = nullptr;
+                    continue;
+                }
+                bool found = false;
+                for (Int spin=0; spin<kNumSpins && !found; ++spin) {
+                    found = num_pending_.load(std::memory_order_relaxed) > 0 || worker.num_bound.load(std::memory_order_relaxed) > 0 ||
+                        stop_.load(std::memory_order_relaxed);
+                    if (!found && spin % 64 == 63)
+                        std::this_thread::yield();
+                }
+                if (found && !stop_.load())
+                    continue;
+                std::unique_lock<std::mutex> lock(sleep_mutex_);
+                num_sleeping_.fetch_add(1);
+                sleep_cv_.wait(lock, [&]() { return stop_.load() || num_pending_.load() > 0 || worker.num_bound.load() > 0; });
+                num_sleeping_.fetch_sub(1);
+                if (stop_.load() && num_pending_.load() <= 0 && worker.num_bound.load() <= 0)
+                    return;
+            }
+        }
+
+        static void Pin(Int core) {
+#if defined(__linux__)
+            Int num_cores = std::max<Int>(std::thread::hardware_concurrency(), 1);
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(core % num_cores, &set);
+            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+        }
+
+        Int num_threads_ = 1;
+        bool pin_threads_ = false;
+        std::vector<std::unique_ptr<Worker>> workers_;
+        std::atomic<Int> num_pending_{0};
+        std::atomic<Int> num_sleeping_{0};
+        std::atomic<Int> next_worker_{0};
+        std::atomic<bool> stop_{false};
+        std::mutex sleep_mutex_;
+        std::condition_variable sleep_cv_;
+        static inline thread_local ThreadPool* current_pool_ = nullptr;
+        static inline thread_local Int current_worker_ = kIntNull;
+    };
+
+    // Calls func(i) for each i in [begin, end) on the shared pool. See ThreadPool::ParallelFor().
+    template<typename TFunc>
+    void ParallelFor(Int begin, Int end, TFunc&& func, Int grain = 1, Int max_threads = kIntFull) {
+        ThreadPool::Global().ParallelFor(begin, end, std::forward<TFunc>(func), grain, max_threads);
+    }
+
+    // Runs func(block, block_begin, block_end) over contiguous blocks on the shared pool. See
+    // ThreadPool::ParallelForBlocks().
+    template<typename TFunc>
+    void ParallelForBlocks(Int begin, Int end, Int max_blocks, TFunc&& func) {
+        ThreadPool::Global().ParallelForBlocks(begin, end, max_blocks, std::forward<TFunc>(func));
+    }
+
+    using TaskGroup = ThreadPool::Group;
+}
@@ -38,6 +38,18 @@ namespace rlop {
             return duration_;
         } 
 
+        // Returns the accumulated duration including the current run, without stopping the timer.
+        int64_t Elapsed() const {
+            if (!running_)
+                return duration_;
+            auto const now = std::chrono::high_resolution_clock::now();
+            return duration_ + std::chrono::duration_cast<T>(now - start_).count();
+        }
+
+        bool running() const {
+            return running_;
+        }
+
     private:
         bool running_;
         int64_t duration_ = 0;
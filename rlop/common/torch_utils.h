@@ -1,6 +1,7 @@
 #pragma once
 #include "torch/torch.h"
 #include "typedef.h"
+#include "thread_pool.h"
 
 namespace rlop::torch_utils {
     // Copies the state dictionary from a source libtorch model to a target model. This includes both
@@ -125,9 +126,99 @@ namespace rlop::torch_utils {
         if (params.size() != target_params.size())
             throw std::runtime_error("PolyakUpdate: Size mismatch between source parameters and target parameters. Source parameters size: " 
                                     + std::to_string(params.size()) + ", Target parameters size: " + std::to_string(target_params.size()));
-        for (size_t i = 0; i < params.size(); ++i) {
-            target_params[i].mul_(1.0 - tau).add_(params[i], tau);
+        if (params.empty())
+            return;
+        if (tau == 1.0) {
+            for (size_t i = 0; i < params.size(); ++i) {
+                target_params[i].copy_(params[i]);
+            }
+            return;
         }
+        // The foreach operations update all the tensors in a few kernels, instead of two per tensor.
+        torch::_foreach_mul_(target_params, 1.0 - tau);
+        torch::_foreach_add_(target_params, params, tau);
+    }
+
+    // Keeps tensors of the same type and device, such as the parameters of a module, in one contiguous flat tensor,
+    // each tensor being replaced in place by a view of it, so that an operation over all of them, such as a Polyak
+    // update, is one operation on the flat tensor whatever the number of layers. The tensors keep their identity, so
+    // that the optimizers holding them are not affected, but a flattening must precede the captures of CUDA graphs.
+    //
+    // Tensors of several types or devices are not flattened, and a load replacing the storage of a tensor, as
+    // torch::nn::Module::load() does, breaks the views: the operations then fall back to the tensors, and valid()
+    // tells when to flatten again.
+    class FlatParameters {
+    public:
+        FlatParameters() = default;
+
+        // Parameters:
+        //   tensors: The tensors.
+        //   flatten: Whether to flatten the tensors, or only to hold them.
+        FlatParameters(const std::vector<torch::Tensor>& tensors, bool flatten = true) : tensors_(tensors) {
+            if (!flatten || tensors_.empty())
+                return;
+            for (const auto& tensor : tensors_) {
+                if (tensor.scalar_type() != tensors_[0].scalar_type() || tensor.device() != tensors_[0].device())
+                    return;
+            }
+            torch::NoGradGuard no_grad;
+            Int numel = 0;
+            for (const auto& tensor : tensors_) {
+                offsets_.push_back(numel);
+                numel += tensor.numel();
+            }
+            flat_ = torch::empty({ numel }, tensors_[0].options());
+            for (Int i=0; i<tensors_.size(); ++i) {
+                torch::Tensor view = flat_.narrow(0, offsets_[i], tensors_[i].numel()).view(tensors_[i].sizes());
+                view.copy_(tensors_[i]);
+                tensors_[i].set_data(view);
+            }
+        }
+
+        // Returns whether the tensors are views of the flat tensor.
+        bool valid() const {
+            if (!flat_.defined())
+                return false;
+            auto* data = static_cast<char*>(flat_.data_ptr());
+            for (Int i=0; i<tensors_.size(); ++i) {
+                if (tensors_[i].data_ptr() != data + offsets_[i] * flat_.element_size())
+                    return false;
+            }
+            return true;
+        }
+
+        // Returns the flat tensor, undefined if the tensors are not flattened.
+        const torch::Tensor& flat() const {
+            return flat_;
+        }
+
+        const std::vector<torch::Tensor>& tensors() const {
+            return tensors_;
+        }
+
+        std::vector<torch::Tensor>& tensors() {
+            return tensors_;
+        }
+
+    protected:
+        std::vector<torch::Tensor> tensors_;
+        std::vector<Int> offsets_; // The offset of each tensor in the flat tensor.
+        torch::Tensor flat_;
+    };
+
+    // Applies Polyak averaging to update target parameters towards source parameters, with one operation on their
+    // flat tensors when both are flattened alike, a copy for tau = 1 and a lerp_ otherwise.
+    inline void PolyakUpdate(const FlatParameters& params, FlatParameters* target_params, double tau) {
+        tau = std::clamp(tau, 0.0, 1.0);
+        if (params.valid() && target_params->valid() && params.flat().sizes() == target_params->flat().sizes()) {
+            torch::NoGradGuard no_grad;
+            if (tau == 1.0)
+                target_params->flat().copy_(params.flat());
+            else
+                target_params->flat().lerp_(params.flat(), tau);
+            return;
+        }
+        PolyakUpdate(params.tensors(), target_params->tensors(), tau);
     }
 
     // Compares two libtorch models to check if they are identical in terms of parameters and buffers.
@@ -222,6 +313,19 @@ namespace rlop::torch_utils {
         }
     }
 
+    // Splits a budget of threads between the intra-op threads of libtorch and the shared ThreadPool, which steps
+    // the environments and runs the parallel searches, so that the two do not oversubscribe the cores. Both keep
+    // at least one thread.
+    //
+    // Parameters:
+    //   num_threads: The total number of threads.
+    //   num_torch_threads: The number of intra-op threads of libtorch, the rest going to the pool.
+    inline void SetThreadBudget(Int num_threads, Int num_torch_threads) {
+        num_torch_threads = std::clamp<Int>(num_torch_threads, 1, std::max<Int>(num_threads, 1));
+        torch::set_num_threads(num_torch_threads);
+        ThreadPool::SetGlobalNumThreads(std::max<Int>(num_threads - num_torch_threads, 1));
+    }
+
     inline void PrintTensorHelper(const torch::Tensor& tensor, int precision = 8) {
         std::cout << std::setprecision(precision);
         if (tensor.dim() == 1) {
@@ -5,6 +5,7 @@ namespace rlop {
     using Int = int64_t;
     constexpr auto kIntNull = (std::numeric_limits<Int>::lowest)(); 
     constexpr auto kIntFull = (std::numeric_limits<Int>::max)(); 
+    constexpr size_t kCacheLineSize = 64; // The alignment keeping data written by different threads apart.
 
 #define DISALLOW_COPY_AND_ASSIGN(TypeName)                                 \
     TypeName(const TypeName&) = delete;                                    \
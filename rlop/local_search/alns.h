@@ -0,0 +1,220 @@
+#pragma once
+#include "local_search.h"
+#include "rlop/common/random.h"
+#include "rlop/common/alias_sampler.h"
+
+namespace rlop {
+    // A template class for Adaptive Large Neighborhood Search, extending LocalSearch (Ropke and Pisinger, An adaptive
+    // large neighborhood search heuristic for the pickup and delivery problem with time windows, 2006). Each iteration
+    // destroys part of the current solution and repairs it, by a destroy and a repair operator drawn with probabilities
+    // proportional to their weights. The new solution is accepted by the simulated annealing criterion, and otherwise
+    // restored. The operators are scored by the outcome of each iteration, and their weights follow their average score
+    // at the end of each segment of iterations.
+    //
+    // A neighbor is the pair of the indices of a destroy operator and a repair operator.
+    //
+    // Template parameter:
+    //   TCost: The cost type of a solution, defaulted to double. Must be an arithmetic type.
+    template<typename TCost = double>
+    class ALNS : public LocalSearch<std::pair<Int, Int>, TCost> {
+    public:
+        using Neighbor = std::pair<Int, Int>;
+
+        // The scores of an operator for the outcome of an iteration.
+        struct Scores {
+            double best = 33; // A new best solution.
+            double better = 9; // A solution better than the current one.
+            double accepted = 13; // A solution accepted while not better.
+        };
+
+        // Parameters:
+        //   initial_temp: The starting temperature of the acceptance criterion, 0 to only accept improvements.
+        //   cooling_rate: The rate at which the temperature decreases in each iteration.
+        //   reaction_factor: The weight of the last segment in the update of the weights, in [0, 1].
+        //   segment_size: The number of iterations between two updates of the weights.
+        ALNS(
+            double initial_temp = 0,
+            double cooling_rate = 0,
+            double reaction_factor = 0.1,
+            Int segment_size = 100
+        ) :
+            temp_(initial_temp),
+            initial_temp_(initial_temp),
+            cooling_rate_(cooling_rate),
+            reaction_factor_(reaction_factor),
+            segment_size_(segment_size)
+        {}
+
+        virtual ~ALNS() = default;
+
+        virtual Int NumDestroyOperators() const = 0;
+
+        virtual Int NumRepairOperators() const = 0;
+
+        // Pure virtual function to remove part of the current solution.
+        //
+        // Parameters:
+        //   destroy_i: The index of the destroy operator.
+        virtual void Destroy(Int destroy_i) = 0;
+
+        // Pure virtual function to complete the destroyed solution.
+        //
+        // Parameters:
+        //   repair_i: The index of the repair operator.
+        virtual void Repair(Int repair_i) = 0;
+
+        // Pure virtual function to make the repaired solution the current one.
+        virtual void KeepSolution() = 0;
+
+        // Pure virtual function to restore the current solution, undoing the destroy and the repair.
+        virtual void RestoreSolution() = 0;
+
+        virtual void Reset() override {
+            LocalSearch<Neighbor, TCost>::Reset();
+            temp_ = initial_temp_;
+            destroy_weights_.clear();
+            repair_weights_.clear();
+        }
+
+        virtual void SetSeed(uint64_t seed) {
+            rand_.Seed(seed);
+        }
+
+        // Draws a destroy and a repair operator with probabilities proportional to their weights, from alias tables
+        // that are rebuilt when the weights change at the end of a segment.
+        virtual std::optional<Neighbor> Select() override {
+            if (NumDestroyOperators() == 0 || NumRepairOperators() == 0)
+                return std::nullopt;
+            if (destroy_weights_.size() != NumDestroyOperators() || repair_weights_.size() != NumRepairOperators())
+                ResetWeights();
+            Int destroy_i = destroy_sampler_.Sample(rand_);
+            Int repair_i = repair_sampler_.Sample(rand_);
+            return { { destroy_i, repair_i } };
+        }
+
+        // Destroys and repairs the current solution, then keeps or restores it and scores both operators.
+        virtual bool Step(const Neighbor& neighbor) override {
+            TCost cost = this->EvaluateSolution();
+            Destroy(neighbor.first);
+            Repair(neighbor.second);
+            TCost new_cost = this->EvaluateSolution();
+            double score = 0;
+            bool accepted = Accept(new_cost, cost);
+            if (new_cost < this->best_cost_)
+                score = scores_.best;
+            else if (new_cost < cost)
+                score = scores_.better;
+            else if (accepted)
+                score = scores_.accepted;
+            if (accepted)
+                KeepSolution();
+            else
+                RestoreSolution();
+            destroy_scores_[neighbor.first] += score;
+            ++destroy_uses_[neighbor.first];
+            repair_scores_[neighbor.second] += score;
+            ++repair_uses_[neighbor.second];
+            return true;
+        }
+
+        // Determines whether to accept a new solution based on its cost relative to the current solution and the
+        // current temperature.
+        //
+        // Parameters:
+        //   new_cost: The cost of the new solution.
+        //   cost: The cost of the current solution.
+        virtual bool Accept(double new_cost, double cost) {
+            if (new_cost < cost)
+                return true;
+            if (temp_ <= 0)
+                return false;
+            return std::exp((cost - new_cost) / temp_) > rand_.Uniform(0.0, 1.0);
+        }
+
+        virtual void Update() override {
+            temp_ *= (1.0 - cooling_rate_);
+            ++this->num_iters_;
+            if (this->num_iters_ % segment_size_ == 0)
+                UpdateWeights();
+        }
+
+        // Sets all the weights to 1 and clears the scores of the segment.
+        void ResetWeights() {
+            destroy_weights_.assign(NumDestroyOperators(), 1);
+            repair_weights_.assign(NumRepairOperators(), 1);
+            destroy_sampler_.Reset(destroy_weights_.begin(), destroy_weights_.end());
+            repair_sampler_.Reset(repair_weights_.begin(), repair_weights_.end());
+            ClearScores();
+        }
+
+        // Moves the weight of each operator used in the segment towards its average score by the reaction factor.
+        void UpdateWeights() {
+            UpdateWeights(destroy_weights_, destroy_scores_, destroy_uses_);
+            UpdateWeights(repair_weights_, repair_scores_, repair_uses_);
+            destroy_sampler_.Reset(destroy_weights_.begin(), destroy_weights_.end());
+            repair_sampler_.Reset(repair_weights_.begin(), repair_weights_.end());
+            ClearScores();
+        }
+
+        const std::vector<double>& destroy_weights() const {
+            return destroy_weights_;
+        }
+
+        const std::vector<double>& repair_weights() const {
+            return repair_weights_;
+        }
+
+        const Scores& scores() const {
+            return scores_;
+        }
+
+        void set_scores(const Scores& scores) {
+            scores_ = scores;
+        }
+
+        double temp() const {
+            return temp_;
+        }
+
+        double reaction_factor() const {
+            return reaction_factor_;
+        }
+
+        Int segment_size() const {
+            return segment_size_;
+        }
+
+    protected:
+        static constexpr double kMinWeight = 1e-3; // Keeps every operator drawable.
+
+        void UpdateWeights(std::vector<double>& weights, const std::vector<double>& scores, const std::vector<Int>& uses) {
+            for (Int i=0; i<weights.size(); ++i) {
+                if (uses[i] > 0)
+                    weights[i] = std::max((1 - reaction_factor_) * weights[i] + reaction_factor_ * scores[i] / uses[i], kMinWeight);
+            }
+        }
+
+        void ClearScores() {
+            destroy_scores_.assign(destroy_weights_.size(), 0);
+            destroy_uses_.assign(destroy_weights_.size(), 0);
+            repair_scores_.assign(repair_weights_.size(), 0);
+            repair_uses_.assign(repair_weights_.size(), 0);
+        }
+
+        double temp_;
+        double initial_temp_;
+        double cooling_rate_;
+        double reaction_factor_;
+        Int segment_size_;
+        Scores scores_;
+        std::vector<double> destroy_weights_;
+        std::vector<double> repair_weights_;
+        AliasSampler destroy_sampler_;
+        AliasSampler repair_sampler_;
+        std::vector<double> destroy_scores_;
+        std::vector<double> repair_scores_;
+        std::vector<Int> destroy_uses_;
+        std::vector<Int> repair_uses_;
+        Random rand_;
+    };
+}
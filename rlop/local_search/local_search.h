@@ -1,5 +1,7 @@
 #pragma once
 #include "rlop/common/base_algorithm.h"
+#include "rlop/common/profiler.h"
+#include "rlop/common/thread_pool.h"
 
 namespace rlop { 
     // A template class for implementing local search algorithms, where the goal is to find an
@@ -48,6 +50,7 @@ namespace rlop {
         // Parameters:
         //   max_num_iters: The maximum number of iterations to perform.
         virtual void Search(Int max_num_iters) {
+            RLOP_PROFILE_SCOPE("LocalSearch::Search");
             num_iters_= 0;
             max_num_iters_ = max_num_iters;
             best_cost_ = EvaluateSolution();
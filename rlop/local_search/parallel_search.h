@@ -0,0 +1,188 @@
+#pragma once
+#include "local_search.h"
+#include "rlop/common/random.h"
+
+namespace rlop {
+    // Runs replicas of a local search in parallel, one replica per thread at a time, for a number of epochs of
+    // iterations. Between two epochs, the replicas share their solutions:
+    //   - kIsland: every replica restarts from the best solution found so far by any replica.
+    //   - kReplicaExchange: the replicas are ordered by temperature, and neighbors swap their current solutions with
+    //     the Metropolis probability of parallel tempering, so that good solutions descend to the cold replicas while
+    //     the hot ones explore. The other replicas continue from their current solutions. The search type must
+    //     provide temp(), which stays constant for a fixed ladder of temperatures.
+    // A replica only interacts with the driver through Search(), EvaluateSolution(), best_cost(), and the functions
+    // getting and setting its solutions, so the replicas are the unmodified searches of a domain. A search type with
+    // SetSeed() has its replicas seeded differently.
+    //
+    // Template parameters:
+    //   TSearch: The type of the replicas, derived from LocalSearch.
+    //   TSolution: The type of the solutions, copyable.
+    template<typename TSearch, typename TSolution>
+    class ParallelSearch : public BaseAlgorithm {
+    public:
+        enum class Mode {
+            kIsland = 0,
+            kReplicaExchange
+        };
+
+        // Returns a solution of a replica, the best one of its last epoch or its current one.
+        using GetSolution = std::function<TSolution(const TSearch&)>;
+
+        // Restarts a replica from a solution.
+        using SetSolution = std::function<void(TSearch&, const TSolution&)>;
+
+        // Parameters:
+        //   replicas: The searches to run, ordered by increasing temperature for replica exchange.
+        //   get_best_solution: Returns the best solution of the last epoch of a replica.
+        //   get_solution: Returns the current solution of a replica, exchanged by replica exchange.
+        //   set_solution: Restarts a replica from a solution, keeping its temperature for replica exchange.
+        //   mode: How the replicas share their solutions between epochs.
+        //   seed: The seed of the first replica, incremented for each next one.
+        ParallelSearch(
+            std::vector<std::unique_ptr<TSearch>> replicas,
+            GetSolution get_best_solution,
+            GetSolution get_solution,
+            SetSolution set_solution,
+            Mode mode = Mode::kIsland,
+            uint64_t seed = 0
+        ) :
+            replicas_(std::move(replicas)),
+            get_best_solution_(std::move(get_best_solution)),
+            get_solution_(std::move(get_solution)),
+            set_solution_(std::move(set_solution)),
+            mode_(mode),
+            rand_(seed)
+        {
+            if (replicas_.empty())
+                throw std::runtime_error("ParallelSearch: there is no replica.");
+            if constexpr (HasSetSeed<TSearch>::value) {
+                for (Int r=0; r<replicas_.size(); ++r)
+                    replicas_[r]->SetSeed(seed + r);
+            }
+            if constexpr (!HasTemp<TSearch>::value) {
+                if (mode_ == Mode::kReplicaExchange)
+                    throw std::runtime_error("ParallelSearch: replica exchange requires replicas with a temperature.");
+            }
+        }
+
+        virtual ~ParallelSearch() = default;
+
+        virtual void Reset() override {
+            best_cost_ = std::numeric_limits<double>::max();
+            best_solution_.reset();
+            num_epochs_ = 0;
+            num_exchanges_ = 0;
+        }
+
+        // Runs the replicas for a number of epochs, sharing their solutions after each one.
+        //
+        // Parameters:
+        //   max_num_epochs: The number of epochs.
+        //   num_epoch_iters: The maximum number of iterations of a replica in an epoch.
+        virtual void Search(Int max_num_epochs, Int num_epoch_iters) {
+            RLOP_PROFILE_SCOPE("ParallelSearch::Search");
+            Int num_replicas = replicas_.size();
+            for (Int epoch=0; epoch<max_num_epochs; ++epoch) {
+                ParallelFor(0, num_replicas, [&](Int r) {
+                    replicas_[r]->Search(num_epoch_iters);
+                }, 1, num_threads_);
+                for (Int r=0; r<num_replicas; ++r) {
+                    if (replicas_[r]->best_cost() < best_cost_) {
+                        best_cost_ = replicas_[r]->best_cost();
+                        best_solution_ = get_best_solution_(*replicas_[r]);
+                    }
+                }
+                if (mode_ == Mode::kIsland) {
+                    for (Int r=0; r<num_replicas; ++r)
+                        set_solution_(*replicas_[r], *best_solution_);
+                }
+                else
+                    Exchange(epoch % 2);
+                ++num_epochs_;
+            }
+        }
+
+        double best_cost() const {
+            return best_cost_;
+        }
+
+        // Returns the best solution found by any replica, or std::nullopt before the first epoch.
+        const std::optional<TSolution>& best_solution() const {
+            return best_solution_;
+        }
+
+        const std::vector<std::unique_ptr<TSearch>>& replicas() const {
+            return replicas_;
+        }
+
+        Mode mode() const {
+            return mode_;
+        }
+
+        Int num_epochs() const {
+            return num_epochs_;
+        }
+
+        // Returns the number of swaps of solutions accepted by replica exchange.
+        Int num_exchanges() const {
+            return num_exchanges_;
+        }
+
+        Int num_threads() const {
+            return num_threads_;
+        }
+
+        // Sets the number of threads running the replicas.
+        void set_num_threads(Int num_threads) {
+            num_threads_ = std::max<Int>(num_threads, 1);
+        }
+
+    protected:
+        template<typename T, typename = void>
+        struct HasSetSeed : std::false_type {};
+
+        template<typename T>
+        struct HasSetSeed<T, std::void_t<decltype(std::declval<T&>().SetSeed(uint64_t()))>> : std::true_type {};
+
+        template<typename T, typename = void>
+        struct HasTemp : std::false_type {};
+
+        template<typename T>
+        struct HasTemp<T, std::void_t<decltype(std::declval<const T&>().temp())>> : std::true_type {};
+
+        // Swaps the current solutions of the pairs of neighbor replicas starting at an offset, each with the
+        // probability min(1, exp((e1 - e2) * (1 / t1 - 1 / t2))) of the current costs e1 and e2 at the temperatures t1
+        // and t2. Only the replicas of the accepted swaps restart, from the solution of their neighbor.
+        void Exchange(Int offset) {
+            if constexpr (HasTemp<TSearch>::value) {
+                Int num_replicas = replicas_.size();
+                for (Int r=offset; r+1<num_replicas; r+=2) {
+                    double e1 = replicas_[r]->EvaluateSolution();
+                    double e2 = replicas_[r+1]->EvaluateSolution();
+                    double t1 = std::max<double>(replicas_[r]->temp(), kMinTemp);
+                    double t2 = std::max<double>(replicas_[r+1]->temp(), kMinTemp);
+                    double exponent = (e1 - e2) * (1 / t1 - 1 / t2);
+                    if (exponent >= 0 || rand_.Uniform(0.0, 1.0) < std::exp(exponent)) {
+                        TSolution solution = get_solution_(*replicas_[r]);
+                        set_solution_(*replicas_[r], get_solution_(*replicas_[r+1]));
+                        set_solution_(*replicas_[r+1], solution);
+                        ++num_exchanges_;
+                    }
+                }
+            }
+        }
+
+        static constexpr double kMinTemp = 1e-9;
+        std::vector<std::unique_ptr<TSearch>> replicas_;
+        GetSolution get_best_solution_;
+        GetSolution get_solution_;
+        SetSolution set_solution_;
+        Mode mode_;
+        Random rand_;
+        Int num_threads_ = 1;
+        double best_cost_ = std::numeric_limits<double>::max();
+        std::optional<TSolution> best_solution_;
+        Int num_epochs_ = 0;
+        Int num_exchanges_ = 0;
+    };
+}
@@ -73,6 +73,8 @@ namespace rlop {
         //   std::optional<TNeighbor>: The neighbor being selected. If there is no legal neighbor,
         //                             returns std::nullopt.
         virtual std::optional<TNeighbor> Select() override {
+            if (num_proposals_ > 0)
+                return SelectProposal();
             TCost cost = this->EvaluateSolution();
             auto neighbor = SelectRandom();
             if (!neighbor)
@@ -82,6 +84,79 @@ namespace rlop {
                 return neighbor;
             return SelectBest();
         }
+
+        // Selects a neighbor in the batched mode. Draws num_proposals() random neighbors, evaluates them together, in
+        // parallel with several threads, and returns the first one passing the Metropolis test, without falling back
+        // to SelectBest(). The uniform draws of the test are made before the evaluations, so the selection does not
+        // depend on the number of threads, and it is the one of as many single proposals in a row. EvaluateNeighbor()
+        // must then be safe to call concurrently, possibly for the same neighbor.
+        //
+        // Returns:
+        //   std::optional<TNeighbor>: The accepted neighbor. If all the proposals are rejected, returns std::nullopt
+        //                             with rejected() true, and if there is no legal neighbor, with rejected() false.
+        virtual std::optional<TNeighbor> SelectProposal() {
+            rejected_ = false;
+            TCost cost = this->EvaluateSolution();
+            proposals_.clear();
+            while (proposals_.size() < num_proposals_) {
+                auto neighbor = SelectRandom();
+                if (!neighbor)
+                    break;
+                proposals_.push_back(std::move(*neighbor));
+            }
+            Int num_proposals = proposals_.size();
+            if (num_proposals == 0)
+                return std::nullopt;
+            proposal_costs_.resize(num_proposals);
+            thresholds_.resize(num_proposals);
+            for (Int i=0; i<num_proposals; ++i)
+                thresholds_[i] = rand_.Uniform(0.0, 1.0);
+            ParallelFor(0, num_proposals, [&](Int i) {
+                proposal_costs_[i] = EvaluateNeighbor(proposals_[i]);
+            }, 1, num_threads_);
+            // exp((cost - new_cost) / temp) > u is cost - new_cost > temp * log(u), which also holds for new_cost < cost.
+            for (Int i=0; i<num_proposals; ++i)
+                thresholds_[i] = (cost - proposal_costs_[i]) - temp_ * std::log(thresholds_[i]);
+            for (Int i=0; i<num_proposals; ++i) {
+                if (thresholds_[i] > 0)
+                    return proposals_[i];
+            }
+            rejected_ = true;
+            return std::nullopt;
+        }
+
+        // Executes the search as LocalSearch does. In the batched mode, an iteration whose proposals are all rejected
+        // keeps the current solution and counts as unimproved, instead of ending the search.
+        virtual void Search(Int max_num_iters) override {
+            if (num_proposals_ == 0) {
+                LocalSearch<TNeighbor, TCost>::Search(max_num_iters);
+                return;
+            }
+            RLOP_PROFILE_SCOPE("SimulatedAnnealing::Search");
+            this->num_iters_ = 0;
+            this->max_num_iters_ = max_num_iters;
+            this->best_cost_ = this->EvaluateSolution();
+            this->RecordSolution();
+            while (this->Proceed()) {
+                auto neighbor = this->Select();
+                if (neighbor) {
+                    if (!this->Step(*neighbor))
+                        break;
+                    TCost cost = this->EvaluateSolution();
+                    if (cost < this->best_cost_) {
+                        this->best_cost_ = cost;
+                        this->Improved();
+                    }
+                    else
+                        this->Unimproved();
+                }
+                else if (rejected_)
+                    this->Unimproved();
+                else
+                    break;
+                this->Update();
+            }
+        }
        
         // Determines whether to accept a new solution based on its cost relative to the current solution
         // and the current temperature.
@@ -119,11 +194,41 @@ namespace rlop {
             return cooling_rate_;
         }
 
+        Int num_proposals() const {
+            return num_proposals_;
+        }
+
+        // Sets the number of random neighbors proposed in each iteration of the batched mode, or 0 for a single
+        // proposal with the SelectBest() fallback.
+        void set_num_proposals(Int num_proposals) {
+            num_proposals_ = std::max<Int>(num_proposals, 0);
+        }
+
+        Int num_threads() const {
+            return num_threads_;
+        }
+
+        // Sets the number of threads evaluating the proposals of the batched mode.
+        void set_num_threads(Int num_threads) {
+            num_threads_ = std::max<Int>(num_threads, 1);
+        }
+
+        // Whether all the proposals of the last batched selection were rejected.
+        bool rejected() const {
+            return rejected_;
+        }
+
     protected:
         double temp_;
         double initial_temp_;
         double final_temp_;
         double cooling_rate_;
+        Int num_proposals_ = 0;
+        Int num_threads_ = 1;
+        bool rejected_ = false;
+        std::vector<TNeighbor> proposals_;
+        std::vector<double> proposal_costs_;
+        std::vector<double> thresholds_; // The uniform draws of the Metropolis test, then the margins of acceptance.
         Random rand_;
     };
 }
\ No newline at end of file
@@ -0,0 +1,86 @@
+#pragma once
+#include "rlop/common/typedef.h"
+
+namespace rlop {
+    // Records the best solution of a local search incrementally, as a copy of an earlier solution followed by a
+    // journal of the steps applied to it since. Committing the current solution as the best only marks the end of the
+    // journal, and the steps are replayed on the copy when the best solution is read, which replaces a full copy of
+    // the solution at each improvement by the replay of the steps in between. Once more steps than the journal can
+    // hold are applied without a commit, they are dropped and the next commit copies the solution.
+    //
+    // Template parameters:
+    //   TSolution: The type of the solution, copyable, with a Step(const TStep&) method applying a step.
+    //   TStep: The type of a step, a plain value such as an operator.
+    template<typename TSolution, typename TStep>
+    class SolutionJournal {
+    public:
+        // Parameters:
+        //   max_num_steps: The maximum number of steps kept in the journal.
+        SolutionJournal(Int max_num_steps = 1024) : max_num_steps_(max_num_steps) {}
+
+        virtual ~SolutionJournal() = default;
+
+        // Sets the best solution to a copy of a solution and clears the journal.
+        void Reset(const TSolution& solution) {
+            best_ = solution;
+            steps_.clear();
+            num_best_steps_ = 0;
+            overflowed_ = false;
+        }
+
+        // Records a step applied to the current solution.
+        void Record(const TStep& step) {
+            if (overflowed_)
+                return;
+            if (steps_.size() >= max_num_steps_) {
+                Replay();
+                if (steps_.size() >= max_num_steps_) {
+                    steps_.clear();
+                    overflowed_ = true;
+                    return;
+                }
+            }
+            steps_.push_back(step);
+        }
+
+        // Marks the current solution, the result of all the recorded steps, as the best one. It is copied only if the
+        // journal has overflowed.
+        void Commit(const TSolution& solution) {
+            if (overflowed_)
+                Reset(solution);
+            else
+                num_best_steps_ = steps_.size();
+        }
+
+        // Returns the best solution, after replaying its pending steps.
+        const TSolution& best() const {
+            Replay();
+            return best_;
+        }
+
+        Int num_steps() const {
+            return steps_.size();
+        }
+
+        Int max_num_steps() const {
+            return max_num_steps_;
+        }
+
+    protected:
+        // Applies the steps up to the last commit to the copy of the best solution, and removes them from the journal.
+        void Replay() const {
+            if (num_best_steps_ == 0)
+                return;
+            for (Int i=0; i<num_best_steps_; ++i)
+                best_.Step(steps_[i]);
+            steps_.erase(steps_.begin(), steps_.begin() + num_best_steps_);
+            num_best_steps_ = 0;
+        }
+
+        Int max_num_steps_;
+        mutable TSolution best_;
+        mutable std::vector<TStep> steps_;
+        mutable Int num_best_steps_ = 0;
+        bool overflowed_ = false;
+    };
+}
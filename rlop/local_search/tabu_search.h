@@ -50,17 +50,32 @@ namespace rlop {
             return num_unimproved_iters_ < max_num_unimproved_iters_;
         }
 
-        // Selects the next neighbor to consider, avoiding tabu neighbors unless it improves the best known cost.
+        // Selects the next neighbor to consider, avoiding tabu neighbors unless it improves the best known cost. With
+        // several threads, each thread of the shared pool scans a contiguous block of neighbors and the blocks are
+        // reduced in order, so the selected neighbor is the same as the one of the serial scan. EvaluateNeighbor() and
+        // IsTabu() must then be safe to call concurrently for different neighbors.
         virtual std::optional<Int> Select() override {
+            Int num_neighbors = NumNeighbors();
+            Int num_blocks = num_neighbors >= kMinNumParallelNeighbors ? num_threads_ : 1;
+            block_bests_.assign(num_blocks, kIntNull);
+            block_best_costs_.assign(num_blocks, std::numeric_limits<double>::max());
+            ParallelForBlocks(0, num_neighbors, num_blocks, [&](Int block, Int begin, Int end) {
+                for (Int i=begin; i<end; ++i) {
+                    double cost = EvaluateNeighbor(i);
+                    if (cost >= this->best_cost_ && IsTabu(i))
+                        continue;
+                    if (cost < block_best_costs_[block]) {
+                        block_bests_[block] = i;
+                        block_best_costs_[block] = cost;
+                    }
+                }
+            });
             Int best = kIntNull;
             double best_cost = std::numeric_limits<double>::max();
-            for (Int i=0; i<NumNeighbors(); ++i) {
-                double cost = EvaluateNeighbor(i);
-                if (cost >= this->best_cost_ && IsTabu(i))
-                    continue;
-                if (cost < best_cost) {
-                    best = i;
-                    best_cost = cost;
+            for (Int block=0; block<block_bests_.size(); ++block) {
+                if (block_best_costs_[block] < best_cost) {
+                    best = block_bests_[block];
+                    best_cost = block_best_costs_[block];
                 }
             }
             if (best == kIntNull)
@@ -85,8 +100,21 @@ namespace rlop {
             return max_num_unimproved_iters_;
         }
 
+        Int num_threads() const {
+            return num_threads_;
+        }
+
+        // Sets the number of threads scanning the neighbors in Select().
+        void set_num_threads(Int num_threads) {
+            num_threads_ = std::max<Int>(num_threads, 1);
+        }
+
     protected:
+        static constexpr Int kMinNumParallelNeighbors = 1024; // Smaller neighborhoods are scanned serially.
         Int num_unimproved_iters_ = 0;
         Int max_num_unimproved_iters_;
+        Int num_threads_ = 1;
+        std::vector<Int> block_bests_;
+        std::vector<double> block_best_costs_;
     };
 }
\ No newline at end of file
@@ -1,10 +1,16 @@
 #pragma once
 #include "rlop/common/utils.h"
+#include "rlop/common/memory_tracker.h"
 
 namespace rlop {
+    // The tabu tables are accounted under the tag "tabu" of the MemoryTracker.
+    constexpr const char* kTabuMemoryTag = "tabu";
+
     template<typename TKey>
     class HashTabuTable {
     public:
+        HashTabuTable() : memory_usage_(kTabuMemoryTag) {}
+
         virtual ~HashTabuTable() = default;
 
         virtual void Reset() {
@@ -23,6 +29,7 @@ namespace rlop {
             map_.erase(key);
         }
 
+        // Ages the entries and accounts the memory of the map, estimated from its nodes and buckets.
         virtual void Update() {
             for (auto it = map_.begin(); it != map_.end();) {
                 --it->second;
@@ -31,6 +38,8 @@ namespace rlop {
                 else
                     ++it;
             }
+            memory_usage_.Set(map_.size() * (sizeof(typename std::unordered_map<TKey, Int>::value_type) + 2 * sizeof(void*)) +
+                map_.bucket_count() * sizeof(void*));
         }
 
         const std::unordered_map<TKey, Int>& map() const {
@@ -39,11 +48,14 @@ namespace rlop {
 
     protected:
         std::unordered_map<TKey, Int> map_;
+        MemoryUsage memory_usage_;
     };
 
     class CircularTabuTable {
     public:
-        CircularTabuTable(size_t size) : vec_(size, 0) {}
+        CircularTabuTable(size_t size) : vec_(size, 0), memory_usage_(kTabuMemoryTag) {
+            memory_usage_.Set(vec_.size() * sizeof(Int));
+        }
 
         virtual ~CircularTabuTable() = default;
 
@@ -72,5 +84,181 @@ namespace rlop {
 
     protected:
         std::vector<Int> vec_;
+        MemoryUsage memory_usage_;
+    };
+
+    // A tabu table storing the iteration at which each key expires, instead of its remaining tenure, in a flat hash
+    // table with linear probing. IsTabu() and Tabu() are O(1) and Update() only advances the iteration, whereas
+    // HashTabuTable ages every entry on each update. The slots of expired keys are reused by later keys, and dropped
+    // when the table is rebuilt to grow. Once the tabu tables reach their memory budget, the table grows only when the
+    // keys still tabu would fill a third of it, instead of a quarter, and so rebuilds more often.
+    //
+    // Template Parameters:
+    //   TKey: The type of the keys, equality comparable and default constructible.
+    //   THash: The hash function of the keys. Its values are mixed again, so that an identity hash of integers
+    //          does not cluster nearby keys.
+    template<typename TKey, typename THash = std::hash<TKey>>
+    class ExpiryHashTabuTable {
+    public:
+        // Parameters:
+        //   capacity: The initial number of slots, rounded up to a power of two.
+        ExpiryHashTabuTable(size_t capacity = 1024) : memory_usage_(kTabuMemoryTag) {
+            size_t num_slots = 8;
+            while (num_slots < capacity)
+                num_slots *= 2;
+            slots_.resize(num_slots);
+            memory_usage_.Set(slots_.capacity() * sizeof(Slot));
+        }
+
+        virtual ~ExpiryHashTabuTable() = default;
+
+        virtual void Reset() {
+            std::fill(slots_.begin(), slots_.end(), Slot());
+            num_used_ = 0;
+            iteration_ = 0;
+        }
+
+        virtual bool IsTabu(const TKey& key) const {
+            size_t i = Find(key);
+            return i != kNotFound && slots_[i].expiry > iteration_;
+        }
+
+        // Makes a key tabu for the next tenure updates.
+        virtual void Tabu(const TKey& key, Int tenure) {
+            if ((num_used_ + 1) * 2 > slots_.size())
+                Rebuild();
+            size_t mask = slots_.size() - 1;
+            size_t reusable = kNotFound;
+            size_t i = Hash(key) & mask;
+            for (; slots_[i].expiry != kIntNull; i = (i + 1) & mask) {
+                if (slots_[i].key == key) {
+                    slots_[i].expiry = iteration_ + tenure;
+                    return;
+                }
+                if (reusable == kNotFound && slots_[i].expiry <= iteration_)
+                    reusable = i;
+            }
+            if (reusable == kNotFound) {
+                reusable = i;
+                ++num_used_;
+            }
+            slots_[reusable] = { key, iteration_ + tenure };
+        }
+
+        virtual void Untabu(const TKey& key) {
+            size_t i = Find(key);
+            if (i != kNotFound)
+                slots_[i].expiry = std::min(slots_[i].expiry, iteration_);
+        }
+
+        virtual void Update() {
+            ++iteration_;
+        }
+
+        Int iteration() const {
+            return iteration_;
+        }
+
+        size_t capacity() const {
+            return slots_.size();
+        }
+
+    protected:
+        static constexpr size_t kNotFound = std::numeric_limits<size_t>::max();
+
+        // A slot which was never used has the expiry kIntNull, and ends the probing.
+        struct Slot {
+            TKey key = TKey();
+            Int expiry = kIntNull;
+        };
+
+        size_t Hash(const TKey& key) const {
+            uint64_t h = THash()(key);
+            h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+            return h ^ (h >> 31);
+        }
+
+        size_t Find(const TKey& key) const {
+            size_t mask = slots_.size() - 1;
+            for (size_t i = Hash(key) & mask; slots_[i].expiry != kIntNull; i = (i + 1) & mask) {
+                if (slots_[i].key == key)
+                    return i;
+            }
+            return kNotFound;
+        }
+
+        // Reinserts the keys still tabu, into twice the slots if they would fill more than a quarter of them.
+        void Rebuild() {
+            std::vector<Slot>& slots = spare_slots_;
+            slots.swap(slots_);
+            size_t num_tabu = std::count_if(slots.begin(), slots.end(), [this](const Slot& slot) {
+                return slot.expiry != kIntNull && slot.expiry > iteration_;
+            });
+            size_t num_slots = slots.size();
+            size_t load = memory_usage_.OverBudget(num_slots * sizeof(Slot)) ? 3 : 4;
+            while (num_tabu * load >= num_slots)
+                num_slots *= 2;
+            slots_.assign(num_slots, Slot());
+            num_used_ = 0;
+            size_t mask = num_slots - 1;
+            for (const auto& slot : slots) {
+                if (slot.expiry == kIntNull || slot.expiry <= iteration_)
+                    continue;
+                size_t i = Hash(slot.key) & mask;
+                while (slots_[i].expiry != kIntNull)
+                    i = (i + 1) & mask;
+                slots_[i] = slot;
+                ++num_used_;
+            }
+            memory_usage_.Set((slots_.capacity() + spare_slots_.capacity()) * sizeof(Slot));
+        }
+
+        std::vector<Slot> slots_;
+        std::vector<Slot> spare_slots_; // The slots before the last rebuild, kept to reuse their memory.
+        size_t num_used_ = 0; // The slots which were ever used since the last rebuild, expired or not.
+        Int iteration_ = 0;
+        MemoryUsage memory_usage_;
+    };
+
+    // A circular tabu table storing the iteration at which each slot expires, so that Update() is O(1) instead of
+    // aging every slot as CircularTabuTable does.
+    class ExpiryCircularTabuTable {
+    public:
+        ExpiryCircularTabuTable(size_t size) : expiries_(size, 0), memory_usage_(kTabuMemoryTag) {
+            memory_usage_.Set(expiries_.size() * sizeof(Int));
+        }
+
+        virtual ~ExpiryCircularTabuTable() = default;
+
+        virtual void Reset() {
+            std::fill(expiries_.begin(), expiries_.end(), 0);
+            iteration_ = 0;
+        }
+
+        virtual bool IsTabu(Int key) const {
+            return expiries_[key % expiries_.size()] > iteration_;
+        }
+
+        virtual void Tabu(Int key, Int tenure) {
+            expiries_[key % expiries_.size()] = iteration_ + tenure;
+        }
+
+        virtual void Update() {
+            ++iteration_;
+        }
+
+        Int iteration() const {
+            return iteration_;
+        }
+
+        const std::vector<Int>& expiries() const {
+            return expiries_;
+        }
+
+    protected:
+        std::vector<Int> expiries_;
+        Int iteration_ = 0;
+        MemoryUsage memory_usage_;
     };
-}
\ No newline at end of file
+}
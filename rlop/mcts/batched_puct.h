@@ -0,0 +1,303 @@
+#pragma once
+#include "rlop/common/base_algorithm.h"
+#include "rlop/common/utils.h"
+#include "rlop/common/random.h"
+#include "rlop/common/profiler.h"
+#include "node_pool.h"
+
+namespace rlop {
+    // Implements a PUCT search which evaluates its leaves in batches. Each iteration descends `batch_size` times from
+    // the root, one descent per slot. Every slot owns an environment and adds a virtual loss to the nodes it passes, so
+    // the descents reach different leaves. The leaves are then evaluated together with a single call to Evaluate(),
+    // which typically runs one forward pass of a policy-value network. Each evaluated leaf gets all its children
+    // expanded with their priors, and its value is back-propagated.
+    class BatchedPUCT : public BaseAlgorithm {
+    public:
+        struct Node {
+            double mean_reward = 0;
+            double prior = 0;
+            Int num_visits = 0;
+            Int num_virtual_losses = 0;
+            Int num_children = 0; // The number of children nodes expanded.
+            bool evaluated = false; // Whether the priors of the children are known.
+            std::vector<Node*> children;
+
+            // Resets the statistics and the children of the node, keeping the capacity of the child array.
+            void Clear() {
+                mean_reward = 0;
+                prior = 0;
+                num_visits = 0;
+                num_virtual_losses = 0;
+                num_children = 0;
+                evaluated = false;
+                children.clear();
+            }
+        };
+
+        // Constructs a BatchedPUCT instance with specified parameters.
+        //
+        // Parameters:
+        //   batch_size: The number of leaves evaluated together, which is also the number of environments.
+        //   coef: The exploration coefficient of the PUCT formula, Default is sqrt(2).
+        //   virtual_loss: The reward penalty applied for each pending descent through a node. Default is 1.
+        BatchedPUCT(Int batch_size, double coef = std::sqrt(2), double virtual_loss = 1) :
+            coef_(coef),
+            virtual_loss_(virtual_loss),
+            paths_(batch_size),
+            terminals_(batch_size, false),
+            values_(batch_size, 0),
+            priors_(batch_size)
+        {
+            pending_slots_.reserve(batch_size);
+            owners_.reserve(batch_size);
+        }
+
+        virtual ~BatchedPUCT() = default;
+
+        // Pure virtual function to return the total number of child states from the current state of a slot.
+        virtual Int NumChildStates(Int slot_i) const = 0;
+
+        // Pure virtual function to revert the state of a slot to the state at the beginning of the search.
+        virtual void RevertState(Int slot_i) = 0;
+
+        // Pure virtual function to advance the state of a slot based on the selected child index.
+        //
+        // Parameters:
+        //   slot_i: The index of the slot.
+        //   child_i: The index of the child to move to.
+        //
+        // Return:
+        //   bool: Returns true if the step was successful and the new state is not terminal.
+        virtual bool Step(Int slot_i, Int child_i) = 0;
+
+        // Pure virtual function to return the reward of a terminal state of a slot.
+        virtual double Reward(Int slot_i) = 0;
+
+        // Pure virtual function to evaluate the current states of a batch of slots at once.
+        //
+        // Parameters:
+        //   slot_indices: The slots whose states must be evaluated.
+        //   priors: Output with at least slot_indices.size() entries. priors[j] receives the prior probabilities of the
+        //           NumChildStates(slot_indices[j]) children of the state of slot_indices[j].
+        //   values: Output with at least slot_indices.size() entries. values[j] receives the value of the state of
+        //           slot_indices[j].
+        virtual void Evaluate(const std::vector<Int>& slot_indices, std::vector<std::vector<double>>& priors, std::vector<double>& values) = 0;
+
+        // Resets the algorithm. The previous tree is released in O(1) by rewinding the node pool.
+        virtual void Reset() override {
+            ReleaseTree();
+            for (auto& path : paths_)
+                path.clear();
+            root_ = NewNode();
+        }
+
+        // Performs the search until the number of back-propagated leaves reaches max_num_iters.
+        //
+        // Parameters:
+        //   max_num_iters: The maximum number of iterations.
+        virtual void Search(Int max_num_iters) {
+            RLOP_PROFILE_SCOPE("BatchedPUCT::Search");
+            num_iters_ = 0;
+            max_num_iters_ = max_num_iters;
+            while (Proceed()) {
+                pending_slots_.clear();
+                owners_.clear();
+                for (Int i=0; i<batch_size(); ++i) {
+                    RevertState(i);
+                    paths_[i].clear();
+                    paths_[i].push_back(root_);
+                    terminals_[i] = !Select(i);
+                    owners_.push_back(terminals_[i] ? kIntNull : Enqueue(i));
+                }
+                if (!pending_slots_.empty()) {
+                    Evaluate(pending_slots_, priors_, values_);
+                    for (Int j=0; j<pending_slots_.size(); ++j)
+                        Expand(pending_slots_[j], priors_[j]);
+                }
+                for (Int i=0; i<batch_size(); ++i) {
+                    double value;
+                    if (terminals_[i])
+                        value = Reward(i);
+                    else
+                        value = values_[owners_[i]];
+                    BackPropagate(i, value);
+                }
+                Update();
+            }
+        }
+
+        // Checks if the search should continue.
+        virtual bool Proceed() {
+            return num_iters_ < max_num_iters_;
+        }
+
+        // Descends from the root to a leaf which has not been evaluated, adding a virtual loss to each node passed.
+        //
+        // Parameters:
+        //   slot_i: The index of the slot.
+        //
+        // Returns:
+        //   bool: Returns false if the descent reached a terminal state instead.
+        virtual bool Select(Int slot_i) {
+            while (paths_[slot_i].back()->evaluated) {
+                auto child_i = SelectTreePolicy(slot_i);
+                if (!child_i)
+                    return false;
+                Node* child = paths_[slot_i].back()->children[*child_i];
+                ++child->num_virtual_losses;
+                paths_[slot_i].push_back(child);
+                if (!Step(slot_i, *child_i))
+                    return false;
+            }
+            return true;
+        }
+
+        // Queues the leaf reached by a slot for evaluation, unless another slot of the batch already queued it.
+        //
+        // Returns:
+        //   Int: The position of the evaluation result of the leaf.
+        virtual Int Enqueue(Int slot_i) {
+            Node* leaf = paths_[slot_i].back();
+            for (Int j=0; j<pending_slots_.size(); ++j) {
+                if (paths_[pending_slots_[j]].back() == leaf)
+                    return j;
+            }
+            pending_slots_.push_back(slot_i);
+            return pending_slots_.size() - 1;
+        }
+
+        // Expands all children of the leaf reached by a slot with their priors.
+        //
+        // Parameters:
+        //   slot_i: The index of the slot.
+        //   priors: The prior probabilities of the children.
+        virtual void Expand(Int slot_i, const std::vector<double>& priors) {
+            Node* leaf = paths_[slot_i].back();
+            leaf->children.assign(priors.size(), nullptr);
+            for (Int i=0; i<priors.size(); ++i) {
+                leaf->children[i] = NewNode();
+                leaf->children[i]->prior = priors[i];
+            }
+            leaf->num_children = priors.size();
+            leaf->evaluated = true;
+        }
+
+        // Backpropagates a value through the path of a slot, removing the virtual losses added on the way down.
+        //
+        // Parameters:
+        //   slot_i: The index of the slot.
+        //   value: The value of the leaf.
+        virtual void BackPropagate(Int slot_i, double value) {
+            while (paths_[slot_i].size() > 1) {
+                --paths_[slot_i].back()->num_virtual_losses;
+                UpdateNode(slot_i, value);
+                paths_[slot_i].pop_back();
+            }
+            UpdateNode(slot_i, value);
+        }
+
+        virtual void Update() {
+            num_iters_ += batch_size();
+        }
+
+        // Releases the whole tree. Together with NewNode() and DeleteNode(), this can be overridden to plug in
+        // another allocation scheme.
+        virtual void ReleaseTree() {
+            node_pool_.Reset();
+        }
+
+        virtual Node* NewNode() {
+            return node_pool_.New();
+        }
+
+        virtual void DeleteNode(Node* node) {
+            node_pool_.Delete(node);
+        }
+
+        virtual void UpdateNode(Int slot_i, double reward) const {
+            Node* node = paths_[slot_i].back();
+            node->mean_reward = (node->num_visits * node->mean_reward + reward) / (node->num_visits + 1.0);
+            node->num_visits += 1;
+        }
+
+        // Computes the PUCT score of a child of the current node of a slot. Pending descents of the other slots are
+        // counted as visits with a reward of -virtual_loss.
+        //
+        // Parameters:
+        //   slot_i: The index of the slot.
+        //   child_i: The index of the child node.
+        //
+        // Return:
+        //   double: the value of the child node.
+        virtual double TreePolicy(Int slot_i, Int child_i) {
+            const Node* parent = paths_[slot_i].back();
+            const Node* child = parent->children[child_i];
+            Int num_visits = child->num_visits + child->num_virtual_losses;
+            double mean_reward = num_visits == 0 ? 0 : (child->num_visits * child->mean_reward - virtual_loss_ * child->num_virtual_losses) / num_visits;
+            double total_num_visits = parent->num_visits + parent->num_virtual_losses;
+            return mean_reward + coef_ * child->prior * std::sqrt(total_num_visits) / (1.0 + num_visits);
+        }
+
+        // Selects the next child node to explore based on the tree policy for a slot.
+        //
+        // Returns:
+        //   std::optional<Int>: The index of the child node with the highest PUCT score. If the current node has no
+        //                       children, returns std::nullopt.
+        virtual std::optional<Int> SelectTreePolicy(Int slot_i) {
+            Int best = kIntNull;
+            double best_score = std::numeric_limits<double>::lowest();
+            for (Int i=0; i<paths_[slot_i].back()->children.size(); ++i) {
+                double score = TreePolicy(slot_i, i);
+                if (score > best_score) {
+                    best = i;
+                    best_score = score;
+                }
+            }
+            if (best == kIntNull)
+                return std::nullopt;
+            return { best };
+        }
+
+        Int batch_size() const {
+            return paths_.size();
+        }
+
+        const Node* root() const {
+            return root_;
+        }
+
+        const std::vector<std::vector<Node*>>& paths() const {
+            return paths_;
+        }
+
+        double coef() const {
+            return coef_;
+        }
+
+        void set_coef(double coef) {
+            coef_ = coef;
+        }
+
+        double virtual_loss() const {
+            return virtual_loss_;
+        }
+
+        void set_virtual_loss(double virtual_loss) {
+            virtual_loss_ = virtual_loss;
+        }
+
+    protected:
+        double coef_;
+        double virtual_loss_;
+        Int num_iters_ = 0;
+        Int max_num_iters_ = 0;
+        Node* root_ = nullptr;
+        std::vector<std::vector<Node*>> paths_;
+        std::vector<bool> terminals_;
+        std::vector<Int> owners_;
+        std::vector<Int> pending_slots_;
+        std::vector<double> values_;
+        std::vector<std::vector<double>> priors_;
+        NodePool<Node> node_pool_;
+    };
+}
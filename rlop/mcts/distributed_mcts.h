@@ -0,0 +1,240 @@
+#pragma once
+#include "root_parallel_mcts.h"
+
+#if defined(__GNUC__) && !defined(_WIN32)
+#include <cerrno>
+#include <cstring>
+#include <thread>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace rlop {
+    // Exchanges root statistics between processes over TCP sockets, so that a single decision can use the cores of
+    // several machines. Process 0 is the coordinator: it listens on a port, gathers the statistics of every other
+    // process, merges them with its own and sends the merged statistics back. The other processes connect to the
+    // coordinator. Statistics are sent in the byte order of the host, so all processes must run on the same
+    // architecture.
+    class RootStatisticsExchanger {
+    public:
+        // Constructs an exchanger. The connections are established by Connect().
+        //
+        // Parameters:
+        //   num_processes: The number of processes taking part in the search.
+        //   process_i: The index of this process, 0 for the coordinator.
+        //   host: The host name or address of the coordinator.
+        //   port: The port the coordinator listens on.
+        RootStatisticsExchanger(Int num_processes, Int process_i, const std::string& host = "127.0.0.1", int port = 50051) :
+            num_processes_(num_processes),
+            process_i_(process_i),
+            host_(host),
+            port_(port)
+        {
+            if (num_processes_ < 1 || process_i_ < 0 || process_i_ >= num_processes_)
+                throw std::runtime_error("Invalid process index " + std::to_string(process_i_) + " of " + std::to_string(num_processes_) + " processes.");
+        }
+
+        virtual ~RootStatisticsExchanger() {
+            Close();
+        }
+
+        DISALLOW_COPY_AND_ASSIGN(RootStatisticsExchanger);
+
+        // Establishes the connections. The coordinator blocks until every other process has connected, while the other
+        // processes retry until the coordinator accepts them or the timeout expires.
+        //
+        // Parameters:
+        //   timeout: The maximum time to wait for the coordinator in milliseconds.
+        void Connect(Int timeout = 30000) {
+            Close();
+            if (num_processes_ == 1)
+                return;
+            if (process_i_ == 0)
+                Listen();
+            else
+                ConnectToCoordinator(timeout);
+        }
+
+        void Close() {
+            for (int fd : peers_)
+                close(fd);
+            peers_.clear();
+            if (listener_ >= 0) {
+                close(listener_);
+                listener_ = -1;
+            }
+        }
+
+        // Merges the statistics of all processes. Every process must call it the same number of times.
+        //
+        // Parameters:
+        //   statistics: The statistics of this process.
+        //
+        // Returns:
+        //   RootStatistics: The statistics summed over all processes.
+        RootStatistics AllReduce(const RootStatistics& statistics) {
+            if (num_processes_ == 1)
+                return statistics;
+            if (peers_.empty())
+                throw std::runtime_error("RootStatisticsExchanger is not connected.");
+            if (process_i_ != 0) {
+                Send(peers_.front(), statistics);
+                return Receive(peers_.front());
+            }
+            RootStatistics merged = statistics;
+            for (int fd : peers_)
+                merged.Merge(Receive(fd));
+            for (int fd : peers_)
+                Send(fd, merged);
+            return merged;
+        }
+
+        Int num_processes() const {
+            return num_processes_;
+        }
+
+        Int process_i() const {
+            return process_i_;
+        }
+
+        bool connected() const {
+            return num_processes_ == 1 || !peers_.empty();
+        }
+
+    protected:
+        void Listen() {
+            listener_ = socket(AF_INET, SOCK_STREAM, 0);
+            if (listener_ < 0)
+                ThrowError("socket");
+            int opt = 1;
+            setsockopt(listener_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_ANY);
+            address.sin_port = htons(port_);
+            if (bind(listener_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0)
+                ThrowError("bind");
+            if (listen(listener_, num_processes_) < 0)
+                ThrowError("listen");
+            while (peers_.size() < num_processes_ - 1) {
+                int fd = accept(listener_, nullptr, nullptr);
+                if (fd < 0)
+                    ThrowError("accept");
+                SetNoDelay(fd);
+                peers_.push_back(fd);
+            }
+        }
+
+        void ConnectToCoordinator(Int timeout) {
+            addrinfo hints{};
+            hints.ai_family = AF_INET;
+            hints.ai_socktype = SOCK_STREAM;
+            addrinfo* addresses = nullptr;
+            if (getaddrinfo(host_.c_str(), std::to_string(port_).c_str(), &hints, &addresses) != 0 || addresses == nullptr)
+                throw std::runtime_error("Cannot resolve the coordinator host " + host_ + ".");
+            Timer<> timer;
+            timer.Start();
+            int fd = -1;
+            while (fd < 0) {
+                fd = socket(addresses->ai_family, addresses->ai_socktype, addresses->ai_protocol);
+                if (fd >= 0 && connect(fd, addresses->ai_addr, addresses->ai_addrlen) == 0)
+                    break;
+                if (fd >= 0)
+                    close(fd);
+                fd = -1;
+                if (timer.Elapsed() >= timeout) {
+                    freeaddrinfo(addresses);
+                    throw std::runtime_error("Cannot connect to the coordinator " + host_ + ":" + std::to_string(port_) + ".");
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+            freeaddrinfo(addresses);
+            SetNoDelay(fd);
+            peers_.push_back(fd);
+        }
+
+        void Send(int fd, const RootStatistics& statistics) {
+            Int size = statistics.size();
+            SendAll(fd, &size, sizeof(size));
+            SendAll(fd, statistics.num_visits.data(), size * sizeof(Int));
+            SendAll(fd, statistics.total_rewards.data(), size * sizeof(double));
+        }
+
+        RootStatistics Receive(int fd) {
+            Int size = 0;
+            ReceiveAll(fd, &size, sizeof(size));
+            if (size < 0)
+                throw std::runtime_error("Received invalid root statistics.");
+            RootStatistics statistics(size);
+            ReceiveAll(fd, statistics.num_visits.data(), size * sizeof(Int));
+            ReceiveAll(fd, statistics.total_rewards.data(), size * sizeof(double));
+            return statistics;
+        }
+
+        void SendAll(int fd, const void* data, size_t num_bytes) {
+            const char* bytes = static_cast<const char*>(data);
+            while (num_bytes > 0) {
+                ssize_t n = send(fd, bytes, num_bytes, MSG_NOSIGNAL);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n <= 0)
+                    ThrowError("send");
+                bytes += n;
+                num_bytes -= n;
+            }
+        }
+
+        void ReceiveAll(int fd, void* data, size_t num_bytes) {
+            char* bytes = static_cast<char*>(data);
+            while (num_bytes > 0) {
+                ssize_t n = recv(fd, bytes, num_bytes, 0);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n == 0)
+                    throw std::runtime_error("The connection was closed by the peer.");
+                if (n < 0)
+                    ThrowError("recv");
+                bytes += n;
+                num_bytes -= n;
+            }
+        }
+
+        static void SetNoDelay(int fd) {
+            int opt = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+        }
+
+        static void ThrowError(const std::string& call) {
+            throw std::runtime_error(call + " failed: " + std::strerror(errno));
+        }
+
+        Int num_processes_;
+        Int process_i_;
+        std::string host_;
+        int port_;
+        int listener_ = -1;
+        std::vector<int> peers_; // The workers for the coordinator, the coordinator for a worker.
+    };
+
+    // Searches the same root on every environment of this process, then merges the root statistics with the other
+    // processes. Every process must search the same root.
+    //
+    // Parameters:
+    //   mcts: The root parallel search of this process.
+    //   exchanger: A connected exchanger.
+    //   max_num_iters: The maximum number of iterations of each environment.
+    //   max_duration: The maximum duration of the local search in milliseconds, kIntFull for no deadline.
+    //
+    // Returns:
+    //   RootStatistics: The statistics summed over all environments of all processes.
+    inline RootStatistics DistributedSearch(RootParallelMCTS& mcts, RootStatisticsExchanger& exchanger, Int max_num_iters, Int max_duration = kIntFull) {
+        if (max_duration == kIntFull)
+            mcts.SearchAsync(max_num_iters);
+        else
+            mcts.SearchAsyncFor(max_duration, max_num_iters);
+        return exchanger.AllReduce(mcts.MergeRootStatistics());
+    }
+}
+#endif
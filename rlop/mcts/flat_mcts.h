@@ -0,0 +1,288 @@
+#pragma once
+#include "rlop/common/base_algorithm.h"
+#include "rlop/common/utils.h"
+#include "rlop/common/random.h"
+#include "rlop/common/selectors.h"
+#include "rlop/common/profiler.h"
+
+namespace rlop {
+    // Implements the Monte Carlo Tree Search (MCTS) algorithm with a flat memory layout. Nodes are stored by index in
+    // a single array, and the children of a node form a contiguous block of struct-of-arrays storage holding their
+    // visit counts, reward sums and priors. The tree policy is evaluated over a whole block at once with a loop the
+    // compiler vectorises, instead of a virtual call and a pointer dereference per child.
+    //
+    // The domain interface is the same as the one of MCTS.
+    class FlatMCTS : public BaseAlgorithm {
+    public:
+        struct Node {
+            double mean_reward = 0;
+            Int num_visits = 0;
+            Int num_children = 0; // The number of children nodes expanded.
+            Int num_child_states = 0; // The size of the child block, 0 before the block is allocated.
+            Int block = kIntNull; // The offset of the child block.
+            Int slot = kIntNull; // The offset of the node in the child block of its parent.
+        };
+
+        // Constructs a FlatMCTS with a exploration coefficient.
+        //
+        // Parameters:
+        //   coef: The exploration coefficient used in the UCB1 formula, Default is sqrt(2).
+        FlatMCTS(double coef = std::sqrt(2)) : coef_(coef) {}
+
+        virtual ~FlatMCTS() = default;
+
+        // Pure virtual function to return the total number of child states from the current state.
+        virtual Int NumChildStates() const = 0;
+
+        // Pure virtual function to determine whether a node has been fully expanded.
+        virtual bool IsExpanded(const Node& node) const = 0;
+
+        // Pure virtual function to revert the environment state to the state at the beginning of the search.
+        virtual void RevertState() = 0;
+
+        // Pure virtual function to advance the environment state based on the selected child index.
+        //
+        // Parameters:
+        //   child_i: The index of the child to move to.
+        //
+        // Return:
+        //   bool: Returns true if the step was successful.
+        virtual bool Step(Int child_i) = 0;
+
+        // Pure virtual function to return the reward of the current state.
+        virtual double Reward() = 0;
+
+        // Resets the algorithm. The storage keeps its capacity, so resetting is O(1).
+        virtual void Reset() override {
+            nodes_.clear();
+            visits_.clear();
+            reward_sums_.clear();
+            priors_.clear();
+            child_nodes_.clear();
+            path_.clear();
+            path_.push_back(NewNode(kIntNull));
+        }
+
+        virtual void SetSeed(uint64_t seed) {
+            rand_.Seed(seed);
+        }
+
+        // Performs the MCTS search over a maximum number of iterations.
+        //
+        // Parameters:
+        //   max_num_iters: The maximum number of iterations.
+        virtual void Search(Int max_num_iters) {
+            RLOP_PROFILE_SCOPE("FlatMCTS::Search");
+            num_iters_ = 0;
+            max_num_iters_ = max_num_iters;
+            while (Proceed()) {
+                RevertState();
+                if (Select() && Expand())
+                    Simulate();
+                BackPropagate();
+                Update();
+            }
+        }
+
+        // Checks if the search should continue.
+        virtual bool Proceed() {
+            return num_iters_ < max_num_iters_;
+        }
+
+        // Selects the next node to explore in the tree based on the tree policy.
+        virtual bool Select() {
+            while (IsExpanded(nodes_[path_.back()])) {
+                auto child_i = SelectByTreePolicy();
+                if (!child_i)
+                    return false;
+                path_.push_back(child_nodes_[nodes_[path_.back()].block + *child_i]);
+                if (!Step(*child_i))
+                    return false;
+            }
+            return true;
+        }
+
+        // Expands the current node by adding a new child node to the tree.
+        virtual bool Expand() {
+            Int node_i = path_.back();
+            if (nodes_[node_i].num_child_states == 0)
+                AllocateBlock(node_i, NumChildStates());
+            if (nodes_[node_i].num_child_states == 0)
+                return false;
+            auto child_i = SelectToExpand();
+            if (!child_i)
+                return false;
+            Int slot = nodes_[node_i].block + *child_i;
+            if (child_nodes_[slot] == kIntNull) {
+                Int child = NewNode(slot);
+                child_nodes_[slot] = child;
+                visits_[slot] = 0;
+                ++nodes_[node_i].num_children;
+            }
+            path_.push_back(child_nodes_[slot]);
+            return Step(*child_i);
+        }
+
+        // Simulates the outcome from the current state to the end of the episode.
+        virtual bool Simulate() {
+            while (true) {
+                auto i = SelectRandom();
+                if (!i || !Step(*i))
+                    return false;
+            }
+        }
+
+        // Backpropagates the simulation results through the path in the tree.
+        virtual void BackPropagate() {
+            double reward = Reward();
+            while (path_.size() > 1) {
+                UpdateNode(reward);
+                path_.pop_back();
+            }
+            UpdateNode(reward);
+        }
+
+        virtual void Update() {
+            ++num_iters_;
+        }
+
+        // Appends a node to the node array.
+        //
+        // Parameters:
+        //   slot: The offset of the node in the child block of its parent, kIntNull for the root.
+        //
+        // Returns:
+        //   Int: The index of the node.
+        virtual Int NewNode(Int slot) {
+            nodes_.emplace_back();
+            nodes_.back().slot = slot;
+            return nodes_.size() - 1;
+        }
+
+        // Allocates the child block of a node. Children which are not expanded yet have a visit count of -1 in the
+        // block, so the tree policy can rank them last without a separate mask.
+        //
+        // Parameters:
+        //   node_i: The index of the node.
+        //   num_child_states: The number of children.
+        virtual void AllocateBlock(Int node_i, Int num_child_states) {
+            if (num_child_states <= 0)
+                return;
+            nodes_[node_i].block = visits_.size();
+            nodes_[node_i].num_child_states = num_child_states;
+            visits_.resize(visits_.size() + num_child_states, -1);
+            reward_sums_.resize(reward_sums_.size() + num_child_states, 0);
+            priors_.resize(priors_.size() + num_child_states, 0);
+            child_nodes_.resize(child_nodes_.size() + num_child_states, kIntNull);
+            scores_.resize(std::max<size_t>(scores_.size(), num_child_states));
+        }
+
+        virtual void UpdateNode(double reward) {
+            Node& node = nodes_[path_.back()];
+            node.mean_reward = (node.num_visits * node.mean_reward + reward) / (node.num_visits + 1.0);
+            node.num_visits += 1;
+            if (node.slot != kIntNull) {
+                visits_[node.slot] = node.num_visits;
+                reward_sums_[node.slot] += reward;
+            }
+        }
+
+        // Computes the UCB1 scores of all children of the current node into `scores_`.
+        virtual void ComputeScores() {
+            const Node& node = nodes_[path_.back()];
+            const double* visits = visits_.data() + node.block;
+            const double* reward_sums = reward_sums_.data() + node.block;
+            double* scores = scores_.data();
+            Int size = node.num_child_states;
+            double c = coef_ * std::sqrt(std::log(std::max<double>(node.num_visits, 1)));
+            constexpr double kLowest = std::numeric_limits<double>::lowest();
+            constexpr double kMax = std::numeric_limits<double>::max();
+            #pragma omp simd
+            for (Int i=0; i<size; ++i) {
+                double n = std::max(visits[i], 1.0);
+                double score = reward_sums[i] / n + c / std::sqrt(n);
+                scores[i] = visits[i] < 0 ? kLowest : (visits[i] == 0 ? kMax : score);
+            }
+        }
+
+        // Selects the next child node to explore based on the tree policy.
+        //
+        // Returns:
+        //   std::optional<Int>: The index of the child node with the highest UCB1 score. If the current node has no
+        //                       expanded children, returns std::nullopt.
+        virtual std::optional<Int> SelectByTreePolicy() {
+            const Node& node = nodes_[path_.back()];
+            if (node.num_children == 0)
+                return std::nullopt;
+            ComputeScores();
+            return SelectBest(scores_.begin(), scores_.begin() + node.num_child_states);
+        }
+
+        // Selects a child node to expand next from the current node's children.
+        //
+        // Returns:
+        //   std::optional<Int>: The index of the child node selected for expansion. If the current node has no legal
+        //                       children, returns std::nullopt.
+        virtual std::optional<Int> SelectToExpand() {
+            Int size = nodes_[path_.back()].num_child_states;
+            if (size == 0)
+                return std::nullopt;
+            return { rand_.Uniform(Int(0), size - 1) };
+        }
+
+        // Selects a child state randomly from the current state. This method is used during the simulation phase.
+        //
+        // Returns:
+        //   std::optional<Int>: The index of the randomly selected child state. If there is no legal child state available,
+        //                       returns std::nullopt.
+        virtual std::optional<Int> SelectRandom() {
+            Int num_children = NumChildStates();
+            if (num_children <= 0)
+                return std::nullopt;
+            return { rand_.Uniform(Int(0), num_children - 1) };
+        }
+
+        // Returns the visit count of a child of a node, or 0 if the child is not expanded.
+        Int ChildNumVisits(Int node_i, Int child_i) const {
+            return std::max<Int>(visits_[nodes_[node_i].block + child_i], 0);
+        }
+
+        // Returns the index of a child of a node, or kIntNull if the child is not expanded.
+        Int ChildNode(Int node_i, Int child_i) const {
+            return child_nodes_[nodes_[node_i].block + child_i];
+        }
+
+        const Node& root() const {
+            return nodes_.front();
+        }
+
+        const std::vector<Node>& nodes() const {
+            return nodes_;
+        }
+
+        const std::vector<Int>& path() const {
+            return path_;
+        }
+
+        double coef() const {
+            return coef_;
+        }
+
+        void set_coef(double coef) {
+            coef_ = coef;
+        }
+
+    protected:
+        double coef_;
+        Int num_iters_ = 0;
+        Int max_num_iters_ = 0;
+        std::vector<Node> nodes_;
+        std::vector<double> visits_;
+        std::vector<double> reward_sums_;
+        std::vector<double> priors_;
+        std::vector<Int> child_nodes_;
+        std::vector<double> scores_;
+        std::vector<Int> path_;
+        Random rand_;
+    };
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "flat_mcts.h"
+
+namespace rlop {
+    class FlatPUCT : public FlatMCTS {
+    public:
+        FlatPUCT(double coef = std::sqrt(2)) : FlatMCTS(coef) {} 
+
+        virtual ~FlatPUCT() = default;
+
+        // Pure virtual function to return the probability of selecting the child at index `child_i`  
+        // according to some policy, typically provided by a neural network or other predictive model.
+        // It is called once per child, when the child block of the current node is allocated.
+        //
+        // Parameters:
+        //   child_i: The index of the child node for which the selection probability is requested.
+        //
+        // Returns:
+        //   double: The probability of selecting the child node at index `child_i`.
+        virtual double GetProb(Int child_i) = 0;
+
+        virtual void AllocateBlock(Int node_i, Int num_child_states) override {
+            FlatMCTS::AllocateBlock(node_i, num_child_states);
+            for (Int i=0; i<nodes_[node_i].num_child_states; ++i)
+                priors_[nodes_[node_i].block + i] = GetProb(i);
+        }
+
+        // Computes the PUCT scores of all children of the current node into `scores_`.
+        virtual void ComputeScores() override {
+            const Node& node = nodes_[path_.back()];
+            const double* visits = visits_.data() + node.block;
+            const double* reward_sums = reward_sums_.data() + node.block;
+            const double* priors = priors_.data() + node.block;
+            double* scores = scores_.data();
+            Int size = node.num_child_states;
+            double c = coef_ * std::sqrt((double)node.num_visits);
+            constexpr double kLowest = std::numeric_limits<double>::lowest();
+            #pragma omp simd
+            for (Int i=0; i<size; ++i) {
+                double n = std::max(visits[i], 0.0);
+                double q = n > 0 ? reward_sums[i] / n : 0;
+                scores[i] = visits[i] < 0 ? kLowest : q + c * priors[i] / (1.0 + n);
+            }
+        }
+    };
+}
@@ -2,6 +2,11 @@
 #include "rlop/common/base_algorithm.h"
 #include "rlop/common/utils.h"
 #include "rlop/common/random.h"
+#include "rlop/common/profiler.h"
+#include "rlop/common/thread_pool.h"
+#include "rlop/common/timer.h"
+#include "node_pool.h"
+#include "mcts_statistics.h"
 
 namespace rlop {
     // Implements the Monte Carlo Tree Search (MCTS) algorithm for decision making in domains
@@ -12,7 +17,19 @@ namespace rlop {
             double mean_reward = 0;
             Int num_visits = 0;
             Int num_children = 0; // The number of children nodes expanded.
+            bool proven = false; // Whether the game-theoretic value of the node is known.
+            double proven_value = 0; // The game-theoretic value, seen by the player choosing the node.
             std::vector<Node*> children;
+
+            // Resets the statistics and the children of the node, keeping the capacity of the child array.
+            void Clear() {
+                mean_reward = 0;
+                num_visits = 0;
+                num_children = 0;
+                proven = false;
+                proven_value = 0;
+                children.clear();
+            }
         };
         
         // Constructs an MCTS with a exploration coefficient.
@@ -44,17 +61,79 @@ namespace rlop {
         // Pure virtual function to return the reward of the current state. 
         virtual double Reward() = 0;
 
-        // Resets the algorithm.
+        // Returns the game-theoretic value of the current state if it is terminal, seen by the player who made the last
+        // step, or std::nullopt otherwise. It is only used by the solver. An illegal step can be reported as
+        // std::numeric_limits<double>::lowest() so that the solver ignores it.
+        virtual std::optional<double> TerminalValue() {
+            return std::nullopt;
+        }
+
+        // Returns an estimate of the reward of the current state, in the convention of Reward(), such as a heuristic
+        // or the prediction of a value network, or std::nullopt without an evaluator. It scores the rollouts cut at
+        // the rollout depth, and the leaves of the tree for a positive leaf value weight.
+        virtual std::optional<double> EvaluateLeaf() {
+            return std::nullopt;
+        }
+
+        // Copies the current state, a leaf of the tree, into the states of the first `num_rollouts` leaf rollouts.
+        // It is required by the leaf-parallel mode, see set_leaf_parallelism().
+        virtual void CloneLeaf(Int num_rollouts) {
+            throw std::runtime_error("MCTS: leaf parallelism requires CloneLeaf() and LeafRollout().");
+        }
+
+        // Plays a random rollout from the copy `rollout_i` of the leaf made by CloneLeaf(), to the end of the episode
+        // or the rollout depth, and returns its reward in the convention of Reward(). It is called concurrently for
+        // different copies, each with a generator of its own.
+        //
+        // Parameters:
+        //   rollout_i: The index of the copy.
+        //   rand: The generator of the rollout.
+        virtual double LeafRollout(Int rollout_i, Random* rand) {
+            throw std::runtime_error("MCTS: leaf parallelism requires CloneLeaf() and LeafRollout().");
+        }
+
+        // Resets the algorithm. The previous tree is released in O(1) by rewinding the node pool.
         virtual void Reset() override {
-            if (!path_.empty()) {
-                Release(path_[0]);
-                delete path_[0];
+            ReleaseTree();
+            path_.clear();
+            path_.push_back(NewNode());
+        }
+
+        // Promotes a child of the root to be the new root, so that the statistics gathered under it are reused by the
+        // next search. Only the sibling subtrees are released. If the child has not been expanded, the tree is reset.
+        //
+        // Parameters:
+        //   child_i: The index of the child that was played.
+        //
+        // Returns:
+        //   bool: Returns true if the subtree was reused.
+        virtual bool AdvanceRoot(Int child_i) {
+            if (path_.empty()) {
+                Reset();
+                return false;
+            }
+            Node* root = path_.front();
+            Node* child = (child_i >= 0 && child_i < root->children.size()) ? root->children[child_i] : nullptr;
+            if (child == nullptr) {
+                Reset();
+                return false;
             }
-            path_ = { NewNode() };
+            for (Int i=0; i<root->children.size(); ++i) {
+                if (i != child_i && root->children[i] != nullptr) {
+                    Release(root->children[i]);
+                    DeleteNode(root->children[i]);
+                }
+            }
+            root->children.clear();
+            DeleteNode(root);
+            path_.clear();
+            path_.push_back(child);
+            return true;
         }
 
         virtual void SetSeed(uint64_t seed) {
             rand_.Seed(seed);
+            ResetLeafRands();
         }
 
         // Performs the MCTS search over a maximum number of iterations.
@@ -62,26 +141,122 @@ namespace rlop {
         // Parameters:
         //   max_num_iters: The maximum number of iterations.
         virtual void Search(Int max_num_iters) {
+            RLOP_PROFILE_SCOPE("MCTS::Search");
             num_iters_ = 0;
             max_num_iters_ = max_num_iters;
+            root_candidates_.clear();
+            if (statistics_enabled_) {
+                SearchWithStatistics();
+                return;
+            }
             while (Proceed()) {
                 RevertState();
                 if (Select() && Expand())
                     Simulate();
+                else if (solver_)
+                    Solve();
+                BackPropagate();
+                Update();
+            }
+        }
+
+        // Runs the same loop as Search() while timing each phase into the statistics. This is only used when the
+        // statistics are enabled, so the plain loop pays a single branch per search.
+        virtual void SearchWithStatistics() {
+            auto search_start = std::chrono::steady_clock::now();
+            auto start = search_start;
+            while (Proceed()) {
+                RevertState();
+                rollout_length_ = 0;
+                start = std::chrono::steady_clock::now();
+                bool selected = Select();
+                statistics_.select_time += MCTSStatistics::Lap(start);
+                bool expanded = selected && Expand();
+                statistics_.expand_time += MCTSStatistics::Lap(start);
+                if (expanded)
+                    Simulate();
+                else if (solver_)
+                    Solve();
+                statistics_.simulate_time += MCTSStatistics::Lap(start);
+                Int depth = path_.size() - 1;
                 BackPropagate();
                 Update();
+                statistics_.backpropagate_time += MCTSStatistics::Lap(start);
+                statistics_.AddIteration(depth, rollout_length_);
             }
+            statistics_.search_time += MCTSStatistics::Lap(search_start);
+            ++statistics_.num_searches;
+            statistics_.num_nodes = node_pool_.size();
+        }
+
+        // Performs the MCTS search until a wall-clock deadline or a maximum number of iterations is reached.
+        //
+        // Parameters:
+        //   max_duration: The maximum duration of the search in milliseconds.
+        //   max_num_iters: The maximum number of iterations.
+        virtual void SearchFor(Int max_duration, Int max_num_iters = kIntFull) {
+            max_duration_ = max_duration;
+            timer_.Restart();
+            Search(max_num_iters);
+            timer_.Stop();
+            max_duration_ = kIntFull;
         }
 
         // Checks if the search should continue.
         virtual bool Proceed() {
-            return num_iters_ < max_num_iters_; 
+            if (num_iters_ >= max_num_iters_)
+                return false;
+            if (max_duration_ != kIntFull && timer_.Elapsed() >= max_duration_)
+                return false;
+            if (solver_ && !path_.empty() && path_.front()->proven)
+                return false;
+            return !early_stopping_ || !IsDecided();
+        }
+
+        // Checks whether the most visited child of the root can still be overtaken by the second most visited one
+        // within the remaining budget. With a time budget, the remaining number of iterations is extrapolated from
+        // the iteration rate so far.
+        //
+        // Returns:
+        //   bool: Returns true if the most visited child of the root can no longer change.
+        virtual bool IsDecided() const {
+            if (path_.empty() || path_.front()->children.size() < 2)
+                return false;
+            Int num_remaining_iters = max_num_iters_ - num_iters_;
+            if (max_duration_ != kIntFull) {
+                Int elapsed = timer_.Elapsed();
+                if (elapsed <= 0)
+                    return false;
+                double rate = num_iters_ / (double)elapsed;
+                num_remaining_iters = std::min<Int>(num_remaining_iters, std::ceil(rate * (max_duration_ - elapsed)));
+            }
+            Int best = 0;
+            Int second = 0;
+            for (const Node* child : path_.front()->children) {
+                Int num_visits = child == nullptr ? 0 : child->num_visits;
+                if (num_visits > best) {
+                    second = best;
+                    best = num_visits;
+                }
+                else if (num_visits > second) {
+                    second = num_visits;
+                }
+            }
+            return best - second > num_remaining_iters;
         }
 
         // Selects the next node to explore in the tree based on the tree policy.
         virtual bool Select() {
             if (path_.empty())
                 return true;
+            if (sequential_halving_ && path_.size() == 1) {
+                auto child_i = SelectBySequentialHalving();
+                if (child_i) {
+                    path_.push_back(path_.back()->children[*child_i]);
+                    if (!Step(*child_i))
+                        return false;
+                }
+            }
             while (IsExpanded(*path_.back())) {
                 auto child_i = SelectByTreePolicy();
                 if (!child_i)
@@ -96,13 +271,15 @@ namespace rlop {
         // Expands the current node by adding a new child node to the tree.
         virtual bool Expand() {
             if (path_.back()->children.empty())
-                path_.back()->children = std::vector<Node*>(NumChildStates());
+                path_.back()->children.assign(NumChildStates(), nullptr);
             if (path_.back()->children.empty())
                 return false;
             auto child_i = SelectToExpand();
             if (!child_i)
                 return false;
             if (path_.back()->children[*child_i] == nullptr) {
+                if (AtNodeBudget())
+                    return true;
                 path_.back()->children[*child_i] = NewNode();
                 ++path_.back()->num_children;
             }
@@ -110,48 +287,234 @@ namespace rlop {
             return Step(*child_i);
         }
 
-        // Simulates the outcome from the current state to the end of the episode.
+        // Simulates the outcome from the current state by random steps, to the end of the episode or the rollout
+        // depth. A rollout cut before the end is scored by EvaluateLeaf(), or by Reward() without an evaluator. With
+        // a leaf value weight λ, the outcome z is mixed with the value v of the leaf as (1 - λ) z + λ v, and a weight
+        // of 1 skips the rollout.
         virtual bool Simulate() {
-            while (true) {
-                auto i = SelectRandom(); 
-                if (!i || !Step(*i))
-                    return false;
+            std::optional<double> leaf_value;
+            if (leaf_value_weight_ > 0)
+                leaf_value = EvaluateLeaf();
+            double outcome = 0;
+            if ((!leaf_value || leaf_value_weight_ < 1) && num_leaf_rollouts_ > 1) {
+                outcome = SimulateLeafParallel();
+            }
+            else if (!leaf_value || leaf_value_weight_ < 1) {
+                Int depth = 0;
+                bool ended = false;
+                while (depth < rollout_depth_) {
+                    auto i = SelectRandom(); 
+                    if (!i || !Step(*i)) {
+                        ended = true;
+                        break;
+                    }
+                    ++depth;
+                    ++rollout_length_;
+                }
+                std::optional<double> value = ended ? std::nullopt : EvaluateLeaf();
+                outcome = value ? *value : Reward();
             }
+            simulated_reward_ = leaf_value ? (1 - leaf_value_weight_) * outcome + leaf_value_weight_ * *leaf_value : outcome;
+            return false;
+        }
+
+        // Plays the leaf rollouts from copies of the leaf in parallel on the thread pool, and returns their mean
+        // reward, which is backpropagated with a weight of their number.
+        virtual double SimulateLeafParallel() {
+            Int num_rollouts = num_leaf_rollouts_;
+            CloneLeaf(num_rollouts);
+            leaf_rewards_.resize(num_rollouts);
+            thread_pool_->ParallelFor(0, num_rollouts, [&](Int i) {
+                leaf_rewards_[i] = LeafRollout(i, &leaf_rands_[i]);
+            });
+            simulated_weight_ = num_rollouts;
+            return std::accumulate(leaf_rewards_.begin(), leaf_rewards_.end(), 0.0) / num_rollouts;
         }
 
         // Backpropagates the simulation results through the path in the tree.
         virtual void BackPropagate() {
-            double reward = Reward();
+            double reward = simulated_reward_ ? *simulated_reward_ : Reward();
+            Int weight = simulated_weight_;
+            simulated_reward_ = std::nullopt;
+            simulated_weight_ = 1;
             while (path_.size() > 1) {
-                UpdateNode(reward);
+                UpdateNode(reward, weight);
                 path_.pop_back();
             }
-            UpdateNode(reward);
+            UpdateNode(reward, weight);
         }
 
         virtual void Update() {
             ++num_iters_;
+            if (budget_policy_ == NodeBudgetPolicy::kPrune && AtNodeBudget()) {
+                Int num_nodes = std::min<Int>(max_num_nodes_, node_pool_.size());
+                Prune(num_nodes - num_nodes * prune_ratio_);
+            }
+        }
+
+        // Whether the tree has reached its node budget, or the node pools their memory budget in the MemoryTracker.
+        virtual bool AtNodeBudget() const {
+            return node_pool_.size() >= max_num_nodes_ || node_pool_.AtMemoryBudget();
+        }
+
+        // Marks the last node of the path as proven if its state is terminal, and propagates the proof towards the
+        // root. This is called when an iteration stops in the tree instead of simulating.
+        virtual void Solve() {
+            auto value = TerminalValue();
+            if (!value)
+                return;
+            path_.back()->proven = true;
+            path_.back()->proven_value = *value;
+            for (Int i=path_.size()-2; i>=0; --i) {
+                if (!UpdateProven(path_[i]))
+                    break;
+            }
+        }
+
+        // Proves a node if one of its children is a proven win for the player choosing among them, or if all of its
+        // children are proven.
+        //
+        // Parameters:
+        //   node: The node to prove.
+        //
+        // Returns:
+        //   bool: Returns true if the node is proven.
+        virtual bool UpdateProven(Node* node) const {
+            if (node->proven)
+                return true;
+            if (node->children.empty())
+                return false;
+            bool all_proven = true;
+            double best = std::numeric_limits<double>::lowest();
+            for (const Node* child : node->children) {
+                if (child == nullptr || !child->proven)
+                    all_proven = false;
+                else
+                    best = std::max(best, child->proven_value);
+            }
+            if (best < solver_win_value_ && !all_proven)
+                return false;
+            node->proven = true;
+            node->proven_value = negamax_ ? -best : best;
+            return true;
+        }
+
+        // Limits the number of nodes of the tree. Once the budget is reached, the tree is either pruned or frozen
+        // depending on the budget policy, and iterations reaching a missing child simulate from its parent.
+        //
+        // Parameters:
+        //   max_num_nodes: The maximum number of nodes.
+        //   policy: What to do once the budget is reached.
+        //   prune_ratio: The fraction of the budget released by each pruning.
+        virtual void SetNodeBudget(Int max_num_nodes, NodeBudgetPolicy policy = NodeBudgetPolicy::kPrune, double prune_ratio = 0.25) {
+            max_num_nodes_ = std::max<Int>(max_num_nodes, 1);
+            budget_policy_ = policy;
+            prune_ratio_ = prune_ratio;
+        }
+
+        // Limits the memory of the tree, assuming each node holds `num_child_states` child pointers. The available
+        // memory of the host can be queried with GetAvailableMemorySize() from platform.h.
+        //
+        // Parameters:
+        //   max_num_bytes: The maximum number of bytes.
+        //   num_child_states: The typical number of children of a node.
+        //   policy: What to do once the budget is reached.
+        //   prune_ratio: The fraction of the budget released by each pruning.
+        virtual void SetMemoryBudget(Int max_num_bytes, Int num_child_states, NodeBudgetPolicy policy = NodeBudgetPolicy::kPrune, double prune_ratio = 0.25) {
+            SetNodeBudget(max_num_bytes / (sizeof(Node) + num_child_states * sizeof(Node*)), policy, prune_ratio);
+        }
+
+        // Releases the least visited subtrees until at most `max_num_nodes` nodes remain. Since a child is never
+        // visited more often than its parent, releasing every node whose visit count is below a threshold releases
+        // whole subtrees. The nodes visited exactly as often as the threshold are then released only until the budget
+        // is met, so that ties at the threshold release at most one subtree more than needed. The root and its
+        // children are always kept.
+        //
+        // Parameters:
+        //   max_num_nodes: The number of nodes to keep.
+        virtual void Prune(Int max_num_nodes) {
+            Int num_to_release = node_pool_.size() - std::max<Int>(max_num_nodes, 1);
+            if (num_to_release <= 0 || path_.empty())
+                return;
+            std::vector<Int> visits;
+            std::vector<Node*> stack;
+            for (Node* child : path_.front()->children) {
+                if (child != nullptr)
+                    stack.push_back(child);
+            }
+            std::vector<Node*> children = stack;
+            while (!stack.empty()) {
+                Node* node = stack.back();
+                stack.pop_back();
+                for (Node* child : node->children) {
+                    if (child != nullptr) {
+                        visits.push_back(child->num_visits);
+                        stack.push_back(child);
+                    }
+                }
+            }
+            if (visits.empty())
+                return;
+            num_to_release = std::min<Int>(num_to_release, visits.size());
+            std::nth_element(visits.begin(), visits.begin() + num_to_release - 1, visits.end());
+            Int threshold = visits[num_to_release - 1];
+            Int num_nodes = node_pool_.size() - num_to_release;
+            // The first pass releases the nodes below the threshold, the second one those at the threshold, whose
+            // descendants are then all at the threshold too, until the budget is met.
+            for (bool at_threshold : { false, true }) {
+                stack = children;
+                while (!stack.empty() && node_pool_.size() > num_nodes) {
+                    Node* node = stack.back();
+                    stack.pop_back();
+                    for (Node*& child : node->children) {
+                        if (child == nullptr)
+                            continue;
+                        if (child->num_visits < threshold || (at_threshold && child->num_visits == threshold && node_pool_.size() > num_nodes)) {
+                            Release(child);
+                            DeleteNode(child);
+                            child = nullptr;
+                            --node->num_children;
+                        }
+                        else {
+                            stack.push_back(child);
+                        }
+                    }
+                }
+            }
         }
 
+        // Releases the descendants of a node, returning them to the node pool.
         virtual void Release(Node* node) {
             if (node == nullptr) 
                 return;
             for (Int i=0; i<node->children.size(); ++i) {
                 Node* child = node->children[i];
                 Release(child);
-                delete child;
+                DeleteNode(child);
             }
             node->children.clear();
+            node->num_children = 0;
         }
 
-        virtual Node* NewNode() const {
-            return new Node();
+        // Releases the whole tree. Together with NewNode() and DeleteNode(), this can be overridden to plug in
+        // another allocation scheme.
+        virtual void ReleaseTree() {
+            node_pool_.Reset();
         }
 
-        virtual void UpdateNode(double reward) const {
+        virtual Node* NewNode() {
+            return node_pool_.New();
+        }
+
+        virtual void DeleteNode(Node* node) {
+            node_pool_.Delete(node);
+        }
+
+        // Updates the last node of the path with a reward, the mean of `num_visits` simulations.
+        virtual void UpdateNode(double reward, Int num_visits = 1) const {
             Node* node = path_.back();
-            node->mean_reward = (node->num_visits * node->mean_reward + reward) / (node->num_visits + 1.0);
-            node->num_visits += 1;
+            node->mean_reward = (node->num_visits * node->mean_reward + num_visits * reward) / (node->num_visits + num_visits);
+            node->num_visits += num_visits;
         }
 
         // Computes the value of a child node using the UCB1 formula.
@@ -179,6 +542,8 @@ namespace rlop {
             Int best = kIntNull;
             double best_score = std::numeric_limits<double>::lowest();
             for (Int i=0; i<path_.back()->children.size(); ++i) {
+                if (solver_ && path_.back()->children[i] != nullptr && path_.back()->children[i]->proven)
+                    continue;
                 double score = TreePolicy(i);
                 if (score > best_score) {
                     best = i;
@@ -190,6 +555,117 @@ namespace rlop {
             return { best };
         }
 
+        // Selects the child of the root to search with sequential halving. The candidates are visited in a round robin
+        // and, once each of them has received its share of the phase, the worse half by RootScore() is discarded. Each
+        // phase gets an equal part of the remaining iterations, so the budget given to Search() must be finite. The
+        // candidates are chosen when the first iteration of a search reaches the root.
+        //
+        // Returns:
+        //   std::optional<Int>: The index of the child of the root to search. If the root has no legal children, 
+        //                       returns std::nullopt.
+        virtual std::optional<Int> SelectBySequentialHalving() {
+            Node* root = path_.front();
+            if (root_candidates_.empty()) {
+                if (root->children.empty())
+                    root->children.assign(NumChildStates(), nullptr);
+                if (root->children.empty())
+                    return std::nullopt;
+                InitRootCandidates();
+                if (root_candidates_.empty())
+                    return std::nullopt;
+                PlanRootPhase();
+            }
+            Int k = std::min_element(root_phase_visits_.begin(), root_phase_visits_.end()) - root_phase_visits_.begin();
+            if (root_phase_visits_[k] >= root_visits_per_candidate_ && root_candidates_.size() > 1) {
+                HalveRootCandidates();
+                k = 0;
+            }
+            ++root_phase_visits_[k];
+            Int child_i = root_candidates_[k];
+            if (root->children[child_i] == nullptr) {
+                root->children[child_i] = NewNode();
+                ++root->num_children;
+            }
+            return { child_i };
+        }
+
+        // Chooses the candidates of sequential halving among the children of the root. By default, all children are
+        // candidates, or a random subset of them if there are more than the maximum number of candidates.
+        virtual void InitRootCandidates() {
+            root_candidates_.resize(path_.front()->children.size());
+            std::iota(root_candidates_.begin(), root_candidates_.end(), 0);
+            if (root_candidates_.size() > max_num_root_candidates_) {
+                rand_.PartialShuffle(root_candidates_.begin(), root_candidates_.end(), max_num_root_candidates_);
+                root_candidates_.resize(max_num_root_candidates_);
+            }
+        }
+
+        // Computes the score used by sequential halving to rank the children of the root.
+        //
+        // Parameters:
+        //   child_i: The index of the child of the root.
+        //
+        // Return:
+        //   double: the score of the child, the higher the better.
+        virtual double RootScore(Int child_i) {
+            const Node* child = path_.front()->children[child_i];
+            if (child == nullptr || child->num_visits == 0)
+                return std::numeric_limits<double>::lowest();
+            return child->mean_reward;
+        }
+
+        // Keeps the better half of the candidates of sequential halving and starts the next phase.
+        virtual void HalveRootCandidates() {
+            std::vector<double> scores(path_.front()->children.size());
+            for (Int child_i : root_candidates_)
+                scores[child_i] = RootScore(child_i);
+            std::stable_sort(root_candidates_.begin(), root_candidates_.end(), [&](Int a, Int b) { return scores[a] > scores[b]; });
+            root_candidates_.resize((root_candidates_.size() + 1) / 2);
+            PlanRootPhase();
+        }
+
+        // Splits the remaining iterations evenly over the remaining phases and the candidates of the current phase.
+        virtual void PlanRootPhase() {
+            Int num_candidates = root_candidates_.size();
+            Int num_phases = std::max<Int>(std::ceil(std::log2(num_candidates)), 1);
+            Int num_remaining_iters = max_num_iters_ - num_iters_;
+            root_visits_per_candidate_ = std::max<Int>(num_remaining_iters / (num_phases * num_candidates), 1);
+            root_phase_visits_.assign(num_candidates, 0);
+        }
+
+        // Returns the child of the root to play. With sequential halving, it is the best remaining candidate,
+        // otherwise the most visited child.
+        //
+        // Returns:
+        //   std::optional<Int>: The index of the child of the root. If the root has no expanded children, returns
+        //                       std::nullopt.
+        virtual std::optional<Int> BestRootChild() {
+            if (path_.empty())
+                return std::nullopt;
+            Int best = kIntNull;
+            double best_score = std::numeric_limits<double>::lowest();
+            const Node* root = path_.front();
+            if (sequential_halving_ && !root_candidates_.empty()) {
+                for (Int child_i : root_candidates_) {
+                    double score = RootScore(child_i);
+                    if (best == kIntNull || score > best_score) {
+                        best = child_i;
+                        best_score = score;
+                    }
+                }
+                return { best };
+            }
+            for (Int i=0; i<root->children.size(); ++i) {
+                if (root->children[i] != nullptr && root->children[i]->num_visits > best_score) {
+                    best = i;
+                    best_score = root->children[i]->num_visits;
+                }
+            }
+            if (best == kIntNull)
+                return std::nullopt;
+            return { best };
+        }
+
         // Selects a child node to expand next from the current node's children. This selection can be random or based on
         // some heuristic.
         // Returns:
@@ -217,6 +693,18 @@ namespace rlop {
             return path_;
         }
 
+        const NodePool<Node>& node_pool() const {
+            return node_pool_;
+        }
+
+        Int max_num_nodes() const {
+            return max_num_nodes_;
+        }
+
+        NodeBudgetPolicy budget_policy() const {
+            return budget_policy_;
+        }
+
         double coef() const {
             return coef_;
         }
@@ -225,11 +713,155 @@ namespace rlop {
             coef_ = coef;
         }
 
+        bool early_stopping() const {
+            return early_stopping_;
+        }
+
+        // Enables stopping the search once the most visited child of the root can no longer be overtaken.
+        void set_early_stopping(bool early_stopping) {
+            early_stopping_ = early_stopping;
+        }
+
+        Int num_iters() const {
+            return num_iters_;
+        }
+
+        bool solver() const {
+            return solver_;
+        }
+
+        // Enables the solver, which propagates the game-theoretic values reported by TerminalValue() and stops
+        // searching proven subtrees.
+        //
+        // Parameters:
+        //   solver: Whether the solver is enabled.
+        //   win_value: The value of a win. A node with a child of this value is proven without its other children.
+        //   negamax: Whether players alternate, in which case the value of a node is the opposite of the value of its
+        //            best child. Otherwise, it is the value of its best child.
+        void set_solver(bool solver, double win_value = 1, bool negamax = true) {
+            solver_ = solver;
+            solver_win_value_ = win_value;
+            negamax_ = negamax;
+        }
+
+        bool statistics_enabled() const {
+            return statistics_enabled_;
+        }
+
+        // Enables collecting the per-phase statistics of the following searches.
+        void set_statistics_enabled(bool statistics_enabled) {
+            statistics_enabled_ = statistics_enabled;
+        }
+
+        bool sequential_halving() const {
+            return sequential_halving_;
+        }
+
+        // Replaces the tree policy at the root by sequential halving, which makes better use of small budgets.
+        void set_sequential_halving(bool sequential_halving) {
+            sequential_halving_ = sequential_halving;
+        }
+
+        Int max_num_root_candidates() const {
+            return max_num_root_candidates_;
+        }
+
+        void set_max_num_root_candidates(Int max_num_root_candidates) {
+            max_num_root_candidates_ = std::max<Int>(max_num_root_candidates, 1);
+        }
+
+        Int rollout_depth() const {
+            return rollout_depth_;
+        }
+
+        // Cuts the rollouts after `rollout_depth` random steps, their outcome being scored by EvaluateLeaf(), so that
+        // an iteration costs O(rollout_depth) instead of O(episode length). 0 leaves the scoring to EvaluateLeaf().
+        void set_rollout_depth(Int rollout_depth) {
+            rollout_depth_ = std::max<Int>(rollout_depth, 0);
+        }
+
+        double leaf_value_weight() const {
+            return leaf_value_weight_;
+        }
+
+        // Sets the weight λ in [0, 1] of the value of the leaves given by EvaluateLeaf() against the outcome of the
+        // rollouts.
+        void set_leaf_value_weight(double leaf_value_weight) {
+            leaf_value_weight_ = std::clamp(leaf_value_weight, 0.0, 1.0);
+        }
+
+        Int num_leaf_rollouts() const {
+            return num_leaf_rollouts_;
+        }
+
+        // Enables the leaf-parallel mode, which uses several cores within one tree: each simulation plays
+        // `num_leaf_rollouts` independent rollouts from copies of the leaf, see CloneLeaf() and LeafRollout(), in
+        // parallel on a thread pool, and backpropagates their mean as that many visits. 1 disables it.
+        //
+        // Parameters:
+        //   num_leaf_rollouts: The number of rollouts per simulation.
+        //   thread_pool: The pool playing the rollouts.
+        void set_leaf_parallelism(Int num_leaf_rollouts, ThreadPool* thread_pool = &ThreadPool::Global()) {
+            num_leaf_rollouts_ = std::max<Int>(num_leaf_rollouts, 1);
+            thread_pool_ = thread_pool;
+            ResetLeafRands();
+        }
+
+        const std::vector<Int>& root_candidates() const {
+            return root_candidates_;
+        }
+
+        const MCTSStatistics& statistics() const {
+            return statistics_;
+        }
+
+        void ClearStatistics() {
+            statistics_.Clear();
+        }
+
     protected:
+        // Derives the generators of the leaf rollouts from rand_.
+        void ResetLeafRands() {
+            leaf_rands_.clear();
+            if (num_leaf_rollouts_ <= 1)
+                return;
+            Random rand = rand_;
+            for (Int i=0; i<num_leaf_rollouts_; ++i) {
+                rand.Jump();
+                leaf_rands_.push_back(rand);
+            }
+        }
+
         double coef_;
         Int num_iters_ = 0;
         Int max_num_iters_ = 0;
+        Int max_duration_ = kIntFull;
+        bool early_stopping_ = false;
+        Timer<> timer_;
         std::vector<Node*> path_;
+        NodePool<Node> node_pool_;
+        Int max_num_nodes_ = kIntFull;
+        NodeBudgetPolicy budget_policy_ = NodeBudgetPolicy::kPrune;
+        double prune_ratio_ = 0.25;
+        bool sequential_halving_ = false;
+        Int max_num_root_candidates_ = 16;
+        Int root_visits_per_candidate_ = 0;
+        std::vector<Int> root_candidates_;
+        std::vector<Int> root_phase_visits_;
+        bool solver_ = false;
+        bool negamax_ = true;
+        double solver_win_value_ = 1;
+        bool statistics_enabled_ = false;
+        Int rollout_length_ = 0;
+        Int rollout_depth_ = kIntFull;
+        double leaf_value_weight_ = 0;
+        std::optional<double> simulated_reward_; // The reward of the simulation of the iteration, if it made one.
+        Int simulated_weight_ = 1; // The number of visits the reward of the simulation stands for.
+        Int num_leaf_rollouts_ = 1;
+        ThreadPool* thread_pool_ = &ThreadPool::Global();
+        std::vector<Random> leaf_rands_; // The generators of the leaf rollouts, jumped apart from rand_.
+        std::vector<double> leaf_rewards_;
+        MCTSStatistics statistics_;
         Random rand_;
     };
 }
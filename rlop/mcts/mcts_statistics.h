@@ -0,0 +1,87 @@
+#pragma once
+#include <chrono>
+#include "rlop/common/typedef.h"
+
+namespace rlop {
+    // Statistics gathered by the MCTS classes when statistics collection is enabled. Times are cumulative over the
+    // searches since the last Clear(), in nanoseconds.
+    struct MCTSStatistics {
+        Int num_iters = 0;
+        Int num_searches = 0;
+        Int search_time = 0;
+        Int select_time = 0;
+        Int expand_time = 0;
+        Int simulate_time = 0;
+        Int backpropagate_time = 0;
+        Int sum_depth = 0;
+        Int max_depth = 0;
+        Int sum_rollout_length = 0;
+        Int max_rollout_length = 0;
+        Int num_nodes = 0; // The size of the tree at the end of the last search.
+
+        void Clear() {
+            *this = MCTSStatistics();
+        }
+
+        // Accumulates the statistics of another search, typically of another environment.
+        void Merge(const MCTSStatistics& other) {
+            num_iters += other.num_iters;
+            num_searches += other.num_searches;
+            search_time = std::max(search_time, other.search_time);
+            select_time += other.select_time;
+            expand_time += other.expand_time;
+            simulate_time += other.simulate_time;
+            backpropagate_time += other.backpropagate_time;
+            sum_depth += other.sum_depth;
+            max_depth = std::max(max_depth, other.max_depth);
+            sum_rollout_length += other.sum_rollout_length;
+            max_rollout_length = std::max(max_rollout_length, other.max_rollout_length);
+            num_nodes += other.num_nodes;
+        }
+
+        // Records one iteration.
+        //
+        // Parameters:
+        //   depth: The depth of the leaf reached by the selection and the expansion.
+        //   rollout_length: The number of steps of the simulation.
+        void AddIteration(Int depth, Int rollout_length) {
+            ++num_iters;
+            sum_depth += depth;
+            max_depth = std::max(max_depth, depth);
+            sum_rollout_length += rollout_length;
+            max_rollout_length = std::max(max_rollout_length, rollout_length);
+        }
+
+        double IterationsPerSecond() const {
+            return search_time == 0 ? 0 : num_iters * 1e9 / search_time;
+        }
+
+        double MeanDepth() const {
+            return num_iters == 0 ? 0 : sum_depth / (double)num_iters;
+        }
+
+        double MeanRolloutLength() const {
+            return num_iters == 0 ? 0 : sum_rollout_length / (double)num_iters;
+        }
+
+        std::string ToString() const {
+            std::stringstream ss;
+            auto ms = [](Int ns) { return ns / 1e6; };
+            ss << "iterations: " << num_iters << "\t" << "iterations/s: " << IterationsPerSecond() << "\t"
+               << "search(ms): " << ms(search_time) << "\t" << "select(ms): " << ms(select_time) << "\t"
+               << "expand(ms): " << ms(expand_time) << "\t" << "simulate(ms): " << ms(simulate_time) << "\t"
+               << "backpropagate(ms): " << ms(backpropagate_time) << "\t" << "mean depth: " << MeanDepth() << "\t"
+               << "max depth: " << max_depth << "\t" << "mean rollout: " << MeanRolloutLength() << "\t"
+               << "max rollout: " << max_rollout_length << "\t" << "nodes: " << num_nodes;
+            return ss.str();
+        }
+
+        // Returns the nanoseconds elapsed since `start` and moves `start` to the current time.
+        static Int Lap(std::chrono::steady_clock::time_point& start) {
+            auto now = std::chrono::steady_clock::now();
+            Int elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count();
+            start = now;
+            return elapsed;
+        }
+    };
+}
@@ -0,0 +1,117 @@
+#pragma once
+#include "rlop/common/typedef.h"
+#include "rlop/common/memory_tracker.h"
+
+namespace rlop {
+    // What a search does once its tree reaches the node budget.
+    enum class NodeBudgetPolicy {
+        kPrune, // Releases the least visited subtrees and recycles their nodes.
+        kStopExpanding // Keeps the tree as it is and simulates from its leaves.
+    };
+
+    // A slab allocator for search tree nodes. Nodes are carved out of fixed size slabs which are kept alive for the
+    // lifetime of the pool, so a whole tree can be released in O(1) by rewinding the pool instead of freeing the nodes
+    // one by one. Single nodes can still be returned with Delete() and are recycled by later calls to New(). Recycled
+    // nodes keep the capacity of their child arrays, so a warm pool performs no heap allocation at all.
+    //
+    // The slabs are accounted under the tag "mcts_tree" of the MemoryTracker, and a search whose pool is at the budget
+    // of the tag, see AtMemoryBudget(), applies its node budget policy.
+    //
+    // TNode must be default constructible and provide a Clear() method which resets the node to its initial state.
+    template<typename TNode>
+    class NodePool {
+    public:
+        // Constructs a node pool.
+        //
+        // Parameters:
+        //   slab_size: The number of nodes allocated at once when the pool runs out of nodes.
+        NodePool(Int slab_size = 4096) : slab_size_(slab_size), memory_usage_(kMemoryTag) {}
+
+        NodePool(NodePool&&) = default;
+
+        NodePool& operator=(NodePool&&) = default;
+
+        // Returns a cleared node, either recycled or taken from the current slab.
+        TNode* New() {
+            TNode* node;
+            if (!free_nodes_.empty()) {
+                node = free_nodes_.back();
+                free_nodes_.pop_back();
+            }
+            else {
+                if (slab_i_ == slabs_.size()) {
+                    slabs_.push_back(std::make_unique<TNode[]>(slab_size_));
+                    memory_usage_.Set(capacity() * sizeof(TNode));
+                }
+                node = &slabs_[slab_i_][node_i_];
+                if (++node_i_ == slab_size_) {
+                    ++slab_i_;
+                    node_i_ = 0;
+                }
+            }
+            node->Clear();
+            ++num_nodes_;
+            return node;
+        }
+
+        // Returns a node to the pool. The node must have been obtained from this pool since the last Reset().
+        void Delete(TNode* node) {
+            if (node == nullptr)
+                return;
+            free_nodes_.push_back(node);
+            --num_nodes_;
+        }
+
+        // Releases all nodes at once. The slabs are kept and reused by subsequent allocations.
+        void Reset() {
+            slab_i_ = 0;
+            node_i_ = 0;
+            num_nodes_ = 0;
+            free_nodes_.clear();
+        }
+
+        // Releases all nodes and frees the memory held by the slabs.
+        void Clear() {
+            Reset();
+            slabs_.clear();
+            slabs_.shrink_to_fit();
+            free_nodes_.shrink_to_fit();
+            memory_usage_.Set(0);
+        }
+
+        // Whether the next New() needs a slab which would exceed the memory budget of the pools.
+        bool AtMemoryBudget() const {
+            return free_nodes_.empty() && slab_i_ == slabs_.size() && memory_usage_.OverBudget(slab_size_ * sizeof(TNode));
+        }
+
+        // Returns the number of nodes currently in use.
+        Int size() const {
+            return num_nodes_;
+        }
+
+        // Returns the number of nodes the allocated slabs can hold.
+        Int capacity() const {
+            return slabs_.size() * slab_size_;
+        }
+
+        Int slab_size() const {
+            return slab_size_;
+        }
+
+        // The share of the pool in the memory accounting, which can be moved to another tag.
+        MemoryUsage& memory_usage() {
+            return memory_usage_;
+        }
+
+        static constexpr const char* kMemoryTag = "mcts_tree";
+
+    protected:
+        Int slab_size_;
+        Int slab_i_ = 0;
+        Int node_i_ = 0;
+        Int num_nodes_ = 0;
+        std::vector<std::unique_ptr<TNode[]>> slabs_;
+        std::vector<TNode*> free_nodes_;
+        MemoryUsage memory_usage_;
+    };
+}
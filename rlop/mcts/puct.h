@@ -24,5 +24,48 @@ namespace rlop {
             return path_.back()->children[child_i]->mean_reward + 
                 this->coef_ * GetProb(child_i) * std::sqrt((double)path_.back()->children[child_i]->num_visits) / (1.0 + path_.back()->num_visits);
         }
+
+        // Chooses the candidates of sequential halving as in Gumbel MuZero: the children with the highest sum of their
+        // log prior and a Gumbel noise, which samples them without replacement from the prior.
+        virtual void InitRootCandidates() override {
+            Int num_children = path_.front()->children.size();
+            root_logits_.resize(num_children);
+            for (Int i=0; i<num_children; ++i) {
+                double u = std::max(rand_.Uniform(0.0, 1.0), 1e-12);
+                root_logits_[i] = std::log(std::max(GetProb(i), 1e-12)) - std::log(-std::log(u));
+            }
+            root_candidates_.resize(num_children);
+            std::iota(root_candidates_.begin(), root_candidates_.end(), 0);
+            Int num_candidates = std::min<Int>(num_children, max_num_root_candidates_);
+            std::partial_sort(root_candidates_.begin(), root_candidates_.begin() + num_candidates, root_candidates_.end(), 
+                [&](Int a, Int b) { return root_logits_[a] > root_logits_[b]; });
+            root_candidates_.resize(num_candidates);
+        }
+
+        // Ranks the children of the root by their Gumbel logit plus their mean reward scaled by the visit count of the
+        // most visited child, so the prior dominates early and the search results dominate late.
+        virtual double RootScore(Int child_i) override {
+            const Node* root = path_.front();
+            const Node* child = root->children[child_i];
+            double q = (child == nullptr || child->num_visits == 0) ? 0 : child->mean_reward;
+            Int max_num_visits = 0;
+            for (const Node* c : root->children) {
+                if (c != nullptr)
+                    max_num_visits = std::max(max_num_visits, c->num_visits);
+            }
+            return root_logits_[child_i] + (gumbel_visit_coef_ + max_num_visits) * gumbel_scale_ * q;
+        }
+
+        // Sets the coefficients of the transformation of the mean rewards in RootScore(), c_visit and c_scale in
+        // Gumbel MuZero.
+        void set_gumbel_coefs(double visit_coef, double scale) {
+            gumbel_visit_coef_ = visit_coef;
+            gumbel_scale_ = scale;
+        }
+
+    protected:
+        double gumbel_visit_coef_ = 50;
+        double gumbel_scale_ = 1;
+        std::vector<double> root_logits_;
     };
 }
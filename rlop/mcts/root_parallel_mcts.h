@@ -2,6 +2,12 @@
 #include "rlop/common/base_algorithm.h"
 #include "rlop/common/utils.h"
 #include "rlop/common/random.h"
+#include "rlop/common/profiler.h"
+#include "rlop/common/thread_pool.h"
+#include "rlop/common/timer.h"
+#include "node_pool.h"
+#include "mcts_statistics.h"
+#include "root_statistics.h"
 
 namespace rlop {
     // Implements a root parallel version of the Monte Carlo Tree Search (MCTS) algorithm. This class
@@ -13,7 +19,19 @@ namespace rlop {
             double mean_reward = 0;
             Int num_visits = 0;
             Int num_children = 0; // The number of children nodes expanded.
+            bool proven = false; // Whether the game-theoretic value of the node is known.
+            double proven_value = 0; // The game-theoretic value, seen by the player choosing the node.
             std::vector<Node*> children;
+
+            // Resets the statistics and the children of the node, keeping the capacity of the child array.
+            void Clear() {
+                mean_reward = 0;
+                num_visits = 0;
+                num_children = 0;
+                proven = false;
+                proven_value = 0;
+                children.clear();
+            }
         };
         
         // Constructs a RootParallelMCTS instance with specified parameters.
@@ -23,12 +41,24 @@ namespace rlop {
         //             independent instance of the problem space for parallel exploration.
         //   coef: The exploration coefficient used in the UCB1 formula, Default is sqrt(2).
         RootParallelMCTS(Int num_envs, double coef = std::sqrt(2)) : 
+            coef_(coef),
             num_iters_(num_envs, 0),
             max_num_iters_(num_envs, 0),
+            max_durations_(num_envs, kIntFull),
+            timers_(num_envs),
             paths_(num_envs),
-            rands_(num_envs),
-            coef_(coef) 
-        {}
+            node_pools_(num_envs),
+            rollout_lengths_(num_envs, 0),
+            simulated_rewards_(num_envs),
+            statistics_(num_envs),
+            env_threads_(num_envs)
+        {
+            for (Int i=0; i<num_envs; ++i) {
+                rands_.push_back(i == 0 ? std::make_unique<Random>() : std::make_unique<Random>(*rands_[i - 1]));
+                if (i > 0)
+                    rands_[i]->Jump();
+            }
+        }
 
         virtual ~RootParallelMCTS() = default;
 
@@ -63,34 +93,138 @@ namespace rlop {
         // Pure virtual function to return the reward of the current state for a specified environment.
         virtual double Reward(Int env_i) = 0;
 
-        // Resets the algorithm.
+        // Returns the game-theoretic value of the current state of a specified environment if it is terminal, seen by
+        // the player who made the last step, or std::nullopt otherwise. It is only used by the solver. An illegal step
+        // can be reported as std::numeric_limits<double>::lowest() so that the solver ignores it.
+        //
+        // Parameters:
+        //   env_i: The index of environment.
+        virtual std::optional<double> TerminalValue(Int env_i) {
+            return std::nullopt;
+        }
+
+        // Returns an estimate of the reward of the current state of a specified environment, in the convention of
+        // Reward(), or std::nullopt without an evaluator, as MCTS::EvaluateLeaf().
+        //
+        // Parameters:
+        //   env_i: The index of environment.
+        virtual std::optional<double> EvaluateLeaf(Int env_i) {
+            return std::nullopt;
+        }
+
+        // Resets the algorithm. The previous trees are released in O(1) by rewinding the per-environment node pools.
         virtual void Reset() override {
-            for (Int i=0; i<paths_.size(); ++i) {
-                if (!paths_[i].empty()) {
-                    Release(paths_[i][0]);
-                    delete paths_[i][0];
+            for (Int i=0; i<paths_.size(); ++i)
+                ResetTree(i);
+        }
+
+        // Promotes a child of the root of a specified environment to be the new root, so that the statistics gathered
+        // under it are reused by the next search. Only the sibling subtrees are released. If the child has not been
+        // expanded, the tree is reset.
+        //
+        // Parameters:
+        //   env_i: The index of environment.
+        //   child_i: The index of the child that was played.
+        //
+        // Returns:
+        //   bool: Returns true if the subtree was reused.
+        virtual bool AdvanceRoot(Int env_i, Int child_i) {
+            Node* root = paths_[env_i].empty() ? nullptr : paths_[env_i].front();
+            Node* child = (root != nullptr && child_i >= 0 && child_i < root->children.size()) ? root->children[child_i] : nullptr;
+            if (child == nullptr) {
+                ResetTree(env_i);
+                return false;
+            }
+            for (Int i=0; i<root->children.size(); ++i) {
+                if (i != child_i && root->children[i] != nullptr) {
+                    Release(env_i, root->children[i]);
+                    DeleteNode(env_i, root->children[i]);
                 }
-                paths_[i] = { NewNode() };
             }
+            root->children.clear();
+            DeleteNode(env_i, root);
+            paths_[env_i].clear();
+            paths_[env_i].push_back(child);
+            return true;
         }
 
+        // Replaces the tree of a specified environment by a copy of a subtree, which may belong to the tree of another
+        // environment. This is used when the root of the next search appears deeper in the tree of another environment.
+        //
+        // Parameters:
+        //   env_i: The index of environment.
+        //   node: The root of the subtree to copy. It must not belong to the tree of `env_i`.
+        virtual void CopyTree(Int env_i, const Node* node) {
+            ReleaseTree(env_i);
+            paths_[env_i].clear();
+            paths_[env_i].push_back(node == nullptr ? NewNode(env_i) : CloneNode(env_i, node));
+        }
+
+        // Resets the tree of a specified environment to a single root node.
+        //
+        // Parameters:
+        //   env_i: The index of environment.
+        virtual void ResetTree(Int env_i) {
+            CopyTree(env_i, nullptr);
+        }
+
+        // Seeds the generators of the environments. Those beyond the seeds take the streams jumped from the
+        // generator of the previous environment, so that no two environments draw the same numbers.
         virtual void SetSeeds(const std::vector<uint64_t>& seeds) {
             if (seeds.empty())
                 return;
             for (Int i=0; i<rands_.size(); ++i) {
-                if (i < seeds.size())
-                    rands_[i].Seed(seeds[i]); 
-                else
-                    rands_[i].Seed(seeds.back()); 
+                if (i < seeds.size()) {
+                    rands_[i]->Seed(seeds[i]);
+                } else {
+                    *rands_[i] = *rands_[i - 1];
+                    rands_[i]->Jump();
+                }
             }
         }
 
-        // Starts the asynchronous search across all environments, running each environment's search in parallel.
+        // Calls func(env_i) for every environment in parallel on the shared ThreadPool. With the environment affinity,
+        // every environment runs on the same thread in successive calls, and an environment which runs on a new
+        // thread is first placed on it by PlaceEnv().
+        template<typename TFunc>
+        void ForEachEnv(TFunc&& func) {
+            if (!env_affinity_) {
+                ParallelFor(0, num_envs(), func);
+                return;
+            }
+            ThreadPool::Global().ParallelForPinned(0, num_envs(), [&](Int i) {
+                if (env_threads_[i] != std::this_thread::get_id()) {
+                    PlaceEnv(i);
+                    env_threads_[i] = std::this_thread::get_id();
+                }
+                func(i);
+            });
+        }
+
+        // Reallocates the state of a specified environment from the thread which searches it, so that its memory is
+        // first touched, and with pinned threads allocated, on the NUMA node of that thread. The tree is copied into a
+        // new node pool and the generator to a new allocation. Derived classes with state of their own per
+        // environment should reallocate it too and call this function.
+        //
+        // Parameters:
+        //   env_i: The index of environment.
+        virtual void PlaceEnv(Int env_i) {
+            NodePool<Node> old_pool = std::move(node_pools_[env_i]);
+            node_pools_[env_i] = NodePool<Node>(old_pool.slab_size());
+            std::vector<Node*> path;
+            path.reserve(paths_[env_i].capacity());
+            if (!paths_[env_i].empty())
+                path.push_back(CloneNode(env_i, paths_[env_i].front()));
+            paths_[env_i].swap(path);
+            rands_[env_i] = std::make_unique<Random>(*rands_[env_i]);
+        }
+
+        // Starts the asynchronous search across all environments, running each environment's search in parallel on
+        // the shared ThreadPool, in turn when there are more environments than threads.
         virtual void SearchAsync(Int max_num_iters) {
-            #pragma omp parallel for
-            for (Int i=0; i<num_envs(); ++i) {
+            ForEachEnv([&](Int i) {
                 Search(i, max_num_iters);
-            }
+            });
         }
 
         // Performs the MCTS search over a maximum number of iterations for a specified environment .
@@ -99,20 +233,156 @@ namespace rlop {
         //   env_i: The index of environment.
         //   max_num_iters: The maximum number of iterations.
         virtual void Search(Int env_i, Int max_num_iters) {
+            RLOP_PROFILE_SCOPE("RootParallelMCTS::Search");
             num_iters_[env_i] = 0;
             max_num_iters_[env_i] = max_num_iters;
+            if (statistics_enabled_) {
+                SearchWithStatistics(env_i);
+                return;
+            }
             while (Proceed(env_i)) {
                 RevertState(env_i);
                 if (Select(env_i) && Expand(env_i))
                     Simulate(env_i);
+                else if (solver_)
+                    Solve(env_i);
                 BackPropagate(env_i);
                 Update(env_i);
             }
         }
 
+        // Runs the same loop as Search() for a specified environment while timing each phase into the statistics of
+        // that environment.
+        //
+        // Parameters:
+        //   env_i: The index of environment.
+        virtual void SearchWithStatistics(Int env_i) {
+            MCTSStatistics& statistics = statistics_[env_i];
+            auto search_start = std::chrono::steady_clock::now();
+            auto start = search_start;
+            while (Proceed(env_i)) {
+                RevertState(env_i);
+                rollout_lengths_[env_i] = 0;
+                start = std::chrono::steady_clock::now();
+                bool selected = Select(env_i);
+                statistics.select_time += MCTSStatistics::Lap(start);
+                bool expanded = selected && Expand(env_i);
+                statistics.expand_time += MCTSStatistics::Lap(start);
+                if (expanded)
+                    Simulate(env_i);
+                else if (solver_)
+                    Solve(env_i);
+                statistics.simulate_time += MCTSStatistics::Lap(start);
+                Int depth = paths_[env_i].size() - 1;
+                BackPropagate(env_i);
+                Update(env_i);
+                statistics.backpropagate_time += MCTSStatistics::Lap(start);
+                statistics.AddIteration(depth, rollout_lengths_[env_i]);
+            }
+            statistics.search_time += MCTSStatistics::Lap(search_start);
+            ++statistics.num_searches;
+            statistics.num_nodes = node_pools_[env_i].size();
+        }
+
+        // Starts the asynchronous search across all environments with a wall-clock deadline. The deadline applies to
+        // each environment from its start, so environments run in turn on a smaller pool take longer in total.
+        //
+        // Parameters:
+        //   max_duration: The maximum duration of the search in milliseconds.
+        //   max_num_iters: The maximum number of iterations of each environment.
+        virtual void SearchAsyncFor(Int max_duration, Int max_num_iters = kIntFull) {
+            ForEachEnv([&](Int i) {
+                SearchFor(i, max_duration, max_num_iters);
+            });
+        }
+
+        // Performs the MCTS search for a specified environment until a wall-clock deadline or a maximum number of
+        // iterations is reached.
+        //
+        // Parameters:
+        //   env_i: The index of environment.
+        //   max_duration: The maximum duration of the search in milliseconds.
+        //   max_num_iters: The maximum number of iterations.
+        virtual void SearchFor(Int env_i, Int max_duration, Int max_num_iters = kIntFull) {
+            max_durations_[env_i] = max_duration;
+            timers_[env_i].Restart();
+            Search(env_i, max_num_iters);
+            timers_[env_i].Stop();
+            max_durations_[env_i] = kIntFull;
+        }
+
         // Checks if the search of a specified environment should continue.
         virtual bool Proceed(Int env_i) {
-            return num_iters_[env_i] < max_num_iters_[env_i]; 
+            if (num_iters_[env_i] >= max_num_iters_[env_i])
+                return false;
+            if (max_durations_[env_i] != kIntFull && timers_[env_i].Elapsed() >= max_durations_[env_i])
+                return false;
+            if (solver_ && !paths_[env_i].empty() && paths_[env_i].front()->proven)
+                return false;
+            return !early_stopping_ || !IsDecided(env_i);
+        }
+
+        // Checks whether the most visited child of the root of a specified environment can still be overtaken by the
+        // second most visited one within the remaining budget. With a time budget, the remaining number of iterations
+        // is extrapolated from the iteration rate so far.
+        //
+        // Parameters:
+        //   env_i: The index of environment.
+        //
+        // Returns:
+        //   bool: Returns true if the most visited child of the root can no longer change.
+        virtual bool IsDecided(Int env_i) const {
+            if (paths_[env_i].empty() || paths_[env_i].front()->children.size() < 2)
+                return false;
+            Int num_remaining_iters = max_num_iters_[env_i] - num_iters_[env_i];
+            if (max_durations_[env_i] != kIntFull) {
+                Int elapsed = timers_[env_i].Elapsed();
+                if (elapsed <= 0)
+                    return false;
+                double rate = num_iters_[env_i] / (double)elapsed;
+                num_remaining_iters = std::min<Int>(num_remaining_iters, std::ceil(rate * (max_durations_[env_i] - elapsed)));
+            }
+            Int best = 0;
+            Int second = 0;
+            for (const Node* child : paths_[env_i].front()->children) {
+                Int num_visits = child == nullptr ? 0 : child->num_visits;
+                if (num_visits > best) {
+                    second = best;
+                    best = num_visits;
+                }
+                else if (num_visits > second) {
+                    second = num_visits;
+                }
+            }
+            return best - second > num_remaining_iters;
+        }
+
+        // Returns the statistics of the children of the root of a specified environment.
+        //
+        // Parameters:
+        //   env_i: The index of environment.
+        virtual RootStatistics GetRootStatistics(Int env_i) const {
+            if (paths_[env_i].empty())
+                return RootStatistics();
+            const Node* root = paths_[env_i].front();
+            RootStatistics statistics(root->children.size());
+            for (Int i=0; i<root->children.size(); ++i) {
+                const Node* child = root->children[i];
+                if (child == nullptr)
+                    continue;
+                statistics.num_visits[i] = child->num_visits;
+                statistics.total_rewards[i] = child->mean_reward * child->num_visits;
+            }
+            return statistics;
+        }
+
+        // Sums the root statistics of all environments. This is the reduction of root parallelisation, where every
+        // environment searches the same root with a different random stream.
+        virtual RootStatistics MergeRootStatistics() const {
+            RootStatistics statistics;
+            for (Int i=0; i<num_envs(); ++i)
+                statistics.Merge(GetRootStatistics(i));
+            return statistics;
         }
 
         // Selects the next node to explore in the tree based on the tree policy for a specified environment.
@@ -139,30 +409,50 @@ namespace rlop {
         //   env_i: The index of environment.
         virtual bool Expand(Int env_i) {
             if (paths_[env_i].back()->children.empty())
-                paths_[env_i].back()->children = std::vector<Node*>(NumChildStates(env_i));
+                paths_[env_i].back()->children.assign(NumChildStates(env_i), nullptr);
             if (paths_[env_i].back()->children.empty())
                 return false;
             auto child_i = SelectToExpand(env_i);
             if (!child_i)
                 return false;
             if (paths_[env_i].back()->children[*child_i] == nullptr) {
-                paths_[env_i].back()->children[*child_i] = NewNode();
+                if (AtNodeBudget(env_i))
+                    return true;
+                paths_[env_i].back()->children[*child_i] = NewNode(env_i);
                 ++paths_[env_i].back()->num_children;
             }
             paths_[env_i].push_back(paths_[env_i].back()->children[*child_i]);
             return Step(env_i, *child_i);
         }
 
-        // Simulates the outcome from the current state to the end of the episode for a specified environment.
+        // Simulates the outcome from the current state of a specified environment by random steps, to the end of the
+        // episode or the rollout depth, as MCTS::Simulate(): a rollout cut before the end is scored by EvaluateLeaf(),
+        // or by Reward() without an evaluator, and mixed with the value of the leaf by the leaf value weight.
         //
         // Parameters:
         //   env_i: The index of environment.
         virtual bool Simulate(Int env_i) {
-            while (true) {
-                auto i = SelectRandom(env_i); 
-                if (!i || !Step(env_i, *i))
-                    return false;
+            std::optional<double> leaf_value;
+            if (leaf_value_weight_ > 0)
+                leaf_value = EvaluateLeaf(env_i);
+            double outcome = 0;
+            if (!leaf_value || leaf_value_weight_ < 1) {
+                Int depth = 0;
+                bool ended = false;
+                while (depth < rollout_depth_) {
+                    auto i = SelectRandom(env_i); 
+                    if (!i || !Step(env_i, *i)) {
+                        ended = true;
+                        break;
+                    }
+                    ++depth;
+                    ++rollout_lengths_[env_i];
+                }
+                std::optional<double> value = ended ? std::nullopt : EvaluateLeaf(env_i);
+                outcome = value ? *value : Reward(env_i);
             }
+            simulated_rewards_[env_i] = leaf_value ? (1 - leaf_value_weight_) * outcome + leaf_value_weight_ * *leaf_value : outcome;
+            return false;
         }
 
         // Backpropagates the simulation results through the path in the tree for a specified environment.
@@ -170,7 +460,8 @@ namespace rlop {
         // Parameters:
         //   env_i: The index of environment.
         virtual void BackPropagate(Int env_i) {
-            double reward = Reward(env_i);
+            double reward = simulated_rewards_[env_i] ? *simulated_rewards_[env_i] : Reward(env_i);
+            simulated_rewards_[env_i] = std::nullopt;
             while (paths_[env_i].size() > 1) {
                 UpdateNode(env_i, reward);
                 paths_[env_i].pop_back();
@@ -180,21 +471,209 @@ namespace rlop {
 
         virtual void Update(Int env_i) {
             ++num_iters_[env_i];
+            if (budget_policy_ == NodeBudgetPolicy::kPrune && AtNodeBudget(env_i)) {
+                Int num_nodes = std::min<Int>(max_num_nodes_, node_pools_[env_i].size());
+                Prune(env_i, num_nodes - num_nodes * prune_ratio_);
+            }
         }
 
-        virtual void Release(Node* node) {
+        // Whether the tree of a specified environment has reached its node budget, or the node pools their memory
+        // budget in the MemoryTracker.
+        //
+        // Parameters:
+        //   env_i: The index of environment.
+        virtual bool AtNodeBudget(Int env_i) const {
+            return node_pools_[env_i].size() >= max_num_nodes_ || node_pools_[env_i].AtMemoryBudget();
+        }
+
+        // Marks the last node of the path of a specified environment as proven if its state is terminal, and propagates
+        // the proof towards the root. This is called when an iteration stops in the tree instead of simulating.
+        //
+        // Parameters:
+        //   env_i: The index of environment.
+        virtual void Solve(Int env_i) {
+            auto value = TerminalValue(env_i);
+            if (!value)
+                return;
+            auto& path = paths_[env_i];
+            path.back()->proven = true;
+            path.back()->proven_value = *value;
+            for (Int i=path.size()-2; i>=0; --i) {
+                if (!UpdateProven(path[i]))
+                    break;
+            }
+        }
+
+        // Proves a node if one of its children is a proven win for the player choosing among them, or if all of its
+        // children are proven.
+        //
+        // Parameters:
+        //   node: The node to prove.
+        //
+        // Returns:
+        //   bool: Returns true if the node is proven.
+        virtual bool UpdateProven(Node* node) const {
+            if (node->proven)
+                return true;
+            if (node->children.empty())
+                return false;
+            bool all_proven = true;
+            double best = std::numeric_limits<double>::lowest();
+            for (const Node* child : node->children) {
+                if (child == nullptr || !child->proven)
+                    all_proven = false;
+                else
+                    best = std::max(best, child->proven_value);
+            }
+            if (best < solver_win_value_ && !all_proven)
+                return false;
+            node->proven = true;
+            node->proven_value = negamax_ ? -best : best;
+            return true;
+        }
+
+        // Limits the number of nodes of the tree of each environment. Once the budget is reached, the tree is either
+        // pruned or frozen depending on the budget policy, and iterations reaching a missing child simulate from its
+        // parent.
+        //
+        // Parameters:
+        //   max_num_nodes: The maximum number of nodes per environment.
+        //   policy: What to do once the budget is reached.
+        //   prune_ratio: The fraction of the budget released by each pruning.
+        virtual void SetNodeBudget(Int max_num_nodes, NodeBudgetPolicy policy = NodeBudgetPolicy::kPrune, double prune_ratio = 0.25) {
+            max_num_nodes_ = std::max<Int>(max_num_nodes, 1);
+            budget_policy_ = policy;
+            prune_ratio_ = prune_ratio;
+        }
+
+        // Limits the memory of all trees together, assuming each node holds `num_child_states` child pointers. The 
+        // available memory of the host can be queried with GetAvailableMemorySize() from platform.h.
+        //
+        // Parameters:
+        //   max_num_bytes: The maximum number of bytes summed over all environments.
+        //   num_child_states: The typical number of children of a node.
+        //   policy: What to do once the budget is reached.
+        //   prune_ratio: The fraction of the budget released by each pruning.
+        virtual void SetMemoryBudget(Int max_num_bytes, Int num_child_states, NodeBudgetPolicy policy = NodeBudgetPolicy::kPrune, double prune_ratio = 0.25) {
+            Int num_nodes = max_num_bytes / (sizeof(Node) + num_child_states * sizeof(Node*));
+            SetNodeBudget(num_nodes / std::max<Int>(num_envs(), 1), policy, prune_ratio);
+        }
+
+        // Releases the least visited subtrees of a specified environment until at most `max_num_nodes` nodes remain.
+        // Since a child is never visited more often than its parent, releasing every node whose visit count is below
+        // a threshold releases whole subtrees. The nodes visited exactly as often as the threshold are then released
+        // only until the budget is met, so that ties at the threshold release at most one subtree more than needed.
+        // The root and its children are always kept.
+        //
+        // Parameters:
+        //   env_i: The index of environment.
+        //   max_num_nodes: The number of nodes to keep.
+        virtual void Prune(Int env_i, Int max_num_nodes) {
+            Int num_to_release = node_pools_[env_i].size() - std::max<Int>(max_num_nodes, 1);
+            if (num_to_release <= 0 || paths_[env_i].empty())
+                return;
+            std::vector<Int> visits;
+            std::vector<Node*> stack;
+            for (Node* child : paths_[env_i].front()->children) {
+                if (child != nullptr)
+                    stack.push_back(child);
+            }
+            std::vector<Node*> children = stack;
+            while (!stack.empty()) {
+                Node* node = stack.back();
+                stack.pop_back();
+                for (Node* child : node->children) {
+                    if (child != nullptr) {
+                        visits.push_back(child->num_visits);
+                        stack.push_back(child);
+                    }
+                }
+            }
+            if (visits.empty())
+                return;
+            num_to_release = std::min<Int>(num_to_release, visits.size());
+            std::nth_element(visits.begin(), visits.begin() + num_to_release - 1, visits.end());
+            Int threshold = visits[num_to_release - 1];
+            Int num_nodes = node_pools_[env_i].size() - num_to_release;
+            // The first pass releases the nodes below the threshold, the second one those at the threshold, whose
+            // descendants are then all at the threshold too, until the budget is met.
+            for (bool at_threshold : { false, true }) {
+                stack = children;
+                while (!stack.empty() && node_pools_[env_i].size() > num_nodes) {
+                    Node* node = stack.back();
+                    stack.pop_back();
+                    for (Node*& child : node->children) {
+                        if (child == nullptr)
+                            continue;
+                        if (child->num_visits < threshold || (at_threshold && child->num_visits == threshold && node_pools_[env_i].size() > num_nodes)) {
+                            Release(env_i, child);
+                            DeleteNode(env_i, child);
+                            child = nullptr;
+                            --node->num_children;
+                        }
+                        else {
+                            stack.push_back(child);
+                        }
+                    }
+                }
+            }
+        }
+
+        // Releases the descendants of a node of a specified environment, returning them to the node pool.
+        //
+        // Parameters:
+        //   env_i: The index of environment.
+        //   node: The node whose descendants are released.
+        virtual void Release(Int env_i, Node* node) {
             if (node == nullptr) 
                 return;
             for (Int i=0; i<node->children.size(); ++i) {
                 Node* child = node->children[i];
-                Release(child);
-                delete child;
+                Release(env_i, child);
+                DeleteNode(env_i, child);
             }
             node->children.clear();
+            node->num_children = 0;
+        }
+
+        // Releases the whole tree of a specified environment. Together with NewNode() and DeleteNode(), this can be
+        // overridden to plug in another allocation scheme.
+        //
+        // Parameters:
+        //   env_i: The index of environment.
+        virtual void ReleaseTree(Int env_i) {
+            node_pools_[env_i].Reset();
+        }
+
+        virtual Node* NewNode(Int env_i) {
+            return node_pools_[env_i].New();
         }
 
-        virtual Node* NewNode() const {
-            return new Node();
+        virtual void DeleteNode(Int env_i, Node* node) {
+            node_pools_[env_i].Delete(node);
+        }
+
+        // Recursively copies a subtree into the node pool of a specified environment.
+        //
+        // Parameters:
+        //   env_i: The index of environment.
+        //   node: The root of the subtree to copy.
+        //
+        // Returns:
+        //   Node*: The root of the copy.
+        virtual Node* CloneNode(Int env_i, const Node* node) {
+            Node* clone = NewNode(env_i);
+            clone->mean_reward = node->mean_reward;
+            clone->num_visits = node->num_visits;
+            clone->num_children = node->num_children;
+            clone->proven = node->proven;
+            clone->proven_value = node->proven_value;
+            clone->children.assign(node->children.size(), nullptr);
+            for (Int i=0; i<node->children.size(); ++i) {
+                if (node->children[i] != nullptr)
+                    clone->children[i] = CloneNode(env_i, node->children[i]);
+            }
+            return clone;
         }
 
         virtual void UpdateNode(Int env_i, double reward) const {
@@ -230,6 +709,8 @@ namespace rlop {
             Int best = kIntNull;
             double best_score = std::numeric_limits<double>::lowest();
             for (Int i=0; i<paths_[env_i].back()->children.size(); ++i) {
+                if (solver_ && paths_[env_i].back()->children[i] != nullptr && paths_[env_i].back()->children[i]->proven)
+                    continue;
                 double score = TreePolicy(env_i, i);
                 if (score > best_score) {
                     best = i;
@@ -253,7 +734,7 @@ namespace rlop {
         virtual std::optional<Int> SelectToExpand(Int env_i) {
             if (paths_[env_i].back()->children.empty())
                 return std::nullopt;
-            return { rands_[env_i].Uniform(size_t(0), paths_[env_i].back()->children.size()-1) };
+            return { rands_[env_i]->Uniform(size_t(0), paths_[env_i].back()->children.size()-1) };
         }
 
         // Selects a child state randomly from the current state for a specified environment. This method is used during the 
@@ -269,10 +750,10 @@ namespace rlop {
             Int num_children = NumChildStates(env_i);
             if (num_children <= 0)
                 return std::nullopt;
-            return { rands_[env_i].Uniform(Int(0), num_children - 1) };
+            return { rands_[env_i]->Uniform(Int(0), num_children - 1) };
         }
 
-        const Int num_envs() const {
+        Int num_envs() const {
             return paths_.size();
         }
 
@@ -280,6 +761,18 @@ namespace rlop {
             return paths_;
         }
 
+        const std::vector<NodePool<Node>>& node_pools() const {
+            return node_pools_;
+        }
+
+        Int max_num_nodes() const {
+            return max_num_nodes_;
+        }
+
+        NodeBudgetPolicy budget_policy() const {
+            return budget_policy_;
+        }
+
         double coef() const {
             return coef_;
         }
@@ -288,11 +781,121 @@ namespace rlop {
             coef_ = coef;
         }
 
+        bool early_stopping() const {
+            return early_stopping_;
+        }
+
+        // Enables stopping the search of an environment once the most visited child of its root can no longer be
+        // overtaken.
+        void set_early_stopping(bool early_stopping) {
+            early_stopping_ = early_stopping;
+        }
+
+        const std::vector<Int>& num_iters() const {
+            return num_iters_;
+        }
+
+        bool solver() const {
+            return solver_;
+        }
+
+        // Enables the solver, which propagates the game-theoretic values reported by TerminalValue() and stops
+        // searching proven subtrees.
+        //
+        // Parameters:
+        //   solver: Whether the solver is enabled.
+        //   win_value: The value of a win. A node with a child of this value is proven without its other children.
+        //   negamax: Whether players alternate, in which case the value of a node is the opposite of the value of its
+        //            best child. Otherwise, it is the value of its best child.
+        void set_solver(bool solver, double win_value = 1, bool negamax = true) {
+            solver_ = solver;
+            solver_win_value_ = win_value;
+            negamax_ = negamax;
+        }
+
+        bool statistics_enabled() const {
+            return statistics_enabled_;
+        }
+
+        // Enables collecting the per-phase statistics of the following searches.
+        void set_statistics_enabled(bool statistics_enabled) {
+            statistics_enabled_ = statistics_enabled;
+        }
+
+        // Returns the statistics of each environment.
+        const std::vector<MCTSStatistics>& statistics() const {
+            return statistics_;
+        }
+
+        // Returns the statistics merged over all environments. Phase times and iterations are summed, while the search
+        // time is the longest one, so the iteration rate is the one of the whole parallel search.
+        MCTSStatistics TotalStatistics() const {
+            MCTSStatistics total;
+            for (const auto& statistics : statistics_)
+                total.Merge(statistics);
+            return total;
+        }
+
+        bool env_affinity() const {
+            return env_affinity_;
+        }
+
+        // Enables running every environment on the same thread of the shared pool in successive searches, its tree and
+        // generator being allocated by that thread. With pinned threads, see ThreadPool::set_pin_threads(), the
+        // memory of each environment then stays on the NUMA node of its core. A search copies the trees of the
+        // environments that move to another thread, such as after a resize of the pool.
+        void set_env_affinity(bool env_affinity) {
+            env_affinity_ = env_affinity;
+        }
+
+        void ClearStatistics() {
+            for (auto& statistics : statistics_)
+                statistics.Clear();
+        }
+
+        Int rollout_depth() const {
+            return rollout_depth_;
+        }
+
+        // Cuts the rollouts after `rollout_depth` random steps, their outcome being scored by EvaluateLeaf(), so that
+        // an iteration costs O(rollout_depth) instead of O(episode length). 0 leaves the scoring to EvaluateLeaf().
+        void set_rollout_depth(Int rollout_depth) {
+            rollout_depth_ = std::max<Int>(rollout_depth, 0);
+        }
+
+        double leaf_value_weight() const {
+            return leaf_value_weight_;
+        }
+
+        // Sets the weight λ in [0, 1] of the value of the leaves given by EvaluateLeaf() against the outcome of the
+        // rollouts.
+        void set_leaf_value_weight(double leaf_value_weight) {
+            leaf_value_weight_ = std::clamp(leaf_value_weight, 0.0, 1.0);
+        }
+
     protected:
         double coef_;
+        bool early_stopping_ = false;
         std::vector<Int> num_iters_;
         std::vector<Int> max_num_iters_;
+        std::vector<Int> max_durations_;
+        std::vector<Timer<>> timers_;
         std::vector<std::vector<Node*>> paths_;
-        std::vector<Random> rands_;
+        std::vector<NodePool<Node>> node_pools_;
+        Int max_num_nodes_ = kIntFull;
+        NodeBudgetPolicy budget_policy_ = NodeBudgetPolicy::kPrune;
+        double prune_ratio_ = 0.25;
+        bool solver_ = false;
+        bool negamax_ = true;
+        double solver_win_value_ = 1;
+        bool statistics_enabled_ = false;
+        std::vector<Int> rollout_lengths_;
+        Int rollout_depth_ = kIntFull;
+        double leaf_value_weight_ = 0;
+        std::vector<std::optional<double>> simulated_rewards_; // The reward of the simulation of each environment.
+        std::vector<MCTSStatistics> statistics_;
+        std::vector<std::unique_ptr<Random>> rands_; // Allocated apart, so that environments do not share cache lines.
+        bool env_affinity_ = false;
+        std::vector<std::thread::id> env_threads_; // The threads the environments are placed on.
     };
 }
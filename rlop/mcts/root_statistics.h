@@ -0,0 +1,68 @@
+#pragma once
+#include "rlop/common/typedef.h"
+
+namespace rlop {
+    // The visit counts and reward sums of the children of a search root. Statistics of trees searching the same root,
+    // in other threads or on other machines, are combined by summing them child by child.
+    struct RootStatistics {
+        std::vector<Int> num_visits;
+        std::vector<double> total_rewards;
+
+        // Constructs empty statistics for a given number of children.
+        RootStatistics(Int num_children = 0) : num_visits(num_children, 0), total_rewards(num_children, 0) {}
+
+        Int size() const {
+            return num_visits.size();
+        }
+
+        // Adds the statistics of another tree child by child. The statistics grow if the other tree has more children.
+        void Merge(const RootStatistics& other) {
+            if (other.size() > size()) {
+                num_visits.resize(other.size(), 0);
+                total_rewards.resize(other.size(), 0);
+            }
+            for (Int i=0; i<other.size(); ++i) {
+                num_visits[i] += other.num_visits[i];
+                total_rewards[i] += other.total_rewards[i];
+            }
+        }
+
+        double MeanReward(Int child_i) const {
+            return num_visits[child_i] == 0 ? 0 : total_rewards[child_i] / num_visits[child_i];
+        }
+
+        Int TotalNumVisits() const {
+            return std::accumulate(num_visits.begin(), num_visits.end(), Int(0));
+        }
+
+        // Returns the index of the most visited child, or std::nullopt if no child was visited.
+        std::optional<Int> MostVisited() const {
+            Int best = kIntNull;
+            Int best_num_visits = 0;
+            for (Int i=0; i<size(); ++i) {
+                if (num_visits[i] > best_num_visits) {
+                    best = i;
+                    best_num_visits = num_visits[i];
+                }
+            }
+            if (best == kIntNull)
+                return std::nullopt;
+            return { best };
+        }
+
+        // Returns the index of the visited child with the highest mean reward, or std::nullopt if no child was visited.
+        std::optional<Int> BestMeanReward() const {
+            Int best = kIntNull;
+            double best_score = std::numeric_limits<double>::lowest();
+            for (Int i=0; i<size(); ++i) {
+                if (num_visits[i] > 0 && MeanReward(i) > best_score) {
+                    best = i;
+                    best_score = MeanReward(i);
+                }
+            }
+            if (best == kIntNull)
+                return std::nullopt;
+            return { best };
+        }
+    };
+}
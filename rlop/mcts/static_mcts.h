@@ -0,0 +1,278 @@
+#pragma once
+#include "rlop/common/base_algorithm.h"
+#include "rlop/common/utils.h"
+#include "rlop/common/random.h"
+#include "rlop/common/profiler.h"
+#include "node_pool.h"
+
+namespace rlop {
+    // Implements the Monte Carlo Tree Search (MCTS) algorithm with static dispatch. The algorithm is the same as the
+    // one of MCTS, but the domain is bound at compile time through the curiously recurring template pattern, so the
+    // compiler can inline the domain callbacks into the selection and the simulation loops. This pays off for cheap
+    // domains where a virtual call per step costs as much as the step itself.
+    //
+    // TDerived must provide the following public methods, with the same meaning as the pure virtual functions of MCTS:
+    //   Int NumChildStates() const;
+    //   bool IsExpanded(const Node& node) const;
+    //   void RevertState();
+    //   bool Step(Int child_i);
+    //   double Reward();
+    // It may also hide any other method of this class, such as UpdateNode() or TreePolicy(), which are always called
+    // through TDerived.
+    //
+    // Template Parameters:
+    //   TDerived: The domain class deriving from StaticMCTS<TDerived>.
+    template<typename TDerived>
+    class StaticMCTS : public BaseAlgorithm {
+    public:
+        struct Node {
+            double mean_reward = 0;
+            Int num_visits = 0;
+            Int num_children = 0; // The number of children nodes expanded.
+            std::vector<Node*> children;
+
+            // Resets the statistics and the children of the node, keeping the capacity of the child array.
+            void Clear() {
+                mean_reward = 0;
+                num_visits = 0;
+                num_children = 0;
+                children.clear();
+            }
+        };
+
+        // Constructs a StaticMCTS with a exploration coefficient.
+        //
+        // Parameters:
+        //   coef: The exploration coefficient used in the UCB1 formula, Default is sqrt(2).
+        StaticMCTS(double coef = std::sqrt(2)) : coef_(coef) {}
+
+        virtual ~StaticMCTS() = default;
+
+        // Resets the algorithm. The previous tree is released in O(1) by rewinding the node pool.
+        virtual void Reset() override {
+            node_pool_.Reset();
+            path_.clear();
+            path_.push_back(node_pool_.New());
+        }
+
+        // Promotes a child of the root to be the new root, so that the statistics gathered under it are reused by the
+        // next search. Only the sibling subtrees are released. If the child has not been expanded, the tree is reset.
+        //
+        // Parameters:
+        //   child_i: The index of the child that was played.
+        //
+        // Returns:
+        //   bool: Returns true if the subtree was reused.
+        bool AdvanceRoot(Int child_i) {
+            Node* root = path_.empty() ? nullptr : path_.front();
+            Node* child = (root != nullptr && child_i >= 0 && child_i < root->children.size()) ? root->children[child_i] : nullptr;
+            if (child == nullptr) {
+                derived().Reset();
+                return false;
+            }
+            for (Int i=0; i<root->children.size(); ++i) {
+                if (i != child_i && root->children[i] != nullptr) {
+                    Release(root->children[i]);
+                    node_pool_.Delete(root->children[i]);
+                }
+            }
+            root->children.clear();
+            node_pool_.Delete(root);
+            path_.clear();
+            path_.push_back(child);
+            return true;
+        }
+
+        void SetSeed(uint64_t seed) {
+            rand_.Seed(seed);
+        }
+
+        // Performs the MCTS search over a maximum number of iterations.
+        //
+        // Parameters:
+        //   max_num_iters: The maximum number of iterations.
+        void Search(Int max_num_iters) {
+            RLOP_PROFILE_SCOPE("StaticMCTS::Search");
+            num_iters_ = 0;
+            max_num_iters_ = max_num_iters;
+            while (derived().Proceed()) {
+                derived().RevertState();
+                if (derived().Select() && derived().Expand())
+                    derived().Simulate();
+                derived().BackPropagate();
+                derived().Update();
+            }
+        }
+
+        // Checks if the search should continue.
+        bool Proceed() {
+            return num_iters_ < max_num_iters_;
+        }
+
+        // Selects the next node to explore in the tree based on the tree policy.
+        bool Select() {
+            if (path_.empty())
+                return true;
+            while (derived().IsExpanded(*path_.back())) {
+                auto child_i = derived().SelectByTreePolicy();
+                if (!child_i)
+                    return false;
+                path_.push_back(path_.back()->children[*child_i]);
+                if (!derived().Step(*child_i))
+                    return false;
+            }
+            return true;
+        }
+
+        // Expands the current node by adding a new child node to the tree.
+        bool Expand() {
+            if (path_.back()->children.empty())
+                path_.back()->children.assign(derived().NumChildStates(), nullptr);
+            if (path_.back()->children.empty())
+                return false;
+            auto child_i = derived().SelectToExpand();
+            if (!child_i)
+                return false;
+            if (path_.back()->children[*child_i] == nullptr) {
+                path_.back()->children[*child_i] = node_pool_.New();
+                ++path_.back()->num_children;
+            }
+            path_.push_back(path_.back()->children[*child_i]);
+            return derived().Step(*child_i);
+        }
+
+        // Simulates the outcome from the current state to the end of the episode.
+        bool Simulate() {
+            while (true) {
+                auto i = derived().SelectRandom();
+                if (!i || !derived().Step(*i))
+                    return false;
+            }
+        }
+
+        // Backpropagates the simulation results through the path in the tree.
+        void BackPropagate() {
+            double reward = derived().Reward();
+            while (path_.size() > 1) {
+                derived().UpdateNode(reward);
+                path_.pop_back();
+            }
+            derived().UpdateNode(reward);
+        }
+
+        void Update() {
+            ++num_iters_;
+        }
+
+        // Releases the descendants of a node, returning them to the node pool.
+        void Release(Node* node) {
+            if (node == nullptr)
+                return;
+            for (Node* child : node->children) {
+                Release(child);
+                node_pool_.Delete(child);
+            }
+            node->children.clear();
+            node->num_children = 0;
+        }
+
+        void UpdateNode(double reward) {
+            Node* node = path_.back();
+            node->mean_reward = (node->num_visits * node->mean_reward + reward) / (node->num_visits + 1.0);
+            node->num_visits += 1;
+        }
+
+        // Computes the value of a child node using the UCB1 formula.
+        //
+        // Parameters:
+        //   child_i: The index of the child node.
+        //
+        // Return:
+        //   double: the value of the child node.
+        double TreePolicy(Int child_i) {
+            const Node* child = path_.back()->children[child_i];
+            if (child == nullptr)
+                return std::numeric_limits<double>::lowest();
+            return UCB1(child->mean_reward, child->num_visits, path_.back()->num_visits, coef_);
+        }
+
+        // Selects the next child node to explore based on the tree policy.
+        //
+        // Returns:
+        //   std::optional<Int>: The index of the child node with the highest UCB1 score. If the current node has no
+        //                       legal children, returns std::nullopt.
+        std::optional<Int> SelectByTreePolicy() {
+            Int best = kIntNull;
+            double best_score = std::numeric_limits<double>::lowest();
+            for (Int i=0; i<path_.back()->children.size(); ++i) {
+                double score = derived().TreePolicy(i);
+                if (score > best_score) {
+                    best = i;
+                    best_score = score;
+                }
+            }
+            if (best == kIntNull)
+                return std::nullopt;
+            return { best };
+        }
+
+        // Selects a child node to expand next from the current node's children.
+        //
+        // Returns:
+        //   std::optional<Int>: The index of the child node selected for expansion. If the current node has no legal
+        //                       children, returns std::nullopt.
+        std::optional<Int> SelectToExpand() {
+            if (path_.back()->children.empty())
+                return std::nullopt;
+            return { rand_.Uniform(size_t(0), path_.back()->children.size() - 1) };
+        }
+
+        // Selects a child state randomly from the current state. This method is used during the simulation phase.
+        //
+        // Returns:
+        //   std::optional<Int>: The index of the randomly selected child state. If there is no legal child state available,
+        //                       returns std::nullopt.
+        std::optional<Int> SelectRandom() {
+            Int num_children = derived().NumChildStates();
+            if (num_children <= 0)
+                return std::nullopt;
+            return { rand_.Uniform(Int(0), num_children - 1) };
+        }
+
+        const std::vector<Node*>& path() const {
+            return path_;
+        }
+
+        const NodePool<Node>& node_pool() const {
+            return node_pool_;
+        }
+
+        double coef() const {
+            return coef_;
+        }
+
+        void set_coef(double coef) {
+            coef_ = coef;
+        }
+
+        Int num_iters() const {
+            return num_iters_;
+        }
+
+    protected:
+        TDerived& derived() {
+            return static_cast<TDerived&>(*this);
+        }
+
+        const TDerived& derived() const {
+            return static_cast<const TDerived&>(*this);
+        }
+
+        double coef_;
+        Int num_iters_ = 0;
+        Int max_num_iters_ = 0;
+        std::vector<Node*> path_;
+        NodePool<Node> node_pool_;
+        Random rand_;
+    };
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include "mcts.h"
+
+namespace rlop {
+    // Implements a Monte Carlo Tree Search which merges transpositions. Nodes are stored in a hash table keyed by the
+    // encoding of the state they represent, so every path reaching the same state shares the same node and its
+    // statistics, and the tree becomes a directed acyclic graph. A state already on the current path is given a private
+    // node instead, which keeps the graph acyclic in domains where states can repeat.
+    //
+    // Since a node may have several parents, subtrees are never released one by one: AdvanceRoot() only moves the root,
+    // pruning is not available and a node budget always stops the expansion.
+    //
+    // Template Parameters:
+    //   TKey: The type of the state encoding. It must be hashable with std::hash.
+    template<typename TKey>
+    class TranspositionMCTS : public MCTS {
+    public:
+        // Constructs a TranspositionMCTS with a exploration coefficient.
+        //
+        // Parameters:
+        //   coef: The exploration coefficient used in the UCB1 formula, Default is sqrt(2).
+        TranspositionMCTS(double coef = std::sqrt(2)) : MCTS(coef) {
+            budget_policy_ = NodeBudgetPolicy::kStopExpanding;
+        }
+
+        virtual ~TranspositionMCTS() = default;
+
+        // Pure virtual function to encode the current state into a key.
+        virtual TKey PositionEncode() const = 0;
+
+        virtual void Reset() override {
+            table_.clear();
+            MCTS::Reset();
+        }
+
+        virtual bool Select() override {
+            if (path_.empty())
+                return true;
+            path_keys_.clear();
+            path_keys_.push_back(PositionEncode());
+            while (IsExpanded(*path_.back())) {
+                auto child_i = SelectByTreePolicy();
+                if (!child_i)
+                    return false;
+                path_.push_back(path_.back()->children[*child_i]);
+                if (!Step(*child_i))
+                    return false;
+                path_keys_.push_back(PositionEncode());
+            }
+            return true;
+        }
+
+        // Expands the current node by linking a child to the node of the state it leads to, creating that node if the
+        // state has not been reached before.
+        virtual bool Expand() override {
+            Node* node = path_.back();
+            if (node->children.empty())
+                node->children.assign(NumChildStates(), nullptr);
+            if (node->children.empty())
+                return false;
+            auto child_i = SelectToExpand();
+            if (!child_i)
+                return false;
+            Node* child = node->children[*child_i];
+            if (child != nullptr) {
+                path_.push_back(child);
+                if (!Step(*child_i))
+                    return false;
+                path_keys_.push_back(PositionEncode());
+                return true;
+            }
+            if (AtNodeBudget())
+                return true;
+            bool success = Step(*child_i);
+            TKey key = PositionEncode();
+            if (std::find(path_keys_.begin(), path_keys_.end(), key) != path_keys_.end()) {
+                child = NewNode();
+            }
+            else {
+                auto it = table_.find(key);
+                if (it == table_.end())
+                    it = table_.emplace(key, NewNode()).first;
+                child = it->second;
+            }
+            node->children[*child_i] = child;
+            ++node->num_children;
+            path_.push_back(child);
+            path_keys_.push_back(key);
+            return success;
+        }
+
+        // Moves the root to one of its children. The previous nodes stay in the table until the next Reset(), since
+        // they may be reached again through transpositions.
+        //
+        // Parameters:
+        //   child_i: The index of the child that was played.
+        //
+        // Returns:
+        //   bool: Returns true if the subtree was reused.
+        virtual bool AdvanceRoot(Int child_i) override {
+            Node* root = path_.empty() ? nullptr : path_.front();
+            Node* child = (root != nullptr && child_i >= 0 && child_i < root->children.size()) ? root->children[child_i] : nullptr;
+            if (child == nullptr) {
+                Reset();
+                return false;
+            }
+            path_.clear();
+            path_.push_back(child);
+            return true;
+        }
+
+        virtual void SetNodeBudget(Int max_num_nodes, NodeBudgetPolicy policy = NodeBudgetPolicy::kStopExpanding, double prune_ratio = 0.25) override {
+            MCTS::SetNodeBudget(max_num_nodes, NodeBudgetPolicy::kStopExpanding, prune_ratio);
+        }
+
+        virtual void Prune(Int max_num_nodes) override {}
+
+        // Returns the number of distinct states in the table.
+        Int num_states() const {
+            return table_.size();
+        }
+
+        const std::unordered_map<TKey, Node*>& table() const {
+            return table_;
+        }
+
+    protected:
+        std::unordered_map<TKey, Node*> table_;
+        std::vector<TKey> path_keys_;
+    };
+}
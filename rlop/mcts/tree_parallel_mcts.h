@@ -0,0 +1,418 @@
+#pragma once
+#include <atomic>
+#include "rlop/common/base_algorithm.h"
+#include "rlop/common/utils.h"
+#include "rlop/common/random.h"
+#include "rlop/common/profiler.h"
+#include "rlop/common/thread_pool.h"
+#include "node_pool.h"
+
+namespace rlop {
+    // Implements a tree parallel version of the Monte Carlo Tree Search (MCTS) algorithm. All worker threads share a
+    // single tree. Node statistics are updated atomically, threads descending through a node add a virtual loss to it
+    // so that concurrent workers spread over different paths, and children are expanded lock-free with compare and
+    // swap. Each worker owns an environment, a path, a random generator and a node pool, indexed by `env_i`.
+    class TreeParallelMCTS : public BaseAlgorithm {
+    public:
+        struct Node {
+            std::atomic<double> total_reward{0};
+            std::atomic<Int> num_visits{0};
+            std::atomic<Int> num_virtual_losses{0};
+            std::atomic<Int> num_children{0}; // The number of children nodes expanded.
+            std::atomic<Int> num_child_states{0}; // 0 before expansion, -1 while the children are being allocated.
+            Int capacity = 0;
+            std::unique_ptr<std::atomic<Node*>[]> children;
+
+            // Returns the mean reward of the node.
+            double mean_reward() const {
+                Int n = num_visits.load(std::memory_order_relaxed);
+                return n == 0 ? 0 : total_reward.load(std::memory_order_relaxed) / n;
+            }
+
+            // Returns the number of children, or 0 if the children are not allocated yet.
+            Int size() const {
+                return std::max<Int>(num_child_states.load(std::memory_order_acquire), 0);
+            }
+
+            Node* child(Int child_i) const {
+                return children[child_i].load(std::memory_order_acquire);
+            }
+
+            // Resets the statistics and the children of the node, keeping the capacity of the child array.
+            void Clear() {
+                total_reward.store(0, std::memory_order_relaxed);
+                num_visits.store(0, std::memory_order_relaxed);
+                num_virtual_losses.store(0, std::memory_order_relaxed);
+                num_children.store(0, std::memory_order_relaxed);
+                num_child_states.store(0, std::memory_order_relaxed);
+            }
+        };
+
+        // Constructs a TreeParallelMCTS instance with specified parameters.
+        //
+        // Parameters:
+        //   num_envs: The number of worker threads, each of them owning an environment.
+        //   coef: The exploration coefficient used in the UCB1 formula, Default is sqrt(2).
+        //   virtual_loss: The reward penalty applied for each worker currently traversing a node. Default is 1.
+        TreeParallelMCTS(Int num_envs, double coef = std::sqrt(2), double virtual_loss = 1) :
+            coef_(coef),
+            virtual_loss_(virtual_loss),
+            paths_(num_envs),
+            node_pools_(num_envs),
+            rands_(num_envs)
+        {
+            for (Int i=1; i<rands_.size(); ++i) {
+                rands_[i] = rands_[i - 1];
+                rands_[i].Jump();
+            }
+        }
+
+        virtual ~TreeParallelMCTS() = default;
+
+        // Pure virtual function to return the total number of child states from the current state for a specified environment.
+        virtual Int NumChildStates(Int env_i) const = 0;
+
+        // Pure virtual function to determine whether a node has been fully expanded for a specified environment.
+        //
+        // Parameters:
+        //   env_i: The index of environment.
+        //
+        // Return:
+        //   bool: Returns true if the node is fully expanded.
+        virtual bool IsExpanded(Int env_i, const Node& node) const = 0;
+
+        // Pure virtual function to revert the state of a specified environment to its state at the beginning of the search.
+        //
+        // Parameters:
+        //   env_i: The index of environment.
+        virtual void RevertState(Int env_i) = 0;
+
+        // Pure virtual function to advance a specified environment state based on the selected child index.
+        //
+        // Parameters:
+        //   env_i: The index of environment.
+        //   child_i: The index of the child to move to.
+        //
+        // Return:
+        //   bool: Returns true if the step was successful. Returns false if the step was unsuccessful.
+        virtual bool Step(Int env_i, Int child_i) = 0;
+
+        // Pure virtual function to return the reward of the current state for a specified environment.
+        virtual double Reward(Int env_i) = 0;
+
+        // Resets the algorithm. The previous tree is released in O(1) by rewinding the node pools.
+        virtual void Reset() override {
+            for (Int i=0; i<num_envs(); ++i) {
+                ReleaseTree(i);
+                paths_[i].clear();
+            }
+            root_ = NewNode(0);
+        }
+
+        // Seeds the generators of the environments. Those beyond the seeds take the streams jumped from the
+        // generator of the previous environment, so that no two environments draw the same numbers.
+        virtual void SetSeeds(const std::vector<uint64_t>& seeds) {
+            if (seeds.empty())
+                return;
+            for (Int i=0; i<rands_.size(); ++i) {
+                if (i < seeds.size()) {
+                    rands_[i].Seed(seeds[i]);
+                } else {
+                    rands_[i] = rands_[i - 1];
+                    rands_[i].Jump();
+                }
+            }
+        }
+
+        // Performs the search with all workers sharing the tree and the iteration budget. The workers run as tasks
+        // of the shared ThreadPool, so an environment whose worker has no thread left only starts once another
+        // worker is done, and then finds the remaining budget.
+        //
+        // Parameters:
+        //   max_num_iters: The maximum number of iterations summed over all workers.
+        virtual void SearchAsync(Int max_num_iters) {
+            RLOP_PROFILE_SCOPE("TreeParallelMCTS::SearchAsync");
+            num_iters_ = 0;
+            max_num_iters_ = max_num_iters;
+            ParallelFor(0, num_envs(), [this](Int i) {
+                RunWorker(i);
+            });
+        }
+
+        // Runs the search loop of a single worker until the shared iteration budget is exhausted.
+        //
+        // Parameters:
+        //   env_i: The index of environment.
+        virtual void RunWorker(Int env_i) {
+            RLOP_PROFILE_SCOPE("TreeParallelMCTS::RunWorker");
+            while (Proceed(env_i)) {
+                RevertState(env_i);
+                paths_[env_i].clear();
+                paths_[env_i].push_back(root_);
+                if (Select(env_i) && Expand(env_i))
+                    Simulate(env_i);
+                BackPropagate(env_i);
+                Update(env_i);
+            }
+        }
+
+        // Claims one iteration from the shared budget.
+        virtual bool Proceed(Int env_i) {
+            return num_iters_.fetch_add(1, std::memory_order_relaxed) < max_num_iters_;
+        }
+
+        // Selects the next node to explore in the tree based on the tree policy for a specified environment.
+        //
+        // Parameters:
+        //   env_i: The index of environment.
+        virtual bool Select(Int env_i) {
+            while (IsExpanded(env_i, *paths_[env_i].back())) {
+                auto child_i = SelectTreePolicy(env_i);
+                if (!child_i)
+                    return false;
+                Node* child = paths_[env_i].back()->child(*child_i);
+                AddVirtualLoss(child);
+                paths_[env_i].push_back(child);
+                if (!Step(env_i, *child_i))
+                    return false;
+            }
+            return true;
+        }
+
+        // Expands the current node by adding a new child node to the tree for a specified environment. If another
+        // worker is allocating the children of the node at the same time, the node is treated as a leaf.
+        //
+        // Parameters:
+        //   env_i: The index of environment.
+        virtual bool Expand(Int env_i) {
+            Node* node = paths_[env_i].back();
+            if (!ExpandChildren(env_i, node))
+                return false;
+            auto child_i = SelectToExpand(env_i);
+            if (!child_i)
+                return false;
+            Node* child = node->child(*child_i);
+            if (child == nullptr) {
+                Node* new_child = NewNode(env_i);
+                if (node->children[*child_i].compare_exchange_strong(child, new_child, std::memory_order_acq_rel)) {
+                    child = new_child;
+                    node->num_children.fetch_add(1, std::memory_order_relaxed);
+                }
+                else {
+                    DeleteNode(env_i, new_child);
+                }
+            }
+            AddVirtualLoss(child);
+            paths_[env_i].push_back(child);
+            return Step(env_i, *child_i);
+        }
+
+        // Simulates the outcome from the current state to the end of the episode for a specified environment.
+        //
+        // Parameters:
+        //   env_i: The index of environment.
+        virtual bool Simulate(Int env_i) {
+            while (true) {
+                auto i = SelectRandom(env_i);
+                if (!i || !Step(env_i, *i))
+                    return false;
+            }
+        }
+
+        // Backpropagates the simulation results through the path in the tree for a specified environment, removing
+        // the virtual losses added on the way down.
+        //
+        // Parameters:
+        //   env_i: The index of environment.
+        virtual void BackPropagate(Int env_i) {
+            double reward = Reward(env_i);
+            while (paths_[env_i].size() > 1) {
+                RevertVirtualLoss(paths_[env_i].back());
+                UpdateNode(env_i, reward);
+                paths_[env_i].pop_back();
+            }
+            UpdateNode(env_i, reward);
+        }
+
+        virtual void Update(Int env_i) {}
+
+        // Allocates the child array of a node. Exactly one worker wins the race and allocates the array; the others
+        // return false until the array is published.
+        //
+        // Parameters:
+        //   env_i: The index of environment.
+        //   node: The node to expand.
+        //
+        // Returns:
+        //   bool: Returns true if the node has at least one child slot available.
+        virtual bool ExpandChildren(Int env_i, Node* node) {
+            Int num_child_states = node->num_child_states.load(std::memory_order_acquire);
+            if (num_child_states > 0)
+                return true;
+            if (num_child_states < 0)
+                return false;
+            if (!node->num_child_states.compare_exchange_strong(num_child_states, -1, std::memory_order_acq_rel))
+                return num_child_states > 0;
+            Int n = NumChildStates(env_i);
+            if (n <= 0) {
+                node->num_child_states.store(0, std::memory_order_release);
+                return false;
+            }
+            if (node->capacity < n) {
+                node->children = std::make_unique<std::atomic<Node*>[]>(n);
+                node->capacity = n;
+            }
+            for (Int i=0; i<n; ++i)
+                node->children[i].store(nullptr, std::memory_order_relaxed);
+            node->num_child_states.store(n, std::memory_order_release);
+            return true;
+        }
+
+        // Releases the part of the tree allocated by a specified worker. Together with NewNode() and DeleteNode(),
+        // this can be overridden to plug in another allocation scheme.
+        //
+        // Parameters:
+        //   env_i: The index of environment.
+        virtual void ReleaseTree(Int env_i) {
+            node_pools_[env_i].Reset();
+        }
+
+        virtual Node* NewNode(Int env_i) {
+            return node_pools_[env_i].New();
+        }
+
+        virtual void DeleteNode(Int env_i, Node* node) {
+            node_pools_[env_i].Delete(node);
+        }
+
+        virtual void UpdateNode(Int env_i, double reward) const {
+            Node* node = paths_[env_i].back();
+            double total_reward = node->total_reward.load(std::memory_order_relaxed);
+            while (!node->total_reward.compare_exchange_weak(total_reward, total_reward + reward, std::memory_order_relaxed));
+            node->num_visits.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void AddVirtualLoss(Node* node) const {
+            node->num_virtual_losses.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void RevertVirtualLoss(Node* node) const {
+            node->num_virtual_losses.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        // Computes the value of a child node using the UCB1 formula for a specified environment. In-flight visits of
+        // other workers are counted as visits with a reward of -virtual_loss.
+        //
+        // Parameters:
+        //   env_i: The index of environment.
+        //   child_i: The index of the child node.
+        //
+        // Return:
+        //   double: the value of the child node.
+        virtual double TreePolicy(Int env_i, Int child_i) {
+            Node* parent = paths_[env_i].back();
+            Node* child = parent->child(child_i);
+            if (child == nullptr)
+                return std::numeric_limits<double>::lowest();
+            Int num_virtual_losses = child->num_virtual_losses.load(std::memory_order_relaxed);
+            Int num_visits = child->num_visits.load(std::memory_order_relaxed) + num_virtual_losses;
+            if (num_visits == 0)
+                return std::numeric_limits<double>::max();
+            double mean_reward = (child->total_reward.load(std::memory_order_relaxed) - virtual_loss_ * num_virtual_losses) / num_visits;
+            Int total_num_visits = parent->num_visits.load(std::memory_order_relaxed) + parent->num_virtual_losses.load(std::memory_order_relaxed);
+            return UCB1(mean_reward, num_visits, std::max<Int>(total_num_visits, 1), coef_);
+        }
+
+        // Selects the next child node to explore based on the tree policy for a specified environment.
+        //
+        // Parameters:
+        //   env_i: The index of environment.
+        //
+        // Returns:
+        //   std::optional<Int>: The index of the child node with the highest UCB1 score. If the current node has no legal
+        //                       children, returns std::nullopt.
+        virtual std::optional<Int> SelectTreePolicy(Int env_i) {
+            Int best = kIntNull;
+            double best_score = std::numeric_limits<double>::lowest();
+            for (Int i=0; i<paths_[env_i].back()->size(); ++i) {
+                double score = TreePolicy(env_i, i);
+                if (score > best_score) {
+                    best = i;
+                    best_score = score;
+                }
+            }
+            if (best == kIntNull)
+                return std::nullopt;
+            return { best };
+        }
+
+        // Selects a child node to expand next from the current node's children for a specified environment.
+        //
+        // Parameters:
+        //   env_i: The index of environment.
+        //
+        // Returns:
+        //   std::optional<Int>: The index of the child node selected for expansion. If the current node has no legal children,
+        //                       returns std::nullopt.
+        virtual std::optional<Int> SelectToExpand(Int env_i) {
+            Int size = paths_[env_i].back()->size();
+            if (size == 0)
+                return std::nullopt;
+            return { rands_[env_i].Uniform(Int(0), size - 1) };
+        }
+
+        // Selects a child state randomly from the current state for a specified environment. This method is used during the
+        // simulation phase.
+        //
+        // Parameters:
+        //   env_i: The index of environment.
+        //
+        // Returns:
+        //   std::optional<Int>: The index of the randomly selected child node. If there is no legal child state available from
+        //                       the current state, returns std::nullopt.
+        virtual std::optional<Int> SelectRandom(Int env_i) {
+            Int num_children = NumChildStates(env_i);
+            if (num_children <= 0)
+                return std::nullopt;
+            return { rands_[env_i].Uniform(Int(0), num_children - 1) };
+        }
+
+        Int num_envs() const {
+            return paths_.size();
+        }
+
+        const Node* root() const {
+            return root_;
+        }
+
+        const std::vector<std::vector<Node*>>& paths() const {
+            return paths_;
+        }
+
+        double coef() const {
+            return coef_;
+        }
+
+        void set_coef(double coef) {
+            coef_ = coef;
+        }
+
+        double virtual_loss() const {
+            return virtual_loss_;
+        }
+
+        void set_virtual_loss(double virtual_loss) {
+            virtual_loss_ = virtual_loss;
+        }
+
+    protected:
+        double coef_;
+        double virtual_loss_;
+        std::atomic<Int> num_iters_{0};
+        Int max_num_iters_ = 0;
+        Node* root_ = nullptr;
+        std::vector<std::vector<Node*>> paths_;
+        std::vector<NodePool<Node>> node_pools_;
+        std::vector<Random> rands_;
+    };
+}
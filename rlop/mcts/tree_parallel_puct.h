@@ -0,0 +1,34 @@
+#pragma once
+#include "tree_parallel_mcts.h"
+
+namespace rlop {
+    class TreeParallelPUCT : public TreeParallelMCTS {
+    public:
+        TreeParallelPUCT(Int num_envs, double coef = std::sqrt(2), double virtual_loss = 1) : TreeParallelMCTS(num_envs, coef, virtual_loss) {}
+
+        virtual ~TreeParallelPUCT() = default;
+
+        // Pure virtual function to return the probability of selecting the child at index `child_i` 
+        // according to some policy, typically provided by a neural network or other predictive model.
+        //
+        // Parameters:
+        //   env_i: The index of environment.
+        //   child_i: The index of the child node for which the selection probability is requested.
+        //
+        // Returns:
+        //   double: The probability of selecting the child node at index `child_i`.
+        virtual double GetProb(Int env_i, Int child_i) = 0;
+
+        virtual double TreePolicy(Int env_i, Int child_i) override {
+            Node* parent = paths_[env_i].back();
+            Node* child = parent->child(child_i);
+            if (child == nullptr)
+                return std::numeric_limits<double>::lowest();
+            Int num_virtual_losses = child->num_virtual_losses.load(std::memory_order_relaxed);
+            Int num_visits = child->num_visits.load(std::memory_order_relaxed) + num_virtual_losses;
+            double mean_reward = num_visits == 0 ? 0 : (child->total_reward.load(std::memory_order_relaxed) - virtual_loss_ * num_virtual_losses) / num_visits;
+            Int total_num_visits = parent->num_visits.load(std::memory_order_relaxed) + parent->num_virtual_losses.load(std::memory_order_relaxed);
+            return mean_reward + coef_ * GetProb(env_i, child_i) * std::sqrt((double)total_num_visits) / (1.0 + num_visits);
+        }
+    };
+}
@@ -1,5 +1,9 @@
 #pragma once
 #include "rlop/common/base_algorithm.h"
+#include "rlop/common/timer.h"
+#include "move_list.h"
+#include "alpha_beta_statistics.h"
+#include <atomic>
 
 namespace rlop {
     // Implements the Alpha-Beta pruning algorithm, an optimization of the Minimax algorithm
@@ -31,8 +35,27 @@ namespace rlop {
         // Pure virtual function to check if the current game state is terminal (i.e., the game is over). 
         virtual bool IsTerminal() = 0;
 
-        // Pure virtual function to generate all possible moves from the current game state.
-        virtual std::vector<Int> GenerateMoves() = 0;
+        // Generates all possible moves from the current game state. A domain must override either this function or
+        // GenerateMoves(MoveList&), which is the one used by the search.
+        virtual std::vector<Int> GenerateMoves() {
+            MoveList moves;
+            GenerateMoves(moves);
+            std::vector<Int> result(moves.size());
+            for (Int i=0; i<moves.size(); ++i)
+                result[i] = moves[i];
+            return result;
+        }
+
+        // Generates all possible moves from the current game state into a list reused at each ply, so that the search
+        // does not allocate per node. The domain may give each move an ordering score, and the list is searched by
+        // decreasing score. The default implementation copies the moves of GenerateMoves() in order.
+        //
+        // Parameters:
+        //   moves: The list to fill, already cleared.
+        virtual void GenerateMoves(MoveList& moves) {
+            for (Int mv : GenerateMoves())
+                moves.Add(mv);
+        }
 
         // Pure virtual function tp make a move and updates the game state accordingly.
         //
@@ -52,6 +75,13 @@ namespace rlop {
         // Resets the algorithm.
         virtual void Reset() override {}
 
+        // Returns an independent copy of the search and its game state, used by parallel searches to give each thread
+        // its own state. The copy should share the transposition table of the original. Searches which do not support
+        // parallelism need not override it.
+        virtual std::unique_ptr<AlphaBetaSearch> Clone() const {
+            throw std::runtime_error("AlphaBetaSearch: Clone() is not implemented by this search.");
+        }
+
         // Implements the Alpha-Beta pruning algorithm for a given depth, alpha, and beta values.
         //
         // Parameters:
@@ -62,18 +92,27 @@ namespace rlop {
         // Returns:
         //   double: The value of the node.
         virtual double AlphaBeta(Int depth, double alpha, double beta) {
-            if (depth == 0 || IsTerminal())
+            if (Stopped())
+                return 0;
+            if (depth == 0 || IsTerminal()) {
+                CountLeaf();
                 return Evaluate();
+            }
             double value = -max_score_;
-            std::vector<Int> moves = GenerateMoves();
-            for (Int mv : moves) {
+            Int num_searched = 0;
+            MoveList& moves = NextMoves(kIntNull);
+            for (Int i=0; i<moves.size(); ++i) {
+                Int mv = moves[i];
                 if (!MakeMove(mv)) 
                     continue;
-                value = std::max(value, -AlphaBeta(depth - 1, -beta, -alpha));
+                value = std::max(value, ChildValue(depth, alpha, beta, num_searched++ == 0));
                 UndoMove(mv);
                 alpha = std::max(alpha, value);
-                if (alpha >= beta) 
+                if (alpha >= beta) {
+                    CountCutoff(num_searched == 1);
+                    UpdateCutoff(mv, depth);
                     break;
+                }
             }
             return value;
         }
@@ -88,30 +127,409 @@ namespace rlop {
         // Returns:
         //   std::pair<Int, double>: The best move and its value. If no move is found, returns {kIntNull, best_value}.
         virtual std::pair<Int, double> Search(Int depth, double alpha = std::numeric_limits<double>::lowest(), double beta = std::numeric_limits<double>::max()) {
-            if (depth == 0 || IsTerminal())
+            if (depth == 0 || IsTerminal()) {
+                CountLeaf();
                 return { kIntNull, Evaluate() };
+            }
             alpha = std::max(-max_score_, alpha);
             beta = std::min(max_score_, beta); 
             Int best_mv = kIntNull;
             double best_value = -max_score_;
-            std::vector<Int> moves = GenerateMoves();
-            for (Int mv : moves) {
+            ply_ = 0;
+            Int num_searched = 0;
+            MoveList& moves = NextMoves(root_move_hint_);
+            for (Int i=0; i<moves.size(); ++i) {
+                Int mv = moves[i];
                 if (!MakeMove(mv))
                     continue;
-                double value = -AlphaBeta(depth - 1, -beta, -alpha);
+                double value = ChildValue(depth, alpha, beta, num_searched++ == 0);
                 UndoMove(mv);
-                if (value > best_value) {
+                if (value > best_value || best_mv == kIntNull) {
                     best_value = value;
                     best_mv = mv;
                 }
                 alpha = std::max(alpha, best_value);
-                if (alpha >= beta) 
+                if (alpha >= beta) {
+                    CountCutoff(num_searched == 1);
                     break;
+                }
             } 
             return { best_mv, best_value }; 
         }
 
+        // Searches one depth from the current game state. With an aspiration window and the value of a previous search,
+        // the search starts with a narrow window around that value and widens it on the side which failed, doubling its
+        // width at each failure. Otherwise the full window is searched.
+        //
+        // Parameters:
+        //   depth: The maximum depth of the search tree to explore.
+        //   guess: The expected value, typically the value of the previous iteration, or std::nullopt.
+        //
+        // Returns:
+        //   std::pair<Int, double>: The best move and its value.
+        virtual std::pair<Int, double> SearchIteration(Int depth, std::optional<double> guess) {
+            if (!guess || aspiration_window_ <= 0)
+                return Search(depth);
+            double delta = aspiration_window_;
+            double alpha = std::max(*guess - delta, -max_score_);
+            double beta = std::min(*guess + delta, max_score_);
+            while (true) {
+                auto result = Search(depth, alpha, beta);
+                if (stopped_)
+                    return result;
+                if (result.second <= alpha && alpha > -max_score_) {
+                    delta *= 2;
+                    alpha = std::max(*guess - delta, -max_score_);
+                }
+                else if (result.second >= beta && beta < max_score_) {
+                    delta *= 2;
+                    beta = std::min(*guess + delta, max_score_);
+                }
+                else
+                    return result;
+            }
+        }
+
+        // Clears the stop of a deadline and the count of nodes of the previous search. It is called at the start of
+        // every top-level search, by IterativeDeepening() and before a search with SearchDepth() or Search() alone.
+        void StartSearch() {
+            stopped_ = false;
+            num_nodes_ = 0;
+        }
+
+        // Searches one depth through SearchIteration() and, when the statistics are enabled, records its nodes and
+        // time as an iteration of the statistics.
+        //
+        // Parameters:
+        //   depth: The maximum depth of the search tree to explore.
+        //   guess: The expected value, typically the value of the previous iteration, or std::nullopt.
+        //
+        // Returns:
+        //   std::pair<Int, double>: The best move and its value.
+        std::pair<Int, double> SearchDepth(Int depth, std::optional<double> guess = std::nullopt) {
+            if (!statistics_enabled_)
+                return SearchIteration(depth, guess);
+            Int start_nodes = num_nodes_;
+            auto start = std::chrono::steady_clock::now();
+            auto result = SearchIteration(depth, guess);
+            AlphaBetaStatistics::Iteration iteration;
+            iteration.depth = depth;
+            iteration.num_nodes = num_nodes_ - start_nodes;
+            iteration.time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            const auto& iterations = statistics_.iterations;
+            if (!iterations.empty() && iterations.back().depth == depth - 1 && iterations.back().num_nodes > 0)
+                iteration.branching_factor = iteration.num_nodes / (double)iterations.back().num_nodes;
+            statistics_.num_nodes += iteration.num_nodes;
+            statistics_.search_time += iteration.time;
+            statistics_.iterations.push_back(iteration);
+            return result;
+        }
+
+        // Searches with increasing depths until the maximum depth or a wall-clock deadline is reached. Each iteration
+        // tries the best move of the previous one first and is guided by its value through SearchIteration(), and a
+        // search interrupted by the deadline is discarded. The iterations of the statistics are those of the last call.
+        //
+        // Parameters:
+        //   max_depth: The maximum depth of the search tree to explore.
+        //   max_duration: The maximum duration of the search in milliseconds.
+        //   min_depth: The depth of the first iteration.
+        //
+        // Returns:
+        //   std::pair<Int, double>: The best move and its value found by the deepest completed iteration. If no
+        //                           iteration completed, returns {kIntNull, -max_score}.
+        virtual std::pair<Int, double> IterativeDeepening(Int max_depth, Int max_duration = kIntFull, Int min_depth = 1) {
+            max_duration_ = max_duration;
+            StartSearch();
+            timer_.Restart();
+            statistics_.iterations.clear();
+            std::pair<Int, double> best = { kIntNull, -max_score_ };
+            for (Int depth=std::max<Int>(min_depth, 1); depth<=max_depth; ++depth) {
+                root_move_hint_ = best.first;
+                auto result = SearchDepth(depth, best.first == kIntNull ? std::nullopt : std::optional<double>(best.second));
+                if (stopped_)
+                    break;
+                best = result;
+                completed_depth_ = depth;
+                if (std::abs(best.second) >= max_score_ || result.first == kIntNull)
+                    break;
+            }
+            timer_.Stop();
+            root_move_hint_ = kIntNull;
+            max_duration_ = kIntFull;
+            return best;
+        }
+
+        // Orders the generated moves by decreasing score, then moves a hinted move, typically the best move of a
+        // previous search, to the front.
+        //
+        // Parameters:
+        //   moves: The generated moves.
+        //   hint: The move to try first, or kIntNull.
+        virtual void OrderMoves(MoveList& moves, Int hint) {
+            if (history_weight_ > 0) {
+                for (Int i=0; i<moves.size(); ++i)
+                    moves.set_score(i, moves.score(i) + history_weight_ * HistoryScore(moves[i]));
+            }
+            moves.Sort();
+            if (killer_moves_ && ply_ < killers_.size()) {
+                for (Int k=kNumKillers - 1; k>=0; --k) {
+                    if (killers_[ply_][k] != kIntNull)
+                        moves.MoveToFront(killers_[ply_][k]);
+                }
+            }
+            if (hint != kIntNull)
+                moves.MoveToFront(hint);
+        }
+
+        // Maps a move to its entry in the history table, e.g. a move of a board game to the square it is played on.
+        // The default implementation uses the move itself, which must then be non-negative.
+        //
+        // Parameters:
+        //   move: A move of the current game state.
+        //
+        // Returns:
+        //   Int: The non-negative index of the move in the history table.
+        virtual Int HistoryIndex(Int move) {
+            return move;
+        }
+
+        // Returns the history score of a move of the current game state, the sum of depth * depth over the nodes where
+        // it caused a beta cutoff. The scores of the two players are kept apart by the parity of the ply.
+        double HistoryScore(Int move) {
+            const auto& history = history_[ply_ & 1];
+            Int i = HistoryIndex(move);
+            return i < history.size() ? history[i] : 0;
+        }
+
+        // Records a move which caused a beta cutoff in the killer slots of the current ply and in the history table.
+        //
+        // Parameters:
+        //   move: The move which caused the cutoff.
+        //   depth: The depth of the node.
+        virtual void UpdateCutoff(Int move, Int depth) {
+            if (stopped_)
+                return;
+            if (killer_moves_) {
+                while (killers_.size() <= ply_)
+                    killers_.push_back(EmptyKillers());
+                auto& killers = killers_[ply_];
+                if (killers[0] != move) {
+                    for (Int k=kNumKillers - 1; k>0; --k)
+                        killers[k] = killers[k - 1];
+                    killers[0] = move;
+                }
+            }
+            if (history_weight_ > 0) {
+                auto& history = history_[ply_ & 1];
+                Int i = HistoryIndex(move);
+                if (i >= history.size())
+                    history.resize(i + 1, 0);
+                history[i] += double(depth) * depth;
+            }
+        }
+
+        // Forgets the killer moves and the history table, typically before searching an unrelated game state.
+        void ClearMoveHistory() {
+            killers_.clear();
+            history_[0].clear();
+            history_[1].clear();
+        }
+
+        // Generates and orders the moves of the current ply into the list of that ply.
+        //
+        // Parameters:
+        //   hint: The move to try first, or kIntNull.
+        //
+        // Returns:
+        //   MoveList&: The ordered moves.
+        MoveList& NextMoves(Int hint) {
+            while (move_lists_.size() <= ply_)
+                move_lists_.emplace_back(kMoveListCapacity);
+            MoveList& moves = move_lists_[ply_];
+            moves.Clear();
+            GenerateMoves(moves);
+            OrderMoves(moves, hint);
+            return moves;
+        }
+
+        // Searches a child of the current node one ply deeper.
+        double Child(Int depth, double alpha, double beta) {
+            ++ply_;
+            double value = AlphaBeta(depth - 1, alpha, beta);
+            --ply_;
+            return value;
+        }
+
+        // Searches a child and returns its value from the point of view of the current node. With principal variation
+        // search, only the first move is searched with the full window. The other moves are searched with a null
+        // window which only proves that they are not better than alpha, and are searched again with the full window
+        // when the proof fails.
+        //
+        // Parameters:
+        //   depth: The depth of the current node.
+        //   alpha: The alpha value of the current node.
+        //   beta: The beta value of the current node.
+        //   first: Whether the child is the first one searched.
+        //
+        // Returns:
+        //   double: The value of the child, negated.
+        double ChildValue(Int depth, double alpha, double beta, bool first) {
+            if (!pvs_ || first)
+                return -Child(depth, -beta, -alpha);
+            double value = -Child(depth, -alpha - score_resolution_, -alpha);
+            if (value > alpha && value < beta)
+                value = -Child(depth, -beta, -alpha);
+            return value;
+        }
+
+        // Counts a leaf in the statistics.
+        void CountLeaf() {
+            if (statistics_enabled_)
+                ++statistics_.num_leaves;
+        }
+
+        // Counts a beta cutoff in the statistics.
+        //
+        // Parameters:
+        //   first: Whether the cutoff was caused by the first move searched.
+        void CountCutoff(bool first) {
+            if (statistics_enabled_) {
+                ++statistics_.num_cutoffs;
+                statistics_.num_first_move_cutoffs += first;
+            }
+        }
+
+        // Checks whether the deadline of the current search has passed or the stop signal was raised. Both are only
+        // checked every 1024 nodes.
+        virtual bool Stopped() {
+            ++num_nodes_;
+            if (!stopped_ && (num_nodes_ & 1023) == 0) {
+                if (stop_signal_ != nullptr && stop_signal_->load(std::memory_order_relaxed))
+                    stopped_ = true;
+                else if (max_duration_ != kIntFull)
+                    stopped_ = timer_.Elapsed() >= max_duration_;
+            }
+            return stopped_;
+        }
+
+        // Sets a flag which interrupts the search when raised, typically by another thread. The flag must outlive the
+        // searches, and nullptr removes it.
+        void set_stop_signal(const std::atomic<bool>* stop_signal) {
+            stop_signal_ = stop_signal;
+        }
+
+        // Enables principal variation search, which searches the moves after the first one with a null window.
+        void set_pvs(bool pvs) {
+            pvs_ = pvs;
+        }
+
+        bool pvs() const {
+            return pvs_;
+        }
+
+        // Sets the half width of the initial aspiration window of IterativeDeepening(), 0 to disable it.
+        void set_aspiration_window(double aspiration_window) {
+            aspiration_window_ = aspiration_window;
+        }
+
+        double aspiration_window() const {
+            return aspiration_window_;
+        }
+
+        // Enables the killer moves: the last moves which caused a beta cutoff at each ply are tried right after the
+        // hinted move at the same ply.
+        void set_killer_moves(bool killer_moves) {
+            killer_moves_ = killer_moves;
+        }
+
+        bool killer_moves() const {
+            return killer_moves_;
+        }
+
+        // Sets the weight of the history scores added to the ordering scores of the domain, 0 to disable the history
+        // table.
+        void set_history_weight(double history_weight) {
+            history_weight_ = history_weight;
+        }
+
+        double history_weight() const {
+            return history_weight_;
+        }
+
+        // Sets the smallest difference between two distinct scores, which is the width of the null windows. It must
+        // not exceed the difference between any two scores of the game, e.g. 1 when the scores are integers.
+        void set_score_resolution(double score_resolution) {
+            score_resolution_ = score_resolution;
+        }
+
+        double score_resolution() const {
+            return score_resolution_;
+        }
+
+        bool statistics_enabled() const {
+            return statistics_enabled_;
+        }
+
+        // Enables collecting the statistics of the following searches. When disabled, the counters cost a branch.
+        void set_statistics_enabled(bool statistics_enabled) {
+            statistics_enabled_ = statistics_enabled;
+        }
+
+        const AlphaBetaStatistics& statistics() const {
+            return statistics_;
+        }
+
+        void ClearStatistics() {
+            statistics_.Clear();
+        }
+
+        // Accumulates the statistics of another search into those of this one, such as of the helpers of Lazy SMP.
+        void MergeStatistics(const AlphaBetaStatistics& statistics) {
+            statistics_.Merge(statistics);
+        }
+
+        // Returns the depth of the last iteration completed by IterativeDeepening().
+        Int completed_depth() const {
+            return completed_depth_;
+        }
+
+        Int num_nodes() const {
+            return num_nodes_;
+        }
+
+        // Returns the distance of the current node from the root.
+        Int ply() const {
+            return ply_;
+        }
+
     protected:
+        static constexpr Int kMoveListCapacity = 64;
+        static constexpr Int kNumKillers = 2;
+
+        static std::array<Int, kNumKillers> EmptyKillers() {
+            std::array<Int, kNumKillers> killers;
+            killers.fill(kIntNull);
+            return killers;
+        }
+
         double max_score_; 
+        Int ply_ = 0;
+        std::deque<MoveList> move_lists_; // One list per ply, in a deque so that growing it keeps references valid.
+        Int max_duration_ = kIntFull;
+        Int root_move_hint_ = kIntNull;
+        bool pvs_ = false;
+        double aspiration_window_ = 0;
+        double score_resolution_ = 1e-6;
+        bool killer_moves_ = false;
+        double history_weight_ = 0;
+        std::vector<std::array<Int, kNumKillers>> killers_; // The killer moves of each ply, the most recent first.
+        std::array<std::vector<double>, 2> history_; // The history scores by ply parity and history index.
+        bool statistics_enabled_ = false;
+        AlphaBetaStatistics statistics_;
+        Int completed_depth_ = 0;
+        Int num_nodes_ = 0;
+        bool stopped_ = false;
+        const std::atomic<bool>* stop_signal_ = nullptr;
+        Timer<> timer_;
     };
 }
\ No newline at end of file
@@ -8,6 +8,14 @@ namespace rlop {
     template<typename TKey>
     class AlphaBetaSearchTrans : public AlphaBetaSearch {
     public:
+        // An entry found in the transposition table. An entry searched at an insufficient depth is returned with the
+        // type kNone, so that only its best move is used.
+        struct TableEntry {
+            double value = 0;
+            ValueType type = ValueType::kNone;
+            Int move = kIntNull;
+        };
+
         // Constructor: Initializes the AlphaBeta search with a maximum score value.
         //
         // Parameters:
@@ -19,18 +27,18 @@ namespace rlop {
         // Pure virtual function to encode the current position into a key of type TKey for transposition table entries
         virtual TKey PositionEncode() = 0;
 
-        // Pure virtual function to attempt to retrieve a value and its type from the transposition table using the given
-        // key and depth. This method is used to check if the current position (encoded as a key) at a specific depth has 
-        // been previously evaluated and stored in the transposition table.
+        // Pure virtual function to attempt to retrieve a value, its type and the best move from the transposition table
+        // using the given key and depth. This method is used to check if the current position (encoded as a key) at a
+        // specific depth has been previously evaluated and stored in the transposition table.
         //
         // Parameters:
         //   key: The encoded key representing the current game state.
         //   depth: The depth of the search at which the game state is evaluated.
         //
         // Returns:
-        //   std::optional<std::pair<double, ValueType>>: An optional containing the value and its type if the position
-        //                                                is found in the table; std::nullopt otherwise.
-        virtual std::optional<std::pair<double, ValueType>> Transpose(const TKey& key, Int depth) = 0;
+        //   std::optional<TableEntry>: An optional containing the entry if the position is found in the table, with the
+        //                              type kNone if it was searched at a lower depth; std::nullopt otherwise.
+        virtual std::optional<TableEntry> Transpose(const TKey& key, Int depth) = 0;
 
         // Pure virtual function to update the transposition table with a new value, its type, and the corresponding key
         // and depth. This method is called after evaluating a position to store the result for future reference, potentially
@@ -41,11 +49,12 @@ namespace rlop {
         //   depth: The depth at which the value was evaluated.
         //   value: The evaluated value of the position.
         //   type: The type of the value (exact, lower bound, or upper bound).
-        virtual void UpdateTable(const TKey& key, Int depth, double value, ValueType type) = 0;
+        //   move: The best move found, or kIntNull.
+        virtual void UpdateTable(const TKey& key, Int depth, double value, ValueType type, Int move) = 0;
 
         // Overrides the AlphaBeta method to integrate transposition table lookups and updates, enhancing the search efficiency 
         // by reusing results of previously evaluated positions. This implementation checks the transposition table before 
-        // proceeding with the standard AlphaBeta search logic. There is a discussion on how to combine negamax and transposition 
+        // proceeding with the standard AlphaBeta search logic, and tries the best move stored in the table first. There is a discussion on how to combine negamax and transposition 
         // table correctly: https://en.wikipedia.org/wiki/Talk:Negamax.
         //
         // Parameters:
@@ -56,42 +65,130 @@ namespace rlop {
         // Returns:
         //   double: The evaluated value of the current position.
         virtual double AlphaBeta(Int depth, double alpha, double beta) override {
+            if (Stopped())
+                return 0;
             double origin_alpha = alpha;
             TKey key = PositionEncode();
             auto trans = Transpose(key, depth);
+            if (statistics_enabled_) {
+                ++statistics_.num_probes;
+                if (trans)
+                    ++statistics_.num_hits[static_cast<Int>(trans->type)];
+            }
+            Int hint = kIntNull;
             if (trans) {
-                auto [value, type] = *trans;
-                if (type == ValueType::kExact) 
-                    return value;
-                else if (type == ValueType::kLowerBound)
-                    alpha = std::max(alpha, value);
-                else if (type == ValueType::kUpperBound)
-                    beta = std::min(beta, value);
+                hint = trans->move;
+                if (trans->type == ValueType::kExact) 
+                    return trans->value;
+                else if (trans->type == ValueType::kLowerBound)
+                    alpha = std::max(alpha, trans->value);
+                else if (trans->type == ValueType::kUpperBound)
+                    beta = std::min(beta, trans->value);
                 if (alpha >= beta) 
-                    return value;
+                    return trans->value;
             }
-            if (depth == 0 || IsTerminal())
+            if (depth == 0 || IsTerminal()) {
+                CountLeaf();
                 return Evaluate();
+            }
             double value = -max_score_;
-            std::vector<Int> moves = GenerateMoves();
-            for (Int mv : moves) {
+            Int best_mv = kIntNull;
+            Int num_searched = 0;
+            MoveList& moves = NextMoves(hint);
+            for (Int i=0; i<moves.size(); ++i) {
+                Int mv = moves[i];
                 if (!MakeMove(mv)) 
                     continue;
-                value = std::max(value, -AlphaBeta(depth - 1, -beta, -alpha));
+                double child_value = ChildValue(depth, alpha, beta, num_searched++ == 0);
                 UndoMove(mv);
+                if (child_value > value || best_mv == kIntNull) {
+                    value = std::max(value, child_value);
+                    best_mv = mv;
+                }
                 alpha = std::max(alpha, value);
-                if (alpha >= beta) 
+                if (alpha >= beta) {
+                    CountCutoff(num_searched == 1);
+                    UpdateCutoff(mv, depth);
                     break;
+                }
             }
+            if (stopped_)
+                return value;
             ValueType type;
             if (value <= origin_alpha)
                 type = ValueType::kUpperBound;
-            if (value >= beta)
+            else if (value >= beta)
                 type = ValueType::kLowerBound;
             else
                 type = ValueType::kExact;
-            UpdateTable(key, depth, value, type);
+            if (statistics_enabled_)
+                ++statistics_.num_stores[static_cast<Int>(type)];
+            UpdateTable(key, depth, value, type, best_mv);
             return value;
         }
+
+        // Finds the value of the current game state by MTD(f): a sequence of null window searches which converge to
+        // the value from a first guess, each one relying on the transposition table to skip the work of the previous
+        // ones. The closer the guess, the fewer searches are needed.
+        //
+        // Parameters:
+        //   depth: The maximum depth of the search tree to explore.
+        //   guess: The first guess of the value, typically the value of the previous iteration.
+        //
+        // Returns:
+        //   std::pair<Int, double>: The best move and its value.
+        std::pair<Int, double> MTDF(Int depth, double guess) {
+            double lower = -max_score_;
+            double upper = max_score_;
+            double value = std::clamp(guess, lower, upper);
+            Int best_mv = kIntNull;
+            Int hint = root_move_hint_;
+            while (lower < upper) {
+                double beta = std::max(value, lower + score_resolution_);
+                auto result = Search(depth, beta - score_resolution_, beta);
+                if (stopped_)
+                    break;
+                value = result.second;
+                if (value < beta)
+                    upper = value;
+                else {
+                    // Only a failing high search proves its move, the others may return any move.
+                    lower = value;
+                    best_mv = result.first;
+                    root_move_hint_ = best_mv;
+                }
+                if (best_mv == kIntNull && upper <= lower)
+                    best_mv = result.first;
+            }
+            root_move_hint_ = hint;
+            return { best_mv, value };
+        }
+
+        // Searches one depth by MTD(f) when it is enabled, guessing 0 without a previous value. Otherwise searches as
+        // AlphaBetaSearch does.
+        //
+        // Parameters:
+        //   depth: The maximum depth of the search tree to explore.
+        //   guess: The expected value, typically the value of the previous iteration, or std::nullopt.
+        //
+        // Returns:
+        //   std::pair<Int, double>: The best move and its value.
+        virtual std::pair<Int, double> SearchIteration(Int depth, std::optional<double> guess) override {
+            if (mtdf_)
+                return MTDF(depth, guess.value_or(0));
+            return AlphaBetaSearch::SearchIteration(depth, guess);
+        }
+
+        // Enables MTD(f) for the iterations of IterativeDeepening() and for SearchIteration().
+        void set_mtdf(bool mtdf) {
+            mtdf_ = mtdf;
+        }
+
+        bool mtdf() const {
+            return mtdf_;
+        }
+
+    protected:
+        bool mtdf_ = false;
     };
 }
\ No newline at end of file
@@ -0,0 +1,84 @@
+#pragma once
+#include <chrono>
+#include "rlop/common/typedef.h"
+
+namespace rlop {
+    // Statistics gathered by the alpha-beta searches when statistics collection is enabled. Counters are cumulative
+    // over the searches since the last Clear(), and times are in nanoseconds. The transposition table counters are
+    // indexed by AlphaBetaSearch::ValueType: exact, lower bound, upper bound, and none for an entry too shallow to be
+    // used for anything but its move.
+    struct AlphaBetaStatistics {
+        // One depth searched by AlphaBetaSearch::SearchDepth().
+        struct Iteration {
+            Int depth = 0;
+            Int num_nodes = 0;
+            Int time = 0;
+            double branching_factor = 0; // The ratio of its nodes to the nodes of the previous depth, 0 for the first.
+        };
+
+        Int num_nodes = 0;
+        Int num_leaves = 0;
+        Int search_time = 0;
+        Int num_probes = 0;
+        std::array<Int, 4> num_hits = {};
+        std::array<Int, 4> num_stores = {};
+        Int num_cutoffs = 0;
+        Int num_first_move_cutoffs = 0;
+        std::vector<Iteration> iterations;
+
+        void Clear() {
+            *this = AlphaBetaStatistics();
+        }
+
+        // Accumulates the statistics of another search, typically of another thread. The iterations are those of the
+        // deepest of both.
+        void Merge(const AlphaBetaStatistics& other) {
+            num_nodes += other.num_nodes;
+            num_leaves += other.num_leaves;
+            search_time = std::max(search_time, other.search_time);
+            num_probes += other.num_probes;
+            for (Int i=0; i<num_hits.size(); ++i) {
+                num_hits[i] += other.num_hits[i];
+                num_stores[i] += other.num_stores[i];
+            }
+            num_cutoffs += other.num_cutoffs;
+            num_first_move_cutoffs += other.num_first_move_cutoffs;
+            if (!other.iterations.empty() && (iterations.empty() || other.iterations.back().depth > iterations.back().depth))
+                iterations = other.iterations;
+        }
+
+        double NodesPerSecond() const {
+            return search_time == 0 ? 0 : num_nodes * 1e9 / search_time;
+        }
+
+        Int TotalHits() const {
+            return std::accumulate(num_hits.begin(), num_hits.end(), Int(0));
+        }
+
+        Int TotalStores() const {
+            return std::accumulate(num_stores.begin(), num_stores.end(), Int(0));
+        }
+
+        double HitRate() const {
+            return num_probes == 0 ? 0 : TotalHits() / (double)num_probes;
+        }
+
+        // Returns the fraction of the beta cutoffs caused by the first move searched, a measure of the move ordering.
+        double FirstMoveCutoffRate() const {
+            return num_cutoffs == 0 ? 0 : num_first_move_cutoffs / (double)num_cutoffs;
+        }
+
+        std::string ToString() const {
+            std::stringstream ss;
+            ss << "nodes: " << num_nodes << "\t" << "leaves: " << num_leaves << "\t" << "nodes/s: " << NodesPerSecond() << "\t"
+               << "search(ms): " << search_time / 1e6 << "\t" << "probes: " << num_probes << "\t" << "hit rate: " << HitRate() << "\t"
+               << "hits(exact/lower/upper/move): " << num_hits[0] << "/" << num_hits[1] << "/" << num_hits[2] << "/" << num_hits[3] << "\t"
+               << "stores(exact/lower/upper): " << num_stores[0] << "/" << num_stores[1] << "/" << num_stores[2] << "\t"
+               << "cutoffs: " << num_cutoffs << "\t" << "first move cutoffs: " << FirstMoveCutoffRate();
+            for (const auto& iteration : iterations)
+                ss << "\n" << "depth: " << iteration.depth << "\t" << "nodes: " << iteration.num_nodes << "\t"
+                   << "time(ms): " << iteration.time / 1e6 << "\t" << "branching factor: " << iteration.branching_factor;
+            return ss.str();
+        }
+    };
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include "alpha_beta_search.h"
+#include "rlop/common/thread_pool.h"
+
+namespace rlop {
+    // Implements Lazy SMP, a parallel alpha-beta search where helper threads run the same iterative deepening as the
+    // main thread on their own copy of the game state. The threads only communicate through a shared transposition
+    // table, which must therefore be thread-safe, such as LocklessTransposition. Helpers fill the table with results
+    // the main thread reuses, and half of them start one ply deeper so that the threads spread over different depths.
+    //
+    // The copies are created with AlphaBetaSearch::Clone(), which must return a search with its own game state and
+    // the transposition table of the original.
+    //
+    // The helpers run as tasks of the shared ThreadPool, so there are at most as many of them as the workers of the
+    // pool, and a helper which only starts after the main thread is done is skipped.
+    class LazySMP {
+    public:
+        // Constructs a LazySMP search.
+        //
+        // Parameters:
+        //   num_threads: The maximum number of threads, including the main thread.
+        LazySMP(Int num_threads) : num_threads_(std::max<Int>(num_threads, 1)) {}
+
+        virtual ~LazySMP() = default;
+
+        // Searches from the current state of a search with all threads. Only the result of the main thread is
+        // returned, and the helpers are stopped as soon as the main thread finishes. When the statistics of the search
+        // are enabled, those of the helpers are merged into them.
+        //
+        // Parameters:
+        //   search: The search of the main thread, set to the state to search from.
+        //   max_depth: The maximum depth of the iterative deepening.
+        //   max_duration: The maximum duration of the search in milliseconds.
+        //
+        // Returns:
+        //   std::pair<Int, double>: The best move and its value found by the main thread.
+        virtual std::pair<Int, double> Search(AlphaBetaSearch& search, Int max_depth, Int max_duration = kIntFull) {
+            ThreadPool& pool = ThreadPool::Global();
+            Int num_helpers = std::min<Int>(num_threads_ - 1, pool.num_workers());
+            if (num_helpers == 0)
+                return search.IterativeDeepening(max_depth, max_duration);
+            helpers_.clear();
+            for (Int i=1; i<=num_helpers; ++i)
+                helpers_.push_back(search.Clone());
+            std::atomic<bool> stop_signal(false);
+            for (auto& helper : helpers_) {
+                helper->set_stop_signal(&stop_signal);
+                helper->ClearStatistics();
+            }
+            std::pair<Int, double> result;
+            {
+                TaskGroup group(pool);
+                for (Int i=1; i<=num_helpers; ++i) {
+                    group.Run([&, i]() {
+                        if (!stop_signal.load(std::memory_order_relaxed))
+                            helpers_[i - 1]->IterativeDeepening(max_depth, max_duration, 1 + i % 2);
+                    });
+                }
+                result = search.IterativeDeepening(max_depth, max_duration);
+                stop_signal.store(true, std::memory_order_relaxed);
+                group.Wait();
+            }
+            for (auto& helper : helpers_) {
+                helper->set_stop_signal(nullptr);
+                if (search.statistics_enabled())
+                    search.MergeStatistics(helper->statistics());
+            }
+            return result;
+        }
+
+        Int num_threads() const {
+            return num_threads_;
+        }
+
+        void set_num_threads(Int num_threads) {
+            num_threads_ = std::max<Int>(num_threads, 1);
+        }
+
+        // Returns the helpers of the last search.
+        const std::vector<std::unique_ptr<AlphaBetaSearch>>& helpers() const {
+            return helpers_;
+        }
+
+    protected:
+        Int num_threads_;
+        std::vector<std::unique_ptr<AlphaBetaSearch>> helpers_;
+    };
+}
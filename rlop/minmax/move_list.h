@@ -0,0 +1,92 @@
+#pragma once
+#include "rlop/common/typedef.h"
+
+namespace rlop {
+    // A list of moves and their ordering scores, reused from node to node so that move generation does not allocate
+    // once the list has reached its working capacity. AlphaBetaSearch keeps one list per ply.
+    class MoveList {
+    public:
+        struct ScoredMove {
+            Int move;
+            double score;
+        };
+
+        // Constructs an empty list.
+        //
+        // Parameters:
+        //   capacity: The number of moves reserved up front.
+        MoveList(Int capacity = 0) {
+            moves_.reserve(capacity);
+        }
+
+        // Removes all moves, keeping the capacity.
+        void Clear() {
+            moves_.clear();
+        }
+
+        // Appends a move.
+        //
+        // Parameters:
+        //   move: The move.
+        //   score: The ordering score of the move, the higher the earlier it is searched once sorted.
+        void Add(Int move, double score = 0) {
+            moves_.push_back({ move, score });
+        }
+
+        // Sorts the moves by decreasing score. The sort is stable, so moves of equal score keep their generation
+        // order. Insertion sort is used since move lists are short.
+        void Sort() {
+            for (Int i=1; i<size(); ++i) {
+                ScoredMove scored_move = moves_[i];
+                Int j = i - 1;
+                for (; j >= 0 && moves_[j].score < scored_move.score; --j)
+                    moves_[j + 1] = moves_[j];
+                moves_[j + 1] = scored_move;
+            }
+        }
+
+        // Moves a move to the front of the list and keeps the order of the other moves.
+        //
+        // Parameters:
+        //   move: The move to bring to the front.
+        //
+        // Returns:
+        //   bool: Returns true if the move is in the list.
+        bool MoveToFront(Int move) {
+            for (Int i=0; i<size(); ++i) {
+                if (moves_[i].move == move) {
+                    std::rotate(moves_.begin(), moves_.begin() + i, moves_.begin() + i + 1);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        Int operator[](Int i) const {
+            return moves_[i].move;
+        }
+
+        double score(Int i) const {
+            return moves_[i].score;
+        }
+
+        void set_score(Int i, double score) {
+            moves_[i].score = score;
+        }
+
+        Int size() const {
+            return moves_.size();
+        }
+
+        bool empty() const {
+            return moves_.empty();
+        }
+
+        const std::vector<ScoredMove>& moves() const {
+            return moves_;
+        }
+
+    protected:
+        std::vector<ScoredMove> moves_;
+    };
+}
@@ -1,7 +1,15 @@
 #pragma once
+#include <atomic>
+#include <cstring>
 #include "alpha_beta_search_trans.h"
+#include <mutex>
+#include "rlop/common/memory_tracker.h"
+#include "rlop/common/mapped_file.h"
 
 namespace rlop {
+    template<typename TKey>
+    class TranspositionBook;
+
     template<typename TKey>
     class CircularTransposition {
     public:
@@ -12,9 +20,15 @@ namespace rlop {
             Int depth;
             double value;
             Type type = Type::kNone;
+            Int move = kIntNull;
         };
 
-        CircularTransposition(size_t size) : vec_(size) {}
+        // Constructs a table of `size` entries, or fewer if they would exceed the memory budget of the transposition
+        // tables in the MemoryTracker.
+        CircularTransposition(size_t size) : memory_usage_(kMemoryTag) {
+            vec_.resize(memory_usage_.Fit(size, sizeof(Item)));
+            memory_usage_.Set(vec_.size() * sizeof(Item));
+        }
 
         virtual ~CircularTransposition() = default;
 
@@ -34,11 +48,513 @@ namespace rlop {
             return vec_[key % vec_.size()];
         }
 
-        const std::vector<Int>& vec() const {
+        const std::vector<Item>& vec() const {
             return vec_;
         } 
 
+        MemoryUsage& memory_usage() {
+            return memory_usage_;
+        }
+
+        static constexpr const char* kMemoryTag = "transposition";
+
     protected:
+        MemoryUsage memory_usage_;
         std::vector<Item> vec_;
     };
-}
\ No newline at end of file
+}
+namespace rlop {
+    // A transposition table which can be shared by several searching threads without locks. Each entry is packed into
+    // two 64-bit words, the data and the key xor-ed with the data, so that an entry torn by concurrent writes decodes to a
+    // wrong lock and is treated as a miss instead of returning mixed data. The value is stored as a float, the depth is
+    // saturated at 65535, which is read back as kIntFull, and moves must lie in [0, 8190].
+    //
+    // Template Parameters:
+    //   TKey: The type of the keys, an integral type of at most 64 bits.
+    template<typename TKey>
+    class LocklessTransposition {
+    public:
+        static_assert(std::is_integral_v<TKey> && sizeof(TKey) <= sizeof(uint64_t), "LocklessTransposition: keys must be integers of at most 64 bits.");
+
+        using Type = typename AlphaBetaSearch::ValueType;
+        using Item = typename CircularTransposition<TKey>::Item;
+
+        // Constructs a table of `size` entries, or fewer if they would exceed the memory budget of the transposition
+        // tables in the MemoryTracker.
+        LocklessTransposition(size_t size) : memory_usage_(kMemoryTag) {
+            size_ = memory_usage_.Fit(size, sizeof(Entry));
+            entries_.reset(new Entry[size_]);
+            memory_usage_.Set(size_ * sizeof(Entry));
+            Reset();
+        }
+
+        virtual ~LocklessTransposition() = default;
+
+        DISALLOW_COPY_AND_ASSIGN(LocklessTransposition);
+
+        // Clears the table. It must not be called while other threads access the table.
+        virtual void Reset() {
+            for (size_t i=0; i<size_; ++i) {
+                entries_[i].check.store(0, std::memory_order_relaxed);
+                entries_[i].data.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        virtual void Save(TKey key, const Item& item) {
+            uint64_t data = Pack(item);
+            Entry& entry = entries_[Index(key)];
+            entry.check.store(static_cast<uint64_t>(key) ^ data, std::memory_order_relaxed);
+            entry.data.store(data, std::memory_order_relaxed);
+        }
+
+        // Returns the entry of the slot of a key. As with CircularTransposition, the slot may hold another key, so the
+        // lock of the entry must be compared with the key. An empty slot has the type kNone.
+        virtual Item Get(TKey key) const {
+            const Entry& entry = entries_[Index(key)];
+            uint64_t data = entry.data.load(std::memory_order_relaxed);
+            uint64_t check = entry.check.load(std::memory_order_relaxed);
+            if (data == 0) {
+                Item item{};
+                item.type = Type::kNone;
+                return item;
+            }
+            return Unpack(static_cast<TKey>(check ^ data), data);
+        }
+
+        size_t size() const {
+            return size_;
+        }
+
+        MemoryUsage& memory_usage() {
+            return memory_usage_;
+        }
+
+        static constexpr const char* kMemoryTag = "transposition";
+
+    protected:
+        friend class TranspositionBook<TKey>; // Which stores the items packed as this table does.
+
+        struct Entry {
+            std::atomic<uint64_t> check;
+            std::atomic<uint64_t> data;
+        };
+
+        static constexpr uint64_t kMaxDepth = 0xFFFF;
+        static constexpr uint64_t kMoveMask = 0x1FFF;
+        static constexpr uint64_t kValidBit = 0x2000;
+
+        size_t Index(TKey key) const {
+            return static_cast<uint64_t>(key) % size_;
+        }
+
+        // Packs an item as | value (32) | depth (16) | type (2) | valid (1) | move + 1 (13) |. The valid bit is set
+        // for every saved item, so a zero word marks an empty entry.
+        static uint64_t Pack(const Item& item) {
+            float value = static_cast<float>(item.value);
+            uint32_t value_bits;
+            std::memcpy(&value_bits, &value, sizeof(value_bits));
+            uint64_t depth = std::clamp<Int>(item.depth, 0, kMaxDepth);
+            uint64_t move = item.move == kIntNull ? 0 : (static_cast<uint64_t>(item.move) + 1) & kMoveMask;
+            return (static_cast<uint64_t>(value_bits) << 32) | (depth << 16) | (static_cast<uint64_t>(item.type) << 14) | kValidBit | move;
+        }
+
+        static Item Unpack(TKey key, uint64_t data) {
+            Item item{};
+            uint32_t value_bits = static_cast<uint32_t>(data >> 32);
+            float value;
+            std::memcpy(&value, &value_bits, sizeof(value));
+            Int depth = (data >> 16) & kMaxDepth;
+            Int move = data & kMoveMask;
+            item.lock = key;
+            item.value = value;
+            item.depth = depth == kMaxDepth ? kIntFull : depth;
+            item.type = static_cast<Type>((data >> 14) & 3);
+            item.move = move == 0 ? kIntNull : move - 1;
+            return item;
+        }
+
+        MemoryUsage memory_usage_;
+        size_t size_;
+        std::unique_ptr<Entry[]> entries_;
+    };
+}
+
+namespace rlop {
+    // A production transposition table, sized in bytes and organised in buckets of one cache line. Each bucket holds
+    // three depth-preferred entries and one always-replace entry, so deep results survive while recent shallow results
+    // still find a place. Entries carry the generation of the search which saved them, and entries of older searches
+    // are replaced first, which lets the table be kept across searches with NewGeneration() instead of being cleared.
+    // As in LocklessTransposition, entries are two 64-bit words xor-verified on read, so the table can be shared by
+    // several threads without locks.
+    //
+    // Entries are packed as | value (32) | depth (12) | generation (6) | type (2) | valid (1) | move + 1 (11) |: the
+    // value is stored as a float, depths are saturated at 4095, which is read back as kIntFull, and moves must lie in
+    // [0, 2046].
+    //
+    // Template Parameters:
+    //   TKey: The type of the keys, an integral type of at most 64 bits.
+    template<typename TKey>
+    class BucketTransposition {
+    public:
+        static_assert(std::is_integral_v<TKey> && sizeof(TKey) <= sizeof(uint64_t), "BucketTransposition: keys must be integers of at most 64 bits.");
+
+        using Type = typename AlphaBetaSearch::ValueType;
+        using Item = typename CircularTransposition<TKey>::Item;
+
+        static constexpr Int kBucketSize = 4;
+        static constexpr Int kNumDepthSlots = 3;
+
+        // Constructs a table.
+        //
+        // Parameters:
+        //   num_bytes: The size of the table in bytes, rounded down to a whole number of buckets, and down to the memory
+        //              budget of the transposition tables in the MemoryTracker.
+        BucketTransposition(size_t num_bytes) : memory_usage_(kMemoryTag) {
+            num_buckets_ = memory_usage_.Fit(num_bytes / sizeof(Bucket), sizeof(Bucket));
+            buckets_.reset(new Bucket[num_buckets_]);
+            memory_usage_.Set(this->num_bytes());
+            Reset();
+        }
+
+        virtual ~BucketTransposition() = default;
+
+        DISALLOW_COPY_AND_ASSIGN(BucketTransposition);
+
+        // Clears the table. It must not be called while other threads access the table.
+        virtual void Reset() {
+            for (size_t i=0; i<num_buckets_; ++i) {
+                for (auto& entry : buckets_[i].entries) {
+                    entry.check.store(0, std::memory_order_relaxed);
+                    entry.data.store(0, std::memory_order_relaxed);
+                }
+            }
+            generation_ = 0;
+        }
+
+        // Starts a new generation. Entries saved by previous generations are kept but replaced first.
+        virtual void NewGeneration() {
+            generation_ = (generation_ + 1) & kGenerationMask;
+        }
+
+        // Returns the entry of a key, or an entry of type kNone if the key is not in the table.
+        virtual Item Get(TKey key) const {
+            const Bucket& bucket = buckets_[Index(key)];
+            for (const auto& entry : bucket.entries) {
+                uint64_t data = entry.data.load(std::memory_order_relaxed);
+                uint64_t check = entry.check.load(std::memory_order_relaxed);
+                if (data != 0 && (check ^ data) == static_cast<uint64_t>(key))
+                    return Unpack(key, data);
+            }
+            Item item{};
+            item.type = Type::kNone;
+            return item;
+        }
+
+        // Saves an item. An entry of the same key is overwritten unless it comes from the same generation and is
+        // deeper. Otherwise, the depth-preferred entry with the lowest depth, discounted by its age, is replaced if it
+        // is not deeper than the item, and the always-replace entry is overwritten if not.
+        virtual void Save(TKey key, const Item& item) {
+            Bucket& bucket = buckets_[Index(key)];
+            Int depth = std::clamp<Int>(item.depth, 0, kMaxDepth);
+            Int victim = kIntNull;
+            Int victim_score = kIntFull;
+            for (Int i=0; i<kBucketSize; ++i) {
+                uint64_t data = bucket.entries[i].data.load(std::memory_order_relaxed);
+                uint64_t check = bucket.entries[i].check.load(std::memory_order_relaxed);
+                if (data != 0 && (check ^ data) == static_cast<uint64_t>(key)) {
+                    if (Generation(data) == generation_ && Depth(data) > depth && item.type != Type::kExact)
+                        return;
+                    Store(bucket.entries[i], key, item);
+                    return;
+                }
+                if (i < kNumDepthSlots) {
+                    Int score = data == 0 ? kIntNull : Depth(data) - kAgeWeight * Age(data);
+                    if (score < victim_score) {
+                        victim = i;
+                        victim_score = score;
+                    }
+                }
+            }
+            if (victim_score > depth)
+                victim = kNumDepthSlots;
+            Store(bucket.entries[victim], key, item);
+        }
+
+        // Calls a function on the items of the table, such as to persist them in a TranspositionBook. It must not be
+        // called while other threads save to the table.
+        void ForEach(const std::function<void(const Item&)>& function) const {
+            for (size_t i=0; i<num_buckets_; ++i) {
+                for (const auto& entry : buckets_[i].entries) {
+                    uint64_t data = entry.data.load(std::memory_order_relaxed);
+                    uint64_t check = entry.check.load(std::memory_order_relaxed);
+                    if (data != 0)
+                        function(Unpack(static_cast<TKey>(check ^ data), data));
+                }
+            }
+        }
+
+        // Estimates the fraction of the table used by the current generation from the first buckets.
+        double Usage() const {
+            size_t num_samples = std::min<size_t>(num_buckets_, 1000);
+            Int num_used = 0;
+            for (size_t i=0; i<num_samples; ++i) {
+                for (const auto& entry : buckets_[i].entries) {
+                    uint64_t data = entry.data.load(std::memory_order_relaxed);
+                    if (data != 0 && Generation(data) == generation_)
+                        ++num_used;
+                }
+            }
+            return num_used / double(num_samples * kBucketSize);
+        }
+
+        size_t num_buckets() const {
+            return num_buckets_;
+        }
+
+        size_t num_bytes() const {
+            return num_buckets_ * sizeof(Bucket);
+        }
+
+        uint64_t generation() const {
+            return generation_;
+        }
+
+        MemoryUsage& memory_usage() {
+            return memory_usage_;
+        }
+
+        static constexpr const char* kMemoryTag = "transposition";
+
+    protected:
+        struct Entry {
+            std::atomic<uint64_t> check;
+            std::atomic<uint64_t> data;
+        };
+
+        struct alignas(64) Bucket {
+            std::array<Entry, kBucketSize> entries;
+        };
+
+        static_assert(sizeof(Bucket) == 64, "BucketTransposition: a bucket must fill one cache line.");
+
+        static constexpr Int kMaxDepth = 0xFFF;
+        static constexpr uint64_t kGenerationMask = 0x3F;
+        static constexpr uint64_t kMoveMask = 0x7FF;
+        static constexpr uint64_t kValidBit = 0x800;
+        static constexpr Int kAgeWeight = 8;
+
+        // Mixes the bits of the key before reducing it, since structured keys such as bitboards vary mostly in a few
+        // bits and the number of buckets is often a power of two.
+        size_t Index(TKey key) const {
+            uint64_t x = static_cast<uint64_t>(key);
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+            return (x ^ (x >> 31)) % num_buckets_;
+        }
+
+        static Int Depth(uint64_t data) {
+            return (data >> 20) & kMaxDepth;
+        }
+
+        static uint64_t Generation(uint64_t data) {
+            return (data >> 14) & kGenerationMask;
+        }
+
+        Int Age(uint64_t data) const {
+            return (generation_ - Generation(data)) & kGenerationMask;
+        }
+
+        void Store(Entry& entry, TKey key, const Item& item) const {
+            uint64_t data = Pack(item);
+            entry.check.store(static_cast<uint64_t>(key) ^ data, std::memory_order_relaxed);
+            entry.data.store(data, std::memory_order_relaxed);
+        }
+
+        uint64_t Pack(const Item& item) const {
+            float value = static_cast<float>(item.value);
+            uint32_t value_bits;
+            std::memcpy(&value_bits, &value, sizeof(value_bits));
+            uint64_t depth = std::clamp<Int>(item.depth, 0, kMaxDepth);
+            uint64_t move = item.move == kIntNull ? 0 : (static_cast<uint64_t>(item.move) + 1) & kMoveMask;
+            return (static_cast<uint64_t>(value_bits) << 32) | (depth << 20) | (generation_ << 14) | 
+                (static_cast<uint64_t>(item.type) << 12) | kValidBit | move;
+        }
+
+        static Item Unpack(TKey key, uint64_t data) {
+            Item item{};
+            uint32_t value_bits = static_cast<uint32_t>(data >> 32);
+            float value;
+            std::memcpy(&value, &value_bits, sizeof(value));
+            Int depth = Depth(data);
+            Int move = data & kMoveMask;
+            item.lock = key;
+            item.value = value;
+            item.depth = depth == kMaxDepth ? kIntFull : depth;
+            item.type = static_cast<Type>((data >> 12) & 3);
+            item.move = move == 0 ? kIntNull : move - 1;
+            return item;
+        }
+
+        MemoryUsage memory_usage_;
+        size_t num_buckets_;
+        std::unique_ptr<Bucket[]> buckets_;
+        uint64_t generation_ = 0;
+    };
+}
+
+namespace rlop {
+    // A read-only transposition table persisted in a file, such as an opening book of solved positions or the table
+    // of a finished search, so that the positions solved once are lookups for the next searches and for the other
+    // processes. The file holds the entries sorted by key and packed as in LocklessTransposition, which Get() finds by
+    // binary search. It is memory-mapped by the first lookup, so that only the pages of the positions looked up are
+    // read, and the processes mapping it share its pages in the page cache. Threads may look up concurrently.
+    //
+    // The file records the largest number of moves, the ply, of its positions, which lets the searches skip the
+    // lookups of the deeper positions.
+    //
+    // Template Parameters:
+    //   TKey: The type of the keys, an integral type of at most 64 bits.
+    template<typename TKey>
+    class TranspositionBook {
+    public:
+        static_assert(std::is_integral_v<TKey> && sizeof(TKey) <= sizeof(uint64_t), "TranspositionBook: keys must be integers of at most 64 bits.");
+
+        using Type = typename AlphaBetaSearch::ValueType;
+        using Item = typename CircularTransposition<TKey>::Item;
+
+        static constexpr const char* kMagic = "RLOPTB01";
+
+        // Parameters:
+        //   path: The path of the file, which is opened by the first lookup.
+        TranspositionBook(const std::string& path) : path_(path) {}
+
+        DISALLOW_COPY_AND_ASSIGN(TranspositionBook);
+
+        virtual ~TranspositionBook() = default;
+
+        // Returns the item of a key, or an item of type kNone if the key is not in the book.
+        Item Get(TKey key) const {
+            Load();
+            size_t low = 0;
+            size_t high = num_entries_;
+            while (low < high) {
+                size_t mid = low + (high - low) / 2;
+                if (ReadEntry(mid).key < static_cast<uint64_t>(key))
+                    low = mid + 1;
+                else
+                    high = mid;
+            }
+            if (low < num_entries_) {
+                Entry entry = ReadEntry(low);
+                if (entry.key == static_cast<uint64_t>(key))
+                    return LocklessTransposition<TKey>::Unpack(key, entry.data);
+            }
+            Item item{};
+            item.type = Type::kNone;
+            return item;
+        }
+
+        // Returns all the items of the book, such as to merge them into a new one.
+        std::vector<Item> Items() const {
+            Load();
+            std::vector<Item> items;
+            items.reserve(num_entries_);
+            for (size_t i=0; i<num_entries_; ++i) {
+                Entry entry = ReadEntry(i);
+                items.push_back(LocklessTransposition<TKey>::Unpack(static_cast<TKey>(entry.key), entry.data));
+            }
+            return items;
+        }
+
+        // Writes a book of items, keeping the deepest item of a key, and the exact one of the items of the same depth.
+        // The book is written next to `path` and renamed over it, so that the processes mapping the previous file keep
+        // reading it.
+        //
+        // Parameters:
+        //   path: The path of the file.
+        //   items: The items, whose locks are their keys. The items of type kNone are skipped.
+        //   max_ply: The largest number of moves of the positions of the items.
+        static void Write(const std::string& path, std::vector<Item> items, Int max_ply) {
+            items.erase(std::remove_if(items.begin(), items.end(), [](const Item& item) { return item.type == Type::kNone; }), items.end());
+            std::sort(items.begin(), items.end(), [](const Item& a, const Item& b) {
+                if (a.lock != b.lock)
+                    return static_cast<uint64_t>(a.lock) < static_cast<uint64_t>(b.lock);
+                if (a.depth != b.depth)
+                    return a.depth > b.depth;
+                return a.type == Type::kExact && b.type != Type::kExact;
+            });
+            items.erase(std::unique(items.begin(), items.end(), [](const Item& a, const Item& b) { return a.lock == b.lock; }), items.end());
+            Header header = {};
+            std::copy(kMagic, kMagic + sizeof(header.magic), header.magic);
+            header.num_entries = items.size();
+            header.max_ply = max_ply;
+            std::string temp_path = path + ".tmp";
+            {
+                std::ofstream output(temp_path, std::ios::binary | std::ios::trunc);
+                output.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+                for (const auto& item : items) {
+                    Entry entry = { static_cast<uint64_t>(item.lock), LocklessTransposition<TKey>::Pack(item) };
+                    output.write(reinterpret_cast<const char*>(&entry), sizeof(Entry));
+                }
+                if (!output)
+                    throw std::runtime_error("TranspositionBook: cannot write " + temp_path + ".");
+            }
+            std::filesystem::rename(temp_path, path);
+        }
+
+        const std::string& path() const {
+            return path_;
+        }
+
+        // Returns the largest number of moves of the positions of the book.
+        Int max_ply() const {
+            Load();
+            return max_ply_;
+        }
+
+        size_t size() const {
+            Load();
+            return num_entries_;
+        }
+
+    protected:
+        struct Header {
+            char magic[8];
+            Int num_entries;
+            Int max_ply;
+        };
+
+        struct Entry {
+            uint64_t key;
+            uint64_t data;
+        };
+
+        // Maps the file, once for all the threads.
+        void Load() const {
+            std::call_once(load_flag_, [this]() {
+                file_.Open(path_);
+                Header header = {};
+                if (file_.size() >= sizeof(Header))
+                    std::memcpy(&header, file_.data(), sizeof(Header));
+                if (!std::equal(header.magic, header.magic + sizeof(header.magic), kMagic) || 
+                    file_.size() != sizeof(Header) + header.num_entries * sizeof(Entry))
+                    throw std::runtime_error("TranspositionBook: " + path_ + " is not a transposition book.");
+                num_entries_ = header.num_entries;
+                max_ply_ = header.max_ply;
+            });
+        }
+
+        // Reads an entry, which the buffer of an unmapped file may not align.
+        Entry ReadEntry(size_t i) const {
+            Entry entry;
+            std::memcpy(&entry, file_.data() + sizeof(Header) + i * sizeof(Entry), sizeof(Entry));
+            return entry;
+        }
+
+        std::string path_;
+        mutable std::once_flag load_flag_;
+        mutable MappedFile file_;
+        mutable size_t num_entries_ = 0;
+        mutable Int max_ply_ = 0;
+    };
+}
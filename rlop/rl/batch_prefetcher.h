@@ -0,0 +1,198 @@
+#pragma once
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "buffers.h"
+
+// The side streams and events of CUDA, where libtorch is built with CUDA and its headers are found.
+#if __has_include(<ATen/cuda/CUDAEvent.h>) && __has_include(<cuda_runtime_api.h>)
+#include <ATen/cuda/CUDAEvent.h>
+#include <c10/cuda/CUDACachingAllocator.h>
+#include <c10/cuda/CUDAGuard.h>
+#include <c10/cuda/CUDAStream.h>
+#define RLOP_CUDA_PREFETCH
+#endif
+
+namespace rlop {
+    // Samples the batches of a replay buffer on a background thread ahead of the training steps, so that gathering
+    // the transitions and copying them to the device overlap the forward and backward passes of the previous batches.
+    // With a CUDA device, the batches are gathered into pinned memory and copied with non-blocking copies on a side
+    // stream, and the stream of the training waits for a copy only when it takes the batch.
+    //
+    // The buffer is sampled only between Start() and the last Next(), at most `num_prefetch_batches` batches ahead.
+    // The sampling holds `buffer_mutex`, which the threads adding transitions concurrently hold as well, and so does
+    // UpdatePriorities(), so that a prefetched batch of a prioritized buffer is drawn from priorities up to
+    // `num_prefetch_batches` updates old.
+    class BatchPrefetcher {
+    public:
+        // Parameters:
+        //   buffer_mutex: The mutex of the accesses to the buffer, which is shared with the other threads adding to it.
+        BatchPrefetcher(
+            const std::shared_ptr<ReplayBuffer>& replay_buffer, 
+            const torch::Device& device, 
+            Int num_prefetch_batches = 2,
+            const std::shared_ptr<std::mutex>& buffer_mutex = std::make_shared<std::mutex>()
+        ) :
+            replay_buffer_(replay_buffer),
+            device_(device),
+            num_prefetch_batches_(std::max(num_prefetch_batches, Int(1))),
+            buffer_mutex_(buffer_mutex)
+        {
+            thread_ = std::thread([this]() { Run(); });
+        }
+
+        DISALLOW_COPY_AND_ASSIGN(BatchPrefetcher);
+
+        virtual ~BatchPrefetcher() {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            cv_.notify_all();
+            thread_.join();
+        }
+
+        // Starts sampling `num_batches` batches of `batch_size` transitions, which Next() returns in order. The
+        // batches of the previous start which were not taken are discarded.
+        void Start(Int num_batches, Int batch_size) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [&]() { return !sampling_; });
+            batches_.clear();
+            error_ = nullptr;
+            num_remaining_ = num_batches;
+            batch_size_ = batch_size;
+            cv_.notify_all();
+        }
+
+        // Returns the next batch on the device, waiting for it to be sampled, and rethrows the error of the sampling.
+        ReplayBuffer::Batch Next() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [&]() { return !batches_.empty() || error_ != nullptr || (num_remaining_ == 0 && !sampling_); });
+            if (error_ != nullptr) {
+                std::exception_ptr error = error_;
+                error_ = nullptr;
+                num_remaining_ = 0;
+                std::rethrow_exception(error);
+            }
+            if (batches_.empty())
+                throw std::runtime_error("BatchPrefetcher: all the batches of Start() are taken.");
+            Prefetched prefetched = std::move(batches_.front());
+            batches_.pop_front();
+            lock.unlock();
+            cv_.notify_all();
+#ifdef RLOP_CUDA_PREFETCH
+            if (prefetched.event != nullptr) {
+                c10::cuda::CUDAStream stream = c10::cuda::getCurrentCUDAStream(device_.index());
+                prefetched.event->block(stream);
+                // The tensors were allocated on the side stream, so the allocator must not reuse them for it before
+                // the training is done with them.
+                for (const torch::Tensor* tensor : Tensors(&prefetched.batch)) {
+                    if (tensor->defined() && tensor->is_cuda())
+                        c10::cuda::CUDACachingAllocator::recordStream(tensor->storage().data_ptr(), stream);
+                }
+            }
+#endif
+            return prefetched.batch;
+        }
+
+        // Updates the priorities of the buffer from the TD errors of a batch, between two samplings.
+        void UpdatePriorities(const torch::Tensor& indices, const torch::Tensor& td_errors) {
+            // The copy to the host, which waits for the training stream, is made before the sampling is held up.
+            torch::Tensor cpu_td_errors = td_errors.detach().to(torch::kCPU);
+            std::lock_guard<std::mutex> lock(*buffer_mutex_);
+            replay_buffer_->UpdatePriorities(indices, cpu_td_errors);
+        }
+
+        const std::shared_ptr<ReplayBuffer>& replay_buffer() const {
+            return replay_buffer_;
+        }
+
+        Int num_prefetch_batches() const {
+            return num_prefetch_batches_;
+        }
+
+    protected:
+        struct Prefetched {
+            ReplayBuffer::Batch batch;
+#ifdef RLOP_CUDA_PREFETCH
+            std::shared_ptr<at::cuda::CUDAEvent> event = nullptr; // Recorded after the copies of the side stream.
+#endif
+        };
+
+        static std::array<torch::Tensor*, 6> Tensors(ReplayBuffer::Batch* batch) {
+            return { &batch->observations, &batch->actions, &batch->next_observations, &batch->rewards, &batch->dones, &batch->weights };
+        }
+
+        void Run() {
+            torch::NoGradGuard no_grad;
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (true) {
+                cv_.wait(lock, [&]() { return stop_ || (num_remaining_ > 0 && (Int)batches_.size() < num_prefetch_batches_); });
+                if (stop_)
+                    return;
+                --num_remaining_;
+                sampling_ = true;
+                Int batch_size = batch_size_;
+                lock.unlock();
+                Prefetched prefetched;
+                std::exception_ptr error = nullptr;
+                try {
+                    prefetched = Prefetch(batch_size);
+                }
+                catch (...) {
+                    error = std::current_exception();
+                }
+                lock.lock();
+                if (error != nullptr)
+                    error_ = error;
+                else
+                    batches_.push_back(std::move(prefetched));
+                sampling_ = false;
+                cv_.notify_all();
+            }
+        }
+
+        Prefetched Prefetch(Int batch_size) {
+            Prefetched prefetched;
+            {
+                std::lock_guard<std::mutex> lock(*buffer_mutex_);
+                prefetched.batch = replay_buffer_->Sample(batch_size);
+            }
+#ifdef RLOP_CUDA_PREFETCH
+            if (device_.is_cuda()) {
+                c10::cuda::CUDAGuard device_guard(device_);
+                if (!stream_.has_value())
+                    stream_ = c10::cuda::getStreamFromPool(false, device_.index());
+                for (torch::Tensor* tensor : Tensors(&prefetched.batch)) {
+                    if (tensor->defined() && !tensor->is_cuda())
+                        *tensor = tensor->pin_memory();
+                }
+                c10::cuda::CUDAStreamGuard stream_guard(*stream_);
+                prefetched.batch = prefetched.batch.To(device_, true);
+                prefetched.event = std::make_shared<at::cuda::CUDAEvent>();
+                prefetched.event->record(*stream_);
+                return prefetched;
+            }
+#endif
+            prefetched.batch = prefetched.batch.To(device_);
+            return prefetched;
+        }
+
+        std::shared_ptr<ReplayBuffer> replay_buffer_;
+        torch::Device device_;
+        Int num_prefetch_batches_;
+        std::shared_ptr<std::mutex> buffer_mutex_; // Keeps the updates of the priorities and the additions apart from the sampling.
+        std::thread thread_;
+        std::mutex mutex_; // Guards the state of the batches below.
+        std::condition_variable cv_;
+        std::deque<Prefetched> batches_;
+        Int num_remaining_ = 0; // The number of batches of Start() left to sample.
+        Int batch_size_ = 0;
+        bool sampling_ = false;
+        bool stop_ = false;
+        std::exception_ptr error_ = nullptr;
+#ifdef RLOP_CUDA_PREFETCH
+        std::optional<c10::cuda::CUDAStream> stream_;
+#endif
+    };
+}
@@ -1,5 +1,11 @@
 #pragma once
+#include <atomic>
 #include "rlop/common/torch_utils.h"
+#include "rlop/common/memory_tracker.h"
+#include "rlop/common/sum_tree.h"
+#include "rlop/common/max_tree.h"
+#include "rlop/common/mapped_file.h"
+#include "observation_codecs.h"
 
 namespace rlop {
     class RLBuffer {
@@ -11,7 +17,8 @@ namespace rlop {
             const std::vector<Int>& action_sizes,
             torch::Dtype observation_type = torch::kFloat32,
             torch::Dtype action_type = torch::kFloat32,
-            const torch::Device& device = torch::kCPU
+            const torch::Device& device = torch::kCPU,
+            const std::string& memory_tag = "rl_buffer"
         ) :
             buffer_size_(buffer_size), 
             num_envs_(num_envs), 
@@ -19,7 +26,8 @@ namespace rlop {
             action_sizes_(action_sizes),
             observation_type_(observation_type),
             action_type_(action_type), 
-            device_(device)
+            device_(device),
+            memory_usage_(memory_tag)
         {}
 
         ~RLBuffer() = default;
@@ -79,7 +87,66 @@ namespace rlop {
             return device_;
         }
 
+        // The share of the buffer in the memory accounting, which can be moved to another tag.
+        MemoryUsage& memory_usage() {
+            return memory_usage_;
+        }
+
+        // Returns the codec of the stored observations, nullptr if they are stored as they are.
+        const std::shared_ptr<ObservationCodec>& observation_codec() const {
+            return observation_codec_;
+        }
+
+        Int num_groups() const {
+            return num_groups_;
+        }
+
+        // Splits the environments into `num_groups` groups of consecutive environments, such as those of the seeds
+        // trained together in one process. The batches then hold as many samples of each group, group after group,
+        // which requires their sizes to be multiples of the number of groups.
+        void set_num_groups(Int num_groups) {
+            if (num_groups < 1 || num_envs_ % num_groups != 0)
+                throw std::runtime_error("RLBuffer: the number of groups must divide the number of environments.");
+            num_groups_ = num_groups;
+        }
+
     protected:
+        void CheckGroupedBatchSize(Int batch_size) const {
+            if (batch_size % num_groups_ != 0)
+                throw std::runtime_error("RLBuffer: the batch size " + std::to_string(batch_size) + " is not a multiple of the " + std::to_string(num_groups_) + " groups.");
+        }
+
+        // Returns the number of bytes of a step of all environments in tensors of stored observations and of actions,
+        // and of single values.
+        Int StepNumBytes(Int num_observations, Int num_actions, Int num_values) const {
+            Int observation_num_bytes = observation_codec_ != nullptr ? observation_codec_->EncodedNumBytes(observation_sizes_) :
+                std::accumulate(observation_sizes_.begin(), observation_sizes_.end(), Int(1), std::multiplies<Int>()) * c10::elementSize(observation_type_);
+            Int action_size = std::accumulate(action_sizes_.begin(), action_sizes_.end(), Int(1), std::multiplies<Int>());
+            return num_envs_ * (num_observations * observation_num_bytes + num_actions * action_size * c10::elementSize(action_type_) + 
+                num_values * sizeof(float));
+        }
+
+        // Returns the sizes of a tensor of stored observations with leading dimensions.
+        std::vector<Int> StoredObservationSizes(std::vector<Int> sizes) const {
+            auto observation_sizes = observation_codec_ != nullptr ? observation_codec_->EncodedSizes(observation_sizes_) : observation_sizes_;
+            sizes.insert(sizes.end(), observation_sizes.begin(), observation_sizes.end());
+            return sizes;
+        }
+
+        torch::Dtype StoredObservationType() const {
+            return observation_codec_ != nullptr ? observation_codec_->encoded_type() : observation_type_;
+        }
+
+        // Encodes a batch of observations for the storage, which is a no-op without a codec.
+        torch::Tensor EncodeObservations(const torch::Tensor& observations) const {
+            return observation_codec_ != nullptr ? observation_codec_->Encode(observations.to(device_)) : observations;
+        }
+
+        // Decodes a batch of stored observations, which is a no-op without a codec.
+        torch::Tensor DecodeObservations(const torch::Tensor& observations) const {
+            return observation_codec_ != nullptr ? observation_codec_->Decode(observations, observation_sizes_, observation_type_) : observations;
+        }
+
         Int buffer_size_;
         Int num_envs_;
         Int pos_ = 0;
@@ -89,6 +156,9 @@ namespace rlop {
         torch::Dtype action_type_;
         bool full_ = false;
         torch::Device device_;
+        MemoryUsage memory_usage_;
+        std::shared_ptr<ObservationCodec> observation_codec_ = nullptr;
+        Int num_groups_ = 1;
     };
 
     class ReplayBuffer : public RLBuffer {
@@ -99,18 +169,54 @@ namespace rlop {
             torch::Tensor next_observations;
             torch::Tensor rewards;
             torch::Tensor dones;
+            torch::Tensor weights; // The importance sampling weights of a prioritized buffer, undefined otherwise.
+            torch::Tensor indices; // The indices of the transitions for UpdatePriorities().
 
-            Batch To(const torch::Device& device) {
+            // Copies the batch to a device, without waiting for the copies from pinned memory with `non_blocking`.
+            Batch To(const torch::Device& device, bool non_blocking = false) {
                 Batch batch;
-                batch.observations = observations.to(device);
-                batch.actions = actions.to(device);
-                batch.next_observations = next_observations.to(device);
-                batch.rewards = rewards.to(device);
-                batch.dones = dones.to(device);
+                batch.observations = observations.to(device, non_blocking);
+                batch.actions = actions.to(device, non_blocking);
+                batch.next_observations = next_observations.to(device, non_blocking);
+                batch.rewards = rewards.to(device, non_blocking);
+                batch.dones = dones.to(device, non_blocking);
+                if (weights.defined())
+                    batch.weights = weights.to(device, non_blocking);
+                batch.indices = indices;
                 return batch;
             }
+
+            // Copies the batch in place into the tensors of `batch`, which are allocated on `device` when undefined,
+            // such as the static inputs of a CUDA graph.
+            void CopyTo(Batch* batch, const torch::Device& device) const {
+                auto copy = [&](const torch::Tensor& source, torch::Tensor* target) {
+                    if (!source.defined())
+                        return;
+                    if (!target->defined())
+                        *target = torch::empty(source.sizes(), source.options().device(device));
+                    target->copy_(source, true);
+                };
+                copy(observations, &batch->observations);
+                copy(actions, &batch->actions);
+                copy(next_observations, &batch->next_observations);
+                copy(rewards, &batch->rewards);
+                copy(dones, &batch->dones);
+                copy(weights, &batch->weights);
+                batch->indices = indices;
+            }
         };
 
+        // Constructs a buffer of `buffer_capacity` transitions over all environments, or fewer if they would exceed the
+        // memory budget of the replay buffers in the MemoryTracker, which is the shrink policy of the buffer.
+        //
+        // With `optimize_memory_usage`, the next observations are not stored, which about halves the memory of
+        // buffers of large observations: the next observation of a transition is the observation of the following
+        // slot of the same environment, written ahead by Add(), and only the final observations of the episodes,
+        // which the observations after a reset replace, are kept aside. The oldest slot of a full buffer is then not
+        // sampled, since its observation holds the next observation of the latest transition.
+        //
+        // With an `observation_codec`, the observations are stored encoded, such as quantized or bit-packed, and
+        // decoded by batch when sampled, which the memory budget accounts for.
         ReplayBuffer(
             Int buffer_capacity,
             Int num_envs,
@@ -118,41 +224,38 @@ namespace rlop {
             const std::vector<Int>& action_sizes,
             torch::Dtype observation_type = torch::kFloat32,
             torch::Dtype action_type = torch::kFloat32,
-            const torch::Device& device = torch::kCPU
+            const torch::Device& device = torch::kCPU,
+            bool optimize_memory_usage = false,
+            const std::shared_ptr<ObservationCodec>& observation_codec = nullptr
         ) :
-            RLBuffer(
-                std::max((Int)(buffer_capacity / num_envs), Int(1)), 
-                num_envs, 
-                observation_sizes, 
-                action_sizes,
-                observation_type,
-                action_type, 
-                device
-            )
-        {
-            std::vector<Int> observation_buffer_sizes = { buffer_size_, num_envs };
-            std::vector<Int> action_buffer_sizes = { buffer_size_, num_envs };
-            observation_buffer_sizes.insert(observation_buffer_sizes.end(), observation_sizes_.begin(), observation_sizes_.end());
-            action_buffer_sizes.insert(action_buffer_sizes.end(), action_sizes_.begin(), action_sizes_.end()); 
-            observations_ = torch::zeros(observation_buffer_sizes, observation_type_).to(device_);
-            actions_ = torch::zeros(action_buffer_sizes, action_type_).to(device_);
-            next_observations_ = torch::zeros(observation_buffer_sizes, observation_type_).to(device_);
-            rewards_ = torch::zeros({ buffer_size_, num_envs }).to(device_);
-            dones_ = torch::zeros({ buffer_size_, num_envs }).to(device_);
-        }
+            ReplayBuffer(buffer_capacity, num_envs, observation_sizes, action_sizes, observation_type, action_type, device, optimize_memory_usage, observation_codec, true)
+        {}
+
+        static constexpr const char* kMemoryTag = "replay_buffer";
 
         virtual ~ReplayBuffer() = default;
 
+        virtual void Reset() override {
+            RLBuffer::Reset();
+            final_observations_.clear();
+        }
+
         virtual Batch Sample(Int batch_size) {
-            Batch batch;
-            torch::Tensor batch_indices = torch::randint(0, Size(), {batch_size}).to(device_);
-            torch::Tensor env_indices = torch::randint(0, num_envs_, {batch_size}).to(device_);
-            batch.observations = observations_.index({batch_indices, env_indices, "..."}).clone();
-            batch.next_observations = next_observations_.index({batch_indices, env_indices, "..."}).clone();
-            batch.actions = actions_.index({batch_indices, env_indices, "..."}).clone();
-            batch.rewards = rewards_.index({batch_indices, env_indices, "..."}).clone();
-            batch.dones = dones_.index({batch_indices, env_indices, "..."}).clone();
-            return batch;
+            torch::Tensor batch_indices;
+            if (optimize_memory_usage_ && full_)
+                batch_indices = (torch::randint(1, buffer_size_, {batch_size}) + pos_).remainder(buffer_size_);
+            else
+                batch_indices = torch::randint(0, Size(), {batch_size});
+            torch::Tensor env_indices;
+            if (num_groups_ > 1) {
+                CheckGroupedBatchSize(batch_size);
+                Int group_size = num_envs_ / num_groups_;
+                torch::Tensor offsets = torch::arange(num_groups_, torch::kInt64).unsqueeze(1) * group_size;
+                env_indices = (torch::randint(0, group_size, {num_groups_, batch_size / num_groups_}, torch::kInt64) + offsets).flatten();
+            }
+            else
+                env_indices = torch::randint(0, num_envs_, {batch_size});
+            return GetBatch(batch_indices, env_indices);
         }
 
         virtual void Add(
@@ -162,9 +265,30 @@ namespace rlop {
             const torch::Tensor& rewards,
             const torch::Tensor& dones
         ) {
-            observations_[pos_].copy_(observations);
+            torch::Tensor stored_observations = EncodeObservations(observations);
+            torch::Tensor stored_next_observations = EncodeObservations(next_observations);
+            if (optimize_memory_usage_) {
+                for (Int i=0; i<num_envs_; ++i)
+                    final_observations_.erase(pos_ * num_envs_ + i);
+                // The slot holds the next observations of the previous step, which differ from the current ones
+                // where an episode ended.
+                if (pos_ > 0 || full_) {
+                    Int last_pos = (pos_ + buffer_size_ - 1) % buffer_size_;
+                    torch::Tensor ended = observations_[pos_].ne(stored_observations.to(device_)).reshape({num_envs_, -1}).any(1).cpu();
+                    auto ended_a = ended.accessor<bool, 1>();
+                    for (Int i=0; i<num_envs_; ++i) {
+                        if (ended_a[i])
+                            final_observations_[last_pos * num_envs_ + i] = observations_[pos_][i].clone();
+                    }
+                }
+                observations_[pos_].copy_(stored_observations);
+                observations_[(pos_ + 1) % buffer_size_].copy_(stored_next_observations);
+            }
+            else {
+                observations_[pos_].copy_(stored_observations);
+                next_observations_[pos_].copy_(stored_next_observations);
+            }
             actions_[pos_].copy_(actions);
-            next_observations_[pos_].copy_(next_observations);
             rewards_[pos_].copy_(rewards);
             dones_[pos_].copy_(dones);
             pos_ += 1;
@@ -174,6 +298,13 @@ namespace rlop {
             }
         }
 
+        // Updates the priorities of sampled transitions from their TD errors, which a uniform buffer ignores.
+        //
+        // Parameters:
+        //   indices: The indices of the transitions, as in Batch::indices.
+        //   td_errors: The TD errors of the transitions.
+        virtual void UpdatePriorities(const torch::Tensor& indices, const torch::Tensor& td_errors) {}
+
         virtual void Load(const std::string& path) {
             torch::serialize::InputArchive archive;
             archive.load_from(path);
@@ -181,11 +312,10 @@ namespace rlop {
         }
 
         virtual void LoadArchive(torch::serialize::InputArchive* archive) {
-            archive->read("observations", observations_);
-            archive->read("actions", actions_);
-            archive->read("next_observations", next_observations_);
-            archive->read("rewards", rewards_);
-            archive->read("dones", dones_);
+            ReadTensor(archive, "observations", &observations_);
+            ReadTensor(archive, "actions", &actions_);
+            ReadTensor(archive, "rewards", &rewards_);
+            ReadTensor(archive, "dones", &dones_);
             torch::Tensor tensor;
             archive->read("pos", tensor);
             pos_ = tensor.item<Int>();
@@ -193,10 +323,19 @@ namespace rlop {
             archive->read("full", tensor);
             full_ = tensor.item<bool>();
             tensor = torch::Tensor();
-            archive->read("optimize_memory_usage", tensor);
-            observation_sizes_ = observations_.sizes().vec();
+            optimize_memory_usage_ = archive->try_read("optimize_memory_usage", tensor) && tensor.item<bool>();
+            if (optimize_memory_usage_) {
+                next_observations_ = torch::Tensor();
+                ReadFinalObservations(archive);
+            }
+            else
+                ReadTensor(archive, "next_observations", &next_observations_);
+            buffer_size_ = observations_.size(0);
+            if (observation_codec_ == nullptr) {
+                observation_sizes_ = observations_.sizes().vec();
+                observation_type_ = observations_.scalar_type();
+            }
             action_sizes_ = actions_.sizes().vec();
-            observation_type_ = observations_.scalar_type();
             action_type_ = actions_.scalar_type();
         }
 
@@ -209,13 +348,18 @@ namespace rlop {
         virtual void SaveArchive(torch::serialize::OutputArchive* archive) {
             archive->write("observations", observations_);
             archive->write("actions", actions_);
-            archive->write("next_observations", next_observations_);
+            if (!optimize_memory_usage_)
+                archive->write("next_observations", next_observations_);
             archive->write("rewards", rewards_);
             archive->write("dones", dones_);
             archive->write("pos", torch::tensor(pos_));
             archive->write("full", torch::tensor(full_));
+            archive->write("optimize_memory_usage", torch::tensor(optimize_memory_usage_));
+            if (optimize_memory_usage_)
+                WriteFinalObservations(archive);
         }
 
+        // Returns the stored observations, which are encoded with an observation codec.
         const torch::Tensor& observations() const {
             return observations_;
         }
@@ -224,10 +368,15 @@ namespace rlop {
             return actions_;
         }
 
+        // Returns the next observations, which are undefined with `optimize_memory_usage`.
         const torch::Tensor& next_observations() const {
             return next_observations_;
         }
 
+        bool optimize_memory_usage() const {
+            return optimize_memory_usage_;
+        }
+
         const torch::Tensor& rewards() const {
             return rewards_;
         }
@@ -237,11 +386,1043 @@ namespace rlop {
         }
 
     protected:
+        // Constructs a buffer, whose tensors are allocated with `allocate_storage` and placed by the derived buffer
+        // otherwise, such as in a mapped file.
+        ReplayBuffer(
+            Int buffer_capacity,
+            Int num_envs,
+            const std::vector<Int>& observation_sizes, 
+            const std::vector<Int>& action_sizes,
+            torch::Dtype observation_type,
+            torch::Dtype action_type,
+            const torch::Device& device,
+            bool optimize_memory_usage,
+            const std::shared_ptr<ObservationCodec>& observation_codec,
+            bool allocate_storage
+        ) :
+            RLBuffer(
+                std::max((Int)(buffer_capacity / num_envs), Int(1)), 
+                num_envs, 
+                observation_sizes, 
+                action_sizes,
+                observation_type,
+                action_type, 
+                device,
+                kMemoryTag
+            ),
+            optimize_memory_usage_(optimize_memory_usage)
+        {
+            observation_codec_ = observation_codec;
+            if (allocate_storage)
+                buffer_size_ = memory_usage_.Fit(buffer_size_, StepNumBytes(optimize_memory_usage_ ? 1 : 2, 1, 2));
+            if (optimize_memory_usage_)
+                buffer_size_ = std::max(buffer_size_, Int(2));
+            if (!allocate_storage)
+                return;
+            std::vector<Int> observation_buffer_sizes = StoredObservationSizes({ buffer_size_, num_envs });
+            std::vector<Int> action_buffer_sizes = { buffer_size_, num_envs };
+            action_buffer_sizes.insert(action_buffer_sizes.end(), action_sizes_.begin(), action_sizes_.end()); 
+            observations_ = torch::zeros(observation_buffer_sizes, StoredObservationType()).to(device_);
+            actions_ = torch::zeros(action_buffer_sizes, action_type_).to(device_);
+            if (!optimize_memory_usage_)
+                next_observations_ = torch::zeros(observation_buffer_sizes, StoredObservationType()).to(device_);
+            rewards_ = torch::zeros({ buffer_size_, num_envs }).to(device_);
+            dones_ = torch::zeros({ buffer_size_, num_envs }).to(device_);
+            memory_usage_.Set(observations_.nbytes() + actions_.nbytes() + (optimize_memory_usage_ ? 0 : next_observations_.nbytes()) + 
+                rewards_.nbytes() + dones_.nbytes());
+        }
+
+        // Reads a tensor of the buffer from an archive, which replaces it.
+        virtual void ReadTensor(torch::serialize::InputArchive* archive, const std::string& key, torch::Tensor* tensor) {
+            archive->read(key, *tensor);
+        }
+
+        void ReadFinalObservations(torch::serialize::InputArchive* archive) {
+            final_observations_.clear();
+            torch::Tensor final_indices, final_observations;
+            if (archive->try_read("final_indices", final_indices) && archive->try_read("final_observations", final_observations)) {
+                for (Int i=0; i<final_indices.numel(); ++i)
+                    final_observations_[final_indices[i].item<Int>()] = final_observations[i].to(device_);
+            }
+        }
+
+        void WriteFinalObservations(torch::serialize::OutputArchive* archive) const {
+            if (final_observations_.empty())
+                return;
+            std::vector<Int> final_indices;
+            std::vector<torch::Tensor> final_observations;
+            for (const auto& [index, observation] : final_observations_) {
+                final_indices.push_back(index);
+                final_observations.push_back(observation);
+            }
+            archive->write("final_indices", torch::tensor(final_indices, torch::kInt64));
+            archive->write("final_observations", torch::stack(final_observations));
+        }
+
+        // Gathers the transitions of slots and environments.
+        Batch GetBatch(const torch::Tensor& batch_indices, const torch::Tensor& env_indices) {
+            Batch batch;
+            torch::Tensor device_batch_indices = batch_indices.to(device_);
+            torch::Tensor device_env_indices = env_indices.to(device_);
+            batch.observations = DecodeObservations(observations_.index({device_batch_indices, device_env_indices, "..."}));
+            batch.actions = actions_.index({device_batch_indices, device_env_indices, "..."}).clone();
+            batch.rewards = rewards_.index({device_batch_indices, device_env_indices, "..."}).clone();
+            batch.dones = dones_.index({device_batch_indices, device_env_indices, "..."}).clone();
+            if (!optimize_memory_usage_) {
+                batch.next_observations = DecodeObservations(next_observations_.index({device_batch_indices, device_env_indices, "..."}));
+                return batch;
+            }
+            torch::Tensor next_indices = (device_batch_indices + 1).remainder(buffer_size_);
+            torch::Tensor next_observations = observations_.index({next_indices, device_env_indices, "..."});
+            if (!final_observations_.empty()) {
+                torch::Tensor cpu_batch_indices = batch_indices.to(torch::kCPU, torch::kInt64).contiguous();
+                torch::Tensor cpu_env_indices = env_indices.to(torch::kCPU, torch::kInt64).contiguous();
+                const Int* batch_indices_ptr = cpu_batch_indices.data_ptr<Int>();
+                const Int* env_indices_ptr = cpu_env_indices.data_ptr<Int>();
+                for (Int i=0; i<cpu_batch_indices.numel(); ++i) {
+                    auto it = final_observations_.find(batch_indices_ptr[i] * num_envs_ + env_indices_ptr[i]);
+                    if (it != final_observations_.end())
+                        next_observations[i].copy_(it->second);
+                }
+            }
+            batch.next_observations = DecodeObservations(next_observations);
+            return batch;
+        }
+
+        bool optimize_memory_usage_;
         torch::Tensor observations_;
         torch::Tensor actions_;
         torch::Tensor next_observations_;
         torch::Tensor rewards_;
         torch::Tensor dones_;
+        std::unordered_map<Int, torch::Tensor> final_observations_; // The final observations of the episodes by transition, with `optimize_memory_usage`.
+    };
+
+    // The priorities of the transitions of a prioritized replay buffer, their last TD errors raised to the power
+    // alpha, by index of Batch::indices. They are kept in a SumTree for the draws and, negated, in a MaxTree for the
+    // lowest one, which normalizes the importance sampling weights, so that setting and drawing a transition cost
+    // O(log n). A new transition gets the highest priority seen so far, so that it is sampled soon.
+    class ReplayPriorities {
+    public:
+        // Parameters:
+        //   alpha: The exponent of the TD errors in the priorities, 0 for uniform draws.
+        //   epsilon: The priority added to the TD errors, so that no transition has a zero priority.
+        ReplayPriorities(double alpha, double epsilon) :
+            alpha_(alpha),
+            epsilon_(epsilon)
+        {}
+
+        // Clears the priorities of `size` transitions, which are not drawn until they are set.
+        void Reset(Int size) {
+            priorities_.Reset(size, 0);
+            min_priorities_.Reset(size, std::numeric_limits<double>::lowest());
+            max_priority_ = 1;
+        }
+
+        // Returns the number of bytes of the trees of `size` transitions.
+        static Int NumBytes(Int size) {
+            Int capacity = 1;
+            while (capacity < size)
+                capacity *= 2;
+            return size * 2 * sizeof(double) + capacity * (sizeof(double) + 2 * sizeof(Int));
+        }
+
+        // Gives a transition the highest priority seen so far.
+        void SetNew(Int i) {
+            Set(i, std::pow(max_priority_, alpha_));
+        }
+
+        void Set(Int i, double priority) {
+            priorities_.Set(i, priority);
+            min_priorities_.Set(i, -priority);
+        }
+
+        void Clear(Int i) {
+            priorities_.Set(i, 0);
+            min_priorities_.Set(i, std::numeric_limits<double>::lowest());
+        }
+
+        // Sets the priorities of transitions from their TD errors.
+        void Update(const torch::Tensor& indices, const torch::Tensor& td_errors) {
+            torch::Tensor cpu_indices = indices.to(torch::kCPU, torch::kInt64).contiguous();
+            torch::Tensor cpu_td_errors = td_errors.detach().to(torch::kCPU, torch::kFloat64).flatten().contiguous();
+            const Int* indices_ptr = cpu_indices.data_ptr<Int>();
+            const double* td_errors_ptr = cpu_td_errors.data_ptr<double>();
+            for (Int i=0; i<cpu_indices.numel(); ++i) {
+                double priority = std::abs(td_errors_ptr[i]) + epsilon_;
+                max_priority_ = std::max(max_priority_, priority);
+                Set(indices_ptr[i], std::pow(priority, alpha_));
+            }
+        }
+
+        // Draws `batch_size` transitions in proportion to their priorities, and returns their indices and their
+        // importance sampling weights raised to the power beta. The draws are stratified: the total priority is
+        // split into as many segments as the batch size and a transition is drawn in each.
+        std::pair<torch::Tensor, torch::Tensor> Draw(Int batch_size, double beta) const {
+            std::vector<Int> indices(batch_size);
+            std::vector<float> weights(batch_size);
+            double total = priorities_.total();
+            double min_priority = -min_priorities_.max();
+            torch::Tensor draws = torch::rand({ batch_size }, torch::kFloat64);
+            auto draws_a = draws.accessor<double, 1>();
+            double segment = total / batch_size;
+            for (Int i=0; i<batch_size; ++i) {
+                double target = std::min((i + draws_a[i]) * segment, std::nextafter(total, 0.0));
+                Int index = priorities_.Find(target);
+                // The rounding of the sums may land a target at the end of a run of free slots.
+                while (index > 0 && priorities_.Get(index) <= 0)
+                    --index;
+                indices[i] = index;
+                weights[i] = std::pow(priorities_.Get(index) / min_priority, -beta);
+            }
+            return { torch::tensor(indices, torch::kInt64), torch::tensor(weights, torch::kFloat32) };
+        }
+
+        double alpha() const {
+            return alpha_;
+        }
+
+        double epsilon() const {
+            return epsilon_;
+        }
+
+        const SumTree<double>& tree() const {
+            return priorities_;
+        }
+
+    protected:
+        double alpha_;
+        double epsilon_;
+        double max_priority_ = 1;
+        SumTree<double> priorities_;
+        MaxTree<double> min_priorities_; // The negated priorities, for the lowest one.
+    };
+
+    // A replay buffer sampling the transitions in proportion to their priorities, their last TD errors raised to the
+    // power alpha, with importance sampling weights which correct the bias of the updates by the power beta, after
+    // Schaul et al. The priorities are kept in ReplayPriorities, so that adding, sampling and updating a transition
+    // cost O(log n), and the draws are stratified.
+    // Paper: https://arxiv.org/abs/1511.05952
+    //
+    // The algorithms weight their losses and update the priorities when the batches have weights, so returning this
+    // buffer from MakeReplayBuffer() turns the prioritized replay on.
+    class PrioritizedReplayBuffer : public ReplayBuffer {
+    public:
+        PrioritizedReplayBuffer(
+            Int buffer_capacity,
+            Int num_envs,
+            const std::vector<Int>& observation_sizes, 
+            const std::vector<Int>& action_sizes,
+            torch::Dtype observation_type = torch::kFloat32,
+            torch::Dtype action_type = torch::kFloat32,
+            const torch::Device& device = torch::kCPU,
+            bool optimize_memory_usage = false,
+            const std::shared_ptr<ObservationCodec>& observation_codec = nullptr,
+            double alpha = 0.6, // The exponent of the TD errors in the priorities, 0 for uniform draws.
+            double beta = 0.4, // The exponent of the importance sampling weights, 1 for a full correction.
+            double epsilon = 1e-6 // The priority added to the TD errors, so that no transition has a zero priority.
+        ) :
+            ReplayBuffer(buffer_capacity, num_envs, observation_sizes, action_sizes, observation_type, action_type, device, optimize_memory_usage, observation_codec),
+            beta_(beta),
+            priorities_(alpha, epsilon)
+        {
+            priorities_.Reset(buffer_size_ * num_envs_);
+            memory_usage_.Set(memory_usage_.num_bytes() + ReplayPriorities::NumBytes(buffer_size_ * num_envs_));
+        }
+
+        virtual ~PrioritizedReplayBuffer() = default;
+
+        virtual void Reset() override {
+            ReplayBuffer::Reset();
+            priorities_.Reset(buffer_size_ * num_envs_);
+        }
+
+        virtual Batch Sample(Int batch_size) override {
+            if (num_groups_ > 1)
+                throw std::runtime_error("PrioritizedReplayBuffer: the prioritized sampling does not support groups of environments.");
+            auto [flat_indices, weights] = priorities_.Draw(batch_size, beta_);
+            Batch batch = GetBatch(flat_indices.div(num_envs_, "floor"), flat_indices.remainder(num_envs_));
+            batch.indices = flat_indices;
+            batch.weights = weights.to(device_);
+            return batch;
+        }
+
+        virtual void Add(
+            const torch::Tensor& observations,
+            const torch::Tensor& actions,
+            const torch::Tensor& next_observations,
+            const torch::Tensor& rewards,
+            const torch::Tensor& dones
+        ) override {
+            Int pos = pos_;
+            ReplayBuffer::Add(observations, actions, next_observations, rewards, dones);
+            for (Int i=0; i<num_envs_; ++i)
+                priorities_.SetNew(pos * num_envs_ + i);
+            // The oldest slot of a full buffer holds the next observations of the latest transitions.
+            if (optimize_memory_usage_ && full_) {
+                for (Int i=0; i<num_envs_; ++i)
+                    priorities_.Clear(pos_ * num_envs_ + i);
+            }
+        }
+
+        virtual void UpdatePriorities(const torch::Tensor& indices, const torch::Tensor& td_errors) override {
+            priorities_.Update(indices, td_errors);
+        }
+
+        // Loads the transitions, which get the highest priority seen so far, as the priorities are not saved.
+        virtual void LoadArchive(torch::serialize::InputArchive* archive) override {
+            ReplayBuffer::LoadArchive(archive);
+            priorities_.Reset(buffer_size_ * num_envs_);
+            for (Int i=0; i<Size()*num_envs_; ++i)
+                priorities_.SetNew(i);
+            if (optimize_memory_usage_ && full_) {
+                for (Int i=0; i<num_envs_; ++i)
+                    priorities_.Clear(pos_ * num_envs_ + i);
+            }
+        }
+
+        double alpha() const {
+            return priorities_.alpha();
+        }
+
+        double beta() const {
+            return beta_;
+        }
+
+        // Sets the exponent of the importance sampling weights, which is usually annealed towards 1 over the training.
+        void set_beta(double beta) {
+            beta_ = beta;
+        }
+
+        // Returns the priorities of the transitions, raised to the power alpha, by index of Batch::indices.
+        const SumTree<double>& priorities() const {
+            return priorities_.tree();
+        }
+
+    protected:
+        double beta_;
+        ReplayPriorities priorities_;
+    };
+
+    // A replay buffer whose transitions are stored in a memory-mapped file instead of tensors in memory. Its capacity
+    // can exceed the memory, as only the pages touched by Add() and Sample() are resident, and a checkpoint is a
+    // Flush() of the slots added since the previous one instead of a serialization of the whole buffer. The tensors of
+    // the buffer are views of the file made with torch::from_blob, which Add() writes to and Sample() gathers from in
+    // place, so the buffer is on the CPU.
+    //
+    // The file starts with a header page, followed by a region per tensor aligned on a page, in which a slot is a
+    // record of a fixed size over all environments: the stored observations, the next observations unless
+    // `optimize_memory_usage`, the actions, the rewards and the dones. The header holds the layout, which must match
+    // when an existing file is opened, and the position of the buffer as of the last Flush(), so that the buffer
+    // resumes from the last checkpoint of the file. As Reset() empties the buffer, a run resumes with Load(path())
+    // after it. The final observations of the episodes with `optimize_memory_usage`, which are few, are written to an
+    // archive next to the file, at `path` + ".final".
+    //
+    // The buffer is not counted in the memory budget of the replay buffers, since its pages belong to the page cache,
+    // which the kernel evicts under memory pressure.
+    class MappedReplayBuffer : public ReplayBuffer {
+    public:
+        MappedReplayBuffer(
+            const std::string& path,
+            Int buffer_capacity,
+            Int num_envs,
+            const std::vector<Int>& observation_sizes, 
+            const std::vector<Int>& action_sizes,
+            torch::Dtype observation_type = torch::kFloat32,
+            torch::Dtype action_type = torch::kFloat32,
+            bool optimize_memory_usage = false,
+            const std::shared_ptr<ObservationCodec>& observation_codec = nullptr
+        ) :
+            ReplayBuffer(buffer_capacity, num_envs, observation_sizes, action_sizes, observation_type, action_type, torch::kCPU, optimize_memory_usage, observation_codec, false)
+        {
+            Open(path);
+        }
+
+        DISALLOW_COPY_AND_ASSIGN(MappedReplayBuffer);
+
+        // The transitions added since the last Flush() still reach the file, but not the position of the buffer.
+        virtual ~MappedReplayBuffer() = default;
+
+        static constexpr const char* kMagic = "RLOPRB01";
+
+        virtual void Reset() override {
+            ReplayBuffer::Reset();
+            num_dirty_ = 0;
+        }
+
+        virtual void Add(
+            const torch::Tensor& observations,
+            const torch::Tensor& actions,
+            const torch::Tensor& next_observations,
+            const torch::Tensor& rewards,
+            const torch::Tensor& dones
+        ) override {
+            ReplayBuffer::Add(observations, actions, next_observations, rewards, dones);
+            num_dirty_ = std::min(num_dirty_ + 1, buffer_size_);
+        }
+
+        // Writes the slots added since the last Flush(), then the position of the buffer, to the file, which makes a
+        // checkpoint of the buffer.
+        void Flush() {
+            // With `optimize_memory_usage`, Add() also writes the observations of the slot after the latest.
+            Int num_slots = std::min(num_dirty_ + (optimize_memory_usage_ ? 1 : 0), buffer_size_);
+            Int begin = ((pos_ - num_dirty_) % buffer_size_ + buffer_size_) % buffer_size_;
+            Int num_first_slots = std::min(num_slots, buffer_size_ - begin);
+            for (const auto& region : regions_) {
+                if (num_first_slots > 0)
+                    file_.Flush(region.offset + begin * region.record_num_bytes, num_first_slots * region.record_num_bytes);
+                if (num_slots > num_first_slots)
+                    file_.Flush(region.offset, (num_slots - num_first_slots) * region.record_num_bytes);
+            }
+            std::string final_path = FinalObservationsPath(file_.path());
+            if (final_observations_.empty())
+                std::filesystem::remove(final_path);
+            else {
+                torch::serialize::OutputArchive archive;
+                WriteFinalObservations(&archive);
+                archive.save_to(final_path);
+            }
+            header()->pos = pos_;
+            header()->full = full_;
+            file_.Flush(0, sizeof(Header));
+            num_dirty_ = 0;
+        }
+
+        // Loads a file of a mapped buffer by copying it over the file of the buffer, which does not hold the file in
+        // memory, or the file itself at the last checkpoint, or an archive of ReplayBuffer::Save().
+        virtual void Load(const std::string& path) override {
+            if (!IsMappedFile(path)) {
+                ReplayBuffer::Load(path);
+                return;
+            }
+            std::string own_path = file_.path();
+            if (!std::filesystem::equivalent(path, own_path)) {
+                file_.Close();
+                std::filesystem::copy_file(path, own_path, std::filesystem::copy_options::overwrite_existing);
+                std::filesystem::remove(FinalObservationsPath(own_path));
+                if (std::filesystem::exists(FinalObservationsPath(path)))
+                    std::filesystem::copy_file(FinalObservationsPath(path), FinalObservationsPath(own_path));
+            }
+            Open(own_path);
+        }
+
+        // Makes a checkpoint and copies the file to `path`, unless it is the file of the buffer.
+        virtual void Save(const std::string& path) override {
+            Flush();
+            std::string own_path = file_.path();
+            if (std::filesystem::exists(path) && std::filesystem::equivalent(path, own_path))
+                return;
+            std::filesystem::copy_file(own_path, path, std::filesystem::copy_options::overwrite_existing);
+            std::filesystem::remove(FinalObservationsPath(path));
+            if (std::filesystem::exists(FinalObservationsPath(own_path)))
+                std::filesystem::copy_file(FinalObservationsPath(own_path), FinalObservationsPath(path));
+        }
+
+        // Loads an archive of ReplayBuffer::Save() into the file, whose layout it must match, and flushes it.
+        virtual void LoadArchive(torch::serialize::InputArchive* archive) override {
+            torch::Tensor tensor;
+            if ((archive->try_read("optimize_memory_usage", tensor) && tensor.item<bool>()) != optimize_memory_usage_)
+                throw std::runtime_error("MappedReplayBuffer: the optimize_memory_usage of the archive does not match " + file_.path() + ".");
+            ReplayBuffer::LoadArchive(archive);
+            num_dirty_ = buffer_size_;
+            Flush();
+        }
+
+        // Returns whether a file is the file of a mapped buffer.
+        static bool IsMappedFile(const std::string& path) {
+            char magic[8] = {};
+            std::ifstream input(path, std::ios::binary);
+            return input.read(magic, sizeof(magic)) && std::equal(magic, magic + sizeof(magic), kMagic);
+        }
+
+        const std::string& path() const {
+            return file_.path();
+        }
+
+        // Returns the number of slots added since the last Flush().
+        Int num_dirty() const {
+            return num_dirty_;
+        }
+
+    protected:
+        static constexpr Int kVersion = 1;
+        static constexpr Int kMaxNumDims = 8;
+        static constexpr size_t kAlignment = 4096; // The alignment of the regions, a page.
+
+        struct Header {
+            char magic[8];
+            Int version;
+            Int buffer_size;
+            Int num_envs;
+            Int optimize_memory_usage;
+            Int observation_type; // The stored type, as a c10::ScalarType.
+            Int action_type;
+            Int num_observation_dims;
+            Int observation_sizes[kMaxNumDims]; // The stored sizes of an observation.
+            Int num_action_dims;
+            Int action_sizes[kMaxNumDims];
+            Int pos; // The position of the buffer as of the last Flush().
+            Int full;
+        };
+
+        // A tensor of the buffer in the file.
+        struct Region {
+            torch::Tensor* tensor;
+            std::vector<Int> sizes;
+            torch::Dtype type;
+            size_t offset;
+            size_t record_num_bytes; // The number of bytes of a slot.
+        };
+
+        // Copies the tensor of the archive into the file instead of replacing the view.
+        virtual void ReadTensor(torch::serialize::InputArchive* archive, const std::string& key, torch::Tensor* tensor) override {
+            torch::Tensor archived;
+            archive->read(key, archived);
+            if (!archived.sizes().equals(tensor->sizes()) || archived.scalar_type() != tensor->scalar_type())
+                throw std::runtime_error("MappedReplayBuffer: the " + key + " of the archive do not match the layout of " + file_.path() + ".");
+            tensor->copy_(archived);
+        }
+
+        static std::string FinalObservationsPath(const std::string& path) {
+            return path + ".final";
+        }
+
+        Header* header() {
+            return reinterpret_cast<Header*>(file_.data());
+        }
+
+        Header MakeHeader() const {
+            Header header = {};
+            std::copy(kMagic, kMagic + sizeof(header.magic), header.magic);
+            header.version = kVersion;
+            header.buffer_size = buffer_size_;
+            header.num_envs = num_envs_;
+            header.optimize_memory_usage = optimize_memory_usage_;
+            header.observation_type = static_cast<Int>(StoredObservationType());
+            header.action_type = static_cast<Int>(action_type_);
+            std::vector<Int> observation_sizes = StoredObservationSizes({});
+            if (observation_sizes.size() > kMaxNumDims || action_sizes_.size() > kMaxNumDims)
+                throw std::runtime_error("MappedReplayBuffer: the observations and actions have at most " + std::to_string(kMaxNumDims) + " dimensions.");
+            header.num_observation_dims = observation_sizes.size();
+            std::copy(observation_sizes.begin(), observation_sizes.end(), header.observation_sizes);
+            header.num_action_dims = action_sizes_.size();
+            std::copy(action_sizes_.begin(), action_sizes_.end(), header.action_sizes);
+            return header;
+        }
+
+        // Whether a header has the layout of the buffer, whatever its position.
+        bool MatchesLayout(const Header& header) const {
+            Header expected = MakeHeader();
+            expected.pos = header.pos;
+            expected.full = header.full;
+            return std::memcmp(&header, &expected, sizeof(Header)) == 0;
+        }
+
+        // Places the tensors one after another, each on a new page, and returns the size of the file.
+        size_t PlaceRegions() {
+            std::vector<Int> action_buffer_sizes = { buffer_size_, num_envs_ };
+            action_buffer_sizes.insert(action_buffer_sizes.end(), action_sizes_.begin(), action_sizes_.end()); 
+            regions_.clear();
+            regions_.push_back({ &observations_, StoredObservationSizes({ buffer_size_, num_envs_ }), StoredObservationType() });
+            if (!optimize_memory_usage_)
+                regions_.push_back({ &next_observations_, StoredObservationSizes({ buffer_size_, num_envs_ }), StoredObservationType() });
+            regions_.push_back({ &actions_, action_buffer_sizes, action_type_ });
+            regions_.push_back({ &rewards_, { buffer_size_, num_envs_ }, torch::kFloat32 });
+            regions_.push_back({ &dones_, { buffer_size_, num_envs_ }, torch::kFloat32 });
+            size_t offset = kAlignment;
+            for (auto& region : regions_) {
+                region.offset = offset;
+                region.record_num_bytes = std::accumulate(region.sizes.begin() + 1, region.sizes.end(), Int(1), std::multiplies<Int>()) * 
+                    c10::elementSize(region.type);
+                offset += (region.record_num_bytes * buffer_size_ + kAlignment - 1) / kAlignment * kAlignment;
+            }
+            return offset;
+        }
+
+        // Maps the file, which is created if it does not exist and resumed from its last checkpoint otherwise.
+        void Open(const std::string& path) {
+            bool exists = std::filesystem::exists(path) && std::filesystem::file_size(path) > 0;
+            if (exists) {
+                // The layout is checked before mapping, which would extend a smaller file.
+                Header header = {};
+                std::ifstream input(path, std::ios::binary);
+                if (!input.read(reinterpret_cast<char*>(&header), sizeof(Header)) || !MatchesLayout(header))
+                    throw std::runtime_error("MappedReplayBuffer: " + path + " is not a replay buffer of the same layout.");
+            }
+            file_.Open(path, PlaceRegions());
+            file_.AdviseRandom();
+            if (exists) {
+                pos_ = header()->pos;
+                full_ = header()->full;
+                final_observations_.clear();
+                if (std::filesystem::exists(FinalObservationsPath(path))) {
+                    torch::serialize::InputArchive archive;
+                    archive.load_from(FinalObservationsPath(path));
+                    ReadFinalObservations(&archive);
+                }
+            }
+            else {
+                *header() = MakeHeader();
+                file_.Flush(0, sizeof(Header));
+            }
+            for (auto& region : regions_)
+                *region.tensor = torch::from_blob(file_.data() + region.offset, region.sizes, torch::TensorOptions().dtype(region.type));
+            num_dirty_ = 0;
+        }
+
+        WritableMappedFile file_;
+        std::vector<Region> regions_;
+        Int num_dirty_ = 0;
+    };
+
+    // A replay buffer whose transitions are stored in POSIX shared memory, so that actor processes add to it while a
+    // learner process samples it, which scales the collection past the environments one process can step, such as
+    // the environments of Python bound by the GIL. One process creates the segment, usually the learner before the
+    // actors start, and the others attach to it by name with the same layout. The tensors of the buffer are views of
+    // the segment made with torch::from_blob, so the buffer is on the CPU.
+    //
+    // The writers share a cursor, the number of slots reserved so far, which Add() advances with one atomic
+    // fetch_add, so that the processes append without a lock: a slot is the cursor, its ticket, modulo the capacity,
+    // which overwrites the oldest slot of a full buffer. Each slot has a version, odd while its ticket is written and
+    // even once committed, which the reader checks before and after gathering a transition, as a seqlock: the
+    // transitions of the slots being written or overwritten meanwhile are drawn again, so that a batch only holds
+    // committed transitions. The capacity must exceed by far the number of writers, which a slot is not shared by.
+    //
+    // With `optimize_memory_usage`, the slots of the writers interleave, so the next observations of a transition are
+    // the observations of the next slot of its writer, which a link of the transition points to once that slot is
+    // committed, and the slot points back to, so that a link into an overwritten slot is not followed. The final
+    // observations of the episodes are written to a slot of their own, reserved at the steps where an episode ended,
+    // which is never sampled, so the optimization pays off with episodes much longer than a step of the environments.
+    // The latest transition of a writer is sampled from its next Add() on.
+    //
+    // With `prioritized`, the sampling process keeps the priorities of the transitions as a PrioritizedReplayBuffer
+    // does, which the new slots enter with the highest priority seen so far when it samples next. The priorities live
+    // in the sampling process only, so a single process samples a prioritized buffer.
+    //
+    // Reset() clears the segment in the creator, which the writers must not add to meanwhile, and only the state of
+    // the process in the others. The buffer cannot be saved or loaded, as the writers change it concurrently.
+    class SharedReplayBuffer : public ReplayBuffer {
+    public:
+        // Parameters:
+        //   name: The name of the segment of shared memory, such as "/rlop_replay".
+        //   create: Whether to create the segment, replacing one of the same name, or to attach to it.
+        //   alpha, beta, epsilon: The parameters of the priorities with `prioritized`, as in PrioritizedReplayBuffer.
+        SharedReplayBuffer(
+            const std::string& name,
+            bool create,
+            Int buffer_capacity,
+            Int num_envs,
+            const std::vector<Int>& observation_sizes, 
+            const std::vector<Int>& action_sizes,
+            torch::Dtype observation_type = torch::kFloat32,
+            torch::Dtype action_type = torch::kFloat32,
+            bool optimize_memory_usage = false,
+            const std::shared_ptr<ObservationCodec>& observation_codec = nullptr,
+            bool prioritized = false,
+            double alpha = 0.6,
+            double beta = 0.4,
+            double epsilon = 1e-6
+        ) :
+            ReplayBuffer(buffer_capacity, num_envs, observation_sizes, action_sizes, observation_type, action_type, torch::kCPU, optimize_memory_usage, observation_codec, false),
+            prioritized_(prioritized),
+            beta_(beta),
+            priorities_(alpha, epsilon)
+        {
+            static_assert(std::atomic<Int>::is_always_lock_free, "SharedReplayBuffer: requires lock-free atomics, which are shared between processes.");
+            Open(name, create);
+            if (prioritized_)
+                priorities_.Reset(buffer_size_ * num_envs_);
+            Sync();
+        }
+
+        DISALLOW_COPY_AND_ASSIGN(SharedReplayBuffer);
+
+        virtual ~SharedReplayBuffer() = default;
+
+        static constexpr const char* kMagic = "RLOPSB01";
+        static constexpr Int kMaxDrawRounds = 100; // The number of draws of the rows of a batch before giving up.
+
+        virtual void Reset() override {
+            ReplayBuffer::Reset();
+            if (memory_.owner()) {
+                header()->cursor.store(0, std::memory_order_relaxed);
+                for (Int i=0; i<buffer_size_; ++i)
+                    versions_[i].store(0, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_release);
+            }
+            last_ticket_ = -1;
+            last_next_observations_ = torch::Tensor();
+            synced_ticket_ = 0;
+            if (prioritized_)
+                priorities_.Reset(buffer_size_ * num_envs_);
+            Sync();
+        }
+
+        // Draws a batch of committed transitions, uniformly or in proportion to their priorities.
+        virtual Batch Sample(Int batch_size) override {
+            if (num_groups_ > 1)
+                throw std::runtime_error("SharedReplayBuffer: the shared sampling does not support groups of environments.");
+            Sync();
+            if (Size() == 0)
+                throw std::runtime_error("SharedReplayBuffer: samples an empty buffer.");
+            std::vector<torch::Tensor> observations, actions, next_observations, rewards, dones, weights, indices;
+            Int num_rows = 0;
+            for (Int round=0; num_rows < batch_size; ++round) {
+                if (round >= kMaxDrawRounds)
+                    throw std::runtime_error("SharedReplayBuffer: cannot draw " + std::to_string(batch_size) + " committed transitions from " + memory_.name() + ".");
+                torch::Tensor flat_indices, draw_weights;
+                if (prioritized_)
+                    std::tie(flat_indices, draw_weights) = priorities_.Draw(batch_size - num_rows, beta_);
+                else
+                    flat_indices = torch::randint(0, Size(), { batch_size - num_rows }, torch::kInt64) * num_envs_ + 
+                        torch::randint(0, num_envs_, { batch_size - num_rows }, torch::kInt64);
+                std::vector<Draw> draws = CheckDraws(flat_indices);
+                if (draws.empty())
+                    continue;
+                std::vector<Int> slots, envs, next_slots;
+                for (const auto& draw : draws) {
+                    slots.push_back(draw.slot);
+                    envs.push_back(draw.env);
+                    next_slots.push_back(draw.next_slot);
+                }
+                torch::Tensor slot_indices = torch::tensor(slots, torch::kInt64);
+                torch::Tensor env_indices = torch::tensor(envs, torch::kInt64);
+                torch::Tensor next_indices = optimize_memory_usage_ ? torch::tensor(next_slots, torch::kInt64) : slot_indices;
+                torch::Tensor gathered_observations = observations_.index({ slot_indices, env_indices, "..." });
+                torch::Tensor gathered_actions = actions_.index({ slot_indices, env_indices, "..." });
+                torch::Tensor gathered_next_observations = (optimize_memory_usage_ ? observations_ : next_observations_).index({ next_indices, env_indices, "..." });
+                torch::Tensor gathered_rewards = rewards_.index({ slot_indices, env_indices });
+                torch::Tensor gathered_dones = dones_.index({ slot_indices, env_indices });
+                // The transitions whose slots were written during the gathers are torn.
+                std::atomic_thread_fence(std::memory_order_acquire);
+                std::vector<Int> kept;
+                for (Int i=0; i<draws.size(); ++i) {
+                    const Draw& draw = draws[i];
+                    if (versions_[draw.slot].load(std::memory_order_relaxed) == draw.version && 
+                        (!optimize_memory_usage_ || versions_[draw.next_slot].load(std::memory_order_relaxed) == draw.next_version))
+                        kept.push_back(i);
+                }
+                torch::Tensor rows = torch::tensor(kept, torch::kInt64);
+                observations.push_back(gathered_observations.index({ rows }));
+                actions.push_back(gathered_actions.index({ rows }));
+                next_observations.push_back(gathered_next_observations.index({ rows }));
+                rewards.push_back(gathered_rewards.index({ rows }));
+                dones.push_back(gathered_dones.index({ rows }));
+                if (prioritized_) {
+                    indices.push_back((slot_indices * num_envs_ + env_indices).index({ rows }));
+                    std::vector<Int> draw_rows;
+                    for (Int i : kept)
+                        draw_rows.push_back(draws[i].row);
+                    weights.push_back(draw_weights.index({ torch::tensor(draw_rows, torch::kInt64) }));
+                }
+                num_rows += kept.size();
+            }
+            Batch batch;
+            batch.observations = DecodeObservations(torch::cat(observations));
+            batch.actions = torch::cat(actions);
+            batch.next_observations = DecodeObservations(torch::cat(next_observations));
+            batch.rewards = torch::cat(rewards);
+            batch.dones = torch::cat(dones);
+            if (prioritized_) {
+                batch.weights = torch::cat(weights);
+                batch.indices = torch::cat(indices);
+            }
+            return batch;
+        }
+
+        // Appends the transitions of a step of the environments of the process to the buffer.
+        virtual void Add(
+            const torch::Tensor& observations,
+            const torch::Tensor& actions,
+            const torch::Tensor& next_observations,
+            const torch::Tensor& rewards,
+            const torch::Tensor& dones
+        ) override {
+            torch::Tensor stored_observations = EncodeObservations(observations).to(torch::kCPU);
+            torch::Tensor stored_next_observations = EncodeObservations(next_observations).to(torch::kCPU);
+            if (!optimize_memory_usage_) {
+                Int ticket = Reserve();
+                Int slot = BeginWrite(ticket);
+                observations_[slot].copy_(stored_observations);
+                next_observations_[slot].copy_(stored_next_observations);
+                WriteTransition(slot, actions, rewards, dones);
+                Commit(slot, ticket);
+                Sync();
+                return;
+            }
+            // The environments whose observations differ from the next observations of the previous step ended an
+            // episode, whose final observations get a slot.
+            std::vector<bool> ended(num_envs_, false);
+            Int final_ticket = -1;
+            if (last_ticket_ >= 0) {
+                torch::Tensor ended_mask = last_next_observations_.ne(stored_observations).reshape({ num_envs_, -1 }).any(1);
+                auto ended_a = ended_mask.accessor<bool, 1>();
+                for (Int i=0; i<num_envs_; ++i)
+                    ended[i] = ended_a[i];
+                if (std::find(ended.begin(), ended.end(), true) != ended.end()) {
+                    final_ticket = Reserve();
+                    Int slot = BeginWrite(final_ticket);
+                    for (Int i=0; i<num_envs_; ++i) {
+                        links_[slot * num_envs_ + i].store(kFinal, std::memory_order_relaxed);
+                        previous_tickets_[slot * num_envs_ + i].store(ended[i] ? last_ticket_ : -1, std::memory_order_relaxed);
+                    }
+                    observations_[slot].copy_(last_next_observations_);
+                    Commit(slot, final_ticket);
+                }
+            }
+            Int ticket = Reserve();
+            Int slot = BeginWrite(ticket);
+            for (Int i=0; i<num_envs_; ++i) {
+                links_[slot * num_envs_ + i].store(kUnlinked, std::memory_order_relaxed);
+                previous_tickets_[slot * num_envs_ + i].store(last_ticket_ >= 0 && !ended[i] ? last_ticket_ : -1, std::memory_order_relaxed);
+            }
+            observations_[slot].copy_(stored_observations);
+            WriteTransition(slot, actions, rewards, dones);
+            Commit(slot, ticket);
+            // The previous slot is not linked if another writer overwrote it meanwhile.
+            Int last_slot = last_ticket_ % buffer_size_;
+            if (last_ticket_ >= 0 && versions_[last_slot].load(std::memory_order_acquire) == 2 * last_ticket_ + 2) {
+                for (Int i=0; i<num_envs_; ++i)
+                    links_[last_slot * num_envs_ + i].store(ended[i] ? final_ticket : ticket, std::memory_order_release);
+            }
+            last_ticket_ = ticket;
+            last_next_observations_ = stored_next_observations.clone();
+            Sync();
+        }
+
+        virtual void UpdatePriorities(const torch::Tensor& indices, const torch::Tensor& td_errors) override {
+            if (prioritized_)
+                priorities_.Update(indices, td_errors);
+        }
+
+        virtual void Load(const std::string& path) override {
+            throw std::runtime_error("SharedReplayBuffer: cannot load a buffer shared between processes.");
+        }
+
+        virtual void LoadArchive(torch::serialize::InputArchive* archive) override {
+            throw std::runtime_error("SharedReplayBuffer: cannot load a buffer shared between processes.");
+        }
+
+        virtual void SaveArchive(torch::serialize::OutputArchive* archive) override {
+            throw std::runtime_error("SharedReplayBuffer: cannot save a buffer shared between processes.");
+        }
+
+        // Updates the size of the buffer from the cursor shared by the writers, and with `prioritized`, gives the
+        // slots reserved since the previous update the highest priority seen so far. Sample() and Add() update it.
+        void Sync() {
+            Int cursor = header()->cursor.load(std::memory_order_acquire);
+            pos_ = cursor % buffer_size_;
+            full_ = cursor >= buffer_size_;
+            if (prioritized_) {
+                for (Int ticket = std::max(synced_ticket_, cursor - buffer_size_); ticket < cursor; ++ticket) {
+                    Int slot = ticket % buffer_size_;
+                    for (Int i=0; i<num_envs_; ++i)
+                        priorities_.SetNew(slot * num_envs_ + i);
+                }
+            }
+            synced_ticket_ = cursor;
+        }
+
+        const std::string& name() const {
+            return memory_.name();
+        }
+
+        // Returns whether the process created the segment.
+        bool owner() const {
+            return memory_.owner();
+        }
+
+        // Returns the number of slots reserved by all the writers so far.
+        Int num_reserved() const {
+            return header()->cursor.load(std::memory_order_acquire);
+        }
+
+        bool prioritized() const {
+            return prioritized_;
+        }
+
+        double beta() const {
+            return beta_;
+        }
+
+        // Sets the exponent of the importance sampling weights with `prioritized`.
+        void set_beta(double beta) {
+            beta_ = beta;
+        }
+
+    protected:
+        static constexpr Int kVersion = 1;
+        static constexpr Int kMaxNumDims = 8;
+        static constexpr size_t kAlignment = 4096; // The alignment of the regions, a page.
+        static constexpr Int kUnlinked = -1; // The link of a transition whose next slot is not committed yet.
+        static constexpr Int kFinal = -2; // The links of a slot of final observations, which is never sampled.
+
+        // The layout of the buffer, which the processes attaching to the segment must match.
+        struct Layout {
+            char magic[8];
+            Int version;
+            Int buffer_size;
+            Int num_envs;
+            Int optimize_memory_usage;
+            Int observation_type; // The stored type, as a c10::ScalarType.
+            Int action_type;
+            Int num_observation_dims;
+            Int observation_sizes[kMaxNumDims]; // The stored sizes of an observation.
+            Int num_action_dims;
+            Int action_sizes[kMaxNumDims];
+        };
+
+        struct Header {
+            Layout layout;
+            std::atomic<Int> ready; // Set by the creator once the layout is written.
+            alignas(kCacheLineSize) std::atomic<Int> cursor; // The number of slots reserved, the next ticket.
+        };
+
+        // A drawn transition which was committed before its gather.
+        struct Draw {
+            Int row; // The row of the draw.
+            Int slot;
+            Int env;
+            Int version;
+            Int next_slot; // The slot of the next observations with `optimize_memory_usage`.
+            Int next_version;
+        };
+
+        Header* header() const {
+            return reinterpret_cast<Header*>(const_cast<char*>(memory_.data()));
+        }
+
+        Layout MakeLayout() const {
+            Layout layout = {};
+            std::copy(kMagic, kMagic + sizeof(layout.magic), layout.magic);
+            layout.version = kVersion;
+            layout.buffer_size = buffer_size_;
+            layout.num_envs = num_envs_;
+            layout.optimize_memory_usage = optimize_memory_usage_;
+            layout.observation_type = static_cast<Int>(StoredObservationType());
+            layout.action_type = static_cast<Int>(action_type_);
+            std::vector<Int> observation_sizes = StoredObservationSizes({});
+            if (observation_sizes.size() > kMaxNumDims || action_sizes_.size() > kMaxNumDims)
+                throw std::runtime_error("SharedReplayBuffer: the observations and actions have at most " + std::to_string(kMaxNumDims) + " dimensions.");
+            layout.num_observation_dims = observation_sizes.size();
+            std::copy(observation_sizes.begin(), observation_sizes.end(), layout.observation_sizes);
+            layout.num_action_dims = action_sizes_.size();
+            std::copy(action_sizes_.begin(), action_sizes_.end(), layout.action_sizes);
+            return layout;
+        }
+
+        // Maps the segment and places the tensors and the versions and links of the slots in it, each on a new page.
+        void Open(const std::string& name, bool create) {
+            Layout layout = MakeLayout();
+            std::vector<Int> observation_buffer_sizes = StoredObservationSizes({ buffer_size_, num_envs_ });
+            std::vector<Int> action_buffer_sizes = { buffer_size_, num_envs_ };
+            action_buffer_sizes.insert(action_buffer_sizes.end(), action_sizes_.begin(), action_sizes_.end()); 
+            std::vector<std::tuple<torch::Tensor*, std::vector<Int>, torch::Dtype>> tensors;
+            tensors.emplace_back(&observations_, observation_buffer_sizes, StoredObservationType());
+            if (!optimize_memory_usage_)
+                tensors.emplace_back(&next_observations_, observation_buffer_sizes, StoredObservationType());
+            tensors.emplace_back(&actions_, action_buffer_sizes, action_type_);
+            tensors.emplace_back(&rewards_, std::vector<Int>{ buffer_size_, num_envs_ }, torch::kFloat32);
+            tensors.emplace_back(&dones_, std::vector<Int>{ buffer_size_, num_envs_ }, torch::kFloat32);
+            auto align = [](size_t num_bytes) { return (num_bytes + kAlignment - 1) / kAlignment * kAlignment; };
+            std::vector<size_t> offsets;
+            size_t offset = align(sizeof(Header));
+            for (const auto& [tensor, sizes, type] : tensors) {
+                offsets.push_back(offset);
+                offset += align(std::accumulate(sizes.begin(), sizes.end(), Int(1), std::multiplies<Int>()) * c10::elementSize(type));
+            }
+            size_t versions_offset = offset;
+            offset += align(buffer_size_ * sizeof(std::atomic<Int>));
+            size_t links_offset = offset;
+            size_t previous_tickets_offset = offset + align(buffer_size_ * num_envs_ * sizeof(std::atomic<Int>));
+            if (optimize_memory_usage_)
+                offset = previous_tickets_offset + align(buffer_size_ * num_envs_ * sizeof(std::atomic<Int>));
+            memory_.Open(name, offset, create);
+            if (create) {
+                header()->layout = layout;
+                header()->ready.store(1, std::memory_order_release);
+                memory_usage_.Set(offset);
+            }
+            else if (header()->ready.load(std::memory_order_acquire) != 1 || std::memcmp(&header()->layout, &layout, sizeof(Layout)) != 0)
+                throw std::runtime_error("SharedReplayBuffer: " + name + " is not a replay buffer of the same layout.");
+            for (Int i=0; i<tensors.size(); ++i) {
+                const auto& [tensor, sizes, type] = tensors[i];
+                *tensor = torch::from_blob(memory_.data() + offsets[i], sizes, torch::TensorOptions().dtype(type));
+            }
+            versions_ = reinterpret_cast<std::atomic<Int>*>(memory_.data() + versions_offset);
+            if (optimize_memory_usage_) {
+                links_ = reinterpret_cast<std::atomic<Int>*>(memory_.data() + links_offset);
+                previous_tickets_ = reinterpret_cast<std::atomic<Int>*>(memory_.data() + previous_tickets_offset);
+            }
+            if (prioritized_)
+                memory_usage_.Set(memory_usage_.num_bytes() + ReplayPriorities::NumBytes(buffer_size_ * num_envs_));
+        }
+
+        // Reserves the next slot of the buffer for the process, and returns its ticket.
+        Int Reserve() {
+            return header()->cursor.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // Marks the slot of a ticket as being written, and returns it.
+        Int BeginWrite(Int ticket) {
+            Int slot = ticket % buffer_size_;
+            versions_[slot].store(2 * ticket + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            return slot;
+        }
+
+        // Marks the slot of a ticket as committed, which publishes its writes.
+        void Commit(Int slot, Int ticket) {
+            versions_[slot].store(2 * ticket + 2, std::memory_order_release);
+        }
+
+        void WriteTransition(Int slot, const torch::Tensor& actions, const torch::Tensor& rewards, const torch::Tensor& dones) {
+            actions_[slot].copy_(actions);
+            rewards_[slot].copy_(rewards);
+            dones_[slot].copy_(dones);
+        }
+
+        // Returns the draws of transitions which are committed, with their next observations with
+        // `optimize_memory_usage`, and clears the priorities of the slots of final observations.
+        std::vector<Draw> CheckDraws(const torch::Tensor& flat_indices) {
+            std::vector<Draw> draws;
+            auto flat_indices_a = flat_indices.accessor<Int, 1>();
+            for (Int i=0; i<flat_indices.size(0); ++i) {
+                Draw draw = {};
+                draw.row = i;
+                draw.slot = flat_indices_a[i] / num_envs_;
+                draw.env = flat_indices_a[i] % num_envs_;
+                draw.version = versions_[draw.slot].load(std::memory_order_acquire);
+                if (draw.version <= 0 || draw.version % 2 == 1)
+                    continue;
+                if (optimize_memory_usage_) {
+                    Int ticket = draw.version / 2 - 1;
+                    Int next_ticket = links_[draw.slot * num_envs_ + draw.env].load(std::memory_order_acquire);
+                    if (next_ticket == kFinal && prioritized_)
+                        priorities_.Clear(flat_indices_a[i]);
+                    if (next_ticket < 0)
+                        continue;
+                    draw.next_slot = next_ticket % buffer_size_;
+                    draw.next_version = versions_[draw.next_slot].load(std::memory_order_acquire);
+                    if (draw.next_version != 2 * next_ticket + 2 || 
+                        previous_tickets_[draw.next_slot * num_envs_ + draw.env].load(std::memory_order_relaxed) != ticket)
+                        continue;
+                }
+                draws.push_back(draw);
+            }
+            return draws;
+        }
+
+        SharedMemory memory_;
+        std::atomic<Int>* versions_ = nullptr; // The versions of the slots, 2 * ticket + 1 while written and 2 * ticket + 2 once committed.
+        std::atomic<Int>* links_ = nullptr; // The tickets of the next observations of the transitions, with `optimize_memory_usage`.
+        std::atomic<Int>* previous_tickets_ = nullptr; // The tickets of the transitions whose next observations a slot holds.
+        Int last_ticket_ = -1; // The ticket of the latest transitions added by the process.
+        torch::Tensor last_next_observations_; // Their stored next observations.
+        Int synced_ticket_ = 0;
+        bool prioritized_;
+        double beta_;
+        ReplayPriorities priorities_;
     };
 
     class RolloutBuffer : public RLBuffer {
@@ -264,6 +1445,18 @@ namespace rlop {
                 batch.returns = returns.to(device);
                 return batch;
             }
+
+            // Returns the samples [begin, end) of the batch, as views.
+            Batch Slice(Int begin, Int end) const {
+                Batch batch;
+                batch.observations = observations.slice(0, begin, end);
+                batch.actions = actions.slice(0, begin, end);
+                batch.values = values.slice(0, begin, end);
+                batch.log_prob = log_prob.slice(0, begin, end);
+                batch.advantages = advantages.slice(0, begin, end);
+                batch.returns = returns.slice(0, begin, end);
+                return batch;
+            }
         };
 
         RolloutBuffer(
@@ -273,7 +1466,8 @@ namespace rlop {
             const std::vector<Int>& action_sizes,
             torch::Dtype observation_type = torch::kFloat32,
             torch::Dtype action_type = torch::kFloat32,
-            const torch::Device& device = torch::kCPU
+            const torch::Device& device = torch::kCPU,
+            const std::shared_ptr<ObservationCodec>& observation_codec = nullptr
         ) :
             RLBuffer(
                 num_steps, 
@@ -282,22 +1476,27 @@ namespace rlop {
                 action_sizes,
                 observation_type,
                 action_type, 
-                device
+                device,
+                kMemoryTag
             ),
             observation_buffer_sizes_({ num_steps, num_envs }),
             action_buffer_sizes_({ num_steps, num_envs })
         {
             observation_buffer_sizes_.insert(observation_buffer_sizes_.end(), observation_sizes_.begin(), observation_sizes_.end());
             action_buffer_sizes_.insert(action_buffer_sizes_.end(), action_sizes_.begin(), action_sizes_.end()); 
+            observation_codec_ = observation_codec;
         }
 
         virtual ~RolloutBuffer() = default;
 
+        // The rollout buffers are accounted but not shrunk, since an update needs all the steps of a rollout.
+        static constexpr const char* kMemoryTag = "rollout_buffer";
+
         virtual void Reset() override {
             RLBuffer::Reset();
             start_i_ = 0;
             generator_ready_ = false;
-            observations_ = torch::zeros(observation_buffer_sizes_, observation_type_).to(device_);
+            observations_ = torch::zeros(StoredObservationSizes({ buffer_size_, num_envs_ }), StoredObservationType()).to(device_);
             actions_ = torch::zeros(action_buffer_sizes_, action_type_).to(device_);
             values_ = torch::zeros({ buffer_size_, num_envs_}).to(device_);
             log_probs_ = torch::zeros({ buffer_size_, num_envs_ }).to(device_);
@@ -305,9 +1504,36 @@ namespace rlop {
             returns_ = torch::zeros({ buffer_size_, num_envs_ }).to(device_);
             rewards_ = torch::zeros({ buffer_size_, num_envs_ }).to(device_);
             episode_starts_ = torch::zeros({ buffer_size_, num_envs_ }).to(device_);
+            // The staging copies the observations, the actions and four series of values.
+            memory_usage_.Set(buffer_size_ * (staged_ ? StepNumBytes(2, 2, 10) : StepNumBytes(1, 1, 6)));
         }
 
+        // Returns the next batch of rollouts of an epoch in a random order, and starts a new epoch after the last
+        // batch. With staging, the rollouts are permuted once per epoch into contiguous staging tensors, of which
+        // the batches are views, and the rollouts stay in their [steps, envs] layout. Otherwise, the rollouts are
+        // flattened in place on the first call and each batch is gathered from them.
         virtual Batch Get(Int batch_size) {
+            if (!staged_)
+                return Gather(batch_size);
+            Int num_rollouts = Size() * num_envs_;
+            if (start_i_ == 0)
+                Stage(batch_size);
+            Int length = std::min(batch_size, num_rollouts - start_i_);
+            Batch batch;
+            batch.observations = DecodeObservations(staged_observations_.narrow(0, start_i_, length));
+            batch.actions = staged_actions_.narrow(0, start_i_, length);
+            batch.values = staged_values_.narrow(0, start_i_, length);
+            batch.log_prob = staged_log_probs_.narrow(0, start_i_, length);
+            batch.advantages = staged_advantages_.narrow(0, start_i_, length);
+            batch.returns = staged_returns_.narrow(0, start_i_, length);
+            start_i_ += batch_size;
+            if (start_i_ >= num_rollouts)
+                start_i_ = 0;
+            return batch;
+        }
+
+        // Gathers the next batch from the rollouts flattened in place.
+        Batch Gather(Int batch_size) {
             Int num_rollouts = Size() * num_envs_;
             if (!generator_ready_) {
                 observations_ = SwapAndFlatten(observations_);
@@ -319,10 +1545,10 @@ namespace rlop {
                 generator_ready_ = true;
             }
             if (start_i_ == 0)
-                indices_ = torch::randperm(num_rollouts).to(device_);
+                indices_ = EpochPermutation(batch_size, true).to(device_);
             Batch batch;
             torch::Tensor indices = indices_.slice(0, start_i_, start_i_ + batch_size);
-            batch.observations = observations_.index_select(0, indices); 
+            batch.observations = DecodeObservations(observations_.index_select(0, indices)); 
             batch.actions = actions_.index_select(0, indices); 
             batch.values = values_.index_select(0, indices); 
             batch.log_prob = log_probs_.index_select(0, indices); 
@@ -342,7 +1568,7 @@ namespace rlop {
             const torch::Tensor& rewards,
             const torch::Tensor& episode_starts
         ) {
-            observations_[pos_].copy_(observations);
+            observations_[pos_].copy_(EncodeObservations(observations));
             actions_[pos_].copy_(actions);
             values_[pos_].copy_(values);
             log_probs_[pos_].copy_(log_prob);
@@ -355,16 +1581,44 @@ namespace rlop {
             }
         }
 
+        // Computes the advantages by generalized advantage estimation and the returns. The backward recursion runs on
+        // the host, in a loop over the environments of a step which the compiler vectorizes, instead of a handful of
+        // tensor operations per step. A buffer on a device is copied to the host and back once.
         virtual void UpdateGAE(const torch::Tensor& last_values, const torch::Tensor& dones, double gamma, double gae_lambda) {
-            torch::Tensor last_gae_lam = torch::zeros(num_envs_).to(device_);
             Int size = Size();
+            auto to_host = [](const torch::Tensor& tensor) {
+                return tensor.to(torch::kCPU, torch::kFloat32).contiguous();
+            };
+            torch::Tensor rewards = to_host(rewards_.slice(0, 0, size));
+            torch::Tensor values = to_host(values_.slice(0, 0, size));
+            torch::Tensor episode_starts = to_host(episode_starts_.slice(0, 0, size));
+            torch::Tensor host_last_values = to_host(last_values.reshape({-1}));
+            torch::Tensor host_dones = to_host(dones.reshape({-1}));
+            bool in_place = advantages_.device().is_cpu() && advantages_.scalar_type() == torch::kFloat32 && advantages_.is_contiguous();
+            torch::Tensor advantages = in_place ? advantages_ : torch::empty({ size, num_envs_ }, torch::kFloat32);
+            const float* rewards_ptr = rewards.data_ptr<float>();
+            const float* values_ptr = values.data_ptr<float>();
+            const float* episode_starts_ptr = episode_starts.data_ptr<float>();
+            float* advantages_ptr = advantages.data_ptr<float>();
+            std::vector<float> last_gae_lam(num_envs_, 0);
+            float* last_gae_lam_ptr = last_gae_lam.data();
+            float gamma_f = gamma;
+            float gamma_lambda = gamma * gae_lambda;
             for (Int i=size-1; i>=0; --i) {
-                torch::Tensor next_non_terminal = i == size - 1? 1.0 - dones.to(advantages_.dtype()).to(device_) : 1.0 - episode_starts_[i+1];
-                torch::Tensor next_values = i == size - 1? last_values.to(device_) : values_[i+1]; 
-                torch::Tensor delta = rewards_[i] + gamma * next_values * next_non_terminal - values_[i];
-                last_gae_lam = delta + gamma * gae_lambda * next_non_terminal * last_gae_lam;
-                advantages_[i].copy_(last_gae_lam);
+                const float* next_values = i == size - 1 ? host_last_values.data_ptr<float>() : values_ptr + (i + 1) * num_envs_;
+                const float* next_dones = i == size - 1 ? host_dones.data_ptr<float>() : episode_starts_ptr + (i + 1) * num_envs_;
+                const float* step_rewards = rewards_ptr + i * num_envs_;
+                const float* step_values = values_ptr + i * num_envs_;
+                float* step_advantages = advantages_ptr + i * num_envs_;
+                for (Int j=0; j<num_envs_; ++j) {
+                    float next_non_terminal = 1.0f - next_dones[j];
+                    float delta = step_rewards[j] + gamma_f * next_values[j] * next_non_terminal - step_values[j];
+                    last_gae_lam_ptr[j] = delta + gamma_lambda * next_non_terminal * last_gae_lam_ptr[j];
+                    step_advantages[j] = last_gae_lam_ptr[j];
+                }
             }
+            if (!in_place)
+                advantages_.slice(0, 0, size).copy_(advantages);
             returns_ = advantages_ + values_;
         }
 
@@ -419,8 +1673,58 @@ namespace rlop {
         const std::vector<Int>& action_buffer_sizes() const {
             return action_buffer_sizes_;
         }
+
+        bool staged() const {
+            return staged_;
+        }
+
+        // Sets whether Get() returns views of the rollouts permuted into staging tensors once per epoch, at the cost
+        // of a second copy of the rollouts, or gathers each batch, which is the default. It applies from the next
+        // Reset().
+        void set_staged(bool staged) {
+            staged_ = staged;
+        }
         
     protected:
+        // Returns the order of the rollouts of an epoch, as indices of the rollouts flattened over the steps and the
+        // environments, or over the environments and the steps if `env_major`. With groups of environments, each
+        // group is permuted apart, and the groups are interleaved by `batch_size / num_groups` rollouts, so that each
+        // batch holds as many rollouts of each group, group after group.
+        torch::Tensor EpochPermutation(Int batch_size, bool env_major) const {
+            Int size = Size();
+            if (num_groups_ == 1)
+                return torch::randperm(size * num_envs_);
+            CheckGroupedBatchSize(batch_size);
+            Int group_size = num_envs_ / num_groups_;
+            torch::Tensor local = torch::argsort(torch::rand({ num_groups_, size * group_size }), 1);
+            torch::Tensor steps = local.div(group_size, "floor");
+            torch::Tensor envs = local.remainder(group_size) + torch::arange(num_groups_, torch::kInt64).unsqueeze(1) * group_size;
+            torch::Tensor indices = env_major ? envs * size + steps : steps * num_envs_ + envs;
+            std::vector<torch::Tensor> batches;
+            for (const auto& batch : indices.split(batch_size / num_groups_, 1)) {
+                batches.push_back(batch.flatten());
+            }
+            return torch::cat(batches);
+        }
+
+        // Permutes the rollouts, flattened over the steps and the environments, into the staging tensors, which
+        // keep their storage from an epoch to the next.
+        void Stage(Int batch_size) {
+            Int size = Size();
+            indices_ = EpochPermutation(batch_size, false).to(device_);
+            auto stage = [&](const torch::Tensor& tensor, torch::Tensor* staged) {
+                if (!staged->defined())
+                    *staged = torch::empty({0}, tensor.options());
+                torch::index_select_out(*staged, tensor.slice(0, 0, size).flatten(0, 1), 0, indices_);
+            };
+            stage(observations_, &staged_observations_);
+            stage(actions_, &staged_actions_);
+            stage(values_, &staged_values_);
+            stage(log_probs_, &staged_log_probs_);
+            stage(advantages_, &staged_advantages_);
+            stage(returns_, &staged_returns_);
+        }
+
         Int start_i_ = 0;
         bool generator_ready_ = false;
         torch::Tensor observations_;
@@ -434,5 +1738,12 @@ namespace rlop {
         torch::Tensor indices_;
         std::vector<Int> observation_buffer_sizes_;
         std::vector<Int> action_buffer_sizes_;
+        bool staged_ = false;
+        torch::Tensor staged_observations_;
+        torch::Tensor staged_actions_;
+        torch::Tensor staged_values_;
+        torch::Tensor staged_log_probs_;
+        torch::Tensor staged_advantages_;
+        torch::Tensor staged_returns_;
     };
 }
\ No newline at end of file
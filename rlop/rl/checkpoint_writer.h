@@ -0,0 +1,71 @@
+#pragma once
+#include <filesystem>
+#include <sstream>
+#include <thread>
+#include "rlop/common/torch_utils.h"
+
+namespace rlop {
+    // Writes checkpoints to files on a background thread, so that the training does not wait for the disk. An
+    // archive is serialized into memory on the calling thread, which snapshots its tensors, as the training goes on
+    // updating them in place, and the bytes are written on the background thread to a temporary file renamed over the
+    // path, so that the path always holds a complete checkpoint. One write is pending at a time: a write waits for the
+    // previous one.
+    class CheckpointWriter {
+    public:
+        CheckpointWriter() = default;
+
+        DISALLOW_COPY_AND_ASSIGN(CheckpointWriter);
+
+        virtual ~CheckpointWriter() {
+            if (thread_.joinable())
+                thread_.join();
+        }
+
+        // Serializes an archive and writes it to `path` in the background.
+        void Write(torch::serialize::OutputArchive* archive, const std::string& path) {
+            auto data = std::make_shared<std::ostringstream>(std::ios::binary);
+            archive->save_to(*data);
+            Wait();
+            thread_ = std::thread([this, data, path]() {
+                try {
+                    WriteFile(data->str(), path);
+                }
+                catch (...) {
+                    error_ = std::current_exception();
+                }
+            });
+        }
+
+        // Waits for the pending write, and rethrows its error.
+        void Wait() {
+            if (thread_.joinable())
+                thread_.join();
+            if (error_ != nullptr) {
+                std::exception_ptr error = error_;
+                error_ = nullptr;
+                std::rethrow_exception(error);
+            }
+        }
+
+        bool pending() const {
+            return thread_.joinable();
+        }
+
+        // Writes bytes to a file atomically, through a temporary file next to it renamed over it.
+        static void WriteFile(const std::string& data, const std::string& path) {
+            std::string temp_path = path + ".tmp";
+            {
+                std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+                out.write(data.data(), data.size());
+                out.flush();
+                if (!out)
+                    throw std::runtime_error("CheckpointWriter: failed to write " + temp_path + ".");
+            }
+            std::filesystem::rename(temp_path, path);
+        }
+
+    protected:
+        std::thread thread_;
+        std::exception_ptr error_ = nullptr; // The error of the last write, read after the thread is joined.
+    };
+}
\ No newline at end of file
@@ -0,0 +1,106 @@
+#pragma once
+#include <functional>
+#include "rlop/common/torch_utils.h"
+
+// The graphs, streams and events of CUDA, where libtorch is built with CUDA and its headers are found.
+#if __has_include(<ATen/cuda/CUDAGraph.h>) && __has_include(<cuda_runtime_api.h>)
+#include <ATen/cuda/CUDAEvent.h>
+#include <ATen/cuda/CUDAGraph.h>
+#include <c10/cuda/CUDAGuard.h>
+#include <c10/cuda/CUDAStream.h>
+#define RLOP_CUDA_GRAPH
+#endif
+
+namespace rlop {
+    // Captures the kernels launched by a function into a CUDA graph and replays them at the next calls, which
+    // launches the whole function at once, where small networks are otherwise bound by the launches of their many
+    // small kernels. The first `num_warmup_calls` calls run eagerly, so that the lazy initializations, such as those of
+    // the gradients and of the libraries of CUDA, are done before the capture.
+    //
+    // A replay only runs the kernels of the capture: the function must read its inputs from static tensors, which the
+    // caller copies the inputs into before each call, and assign its outputs to tensors outliving the calls, which
+    // the replays overwrite in place, and it must not wait for the device nor branch on values of the device. The
+    // parameters are read from their addresses at the capture, so that they may be updated in place, as by the
+    // optimizers, but a graph must be discarded when they are reallocated. On the CPU, the function runs eagerly.
+    class CudaGraph {
+    public:
+        CudaGraph(const torch::Device& device, Int num_warmup_calls = 3) :
+            device_(device),
+            num_warmup_calls_(num_warmup_calls)
+        {}
+
+        DISALLOW_COPY_AND_ASSIGN(CudaGraph);
+
+        virtual ~CudaGraph() = default;
+
+        void Run(const std::function<void()>& function) {
+#ifdef RLOP_CUDA_GRAPH
+            if (device_.is_cuda()) {
+                if (graph_ != nullptr) {
+                    graph_->replay();
+                    ++num_calls_;
+                    return;
+                }
+                c10::cuda::CUDAGuard device_guard(device_);
+                c10::cuda::CUDAStream stream = c10::cuda::getCurrentCUDAStream(device_.index());
+                if (!side_stream_.has_value())
+                    side_stream_ = c10::cuda::getStreamFromPool(false, device_.index());
+                // The capture cannot run on the default stream, so the warmup calls and the capture run on a side
+                // stream, after the work of the current stream and before its next.
+                at::cuda::CUDAEvent inputs_ready;
+                inputs_ready.record(stream);
+                inputs_ready.block(*side_stream_);
+                {
+                    c10::cuda::CUDAStreamGuard stream_guard(*side_stream_);
+                    if (num_calls_ < num_warmup_calls_)
+                        function();
+                    else {
+                        graph_ = std::make_unique<at::cuda::CUDAGraph>();
+                        // The other threads, such as the prefetching of the batches, keep using the device during
+                        // the capture.
+                        graph_->capture_begin({ 0, 0 }, cudaStreamCaptureModeThreadLocal);
+                        function();
+                        graph_->capture_end();
+                    }
+                }
+                at::cuda::CUDAEvent outputs_ready;
+                outputs_ready.record(*side_stream_);
+                outputs_ready.block(stream);
+                // The capture only records the kernels, which the first replay runs.
+                if (graph_ != nullptr)
+                    graph_->replay();
+                ++num_calls_;
+                return;
+            }
+#endif
+            function();
+            ++num_calls_;
+        }
+
+        // Returns whether the calls are replayed from a capture.
+        bool captured() const {
+#ifdef RLOP_CUDA_GRAPH
+            return graph_ != nullptr;
+#else
+            return false;
+#endif
+        }
+
+        Int num_calls() const {
+            return num_calls_;
+        }
+
+        Int num_warmup_calls() const {
+            return num_warmup_calls_;
+        }
+
+    protected:
+        torch::Device device_;
+        Int num_warmup_calls_;
+        Int num_calls_ = 0;
+#ifdef RLOP_CUDA_GRAPH
+        std::unique_ptr<at::cuda::CUDAGraph> graph_ = nullptr;
+        std::optional<c10::cuda::CUDAStream> side_stream_;
+#endif
+    };
+}
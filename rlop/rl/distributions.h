@@ -11,6 +11,18 @@ namespace rlop {
         virtual torch::Tensor LogProb(const torch::Tensor& x) const = 0;
 
         virtual torch::Tensor Entropy() const = 0;
+
+        // Returns the log probabilities of `x` and the entropy, sharing the tensors the two compute in common, as in
+        // the evaluation of the actions of a minibatch.
+        virtual std::array<torch::Tensor, 2> LogProbAndEntropy(const torch::Tensor& x) const {
+            return { LogProb(x), Entropy() };
+        }
+
+        // Returns a sample and its log probabilities, sharing the noise of the sample with the log probabilities.
+        virtual std::array<torch::Tensor, 2> SampleAndLogProb() const {
+            torch::Tensor x = Sample();
+            return { x, LogProb(x) };
+        }
     };
 
     // Continuous actions are usually considered to be independent, so we can sum components of the `log_prob` or the entropy.
@@ -37,11 +49,12 @@ namespace rlop {
 
     class DiagGaussian : public RLDistribution {
     public:
-        DiagGaussian(const torch::Tensor& mean, const torch::Tensor& std) : mean_(mean), std_(std) {}
+        // The logarithm of the standard deviation, which the policies usually predict, spares its computation if given.
+        DiagGaussian(const torch::Tensor& mean, const torch::Tensor& std, const torch::Tensor& log_std = torch::Tensor()) :
+            mean_(mean), std_(std), log_std_(log_std.defined() ? log_std : std.log()) {}
 
         virtual torch::Tensor Sample() const override {
-            torch::Tensor eps = torch::empty(mean_.sizes()).normal_().to(mean_.device());
-            return eps * std_ + mean_;
+            return SampleNoise() * std_ + mean_;
         }
 
         virtual torch::Tensor Mode() const override {
@@ -49,26 +62,47 @@ namespace rlop {
         }
 
         virtual torch::Tensor LogProb(const torch::Tensor& x) const override {
-            torch::Tensor log_prob = -(x - mean_).square() / (2.0 * std_.square()) - std_.log() - std::log(std::sqrt(2.0 * M_PI));
-            return SumIndependentDims(log_prob);
+            return NoiseLogProb((x - mean_) / std_);
         }
 
         virtual torch::Tensor Entropy() const override {
-            auto entropy = 0.5 + 0.5 * std::log(2 * M_PI) + std_.log();
-            return SumIndependentDims(entropy);
+            return SumIndependentDims(log_std_ + kEntropyConstant);
+        }
+
+        virtual std::array<torch::Tensor, 2> SampleAndLogProb() const override {
+            torch::Tensor eps = SampleNoise();
+            return { eps * std_ + mean_, NoiseLogProb(eps) };
         }
 
     protected:
+        static constexpr double kLogSqrt2Pi = 0.91893853320467274178; // log(sqrt(2 * pi))
+        static constexpr double kEntropyConstant = 0.5 + kLogSqrt2Pi;
+
+        torch::Tensor SampleNoise() const {
+            return torch::randn(mean_.sizes(), mean_.options());
+        }
+
+        // The log probabilities of the standardized deviations `eps` = (x - mean) / std.
+        torch::Tensor NoiseLogProb(const torch::Tensor& eps) const {
+            return SumIndependentDims(-0.5 * eps.square() - log_std_ - kLogSqrt2Pi);
+        }
+
         torch::Tensor mean_;
         torch::Tensor std_;
+        torch::Tensor log_std_;
     };
 
+    // A diagonal Gaussian squashed by tanh. Its last sample keeps the Gaussian sample it was squashed from, so that
+    // the log probabilities of the sample skip the inversion by atanh.
     class SquashedDiagGaussian : public DiagGaussian {
     public:
-        SquashedDiagGaussian(const torch::Tensor& mean, const torch::Tensor& std, double eps = 1e-6) : DiagGaussian(mean, std), eps_(eps) {}
+        SquashedDiagGaussian(const torch::Tensor& mean, const torch::Tensor& std, double eps = 1e-6, const torch::Tensor& log_std = torch::Tensor()) :
+            DiagGaussian(mean, std, log_std), eps_(eps) {}
         
         virtual torch::Tensor Sample() const override {
-            return torch::tanh(DiagGaussian::Sample());
+            gaussian_sample_ = DiagGaussian::Sample();
+            sample_ = torch::tanh(gaussian_sample_);
+            return sample_;
         }
 
         virtual torch::Tensor Mode() const override {
@@ -76,24 +110,44 @@ namespace rlop {
         }
 
         virtual torch::Tensor LogProb(const torch::Tensor& x) const override {
-            return torch::Tensor();
+            if (sample_.defined() && x.is_same(sample_))
+                return LogProb(x, gaussian_sample_);
+            torch::Tensor clamped_x = torch::clamp(x, -1.0 + eps_, 1.0 - eps_);
+            return LogProb(x, torch::atanh(clamped_x));
         }
 
         virtual torch::Tensor LogProb(const torch::Tensor& x, const torch::Tensor& gaussian_x) const {
-            return DiagGaussian::LogProb(gaussian_x) - SumIndependentDims(torch::log(1.0 - x.square() + eps_));
+            return DiagGaussian::LogProb(gaussian_x) - SquashCorrection(x);
         }
 
+        // The entropy has no closed form, and is estimated by the negated log probabilities of the samples.
         virtual torch::Tensor Entropy() const override {
             return torch::Tensor();
         }
 
+        virtual std::array<torch::Tensor, 2> SampleAndLogProb() const override {
+            auto [ gaussian_x, gaussian_log_prob ] = DiagGaussian::SampleAndLogProb();
+            gaussian_sample_ = gaussian_x;
+            sample_ = torch::tanh(gaussian_x);
+            return { sample_, gaussian_log_prob - SquashCorrection(sample_) };
+        }
+
     protected:
+        // The log determinant of the Jacobian of tanh at the squashed `x`.
+        torch::Tensor SquashCorrection(const torch::Tensor& x) const {
+            return SumIndependentDims(torch::log(1.0 - x.square() + eps_));
+        }
+
         double eps_;
+        mutable torch::Tensor sample_; // The last sample.
+        mutable torch::Tensor gaussian_sample_; // The Gaussian sample the last sample was squashed from.
     };
 
     class Categorical : public RLDistribution {
     public:
-        Categorical(const torch::Tensor& logits) : logits_(logits - logits.logsumexp(-1, true)), probs_(LogitsToProbs(logits_)) {}
+        // The logits are normalized once into log probabilities, whose exponentials are the probabilities, and which
+        // both LogProb() and Entropy() read.
+        Categorical(const torch::Tensor& logits) : logits_(torch::log_softmax(logits, -1)), probs_(logits_.exp()) {}
 
         virtual torch::Tensor Sample() const override {
             return torch::multinomial(probs_, 1).flatten();
@@ -105,6 +159,9 @@ namespace rlop {
 
         virtual torch::Tensor LogProb(const torch::Tensor& x) const override {
             torch::Tensor value = x.to(torch::kInt64).unsqueeze(-1);
+            // The actions of a batch index the rows of the logits directly, without broadcasting.
+            if (value.dim() == logits_.dim() && value.sizes().slice(0, value.dim() - 1) == logits_.sizes().slice(0, logits_.dim() - 1))
+                return logits_.gather(-1, value).squeeze(-1);
             auto broadcasted = torch::broadcast_tensors({value, logits_});
             value = broadcasted[0].index({"...", torch::indexing::Slice(0, 1)});
             return broadcasted[1].gather(-1, value).squeeze(-1);
@@ -116,8 +173,8 @@ namespace rlop {
                 min_real = std::numeric_limits<float>::lowest();
             else if (logits_.scalar_type() == c10::ScalarType::Double)
                 min_real = std::numeric_limits<double>::lowest();
-            torch::Tensor logits = torch::clamp(logits_, min_real);
-            torch::Tensor p_log_p = logits * probs_;
+            // The masked actions of -inf logits would make nan products with their zero probabilities.
+            torch::Tensor p_log_p = torch::clamp(logits_, min_real) * probs_;
             return -p_log_p.sum(-1);
         }
 
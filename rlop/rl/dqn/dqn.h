@@ -39,10 +39,7 @@ namespace rlop {
         virtual void Reset() override {
             OffPolicyRL::Reset();
             optimizer_ = MakeOptimizer();
-            parameters_ = torch_utils::GetParameters(*policy()->q_net()).second;
-            target_parameters_ = torch_utils::GetParameters(*policy()->q_net_target()).second;
-            buffers_ = torch_utils::GetBuffersByName(*policy()->q_net(), { "running_" });
-            target_buffers_ = torch_utils::GetBuffersByName(*policy()->q_net_target(), { "running_" });
+            FlattenParameters();
             num_calls_ = 0;
         }
 
@@ -63,67 +60,91 @@ namespace rlop {
             if (!deterministic && torch::rand({1}, torch::kFloat64).item<double>() < eps_)
                 return { SampleActions(), torch::Tensor() };
             else   
-                return policy_->Predict(observation, deterministic, state, episode_start);
+                return OffPolicyRL::Predict(observation, deterministic, state, episode_start);
         }
 
         virtual void Train() override {
+            RLOP_PROFILE_SCOPE("DQN::Train");
             if (time_steps_ <= learning_starts_)
                 return;
             policy_->SetTrainingMode(true);
-            std::vector<double> q_value_list;
-            std::vector<double> loss_list;
-            std::vector<double> reward_list;
-            q_value_list.reserve(gradient_steps_);
-            loss_list.reserve(gradient_steps_);
-            reward_list.reserve(gradient_steps_);
+            metrics_.Reset();
+            StartSampling(gradient_steps_, batch_size_);
             for (Int step=0; step<gradient_steps_; ++step) {
-                auto batch = replay_buffer_->Sample(batch_size_).To(device_);
-                torch::Tensor target_q_value;
-                {
-                    torch::NoGradGuard no_grad;
-                    torch::Tensor next_q_values = policy()->q_net_target()->PredictQValues(batch.next_observations);
-                    torch::Tensor max_next_q_value = std::get<0>(torch::max(next_q_values, 1));
-                    target_q_value = batch.rewards + (1.0 - batch.dones) * gamma_ * max_next_q_value;
-                }
-                torch::Tensor q_values = policy()->q_net()->PredictQValues(batch.observations);
-                torch::Tensor q_value = torch::gather(q_values, 1, batch.actions.reshape({-1, 1})).flatten();
-                torch::Tensor loss = torch::smooth_l1_loss(q_value, target_q_value);
-                optimizer_->zero_grad();
-                loss.backward();
+                auto batch = NextBatch();
+                RunCudaGraph(&train_graph_, [&]() { train_outputs_ = ComputeGradients(batch); });
+                auto [ q_values, loss, td_errors ] = train_outputs_;
+                if (batch.weights.defined())
+                    UpdatePriorities(batch.indices, td_errors);
+                grad_scaler_.Unscale(optimizer_.get());
                 torch::nn::utils::clip_grad_norm_(policy()->q_net()->parameters(), max_grad_norm_);
-                optimizer_->step();
+                grad_scaler_.Step(optimizer_.get());
+                grad_scaler_.Update();
                 ++num_updates_;
-                q_value_list.push_back(q_values.mean().item<double>());
-                loss_list.push_back(loss.item<double>());
-                reward_list.push_back(batch.rewards.mean().item<double>());
+                telemetry_.AddGradientSteps(1);
+                metrics_.Add("q_value", q_values);
+                metrics_.Add("loss", loss);
+                metrics_.Add("reward", batch.rewards);
             }
             if (!log_items_.empty()) {
                 auto it = log_items_.find("num_updates");
                 if (it != log_items_.end())
                 it->second = torch::tensor(num_updates_);
-                it = log_items_.find("q_value");
-                if (it != log_items_.end()) 
-                    it->second  = torch::tensor(q_value_list).mean();
-                it = log_items_.find("loss");
-                if (it != log_items_.end()) 
-                    it->second = torch::tensor(loss_list).mean();
-                it = log_items_.find("reward");
-                if (it != log_items_.end()) 
-                    it->second = torch::tensor(reward_list).mean();
+                metrics_.WriteTo(&log_items_, { "q_value", "loss", "reward" });
                 it = log_items_.find("eps");
                 if (it != log_items_.end()) 
                     it->second = torch::tensor(eps_);
             }
         }
 
+        // Computes the loss of a batch and its gradients, and returns the Q-values of the batch, the loss and, for a
+        // prioritized buffer, the TD errors.
+        virtual std::array<torch::Tensor, 3> ComputeGradients(const ReplayBuffer::Batch& batch) {
+            AutocastGuard autocast = Autocast();
+            torch::Tensor target_q_value;
+            {
+                torch::NoGradGuard no_grad;
+                torch::Tensor next_q_values = policy()->q_net_target()->PredictQValues(batch.next_observations);
+                torch::Tensor max_next_q_value = std::get<0>(torch::max(next_q_values, 1));
+                target_q_value = batch.rewards + (1.0 - batch.dones) * gamma_ * max_next_q_value;
+            }
+            torch::Tensor q_values = policy()->q_net()->PredictQValues(batch.observations);
+            torch::Tensor q_value = torch::gather(q_values, 1, batch.actions.reshape({-1, 1})).flatten();
+            torch::Tensor loss;
+            torch::Tensor td_errors;
+            if (batch.weights.defined()) {
+                loss = (batch.weights * torch::smooth_l1_loss(q_value, target_q_value, torch::Reduction::None)).mean();
+                td_errors = q_value.detach() - target_q_value;
+            }
+            else
+                loss = torch::smooth_l1_loss(q_value, target_q_value);
+            autocast.Exit();
+            optimizer_->zero_grad();
+            grad_scaler_.Scale(loss).backward();
+            return { q_values, loss, td_errors };
+        }
+
+        virtual void ResetCudaGraphs() override {
+            OffPolicyRL::ResetCudaGraphs();
+            train_graph_ = nullptr;
+        }
+
         virtual void OnCollectRolloutStep() override {
             ++num_calls_;
             if (num_calls_ % std::max(target_update_interval_ / replay_buffer_->num_envs(), Int(1)) == 0) {
-                torch_utils::PolyakUpdate(parameters_, target_parameters_, tau_);
+                torch_utils::PolyakUpdate(parameters_, &target_parameters_, tau_);
                 torch_utils::PolyakUpdate(buffers_, target_buffers_, 1.0);
             }
         }
 
+        // Gathers the parameters and the buffers updating the target network, the parameters flattened if set.
+        void FlattenParameters() {
+            parameters_ = torch_utils::FlatParameters(torch_utils::GetParameters(*policy()->q_net()).second, flat_parameters_);
+            target_parameters_ = torch_utils::FlatParameters(torch_utils::GetParameters(*policy()->q_net_target()).second, flat_parameters_);
+            buffers_ = torch_utils::GetBuffersByName(*policy()->q_net(), { "running_" });
+            target_buffers_ = torch_utils::GetBuffersByName(*policy()->q_net_target(), { "running_" });
+        }
+
         virtual void LoadArchive(torch::serialize::InputArchive* archive, const std::unordered_set<std::string>& names) override {
             if (names.count("all") || names.count("q_net")) {
                 torch::serialize::InputArchive q_net_archive;
@@ -135,6 +156,9 @@ namespace rlop {
                 if (archive->try_read("target_net", target_q_net_archive))
                     policy()->q_net_target()->load(target_q_net_archive);
             }
+            // A load replaces the storages of the parameters, which are flattened again.
+            if (flat_parameters_ && !(parameters_.valid() && target_parameters_.valid()))
+                FlattenParameters();
             if (names.count("all") || names.count("optimizer")) {
                 torch::serialize::InputArchive optimizer_archive;
                 if (archive->try_read("optimizer", optimizer_archive))
@@ -223,9 +247,11 @@ namespace rlop {
         Int target_update_interval_;
         Int num_calls_;
         std::shared_ptr<torch::optim::Optimizer> optimizer_ = nullptr;
-        std::vector<torch::Tensor> parameters_;
-        std::vector<torch::Tensor> target_parameters_;
+        torch_utils::FlatParameters parameters_;
+        torch_utils::FlatParameters target_parameters_;
         std::vector<torch::Tensor> buffers_;
         std::vector<torch::Tensor> target_buffers_;
+        std::unique_ptr<CudaGraph> train_graph_ = nullptr; // The capture of ComputeGradients().
+        std::array<torch::Tensor, 3> train_outputs_;
     };
 }
\ No newline at end of file
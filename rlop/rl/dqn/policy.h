@@ -49,6 +49,7 @@ namespace rlop {
         }
 
         virtual void Reset() override {
+            ResetCudaGraphs();
             q_net_= MakeQNet();
             q_net_->to(device_);
             q_net_target_ = MakeQNet();
@@ -57,6 +58,15 @@ namespace rlop {
             torch_utils::CopyStateDict(*q_net_, q_net_target_.get());
         }
 
+        // Copies the Q-networks, which are not submodules of the policy.
+        virtual void CopyWeights(const RLPolicy& source) override {
+            const auto* dqn_policy = dynamic_cast<const DQNPolicy*>(&source);
+            if (dqn_policy == nullptr)
+                throw std::runtime_error("DQNPolicy: copies the weights of another type of policy.");
+            torch_utils::CopyStateDict(*dqn_policy->q_net_, q_net_.get());
+            torch_utils::CopyStateDict(*dqn_policy->q_net_target_, q_net_target_.get());
+        }
+
         virtual void SetTrainingMode(bool mode) override {
             if (mode)
                 q_net_->train();
@@ -0,0 +1,122 @@
+#pragma once
+#include "rlop/common/torch_utils.h"
+
+namespace rlop {
+    // A stack of `ensemble_size` independent linear layers evaluated in one batched matrix product, in place of
+    // `ensemble_size` forwards of small layers, which are bound by the launches of their kernels. The inputs are of
+    // shape {ensemble_size, n, in_features}, the i-th slice going through the i-th layer, and the outputs of shape
+    // {ensemble_size, n, out_features}. Each layer is initialized as a torch::nn::Linear.
+    class EnsembleLinear : public torch::nn::Module {
+    public:
+        EnsembleLinear(Int ensemble_size, Int in_features, Int out_features) :
+            ensemble_size_(ensemble_size),
+            in_features_(in_features),
+            out_features_(out_features)
+        {
+            double bound = 1.0 / std::sqrt((double)in_features);
+            weight_ = register_parameter("weight", torch::empty({ ensemble_size, in_features, out_features }).uniform_(-bound, bound));
+            bias_ = register_parameter("bias", torch::empty({ ensemble_size, 1, out_features }).uniform_(-bound, bound));
+        }
+
+        virtual ~EnsembleLinear() = default;
+
+        torch::Tensor forward(const torch::Tensor& input) {
+            return torch::baddbmm(bias_, input, weight_);
+        }
+
+        Int ensemble_size() const {
+            return ensemble_size_;
+        }
+
+        Int in_features() const {
+            return in_features_;
+        }
+
+        Int out_features() const {
+            return out_features_;
+        }
+
+    protected:
+        Int ensemble_size_;
+        Int in_features_;
+        Int out_features_;
+        torch::Tensor weight_;
+        torch::Tensor bias_;
+    };
+
+    // A stack of `ensemble_size` independent multilayer perceptrons, of EnsembleLinear layers separated by an
+    // activation, such as the networks of the seeds trained together in one process. The inputs are the rows of the
+    // members one member after the other, of shape {ensemble_size * n, in_features}, and the outputs of shape
+    // {ensemble_size * n, out_features} in the same order.
+    class EnsembleMLP : public torch::nn::Module {
+    public:
+        // Parameters:
+        //   ensemble_size: The number of members.
+        //   sizes: The sizes of the input, of the hidden layers and of the output.
+        //   activation: The activation between two layers, tanh by default.
+        EnsembleMLP(Int ensemble_size, const std::vector<Int>& sizes, std::function<torch::Tensor(const torch::Tensor&)> activation = nullptr) :
+            ensemble_size_(ensemble_size),
+            activation_(activation ? std::move(activation) : [](const torch::Tensor& x) { return torch::tanh(x); })
+        {
+            if (sizes.size() < 2)
+                throw std::runtime_error("EnsembleMLP: requires the sizes of the input and of the output.");
+            for (Int i=0; i+1<sizes.size(); ++i) {
+                layers_.push_back(register_module("layer_" + std::to_string(i), std::make_shared<EnsembleLinear>(ensemble_size, sizes[i], sizes[i + 1])));
+            }
+        }
+
+        virtual ~EnsembleMLP() = default;
+
+        torch::Tensor forward(const torch::Tensor& input) {
+            torch::Tensor x = input.reshape({ ensemble_size_, -1, input.size(-1) });
+            for (Int i=0; i<layers_.size(); ++i) {
+                x = layers_[i]->forward(x);
+                if (i + 1 < layers_.size())
+                    x = activation_(x);
+            }
+            return x.reshape({ -1, x.size(-1) });
+        }
+
+        Int ensemble_size() const {
+            return ensemble_size_;
+        }
+
+        const std::vector<std::shared_ptr<EnsembleLinear>>& layers() const {
+            return layers_;
+        }
+
+    protected:
+        Int ensemble_size_;
+        std::function<torch::Tensor(const torch::Tensor&)> activation_;
+        std::vector<std::shared_ptr<EnsembleLinear>> layers_;
+    };
+
+    // Clips the gradients of the members of an ensemble by the norms of their own gradients, as each member would
+    // be clipped alone, where the parameters are stacked with a leading dimension of `ensemble_size`. Returns the
+    // norms of the members before the clipping.
+    inline torch::Tensor ClipGradNormPerMember(const std::vector<torch::Tensor>& parameters, Int ensemble_size, double max_norm) {
+        std::vector<torch::Tensor> grads;
+        for (const auto& parameter : parameters) {
+            if (!parameter.grad().defined())
+                continue;
+            if (parameter.dim() == 0 || parameter.size(0) != ensemble_size)
+                throw std::runtime_error("ClipGradNormPerMember: a parameter is not stacked over the members of the ensemble.");
+            grads.push_back(parameter.grad());
+        }
+        if (grads.empty())
+            return torch::zeros({ ensemble_size });
+        torch::NoGradGuard no_grad;
+        torch::Tensor squared_norms = torch::zeros({ ensemble_size }, grads[0].options().dtype(torch::kFloat32));
+        for (const auto& grad : grads) {
+            squared_norms += grad.reshape({ ensemble_size, -1 }).to(torch::kFloat32).square().sum(1);
+        }
+        torch::Tensor norms = squared_norms.sqrt();
+        torch::Tensor coefs = (max_norm / (norms + 1e-6)).clamp_max(1.0);
+        for (auto& grad : grads) {
+            std::vector<Int> sizes(grad.dim(), 1);
+            sizes[0] = ensemble_size;
+            grad.mul_(coefs.to(grad.scalar_type()).view(sizes));
+        }
+        return norms;
+    }
+}
\ No newline at end of file
@@ -1,6 +1,10 @@
 #pragma once
+#include <atomic>
+#include <exception>
+#include <thread>
 #include "rlop/common/utils.h"
 #include "rlop/common/torch_utils.h"
+#include "rl.h"
 
 namespace rlop {
     // RLEvaluator is a classs to assess the performance of a RL model by executing it in
@@ -43,14 +47,17 @@ namespace rlop {
                     break;
                 auto [action, next_state] = rl->Predict(observation, deterministic, state, episode_start);
                 auto [next_observation, reward, terminated, truncated, terminal_observation] = rl->Step(action);
-                torch::Tensor done = torch::logical_or(terminated, truncated);
-                current_rewards += reward;
+                // The dones and rewards of all the environments are brought to the host at once.
+                torch::Tensor done = torch::logical_or(terminated, truncated).to(torch::kCPU).contiguous();
+                current_rewards += reward.to(torch::kCPU, torch::kFloat64);
                 std::for_each(current_lengths.begin(), current_lengths.end(), [](Int& item) { item += 1; });
+                auto done_a = done.accessor<bool, 1>();
+                auto current_rewards_a = current_rewards.accessor<double, 1>();
                 for (Int i = 0; i < num_envs; ++i) {
-                    if (episode_counts[i] < episode_count_targets[i] && done[i].item<bool>()) {
-                        episode_rewards_.push_back(current_rewards[i].item<double>());
+                    if (episode_counts[i] < episode_count_targets[i] && done_a[i]) {
+                        episode_rewards_.push_back(current_rewards_a[i]);
                         episode_lengths_.push_back(current_lengths[i]);
-                        current_rewards[i] = 0;
+                        current_rewards_a[i] = 0;
                         current_lengths[i] = 0;
                         episode_counts[i] += 1;
                     }
@@ -74,4 +81,142 @@ namespace rlop {
         std::vector<double> episode_rewards_;
         std::vector<Int> episode_lengths_;
     };
+
+    // Evaluates snapshots of the policy of an algorithm on a background thread while it keeps training, as a
+    // callback of its Learn(). The evaluation runs on `eval_rl`, an algorithm of the class of the trained one after
+    // its Reset(), whose environments are those of the evaluation and whose policy receives the snapshots, so that
+    // neither the training nor the state of its environments waits for it.
+    //
+    // Every `eval_interval` time steps, once the previous evaluation finished, the parameters of the trained policy
+    // are copied into the policy of `eval_rl` on the training thread, and an evaluation of `num_eval_episodes`
+    // episodes starts. The results of the last finished evaluation are written to the log items "eval_mean_reward",
+    // "eval_std_reward" and "eval_time_steps", the time steps of its snapshot, NaN and -1 before the first one. The
+    // environments of `eval_rl` are stepped on the background thread, so that Python environments must take the GIL.
+    class BackgroundEvaluator : public LearnCallback {
+    public:
+        // Parameters:
+        //   eval_rl: The algorithm running the evaluations.
+        //   num_eval_episodes: The number of episodes of an evaluation.
+        //   eval_interval: The number of time steps between the starts of two evaluations.
+        //   deterministic: Whether the evaluations take the deterministic actions.
+        BackgroundEvaluator(const std::shared_ptr<RL>& eval_rl, Int num_eval_episodes, Int eval_interval, bool deterministic = true) :
+            eval_rl_(eval_rl),
+            num_eval_episodes_(num_eval_episodes),
+            eval_interval_(eval_interval),
+            deterministic_(deterministic)
+        {}
+
+        DISALLOW_COPY_AND_ASSIGN(BackgroundEvaluator);
+
+        virtual ~BackgroundEvaluator() {
+            if (thread_.joinable())
+                thread_.join();
+        }
+
+        virtual void RegisterLogItems(std::unordered_map<std::string, torch::Tensor>* log_items) override {
+            WriteTo(log_items);
+        }
+
+        // Writes the results of a finished evaluation, and starts the next one when it is due.
+        virtual void OnLearnStep(RL* rl, std::unordered_map<std::string, torch::Tensor>* log_items) override {
+            if (running_) {
+                if (!done_)
+                    return;
+                Join();
+                WriteTo(log_items);
+            }
+            if (last_time_steps_ >= 0 && rl->time_steps() - last_time_steps_ < eval_interval_)
+                return;
+            Start(rl);
+        }
+
+        // Waits for the running evaluation, and writes its results.
+        virtual void OnLearnEnd(RL* rl, std::unordered_map<std::string, torch::Tensor>* log_items) override {
+            if (!running_)
+                return;
+            Join();
+            WriteTo(log_items);
+        }
+
+        // Returns the mean and the standard deviation of the rewards of the episodes of the last finished evaluation.
+        std::array<double, 2> results() const {
+            return { mean_reward_, std_reward_ };
+        }
+
+        // Returns the time steps of the snapshot of the last finished evaluation, -1 before the first one.
+        Int eval_time_steps() const {
+            return eval_time_steps_;
+        }
+
+        bool running() const {
+            return running_;
+        }
+
+        const std::shared_ptr<RL>& eval_rl() const {
+            return eval_rl_;
+        }
+
+    protected:
+        // Copies the trained policy into the policy of the evaluation, on the training thread, and starts the
+        // evaluation of the copy.
+        void Start(RL* rl) {
+            std::shared_ptr<RLPolicy> policy = rl->GetPolicy();
+            std::shared_ptr<RLPolicy> eval_policy = eval_rl_->GetPolicy();
+            if (policy == nullptr || eval_policy == nullptr)
+                throw std::runtime_error("BackgroundEvaluator: the algorithms must return their policies with GetPolicy().");
+            torch_utils::CopyStateDict(*policy, eval_policy.get());
+            last_time_steps_ = rl->time_steps();
+            running_ = true;
+            done_ = false;
+            thread_ = std::thread([this, time_steps = last_time_steps_]() {
+                try {
+                    torch::NoGradGuard no_grad;
+                    evaluator_.Reset();
+                    next_results_ = evaluator_.Evaluate(eval_rl_.get(), num_eval_episodes_, deterministic_);
+                    next_time_steps_ = time_steps;
+                }
+                catch (...) {
+                    error_ = std::current_exception();
+                }
+                done_ = true;
+            });
+        }
+
+        // Joins the thread of the evaluation, and takes its results or rethrows its error.
+        void Join() {
+            thread_.join();
+            running_ = false;
+            if (error_ != nullptr) {
+                std::exception_ptr error = error_;
+                error_ = nullptr;
+                std::rethrow_exception(error);
+            }
+            mean_reward_ = next_results_[0];
+            std_reward_ = next_results_[1];
+            eval_time_steps_ = next_time_steps_;
+        }
+
+        void WriteTo(std::unordered_map<std::string, torch::Tensor>* log_items) const {
+            (*log_items)["eval_mean_reward"] = torch::tensor(mean_reward_, torch::kFloat64);
+            (*log_items)["eval_std_reward"] = torch::tensor(std_reward_, torch::kFloat64);
+            (*log_items)["eval_time_steps"] = torch::tensor(eval_time_steps_, torch::kInt64);
+        }
+
+        std::shared_ptr<RL> eval_rl_;
+        Int num_eval_episodes_;
+        Int eval_interval_;
+        bool deterministic_;
+        RLEvaluator evaluator_;
+        std::thread thread_;
+        bool running_ = false;
+        std::atomic<bool> done_ = false;
+        // The results and the error of the thread, read after it is joined.
+        std::array<double, 2> next_results_ = { 0, 0 };
+        Int next_time_steps_ = -1;
+        std::exception_ptr error_ = nullptr;
+        Int last_time_steps_ = -1; // The time steps of the last start.
+        double mean_reward_ = std::numeric_limits<double>::quiet_NaN();
+        double std_reward_ = std::numeric_limits<double>::quiet_NaN();
+        Int eval_time_steps_ = -1;
+    };
 }
\ No newline at end of file
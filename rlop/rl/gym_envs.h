@@ -162,6 +162,34 @@ namespace rlop {
                 py::cast<py::dict>(results[4]),
             };
         }
+
+        // Starts a step with the actions, which StepWait() completes, so that the caller works while the environments
+        // step, in the subprocesses of the "async" vectorization mode. Vector environments without step_async(), as
+        // those of the "sync" mode in recent versions of Gymnasium, step in StepWait().
+        virtual void StepAsync(const py::object& actions) {
+            if (py::hasattr(env_, "step_async"))
+                env_.attr("step_async")(actions);
+            else
+                pending_actions_ = actions;
+        }
+
+        // Waits for the step started by StepAsync(), at most `timeout` seconds if not none, and returns its results
+        // as Step().
+        virtual std::tuple<py::object, py::array, py::array, py::array, py::dict> StepWait(const py::object& timeout = py::none()) {
+            if (pending_actions_.is_none()) {
+                auto results = py::cast<py::tuple>(env_.attr("step_wait")(timeout));
+                return {
+                    results[0],
+                    py::cast<py::array>(results[1]),
+                    py::cast<py::array>(results[2]),
+                    py::cast<py::array>(results[3]),
+                    py::cast<py::dict>(results[4]),
+                };
+            }
+            py::object actions = pending_actions_;
+            pending_actions_ = py::none();
+            return Step(actions);
+        }
         
         virtual void Seed(uint64_t seed) {
             seeds_ = py::list();
@@ -225,5 +253,6 @@ namespace rlop {
         py::object env_;
         Int num_envs_;
         py::list seeds_;
+        py::object pending_actions_ = py::none(); // The actions of a step started without step_async().
     };
 }
\ No newline at end of file
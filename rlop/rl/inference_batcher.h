@@ -0,0 +1,187 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include "policy.h"
+
+namespace rlop {
+    // Serves the forwards of a policy to many threads, such as the threads of a search, the actors of an
+    // asynchronous algorithm or the evaluators, which each want the output of a single observation. The requests are
+    // queued with Submit(), which returns a future, and a background thread coalesces them into one forward of up to
+    // `max_batch_size` observations, launched when the batch is full or the oldest request has waited
+    // `max_latency_us` microseconds, so that the callers share the device in large batches instead of taking turns
+    // at small ones.
+    //
+    // The forward is a function of the policy and the batch of observations, which returns a tensor of one row per
+    // observation, by default the actions of Predict(). The policy is only used by the thread of the batcher while it
+    // is served: it can be swapped with SetPolicy(), or its weights updated with LoadWeights(), between two batches.
+    class InferenceBatcher {
+    public:
+        using Forward = std::function<torch::Tensor(RLPolicy*, const torch::Tensor&)>;
+
+        // Parameters:
+        //   policy: The policy served.
+        //   max_batch_size: The maximum number of observations of a forward.
+        //   max_latency_us: The maximum time a request waits for others to join its batch, in microseconds.
+        //   forward: The forward of a batch, Predict() with deterministic actions if null.
+        InferenceBatcher(
+            const std::shared_ptr<RLPolicy>& policy,
+            Int max_batch_size = 256,
+            Int max_latency_us = 1000,
+            Forward forward = nullptr
+        ) :
+            policy_(policy),
+            max_batch_size_(std::max(max_batch_size, Int(1))),
+            max_latency_(max_latency_us),
+            forward_(forward ? std::move(forward) : Forward([](RLPolicy* policy, const torch::Tensor& observations) {
+                return policy->Predict(observations, true)[0];
+            }))
+        {
+            if (policy_ == nullptr)
+                throw std::runtime_error("InferenceBatcher: requires a policy.");
+            thread_ = std::thread([this]() { Run(); });
+        }
+
+        DISALLOW_COPY_AND_ASSIGN(InferenceBatcher);
+
+        // Serves the queued requests, and stops the thread.
+        virtual ~InferenceBatcher() {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            cv_.notify_all();
+            thread_.join();
+        }
+
+        // Queues an observation, without the batch dimension, and returns the future of its row of the output.
+        std::future<torch::Tensor> Submit(const torch::Tensor& observation) {
+            Request request;
+            request.observation = observation;
+            request.time = std::chrono::steady_clock::now();
+            std::future<torch::Tensor> future = request.promise.get_future();
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (stop_)
+                    throw std::runtime_error("InferenceBatcher: submits to a stopped batcher.");
+                requests_.push_back(std::move(request));
+            }
+            cv_.notify_all();
+            return future;
+        }
+
+        // Queues an observation and waits for its row of the output.
+        torch::Tensor Predict(const torch::Tensor& observation) {
+            return Submit(observation).get();
+        }
+
+        // Replaces the policy served from the next batch on.
+        void SetPolicy(const std::shared_ptr<RLPolicy>& policy) {
+            if (policy == nullptr)
+                throw std::runtime_error("InferenceBatcher: requires a policy.");
+            std::lock_guard<std::mutex> lock(policy_mutex_);
+            policy_ = policy;
+        }
+
+        // Copies the weights of a module of the same structure into the policy served, between two batches.
+        void LoadWeights(const torch::nn::Module& source) {
+            std::lock_guard<std::mutex> lock(policy_mutex_);
+            torch_utils::CopyStateDict(source, policy_.get());
+        }
+
+        // Copies the weights of a policy of the same structure into the policy served, between two batches, with
+        // CopyWeights(), such as into a quantized copy, whose weights are re-quantized at the next batch.
+        void LoadWeights(const RLPolicy& source) {
+            std::lock_guard<std::mutex> lock(policy_mutex_);
+            policy_->CopyWeights(source);
+        }
+
+        Int max_batch_size() const {
+            return max_batch_size_;
+        }
+
+        Int max_latency_us() const {
+            return max_latency_.count();
+        }
+
+        // Returns the number of forwards run.
+        Int num_batches() const {
+            return num_batches_;
+        }
+
+        // Returns the number of requests served, which divided by the number of forwards is the mean batch size.
+        Int num_requests() const {
+            return num_requests_;
+        }
+
+    protected:
+        struct Request {
+            torch::Tensor observation;
+            std::promise<torch::Tensor> promise;
+            std::chrono::steady_clock::time_point time; // The time of the submission.
+        };
+
+        void Run() {
+            std::vector<Request> batch;
+            std::vector<torch::Tensor> observations;
+            while (true) {
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    cv_.wait(lock, [this]() { return stop_ || !requests_.empty(); });
+                    if (requests_.empty())
+                        return;
+                    // Waits for the batch to fill up until the deadline of the oldest request, unless stopping.
+                    auto deadline = requests_.front().time + max_latency_;
+                    cv_.wait_until(lock, deadline, [this]() { return stop_ || requests_.size() >= max_batch_size_; });
+                    Int batch_size = std::min<Int>(requests_.size(), max_batch_size_);
+                    batch.clear();
+                    for (Int i=0; i<batch_size; ++i) {
+                        batch.push_back(std::move(requests_.front()));
+                        requests_.pop_front();
+                    }
+                }
+                observations.clear();
+                for (const auto& request : batch) {
+                    observations.push_back(request.observation);
+                }
+                try {
+                    torch::Tensor outputs;
+                    {
+                        std::lock_guard<std::mutex> lock(policy_mutex_);
+                        torch::NoGradGuard no_grad;
+                        outputs = forward_(policy_.get(), torch::stack(observations));
+                    }
+                    if (outputs.size(0) != batch.size())
+                        throw std::runtime_error("InferenceBatcher: the forward returned " + std::to_string(outputs.size(0)) + " rows for " + std::to_string(batch.size()) + " observations.");
+                    for (Int i=0; i<batch.size(); ++i) {
+                        batch[i].promise.set_value(outputs[i]);
+                    }
+                }
+                catch (...) {
+                    for (auto& request : batch) {
+                        request.promise.set_exception(std::current_exception());
+                    }
+                }
+                ++num_batches_;
+                num_requests_ += batch.size();
+            }
+        }
+
+        std::shared_ptr<RLPolicy> policy_;
+        Int max_batch_size_;
+        std::chrono::microseconds max_latency_;
+        Forward forward_;
+        std::thread thread_;
+        std::mutex mutex_; // The mutex of the requests.
+        std::mutex policy_mutex_; // The mutex of the policy, held during the forwards.
+        std::condition_variable cv_;
+        std::deque<Request> requests_;
+        bool stop_ = false;
+        std::atomic<Int> num_batches_ = 0;
+        std::atomic<Int> num_requests_ = 0;
+    };
+}
\ No newline at end of file
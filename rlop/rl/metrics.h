@@ -0,0 +1,60 @@
+#pragma once
+#include "rlop/common/torch_utils.h"
+
+namespace rlop {
+    // Accumulates the sums of scalar metrics over the steps of a training, such as the losses of the batches, as
+    // tensors on the device of the metrics. Adding a metric launches an addition without waiting for the device, as
+    // .item() would, and the means are written to the log items as tensors, so that the device is waited for only
+    // when the log is printed or saved.
+    class MetricAccumulator {
+    public:
+        MetricAccumulator() = default;
+
+        virtual ~MetricAccumulator() = default;
+
+        void Reset() {
+            sums_.clear();
+        }
+
+        // Adds a value of a metric, the mean of a tensor of several values.
+        void Add(const std::string& name, const torch::Tensor& value) {
+            torch::Tensor mean = value.detach().to(torch::kFloat64).mean();
+            auto it = sums_.find(name);
+            if (it == sums_.end())
+                sums_.emplace(name, std::make_pair(mean, Int(1)));
+            else {
+                it->second.first = it->second.first + mean;
+                ++it->second.second;
+            }
+        }
+
+        void Add(const std::string& name, double value) {
+            Add(name, torch::tensor(value, torch::kFloat64));
+        }
+
+        // Returns the mean of a metric on its device, NaN if it was not added.
+        torch::Tensor Mean(const std::string& name) const {
+            auto it = sums_.find(name);
+            if (it == sums_.end())
+                return torch::tensor(std::numeric_limits<double>::quiet_NaN(), torch::kFloat64);
+            return it->second.first / (double)it->second.second;
+        }
+
+        Int Count(const std::string& name) const {
+            auto it = sums_.find(name);
+            return it == sums_.end() ? 0 : it->second.second;
+        }
+
+        // Sets the log items of the names, among those registered, to the means of the metrics.
+        void WriteTo(std::unordered_map<std::string, torch::Tensor>* log_items, const std::vector<std::string>& names) const {
+            for (const auto& name : names) {
+                auto it = log_items->find(name);
+                if (it != log_items->end())
+                    it->second = Mean(name);
+            }
+        }
+
+    protected:
+        std::unordered_map<std::string, std::pair<torch::Tensor, Int>> sums_; // The sum and the count by metric.
+    };
+}
@@ -0,0 +1,152 @@
+#pragma once
+#include <ATen/autocast_mode.h>
+#include "rlop/common/torch_utils.h"
+
+namespace rlop {
+    // Runs the operations of a scope in mixed precision with the autocast of libtorch: the matrix products and the
+    // convolutions run in `dtype`, float16 or bfloat16, and the numerically sensitive operations, such as the
+    // reductions and the losses, in float32. A dtype of float32 disables it. The forward passes run under the guard
+    // and the backward passes after Exit(), as libtorch recommends.
+    class AutocastGuard {
+    public:
+        AutocastGuard(const torch::Device& device, torch::Dtype dtype) :
+            device_type_(device.type()),
+            dtype_(dtype)
+        {
+            Enter();
+        }
+
+        DISALLOW_COPY_AND_ASSIGN(AutocastGuard);
+
+        virtual ~AutocastGuard() {
+            Exit();
+        }
+
+        void Enter() {
+            if (active_ || dtype_ == torch::kFloat32)
+                return;
+            previous_enabled_ = at::autocast::is_autocast_enabled(device_type_);
+            previous_dtype_ = at::autocast::get_autocast_dtype(device_type_);
+            at::autocast::set_autocast_enabled(device_type_, true);
+            at::autocast::set_autocast_dtype(device_type_, dtype_);
+            at::autocast::increment_nesting();
+            active_ = true;
+        }
+
+        // Restores the autocast state of before Enter(), and frees the cached casts of the weights at the outermost
+        // guard.
+        void Exit() {
+            if (!active_)
+                return;
+            if (at::autocast::decrement_nesting() == 0)
+                at::autocast::clear_cache();
+            at::autocast::set_autocast_enabled(device_type_, previous_enabled_);
+            at::autocast::set_autocast_dtype(device_type_, previous_dtype_);
+            active_ = false;
+        }
+
+        bool active() const {
+            return active_;
+        }
+
+    protected:
+        torch::DeviceType device_type_;
+        torch::Dtype dtype_;
+        bool active_ = false;
+        bool previous_enabled_ = false;
+        torch::Dtype previous_dtype_ = torch::kFloat32;
+    };
+
+    // Scales the losses of float16 training, whose small gradients would underflow otherwise, after the GradScaler
+    // of PyTorch. The gradients are unscaled before the steps, which are skipped when a gradient is infinite or NaN,
+    // and the scale is halved then, and doubled after `growth_interval` steps without any. A disabled scaler, as for
+    // float32 and bfloat16, steps the optimizers as they are.
+    //
+    // An iteration scales each loss with Scale(), unscales the gradients of each optimizer with Unscale(), before
+    // clipping them, steps it with Step(), and ends with Update().
+    class GradScaler {
+    public:
+        GradScaler(
+            bool enabled = false,
+            double init_scale = 65536.0,
+            double growth_factor = 2.0,
+            double backoff_factor = 0.5,
+            Int growth_interval = 2000
+        ) :
+            enabled_(enabled),
+            init_scale_(init_scale),
+            growth_factor_(growth_factor),
+            backoff_factor_(backoff_factor),
+            growth_interval_(growth_interval)
+        {}
+
+        torch::Tensor Scale(const torch::Tensor& loss) {
+            if (!enabled_)
+                return loss;
+            if (!scale_.defined()) {
+                scale_ = torch::full({1}, init_scale_, torch::TensorOptions().dtype(torch::kFloat32).device(loss.device()));
+                growth_tracker_ = torch::zeros({1}, torch::TensorOptions().dtype(torch::kInt32).device(loss.device()));
+            }
+            return loss * scale_.to(loss.scalar_type());
+        }
+
+        // Divides the gradients of the parameters of an optimizer by the scale, once per iteration, and records
+        // whether one of them is infinite or NaN.
+        void Unscale(torch::optim::Optimizer* optimizer) {
+            if (!enabled_ || !scale_.defined() || found_infs_.count(optimizer))
+                return;
+            std::vector<torch::Tensor> grads;
+            for (auto& group : optimizer->param_groups()) {
+                for (auto& param : group.params()) {
+                    if (param.grad().defined())
+                        grads.push_back(param.grad());
+                }
+            }
+            torch::Tensor found_inf = torch::zeros({1}, scale_.options());
+            if (!grads.empty())
+                at::_amp_foreach_non_finite_check_and_unscale_(grads, found_inf, scale_.to(torch::kFloat64).reciprocal().to(torch::kFloat32));
+            found_infs_[optimizer] = found_inf;
+        }
+
+        // Steps an optimizer unless one of its gradients is infinite or NaN, which waits for the device.
+        void Step(torch::optim::Optimizer* optimizer) {
+            if (!enabled_ || !scale_.defined()) {
+                optimizer->step();
+                return;
+            }
+            Unscale(optimizer);
+            if (found_infs_[optimizer].item<float>() == 0)
+                optimizer->step();
+        }
+
+        // Updates the scale from the gradients of the iteration.
+        void Update() {
+            if (!enabled_ || found_infs_.empty())
+                return;
+            torch::Tensor found_inf = torch::zeros({1}, scale_.options());
+            for (const auto& [optimizer, optimizer_found_inf] : found_infs_)
+                found_inf += optimizer_found_inf;
+            at::_amp_update_scale_(scale_, growth_tracker_, found_inf, growth_factor_, backoff_factor_, growth_interval_);
+            found_infs_.clear();
+        }
+
+        bool enabled() const {
+            return enabled_;
+        }
+
+        // Returns the current scale, undefined before the first loss.
+        const torch::Tensor& scale() const {
+            return scale_;
+        }
+
+    protected:
+        bool enabled_;
+        double init_scale_;
+        double growth_factor_;
+        double backoff_factor_;
+        Int growth_interval_;
+        torch::Tensor scale_;
+        torch::Tensor growth_tracker_; // The number of steps since the last infinite gradient.
+        std::unordered_map<torch::optim::Optimizer*, torch::Tensor> found_infs_;
+    };
+}
@@ -0,0 +1,204 @@
+#pragma once
+#include "rlop/common/torch_utils.h"
+
+namespace rlop {
+    // Stores the observations of a buffer in a compact form, encoding them as they are added and decoding them by
+    // batch as they are sampled. The codecs work on batches of observations of shape {n, observation sizes...} on
+    // any device, with tensor operations only.
+    class ObservationCodec {
+    public:
+        virtual ~ObservationCodec() = default;
+
+        // Returns the sizes of an encoded observation.
+        virtual std::vector<Int> EncodedSizes(const std::vector<Int>& observation_sizes) const = 0;
+
+        virtual torch::Dtype encoded_type() const = 0;
+
+        // Encodes a batch of observations of shape {n, observation sizes...} into {n, encoded sizes...}.
+        virtual torch::Tensor Encode(const torch::Tensor& observations) const = 0;
+
+        // Decodes a batch of encoded observations into observations of the given sizes and type.
+        virtual torch::Tensor Decode(const torch::Tensor& encoded, const std::vector<Int>& observation_sizes, torch::Dtype observation_type) const = 0;
+
+        // Returns the number of bytes of an encoded observation.
+        Int EncodedNumBytes(const std::vector<Int>& observation_sizes) const {
+            auto sizes = EncodedSizes(observation_sizes);
+            return std::accumulate(sizes.begin(), sizes.end(), Int(1), std::multiplies<Int>()) * c10::elementSize(encoded_type());
+        }
+    };
+
+    // Quantizes the values to uint8 as round((x - offset) / scale), clamped to [0, 255], which stores values of
+    // 256 levels exactly, and others with an error of at most scale / 2, in a quarter of the bytes of float32.
+    class QuantizedCodec : public ObservationCodec {
+    public:
+        QuantizedCodec(double scale = 1.0 / 255, double offset = 0) : scale_(scale), offset_(offset) {}
+
+        virtual std::vector<Int> EncodedSizes(const std::vector<Int>& observation_sizes) const override {
+            return observation_sizes;
+        }
+
+        virtual torch::Dtype encoded_type() const override {
+            return torch::kUInt8;
+        }
+
+        virtual torch::Tensor Encode(const torch::Tensor& observations) const override {
+            return observations.to(torch::kFloat32).sub(offset_).div_(scale_).round_().clamp_(0, 255).to(torch::kUInt8);
+        }
+
+        virtual torch::Tensor Decode(const torch::Tensor& encoded, const std::vector<Int>& observation_sizes, torch::Dtype observation_type) const override {
+            return encoded.to(torch::kFloat32).mul_(scale_).add_(offset_).to(observation_type);
+        }
+
+        double scale() const {
+            return scale_;
+        }
+
+        double offset() const {
+            return offset_;
+        }
+
+    protected:
+        double scale_;
+        double offset_;
+    };
+
+    // Packs binary observations, such as the 0/1 planes of a grid, into 8 values per byte, in 1/32 of the bytes of
+    // float32. A non-zero value decodes as 1.
+    class BitPackedCodec : public ObservationCodec {
+    public:
+        virtual std::vector<Int> EncodedSizes(const std::vector<Int>& observation_sizes) const override {
+            Int size = std::accumulate(observation_sizes.begin(), observation_sizes.end(), Int(1), std::multiplies<Int>());
+            return { (size + 7) / 8 };
+        }
+
+        virtual torch::Dtype encoded_type() const override {
+            return torch::kUInt8;
+        }
+
+        virtual torch::Tensor Encode(const torch::Tensor& observations) const override {
+            Int n = observations.size(0);
+            torch::Tensor bits = observations.reshape({ n, -1 }).ne(0).to(torch::kUInt8);
+            Int size = bits.size(1);
+            Int padding = (8 - size % 8) % 8;
+            if (padding > 0)
+                bits = torch::constant_pad_nd(bits, { 0, padding });
+            return bits.reshape({ n, -1, 8 }).mul_(BitWeights(bits.device())).sum(-1).to(torch::kUInt8);
+        }
+
+        virtual torch::Tensor Decode(const torch::Tensor& encoded, const std::vector<Int>& observation_sizes, torch::Dtype observation_type) const override {
+            Int n = encoded.size(0);
+            Int size = std::accumulate(observation_sizes.begin(), observation_sizes.end(), Int(1), std::multiplies<Int>());
+            torch::Tensor bits = encoded.reshape({ n, -1, 1 }).bitwise_and(BitWeights(encoded.device())).ne(0);
+            std::vector<Int> sizes = { n };
+            sizes.insert(sizes.end(), observation_sizes.begin(), observation_sizes.end());
+            return bits.reshape({ n, -1 }).slice(1, 0, size).to(observation_type).reshape(sizes);
+        }
+
+    protected:
+        static torch::Tensor BitWeights(const torch::Device& device) {
+            return torch::tensor({ 128, 64, 32, 16, 8, 4, 2, 1 }, torch::TensorOptions().dtype(torch::kUInt8).device(device));
+        }
+    };
+
+    // Stores the values in half precision, float16 or bfloat16, in half the bytes of float32, as the mixed precision
+    // of the training runs its forward passes. float16 keeps 11 significant bits in [6e-5, 65504], and bfloat16 8 bits
+    // in the range of float32.
+    class HalfPrecisionCodec : public ObservationCodec {
+    public:
+        HalfPrecisionCodec(torch::Dtype dtype = torch::kFloat16) : dtype_(dtype) {
+            if (dtype_ != torch::kFloat16 && dtype_ != torch::kBFloat16)
+                throw std::runtime_error("HalfPrecisionCodec: the type must be float16 or bfloat16.");
+        }
+
+        virtual std::vector<Int> EncodedSizes(const std::vector<Int>& observation_sizes) const override {
+            return observation_sizes;
+        }
+
+        virtual torch::Dtype encoded_type() const override {
+            return dtype_;
+        }
+
+        virtual torch::Tensor Encode(const torch::Tensor& observations) const override {
+            return observations.to(dtype_);
+        }
+
+        virtual torch::Tensor Decode(const torch::Tensor& encoded, const std::vector<Int>& observation_sizes, torch::Dtype observation_type) const override {
+            return encoded.to(observation_type);
+        }
+
+    protected:
+        torch::Dtype dtype_;
+    };
+
+    // Encodes groups of consecutive channels, the first dimension of the observations, with their own codecs, such
+    // as the binary planes of a grid bit-packed and a graded plane quantized, and concatenates the flattened codes.
+    // The codecs must share their encoded type.
+    class ChannelSplitCodec : public ObservationCodec {
+    public:
+        // Parameters:
+        //   num_channels: The number of channels of each group.
+        //   codecs: The codec of each group.
+        ChannelSplitCodec(const std::vector<Int>& num_channels, const std::vector<std::shared_ptr<ObservationCodec>>& codecs) :
+            num_channels_(num_channels),
+            codecs_(codecs)
+        {
+            if (num_channels_.size() != codecs_.size() || codecs_.empty())
+                throw std::runtime_error("ChannelSplitCodec: requires one codec per group of channels.");
+            for (const auto& codec : codecs_) {
+                if (codec->encoded_type() != codecs_[0]->encoded_type())
+                    throw std::runtime_error("ChannelSplitCodec: requires codecs of the same encoded type.");
+            }
+        }
+
+        virtual std::vector<Int> EncodedSizes(const std::vector<Int>& observation_sizes) const override {
+            Int size = 0;
+            for (Int i=0; i<codecs_.size(); ++i) {
+                auto sizes = codecs_[i]->EncodedSizes(GroupSizes(observation_sizes, i));
+                size += std::accumulate(sizes.begin(), sizes.end(), Int(1), std::multiplies<Int>());
+            }
+            return { size };
+        }
+
+        virtual torch::Dtype encoded_type() const override {
+            return codecs_[0]->encoded_type();
+        }
+
+        virtual torch::Tensor Encode(const torch::Tensor& observations) const override {
+            Int n = observations.size(0);
+            std::vector<torch::Tensor> codes;
+            codes.reserve(codecs_.size());
+            Int channel = 0;
+            for (Int i=0; i<codecs_.size(); ++i) {
+                codes.push_back(codecs_[i]->Encode(observations.slice(1, channel, channel + num_channels_[i])).reshape({ n, -1 }));
+                channel += num_channels_[i];
+            }
+            return torch::cat(codes, 1);
+        }
+
+        virtual torch::Tensor Decode(const torch::Tensor& encoded, const std::vector<Int>& observation_sizes, torch::Dtype observation_type) const override {
+            Int n = encoded.size(0);
+            std::vector<torch::Tensor> groups;
+            groups.reserve(codecs_.size());
+            Int offset = 0;
+            for (Int i=0; i<codecs_.size(); ++i) {
+                auto group_sizes = GroupSizes(observation_sizes, i);
+                auto sizes = codecs_[i]->EncodedSizes(group_sizes);
+                Int size = std::accumulate(sizes.begin(), sizes.end(), Int(1), std::multiplies<Int>());
+                sizes.insert(sizes.begin(), n);
+                groups.push_back(codecs_[i]->Decode(encoded.slice(1, offset, offset + size).reshape(sizes), group_sizes, observation_type));
+                offset += size;
+            }
+            return torch::cat(groups, 1);
+        }
+
+    protected:
+        std::vector<Int> GroupSizes(const std::vector<Int>& observation_sizes, Int i) const {
+            std::vector<Int> sizes = observation_sizes;
+            sizes[0] = num_channels_[i];
+            return sizes;
+        }
+
+        std::vector<Int> num_channels_;
+        std::vector<std::shared_ptr<ObservationCodec>> codecs_;
+    };
+}
@@ -1,10 +1,24 @@
 #pragma once
 #include "rl.h"
 #include "buffers.h"
+#include "batch_prefetcher.h"
+#include "cuda_graph.h"
 #include "policy.h"
 
 namespace rlop {
     // The base class for Off-Policy algorithms (ex: SAC/DQN).
+    //
+    // In the asynchronous mode of set_async(), Learn() steps the environments on an actor thread with a copy of the
+    // policy, synchronized with the trained one every `policy_sync_interval` updates, while the training runs
+    // concurrently on the calling thread, so that neither the device nor the environments wait for the other. The
+    // replay buffer is shared under a mutex. With an update-to-data ratio, the training waits for the transitions
+    // which its next updates are due for, and the actor waits when the training lags by more than `max_update_lag`
+    // updates. OnCollectRolloutStep() then runs on the training thread, once per step collected since the previous
+    // training, so that the callbacks update the trained networks between their gradient steps. The environments
+    // are only stepped from the actor thread, so that environments calling into Python need the GIL released by the
+    // calling thread. Step() and SampleActions() then run concurrently with the training, Monitor() and the
+    // callbacks, and must not touch the log items or other state of the training thread, but hand their results to
+    // OnCollectRolloutStep() under a lock of their own.
     class OffPolicyRL : public RL {
     public:
         OffPolicyRL(
@@ -15,10 +29,13 @@ namespace rlop {
         ) :
             learning_starts_(learning_starts),
             train_freq_(train_freq),
+            num_prefetch_batches_(device.is_cuda() ? 2 : 0),
             RL(output_path, device) 
         {}
 
-        virtual ~OffPolicyRL() = default;
+        virtual ~OffPolicyRL() {
+            StopActor();
+        }
 
         // Factory method to create and return a shared pointer to a replay buffer.
         virtual std::shared_ptr<ReplayBuffer> MakeReplayBuffer() const = 0; 
@@ -34,10 +51,14 @@ namespace rlop {
 
         virtual void Reset() override {
             RL::Reset();
+            prefetcher_ = nullptr;
             replay_buffer_ = MakeReplayBuffer();
             replay_buffer_->Reset();
+            if (num_prefetch_batches_ > 0)
+                prefetcher_ = std::make_unique<BatchPrefetcher>(replay_buffer_, device_, num_prefetch_batches_, replay_buffer_mutex_);
             policy_ = MakePolicy();
             policy_->To(device_);
+            policy_->set_cuda_graph(cuda_graph_);
             policy_->Reset();
             last_observations_ = ResetEnv();
         }
@@ -62,40 +83,154 @@ namespace rlop {
             const torch::Tensor& truncations,
             const torch::Tensor& final_observations
         ) {
-            torch::Tensor next_observations = new_observations.clone();
+            torch::Tensor next_observations = new_observations;
             if (final_observations.defined()) {
-                torch::Tensor dones = torch::logical_or(terminations, truncations);
-                for (Int i=0; i<replay_buffer_->num_envs(); ++i) {
-                    if (dones[i].item<bool>()) 
-                        next_observations[i].copy_(final_observations[i]);
-                }
+                std::vector<Int> mask_sizes(new_observations.dim(), 1);
+                mask_sizes[0] = -1;
+                torch::Tensor dones = torch::logical_or(terminations, truncations).to(new_observations.device()).reshape(mask_sizes);
+                next_observations = torch::where(dones, final_observations.to(new_observations.device(), new_observations.scalar_type()), new_observations);
             }
             replay_buffer_->Add(last_observations_, actions, next_observations, rewards, terminations); 
             last_observations_ = new_observations;
         }
 
+        // Starts sampling the batches of the gradient steps of a training, which are prefetched in the background
+        // with a prefetcher.
+        void StartSampling(Int num_batches, Int batch_size) {
+            sample_batch_size_ = batch_size;
+            if (prefetcher_ != nullptr)
+                prefetcher_->Start(num_batches, batch_size);
+        }
+
+        // Returns the next batch of the training, on the device. With the CUDA graphs, the batches are copied into
+        // the same static tensors, which the captured gradient steps read.
+        ReplayBuffer::Batch NextBatch() {
+            Telemetry::Scope scope(&telemetry_, Telemetry::kBuffer);
+            ReplayBuffer::Batch batch;
+            if (prefetcher_ != nullptr)
+                batch = prefetcher_->Next();
+            else {
+                std::lock_guard<std::mutex> lock(*replay_buffer_mutex_);
+                batch = replay_buffer_->Sample(sample_batch_size_);
+            }
+            if (cuda_graph_) {
+                batch.CopyTo(&static_batch_, device_);
+                return static_batch_;
+            }
+            return prefetcher_ != nullptr ? batch : batch.To(device_);
+        }
+
+        // Runs a part of a gradient step, a function of the batches of NextBatch(), in a CUDA graph with the CUDA
+        // graphs, and eagerly otherwise.
+        void RunCudaGraph(std::unique_ptr<CudaGraph>* graph, const std::function<void()>& function) {
+            if (!cuda_graph_) {
+                function();
+                return;
+            }
+            if (*graph == nullptr)
+                *graph = std::make_unique<CudaGraph>(device_);
+            (*graph)->Run(function);
+        }
+
+        virtual void ResetCudaGraphs() override {
+            static_batch_ = ReplayBuffer::Batch();
+            if (policy_ != nullptr)
+                policy_->ResetCudaGraphs();
+            if (actor_policy_ != nullptr)
+                actor_policy_->ResetCudaGraphs();
+        }
+
+        // Updates the priorities of the replay buffer from the TD errors of a batch.
+        void UpdatePriorities(const torch::Tensor& indices, const torch::Tensor& td_errors) {
+            if (prefetcher_ != nullptr) {
+                prefetcher_->UpdatePriorities(indices, td_errors);
+                return;
+            }
+            torch::Tensor cpu_td_errors = td_errors.detach().to(torch::kCPU);
+            std::lock_guard<std::mutex> lock(*replay_buffer_mutex_);
+            replay_buffer_->UpdatePriorities(indices, cpu_td_errors);
+        }
+
+        virtual void Learn(Int max_time_steps, Int monitor_interval = 0, Int checkpoint_interval = 0) override {
+            if (!async_) {
+                RL::Learn(max_time_steps, monitor_interval, checkpoint_interval);
+                return;
+            }
+            RLOP_PROFILE_SCOPE("OffPolicyRL::Learn");
+            time_steps_ = 0;
+            max_time_steps_ = max_time_steps;
+            monitor_interval_ = monitor_interval;
+            checkpoint_interval_ = checkpoint_interval;
+            telemetry_.Restart(time_steps_);
+            StartActor();
+            try {
+                while (Proceed()) {
+                    WaitForTransitions();
+                    {
+                        Telemetry::Scope scope(&telemetry_, Telemetry::kTrain);
+                        Train();
+                    }
+                    {
+                        std::lock_guard<std::mutex> lock(actor_mutex_);
+                        num_learner_updates_ = num_updates_ - num_start_updates_;
+                    }
+                    actor_cv_.notify_all();
+                    if (num_updates_ - num_synced_updates_ >= policy_sync_interval_)
+                        SyncActorPolicy();
+                    {
+                        Telemetry::Scope scope(&telemetry_, Telemetry::kLog);
+                        RunCallbacks();
+                        Monitor();
+                        Checkpoint();
+                        OnLearnStep();
+                    }
+                    ++num_iters_;
+                    telemetry_.EndIteration(time_steps_);
+                }
+            }
+            catch (...) {
+                StopActor();
+                throw;
+            }
+            StopActor();
+            checkpoint_writer_.Wait();
+            EndCallbacks();
+        }
+
         // A callback function for DQN, check if the target network should be updated
         // and update the exploration schedule
         virtual void OnCollectRolloutStep() {}
 
         virtual void CollectRollouts() override {
+            RLOP_PROFILE_SCOPE("OffPolicyRL::CollectRollouts");
             policy_->SetTrainingMode(false);
             torch::NoGradGuard no_grad;
             for (Int step = 0; step < train_freq_; ++step) {
                 torch::Tensor actions;
-                if (time_steps_ < learning_starts_)
-                    actions = SampleActions();
-                else 
-                    actions = Predict(last_observations_, false)[0];
-                auto [new_observations, rewards, terminations, truncations, final_observations] = Step(actions);
+                {
+                    Telemetry::Scope scope(&telemetry_, Telemetry::kInference);
+                    if (time_steps_ < learning_starts_)
+                        actions = SampleActions();
+                    else 
+                        actions = Predict(last_observations_, false)[0];
+                }
+                std::array<torch::Tensor, 5> results;
+                {
+                    Telemetry::Scope scope(&telemetry_, Telemetry::kEnv);
+                    results = Step(actions);
+                }
+                auto [new_observations, rewards, terminations, truncations, final_observations] = results;
                 time_steps_ += replay_buffer_->num_envs();
-                StoreTransition(actions, new_observations, rewards, terminations, truncations, final_observations);
+                {
+                    Telemetry::Scope scope(&telemetry_, Telemetry::kBuffer);
+                    StoreTransition(actions, new_observations, rewards, terminations, truncations, final_observations);
+                }
                 OnCollectRolloutStep();
             }
         }
 
         virtual std::array<torch::Tensor, 2> Predict(const torch::Tensor& observation, bool deterministic = false, const torch::Tensor& state = torch::Tensor(), const torch::Tensor& episode_start = torch::Tensor()) override {
-            return policy_->Predict(observation, deterministic, state, episode_start);
+            return ActingPolicy()->Predict(observation, deterministic, state, episode_start);
         }
 
         virtual void Monitor() override {
@@ -112,11 +247,207 @@ namespace rlop {
             return policy_;
         }
 
+        virtual std::shared_ptr<RLPolicy> GetPolicy() const override {
+            return policy_;
+        }
+
+        Int num_prefetch_batches() const {
+            return num_prefetch_batches_;
+        }
+
+        // Sets the number of batches sampled ahead of the training on a background thread, 0 to sample them when
+        // needed, which is the default on the CPU. It applies from the next Reset().
+        void set_num_prefetch_batches(Int num_prefetch_batches) {
+            num_prefetch_batches_ = num_prefetch_batches;
+        }
+
+        bool async() const {
+            return async_;
+        }
+
+        // Sets whether Learn() collects the transitions on an actor thread concurrently with the training. Step() and
+        // SampleActions() then run on the actor thread, so they must not write the log items.
+        void set_async(bool async) {
+            async_ = async;
+        }
+
+        double update_to_data_ratio() const {
+            return update_to_data_ratio_;
+        }
+
+        // Sets the number of gradient updates per environment time step of the asynchronous mode, 0 to train
+        // continuously, and the number of updates by which the training may lag before the actor waits.
+        void set_update_to_data_ratio(double update_to_data_ratio, Int max_update_lag = 1000) {
+            update_to_data_ratio_ = update_to_data_ratio;
+            max_update_lag_ = max_update_lag;
+        }
+
+        bool flat_parameters() const {
+            return flat_parameters_;
+        }
+
+        // Sets whether the parameters of the networks updating target networks are kept in flat tensors, so that a
+        // target update is one operation whatever the number of layers. Effective from the next Reset().
+        void set_flat_parameters(bool flat_parameters) {
+            flat_parameters_ = flat_parameters;
+        }
+
+        Int policy_sync_interval() const {
+            return policy_sync_interval_;
+        }
+
+        // Sets the number of gradient updates between two copies of the trained policy to the actor.
+        void set_policy_sync_interval(Int policy_sync_interval) {
+            policy_sync_interval_ = policy_sync_interval;
+        }
+
     protected:
+        // Returns the policy of the calling thread, the copy of the actor on the actor thread.
+        RLPolicy* ActingPolicy() const {
+            if (acting_rl_ == this)
+                return actor_policy_.get();
+            return policy_.get();
+        }
+
+        void StartActor() {
+            actor_policy_ = MakePolicy();
+            actor_policy_->To(device_);
+            actor_policy_->set_cuda_graph(cuda_graph_);
+            actor_policy_->Reset();
+            SyncActorPolicy();
+            num_start_updates_ = num_updates_;
+            num_actor_steps_ = 0;
+            num_pending_steps_ = 0;
+            num_learner_updates_ = 0;
+            stop_actor_ = false;
+            actor_done_ = false;
+            actor_error_ = nullptr;
+            actor_thread_ = std::thread([this]() { RunActor(); });
+        }
+
+        void StopActor() {
+            if (!actor_thread_.joinable())
+                return;
+            {
+                std::lock_guard<std::mutex> lock(actor_mutex_);
+                stop_actor_ = true;
+            }
+            actor_cv_.notify_all();
+            actor_thread_.join();
+            actor_policy_ = nullptr;
+        }
+
+        void SyncActorPolicy() {
+            std::lock_guard<std::mutex> lock(policy_mutex_);
+            torch::NoGradGuard no_grad;
+            torch_utils::CopyStateDict(*policy_, actor_policy_.get());
+            num_synced_updates_ = num_updates_;
+        }
+
+        // Steps the environments until the time steps of Learn() are collected, on the actor thread.
+        void RunActor() {
+            RLOP_PROFILE_SCOPE("OffPolicyRL::RunActor");
+            acting_rl_ = this;
+            try {
+                torch::NoGradGuard no_grad;
+                while (true) {
+                    Int num_actor_steps;
+                    {
+                        std::unique_lock<std::mutex> lock(actor_mutex_);
+                        actor_cv_.wait(lock, [&]() { return stop_actor_ || update_to_data_ratio_ <= 0 || num_actor_steps_ <= learning_starts_ || 
+                            update_to_data_ratio_ * (num_actor_steps_ - learning_starts_) - num_learner_updates_ <= max_update_lag_; });
+                        if (stop_actor_ || num_actor_steps_ >= max_time_steps_)
+                            break;
+                        num_actor_steps = num_actor_steps_;
+                    }
+                    torch::Tensor actions;
+                    if (num_actor_steps < learning_starts_)
+                        actions = SampleActions();
+                    else {
+                        // The callbacks of the training thread, such as an exploration schedule, hold it as well.
+                        std::lock_guard<std::mutex> lock(policy_mutex_);
+                        Telemetry::Scope scope(&telemetry_, Telemetry::kInference);
+                        actions = Predict(last_observations_, false)[0];
+                    }
+                    std::array<torch::Tensor, 5> results;
+                    {
+                        Telemetry::Scope scope(&telemetry_, Telemetry::kEnv);
+                        results = Step(actions);
+                    }
+                    auto [new_observations, rewards, terminations, truncations, final_observations] = results;
+                    {
+                        std::lock_guard<std::mutex> lock(*replay_buffer_mutex_);
+                        Telemetry::Scope scope(&telemetry_, Telemetry::kBuffer);
+                        StoreTransition(actions, new_observations, rewards, terminations, truncations, final_observations);
+                    }
+                    {
+                        std::lock_guard<std::mutex> lock(actor_mutex_);
+                        num_actor_steps_ += replay_buffer_->num_envs();
+                        ++num_pending_steps_;
+                    }
+                    actor_cv_.notify_all();
+                }
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(actor_mutex_);
+                actor_error_ = std::current_exception();
+            }
+            {
+                std::lock_guard<std::mutex> lock(actor_mutex_);
+                actor_done_ = true;
+            }
+            acting_rl_ = nullptr;
+            actor_cv_.notify_all();
+        }
+
+        // Waits until the actor has collected the transitions of the next training at the update-to-data ratio, and
+        // runs the callbacks of the steps collected since the previous training.
+        void WaitForTransitions() {
+            Int num_pending_steps;
+            {
+                std::unique_lock<std::mutex> lock(actor_mutex_);
+                actor_cv_.wait(lock, [&]() { return actor_done_ || (num_actor_steps_ > learning_starts_ && (update_to_data_ratio_ <= 0 || 
+                    num_learner_updates_ < update_to_data_ratio_ * (num_actor_steps_ - learning_starts_))); });
+                if (actor_error_ != nullptr)
+                    std::rethrow_exception(actor_error_);
+                time_steps_ = num_actor_steps_;
+                num_pending_steps = num_pending_steps_;
+                num_pending_steps_ = 0;
+            }
+            std::lock_guard<std::mutex> lock(policy_mutex_);
+            for (Int i=0; i<num_pending_steps; ++i)
+                OnCollectRolloutStep();
+        }
+
         Int learning_starts_;
         Int train_freq_;
+        Int num_prefetch_batches_;
+        Int sample_batch_size_ = 0;
         torch::Tensor last_observations_;
         std::shared_ptr<ReplayBuffer> replay_buffer_ = nullptr;
         std::shared_ptr<RLPolicy> policy_ = nullptr;
+        std::unique_ptr<BatchPrefetcher> prefetcher_ = nullptr;
+        ReplayBuffer::Batch static_batch_; // The inputs of the captured gradient steps.
+        std::shared_ptr<std::mutex> replay_buffer_mutex_ = std::make_shared<std::mutex>();
+        bool async_ = false;
+        double update_to_data_ratio_ = 0;
+        Int max_update_lag_ = 1000;
+        Int policy_sync_interval_ = 100;
+        bool flat_parameters_ = false;
+        std::shared_ptr<RLPolicy> actor_policy_ = nullptr; // The copy of the policy stepping the environments, while the actor runs.
+        std::thread actor_thread_;
+        std::mutex policy_mutex_; // Guards the actor policy and the state the actions depend on.
+        std::mutex actor_mutex_; // Guards the counters below.
+        std::condition_variable actor_cv_;
+        Int num_actor_steps_ = 0; // The time steps collected by the actor.
+        Int num_pending_steps_ = 0; // The collection steps whose callbacks have not run.
+        Int num_learner_updates_ = 0; // The gradient updates since the actor started.
+        Int num_start_updates_ = 0;
+        Int num_synced_updates_ = 0;
+        bool stop_actor_ = false;
+        bool actor_done_ = false;
+        std::exception_ptr actor_error_ = nullptr;
+
+        static inline thread_local const OffPolicyRL* acting_rl_ = nullptr; // The algorithm whose actor runs on the thread.
     };
 }
\ No newline at end of file
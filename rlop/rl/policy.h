@@ -1,5 +1,6 @@
 #pragma once
 #include "rlop/common/torch_utils.h"
+#include "cuda_graph.h"
 
 namespace rlop {
     class RLPolicy : public torch::nn::Module {
@@ -57,14 +58,80 @@ namespace rlop {
         virtual std::array<torch::Tensor, 2> Predict(const torch::Tensor& observation, bool deterministic = false, const torch::Tensor& state = torch::Tensor(), const torch::Tensor& episode_start = torch::Tensor()) {
             SetTrainingMode(false);
             torch::NoGradGuard no_grad;
+            if (cuda_graph_ && device_.is_cuda()) {
+                return { 
+                    RunCudaGraph(deterministic ? "predict_deterministic" : "predict", { observation }, [this, deterministic](const std::vector<torch::Tensor>& inputs) {
+                        return std::vector<torch::Tensor>{ PredictActions(inputs[0], deterministic) }; 
+                    })[0], 
+                    torch::Tensor() 
+                };
+            }
             return { PredictActions(observation.to(device_), deterministic), torch::Tensor() };
         }
 
+        // Copies the weights of a policy of the same structure, by default its parameters and buffers, such as into the
+        // copy of an actor or into a quantized copy.
+        virtual void CopyWeights(const RLPolicy& source) {
+            torch_utils::CopyStateDict(source, this);
+        }
+
         void To(const torch::Device& device) {
             device_ = device;
+            ResetCudaGraphs();
+        }
+
+        bool cuda_graph() const {
+            return cuda_graph_;
+        }
+
+        // Sets whether the predictions of the policy, such as Predict(), are captured into CUDA graphs on a CUDA
+        // device, one per shape of their inputs, and replayed at the next predictions of the same shapes.
+        void set_cuda_graph(bool cuda_graph) {
+            cuda_graph_ = cuda_graph;
+            ResetCudaGraphs();
+        }
+
+        // Discards the captured graphs, which must be done when the parameters are reallocated, as by Reset() or
+        // load(), rather than updated in place.
+        void ResetCudaGraphs() {
+            cuda_graphs_.clear();
         }
 
     protected:
+        struct CapturedCall {
+            std::vector<torch::Tensor> inputs; // The static inputs, which the inputs of a call are copied into.
+            std::vector<torch::Tensor> outputs;
+            std::unique_ptr<CudaGraph> graph = nullptr;
+        };
+
+        // Runs a function of inputs on the device in the CUDA graph of `name` and the shapes and types of the inputs,
+        // and returns copies of its outputs, which the next replays overwrite.
+        std::vector<torch::Tensor> RunCudaGraph(
+            const std::string& name, 
+            const std::vector<torch::Tensor>& inputs, 
+            const std::function<std::vector<torch::Tensor>(const std::vector<torch::Tensor>&)>& function
+        ) {
+            std::string key = name;
+            for (const auto& input : inputs)
+                key += "|" + std::string(c10::toString(input.scalar_type())) + c10::str(input.sizes());
+            CapturedCall& call = cuda_graphs_[key];
+            if (call.graph == nullptr) {
+                for (const auto& input : inputs)
+                    call.inputs.push_back(torch::empty(input.sizes(), input.options().device(device_)));
+                call.graph = std::make_unique<CudaGraph>(device_);
+            }
+            for (size_t i = 0; i < inputs.size(); ++i)
+                call.inputs[i].copy_(inputs[i], true);
+            call.graph->Run([&]() { call.outputs = function(call.inputs); });
+            std::vector<torch::Tensor> outputs;
+            outputs.reserve(call.outputs.size());
+            for (const auto& output : call.outputs)
+                outputs.push_back(output.defined() ? output.clone() : output);
+            return outputs;
+        }
+
         torch::Device device_ = torch::kCPU;
+        bool cuda_graph_ = false;
+        std::unordered_map<std::string, CapturedCall> cuda_graphs_;
     };
 }
\ No newline at end of file
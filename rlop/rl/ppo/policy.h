@@ -47,7 +47,21 @@ namespace rlop {
         //     - [2]: The log probability of the recommended action.
         virtual std::array<torch::Tensor, 3> Forward(const torch::Tensor& observations) = 0;
 
+        // Runs Forward() without gradients for the collection of rollouts, replayed from a CUDA graph with
+        // set_cuda_graph() on a CUDA device.
+        std::array<torch::Tensor, 3> RunForward(const torch::Tensor& observations) {
+            torch::NoGradGuard no_grad;
+            if (!cuda_graph_ || !device_.is_cuda())
+                return Forward(observations.to(device_));
+            auto outputs = RunCudaGraph("forward", { observations }, [this](const std::vector<torch::Tensor>& inputs) {
+                auto [ actions, values, log_probs ] = Forward(inputs[0]);
+                return std::vector<torch::Tensor>{ actions, values, log_probs };
+            });
+            return { outputs[0], outputs[1], outputs[2] };
+        }
+
         virtual void Reset() override {
+            ResetCudaGraphs();
             this->to(device_);
         }
 
@@ -2,6 +2,7 @@
 #include "policy.h"
 #include "rlop/rl/rl.h"
 #include "rlop/rl/buffers.h"
+#include "rlop/rl/ensemble.h"
 
 namespace rlop {
     // The PPO class implements the Proximal Policy Optimization algorithm, which is designed for efficient and effective
@@ -52,10 +53,23 @@ namespace rlop {
        
         virtual void Reset() override {
             RL::Reset();
+            if (num_seeds_ > 1 && !data_parallel_devices_.empty())
+                throw std::runtime_error("PPO: the seeds trained together do not support the data parallelism.");
+            if (batch_size_ % num_seeds_ != 0)
+                throw std::runtime_error("PPO: the batch size must be a multiple of the number of seeds.");
             rollout_buffer_ = MakeRolloutBuffer();
+            rollout_buffer_->set_num_groups(num_seeds_);
             policy_ = MakePolicy();
             policy_->To(device_);
+            policy_->set_cuda_graph(cuda_graph_);
             policy_->Reset();
+            replicas_.clear();
+            for (const auto& device : data_parallel_devices_) {
+                auto replica = MakePolicy();
+                replica->To(device);
+                replica->Reset();
+                replicas_.push_back(replica);
+            }
             optimizer_ = MakeOptimizer();
             last_observations_ = ResetEnv();
             last_episode_starts_ = torch::ones({ rollout_buffer_->num_envs() }, torch::kBool);
@@ -80,34 +94,38 @@ namespace rlop {
         }
 
         virtual void CollectRollouts() override {
-            std::vector<double> reward_list;
+            RLOP_PROFILE_SCOPE("PPO::CollectRollouts");
+            MetricAccumulator rollout_metrics;
             policy_->SetTrainingMode(false);
             torch::NoGradGuard no_grad;
             rollout_buffer_->Reset();
-            while (!rollout_buffer_->full()) {
-                auto [ actions, values, log_probs ] = policy_->Forward(last_observations_.to(device_));
-                auto [next_observations, rewards, terminations, truncations, terminal_observations] = Step(actions);
-                rewards = rewards.to(torch::kFloat32);
-                time_steps_ += rollout_buffer_->num_envs();
-                torch::Tensor dones = torch::logical_or(terminations, truncations);
-                if (terminal_observations.defined()) {
-                    for (Int i=0; i<rollout_buffer_->num_envs(); ++i) {
-                        if (terminations[i].item<bool>()) {
-                            torch::Tensor terminal_value = policy_->PredictValues(terminal_observations[i].unsqueeze(0).to(device_))[0];
-                            rewards[i] += gamma_ * terminal_value.to(rewards.device());
-                        }
+            if (NumEnvGroups() > 1)
+                CollectPipelinedSteps(&rollout_metrics);
+            else {
+                while (!rollout_buffer_->full()) {
+                    std::array<torch::Tensor, 3> forward;
+                    {
+                        Telemetry::Scope scope(&telemetry_, Telemetry::kInference);
+                        forward = policy_->RunForward(last_observations_);
+                    }
+                    std::array<torch::Tensor, 5> results;
+                    {
+                        Telemetry::Scope scope(&telemetry_, Telemetry::kEnv);
+                        results = Step(forward[0]);
                     }
+                    AddRolloutStep(forward[0], forward[1], forward[2], results, &rollout_metrics);
                 }
-                reward_list.push_back(rewards.mean().item<double>());
-                rollout_buffer_->Add(last_observations_, actions, values, log_probs, rewards, last_episode_starts_);
-                last_observations_ = next_observations;
-                last_episode_starts_ = dones;
             }
-            torch::Tensor values = policy_->PredictValues(last_observations_.to(device_));
-            rollout_buffer_->UpdateGAE(values, last_episode_starts_, gamma_, gae_lambda_);
-            auto it = log_items_.find("mean_reward");
-            if (it != log_items_.end()) 
-                it->second  = torch::tensor(reward_list).mean();
+            torch::Tensor values;
+            {
+                Telemetry::Scope scope(&telemetry_, Telemetry::kInference);
+                values = policy_->PredictValues(last_observations_.to(device_));
+            }
+            {
+                Telemetry::Scope scope(&telemetry_, Telemetry::kBuffer);
+                rollout_buffer_->UpdateGAE(values, last_episode_starts_, gamma_, gae_lambda_);
+            }
+            rollout_metrics.WriteTo(&log_items_, { "mean_reward" });
         }
 
         virtual std::array<torch::Tensor, 2> Predict(const torch::Tensor& observation, bool deterministic = false, const torch::Tensor& state = torch::Tensor(), const torch::Tensor& episode_start = torch::Tensor()) {
@@ -115,65 +133,89 @@ namespace rlop {
         }
     
         virtual void Train() override {
+            RLOP_PROFILE_SCOPE("PPO::Train");
             Int num_steps = std::ceil(rollout_buffer_->Size() * rollout_buffer_->num_envs() / (double)batch_size_);
-            std::vector<double> ratio_list;
-            std::vector<double> policy_loss_list;
-            std::vector<double> value_loss_list;
-            std::vector<double> entropy_loss_list;
-            std::vector<double> loss_list;
-            std::vector<double> approx_kl_list;
-            Int size = num_epochs_* num_steps;
-            ratio_list.reserve(size);
-            policy_loss_list.reserve(size);
-            value_loss_list.reserve(size);
-            entropy_loss_list.reserve(size);
-            loss_list.reserve(size);
-            approx_kl_list.reserve(size);
+            metrics_.Reset();
             bool continue_training = true;
             policy_->SetTrainingMode(true);
+            for (auto& replica : replicas_) {
+                replica->SetTrainingMode(true);
+            }
+            SyncReplicas();
             for (Int epoch=0; epoch<num_epochs_; ++epoch) {
                 for (Int step =0; step<num_steps; ++step) {
-                    auto batch = rollout_buffer_->Get(batch_size_).To(device_);
-                    auto advantages = batch.advantages;
-                    auto [ values, log_prob, entropy ] = policy_->EvaluateActions(batch.observations, batch.actions);
-                    if (normalize_advantage_ && advantages.sizes()[0] > 1)
-                        advantages = (advantages - advantages.mean()) / (advantages.std() + 1e-8);
-                    torch::Tensor ratio = torch::exp(log_prob - batch.log_prob);
-                    torch::Tensor policy_loss_1 = advantages * ratio;
-                    torch::Tensor policy_loss_2 = advantages * torch::clamp(ratio, 1 - clip_range_, 1 + clip_range_);
-                    torch::Tensor policy_loss = -torch::min(policy_loss_1, policy_loss_2).mean();
-                    torch::Tensor pred_value;
-                    if (clip_range_vf_ > 0)
-                        pred_value = batch.values + torch::clamp(values - batch.values, -clip_range_vf_, clip_range_vf_);
-                    else
-                        pred_value = values; 
-                    torch::Tensor value_loss = torch::mse_loss(batch.returns, pred_value);
-                    torch::Tensor entropy_loss;
-                    if (entropy)
-                        entropy_loss = -torch::mean(*entropy);
-                    else
-                        entropy_loss = -torch::mean(-log_prob);
-                    torch::Tensor loss = policy_loss + vf_coef_ * value_loss + ent_coef_ * entropy_loss;
-                    double approx_kl_div;
+                    RolloutBuffer::Batch batch;
                     {
-                        torch::NoGradGuard no_grad;
-                        approx_kl_div = torch_utils::ComputeApproxKL(log_prob, batch.log_prob).to(torch::kCPU).item<double>();
+                        Telemetry::Scope scope(&telemetry_, Telemetry::kBuffer);
+                        batch = rollout_buffer_->Get(batch_size_).To(device_);
+                    }
+                    // The advantages of the seeds are normalized apart, as in their own trainings.
+                    if (normalize_advantage_ && batch.advantages.sizes()[0] > num_seeds_) {
+                        torch::Tensor advantages = batch.advantages.view({ num_seeds_, -1 });
+                        batch.advantages = ((advantages - advantages.mean(1, true)) / (advantages.std(1, true) + 1e-8)).view({ -1 });
                     }
-                    if (target_kl_ > 0 && approx_kl_div > 1.5 * target_kl_) {
-                        std::cout << "Early stopping at epoch " << epoch << " due to reaching max kl: {approx_kl_div: " << approx_kl_div << "}"  << std::endl;
-                        continue_training = false;
-                        break;
+                    // The batch is split over the replicas of the policy, whose losses are weighted by the sizes of
+                    // their shards, so that the sum of their gradients is that of the whole batch.
+                    Int num_shards = replicas_.size() + 1;
+                    Int num_samples = batch.observations.size(0);
+                    std::vector<std::array<torch::Tensor, 6>> shard_losses;
+                    std::vector<double> weights;
+                    for (Int shard=0; shard<num_shards; ++shard) {
+                        Int begin = num_samples * shard / num_shards;
+                        Int end = num_samples * (shard + 1) / num_shards;
+                        if (begin == end)
+                            continue;
+                        PPOPolicy* policy = shard == 0 ? policy_.get() : replicas_[shard - 1].get();
+                        const torch::Device& device = shard == 0 ? device_ : data_parallel_devices_[shard - 1];
+                        auto shard_batch = num_shards == 1 ? batch : batch.Slice(begin, end).To(device);
+                        AutocastGuard autocast = Autocast();
+                        shard_losses.push_back(ComputeLosses(policy, shard_batch));
+                        weights.push_back((end - begin) / (double)num_samples);
+                    }
+                    std::array<torch::Tensor, 6> losses;
+                    for (Int i=0; i<6; ++i) {
+                        losses[i] = shard_losses[0][i].detach() * weights[0];
+                        for (Int shard=1; shard<shard_losses.size(); ++shard) {
+                            losses[i] = losses[i] + shard_losses[shard][i].detach().to(device_) * weights[shard];
+                        }
+                    }
+                    auto [ loss, ratio, policy_loss, value_loss, entropy_loss, approx_kl_div ] = losses;
+                    // Reading the divergence waits for the device, so it is checked every `kl_check_interval` batches.
+                    // The divergence is that of the whole batch, so that all the replicas stop together, as do the
+                    // seeds on their mean divergence.
+                    if (target_kl_ > 0 && (epoch * num_steps + step) % kl_check_interval_ == 0) {
+                        double approx_kl = approx_kl_div.item<double>();
+                        if (approx_kl > 1.5 * target_kl_) {
+                            std::cout << "Early stopping at epoch " << epoch << " due to reaching max kl: {approx_kl_div: " << approx_kl << "}"  << std::endl;
+                            continue_training = false;
+                            break;
+                        }
                     }
                     optimizer_->zero_grad();
-                    loss.backward();
-                    torch::nn::utils::clip_grad_norm_(policy_->parameters(), max_grad_norm_);
-                    optimizer_->step();
-                    ratio_list.push_back(ratio.mean().item<double>()); 
-                    policy_loss_list.push_back(policy_loss.item<double>()); 
-                    value_loss_list.push_back(value_loss.item<double>()); 
-                    entropy_loss_list.push_back(entropy_loss.item<double>()); 
-                    approx_kl_list.push_back(approx_kl_div);
-                    loss_list.push_back(loss.item<double>()); 
+                    for (auto& replica : replicas_) {
+                        replica->zero_grad();
+                    }
+                    // The loss of the seeds is the mean of their losses over their equal shares of the batch, whose
+                    // gradient, times the number of seeds, is the gradient of each seed's own loss for its members.
+                    for (Int shard=0; shard<shard_losses.size(); ++shard) {
+                        grad_scaler_.Scale(shard_losses[shard][0] * (weights[shard] * num_seeds_)).backward();
+                    }
+                    ReduceGradients();
+                    grad_scaler_.Unscale(optimizer_.get());
+                    if (num_seeds_ > 1)
+                        ClipGradNormPerMember(policy_->parameters(), num_seeds_, max_grad_norm_);
+                    else
+                        torch::nn::utils::clip_grad_norm_(policy_->parameters(), max_grad_norm_);
+                    grad_scaler_.Step(optimizer_.get());
+                    grad_scaler_.Update();
+                    telemetry_.AddGradientSteps(1);
+                    SyncReplicas();
+                    metrics_.Add("ratio", ratio);
+                    metrics_.Add("policy_loss", policy_loss);
+                    metrics_.Add("value_loss", value_loss);
+                    metrics_.Add("entropy_loss", entropy_loss);
+                    metrics_.Add("approx_kl", approx_kl_div);
+                    metrics_.Add("loss", loss);
                 }
                 ++num_updates_;
                 if (!continue_training)
@@ -183,24 +225,7 @@ namespace rlop {
                 auto it = log_items_.find("num_updates");
                 if (it != log_items_.end()) 
                     it->second = torch::tensor(num_updates_);
-                it = log_items_.find("ratio");
-                if (it != log_items_.end()) 
-                    it->second = torch::tensor(ratio_list).mean();
-                it = log_items_.find("policy_loss");
-                if (it != log_items_.end()) 
-                    it->second  = torch::tensor(policy_loss_list).mean();
-                it = log_items_.find("value_loss");
-                if (it != log_items_.end()) 
-                    it->second  = torch::tensor(value_loss_list).mean();
-                it = log_items_.find("entropy_loss");
-                if (it != log_items_.end()) 
-                    it->second  = torch::tensor(entropy_loss_list).mean();
-                it = log_items_.find("loss");
-                if (it != log_items_.end()) 
-                    it->second  = torch::tensor(loss_list).mean();
-                it = log_items_.find("approx_kl");
-                if (it != log_items_.end()) 
-                    it->second  = torch::tensor(approx_kl_list).mean();
+                metrics_.WriteTo(&log_items_, { "ratio", "policy_loss", "value_loss", "entropy_loss", "loss", "approx_kl" });
                 it = log_items_.find("variance");
                 if (it != log_items_.end()) 
                     it->second  = torch_utils::ExplainedVariance(rollout_buffer_->values().flatten(), rollout_buffer_->returns().flatten());
@@ -210,6 +235,11 @@ namespace rlop {
             }
         }
 
+        virtual void ResetCudaGraphs() override {
+            if (policy_ != nullptr)
+                policy_->ResetCudaGraphs();
+        }
+
         virtual void LoadArchive(torch::serialize::InputArchive* archive, const std::unordered_set<std::string>& names) override {
             if (names.count("all") || names.count("actor_critic_net")) {
                 torch::serialize::InputArchive net_archive;
@@ -296,11 +326,184 @@ namespace rlop {
             return policy_;
         }
 
+        virtual std::shared_ptr<RLPolicy> GetPolicy() const override {
+            return policy_;
+        }
+
         std::shared_ptr<torch::optim::Optimizer> optimizer() const {
             return optimizer_;
         }
 
+        Int kl_check_interval() const {
+            return kl_check_interval_;
+        }
+
+        const std::vector<torch::Device>& data_parallel_devices() const {
+            return data_parallel_devices_;
+        }
+
+        // Sets the devices, besides the device of the algorithm, over which the batches of the training are split.
+        // Each holds a replica of the policy computing the gradients of its shard, which are summed on the device of
+        // the algorithm before the step of the optimizer, after which the parameters are copied back to the replicas.
+        // Effective from the next Reset().
+        void set_data_parallel_devices(const std::vector<torch::Device>& devices) {
+            data_parallel_devices_ = devices;
+        }
+
+        // Sets the number of batches between two checks of the KL divergence against `target_kl`, each of which
+        // waits for the device.
+        void set_kl_check_interval(Int kl_check_interval) {
+            kl_check_interval_ = std::max(kl_check_interval, Int(1));
+        }
+
     protected:
+        // Collects the steps of the rollouts with the environments in the groups of StepAsync(), so that the policy
+        // runs on the next observations of a group while the groups after it step, and the environments and the
+        // device work concurrently.
+        void CollectPipelinedSteps(MetricAccumulator* rollout_metrics) {
+            Int num_groups = NumEnvGroups();
+            std::vector<Int> bounds(num_groups + 1);
+            for (Int group=0; group<=num_groups; ++group) {
+                bounds[group] = NumEnvs() * group / num_groups;
+            }
+            Int num_steps = rollout_buffer_->buffer_size() - rollout_buffer_->Size();
+            std::vector<std::array<torch::Tensor, 3>> forwards(num_groups);
+            for (Int group=0; group<num_groups; ++group) {
+                {
+                    Telemetry::Scope scope(&telemetry_, Telemetry::kInference);
+                    forwards[group] = policy_->RunForward(last_observations_.slice(0, bounds[group], bounds[group + 1]));
+                }
+                Telemetry::Scope scope(&telemetry_, Telemetry::kEnv);
+                StepAsync(group, forwards[group][0]);
+            }
+            for (Int step=0; step<num_steps; ++step) {
+                std::vector<std::array<torch::Tensor, 3>> next_forwards(num_groups);
+                std::array<std::vector<torch::Tensor>, 5> group_results;
+                for (Int group=0; group<num_groups; ++group) {
+                    std::array<torch::Tensor, 5> results;
+                    {
+                        Telemetry::Scope scope(&telemetry_, Telemetry::kEnv);
+                        results = StepWait(group);
+                    }
+                    for (Int i=0; i<5; ++i) {
+                        group_results[i].push_back(results[i]);
+                    }
+                    if (step + 1 < num_steps) {
+                        {
+                            Telemetry::Scope scope(&telemetry_, Telemetry::kInference);
+                            next_forwards[group] = policy_->RunForward(results[0]);
+                        }
+                        Telemetry::Scope scope(&telemetry_, Telemetry::kEnv);
+                        StepAsync(group, next_forwards[group][0]);
+                    }
+                }
+                std::array<torch::Tensor, 3> forward;
+                for (Int i=0; i<3; ++i) {
+                    std::vector<torch::Tensor> tensors;
+                    for (const auto& group_forward : forwards)
+                        tensors.push_back(group_forward[i]);
+                    forward[i] = torch::cat(tensors);
+                }
+                std::array<torch::Tensor, 5> results;
+                for (Int i=0; i<5; ++i) {
+                    bool defined = std::all_of(group_results[i].begin(), group_results[i].end(), [](const torch::Tensor& tensor) { return tensor.defined(); });
+                    if (defined)
+                        results[i] = torch::cat(group_results[i]);
+                }
+                AddRolloutStep(forward[0], forward[1], forward[2], results, rollout_metrics);
+                forwards = std::move(next_forwards);
+            }
+        }
+
+        // Computes the losses of a batch with a policy.
+        //
+        // Returns:
+        //   std::array<torch::Tensor, 6>: The loss, the mean ratio of the probabilities of the actions, the policy
+        //                                 loss, the value loss, the entropy loss and the approximate KL divergence.
+        std::array<torch::Tensor, 6> ComputeLosses(PPOPolicy* policy, const RolloutBuffer::Batch& batch) {
+            auto [ values, log_prob, entropy ] = policy->EvaluateActions(batch.observations, batch.actions);
+            torch::Tensor ratio = torch::exp(log_prob - batch.log_prob);
+            torch::Tensor policy_loss_1 = batch.advantages * ratio;
+            torch::Tensor policy_loss_2 = batch.advantages * torch::clamp(ratio, 1 - clip_range_, 1 + clip_range_);
+            torch::Tensor policy_loss = -torch::min(policy_loss_1, policy_loss_2).mean();
+            torch::Tensor pred_value;
+            if (clip_range_vf_ > 0)
+                pred_value = batch.values + torch::clamp(values - batch.values, -clip_range_vf_, clip_range_vf_);
+            else
+                pred_value = values; 
+            torch::Tensor value_loss = torch::mse_loss(batch.returns, pred_value);
+            torch::Tensor entropy_loss;
+            if (entropy)
+                entropy_loss = -torch::mean(*entropy);
+            else
+                entropy_loss = -torch::mean(-log_prob);
+            torch::Tensor loss = policy_loss + vf_coef_ * value_loss + ent_coef_ * entropy_loss;
+            torch::Tensor approx_kl_div;
+            {
+                torch::NoGradGuard no_grad;
+                approx_kl_div = torch_utils::ComputeApproxKL(log_prob, batch.log_prob);
+            }
+            return { loss, ratio.detach().mean(), policy_loss, value_loss, entropy_loss, approx_kl_div };
+        }
+
+        // Adds the gradients of the replicas to those of the policy.
+        void ReduceGradients() {
+            if (replicas_.empty())
+                return;
+            torch::NoGradGuard no_grad;
+            auto params = policy_->parameters();
+            for (const auto& replica : replicas_) {
+                auto replica_params = replica->parameters();
+                for (Int i=0; i<params.size(); ++i) {
+                    const torch::Tensor& grad = replica_params[i].grad();
+                    if (!grad.defined())
+                        continue;
+                    if (params[i].grad().defined())
+                        params[i].mutable_grad().add_(grad.to(device_));
+                    else
+                        params[i].mutable_grad() = grad.to(device_);
+                }
+            }
+        }
+
+        // Copies the parameters of the policy to the replicas.
+        void SyncReplicas() {
+            for (const auto& replica : replicas_) {
+                torch_utils::CopyStateDict(*policy_, replica.get());
+            }
+        }
+
+        // Adds a step of the environments to the rollout buffer, the rewards of the truncated episodes bootstrapped
+        // with the values of their final observations.
+        void AddRolloutStep(
+            const torch::Tensor& actions, 
+            const torch::Tensor& values, 
+            const torch::Tensor& log_probs, 
+            const std::array<torch::Tensor, 5>& step_results, 
+            MetricAccumulator* rollout_metrics
+        ) {
+            auto [next_observations, rewards, terminations, truncations, terminal_observations] = step_results;
+            rewards = rewards.to(torch::kFloat32);
+            time_steps_ += rollout_buffer_->num_envs();
+            torch::Tensor dones = torch::logical_or(terminations, truncations);
+            if (terminal_observations.defined()) {
+                Telemetry::Scope scope(&telemetry_, Telemetry::kInference);
+                // A forward over the terminal observations of all the environments, masked, does not wait for
+                // the device to know which ones terminated.
+                torch::Tensor terminal_values = policy_->PredictValues(terminal_observations.to(device_)).reshape({-1});
+                torch::Tensor bootstrap = terminations.to(device_, torch::kBool);
+                terminal_values = torch::where(bootstrap, terminal_values, torch::zeros_like(terminal_values));
+                rewards = rewards + gamma_ * terminal_values.to(rewards.device());
+            }
+            rollout_metrics->Add("mean_reward", rewards);
+            {
+                Telemetry::Scope scope(&telemetry_, Telemetry::kBuffer);
+                rollout_buffer_->Add(last_observations_, actions, values, log_probs, rewards, last_episode_starts_);
+            }
+            last_observations_ = next_observations;
+            last_episode_starts_ = dones;
+        }
+
         Int batch_size_;
         Int num_epochs_;
         double lr_;
@@ -313,8 +516,11 @@ namespace rlop {
         double gae_lambda_;
         double max_grad_norm_;
         double target_kl_;
+        Int kl_check_interval_ = 1;
         std::shared_ptr<RolloutBuffer> rollout_buffer_ = nullptr;
         std::shared_ptr<PPOPolicy> policy_ = nullptr;
+        std::vector<torch::Device> data_parallel_devices_;
+        std::vector<std::shared_ptr<PPOPolicy>> replicas_; // The replicas of the policy on the data parallel devices.
         std::shared_ptr<torch::optim::Optimizer> optimizer_ = nullptr;
         torch::Tensor last_observations_;
         torch::Tensor last_episode_starts_;
@@ -0,0 +1,128 @@
+#pragma once
+#include <mutex>
+#include "policy.h"
+
+namespace rlop {
+    // A linear layer whose forwards in evaluation mode on the CPU run on int8 weights, dynamically quantized as by
+    // quantize_dynamic() of PyTorch: the weights are quantized per tensor, the activations per batch by the kernels of
+    // FBGEMM, which accumulate in int32 and return float32. It has the parameters of a torch::nn::Linear, under the
+    // same names and initialized the same, so that the weights of a float32 network are copied into it by
+    // CopyStateDict(), and it re-quantizes its weights at the first forward after they change, such as after a sync of
+    // the weights. In training mode, on other devices, or on a CPU which FBGEMM does not support, it is a float32
+    // linear layer.
+    class QuantizedLinear : public torch::nn::Module {
+    public:
+        QuantizedLinear(Int in_features, Int out_features, bool bias = true) :
+            in_features_(in_features),
+            out_features_(out_features)
+        {
+            weight_ = register_parameter("weight", torch::empty({ out_features, in_features }));
+            torch::nn::init::kaiming_uniform_(weight_, std::sqrt(5.0));
+            double bound = 1.0 / std::sqrt((double)in_features);
+            if (bias)
+                bias_ = register_parameter("bias", torch::empty({ out_features }).uniform_(-bound, bound));
+        }
+
+        virtual ~QuantizedLinear() = default;
+
+        torch::Tensor forward(const torch::Tensor& input) {
+            if (is_training() || !input.device().is_cpu() || input.scalar_type() != torch::kFloat32 || !supported_)
+                return torch::nn::functional::linear(input, weight_, bias_);
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!Quantize())
+                return torch::nn::functional::linear(input, weight_, bias_);
+            return torch::fbgemm_linear_int8_weight_fp32_activation(
+                input, quantized_weight_, packed_weight_, col_offsets_, scale_, zero_point_, quantized_bias_
+            );
+        }
+
+        // Returns whether the forwards run on int8 weights, false once the kernels of FBGEMM turn out to be missing
+        // from libtorch or unsupported by the CPU.
+        bool supported() const {
+            return supported_;
+        }
+
+        Int in_features() const {
+            return in_features_;
+        }
+
+        Int out_features() const {
+            return out_features_;
+        }
+
+        const torch::Tensor& weight() const {
+            return weight_;
+        }
+
+        const torch::Tensor& bias() const {
+            return bias_;
+        }
+
+    protected:
+        // Quantizes and packs the weights, unless they are the ones of the previous forward, and returns false if
+        // FBGEMM is not supported.
+        bool Quantize() {
+            if (packed_weight_.defined() && weight_.data_ptr() == data_ptr_ && weight_._version() == version_)
+                return true;
+            torch::NoGradGuard no_grad;
+            try {
+                auto [ quantized_weight, col_offsets, scale, zero_point ] = torch::fbgemm_linear_quantize_weight(weight_.contiguous());
+                quantized_weight_ = quantized_weight;
+                col_offsets_ = col_offsets;
+                scale_ = scale;
+                zero_point_ = zero_point;
+                packed_weight_ = torch::fbgemm_pack_quantized_matrix(quantized_weight_);
+            }
+            catch (const c10::Error&) {
+                supported_ = false;
+                packed_weight_ = torch::Tensor();
+                return false;
+            }
+            // The kernel requires a bias.
+            quantized_bias_ = bias_.defined() ? bias_.detach().contiguous() : torch::zeros({ out_features_ });
+            data_ptr_ = weight_.data_ptr();
+            version_ = weight_._version();
+            return true;
+        }
+
+        Int in_features_;
+        Int out_features_;
+        torch::Tensor weight_;
+        torch::Tensor bias_;
+        bool supported_ = true;
+        std::mutex mutex_; // The mutex of the quantized weights, shared by the threads of the forwards.
+        torch::Tensor quantized_weight_;
+        torch::Tensor packed_weight_;
+        torch::Tensor col_offsets_;
+        torch::Tensor quantized_bias_;
+        double scale_ = 1.0;
+        int64_t zero_point_ = 0;
+        const void* data_ptr_ = nullptr; // The storage of the weights quantized.
+        int64_t version_ = 0; // The version of the weights quantized, which their in-place updates increment.
+    };
+
+    // Returns a linear layer for a torch::nn::Sequential or a torch::nn::AnyModule, quantized or float32, so that a
+    // network builds its float32 and its quantized versions from the same code.
+    inline torch::nn::AnyModule MakeLinear(Int in_features, Int out_features, bool quantized = false, bool bias = true) {
+        if (quantized)
+            return torch::nn::AnyModule(std::make_shared<QuantizedLinear>(in_features, out_features, bias));
+        return torch::nn::AnyModule(torch::nn::Linear(torch::nn::LinearOptions(in_features, out_features).bias(bias)));
+    }
+
+    // Makes the int8 copy of a trained policy for the actors and the evaluators on the CPU, while the learner keeps the
+    // float32 policy: `make_policy` makes a policy of the same structure whose linear layers are QuantizedLinear, such
+    // as built with MakeLinear(), which is reset on the CPU, in evaluation mode, with the weights of `policy`. The
+    // convolutions stay float32. At the syncs of the weights, the weights copied again with CopyWeights(), such as by
+    // InferenceBatcher::LoadWeights(), are re-quantized at the next forward.
+    template <typename TMakePolicy>
+    auto MakeQuantizedPolicy(const RLPolicy& policy, const TMakePolicy& make_policy) {
+        auto quantized_policy = make_policy();
+        if (quantized_policy == nullptr)
+            throw std::runtime_error("MakeQuantizedPolicy: requires a policy.");
+        quantized_policy->To(torch::kCPU);
+        quantized_policy->Reset();
+        quantized_policy->CopyWeights(policy);
+        quantized_policy->SetTrainingMode(false);
+        return quantized_policy;
+    }
+}
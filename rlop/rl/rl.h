@@ -1,10 +1,35 @@
 #pragma once
 #include "rlop/common/base_algorithm.h"
 #include "rlop/common/platform.h"
+#include "rlop/common/profiler.h"
 #include "rlop/common/torch_utils.h"
 #include "rlop/common/utils.h"
+#include "checkpoint_writer.h"
+#include "metrics.h"
+#include "mixed_precision.h"
+#include "policy.h"
+#include "quantization.h"
+#include "telemetry.h"
 
 namespace rlop {
+    class RL;
+
+    // A task of RL::Learn() run after the training of each iteration, before the monitoring, such as the evaluation
+    // of a BackgroundEvaluator, which may write log items of its own.
+    class LearnCallback {
+    public:
+        virtual ~LearnCallback() = default;
+
+        // Registers the log items of the callback, at the Reset() of the algorithm.
+        virtual void RegisterLogItems(std::unordered_map<std::string, torch::Tensor>* log_items) {}
+
+        // Called after the training of an iteration, with the log items of the algorithm.
+        virtual void OnLearnStep(RL* rl, std::unordered_map<std::string, torch::Tensor>* log_items) = 0;
+
+        // Called at the end of Learn().
+        virtual void OnLearnEnd(RL* rl, std::unordered_map<std::string, torch::Tensor>* log_items) {}
+    };
+
     // The RL class is as an abstract base class for reinforcement learning algorithms, providing common interfaces
     // for training, managing environments, and performing evaluations.
     class RL : public BaseAlgorithm {
@@ -45,6 +70,24 @@ namespace rlop {
         //     - [4]: Final observations - The last observations of an episode.
         virtual std::array<torch::Tensor, 5> Step(const torch::Tensor& actions) = 0;
 
+        // Returns the number of groups of the environments stepped asynchronously with StepAsync() and StepWait(),
+        // the contiguous ranges [NumEnvs() * g / n, NumEnvs() * (g + 1) / n) of the environments. With more than one,
+        // the algorithms supporting it run the policy on the observations of a group while the others step.
+        virtual Int NumEnvGroups() const {
+            return 1;
+        }
+
+        // Starts a step of the environments of a group with their actions, which StepWait() completes. By default,
+        // the step runs in StepWait() with Step(), for a single group.
+        virtual void StepAsync(Int group, const torch::Tensor& actions) {
+            pending_actions_ = actions;
+        }
+
+        // Waits for the step of the environments of a group started by StepAsync(), and returns its results as Step().
+        virtual std::array<torch::Tensor, 5> StepWait(Int group) {
+            return Step(pending_actions_);
+        }
+
         // Pure virtual function to collect rollouts from the environment. 
         virtual void CollectRollouts() = 0;
 
@@ -73,6 +116,11 @@ namespace rlop {
             num_iters_ = 0;
             time_steps_ = 0;
             num_updates_ = 0;
+            if (cuda_graph_ && mixed_precision_ != torch::kFloat32)
+                throw std::runtime_error("RL: the CUDA graphs require the float32 precision.");
+            grad_scaler_ = GradScaler(mixed_precision_ == torch::kFloat16);
+            telemetry_.Open(telemetry_path_, device_);
+            ResetCudaGraphs();
             RegisterLogItems();
             if (!output_path_.empty()) {
                 std::ofstream out(output_path_ + "_log.txt");
@@ -84,9 +132,74 @@ namespace rlop {
             }
         }
 
+        // Sets the precision of the forward passes of the training, float32 by default, or float16 or bfloat16 to run
+        // them in mixed precision with the autocast of libtorch, scaling the losses for float16. Effective from the
+        // next Reset().
+        void set_mixed_precision(torch::Dtype dtype) {
+            if (dtype != torch::kFloat32 && dtype != torch::kFloat16 && dtype != torch::kBFloat16)
+                throw std::runtime_error("RL: the mixed precision must be float32, float16 or bfloat16.");
+            mixed_precision_ = dtype;
+        }
+
+        torch::Dtype mixed_precision() const {
+            return mixed_precision_;
+        }
+
+        bool cuda_graph() const {
+            return cuda_graph_;
+        }
+
+        // Sets whether the inference of the policies and, for the algorithms supporting it, the gradient steps are
+        // captured into CUDA graphs on a CUDA device and replayed, which removes the launch overhead of the small
+        // networks. Effective from the next Reset().
+        void set_cuda_graph(bool cuda_graph) {
+            cuda_graph_ = cuda_graph;
+        }
+
+        Int num_seeds() const {
+            return num_seeds_;
+        }
+
+        // Sets the number of independent seeds, or configurations, trained together in one process, 1 by default.
+        // The environments are split into as many groups of consecutive environments, one per seed, whose
+        // observations go through a policy of stacked members, such as the EnsembleMLP of the seeds, one group after
+        // the other. The batches of the training hold as many samples of each seed, group after group, and the
+        // losses and the gradients of the seeds are those of their own trainings. Effective from the next Reset().
+        void set_num_seeds(Int num_seeds) {
+            if (num_seeds < 1)
+                throw std::runtime_error("RL: the number of seeds must be positive.");
+            num_seeds_ = num_seeds;
+        }
+
+        // Discards the CUDA graphs, which read the parameters from their addresses at the capture, after the
+        // parameters are reallocated, as by Reset() and Load().
+        virtual void ResetCudaGraphs() {}
+
         // Registers loggable items. This function should be overridden to include algorithm-specific metrics.
         virtual void RegisterLogItems() {
             log_items_["num_updates"] = torch::Tensor();
+            for (const auto& callback : callbacks_) {
+                callback->RegisterLogItems(&log_items_);
+            }
+        }
+
+        // Adds a task run by Learn() after the training of each iteration. Its log items are registered from the
+        // next Reset().
+        void add_callback(const std::shared_ptr<LearnCallback>& callback) {
+            callbacks_.push_back(callback);
+        }
+
+        const std::vector<std::shared_ptr<LearnCallback>>& callbacks() const {
+            return callbacks_;
+        }
+
+        // Returns the policy acting in the environments, to be overridden by the algorithms, or nullptr.
+        virtual std::shared_ptr<RLPolicy> GetPolicy() const {
+            return nullptr;
+        }
+
+        Int time_steps() const {
+            return time_steps_;
         }
 
         // Checks if the algorithm should continue.
@@ -96,18 +209,30 @@ namespace rlop {
         
         // Main learning loop. Runs the algorithm for a specified number of time steps, monitoring and checkpointing as configured.
         virtual void Learn(Int max_time_steps, Int monitor_interval = 0, Int checkpoint_interval = 0) {
+            RLOP_PROFILE_SCOPE("RL::Learn");
             time_steps_ = 0;
             max_time_steps_ = max_time_steps;
             monitor_interval_ = monitor_interval;
             checkpoint_interval_ = checkpoint_interval;
+            telemetry_.Restart(time_steps_);
             while (Proceed()) {
                 CollectRollouts();
-                Train();
-                Monitor();
-                Checkpoint();
-                OnLearnStep();
+                {
+                    Telemetry::Scope scope(&telemetry_, Telemetry::kTrain);
+                    Train();
+                }
+                {
+                    Telemetry::Scope scope(&telemetry_, Telemetry::kLog);
+                    RunCallbacks();
+                    Monitor();
+                    Checkpoint();
+                    OnLearnStep();
+                }
                 ++num_iters_;
+                telemetry_.EndIteration(time_steps_);
             }
+            checkpoint_writer_.Wait();
+            EndCallbacks();
         }
 
         // Monitors the learning progress and logs metrics at specified intervals.
@@ -123,8 +248,33 @@ namespace rlop {
         virtual void Checkpoint() {
             if (checkpoint_interval_ <= 0 || num_iters_ % checkpoint_interval_ != 0)
                 return; 
-            if (!output_path_.empty())
-                Save(output_path_ + "_" + rlop::GetDatetime() + "_" + std::to_string(time_steps_) + ".pth");
+            if (output_path_.empty())
+                return;
+            std::string path = output_path_ + "_" + rlop::GetDatetime() + "_" + std::to_string(time_steps_) + ".pth";
+            if (async_checkpoint_)
+                SaveAsync(path);
+            else
+                Save(path);
+        }
+
+        const std::string& telemetry_path() const {
+            return telemetry_path_;
+        }
+
+        // Sets the file the telemetry of Learn() is written to at each iteration, see Telemetry, none if empty.
+        // Effective from the next Reset().
+        void set_telemetry_path(const std::string& telemetry_path) {
+            telemetry_path_ = telemetry_path;
+        }
+
+        bool async_checkpoint() const {
+            return async_checkpoint_;
+        }
+
+        // Sets whether Checkpoint() writes the checkpoints with SaveAsync(), the training going on while they are
+        // written to the disk.
+        void set_async_checkpoint(bool async_checkpoint) {
+            async_checkpoint_ = async_checkpoint;
         }
 
         virtual void OnLearnStep() {}
@@ -179,6 +329,7 @@ namespace rlop {
             torch::serialize::InputArchive archive;
             archive.load_from(path);
             LoadArchive(&archive, names); 
+            ResetCudaGraphs();
         }
         
         // Saves model and algorithm state to a file.
@@ -188,6 +339,15 @@ namespace rlop {
             archive.save_to(path);
         }
 
+        // Saves model and algorithm state to a file in the background: the archive is serialized into memory, which
+        // snapshots it, and written to the file on the thread of the checkpoint writer, atomically. The previous
+        // write is waited for first, and the last one by the end of Learn().
+        virtual void SaveAsync(const std::string& path, const std::unordered_set<std::string>& names = {"all"}) {
+            torch::serialize::OutputArchive archive;
+            SaveArchive(&archive, names);
+            checkpoint_writer_.Write(&archive, path);
+        }
+
         // Load algorithm-specific components from an archive. To be implemented by derived classes.
         virtual void LoadArchive(torch::serialize::InputArchive* archive, const std::unordered_set<std::string>& names) {}
 
@@ -195,6 +355,23 @@ namespace rlop {
         virtual void SaveArchive(torch::serialize::OutputArchive* archive, const std::unordered_set<std::string>& names) {}
 
     protected:
+        void RunCallbacks() {
+            for (const auto& callback : callbacks_) {
+                callback->OnLearnStep(this, &log_items_);
+            }
+        }
+
+        void EndCallbacks() {
+            for (const auto& callback : callbacks_) {
+                callback->OnLearnEnd(this, &log_items_);
+            }
+        }
+
+        // Returns a guard running the forward passes of its scope in the mixed precision.
+        AutocastGuard Autocast() const {
+            return AutocastGuard(device_, mixed_precision_);
+        }
+
         Int num_iters_ = 0;
         Int time_steps_ = 0;
         Int max_time_steps_ = 0;
@@ -203,6 +380,17 @@ namespace rlop {
         Int checkpoint_interval_ = 0;
         std::string output_path_;
         std::unordered_map<std::string, torch::Tensor> log_items_;
+        MetricAccumulator metrics_; // The metrics of the steps of a training, for the log items.
+        torch::Dtype mixed_precision_ = torch::kFloat32;
+        bool cuda_graph_ = false;
+        Int num_seeds_ = 1;
+        GradScaler grad_scaler_;
+        bool async_checkpoint_ = false;
+        std::string telemetry_path_;
+        Telemetry telemetry_;
+        CheckpointWriter checkpoint_writer_;
+        std::vector<std::shared_ptr<LearnCallback>> callbacks_;
+        torch::Tensor pending_actions_; // The actions of the step started by the default StepAsync().
         torch::Device device_;
     };
 }
\ No newline at end of file
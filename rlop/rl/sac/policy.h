@@ -1,4 +1,5 @@
 #pragma once
+#include "rlop/rl/ensemble.h"
 #include "rlop/rl/policy.h"
 
 namespace rlop {
@@ -18,6 +19,54 @@ namespace rlop {
         //   std::vector<torch::Tensor>: A vector of tensors representing the estimated values of the given actions in the given states.
         //   Depending on the SAC implementation, this might include Q-values from multiple critic networks.
         virtual std::vector<torch::Tensor> PredictQValues(const torch::Tensor& observation, const torch::Tensor& action) = 0;
+
+        // Returns the values of the critics stacked into a tensor of shape {n, number of critics}, which SAC works
+        // on. By default, the outputs of PredictQValues() are concatenated.
+        virtual torch::Tensor PredictStackedQValues(const torch::Tensor& observation, const torch::Tensor& action) {
+            return torch::cat(PredictQValues(observation, action), 1);
+        }
+    };
+
+    // Critics of the same multilayer perceptron, of ReLU activations, on the concatenation of the observations and
+    // the actions, whose layers are EnsembleLinear layers: the critics are evaluated together in one batched matrix
+    // product per layer, instead of a forward per critic.
+    class EnsembleQNet : public ContinuousQNet {
+    public:
+        // Parameters:
+        //   num_critics: The number of critics.
+        //   input_dim: The size of an observation and an action concatenated.
+        //   hidden_sizes: The sizes of the hidden layers.
+        EnsembleQNet(Int num_critics, Int input_dim, const std::vector<Int>& hidden_sizes) : num_critics_(num_critics) {
+            Int in_features = input_dim;
+            for (Int i=0; i<=hidden_sizes.size(); ++i) {
+                Int out_features = i < hidden_sizes.size() ? hidden_sizes[i] : 1;
+                layers_.push_back(register_module("layer_" + std::to_string(i), std::make_shared<EnsembleLinear>(num_critics, in_features, out_features)));
+                in_features = out_features;
+            }
+        }
+
+        virtual std::vector<torch::Tensor> PredictQValues(const torch::Tensor& observation, const torch::Tensor& action) override {
+            return PredictStackedQValues(observation, action).split(1, 1);
+        }
+
+        virtual torch::Tensor PredictStackedQValues(const torch::Tensor& observation, const torch::Tensor& action) override {
+            torch::Tensor input = torch::cat({ observation, action }, 1);
+            torch::Tensor x = input.unsqueeze(0).expand({ num_critics_, input.size(0), input.size(1) });
+            for (Int i=0; i<layers_.size(); ++i) {
+                x = layers_[i]->forward(x);
+                if (i + 1 < layers_.size())
+                    x = torch::relu(x);
+            }
+            return x.squeeze(-1).transpose(0, 1);
+        }
+
+        Int num_critics() const {
+            return num_critics_;
+        }
+
+    protected:
+        Int num_critics_;
+        std::vector<std::shared_ptr<EnsembleLinear>> layers_;
     };
 
     class SACPolicy : public RLPolicy {
@@ -44,6 +93,7 @@ namespace rlop {
         virtual std::shared_ptr<ContinuousQNet> MakeCritic() const = 0;
 
         virtual void Reset() override {
+            ResetCudaGraphs();
             this->to(device_);
             critic_= MakeCritic();
             critic_->to(device_);
@@ -45,10 +45,14 @@ namespace rlop {
 
         virtual void Reset() override {
             OffPolicyRL::Reset();
+            if (batch_size_ % num_seeds_ != 0)
+                throw std::runtime_error("SAC: the batch size must be a multiple of the number of seeds.");
+            replay_buffer_->set_num_groups(num_seeds_);
             actor_optimizer_ = MakeActorOptimizer();
             critic_optimizer_ = MakeCriticOptimizer();
             if (auto_ent_coef_) {
-                log_ent_coef_ = torch::log(torch::ones(1).to(device_) * ent_coef_).set_requires_grad(true);
+                // Each seed adjusts its own entropy coefficient.
+                log_ent_coef_ = torch::log(torch::ones(num_seeds_).to(device_) * ent_coef_).set_requires_grad(true);
                 ent_coef_optimizer_ = MakeEntropyOptimizer();
                 if (auto_target_entropy_) {
                     target_entropy_ = -1.0;
@@ -59,10 +63,7 @@ namespace rlop {
             }
             else
                 ent_coef_tensor_ = torch::tensor(ent_coef_).to(device_);
-            parameters_ = torch_utils::GetParameters(*policy()->critic()).second;
-            target_parameters_ = torch_utils::GetParameters(*policy()->critic_target()).second;
-            buffers_ = torch_utils::GetBuffersByName(*policy()->critic(), { "running_" });
-            target_buffers_ = torch_utils::GetBuffersByName(*policy()->critic_target(), { "running_" });
+            FlattenParameters();
         }
 
         // Factory methods to create optimizers for the actor, critic, and entropy coefficient.
@@ -91,98 +92,127 @@ namespace rlop {
         }
 
         virtual void Train() override {
+            RLOP_PROFILE_SCOPE("SAC::Train");
             if (time_steps_ <= learning_starts_)
                 return;
             policy_->SetTrainingMode(true); 
-            std::vector<double> ent_coef_list;
-            std::vector<double> actor_loss_list;
-            std::vector<double> critic_loss_list;
-            std::vector<double> ent_coef_loss_list;
-            std::vector<double> reward_list;
-            ent_coef_list.reserve(gradient_steps_);
-            actor_loss_list.reserve(gradient_steps_);
-            critic_loss_list.reserve(gradient_steps_);
-            ent_coef_loss_list.reserve(gradient_steps_);
-            reward_list.reserve(gradient_steps_);
+            metrics_.Reset();
+            StartSampling(gradient_steps_, batch_size_);
             for (Int step=0; step<gradient_steps_; ++step) {
-                auto batch = replay_buffer_->Sample(batch_size_).To(device_);
-                auto [actions_pi, log_prob] = policy()->PredictLogProb(batch.observations);
-                torch::Tensor ent_coef;
-                torch::Tensor ent_coef_loss;
-                if (ent_coef_optimizer_ != nullptr && log_ent_coef_.defined()) {
-                    ent_coef = torch::exp(log_ent_coef_.detach());
-                    ent_coef_loss = -(log_ent_coef_ * (log_prob + target_entropy_).detach()).mean();
-                    ent_coef_loss_list.push_back(ent_coef_loss.item<double>()); 
-                }
-                else 
-                    ent_coef = ent_coef_tensor_;
-                ent_coef_list.push_back(ent_coef.item<double>());
-    
-                if (ent_coef_optimizer_ != nullptr && log_ent_coef_.defined()) {
-                    ent_coef_optimizer_->zero_grad();
-                    ent_coef_loss.backward();
-                    ent_coef_optimizer_->step(); 
-                } 
-                torch::Tensor target_q_values;
-                {
-                    torch::NoGradGuard no_grad;
-                    auto [next_actions, next_log_prob] = policy()->PredictLogProb(batch.next_observations);
-                    torch::Tensor next_q_values = torch::cat(policy()->critic_target()->PredictQValues(batch.next_observations, next_actions), 1);
-                    next_q_values = std::get<0>(torch::min(next_q_values, 1));
-                    next_q_values = next_q_values - ent_coef * next_log_prob;
-                    target_q_values = (batch.rewards + (1 - batch.dones) * gamma_ * next_q_values).reshape({-1, 1});
-                }
-                auto current_q_values = policy()->critic()->PredictQValues(batch.observations, batch.actions);
-                reward_list.push_back(batch.rewards.mean().item<double>());
+                auto batch = NextBatch();
+                // The actor loss is computed after the step of the critic, with the entropy coefficient of before
+                // the step of its own, so that each part is a function of the batch which a CUDA graph can capture.
+                RunCudaGraph(&critic_graph_, [&]() { critic_outputs_ = ComputeCriticGradients(batch); });
+                auto [ critic_loss, td_errors, ent_coef ] = critic_outputs_;
+                if (batch.weights.defined())
+                    UpdatePriorities(batch.indices, td_errors);
+                grad_scaler_.Step(critic_optimizer_.get());
 
-                torch::Tensor critic_loss = torch::tensor(0.0).to(device_);
-                for (const auto& current : current_q_values) {
-                    critic_loss += torch::mse_loss(current, target_q_values);
+                RunCudaGraph(&actor_graph_, [&]() { actor_outputs_ = ComputeActorGradients(batch, critic_outputs_[2]); });
+                auto [ actor_loss, ent_coef_loss ] = actor_outputs_;
+                if (ent_coef_loss.defined()) {
+                    grad_scaler_.Step(ent_coef_optimizer_.get());
+                    metrics_.Add("ent_coef_loss", ent_coef_loss);
                 }
-                critic_loss /= (double)current_q_values.size();
-                critic_loss_list.push_back(critic_loss.item<double>());
-
-                critic_optimizer_->zero_grad();
-                critic_loss.backward();
-                critic_optimizer_->step();
-
-                torch::Tensor q_values_pi = torch::cat(policy()->critic()->PredictQValues(batch.observations, actions_pi), 1);
-                torch::Tensor min_qf_pi = std::get<0>(torch::min(q_values_pi, 1));
-                torch::Tensor actor_loss = (ent_coef * log_prob - min_qf_pi).mean();
-                actor_loss_list.push_back(actor_loss.item<double>());
-
-                actor_optimizer_->zero_grad();
-                actor_loss.backward();
-                actor_optimizer_->step();
+                grad_scaler_.Step(actor_optimizer_.get());
+                // The three losses share a scale, which is updated once per step.
+                grad_scaler_.Update();
+                metrics_.Add("ent_coef", ent_coef);
+                metrics_.Add("mean_reward", batch.rewards);
+                metrics_.Add("critic_loss", critic_loss);
+                metrics_.Add("actor_loss", actor_loss);
                 
                 if (step % target_update_interval_ == 0) {
-                    auto [ params_names, params ] = torch_utils::GetParameters(*policy()->critic());
-                    auto [ target_params_names, target_params ] = torch_utils::GetParameters(*policy()->critic_target());
-                    torch_utils::PolyakUpdate(parameters_, target_parameters_, tau_);
+                    torch_utils::PolyakUpdate(parameters_, &target_parameters_, tau_);
                     torch_utils::PolyakUpdate(buffers_, target_buffers_, 1.0);
                 }
             }
             num_updates_ += gradient_steps_;
+            telemetry_.AddGradientSteps(gradient_steps_);
             if (!log_items_.empty()) {
                 auto it = log_items_.find("num_updates");
                 if (it != log_items_.end()) 
                     it->second = torch::tensor(num_updates_);
-                it = log_items_.find("ent_coef");
-                if (it != log_items_.end()) 
-                    it->second = torch::tensor(ent_coef_list).mean();
-                it = log_items_.find("actor_loss");
-                if (it != log_items_.end()) 
-                    it->second  = torch::tensor(actor_loss_list).mean();
-                it = log_items_.find("critic_loss");
-                if (it != log_items_.end()) 
-                    it->second  = torch::tensor(critic_loss_list).mean();
-                it = log_items_.find("ent_coef_loss");
-                if (it != log_items_.end()) 
-                    it->second  = torch::tensor(ent_coef_loss_list).mean();
-                it = log_items_.find("mean_reward");
-                if (it != log_items_.end()) 
-                    it->second  = torch::tensor(reward_list).mean();
+                metrics_.WriteTo(&log_items_, { "ent_coef", "actor_loss", "critic_loss", "ent_coef_loss", "mean_reward" });
+            }
+        }
+
+        // Computes the loss of the critic of a batch and its gradients, and returns the loss, the TD errors for a
+        // prioritized buffer, and the entropy coefficient.
+        virtual std::array<torch::Tensor, 3> ComputeCriticGradients(const ReplayBuffer::Batch& batch) {
+            AutocastGuard autocast = Autocast();
+            torch::Tensor ent_coef = log_ent_coef_.defined() ? torch::exp(log_ent_coef_.detach()) : ent_coef_tensor_;
+            torch::Tensor target_q_values;
+            {
+                torch::NoGradGuard no_grad;
+                auto [next_actions, next_log_prob] = policy()->PredictLogProb(batch.next_observations);
+                torch::Tensor next_q_values = policy()->critic_target()->PredictStackedQValues(batch.next_observations, next_actions);
+                next_q_values = std::get<0>(torch::min(next_q_values, 1));
+                next_q_values = next_q_values - PerSeed(ent_coef, next_log_prob.size(0)) * next_log_prob;
+                target_q_values = (batch.rewards + (1 - batch.dones) * gamma_ * next_q_values).reshape({-1, 1});
+            }
+            // The losses of the critics are computed together on their stacked values, of shape {n, number of
+            // critics}, against the targets broadcast over the critics: the mean over both dimensions is the mean of
+            // the losses of the critics.
+            torch::Tensor current_q_values = policy()->critic()->PredictStackedQValues(batch.observations, batch.actions);
+            torch::Tensor squared_errors = (current_q_values - target_q_values).pow(2);
+            torch::Tensor critic_loss;
+            torch::Tensor td_errors;
+            if (batch.weights.defined()) {
+                critic_loss = (batch.weights.reshape({-1, 1}) * squared_errors).mean();
+                td_errors = (current_q_values.detach() - target_q_values).abs().mean(1, true);
             }
+            else
+                critic_loss = squared_errors.mean();
+            autocast.Exit();
+            critic_optimizer_->zero_grad();
+            // The losses are means over the equal shares of the seeds in the batch, whose gradients, times the
+            // number of seeds, are those of the seeds' own losses.
+            grad_scaler_.Scale(critic_loss * num_seeds_).backward();
+            return { critic_loss, td_errors, ent_coef };
+        }
+
+        // Computes the losses of the actor and of the entropy coefficient of a batch and their gradients, and returns
+        // them, the latter undefined for a fixed coefficient.
+        virtual std::array<torch::Tensor, 2> ComputeActorGradients(const ReplayBuffer::Batch& batch, const torch::Tensor& ent_coef) {
+            AutocastGuard autocast = Autocast();
+            auto [actions_pi, log_prob] = policy()->PredictLogProb(batch.observations);
+            torch::Tensor ent_coef_loss;
+            if (ent_coef_optimizer_ != nullptr && log_ent_coef_.defined())
+                ent_coef_loss = -(PerSeed(log_ent_coef_, log_prob.size(0)) * (log_prob + target_entropy_).detach()).mean();
+            torch::Tensor q_values_pi = policy()->critic()->PredictStackedQValues(batch.observations, actions_pi);
+            torch::Tensor min_qf_pi = std::get<0>(torch::min(q_values_pi, 1));
+            torch::Tensor actor_loss = (PerSeed(ent_coef, log_prob.size(0)) * log_prob - min_qf_pi).mean();
+            autocast.Exit();
+            if (ent_coef_loss.defined()) {
+                ent_coef_optimizer_->zero_grad();
+                grad_scaler_.Scale(ent_coef_loss * num_seeds_).backward();
+            }
+            actor_optimizer_->zero_grad();
+            grad_scaler_.Scale(actor_loss * num_seeds_).backward();
+            return { actor_loss, ent_coef_loss };
+        }
+
+        // Repeats the values of the seeds, such as their entropy coefficients, over their equal shares of `n` samples,
+        // or returns a value shared by the seeds.
+        torch::Tensor PerSeed(const torch::Tensor& values, Int n) const {
+            if (num_seeds_ == 1 || values.dim() == 0)
+                return values;
+            return values.repeat_interleave(n / num_seeds_);
+        }
+
+        virtual void ResetCudaGraphs() override {
+            OffPolicyRL::ResetCudaGraphs();
+            critic_graph_ = nullptr;
+            actor_graph_ = nullptr;
+        }
+
+        // Gathers the parameters and the buffers updating the target network, the parameters flattened if set.
+        void FlattenParameters() {
+            parameters_ = torch_utils::FlatParameters(torch_utils::GetParameters(*policy()->critic()).second, flat_parameters_);
+            target_parameters_ = torch_utils::FlatParameters(torch_utils::GetParameters(*policy()->critic_target()).second, flat_parameters_);
+            buffers_ = torch_utils::GetBuffersByName(*policy()->critic(), { "running_" });
+            target_buffers_ = torch_utils::GetBuffersByName(*policy()->critic_target(), { "running_" });
         }
 
         virtual void LoadArchive(torch::serialize::InputArchive* archive, const std::unordered_set<std::string>& names) override {
@@ -201,6 +231,9 @@ namespace rlop {
                 if (archive->try_read("critic_target", critic_target_archive))
                     policy()->critic_target()->load(critic_target_archive);
             }
+            // A load replaces the storages of the parameters, which are flattened again.
+            if (flat_parameters_ && !(parameters_.valid() && target_parameters_.valid()))
+                FlattenParameters();
             if (names.count("all") || names.count("actor_optimizer")) {
                 torch::serialize::InputArchive actor_optimizer_archive;
                 if (archive->try_read("actor_optimizer", actor_optimizer_archive))
@@ -336,11 +369,15 @@ namespace rlop {
         std::shared_ptr<torch::optim::Optimizer> actor_optimizer_ = nullptr;
         std::shared_ptr<torch::optim::Optimizer> critic_optimizer_ = nullptr;
         std::shared_ptr<torch::optim::Optimizer> ent_coef_optimizer_ = nullptr;
-        std::vector<torch::Tensor> parameters_;
-        std::vector<torch::Tensor> target_parameters_;
+        torch_utils::FlatParameters parameters_;
+        torch_utils::FlatParameters target_parameters_;
         std::vector<torch::Tensor> buffers_;
         std::vector<torch::Tensor> target_buffers_;
         torch::Tensor log_ent_coef_;
         torch::Tensor ent_coef_tensor_;
+        std::unique_ptr<CudaGraph> critic_graph_ = nullptr; // The capture of ComputeCriticGradients().
+        std::unique_ptr<CudaGraph> actor_graph_ = nullptr; // The capture of ComputeActorGradients().
+        std::array<torch::Tensor, 3> critic_outputs_;
+        std::array<torch::Tensor, 2> actor_outputs_;
     };
 }
\ No newline at end of file
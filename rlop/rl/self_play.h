@@ -0,0 +1,523 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <thread>
+#include "rlop/common/random.h"
+#include "rlop/mcts/batched_puct.h"
+#include "inference_batcher.h"
+
+namespace rlop {
+    // A game of two players alternating moves, played against itself by SelfPlay.
+    class SelfPlayGame {
+    public:
+        virtual ~SelfPlayGame() = default;
+
+        // Resets the game to its initial state.
+        virtual void Reset() = 0;
+
+        // Returns a copy of the game.
+        virtual std::unique_ptr<SelfPlayGame> Clone() const = 0;
+
+        // Copies the state of another game of the same type, without allocating when possible.
+        virtual void CopyFrom(const SelfPlayGame& other) = 0;
+
+        virtual Int NumActions() const = 0;
+
+        virtual bool IsLegal(Int action) const = 0;
+
+        // Plays a legal action, and returns whether the game goes on.
+        virtual bool Step(Int action) = 0;
+
+        virtual bool IsOver() const = 0;
+
+        // Returns the outcome of an ended game seen by the player who made the last move: 1 for a win, -1 for a loss
+        // and 0 for a draw.
+        virtual double Result() const = 0;
+
+        // Returns the observation of the current state seen by the player to move, on the CPU.
+        virtual torch::Tensor Observe() const = 0;
+    };
+
+    // A network predicting from the observations of the player to move the logits of the actions and the value of the
+    // state, in [-1, 1], as in AlphaZero.
+    class PolicyValueNet : public RLPolicy {
+    public:
+        // Returns the logits of shape {batch_size, num_actions} and the values of shape {batch_size}.
+        virtual std::array<torch::Tensor, 2> PredictPolicyValues(const torch::Tensor& observations) = 0;
+
+        virtual torch::Tensor PredictActions(const torch::Tensor& observations, bool deterministic = false) override {
+            torch::Tensor logits = PredictPolicyValues(observations)[0];
+            if (deterministic)
+                return logits.argmax(1);
+            return torch::multinomial(torch::softmax(logits, 1), 1).squeeze(1);
+        }
+    };
+
+    // A BatchedPUCT searching the moves of a SelfPlayGame, whose leaves are evaluated by a PolicyValueNet served by an
+    // InferenceBatcher, so that the searches of concurrent games share its forwards. The values are negated at each
+    // level of the tree, as the players alternate, and illegal moves are never selected. The priors of the root can be
+    // mixed with a Dirichlet noise, which diversifies the games of self-play.
+    class SelfPlaySearch : public BatchedPUCT {
+    public:
+        // Parameters:
+        //   batcher: The batcher of the network, whose forward returns the logits and the value of each observation
+        //            as one row.
+        //   batch_size: The number of leaves of a batch of the search.
+        SelfPlaySearch(InferenceBatcher* batcher, Int batch_size = 8, double coef = 1.5, double virtual_loss = 1) :
+            BatchedPUCT(batch_size, coef, virtual_loss),
+            batcher_(batcher),
+            slots_(batch_size)
+        {}
+
+        virtual ~SelfPlaySearch() = default;
+
+        // Searches the moves of a game with `num_simulations` leaves after the evaluation of the root, which takes the
+        // first batch.
+        void Search(const SelfPlayGame& game, Int num_simulations) {
+            if (root_game_ == nullptr)
+                root_game_ = game.Clone();
+            else
+                root_game_->CopyFrom(game);
+            Reset();
+            BatchedPUCT::Search(std::max(num_simulations, Int(1)) + batch_size());
+        }
+
+        // Returns the visit counts of the children of the root, normalized.
+        std::vector<float> VisitDistribution() const {
+            std::vector<float> distribution(root_game_->NumActions(), 0);
+            double total = 0;
+            for (Int i=0; i<root_->children.size(); ++i) {
+                distribution[i] = root_->children[i]->num_visits;
+                total += distribution[i];
+            }
+            if (total > 0) {
+                for (auto& p : distribution) {
+                    p /= total;
+                }
+            }
+            return distribution;
+        }
+
+        Int NumChildStates(Int slot_i) const override {
+            return root_game_->NumActions();
+        }
+
+        void RevertState(Int slot_i) override {
+            if (slots_[slot_i] == nullptr)
+                slots_[slot_i] = root_game_->Clone();
+            else
+                slots_[slot_i]->CopyFrom(*root_game_);
+        }
+
+        bool Step(Int slot_i, Int child_i) override {
+            return slots_[slot_i]->Step(child_i);
+        }
+
+        double Reward(Int slot_i) override {
+            return slots_[slot_i]->Result();
+        }
+
+        // Evaluates the leaves through the batcher: their priors are the softmax of the logits over the legal moves,
+        // and their values, predicted for the player to move, are negated for the player who moved into them.
+        void Evaluate(const std::vector<Int>& slot_indices, std::vector<std::vector<double>>& priors, std::vector<double>& values) override {
+            futures_.clear();
+            for (Int slot_i : slot_indices) {
+                futures_.push_back(batcher_->Submit(slots_[slot_i]->Observe()));
+            }
+            for (Int j=0; j<slot_indices.size(); ++j) {
+                const SelfPlayGame& game = *slots_[slot_indices[j]];
+                torch::Tensor output = futures_[j].get().to(torch::kCPU, torch::kFloat64).contiguous();
+                const double* data = output.data_ptr<double>();
+                Int num_actions = game.NumActions();
+                auto& prior = priors[j];
+                prior.assign(num_actions, 0);
+                double max_logit = std::numeric_limits<double>::lowest();
+                for (Int i=0; i<num_actions; ++i) {
+                    if (game.IsLegal(i))
+                        max_logit = std::max(max_logit, data[i]);
+                }
+                double total = 0;
+                for (Int i=0; i<num_actions; ++i) {
+                    if (game.IsLegal(i)) {
+                        prior[i] = std::exp(data[i] - max_logit);
+                        total += prior[i];
+                    }
+                }
+                for (auto& p : prior) {
+                    p /= total;
+                }
+                values[j] = -data[num_actions];
+            }
+        }
+
+        // Expands a leaf, and mixes the priors of the root with a Dirichlet noise over the legal moves.
+        void Expand(Int slot_i, const std::vector<double>& priors) override {
+            BatchedPUCT::Expand(slot_i, priors);
+            Node* leaf = paths_[slot_i].back();
+            if (leaf != root_ || noise_fraction_ <= 0 || rand_ == nullptr)
+                return;
+            std::gamma_distribution<double> gamma(dirichlet_alpha_, 1.0);
+            std::vector<double> noise(leaf->children.size(), 0);
+            double total = 0;
+            for (Int i=0; i<noise.size(); ++i) {
+                if (root_game_->IsLegal(i)) {
+                    noise[i] = gamma(rand_->generator());
+                    total += noise[i];
+                }
+            }
+            if (!(total > 0))
+                return;
+            for (Int i=0; i<noise.size(); ++i) {
+                leaf->children[i]->prior = (1 - noise_fraction_) * leaf->children[i]->prior + noise_fraction_ * noise[i] / total;
+            }
+        }
+
+        // Backpropagates the value of a leaf, seen by the player who moved into it, negating it at each level up.
+        void BackPropagate(Int slot_i, double value) override {
+            while (paths_[slot_i].size() > 1) {
+                --paths_[slot_i].back()->num_virtual_losses;
+                UpdateNode(slot_i, value);
+                paths_[slot_i].pop_back();
+                value = -value;
+            }
+            UpdateNode(slot_i, value);
+        }
+
+        // Never selects the illegal moves.
+        double TreePolicy(Int slot_i, Int child_i) override {
+            if (!slots_[slot_i]->IsLegal(child_i))
+                return std::numeric_limits<double>::lowest();
+            return BatchedPUCT::TreePolicy(slot_i, child_i);
+        }
+
+        // Sets the Dirichlet noise of the priors of the root, drawn from `rand`, disabled by a fraction of 0.
+        void set_root_noise(double dirichlet_alpha, double noise_fraction, Random* rand) {
+            dirichlet_alpha_ = dirichlet_alpha;
+            noise_fraction_ = noise_fraction;
+            rand_ = rand;
+        }
+
+    protected:
+        InferenceBatcher* batcher_;
+        std::unique_ptr<SelfPlayGame> root_game_ = nullptr;
+        std::vector<std::unique_ptr<SelfPlayGame>> slots_;
+        std::vector<std::future<torch::Tensor>> futures_;
+        double dirichlet_alpha_ = 0.3;
+        double noise_fraction_ = 0;
+        Random* rand_ = nullptr;
+    };
+
+    // Trains a PolicyValueNet by self-play as AlphaZero, in a pipeline whose stages run concurrently:
+    //   - `num_actors` threads each play games against themselves, searching each move with a SelfPlaySearch, whose
+    //     leaves are evaluated in batches across all the games by an InferenceBatcher of a copy of the network;
+    //   - the positions of each ended game, with the visit distribution of their search as the target of the policy
+    //     and the outcome for their player to move as the target of the value, are streamed into a replay buffer;
+    //   - the learner, on the thread of Learn(), trains the network on batches of the buffer, and copies its weights
+    //     into the copy served to the searches every `sync_interval` gradient steps.
+    class SelfPlay {
+    public:
+        // Parameters:
+        //   net: The network trained.
+        //   inference_net: A network of the same structure as `net`, on the same device, which evaluates the leaves.
+        //   make_game: Returns a new game.
+        //   num_actors: The number of games played concurrently, each on a thread.
+        //   num_simulations: The number of leaves evaluated by the search of a move.
+        //   search_batch_size: The number of leaves of a batch of a search.
+        //   replay_capacity: The number of positions kept in the replay buffer.
+        //   learning_starts: The number of positions played before the training starts.
+        //   batch_size: The number of positions of a gradient step.
+        //   lr: The learning rate.
+        //   sync_interval: The number of gradient steps between the copies of the weights to the searches.
+        //   num_sampled_moves: The number of moves of a game sampled from the visit distribution, the next ones being
+        //                      the most visited.
+        //   dirichlet_alpha: The concentration of the noise of the priors of the root.
+        //   noise_fraction: The weight of the noise of the priors of the root.
+        //   max_inference_batch_size: The maximum number of leaves of a forward of the batcher.
+        //   max_inference_latency_us: The maximum time a leaf waits for a forward, in microseconds.
+        //   device: The device of the networks.
+        SelfPlay(
+            const std::shared_ptr<PolicyValueNet>& net,
+            const std::shared_ptr<PolicyValueNet>& inference_net,
+            std::function<std::unique_ptr<SelfPlayGame>()> make_game,
+            Int num_actors = 16,
+            Int num_simulations = 200,
+            Int search_batch_size = 8,
+            Int replay_capacity = 100000,
+            Int learning_starts = 5000,
+            Int batch_size = 256,
+            double lr = 1e-3,
+            Int sync_interval = 100,
+            Int num_sampled_moves = 10,
+            double dirichlet_alpha = 0.3,
+            double noise_fraction = 0.25,
+            Int max_inference_batch_size = 512,
+            Int max_inference_latency_us = 500,
+            const torch::Device& device = torch::kCPU
+        ) :
+            net_(net),
+            inference_net_(inference_net),
+            make_game_(std::move(make_game)),
+            num_actors_(std::max(num_actors, Int(1))),
+            num_simulations_(num_simulations),
+            search_batch_size_(search_batch_size),
+            replay_capacity_(replay_capacity),
+            learning_starts_(std::max(learning_starts, batch_size)),
+            batch_size_(batch_size),
+            lr_(lr),
+            sync_interval_(std::max(sync_interval, Int(1))),
+            num_sampled_moves_(num_sampled_moves),
+            dirichlet_alpha_(dirichlet_alpha),
+            noise_fraction_(noise_fraction),
+            max_inference_batch_size_(max_inference_batch_size),
+            max_inference_latency_us_(max_inference_latency_us),
+            device_(device)
+        {
+            if (net_ == nullptr || inference_net_ == nullptr || !make_game_)
+                throw std::runtime_error("SelfPlay: requires the networks and the games.");
+        }
+
+        DISALLOW_COPY_AND_ASSIGN(SelfPlay);
+
+        virtual ~SelfPlay() {
+            try {
+                StopActors();
+            }
+            catch (...) {}
+        }
+
+        virtual void Reset() {
+            StopActors();
+            net_->Reset();
+            net_->To(device_);
+            net_->to(device_);
+            inference_net_->To(device_);
+            inference_net_->to(device_);
+            torch_utils::CopyStateDict(*net_, inference_net_.get());
+            inference_net_->SetTrainingMode(false);
+            optimizer_ = std::make_unique<torch::optim::Adam>(net_->parameters(), torch::optim::AdamOptions(lr_));
+            batcher_ = std::make_unique<InferenceBatcher>(
+                inference_net_,
+                max_inference_batch_size_,
+                max_inference_latency_us_,
+                [this](RLPolicy* policy, const torch::Tensor& observations) {
+                    auto [logits, values] = static_cast<PolicyValueNet*>(policy)->PredictPolicyValues(observations.to(device_));
+                    return torch::cat({ logits, values.view({ -1, 1 }) }, 1).to(torch::kCPU);
+                }
+            );
+            {
+                std::lock_guard<std::mutex> lock(buffer_mutex_);
+                buffer_size_ = 0;
+                buffer_pos_ = 0;
+                observations_ = torch::Tensor();
+                policies_ = torch::Tensor();
+                values_ = torch::Tensor();
+            }
+            num_games_ = 0;
+            num_positions_ = 0;
+            num_gradient_steps_ = 0;
+            rand_ = Random();
+        }
+
+        // Plays and trains until `num_gradient_steps` more gradient steps are made. The actors play on while the
+        // learner trains, and are stopped at the end.
+        void Learn(Int num_gradient_steps) {
+            if (batcher_ == nullptr)
+                throw std::runtime_error("SelfPlay: learns before Reset().");
+            StartActors();
+            try {
+                Int end = num_gradient_steps_ + num_gradient_steps;
+                // The actors stop themselves on an error, which StopActors() rethrows.
+                while (num_gradient_steps_ < end && !stop_) {
+                    if (buffer_size() < learning_starts_) {
+                        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                        continue;
+                    }
+                    Train();
+                    if (num_gradient_steps_ % sync_interval_ == 0)
+                        batcher_->LoadWeights(*net_);
+                }
+                batcher_->LoadWeights(*net_);
+            }
+            catch (...) {
+                StopActors();
+                throw;
+            }
+            StopActors();
+        }
+
+        Int buffer_size() const {
+            std::lock_guard<std::mutex> lock(buffer_mutex_);
+            return buffer_size_;
+        }
+
+        Int num_games() const {
+            return num_games_;
+        }
+
+        Int num_positions() const {
+            return num_positions_;
+        }
+
+        Int num_gradient_steps() const {
+            return num_gradient_steps_;
+        }
+
+        // Returns the policy loss and the value loss of the last gradient step.
+        std::array<double, 2> losses() const {
+            return { policy_loss_, value_loss_ };
+        }
+
+        const InferenceBatcher* batcher() const {
+            return batcher_.get();
+        }
+
+    protected:
+        // A position of a game, with the targets of its training but the value, known at the end.
+        struct Position {
+            torch::Tensor observation;
+            std::vector<float> policy;
+        };
+
+        void StartActors() {
+            stop_ = false;
+            Random rand = rand_;
+            for (Int i=0; i<num_actors_; ++i) {
+                rand.Jump();
+                actors_.emplace_back([this, rand]() mutable { RunActor(&rand); });
+            }
+            rand_ = rand;
+        }
+
+        void StopActors() {
+            stop_ = true;
+            for (auto& actor : actors_) {
+                actor.join();
+            }
+            actors_.clear();
+            if (actor_error_ != nullptr) {
+                std::exception_ptr error = actor_error_;
+                actor_error_ = nullptr;
+                std::rethrow_exception(error);
+            }
+        }
+
+        // Plays games until the actors are stopped. A game interrupted by the stop is discarded.
+        void RunActor(Random* rand) {
+            try {
+                SelfPlaySearch search(batcher_.get(), search_batch_size_);
+                search.set_root_noise(dirichlet_alpha_, noise_fraction_, rand);
+                std::unique_ptr<SelfPlayGame> game = make_game_();
+                std::vector<Position> positions;
+                while (!stop_) {
+                    game->Reset();
+                    positions.clear();
+                    while (!game->IsOver() && !stop_) {
+                        search.Search(*game, num_simulations_);
+                        Position position;
+                        position.observation = game->Observe();
+                        position.policy = search.VisitDistribution();
+                        Int action;
+                        if (positions.size() < num_sampled_moves_)
+                            action = rand->Discrete<Int>(position.policy.begin(), position.policy.end());
+                        else
+                            action = std::max_element(position.policy.begin(), position.policy.end()) - position.policy.begin();
+                        positions.push_back(std::move(position));
+                        game->Step(action);
+                    }
+                    if (game->IsOver())
+                        AddGame(positions, game->Result());
+                }
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(buffer_mutex_);
+                if (actor_error_ == nullptr)
+                    actor_error_ = std::current_exception();
+                stop_ = true;
+            }
+        }
+
+        // Adds the positions of an ended game to the buffer, the value of each being the result for its player to
+        // move, the result of the last move being seen by the player who made it.
+        void AddGame(const std::vector<Position>& positions, double result) {
+            Int num_positions = positions.size();
+            std::lock_guard<std::mutex> lock(buffer_mutex_);
+            for (Int t=0; t<num_positions; ++t) {
+                const Position& position = positions[t];
+                if (!observations_.defined()) {
+                    std::vector<Int> sizes = { replay_capacity_ };
+                    sizes.insert(sizes.end(), position.observation.sizes().begin(), position.observation.sizes().end());
+                    observations_ = torch::zeros(sizes, position.observation.options());
+                    policies_ = torch::zeros({ replay_capacity_, (Int)position.policy.size() }, torch::kFloat32);
+                    values_ = torch::zeros({ replay_capacity_ }, torch::kFloat32);
+                }
+                observations_[buffer_pos_].copy_(position.observation);
+                policies_[buffer_pos_].copy_(torch::from_blob((void*)position.policy.data(), { (Int)position.policy.size() }, torch::kFloat32));
+                values_[buffer_pos_] = (num_positions - 1 - t) % 2 == 0 ? result : -result;
+                buffer_pos_ = (buffer_pos_ + 1) % replay_capacity_;
+                buffer_size_ = std::min(buffer_size_ + 1, replay_capacity_);
+            }
+            ++num_games_;
+            num_positions_ += num_positions;
+        }
+
+        // Makes a gradient step on a batch of the buffer, the cross-entropy of the visit distributions and the
+        // squared error of the values.
+        void Train() {
+            torch::Tensor observations, policies, values;
+            {
+                std::lock_guard<std::mutex> lock(buffer_mutex_);
+                torch::Tensor indices = torch::randint(0, buffer_size_, { batch_size_ }, torch::kInt64);
+                observations = observations_.index_select(0, indices);
+                policies = policies_.index_select(0, indices);
+                values = values_.index_select(0, indices);
+            }
+            net_->SetTrainingMode(true);
+            auto [logits, predicted_values] = net_->PredictPolicyValues(observations.to(device_));
+            torch::Tensor policy_loss = -(policies.to(device_) * torch::log_softmax(logits, 1)).sum(1).mean();
+            torch::Tensor value_loss = torch::mse_loss(predicted_values.view({ -1 }), values.to(device_));
+            torch::Tensor loss = policy_loss + value_loss;
+            optimizer_->zero_grad();
+            loss.backward();
+            optimizer_->step();
+            policy_loss_ = policy_loss.item<double>();
+            value_loss_ = value_loss.item<double>();
+            ++num_gradient_steps_;
+        }
+
+        std::shared_ptr<PolicyValueNet> net_;
+        std::shared_ptr<PolicyValueNet> inference_net_;
+        std::function<std::unique_ptr<SelfPlayGame>()> make_game_;
+        Int num_actors_;
+        Int num_simulations_;
+        Int search_batch_size_;
+        Int replay_capacity_;
+        Int learning_starts_;
+        Int batch_size_;
+        double lr_;
+        Int sync_interval_;
+        Int num_sampled_moves_;
+        double dirichlet_alpha_;
+        double noise_fraction_;
+        Int max_inference_batch_size_;
+        Int max_inference_latency_us_;
+        torch::Device device_;
+        std::unique_ptr<torch::optim::Adam> optimizer_ = nullptr;
+        std::unique_ptr<InferenceBatcher> batcher_ = nullptr;
+        std::vector<std::thread> actors_;
+        std::atomic<bool> stop_ = false;
+        std::exception_ptr actor_error_ = nullptr; // The first error of the actors, set under buffer_mutex_.
+        mutable std::mutex buffer_mutex_;
+        torch::Tensor observations_;
+        torch::Tensor policies_;
+        torch::Tensor values_;
+        Int buffer_size_ = 0;
+        Int buffer_pos_ = 0;
+        std::atomic<Int> num_games_ = 0;
+        std::atomic<Int> num_positions_ = 0;
+        Int num_gradient_steps_ = 0;
+        double policy_loss_ = 0;
+        double value_loss_ = 0;
+        Random rand_;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,206 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include "rlop/common/platform.h"
+#include "rlop/common/torch_utils.h"
+
+// The statistics of the caching allocator of CUDA, where libtorch is built with CUDA and its headers are found.
+#if __has_include(<c10/cuda/CUDACachingAllocator.h>) && __has_include(<cuda_runtime_api.h>)
+#include <c10/cuda/CUDACachingAllocator.h>
+#define RLOP_CUDA_MEMORY_STATS
+#endif
+
+namespace rlop {
+    // Appends lines to a file on a background thread, so that the thread logging them does not wait for the disk.
+    class AsyncLineWriter {
+    public:
+        AsyncLineWriter(const std::string& path) : out_(path, std::ios::trunc) {
+            if (!out_)
+                throw std::runtime_error("AsyncLineWriter: failed to open " + path + ".");
+            thread_ = std::thread([this]() { Run(); });
+        }
+
+        DISALLOW_COPY_AND_ASSIGN(AsyncLineWriter);
+
+        // Writes the queued lines, and stops the thread.
+        virtual ~AsyncLineWriter() {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            cv_.notify_all();
+            thread_.join();
+        }
+
+        void Write(std::string line) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                lines_.push_back(std::move(line));
+            }
+            cv_.notify_all();
+        }
+
+    protected:
+        void Run() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (true) {
+                cv_.wait(lock, [this]() { return stop_ || !lines_.empty(); });
+                if (lines_.empty() && stop_)
+                    return;
+                std::deque<std::string> lines;
+                lines.swap(lines_);
+                lock.unlock();
+                for (const auto& line : lines) {
+                    out_ << line << '\n';
+                }
+                out_.flush();
+                lock.lock();
+            }
+        }
+
+        std::ofstream out_;
+        std::thread thread_;
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        std::deque<std::string> lines_;
+        bool stop_ = false;
+    };
+
+    // Measures the throughput of the learning of an algorithm: the environment steps and the gradient steps per
+    // second, the time spent in the phases of an iteration, and the peak memory of the device, written as a line of a
+    // tab-separated file at each iteration of Learn() by an AsyncLineWriter. It is disabled, and its scopes cost a
+    // branch, until a path is set.
+    //
+    // The time of a phase is exclusive of the phases nested in it, such as the buffer operations in the training,
+    // and is the time of the host: without synchronization, the work of the device is counted where the host waits
+    // for it. The phases of concurrent threads, as the actor of the asynchronous off-policy mode, add up, so that their
+    // sum may exceed the time of an iteration.
+    class Telemetry {
+    public:
+        enum Phase { kEnv = 0, kInference, kBuffer, kTrain, kLog, kNumPhases };
+
+        // Times a phase for the rest of the enclosing scope.
+        class Scope {
+        public:
+            Scope(Telemetry* telemetry, Phase phase) : telemetry_(telemetry->enabled() ? telemetry : nullptr), phase_(phase) {
+                if (telemetry_ == nullptr)
+                    return;
+                parent_ = current_;
+                current_ = this;
+                start_ = Now();
+            }
+
+            DISALLOW_COPY_AND_ASSIGN(Scope);
+
+            ~Scope() {
+                if (telemetry_ == nullptr)
+                    return;
+                int64_t duration = Now() - start_;
+                telemetry_->phase_times_[phase_].fetch_add(duration - child_time_, std::memory_order_relaxed);
+                if (parent_ != nullptr)
+                    parent_->child_time_ += duration;
+                current_ = parent_;
+            }
+
+        protected:
+            Telemetry* telemetry_;
+            Phase phase_;
+            Scope* parent_ = nullptr;
+            int64_t start_ = 0;
+            int64_t child_time_ = 0; // The time of the nested scopes.
+            static inline thread_local Scope* current_ = nullptr;
+        };
+
+        Telemetry() = default;
+
+        DISALLOW_COPY_AND_ASSIGN(Telemetry);
+
+        virtual ~Telemetry() = default;
+
+        // Starts writing the telemetry to a file, or stops it for an empty path.
+        void Open(const std::string& path, const torch::Device& device) {
+            writer_ = nullptr;
+            if (path.empty())
+                return;
+            device_ = device;
+            writer_ = std::make_unique<AsyncLineWriter>(path);
+            std::string header = "time_steps\tseconds\tenv_steps_per_second\tgradient_steps_per_second";
+            for (Int phase=0; phase<kNumPhases; ++phase) {
+                header += std::string("\t") + kPhaseNames[phase] + "_seconds";
+            }
+            header += "\tdevice_peak_bytes\tprocess_bytes";
+            writer_->Write(header);
+            Restart(0);
+        }
+
+        // Starts the measures of a run of Learn() from its time steps.
+        void Restart(Int time_steps) {
+            last_time_ = Now();
+            last_time_steps_ = time_steps;
+            num_gradient_steps_ = 0;
+            for (auto& time : phase_times_) {
+                time = 0;
+            }
+        }
+
+        void AddGradientSteps(Int num_steps) {
+            if (enabled())
+                num_gradient_steps_.fetch_add(num_steps, std::memory_order_relaxed);
+        }
+
+        // Writes the measures since the previous iteration.
+        void EndIteration(Int time_steps) {
+            if (!enabled())
+                return;
+            int64_t now = Now();
+            double seconds = (now - last_time_) * 1e-9;
+            std::ostringstream line;
+            line << time_steps << '\t' << seconds;
+            line << '\t' << (seconds > 0 ? (time_steps - last_time_steps_) / seconds : 0.0);
+            line << '\t' << (seconds > 0 ? num_gradient_steps_.exchange(0) / seconds : 0.0);
+            for (auto& time : phase_times_) {
+                line << '\t' << time.exchange(0) * 1e-9;
+            }
+            line << '\t' << DevicePeakBytes() << '\t' << GetProcessMemoryUsage();
+            writer_->Write(line.str());
+            last_time_ = now;
+            last_time_steps_ = time_steps;
+        }
+
+        bool enabled() const {
+            return writer_ != nullptr;
+        }
+
+    protected:
+        static constexpr const char* kPhaseNames[kNumPhases] = { "env", "inference", "buffer", "train", "log" };
+
+        static int64_t Now() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        // Returns the peak of the memory allocated by libtorch on a CUDA device since the start, 0 elsewhere.
+        int64_t DevicePeakBytes() const {
+#ifdef RLOP_CUDA_MEMORY_STATS
+            if (device_.is_cuda()) {
+                auto stats = c10::cuda::CUDACachingAllocator::getDeviceStats(device_.has_index() ? device_.index() : 0);
+                // The first statistic is the aggregate of the pools, whose enum moved across the versions of libtorch.
+                return stats.allocated_bytes[0].peak;
+            }
+#endif
+            return 0;
+        }
+
+        std::unique_ptr<AsyncLineWriter> writer_ = nullptr;
+        torch::Device device_ = torch::kCPU;
+        int64_t last_time_ = 0;
+        Int last_time_steps_ = 0;
+        std::atomic<Int> num_gradient_steps_ = 0;
+        std::array<std::atomic<int64_t>, kNumPhases> phase_times_ = {}; // The exclusive times of the phases in nanoseconds.
+    };
+}
\ No newline at end of file
@@ -0,0 +1,160 @@
+#pragma once
+#include "rlop/common/thread_pool.h"
+#include "rlop/common/torch_utils.h"
+
+namespace rlop {
+    // The outcome of a step of an Env.
+    struct EnvStep {
+        double reward = 0;
+        bool terminated = false; // Whether the environment reached a terminal state.
+        bool truncated = false; // Whether the episode was cut outside the scope of the MDP, such as by a time limit.
+    };
+
+    // An environment implemented in C++, stepped by a VectorEnv. An environment is only called from one thread at a
+    // time, but not always the same one.
+    class Env {
+    public:
+        virtual ~Env() = default;
+
+        // Resets the environment to the start of an episode.
+        virtual void Reset() = 0;
+
+        // Steps the environment with an action, the row of the environment in the actions of the VectorEnv, on the CPU.
+        virtual EnvStep Step(const torch::Tensor& action) = 0;
+
+        // Writes the current observation into `observation`, a contiguous tensor on the CPU of the observation sizes
+        // and type of the VectorEnv.
+        virtual void Observe(const torch::Tensor& observation) const = 0;
+    };
+
+    // Steps a vector of C++ environments in parallel on a thread pool, as the vector environments of Gymnasium do
+    // in Python: the results of a step are the observations, the rewards, the terminations, the truncations and the
+    // final observations of the environments, and an environment ending an episode is reset at once, its last
+    // observation written to its row of the final observations, zero for the others.
+    //
+    // The environments write their results directly into tensors allocated once, which are not copied: they cycle
+    // over `num_buffers` sets, so that the results of a step are overwritten `num_buffers` steps later. The default
+    // of 2 keeps the observations of the previous step valid, as the algorithms store them along with those of the
+    // next one, and a caller keeping the results longer must copy them. Each environment is stepped on the same
+    // thread of the pool across the steps, which keeps its state in the cache of that thread.
+    class VectorEnv {
+    public:
+        // Parameters:
+        //   envs: The environments.
+        //   observation_sizes: The sizes of an observation of an environment.
+        //   observation_type: The type of the observations.
+        //   num_buffers: The number of sets of result tensors, at least 2.
+        //   thread_pool: The pool stepping the environments.
+        VectorEnv(
+            const std::vector<std::shared_ptr<Env>>& envs,
+            const std::vector<Int>& observation_sizes,
+            torch::Dtype observation_type = torch::kFloat32,
+            Int num_buffers = 2,
+            ThreadPool* thread_pool = &ThreadPool::Global()
+        ) :
+            envs_(envs),
+            observation_sizes_(observation_sizes),
+            observation_type_(observation_type),
+            thread_pool_(thread_pool)
+        {
+            if (envs_.empty())
+                throw std::runtime_error("VectorEnv: requires at least one environment.");
+            Int num_envs = envs_.size();
+            std::vector<Int> sizes = { num_envs };
+            sizes.insert(sizes.end(), observation_sizes_.begin(), observation_sizes_.end());
+            buffers_.resize(std::max(num_buffers, Int(2)));
+            for (auto& buffers : buffers_) {
+                buffers.observations = torch::zeros(sizes, observation_type_);
+                buffers.rewards = torch::zeros({ num_envs }, torch::kFloat32);
+                buffers.terminations = torch::zeros({ num_envs }, torch::kBool);
+                buffers.truncations = torch::zeros({ num_envs }, torch::kBool);
+                buffers.final_observations = torch::zeros(sizes, observation_type_);
+                buffers.final_written.assign(num_envs, false);
+            }
+        }
+
+        DISALLOW_COPY_AND_ASSIGN(VectorEnv);
+
+        virtual ~VectorEnv() = default;
+
+        // Resets all the environments, and returns their observations.
+        torch::Tensor Reset() {
+            Buffers& buffers = NextBuffers();
+            thread_pool_->ParallelForPinned(0, num_envs(), [&](Int i) {
+                envs_[i]->Reset();
+                envs_[i]->Observe(buffers.observations[i]);
+            });
+            return buffers.observations;
+        }
+
+        // Steps the environments with their actions, a tensor of one row per environment on any device, and resets
+        // those ending an episode.
+        //
+        // Returns:
+        //   std::array<torch::Tensor, 5>: The observations, the rewards, the terminations, the truncations and the
+        //                                 final observations, in the order of RL::Step().
+        std::array<torch::Tensor, 5> Step(const torch::Tensor& actions) {
+            torch::Tensor cpu_actions = actions.to(torch::kCPU).contiguous();
+            Buffers& buffers = NextBuffers();
+            float* rewards = buffers.rewards.data_ptr<float>();
+            bool* terminations = buffers.terminations.data_ptr<bool>();
+            bool* truncations = buffers.truncations.data_ptr<bool>();
+            thread_pool_->ParallelForPinned(0, num_envs(), [&](Int i) {
+                EnvStep step = envs_[i]->Step(cpu_actions[i]);
+                rewards[i] = step.reward;
+                terminations[i] = step.terminated;
+                truncations[i] = step.truncated;
+                if (step.terminated || step.truncated) {
+                    envs_[i]->Observe(buffers.final_observations[i]);
+                    buffers.final_written[i] = true;
+                    envs_[i]->Reset();
+                }
+                else if (buffers.final_written[i]) {
+                    // Only the rows written at the previous use of the buffers are cleared.
+                    buffers.final_observations[i].zero_();
+                    buffers.final_written[i] = false;
+                }
+                envs_[i]->Observe(buffers.observations[i]);
+            });
+            return { buffers.observations, buffers.rewards, buffers.terminations, buffers.truncations, buffers.final_observations };
+        }
+
+        Int num_envs() const {
+            return envs_.size();
+        }
+
+        const std::shared_ptr<Env>& env(Int i) const {
+            return envs_[i];
+        }
+
+        const std::vector<Int>& observation_sizes() const {
+            return observation_sizes_;
+        }
+
+        torch::Dtype observation_type() const {
+            return observation_type_;
+        }
+
+    protected:
+        struct Buffers {
+            torch::Tensor observations;
+            torch::Tensor rewards;
+            torch::Tensor terminations;
+            torch::Tensor truncations;
+            torch::Tensor final_observations;
+            std::vector<char> final_written; // Whether the row of an environment in the final observations is set.
+        };
+
+        Buffers& NextBuffers() {
+            buffer_i_ = (buffer_i_ + 1) % (Int)buffers_.size();
+            return buffers_[buffer_i_];
+        }
+
+        std::vector<std::shared_ptr<Env>> envs_;
+        std::vector<Int> observation_sizes_;
+        torch::Dtype observation_type_;
+        ThreadPool* thread_pool_;
+        std::vector<Buffers> buffers_;
+        Int buffer_i_ = -1;
+    };
+}
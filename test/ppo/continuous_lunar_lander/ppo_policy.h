@@ -40,7 +40,7 @@ namespace continuous_lunar_lander {
 
         torch::Tensor PredictActions(const torch::Tensor& observations, bool deterministic = false) override {
             torch::Tensor mean = PredictDist(observations);
-            rlop::DiagGaussian dist(mean, log_std_.exp());
+            rlop::DiagGaussian dist(mean, log_std_.exp(), log_std_);
             if (deterministic) 
                 return dist.Mode();
             else {
@@ -55,18 +55,16 @@ namespace continuous_lunar_lander {
 
         std::tuple<torch::Tensor, torch::Tensor, std::optional<torch::Tensor>> EvaluateActions(const torch::Tensor& observations, const torch::Tensor& actions) override {
             torch::Tensor mean = PredictDist(observations);
-            rlop::DiagGaussian dist(mean, log_std_.exp());
-            torch::Tensor log_prob = dist.LogProb(actions);
-            torch::Tensor entropy = dist.Entropy();
+            rlop::DiagGaussian dist(mean, log_std_.exp(), log_std_);
+            auto [ log_prob, entropy ] = dist.LogProbAndEntropy(actions);
             torch::Tensor values = PredictValues(observations);
             return { values, log_prob, { entropy } };
         }
 
         std::array<torch::Tensor, 3> Forward(const torch::Tensor& observations) override {
             torch::Tensor mean = PredictDist(observations);
-            rlop::DiagGaussian dist(mean, log_std_.exp());
-            torch::Tensor actions = dist.Sample();
-            torch::Tensor log_prob = dist.LogProb(actions);
+            rlop::DiagGaussian dist(mean, log_std_.exp(), log_std_);
+            auto [ actions, log_prob ] = dist.SampleAndLogProb();
             torch::Tensor values = PredictValues(observations);
             return { actions, values, log_prob };
         }
@@ -55,17 +55,15 @@ namespace lunar_lander {
             torch::Tensor logits = PredictActionLogits(observations);
             torch::Tensor values = PredictValues(observations);
             rlop::Categorical dist(logits);
-            torch::Tensor log_prob = dist.LogProb(actions);
-            torch::Tensor entropy = dist.Entropy();
+            auto [ log_prob, entropy ] = dist.LogProbAndEntropy(actions);
             return { values, log_prob, { entropy } };
         }
 
         std::array<torch::Tensor, 3> Forward(const torch::Tensor& observations) override {
             torch::Tensor logits = PredictActionLogits(observations);
             rlop::Categorical dist(logits);
-            torch::Tensor actions = dist.Sample();
+            auto [ actions, log_prob ] = dist.SampleAndLogProb();
             torch::Tensor values = PredictValues(observations);
-            torch::Tensor log_prob = dist.LogProb(actions);
             return { actions, values, log_prob };
         }
 
@@ -66,16 +66,14 @@ namespace continuous_lunar_lander {
 
         std::array<torch::Tensor, 2> PredictLogProb(const torch::Tensor& observations) override {
             auto [ mean, log_std ] = PredictDist(observations);
-            rlop::SquashedDiagGaussian dist(mean, log_std.exp());
-            torch::Tensor gaussian_actions = dist.rlop::DiagGaussian::Sample();
-            torch::Tensor actions = torch::tanh(gaussian_actions);
-            torch::Tensor log_prob = dist.LogProb(actions, gaussian_actions);
+            rlop::SquashedDiagGaussian dist(mean, log_std.exp(), 1e-6, log_std);
+            auto [ actions, log_prob ] = dist.SampleAndLogProb();
             return { actions, log_prob };
         }
 
         torch::Tensor PredictActions(const torch::Tensor& observations, bool deterministic = false) override {
             auto [ mean, log_std ] = PredictDist(observations);
-            rlop::SquashedDiagGaussian dist(mean, log_std.exp());
+            rlop::SquashedDiagGaussian dist(mean, log_std.exp(), 1e-6, log_std);
             if (deterministic)
                 return dist.Mode();
             return dist.Sample();